@@ -0,0 +1,101 @@
+#include "BatchRenderer.hpp"
+
+#include "utils/gl_extensions.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <thread>
+
+BatchRenderer::BatchRenderer(const fs::path &appPath, uint32_t width,
+    uint32_t height, const fs::path &gltfFile,
+    const std::vector<float> &lookatArgs, const std::string &vertexShader,
+    const std::string &fragmentShader, const fs::path &output,
+    const ViewerOptions &options, size_t workerCount) :
+    m_appPath(appPath),
+    m_width(width),
+    m_height(height),
+    m_gltfFile(gltfFile),
+    m_lookatArgs(lookatArgs),
+    m_vertexShader(vertexShader),
+    m_fragmentShader(fragmentShader),
+    m_output(output),
+    m_options(options),
+    m_workerCount(workerCount ? workerCount
+                              : std::max(HeadlessGLContext::getDeviceCount(),
+                                    size_t(1)))
+{
+  // Workers render on their threads, GLFW windows can only be created on the
+  // main thread. The scene is shared, so it must be kept as loaded.
+  m_options.headlessContext = true;
+  m_options.releaseCpuData = false;
+}
+
+int BatchRenderer::run()
+{
+  // With --parallel-startup, workers create their contexts while the scene
+  // is loaded, and only wait for it to draw
+  std::shared_future<std::shared_ptr<LoadedScene>> sceneLoading =
+      std::async(m_options.parallelStartup ? std::launch::async
+                                           : std::launch::deferred,
+          [&]() {
+            return ViewerApplication::loadScene(m_gltfFile, m_options);
+          });
+  if (!m_options.parallelStartup && !sceneLoading.get()) {
+    std::cerr << "Error : unable to load " << m_gltfFile.string()
+              << std::endl;
+    return -1;
+  }
+  if (!m_options.cameraListPath.empty() || m_options.turntableViewCount ||
+      !m_options.sweepPath.empty()) {
+    // Before workers write in it
+    fs::create_directories(m_output);
+  }
+
+  std::atomic<size_t> nextViewIdx{0};
+  std::atomic<bool> hasFailed{false};
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < m_workerCount; ++i) {
+    workers.emplace_back([&, i]() {
+      try {
+        auto options = m_options;
+        options.headlessDevice = int(i);
+        // The scene is loaded once, for all of them
+        options.parallelStartup = false;
+        ViewerApplication app{m_appPath, m_width, m_height, m_gltfFile,
+            m_lookatArgs, m_vertexShader, m_fragmentShader, m_output,
+            options};
+        if (m_options.parallelStartup) {
+          enableParallelShaderCompile();
+        }
+        const auto scene = sceneLoading.get();
+        if (!scene) {
+          hasFailed = true;
+          return;
+        }
+        app.setLoadedScene(scene);
+        app.setBatchViews([&](size_t &viewIdx) {
+          viewIdx = nextViewIdx++;
+          return true;
+        });
+        if (app.run() != 0) {
+          hasFailed = true;
+        }
+      } catch (const std::exception &e) {
+        std::cerr << "Error : worker " << i << " failed: " << e.what()
+                  << std::endl;
+        hasFailed = true;
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  if (!sceneLoading.get()) {
+    std::cerr << "Error : unable to load " << m_gltfFile.string()
+              << std::endl;
+    return -1;
+  }
+  return hasFailed ? -1 : 0;
+}
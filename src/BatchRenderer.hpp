@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ViewerApplication.hpp"
+
+#include <string>
+#include <vector>
+
+// Renderer of the views of an output path (a batch of --cameras,
+// --turntable or --sweep, or --frames) on several workers. Each runs a ViewerApplication
+// on its own thread, with a headless context on its own EGL device (see
+// HeadlessGLContext), usually one per GPU.
+//
+// The glTF file is loaded, and its images decoded, once: workers draw the
+// same LoadedScene. They take the index of their next view from a shared
+// counter, so that faster devices render more views.
+class BatchRenderer
+{
+public:
+  // With a workerCount of 0, one worker per EGL device
+  BatchRenderer(const fs::path &appPath, uint32_t width, uint32_t height,
+      const fs::path &gltfFile, const std::vector<float> &lookatArgs,
+      const std::string &vertexShader, const std::string &fragmentShader,
+      const fs::path &output, const ViewerOptions &options,
+      size_t workerCount);
+
+  // Returns 0 once all views are rendered, -1 if the scene could not be
+  // loaded or a worker failed
+  int run();
+
+private:
+  fs::path m_appPath;
+  uint32_t m_width;
+  uint32_t m_height;
+  fs::path m_gltfFile;
+  std::vector<float> m_lookatArgs;
+  std::string m_vertexShader;
+  std::string m_fragmentShader;
+  fs::path m_output;
+  ViewerOptions m_options;
+  size_t m_workerCount;
+};
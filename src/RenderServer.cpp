@@ -0,0 +1,185 @@
+#include "RenderServer.hpp"
+#include "utils/image_writer.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+RenderServer::RenderServer(const fs::path &appPath,
+    const ViewerOptions &options, size_t maxSceneCount) :
+    m_appPath(appPath),
+    m_options(options),
+    m_maxSceneCount(std::max(maxSceneCount, size_t(1)))
+{
+  // Scenes render on their threads, GLFW windows can only be created on the
+  // main thread
+  m_options.headlessContext = true;
+}
+
+RenderServer::~RenderServer()
+{
+  for (auto &scene : m_scenes) {
+    stopScene(*scene);
+  }
+}
+
+int RenderServer::run(std::istream &input, std::ostream &output)
+{
+  m_output = &output;
+  std::string line;
+  while (std::getline(input, line)) {
+    std::istringstream fields(line);
+    std::string gltfFile, outputPath, size, camera;
+    if (!(fields >> gltfFile)) {
+      continue; // Empty line
+    }
+    OutputJob job;
+    char separator = 0;
+    auto isValid = bool(fields >> outputPath >> size);
+    if (isValid) {
+      job.outputPath = outputPath;
+      std::istringstream sizeFields(size);
+      isValid = sizeFields >> job.width >> separator >> job.height &&
+                separator == 'x' && job.width && job.height &&
+                isImageFormatSupported(job.outputPath);
+    }
+    if (isValid && fields >> camera) {
+      job.hasCamera = parseCamera(camera, job.camera);
+      isValid = job.hasCamera;
+    }
+    if (!isValid) {
+      std::cerr << "Error : unable to parse job \"" << line << "\""
+                << std::endl;
+      reportJob(outputPath, false);
+      continue;
+    }
+
+    job.done = [this, outputPath = job.outputPath](bool written) {
+      reportJob(outputPath, written);
+    };
+    auto &scene = getScene(gltfFile);
+    if (!scene.thread.joinable()) {
+      scene.thread =
+          std::thread([this, &scene, job]() { runScene(scene, job); });
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(scene.mutex);
+      scene.jobs.push_back(std::move(job));
+    }
+    scene.condition.notify_all();
+  }
+
+  for (auto &scene : m_scenes) {
+    stopScene(*scene);
+  }
+  m_scenes.clear();
+  return 0;
+}
+
+RenderServer::Scene &RenderServer::getScene(const fs::path &gltfFile)
+{
+  auto it = std::find_if(begin(m_scenes), end(m_scenes),
+      [&](const std::unique_ptr<Scene> &scene) {
+        return scene->gltfFile == gltfFile;
+      });
+  if (it != end(m_scenes)) {
+    bool failed;
+    {
+      std::lock_guard<std::mutex> lock((*it)->mutex);
+      failed = (*it)->failed;
+    }
+    if (!failed) {
+      m_scenes.splice(begin(m_scenes), m_scenes, it);
+      return *m_scenes.front();
+    }
+    // Try to load it again, the file may have been fixed
+    stopScene(**it);
+    m_scenes.erase(it);
+  }
+
+  if (m_scenes.size() >= m_maxSceneCount) {
+    stopScene(*m_scenes.back());
+    m_scenes.pop_back();
+  }
+  m_scenes.push_front(std::make_unique<Scene>());
+  m_scenes.front()->gltfFile = gltfFile;
+  return *m_scenes.front();
+}
+
+void RenderServer::stopScene(Scene &scene)
+{
+  {
+    std::lock_guard<std::mutex> lock(scene.mutex);
+    scene.stop = true;
+  }
+  scene.condition.notify_all();
+  if (scene.thread.joinable()) {
+    scene.thread.join();
+  }
+}
+
+void RenderServer::runScene(Scene &scene, const OutputJob &firstJob)
+{
+  // Output of the job handed to the application and not done yet, reported
+  // as failed if it throws
+  auto jobInProgress = firstJob.outputPath;
+  auto isFirstJob = true;
+  const auto nextJob = [&](OutputJob &job) {
+    if (isFirstJob) {
+      isFirstJob = false;
+      job = firstJob;
+    } else {
+      std::unique_lock<std::mutex> lock(scene.mutex);
+      scene.condition.wait(
+          lock, [&]() { return scene.stop || !scene.jobs.empty(); });
+      if (scene.jobs.empty()) {
+        return false;
+      }
+      job = std::move(scene.jobs.front());
+      scene.jobs.pop_front();
+    }
+    jobInProgress = job.outputPath;
+    const auto done = job.done;
+    job.done = [&jobInProgress, done](bool written) {
+      jobInProgress.clear();
+      done(written);
+    };
+    return true;
+  };
+
+  try {
+    ViewerApplication app{m_appPath, firstJob.width, firstJob.height,
+        scene.gltfFile, {}, "", "", firstJob.outputPath, m_options};
+    app.setOutputJobs(nextJob);
+    app.run();
+    return;
+  } catch (const std::exception &e) {
+    std::cerr << "Error : unable to render " << scene.gltfFile.string()
+              << ": " << e.what() << std::endl;
+  }
+
+  // Jobs of the scene and those added until it is removed fail
+  if (!jobInProgress.empty()) {
+    reportJob(jobInProgress, false);
+  }
+  std::unique_lock<std::mutex> lock(scene.mutex);
+  scene.failed = true;
+  for (;;) {
+    scene.condition.wait(
+        lock, [&]() { return scene.stop || !scene.jobs.empty(); });
+    if (scene.jobs.empty()) {
+      return;
+    }
+    const auto job = std::move(scene.jobs.front());
+    scene.jobs.pop_front();
+    lock.unlock();
+    reportJob(job.outputPath, false);
+    lock.lock();
+  }
+}
+
+void RenderServer::reportJob(const fs::path &outputPath, bool written)
+{
+  std::lock_guard<std::mutex> lock(m_outputMutex);
+  *m_output << (written ? "ok " : "error ") << outputPath.string() << std::endl;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ViewerApplication.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Long running renderer of output images, jobs are read from an input stream
+// one per line:
+//
+//   <glTF file> <output image> <width>x<height> [<camera>]
+//
+// with the camera in the format of --lookat, else the default camera of the
+// scene. Paths can not contain spaces. Each job is answered by a line on the
+// output stream once done, "ok <output image>" or "error <output image>", in
+// the order jobs complete.
+//
+// The scenes of the last maxSceneCount files stay loaded on the GPU: each
+// runs a ViewerApplication on its own thread with its own headless context
+// (see HeadlessGLContext), rendering its jobs while the next ones are read.
+// The least recently used one is released when another file is needed.
+class RenderServer
+{
+public:
+  RenderServer(const fs::path &appPath, const ViewerOptions &options,
+      size_t maxSceneCount);
+
+  // Wait for the jobs of all scenes
+  ~RenderServer();
+
+  RenderServer(const RenderServer &) = delete;
+
+  RenderServer &operator=(const RenderServer &) = delete;
+
+  // Serve the jobs of input until its end, returns 0 once they are all done
+  int run(std::istream &input, std::ostream &output);
+
+private:
+  struct Scene
+  {
+    fs::path gltfFile;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<OutputJob> jobs;
+    bool stop = false; // No more jobs, return once jobs is empty
+    bool failed = false; // Could not be loaded, jobs fail until it is removed
+  };
+
+  // Scene of gltfFile, first in m_scenes, created if it is not loaded
+  Scene &getScene(const fs::path &gltfFile);
+
+  // Let the jobs of scene finish and release it
+  static void stopScene(Scene &scene);
+
+  void runScene(Scene &scene, const OutputJob &firstJob);
+
+  // Report a job, from any thread
+  void reportJob(const fs::path &outputPath, bool written);
+
+  fs::path m_appPath;
+  ViewerOptions m_options;
+  size_t m_maxSceneCount;
+  std::list<std::unique_ptr<Scene>> m_scenes; // Most recently used first
+  std::ostream *m_output = nullptr;
+  std::mutex m_outputMutex;
+};
@@ -1,24 +1,133 @@
 #include "ViewerApplication.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <numeric>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/io.hpp>
 
+#include "utils/ambient_occlusion.hpp"
+#include "utils/animation.hpp"
+#include "utils/block_compression.hpp"
+#include "utils/bloom.hpp"
 #include "utils/cameras.hpp"
+#include "utils/coherent_culler.hpp"
+#include "utils/debug_views.hpp"
+#include "utils/deduplicate.hpp"
+#include "utils/depth_pyramid.hpp"
+#include "utils/draco.hpp"
+#include "utils/draw_id_picker.hpp"
+#include "utils/draw_stats.hpp"
+#include "utils/draw_visibility.hpp"
+#include "utils/dynamic_resolution.hpp"
+#include "utils/environment_map.hpp"
+#include "utils/file_watcher.hpp"
+#include "utils/frame_accumulator.hpp"
+#include "utils/frame_profiler.hpp"
+#include "utils/frame_timing.hpp"
+#include "utils/gbuffer.hpp"
+#include "utils/gl_extensions.hpp"
 #include "utils/gltf.hpp"
+#include "utils/gltf_json.hpp"
+#include "utils/gpu_reduction.hpp"
+#include "utils/image_readback.hpp"
+#include "utils/image_writer.hpp"
+#include "utils/job_system.hpp"
 #include "utils/images.hpp"
+#include "utils/impostors.hpp"
+#include "utils/light_clusters.hpp"
+#include "utils/loader_thread.hpp"
+#include "utils/mesh_optimize.hpp"
+#include "utils/meshopt.hpp"
+#include "utils/packed_geometry.hpp"
+#include "utils/parallel.hpp"
+#include "utils/path_tracer.hpp"
+#include "utils/point_clouds.hpp"
+#include "utils/primitive_picker.hpp"
+#include "utils/program_cache.hpp"
+#include "utils/progressive_textures.hpp"
+#include "utils/ray_queries.hpp"
+#include "utils/render_device.hpp"
+#include "utils/runtime_scene.hpp"
+#include "utils/scene_color.hpp"
+#include "utils/scene_outliner.hpp"
+#include "utils/selection_outline.hpp"
+#include "utils/shading_rate.hpp"
+#include "utils/shadow_cascades.hpp"
+#include "utils/skinning.hpp"
+#include "utils/skinning_prepass.hpp"
+#include "utils/static_geometry.hpp"
+#include "utils/stereo_framebuffer.hpp"
+#include "utils/tangents.hpp"
+#include "utils/temporal_antialiasing.hpp"
+#include "utils/texture_arrays.hpp"
+#include "utils/texture_streamer.hpp"
+#include "utils/tile_pager.hpp"
+#include "utils/tiled_image.hpp"
+#include "utils/tone_mapping.hpp"
+#include "utils/trace.hpp"
+#include "utils/uniform_ring.hpp"
+#include "utils/vertex_streams.hpp"
+#include "utils/video_writer.hpp"
+#include "utils/view_sweep.hpp"
 
-#include <stb_image_write.h>
 #include <tiny_gltf.h>
 
 const GLuint VERTEX_ATTRIB_POSITION_IDX = 0;
 const GLuint VERTEX_ATTRIB_NORMAL_IDX = 1;
 const GLuint VERTEX_ATTRIB_TEXCOORD0_IDX = 2;
+const GLuint VERTEX_ATTRIB_DRAW_INDEX_IDX = 3; // Instanced, see instanceDraws
+// Of skinned meshes, joint indices are read as floats (exact for the 8 and 16
+// bits integers of glTF)
+const GLuint VERTEX_ATTRIB_JOINTS0_IDX = 4;
+const GLuint VERTEX_ATTRIB_WEIGHTS0_IDX = 5;
+// Of primitives with tangents, given or generated (see generateTangents)
+const GLuint VERTEX_ATTRIB_TANGENT_IDX = 6;
 
+// Material textures are bound to units 0 to MATERIAL_TEXTURE_COUNT - 1: base
+// color, metallic roughness, emissive, occlusion then normal texture
+const GLuint MATERIAL_TEXTURE_COUNT = 5;
+
+// With --reversed-z, the near and far planes fitted to the scene are moved
+// by this fraction of their depth, to keep nodes moving since the last
+// bounds update in. The near plane stays beyond MIN_NEAR_RATIO times the far
+// one when the camera is inside the scene.
+const float DEPTH_RANGE_MARGIN = 0.01f;
+const float MIN_NEAR_RATIO = 1e-5f;
+
+// A resized window gets render targets of its size once its size stayed the
+// same for this many seconds, not at each step of a drag resize
+const double RESIZE_DEBOUNCE_DELAY = 0.2;
+
+// With --upload-budget, seconds of a frame after which no new transfer of
+// queued textures starts
+const double UPLOAD_FRAME_SECONDS = 0.004;
+
+// With --camera-relative, distance from the camera beyond which the origin
+// of the matrices of the shaders moves to it. Vertices within it keep
+// floats of less than a tenth of a millimeter for models in meters, and
+// the Draws table is only uploaded again when the origin moves.
+const double RENDER_ORIGIN_DISTANCE = 1024.;
+
+// With --gpu-picking, default width of the outline of the picked node, in
+// pixels of the window
+const float SELECTION_OUTLINE_WIDTH = 3.f;
+
+#ifndef GLTF_VIEWER_HEADLESS
 void keyCallback(
     GLFWwindow *window, int key, int scancode, int action, int mods)
 {
@@ -26,41 +135,316 @@ void keyCallback(
     glfwSetWindowShouldClose(window, 1);
   }
 }
+#endif
+
+// Defines of the variant of pbr_directional_light.fs.glsl for a material,
+// disabling the textures it does not have. Empty if it has all of them.
+std::string getMaterialDefines(const RuntimeMaterial &material)
+{
+  static const char *const textureFeatures[MATERIAL_TEXTURE_COUNT] = {
+      "HAS_BASE_COLOR_TEXTURE", "HAS_METALLIC_ROUGHNESS_TEXTURE",
+      "HAS_EMISSIVE_TEXTURE", "HAS_OCCLUSION_TEXTURE", "HAS_NORMAL_TEXTURE"};
+  std::string defines;
+  for (size_t unit = 0; unit < MATERIAL_TEXTURE_COUNT; ++unit) {
+    if (material.textures[unit] < 0) {
+      defines += std::string("#define ") + textureFeatures[unit] + " 0\n";
+    }
+  }
+  return defines;
+}
+
+// Sampler of textures without one
+tinygltf::Sampler getDefaultSampler()
+{
+  tinygltf::Sampler sampler;
+  sampler.minFilter = GL_LINEAR;
+  sampler.magFilter = GL_LINEAR;
+  sampler.wrapS = GL_REPEAT;
+  sampler.wrapT = GL_REPEAT;
+  sampler.wrapR = GL_REPEAT;
+  return sampler;
+}
+
+// Output path of a frame rendered with --frames: frameIdx is inserted before
+// the extension when there are several frames
+fs::path getFramePath(
+    const fs::path &outputPath, size_t frameIdx, size_t frameCount)
+{
+  if (frameCount <= 1) {
+    return outputPath;
+  }
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), "_%04zu", frameIdx);
+  auto fileName = outputPath.stem();
+  fileName += suffix;
+  fileName += outputPath.extension();
+  return outputPath.parent_path() / fileName;
+}
 
 int ViewerApplication::run()
 {
-  // Loader shaders
-  const auto glslProgram =
-      compileProgram({m_ShadersRootPath / m_vertexShader,
-          m_ShadersRootPath / m_fragmentShader});
-
-  const auto modelViewProjMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewProjMatrix");
-  const auto modelViewMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uModelViewMatrix");
-  const auto normalMatrixLocation =
-      glGetUniformLocation(glslProgram.glId(), "uNormalMatrix");
-
-  //Light & base color
-  const auto uLightDirectionLocation = glGetUniformLocation(glslProgram.glId(), "uLightDirection");
-  const auto uLightIntensity = glGetUniformLocation(glslProgram.glId(), "uLightIntensity");
-  const auto uBaseColorTexture = glGetUniformLocation(glslProgram.glId(), "uBaseColorTexture");
-  const auto uBaseColorFactor = glGetUniformLocation(glslProgram.glId(), "uBaseColorFactor");
-
-  //Metallic
-  const auto uMetallicRoughness = glGetUniformLocation(glslProgram.glId(), "uMetallicRoughnessTexture");
-  const auto uMetallicFactor = glGetUniformLocation(glslProgram.glId(), "uMetallicFactor");
-  const auto uRoughnessFactor = glGetUniformLocation(glslProgram.glId(), "uRoughnessFactor");
-
-  //Emission
-  const auto uEmissiveTexture = glGetUniformLocation(glslProgram.glId(), "uEmissiveTexture");
-  const auto uEmissiveFactor = glGetUniformLocation(glslProgram.glId(), "uEmissiveFactor");
-
-  //Occlusion
-  const auto uOcclusionTexture = glGetUniformLocation(glslProgram.glId(), "uOcclusionTexture");
-  const auto uOcclusionStrength = glGetUniformLocation(glslProgram.glId(), "uOcclusionStrength");
-  const auto uApplyOcclusion = glGetUniformLocation(glslProgram.glId(), "uApplyOcclusion");
+  // Allocations of this thread, the loader thread makes it current on its own
+  const GpuMemoryTracker::Scope memoryScope(&m_gpuMemory);
+  const auto &modelList = m_options.modelList;
+  for (;;) {
+    m_modelListIdx = size_t(
+        std::find(begin(modelList), end(modelList), m_gltfFilePath) -
+        begin(modelList));
+    const auto drawnFile = m_gltfFilePath;
+    const auto returnCode = runScene();
+    if (!m_nextScene) {
+      return returnCode;
+    }
+    // A dropped model is drawn from its default camera, the same model
+    // reloaded from the last camera (see runScene)
+    // The same file reloaded keeps the scene drawn
+    if (m_nextScene != m_scene) {
+      m_flatScenes.clear();
+      if (m_gltfFilePath != drawnFile ||
+          size_t(m_drawnSceneIdx) >= m_nextScene->model.scenes.size()) {
+        m_drawnSceneIdx = -1;
+      }
+    }
+    m_scene = std::move(m_nextScene);
+    m_hasUserCamera = m_gltfFilePath == drawnFile;
+  }
+}
+
+int ViewerApplication::runScene()
+{
+  // Loader shaders, with --program-cache from the binaries of a previous run
+  const ProgramCache programCache(
+      m_options.programCache ? m_AppPath.parent_path() / "program-cache"
+                             : fs::path());
+  // With GL_ARB_bindless_texture, the Materials table holds resident handles
+  // of the textures of materials and draws never bind textures
+  BindlessTextureFunctions bindless;
+  const auto useBindlessTextures = loadBindlessTextureFunctions(bindless);
+  // With --texture-arrays, textures are sampled from layers of array
+  // textures (see packTextureArrays). Not with bindless textures, which
+  // never bind them, nor with textures created while drawing.
+  const auto textureArrays = m_options.textureArrays &&
+                             !useBindlessTextures &&
+                             !decodeImagesInBackground();
+
+  // Without its maps, the scene is drawn without the environment. Prepared
+  // before the model is needed, while --parallel-startup parses it.
+  std::unique_ptr<EnvironmentMap> environmentMap;
+  auto environmentIntensity = 1.f;
+  if (!m_options.environmentPath.empty()) {
+    try {
+      environmentMap =
+          std::make_unique<EnvironmentMap>(m_options.environmentPath,
+              m_AppPath.parent_path() / "environment-cache", programCache,
+              m_ShadersRootPath);
+    } catch (const std::exception &e) {
+      std::cerr << "Error : " << e.what() << std::endl;
+    }
+  }
+
+  // Loading the glTF file
+  if (!m_scene) {
+    m_scene = m_startupScene.valid() ? m_startupScene.get()
+                                     : loadScene(m_gltfFilePath, m_options,
+                                           decodeImagesInBackground());
+  }
+  if (!m_scene)
+    throw std::runtime_error("Unable to load glTF model");
+
+  // With --srgb, the fragment shader does not decode textures itself
+  std::string programDefines;
+  if (m_options.hardwareSrgb) {
+    programDefines += "#define HARDWARE_SRGB 1\n";
+  }
+  if (textureArrays) {
+    programDefines += "#define TEXTURE_ARRAYS 1\n";
+  }
+  // Vertices of skinned meshes are transformed by joint matrices, in a
+  // variant of the vertex shader only compiled for models with skins
+  const std::string skinningDefines =
+      m_scene->model.skins.empty() ? "" : "#define SKINNING 1\n";
+  programDefines += skinningDefines;
+  // Lights of the model are only looped over by a variant of the shaders
+  const auto hasPunctualLights =
+      m_options.punctualLights && !m_scene->model.lights.empty();
+  if (hasPunctualLights) {
+    programDefines += "#define PUNCTUAL_LIGHTS 1\n";
+  }
+  if (m_options.shadowMaps) {
+    programDefines += "#define SHADOW_MAPS 1\n";
+  }
+  // With --reversed-z, the shaders reading depths back are compiled for the
+  // [0, 1] clip control range where the near plane is at 1
+  const auto clipControl =
+      m_options.reversedZ ? loadClipControlFunction() : nullptr;
+  if (m_options.reversedZ && !clipControl) {
+    std::cerr << "Warning : reversed depth disabled, glClipControl is not "
+                 "supported"
+              << std::endl;
+  }
+  const auto reversedZ = clipControl != nullptr;
+  const std::string depthDefines = reversedZ ? "#define REVERSED_Z 1\n" : "";
+  programDefines += depthDefines;
+  // With --gpu-picking, the shading programs write the draw IDs of the scene
+  // image. The passes of the G-buffer and of the depth pyramid draw in
+  // framebuffers of their own.
+  auto gpuPicking = m_options.gpuPicking && m_OutputPath.empty();
+  if (gpuPicking &&
+      (m_options.deferredShading || m_options.occlusionCulling)) {
+    std::cerr << "Warning : GPU picking disabled, not with deferred shading "
+                 "or occlusion culling"
+              << std::endl;
+    gpuPicking = false;
+  }
+  if (gpuPicking) {
+    programDefines += "#define DRAW_IDS 1\n";
+  }
+  // With --output-aovs, the forward shaders also write the draw IDs and the
+  // geometry of the pixels of output images. The passes of the G-buffer, of
+  // the depth pyramid and of HDR draw in framebuffers of their own, and
+  // neither can be averaged over samples.
+  auto outputAovs = m_options.outputAovs && !m_OutputPath.empty();
+  if (outputAovs &&
+      (m_options.deferredShading || m_options.occlusionCulling ||
+          m_options.hdr || m_options.outputSampleCount > 1)) {
+    std::cerr << "Warning : output AOVs disabled, not with deferred "
+                 "shading, occlusion culling, HDR or multisampling"
+              << std::endl;
+    outputAovs = false;
+  }
+  if (outputAovs) {
+    programDefines += "#define DRAW_IDS 1\n#define AOVS 1\n";
+  }
+  // With --taa, the forward shaders write the motion of their draws where
+  // draw IDs would be, GPU picking being off with HDR. Only the window is
+  // antialiased, --refine keeps its own jittered average.
+  const auto motionVectors = m_options.temporalAntiAliasing &&
+                             m_options.hdr && !gpuPicking &&
+                             m_OutputPath.empty() && !m_nextOutputJob &&
+                             m_options.refineFrameCount == 0;
+  if (motionVectors) {
+    programDefines += "#define MOTION_VECTORS 1\n";
+  }
+  // Without its maps, the scene is drawn without the environment
+  if (environmentMap) {
+    programDefines += "#define IMAGE_BASED_LIGHTING 1\n";
+  }
+  // With --stereo, the forward shaders draw both eyes in the layers of
+  // stereoFramebuffer. Every draw in it must be multiview, passes drawing
+  // with programs of their own or in framebuffers of their own are not
+  // supported.
+  auto framebufferTextureMultiview =
+      m_options.stereoSeparation > 0.f && m_OutputPath.empty() &&
+              !m_nextOutputJob
+          ? loadFramebufferTextureMultiviewFunction()
+          : nullptr;
+  if (m_options.stereoSeparation > 0.f && m_OutputPath.empty() &&
+      !m_nextOutputJob && !framebufferTextureMultiview) {
+    std::cerr << "Warning : stereo disabled, GL_OVR_multiview2 is not "
+                 "supported"
+              << std::endl;
+  }
+  if (framebufferTextureMultiview &&
+      (m_options.hdr || m_options.deferredShading ||
+          m_options.occlusionCulling || gpuPicking ||
+          m_options.punctualLights || m_options.impostors ||
+          m_options.computePoints || m_options.conditionalRender ||
+          m_options.cacheSceneImage || m_options.targetFrameTime > 0.f ||
+          m_options.refineFrameCount > 0)) {
+    std::cerr << "Warning : stereo disabled, not with HDR, deferred "
+                 "shading, occlusion culling, GPU picking, punctual lights, "
+                 "impostors, compute points, conditional rendering nor a "
+                 "scene image"
+              << std::endl;
+    framebufferTextureMultiview = nullptr;
+  }
+  const auto stereo = framebufferTextureMultiview != nullptr;
+  const std::string multiviewDefines = stereo ? "#define MULTIVIEW 1\n" : "";
+  programDefines += multiviewDefines;
+  // With --viewports, the scene is drawn from four cameras per frame. Passes
+  // keeping state from the previous frame of a single camera are not
+  // supported.
+  auto multiViewport =
+      m_options.multiViewport && m_OutputPath.empty() && !m_nextOutputJob;
+  if (multiViewport &&
+      (stereo || m_options.occlusionCulling ||
+          m_options.temporalAntiAliasing || m_options.conditionalRender ||
+          m_options.pipelinedFrames || gpuPicking ||
+          m_options.cacheSceneImage || m_options.targetFrameTime > 0.f ||
+          m_options.refineFrameCount > 0)) {
+    std::cerr << "Warning : multiple viewports disabled, not with stereo, "
+                 "occlusion culling, TAA, conditional rendering, pipelined "
+                 "frames nor a scene image"
+              << std::endl;
+    multiViewport = false;
+  }
+  // In the window, the forward shaders can draw the debug views of the GUI
+  // instead of the shaded scene (see DebugViews)
+#ifndef GLTF_VIEWER_HEADLESS
+  auto hasWireframeView = false;
+#endif
+  if (m_OutputPath.empty() && !m_nextOutputJob &&
+      !m_options.deferredShading && !stereo) {
+    const auto wireframeDefines = DebugViews::getWireframeDefines();
+#ifndef GLTF_VIEWER_HEADLESS
+    hasWireframeView = !wireframeDefines.empty();
+#endif
+    programDefines += "#define DEBUG_VIEWS 1\n" + wireframeDefines;
+  }
+  auto glslProgram =
+      programCache.compileProgram({m_ShadersRootPath / m_vertexShader,
+                                      m_ShadersRootPath / m_fragmentShader},
+          programDefines);
+
+  // Camera and light are written once per frame in the FrameUniforms block,
+  // draws not reading the Draws table write their matrices in DrawUniforms.
+  // Both are written in uniformRing.
+  const auto bindUniformBlocks = [](const GLProgram &program) {
+    for (const auto &block :
+        {std::make_pair("FrameUniforms", FRAME_UNIFORMS_BINDING),
+            std::make_pair("DrawUniforms", DRAW_UNIFORMS_BINDING),
+            std::make_pair(
+                "ShadowUniforms", ShadowCascades::UNIFORMS_BINDING),
+            std::make_pair(
+                "EnvironmentUniforms", EnvironmentMap::UNIFORMS_BINDING)}) {
+      const auto blockIndex = program.getUniformBlockIndex(block.first);
+      if (blockIndex != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program.glId(), blockIndex, block.second);
+      }
+    }
+  };
+  bindUniformBlocks(glslProgram);
+
+  // Output images are rendered in tiles with --tile-size, or when they do not
+  // fit in a texture. Returns 0 for images of the current size rendered whole.
+  GLint maxTextureSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  const auto getOutputTileSize = [&]() {
+    auto tileSize = m_options.outputTileSize;
+    if (!tileSize &&
+        std::max(m_nWindowWidth, m_nWindowHeight) > maxTextureSize) {
+      tileSize = std::min(size_t(2048), size_t(maxTextureSize));
+    }
+    if (m_OutputPath.empty() || (tileSize >= size_t(m_nWindowWidth) &&
+                                    tileSize >= size_t(m_nWindowHeight))) {
+      return size_t(0);
+    }
+    return tileSize;
+  };
+  if (outputAovs && getOutputTileSize()) {
+    std::cerr << "Warning : output AOVs disabled, not with tiled images"
+              << std::endl;
+    outputAovs = false;
+  }
 
+  //Material textures, factors are in the Materials table
+  const auto uBaseColorTexture = glslProgram.getUniformLocation("uBaseColorTexture");
+  const auto uMetallicRoughness = glslProgram.getUniformLocation("uMetallicRoughnessTexture");
+  const auto uEmissiveTexture = glslProgram.getUniformLocation("uEmissiveTexture");
+  const auto uOcclusionTexture = glslProgram.getUniformLocation("uOcclusionTexture");
+  const auto uNormalTexture = glslProgram.getUniformLocation("uNormalTexture");
+  const auto uMaterialIndex = glslProgram.getUniformLocation("uMaterialIndex");
+  const auto uBindlessTextures = glslProgram.getUniformLocation("uBindlessTextures");
 
   //Init light parameters
   glm::vec3 lightDirection(1,1,1);
@@ -68,20 +452,79 @@ int ViewerApplication::run()
   bool lightFromCamera = false;
   bool applyOcclusion = true;
 
-  tinygltf::Model model;
-  // Loading the glTF file
-  if (!loadGltfFile(model))
-    throw std::exception("Unable to load glTF model");
+  auto &model = m_scene->model;
+  const auto &bufferBytes = m_scene->bufferBytes;
+
+  // Phases of creating GL objects end once the GL is done with their work
+  m_loadPhases = m_scene->loadPhases;
+  const auto phases = m_options.profileLoading ? &m_loadPhases : nullptr;
+  const auto endUploadPhase = [&](LoadPhaseTimer &phase) {
+    if (phases) {
+      glFinish();
+    }
+    phase.end();
+  };
 
-  //Load textures
-  const auto textureObjects = createTextureObjects(model);
+  // GL objects of a dropped model already created by the loader thread
+  const auto uploadedScene = std::move(m_uploadedScene);
+
+  //Load textures, with --pbo-upload the copies of the pixels into pixel
+  //buffers overlap with the transfers of the previous textures. Textures of
+  //the previous scene are reused when their format and size match.
+  const auto pixelBufferCount =
+      m_options.pixelBufferUpload ? size_t(4) : size_t(0);
+  TextureUploader textureUploader{pixelBufferCount, &m_resourcePool};
+  LoadPhaseTimer texturePhase(phases, "createTextureObjects");
+  // With --lazy-resources, by createVisibleResources
+  const auto lazyTextures = createTexturesLazily() && !uploadedScene;
+  const auto lazyGeometry = uploadGeometryLazily() && !uploadedScene;
+  auto imageTextures =
+      uploadedScene ? std::move(uploadedScene->imageTextures)
+      : lazyTextures
+          ? GLTextures{std::vector<GLuint>(model.images.size(), 0)}
+          : createTextureObjects(model, textureUploader);
+  endUploadPhase(texturePhase);
+
+  // With --progressive, images are decoded while the scene is already drawn.
+  // Until then their textures are 0 and bindMaterial uses its fallback,
+  // textures with a KHR_texture_basisu image keep sampling it.
+  const auto imageUsages = getImageUsages(model);
+  ProgressiveTextures progressiveTextures(model, imageTextures, imageUsages,
+      [&](int imageIdx, const ImageUsage &usage, TextureUploader &uploader) {
+        return createTextureObject(model, imageIdx, uploader,
+            usage.generateMipmaps, usage.color);
+      },
+      m_options.releaseCpuData, m_options.hardwareSrgb,
+      m_options.maxTextureSize);
+  if (decodeImagesInBackground() && !uploadedScene) {
+    progressiveTextures.decodeImages(m_scene->remoteImages);
+  }
+  // With --loader-thread, textures of decoded images and dropped models are
+  // created there, and published between frames
+  std::unique_ptr<GLLoaderThread> loaderThread;
+#ifndef GLTF_VIEWER_HEADLESS
+  if (m_options.loaderThread && m_GLFWHandle && m_OutputPath.empty()) {
+    loaderThread = std::make_unique<GLLoaderThread>(m_GLFWHandle->window());
+    progressiveTextures.setLoaderThread(
+        loaderThread.get(), pixelBufferCount, &m_gpuMemory);
+  }
+#endif
+  // With --upload-budget, the textures of images decoded or first sampled
+  // while the scene is drawn are transferred over frames (see updateUploads)
+  if (m_options.uploadBudget > 0 &&
+      (progressiveTextures.isDecoding() || lazyTextures) && !loaderThread &&
+      m_OutputPath.empty()) {
+    progressiveTextures.setUploadBudget(
+        m_options.uploadBudget << 20, UPLOAD_FRAME_SECONDS);
+  }
 
   //Default white texture
   float white[] = {1,1,1,1};
-  GLuint whiteTexture;
-  glGenTextures(1, &whiteTexture);
+  auto whiteTextureObject = GLTexture::generate();
+  auto whiteTexture = whiteTextureObject.glId();
   glBindTexture(GL_TEXTURE_2D, whiteTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, white);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_FLOAT, white);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -89,277 +532,5431 @@ int ViewerApplication::run()
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_REPEAT);
   glBindTexture(GL_TEXTURE_2D, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &whiteTexture);
+
+  // With --texture-arrays, the textures of images and whiteTexture are
+  // replaced by the array textures they are copied in, owned by all of them
+  std::vector<GLuint> arrayTextures;
+  std::vector<GLint> imageLayers(model.images.size(), 0);
+  GLint whiteLayer = 0;
+  if (textureArrays) {
+    auto textures = imageTextures.release();
+    textures.push_back(whiteTextureObject.release());
+    const auto layers = packTextureArrays(textures, arrayTextures);
+    std::vector<GLuint> imageArrayTextures(model.images.size(), 0);
+    for (size_t i = 0; i < imageArrayTextures.size(); ++i) {
+      imageArrayTextures[i] = layers[i].arrayTexture;
+      imageLayers[i] = layers[i].layer;
+    }
+    imageTextures = GLTextures{std::move(imageArrayTextures)};
+    whiteTexture = layers.back().arrayTexture;
+    whiteLayer = layers.back().layer;
+    whiteTextureObject.reset(whiteTexture);
+  }
+  const auto textureTarget =
+      textureArrays ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+  // Materials and primitives of the model as plain arrays, what the frames
+  // read instead of the model. With --gpu-bounds, the boxes of primitives
+  // lacking min/max are reduced from their vertex buffers once uploaded.
+  const auto gpuBounds = m_options.gpuBounds && !lazyGeometry;
+  const auto runtimeScene =
+      buildRuntimeScene(model, bufferBytes, !gpuBounds);
+  const auto materialCount = runtimeScene.materials.size() - 1;
+  // Texture indices of a material, all -1 for the default one. The images
+  // and sampler of each texture are read once from the model too.
+  const auto getMaterialTextures = [&](int materialIdx) -> const auto & {
+    return runtimeScene.material(materialIdx).textures;
+  };
+  // KHR_texture_basisu image then source image of each texture
+  std::vector<std::array<int, 2>> textureSources(model.textures.size());
+  std::vector<int> textureSamplers(model.textures.size());
+  for (size_t i = 0; i < model.textures.size(); ++i) {
+    const auto &texture = model.textures[i];
+    textureSources[i] = {getBasisuImageSource(texture), texture.source};
+    textureSamplers[i] = texture.sampler;
+  }
+  // Image sampled by a texture: its KHR_texture_basisu image if its texture
+  // object is created, else its source image if created, -1 if neither is
+  const auto getTextureImage = [&](int textureIdx) {
+    if (textureIdx >= 0) {
+      for (const auto source : textureSources[textureIdx]) {
+        if (source >= 0 && imageTextures[source]) {
+          return source;
+        }
+      }
+    }
+    return -1;
+  };
+  // Texture of a material, or whiteTexture if it has none or it is not
+  // created yet: glTF multiplies factors by textures
+  const auto getMaterialTexture = [&](int textureIdx) {
+    const auto imageIdx = getTextureImage(textureIdx);
+    return imageIdx >= 0 ? imageTextures[imageIdx] : whiteTexture;
+  };
+  // Its layer with --texture-arrays
+  const auto getMaterialLayer = [&](int textureIdx) {
+    const auto imageIdx = getTextureImage(textureIdx);
+    return imageIdx >= 0 ? imageLayers[imageIdx] : whiteLayer;
+  };
+  // Textures are sampled with the sampler object of their glTF sampler,
+  // whiteTexture with the default one
+  const auto samplerObjects = createSamplerObjects(model);
+  const auto getMaterialSampler = [&](int textureIdx) {
+    const auto sampler = getMaterialTexture(textureIdx) != whiteTexture
+                             ? textureSamplers[textureIdx]
+                             : -1;
+    return sampler >= 0 ? samplerObjects[sampler] : samplerObjects.back();
+  };
 
   // Creation of Buffer Objects
-  auto bufferObjects = createBufferObjects(model);
+  std::vector<BufferViewRange> bufferViewRanges;
+  LoadPhaseTimer bufferPhase(phases, "createBufferObjects");
+  GLBufferRanges bufferObjects;
+  if (uploadedScene) {
+    bufferObjects = std::move(uploadedScene->bufferObjects);
+    bufferViewRanges = std::move(uploadedScene->bufferViewRanges);
+  } else {
+    bufferObjects = createBufferObjects(
+        model, bufferBytes, bufferViewRanges, !lazyGeometry);
+  }
+  endUploadPhase(bufferPhase);
+  // What the previous scene left and this one does not reuse
+  m_resourcePool.clear();
+  m_bufferHeap->trim();
 
   // Creation of Vertex Array Objects
   std::vector<VaoRange> meshToVA;
-  auto vertexArrayObjects = createVertexArrayObjects(model, bufferObjects, meshToVA);
+  LoadPhaseTimer vertexArrayPhase(phases, "createVertexArrayObjects");
+  auto vertexArrayObjects = createVertexArrayObjects(model, bufferViewRanges, meshToVA);
+  endUploadPhase(vertexArrayPhase);
 
-  // Scene bounding box
-  glm::vec3 bboxMin, bboxMax;
-  computeSceneBounds(model, bboxMin, bboxMax);
+  // Factors of all materials in one shader storage buffer, indexed by the
+  // uMaterialIndex of each draw. The last entry is the default material.
+  const auto getMaterialData = [](const RuntimeMaterial &material) {
+    MaterialData data;
+    data.baseColorFactor = material.baseColorFactor;
+    data.emissiveFactor = material.emissiveFactor;
+    data.metallicFactor = material.metallicFactor;
+    data.roughnessFactor = material.roughnessFactor;
+    data.occlusionStrength = material.occlusionStrength;
+    data.normalScale = material.normalScale;
+    data.alphaCutoff = material.alphaCutoff;
+    std::copy(begin(material.uvTransforms), end(material.uvTransforms),
+        data.uvTransforms);
+    data.transmissionFactor = material.transmissionFactor;
+    return data;
+  };
+  std::vector<MaterialData> materialTable(runtimeScene.materials.size());
+  for (size_t i = 0; i < materialCount; ++i) {
+    materialTable[i] = getMaterialData(runtimeScene.materials[i]);
+  }
+  const auto defaultMaterialIndex = GLint(materialCount);
 
-  // Build projection matrix
-  // Using scene bounds
-  const auto diagonal = bboxMax - bboxMin;
-  auto maxDist = glm::length(diagonal);
-  const auto projMatrix =
-      glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight,
-          0.001f * maxDist, 1.5f * maxDist);
+  // With bindless textures, the table also holds resident handles of the
+  // textures of materials, of each texture and sampler object pair. With
+  // --texture-arrays, it holds their layers.
+  std::map<std::pair<GLuint, GLuint>, GLuint64> residentHandles;
+  const auto getResidentHandle = [&](int textureIdx) {
+    const auto textureSampler = std::make_pair(
+        getMaterialTexture(textureIdx), getMaterialSampler(textureIdx));
+    auto &handle = residentHandles[textureSampler];
+    if (!handle) {
+      handle = bindless.getTextureSamplerHandle(
+          textureSampler.first, textureSampler.second);
+      bindless.makeTextureHandleResident(handle);
+    }
+    return handle;
+  };
+  const auto getTableTexture = [&](int textureIdx) {
+    return useBindlessTextures ? getResidentHandle(textureIdx)
+                               : GLuint64(getMaterialLayer(textureIdx));
+  };
+  const auto updateMaterialTextureHandles = [&]() {
+    for (size_t i = 0; i < materialTable.size(); ++i) {
+      const auto &textures = runtimeScene.materials[i].textures;
+      auto &data = materialTable[i];
+      data.baseColorTexture = getTableTexture(textures[0]);
+      data.metallicRoughnessTexture = getTableTexture(textures[1]);
+      data.emissiveTexture = getTableTexture(textures[2]);
+      data.occlusionTexture = getTableTexture(textures[3]);
+      data.normalTexture = getTableTexture(textures[4]);
+    }
+  };
+  if (useBindlessTextures || textureArrays) {
+    updateMaterialTextureHandles();
+  }
 
-  // Implement a new CameraController model and use it instead. Propose the
-  // choice from the GUI
-  std::unique_ptr<CameraController> cameraController = 
-    std::make_unique<TrackballCameraController>(
-      m_GLFWHandle.window(), 0.5f * maxDist);
-  if (m_hasUserCamera) {
-    cameraController->setCamera(m_userCamera);
+  const auto materialsIndex = glGetProgramResourceIndex(
+      glslProgram.glId(), GL_SHADER_STORAGE_BLOCK, "Materials");
+  if (materialsIndex != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(
+        glslProgram.glId(), materialsIndex, MATERIALS_BINDING);
+  }
+  const auto materialBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      materialTable.size() * sizeof(MaterialData), materialTable.data(),
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, MATERIALS_BINDING, materialBuffer.glId());
+
+  // Nodes of the scene to draw, flattened once per scene of the model
+  const auto drawnSceneIdx =
+      m_drawnSceneIdx >= 0 ? m_drawnSceneIdx : model.defaultScene;
+  auto flatSceneIt = m_flatScenes.find(drawnSceneIdx);
+  if (flatSceneIt == end(m_flatScenes)) {
+    flatSceneIt = m_flatScenes
+                      .emplace(drawnSceneIdx,
+                          flattenScene(model, drawnSceneIdx, bufferBytes))
+                      .first;
+  }
+  auto flatScene = flatSceneIt->second;
+
+  // Joint matrices of the skins, read by the vertex shader from the Joints
+  // table. Recomputed with the world matrices of moved nodes.
+  std::unique_ptr<JointPalette> jointPalette;
+  GLBuffer jointBuffer;
+  if (!model.skins.empty()) {
+    jointPalette =
+        std::make_unique<JointPalette>(model, flatScene, bufferBytes);
+    jointBuffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, jointBuffer.glId());
+    const auto &matrices = jointPalette->matrices();
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        std::max(matrices.size(), size_t(1)) * sizeof(glm::mat4),
+        matrices.empty() ? nullptr : matrices.data(), GL_DYNAMIC_STORAGE_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, JOINTS_BINDING, jointBuffer.glId());
+  }
+  // First joint of the skin of each entry of flatScene, -1 if not skinned
+  std::vector<GLint> nodeFirstJoints(flatScene.nodes.size(), -1);
+  for (size_t i = 0; jointPalette && i < flatScene.nodes.size(); ++i) {
+    const auto skin = model.nodes[flatScene.nodes[i]].skin;
+    if (skin >= 0) {
+      nodeFirstJoints[i] = GLint(jointPalette->getFirstJoint(skin));
+    }
+  }
+  const auto getFirstJoint = [&](size_t nodeIdx) {
+    return nodeFirstJoints[nodeIdx];
+  };
+
+  // KHR_lights_punctual lights, binned once per drawn view
+  std::unique_ptr<LightClusters> lightClusters;
+  if (hasPunctualLights) {
+    lightClusters = std::make_unique<LightClusters>(model, flatScene,
+        programCache.compileProgram(
+            {m_ShadersRootPath / "light_clusters.cs.glsl"}));
+  }
+  auto punctualLights = true;
+
+  // Keyframes of the animations, read before --release-cpu-data frees the
+  // buffers. Only played by the viewer, images are rendered in the rest pose
+  std::unique_ptr<AnimationPlayer> animationPlayer;
+  if (!model.animations.empty()) {
+    animationPlayer =
+        std::make_unique<AnimationPlayer>(model, flatScene, bufferBytes);
+  }
+  AnimationPlayback animationPlayback(m_OutputPath.empty());
+
+  // World space bounds of the primitives of each node, tested against the
+  // view frustum to skip the draws of invisible primitives. Primitives of
+  // node i start at primitiveBounds[firstPrimitiveBounds[i]].
+  std::vector<BoundingBox> localPrimitiveBounds; // Like vertexArrayObjects
+  for (const auto &primitive : runtimeScene.primitives) {
+    localPrimitiveBounds.push_back(primitive.bounds);
+  }
+  std::unique_ptr<GpuReduction> gpuReduction;
+  if (gpuBounds) {
+    gpuReduction = std::make_unique<GpuReduction>(programCache.compileProgram(
+        {m_ShadersRootPath / "reduce_bounds.cs.glsl"}));
+    // Float positions of dense accessors, the others are read by the CPU
+    std::vector<size_t> reducedPrimitives;
+    std::vector<GpuReduction::PositionRange> positionRanges;
+    for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+      const auto &primitives = model.meshes[meshIdx].primitives;
+      for (size_t i = 0; i < primitives.size(); ++i) {
+        const auto primitiveIdx = size_t(meshToVA[meshIdx].begin) + i;
+        const auto position = primitives[i].attributes.find("POSITION");
+        if (!localPrimitiveBounds[primitiveIdx].isEmpty() ||
+            position == end(primitives[i].attributes)) {
+          continue;
+        }
+        const auto &accessor = model.accessors[position->second];
+        if (accessor.type != TINYGLTF_TYPE_VEC3) {
+          continue;
+        }
+        if (accessor.bufferView >= 0 && !accessor.sparse.isSparse &&
+            accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+          const auto &bufferView = model.bufferViews[accessor.bufferView];
+          const auto &range = bufferViewRanges[accessor.bufferView];
+          const auto byteOffset = size_t(range.byteOffset) +
+                                  accessor.byteOffset;
+          const auto byteStride =
+              bufferView.byteStride ? bufferView.byteStride : size_t(12);
+          if (range.bufferObject &&
+              GpuReduction::isAligned(byteOffset, byteStride)) {
+            reducedPrimitives.push_back(primitiveIdx);
+            positionRanges.push_back({range.bufferObject,
+                GLintptr(byteOffset), GLsizei(byteStride), accessor.count});
+            continue;
+          }
+        }
+        localPrimitiveBounds[primitiveIdx] =
+            getPrimitiveBounds(model, primitives[i], bufferBytes);
+      }
+    }
+    const auto reducedBounds = gpuReduction->reduceBounds(positionRanges);
+    for (size_t i = 0; i < reducedPrimitives.size(); ++i) {
+      localPrimitiveBounds[reducedPrimitives[i]] = reducedBounds[i];
+    }
+  }
+  // Of each draw, local bounds of vertices morphed by the skinning pre-pass
+  // instead, if not empty
+  std::vector<BoundingBox> morphedBounds;
+  // With --gpu-bounds, world bounds of the vertices of skinned draws of the
+  // pre-pass instead, if not empty
+  std::vector<BoundingBox> skinnedBounds;
+  std::vector<BoundingBox> primitiveBounds;
+  std::vector<size_t> firstPrimitiveBounds(flatScene.size());
+  const auto updatePrimitiveBounds = [&]() {
+    primitiveBounds.clear();
+    for (size_t nodeIdx = 0; nodeIdx < flatScene.size(); ++nodeIdx) {
+      firstPrimitiveBounds[nodeIdx] = primitiveBounds.size();
+      const auto meshIdx = flatScene.meshes[nodeIdx];
+      if (meshIdx < 0) {
+        continue;
+      }
+      const auto &vaoRange = meshToVA[meshIdx];
+      const auto skin = runtimeScene.nodeSkins[flatScene.nodes[nodeIdx]];
+      for (GLsizei prIdx = 0; prIdx < vaoRange.count; ++prIdx) {
+        const auto drawIdx = primitiveBounds.size();
+        if (!skinnedBounds.empty() && !skinnedBounds[drawIdx].isEmpty()) {
+          primitiveBounds.push_back(skinnedBounds[drawIdx]);
+          continue;
+        }
+        const auto &bounds = !morphedBounds.empty() &&
+                                     !morphedBounds[drawIdx].isEmpty()
+                                 ? morphedBounds[drawIdx]
+                                 : localPrimitiveBounds[vaoRange.begin + prIdx];
+        primitiveBounds.emplace_back(
+            skin >= 0 && jointPalette
+                ? jointPalette->getSkinnedBounds(bounds, skin)
+                : transformBoundingBox(
+                      bounds, flatScene.worldMatrices[nodeIdx]));
+      }
+    }
+  };
+  updatePrimitiveBounds();
+
+  // Draws of the scene, indexed like primitiveBounds, and the order in which
+  // they are submitted to minimize state changes
+  std::vector<DrawCommand> drawCommands;
+  for (size_t nodeIdx = 0; nodeIdx < flatScene.size(); ++nodeIdx) {
+    const auto meshIdx = flatScene.meshes[nodeIdx];
+    if (meshIdx < 0) {
+      continue;
+    }
+    const auto &vaoRange = meshToVA[meshIdx];
+    for (GLsizei prIdx = 0; prIdx < vaoRange.count; ++prIdx) {
+      const auto &primitive =
+          runtimeScene.primitives[size_t(vaoRange.begin + prIdx)];
+      DrawCommand command;
+      command.node = int(nodeIdx);
+      command.material = primitive.material;
+      command.vertexArray = vertexArrayObjects[vaoRange.begin + prIdx];
+      command.primitive = vaoRange.begin + prIdx;
+      command.mode = primitive.mode;
+      command.count = GLsizei(primitive.count);
+      command.indexType = primitive.indexType;
+      command.indexByteOffset =
+          primitive.indexType
+              ? primitive.indexByteOffset +
+                    bufferViewRanges[primitive.indexBufferView].byteOffset
+              : 0;
+      command.minIndex = primitive.minIndex;
+      command.maxIndex = primitive.maxIndex;
+      drawCommands.push_back(command);
+    }
+  }
+
+  // With --compute-skinning, skinned and morphed draws are drawn from the
+  // vertices of the pre-pass, each from a vertex array of its own. Vertices
+  // of skinned nodes are in world space: the vertex shader applies no matrix
+  // to them, so all the primitives of a node must go through the pre-pass.
+  std::unique_ptr<SkinningPrepass> skinningPrepass;
+  GLVertexArrays preSkinnedVertexArrays;
+  std::vector<uint8_t> preSkinnedNodes(flatScene.size(), 0);
+  // Draws of skinned nodes, and their index in the pre-pass
+  std::vector<std::pair<size_t, int>> skinnedPrepassDraws;
+  if (m_options.computeSkinning &&
+      (m_options.multiDrawIndirect || m_options.sharedBuffers)) {
+    std::cerr << "Warning : compute skinning disabled, not with shared "
+                 "buffers"
+              << std::endl;
+  } else if (m_options.computeSkinning) {
+    skinningPrepass = std::make_unique<SkinningPrepass>(
+        programCache.compileProgram(
+            {m_ShadersRootPath / "skin_vertices.cs.glsl"}),
+        GLuint(JOINTS_BINDING));
+    // Of each primitive, its index in the pre-pass, -1 if it cannot be read
+    std::vector<int> prepassPrimitives(vertexArrayObjects.size(), -2);
+    std::vector<uint8_t> isNodeReadable(flatScene.size(), 1);
+    const auto getPrimitive = [&](const DrawCommand &command) {
+      const auto meshIdx = flatScene.meshes[command.node];
+      return &model.meshes[meshIdx]
+                  .primitives[command.primitive - meshToVA[meshIdx].begin];
+    };
+    for (const auto &command : drawCommands) {
+      const auto &primitive = *getPrimitive(command);
+      if (getFirstJoint(size_t(command.node)) < 0 &&
+          primitive.targets.empty()) {
+        continue;
+      }
+      auto &prepassPrimitive = prepassPrimitives[command.primitive];
+      if (prepassPrimitive == -2) {
+        prepassPrimitive =
+            skinningPrepass->addPrimitive(model, bufferBytes, primitive);
+      }
+      if (prepassPrimitive < 0) {
+        isNodeReadable[command.node] = 0;
+      }
+    }
+
+    std::vector<std::pair<size_t, int>> prepassDraws; // Draw, in the pre-pass
+    for (size_t drawIdx = 0; drawIdx < drawCommands.size(); ++drawIdx) {
+      const auto &command = drawCommands[drawIdx];
+      const auto prepassPrimitive = prepassPrimitives[command.primitive];
+      const auto firstJoint = getFirstJoint(size_t(command.node));
+      if (prepassPrimitive < 0 ||
+          (firstJoint >= 0 && !isNodeReadable[command.node])) {
+        continue;
+      }
+      const auto &node = model.nodes[flatScene.nodes[command.node]];
+      const auto &weights = !node.weights.empty()
+                                ? node.weights
+                                : model.meshes[node.mesh].weights;
+      const auto prepassDraw =
+          skinningPrepass->addDraw(prepassPrimitive, firstJoint, weights);
+      if (prepassDraw >= 0) {
+        prepassDraws.emplace_back(drawIdx, prepassDraw);
+        preSkinnedNodes[command.node] = firstJoint >= 0;
+        if (firstJoint >= 0) {
+          skinnedPrepassDraws.emplace_back(drawIdx, prepassDraw);
+        }
+      }
+    }
+
+    if (prepassDraws.empty()) {
+      skinningPrepass.reset();
+    } else {
+      skinningPrepass->createBuffers();
+      morphedBounds.resize(drawCommands.size());
+      preSkinnedVertexArrays = GLVertexArrays::generate(prepassDraws.size());
+      for (size_t i = 0; i < prepassDraws.size(); ++i) {
+        auto &command = drawCommands[prepassDraws[i].first];
+        const auto prepassDraw = prepassDraws[i].second;
+        morphedBounds[prepassDraws[i].first] =
+            skinningPrepass->getMorphedBounds(prepassDraw);
+        // Same indices as the vertex array of the primitive
+        glBindVertexArray(command.vertexArray);
+        GLint elementBuffer = 0;
+        glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+        command.vertexArray = preSkinnedVertexArrays[i];
+        glBindVertexArray(command.vertexArray);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, GLuint(elementBuffer));
+        glBindBuffer(GL_ARRAY_BUFFER, skinningPrepass->vertexBuffer());
+        const auto byteOffset =
+            skinningPrepass->getVertexByteOffset(prepassDraw);
+        using OutputVertex = SkinningPrepass::OutputVertex;
+        for (const auto &attribute :
+            {std::make_tuple(VERTEX_ATTRIB_POSITION_IDX, 3,
+                 offsetof(PackedVertex, position)),
+                std::make_tuple(VERTEX_ATTRIB_NORMAL_IDX, 3,
+                    offsetof(PackedVertex, normal)),
+                std::make_tuple(VERTEX_ATTRIB_TEXCOORD0_IDX, 2,
+                    offsetof(PackedVertex, texCoords)),
+                std::make_tuple(VERTEX_ATTRIB_TANGENT_IDX, 4,
+                    offsetof(OutputVertex, tangent))}) {
+          glEnableVertexAttribArray(std::get<0>(attribute));
+          glVertexAttribPointer(std::get<0>(attribute), std::get<1>(attribute),
+              GL_FLOAT, GL_FALSE, sizeof(OutputVertex),
+              (const GLvoid *)(byteOffset + std::get<2>(attribute)));
+        }
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      skinningPrepass->run();
+    }
+  }
+  // Once the pre-pass ran, with --gpu-bounds
+  const auto reduceSkinnedBounds = [&]() {
+    if (!gpuReduction || skinnedPrepassDraws.empty()) {
+      return;
+    }
+    std::vector<GpuReduction::PositionRange> positionRanges;
+    for (const auto &draw : skinnedPrepassDraws) {
+      positionRanges.push_back({skinningPrepass->vertexBuffer(),
+          skinningPrepass->getVertexByteOffset(draw.second),
+          GLsizei(sizeof(SkinningPrepass::OutputVertex)),
+          skinningPrepass->getVertexCount(draw.second)});
+    }
+    const auto bounds = gpuReduction->reduceBounds(positionRanges);
+    skinnedBounds.resize(drawCommands.size());
+    for (size_t i = 0; i < skinnedPrepassDraws.size(); ++i) {
+      skinnedBounds[skinnedPrepassDraws[i].first] = bounds[i];
+    }
+  };
+  if (skinningPrepass) {
+    reduceSkinnedBounds();
+    updatePrimitiveBounds();
+  }
+  // With --camera-relative, world matrices given to the shaders are relative
+  // to renderOrigin, and so is the view matrix of FrameUniforms
+  auto cameraRelative = m_options.cameraRelative;
+  auto renderOrigin = glm::dvec3(0);
+  // Matrices and joints the vertex shader applies to the vertices of a node,
+  // none to those already in world space
+  const auto getDrawUniforms = [&](size_t nodeIdx) {
+    if (preSkinnedNodes[nodeIdx]) {
+      return DrawUniforms{glm::mat4(1), glm::mat4(1), -1, {}, glm::mat4(1)};
+    }
+    if (cameraRelative) {
+      const auto modelMatrix =
+          getRelativeMatrix(flatScene.worldMatrices[nodeIdx],
+              flatScene.worldTranslations[nodeIdx], renderOrigin);
+      return DrawUniforms{modelMatrix, flatScene.normalMatrices[nodeIdx],
+          getFirstJoint(nodeIdx), {},
+          flatScene.previousWorldMatrices.empty()
+              ? modelMatrix
+              : getRelativeMatrix(flatScene.previousWorldMatrices[nodeIdx],
+                    flatScene.previousWorldTranslations[nodeIdx],
+                    renderOrigin)};
+    }
+    return DrawUniforms{flatScene.worldMatrices[nodeIdx],
+        flatScene.normalMatrices[nodeIdx], getFirstJoint(nodeIdx), {},
+        flatScene.previousWorldMatrices.empty()
+            ? flatScene.worldMatrices[nodeIdx]
+            : flatScene.previousWorldMatrices[nodeIdx]};
+  };
+
+  auto drawOrder = getDrawOrder(drawCommands);
+  // With --texture-arrays, materials binding the same textures and samplers
+  // are drawn together, from the draw groups of the first of them
+  std::vector<int> textureSetMaterials(materialCount + 1, -1);
+  if (textureArrays) {
+    std::map<std::array<GLuint, 2 * MATERIAL_TEXTURE_COUNT>, int>
+        setMaterials;
+    for (auto materialIdx = -1; materialIdx < int(materialCount);
+         ++materialIdx) {
+      const auto &textureIndices = getMaterialTextures(materialIdx);
+      std::array<GLuint, 2 * MATERIAL_TEXTURE_COUNT> bindings;
+      for (size_t unit = 0; unit < MATERIAL_TEXTURE_COUNT; ++unit) {
+        bindings[2 * unit] = getMaterialTexture(textureIndices[unit]);
+        bindings[2 * unit + 1] = getMaterialSampler(textureIndices[unit]);
+      }
+      textureSetMaterials[size_t(materialIdx + 1)] =
+          setMaterials.emplace(bindings, materialIdx).first->second;
+    }
   } else {
-    // Using scene bounds to compute a better default camera
-    const auto center = 0.5f * (bboxMax + bboxMin);
-    const auto up = glm::vec3(0 , 1 , 0);
-    const auto eye = diagonal.z > 0.f ? center + diagonal : center + 2.f * glm::cross(diagonal, up);
-    cameraController->setCamera(Camera(eye, center, up));
+    std::iota(begin(textureSetMaterials), end(textureSetMaterials), -1);
+  }
+  const auto getTextureSetMaterial = [&](int materialIdx) {
+    return textureSetMaterials[size_t(materialIdx + 1)];
+  };
+  const auto sortDrawOrderByTextureSet = [&]() {
+    std::stable_sort(begin(drawOrder), end(drawOrder), [&](size_t a, size_t b) {
+      return getTextureSetMaterial(drawCommands[a].material) <
+             getTextureSetMaterial(drawCommands[b].material);
+    });
+  };
+  if (textureArrays) {
+    sortDrawOrderByTextureSet();
   }
 
-  // Setup OpenGL state for rendering
-  glEnable(GL_DEPTH_TEST);
-  glslProgram.use();
+  // Blocks of a frame: its FrameUniforms, then at most one DrawUniforms per
+  // draw, and per draw of the depth pre-pass. Each shadow cascade has its
+  // FrameUniforms and DrawUniforms, the ones of the camera are bound again.
+  const auto shadowBlockCount =
+      m_options.shadowMaps
+          ? ShadowCascades::CASCADE_COUNT * (1 + drawCommands.size()) + 1
+          : 0;
+  UniformRing uniformRing(std::max(sizeof(FrameUniforms), sizeof(DrawUniforms)),
+      1 + (m_options.depthPrepass ? 2 : 1) * drawCommands.size() +
+          shadowBlockCount);
 
-  const auto bindMaterial = [&](const auto materialIndex) {
-    if (materialIndex >= 0) {
-      const auto &material = model.materials[materialIndex];
-      const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
-      if (uBaseColorFactor >= 0) {
-        glUniform4f(uBaseColorFactor,
-            (float)pbrMetallicRoughness.baseColorFactor[0],
-            (float)pbrMetallicRoughness.baseColorFactor[1],
-            (float)pbrMetallicRoughness.baseColorFactor[2],
-            (float)pbrMetallicRoughness.baseColorFactor[3]);
+  // Hierarchy over primitiveBounds, so that culling and picking do not test
+  // every primitive. Refitted when nodes move.
+  // Entries whose bounds follow their joints, not only their own matrix
+  std::vector<int> skinnedEntries;
+  for (size_t i = 0; i < flatScene.size(); ++i) {
+    if (nodeFirstJoints[i] >= 0) {
+      skinnedEntries.push_back(int(i));
+    }
+  }
+  updateSubtreeBounds(flatScene, primitiveBounds, firstPrimitiveBounds);
+  auto primitiveBvh = buildBvh(primitiveBounds);
+  // With --coherent-culling, culls the draws of the frames instead of
+  // cullBvh, reset when draws move
+  CoherentCuller coherentCuller;
+#ifndef GLTF_VIEWER_HEADLESS
+  // Ray queries against the triangles of the draws in primitiveBvh, whose
+  // triangle hierarchies are built by the first query reaching them
+  const RayQueries rayQueries(model, bufferBytes);
+  // The draws of RayQueries, skinned ones are hit on their box
+  const auto getRayQueryItems = [&]() {
+    std::vector<RayQueryItem> items(drawCommands.size());
+    for (size_t i = 0; i < drawCommands.size(); ++i) {
+      const auto nodeIdx = size_t(drawCommands[i].node);
+      if (nodeFirstJoints[nodeIdx] < 0) {
+        items[i].primitive = drawCommands[i].primitive;
+        items[i].matrix = flatScene.worldMatrices[nodeIdx];
       }
-      
-      //Set Material to white
-      if (uBaseColorTexture >= 0) {
-        if (uBaseColorFactor >= 0) {
-          glUniform4f(uBaseColorFactor, 1, 1, 1, 1);
+    }
+    return items;
+  };
+#endif
+  std::vector<uint8_t> visiblePrimitives;
+  bool frustumCulling = true;
+  size_t drawnPrimitiveCount = 0;
+  size_t culledPrimitiveCount = 0;
+  // BVH nodes tested and reused by coherentCuller
+  size_t testedCullNodeCount = 0;
+  size_t reusedCullNodeCount = 0;
+  size_t instancedDrawCount = 0; // Draws left once instances are merged
+  // Calls and state changes of the current frame or output view, each drawScene
+  // adds to them
+  DrawStats drawStats;
+
+  // Handles of the textures of materials with bindless textures, once
+  // textures are created or replaced
+  const auto uploadMaterialTextureHandles = [&]() {
+    updateMaterialTextureHandles();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer.glId());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+        materialTable.size() * sizeof(MaterialData), materialTable.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    drawStats.uploadedBufferBytes +=
+        materialTable.size() * sizeof(MaterialData);
+  };
+
+  // With --lazy-resources, the bufferViews read by each primitive (like
+  // vertexArrayObjects), uploaded the first time one of its draws is visible
+  std::vector<std::vector<size_t>> primitiveBufferViews;
+  std::vector<uint8_t> uploadedPrimitives;
+  std::vector<uint8_t> uploadedBufferViews(model.bufferViews.size(), 0);
+  if (lazyGeometry) {
+    for (const auto &mesh : model.meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        std::vector<size_t> bufferViews;
+        for (const auto &attribute : primitive.attributes) {
+          bufferViews.push_back(
+              size_t(model.accessors[attribute.second].bufferView));
+        }
+        if (primitive.indices >= 0) {
+          bufferViews.push_back(
+              size_t(model.accessors[primitive.indices].bufferView));
+        }
+        primitiveBufferViews.push_back(std::move(bufferViews));
+      }
+    }
+    uploadedPrimitives.assign(primitiveBufferViews.size(), 0);
+  }
+  // Images whose texture creation was attempted, created or not
+  std::vector<uint8_t> attemptedImages(model.images.size(), !lazyTextures);
+  size_t lazyPrimitiveCount = 0;
+  size_t lazyImageCount = 0;
+  // Create the textures of a material not attempted yet. Returns true if
+  // textures were created.
+  const auto createMaterialTextures = [&](int materialIdx) {
+    auto createdTextures = false;
+    const auto createImageTexture = [&](int imageIdx) {
+      if (imageIdx < 0 || attemptedImages[imageIdx]) {
+        return;
+      }
+      attemptedImages[imageIdx] = 1;
+      // Counted once transferred if queued
+      if (progressiveTextures.createTexture(imageIdx, textureUploader)) {
+        createdTextures = true;
+        ++lazyImageCount;
+      }
+    };
+    // Like createTextureObjects, the source of a texture is only created if
+    // its KHR_texture_basisu image cannot be
+    for (const auto textureIdx : getMaterialTextures(materialIdx)) {
+      if (textureIdx >= 0) {
+        const auto basisuSource = textureSources[textureIdx][0];
+        createImageTexture(basisuSource);
+        if (basisuSource < 0 || !imageTextures[basisuSource]) {
+          createImageTexture(textureSources[textureIdx][1]);
+        }
+      }
+    }
+    return createdTextures;
+  };
+  // Upload the geometry of the draws flagged in visibleDraws (all if null),
+  // and with textures create the textures of their materials. Returns true if
+  // textures were created.
+  const auto createVisibleResources =
+      [&](const std::vector<uint8_t> *visibleDraws, bool textures) {
+    auto createdTextures = false;
+    for (size_t drawIdx = 0; drawIdx < drawCommands.size(); ++drawIdx) {
+      if (visibleDraws && !(*visibleDraws)[drawIdx]) {
+        continue;
+      }
+      const auto &command = drawCommands[drawIdx];
+      const auto primitiveIdx = size_t(command.primitive);
+      if (lazyGeometry && !uploadedPrimitives[primitiveIdx]) {
+        uploadedPrimitives[primitiveIdx] = 1;
+        ++lazyPrimitiveCount;
+        for (const auto bufferViewIdx : primitiveBufferViews[primitiveIdx]) {
+          if (!uploadedBufferViews[bufferViewIdx]) {
+            uploadedBufferViews[bufferViewIdx] = 1;
+            uploadBufferView(model, bufferBytes,
+                bufferViewRanges[bufferViewIdx], bufferViewIdx);
+            drawStats.uploadedBufferBytes +=
+                model.bufferViews[bufferViewIdx].byteLength;
+          }
+        }
+      }
+      if (lazyTextures && textures && command.material >= 0) {
+        createdTextures =
+            createMaterialTextures(command.material) || createdTextures;
+      }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return createdTextures;
+  };
+
+  // MSFT_lod group and level of the node of each draw, the group is -1
+  // outside of groups. lodVisibleDraws flags the draws of selected levels.
+  std::vector<std::pair<int, int>> nodeLods(flatScene.size(), {-1, 0});
+  for (size_t groupIdx = 0; groupIdx < flatScene.lodGroups.size();
+       ++groupIdx) {
+    const auto &levels = flatScene.lodGroups[groupIdx].levels;
+    for (size_t level = 0; level < levels.size(); ++level) {
+      for (auto nodeIdx = levels[level];
+           nodeIdx < flatScene.subtreeEnds[levels[level]]; ++nodeIdx) {
+        nodeLods[nodeIdx] = {int(groupIdx), int(level)};
+      }
+    }
+  }
+  std::vector<std::pair<int, int>> drawLods;
+  for (const auto &command : drawCommands) {
+    drawLods.push_back(nodeLods[command.node]);
+  }
+  std::vector<uint8_t> lodVisibleDraws(drawCommands.size(), 1);
+  std::vector<int> selectedLodLevels(flatScene.lodGroups.size(), 0);
+  const auto updateLodVisibleDraws = [&]() {
+    for (size_t i = 0; i < drawCommands.size(); ++i) {
+      lodVisibleDraws[i] = drawLods[i].first < 0 ||
+                           drawLods[i].second ==
+                               selectedLodLevels[drawLods[i].first];
+    }
+  };
+  updateLodVisibleDraws();
+  // Nodes hidden from the scene panel of the GUI and the visibility of
+  // their draws, culled like those of unselected levels, and by the culling
+  // shader with --gpu-culling
+  DrawVisibility drawVisibility(
+      flatScene, firstPrimitiveBounds, drawCommands.size());
+  // Select the level of each group from the screen coverage of the bounding
+  // sphere of its first level: the area of the square around its projection
+  // over the area of the screen. Output images smaller than the screens of
+  // the coverages count as smaller areas of them with fitOutputDetail.
+  const auto lodCoverageScale =
+      m_options.fitOutputDetail && !m_OutputPath.empty()
+          ? std::min(1.f, glm::pow(float(m_nWindowHeight) /
+                                       float(LOD_REFERENCE_HEIGHT),
+                              2.f))
+          : 1.f;
+  const auto selectLodLevels = [&](const glm::mat4 &viewMatrix,
+                                   const glm::mat4 &projMatrix) {
+    for (size_t groupIdx = 0; groupIdx < flatScene.lodGroups.size();
+         ++groupIdx) {
+      const auto &group = flatScene.lodGroups[groupIdx];
+      const auto end = size_t(flatScene.subtreeEnds[group.levels[0]]);
+      const auto firstBounds = firstPrimitiveBounds[group.levels[0]];
+      const auto endBounds = end < flatScene.size() ? firstPrimitiveBounds[end]
+                                                    : primitiveBounds.size();
+      BoundingBox bounds;
+      for (auto i = firstBounds; i < endBounds; ++i) {
+        bounds.extend(primitiveBounds[i]);
+      }
+      auto coverage = 0.f;
+      if (!bounds.isEmpty()) {
+        const auto center =
+            glm::vec3(viewMatrix * glm::vec4(0.5f * (bounds.min + bounds.max), 1));
+        const auto radius = 0.5f * glm::length(bounds.max - bounds.min);
+        const auto distance = glm::length(center);
+        coverage = distance <= radius
+                       ? 1.f
+                       : std::min(1.f, radius * radius * projMatrix[0][0] *
+                                           projMatrix[1][1] /
+                                           (distance * distance));
+      }
+      selectedLodLevels[groupIdx] =
+          selectLodLevel(group, lodCoverageScale * coverage);
+    }
+    updateLodVisibleDraws();
+  };
+
+
+  // Consecutive draws of drawOrder with the same primitive are merged into
+  // one instanced draw. Its instances read the index of their DrawCommand
+  // from instanceDraws through the aDrawIndex attribute (divisor 1), starting
+  // at the base instance of the draw, and their matrices from the Draws
+  // table. Rewritten every frame with the visible draws.
+  std::vector<GLuint> instanceDraws(drawCommands.size());
+  std::iota(begin(instanceDraws), end(instanceDraws), GLuint(0));
+  const auto instanceDrawBuffer = GLBuffer::generate();
+  glBindBuffer(GL_ARRAY_BUFFER, instanceDrawBuffer.glId());
+  glBufferStorage(GL_ARRAY_BUFFER,
+      std::max(instanceDraws.size(), size_t(1)) * sizeof(GLuint),
+      instanceDraws.data(), GL_DYNAMIC_STORAGE_BIT);
+  for (const auto *vertexArrays :
+      {&vertexArrayObjects, &preSkinnedVertexArrays}) {
+    for (const auto vertexArray : *vertexArrays) {
+      glBindVertexArray(vertexArray);
+      glEnableVertexAttribArray(VERTEX_ATTRIB_DRAW_INDEX_IDX);
+      glVertexAttribIPointer(
+          VERTEX_ATTRIB_DRAW_INDEX_IDX, 1, GL_UNSIGNED_INT, 0, nullptr);
+      glVertexAttribDivisor(VERTEX_ATTRIB_DRAW_INDEX_IDX, 1);
+    }
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  struct InstanceRun
+  {
+    size_t begin; // In instanceDraws
+    size_t end;
+  };
+  std::vector<InstanceRun> instanceRuns; // Without --multi-draw
+  // Of the first cutout and blended runs, see buildFramePacket
+  size_t cutoutRunBegin = 0;
+  size_t blendRunBegin = 0;
+  const auto uploadInstanceDraws = [&]() {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceDrawBuffer.glId());
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instanceDraws.size() * sizeof(GLuint),
+        instanceDraws.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    drawStats.uploadedBufferBytes += instanceDraws.size() * sizeof(GLuint);
+  };
+
+  // With --multi-draw, all primitives are packed in shared buffers drawn
+  // through one vertex array, and all draws read their transform and
+  // material from the Draws table. With --shared-buffers alone, the same
+  // buffers and vertex array are drawn with one base vertex draw per run of
+  // instances instead of a vertex array per primitive.
+  auto multiDraw = m_options.multiDrawIndirect;
+  auto sharedBuffers = m_options.sharedBuffers && !multiDraw;
+  PackedGeometry packedGeometry;
+  if (multiDraw || sharedBuffers) {
+    std::string err;
+    if (!packGeometry(model, bufferBytes, packedGeometry, err)) {
+      std::cerr << "Warning : " << (multiDraw ? "multi-draw" : "shared buffers")
+                << " disabled, " << err << std::endl;
+      multiDraw = false;
+      sharedBuffers = false;
+    } else if (multiDraw) {
+      if (m_options.meshletCulling) {
+        splitIntoMeshlets(model, packedGeometry);
+      }
+      if (m_options.generateLods) {
+        buildLods(model, packedGeometry, 3);
+      }
+    }
+    multiDraw = multiDraw && !packedGeometry.indices.empty();
+    sharedBuffers = sharedBuffers && !packedGeometry.indices.empty();
+  }
+  // Creates the buffers of the scene draws and submits them, with handles
+  // instead of GL names and enums
+  GLRenderDevice renderDevice;
+  GLBuffers packedBuffers; // Vertices, indices
+  GLBuffer packedSkinBuffer; // Of packedGeometry.skinVertices
+  GLBuffer packedTangentBuffer; // Of packedGeometry.tangents
+  GLVertexArray packedVertexArray;
+  GLBuffer drawDataBuffer;
+  GLBuffer indirectBuffer;
+  std::vector<DrawData> drawData(drawCommands.size());
+  std::vector<DrawElementsIndirectCommand> indirectCommands;
+
+  // Levels of detail of --lod, chosen for their error to be at most
+  // lodPixelError pixels on screen
+  auto lodPixelError = 1.f;
+  // With --refine, frames drawn while the view changes, with coarser levels
+  // of detail and without occlusion textures
+  auto isInteractiveFrame = false;
+  auto lodEye = glm::vec3(0); // Of the frame
+  auto lodPixelSizeFactor = 0.f; // Height of a pixel at a distance of 1
+  const auto selectGeneratedLod = [&](size_t drawIdx) {
+    if (packedGeometry.lods.empty()) {
+      return -1;
+    }
+    const auto &command = drawCommands[drawIdx];
+    const auto &lods = packedGeometry.lods[command.primitive];
+    const auto &bounds = primitiveBounds[drawIdx];
+    const auto distance = glm::length(
+        glm::max(glm::max(bounds.min - lodEye, lodEye - bounds.max),
+            glm::vec3(0)));
+    const auto &worldMatrix = flatScene.worldMatrices[command.node];
+    const auto scale = std::max(glm::length(glm::vec3(worldMatrix[0])),
+        std::max(glm::length(glm::vec3(worldMatrix[1])),
+            glm::length(glm::vec3(worldMatrix[2]))));
+    const auto pixelSize = lodPixelSizeFactor * distance;
+    auto level = -1;
+    while (level + 1 < int(lods.size()) &&
+           lods[level + 1].error * scale <=
+               (isInteractiveFrame ? 4.f : 1.f) * lodPixelError * pixelSize) {
+      ++level;
+    }
+    return level;
+  };
+
+  // Draws in drawOrder, submitted in one glMultiDrawElementsIndirect per run
+  // of draws sharing their mode, and their material if textures must be bound
+  struct DrawGroup
+  {
+    GLenum mode;
+    int material;
+    size_t begin; // In indirectCommands
+    size_t end;
+  };
+  std::vector<DrawGroup> drawGroups;
+  // With --meshlets, bounding sphere then normal cone of the meshlet of each
+  // command not instanced, in object space. The radius is -1 for commands
+  // drawing a whole primitive, the cone cutoff 1 for double sided materials.
+  std::vector<glm::vec4> commandMeshlets;
+  // Fill indirectCommands and drawGroups with the draws whose visible flag is
+  // set, or with all draws if visible is null. If instanced, levels of detail
+  // of --lod are selected, instances are merged and instanceDraws is
+  // rewritten, otherwise the base instance of a command is the index of its
+  // DrawCommand and draws are split in their meshlets.
+  const auto buildIndirectCommands = [&](const uint8_t *visible,
+                                         bool instanced) {
+    indirectCommands.clear();
+    drawGroups.clear();
+    commandMeshlets.clear();
+    if (instanced) {
+      instanceDraws.clear();
+    }
+    auto lastPrimitive = -1;
+    auto lastLod = -1;
+    for (const auto drawIdx : drawOrder) {
+      if (visible && !visible[drawIdx]) {
+        ++culledPrimitiveCount;
+        continue;
+      }
+      ++drawnPrimitiveCount;
+      const auto &command = drawCommands[drawIdx];
+      const auto &range = packedGeometry.ranges[command.primitive];
+      const auto lod = instanced ? selectGeneratedLod(drawIdx) : -1;
+      auto firstIndex = range.firstIndex;
+      auto indexCount = range.indexCount;
+      if (lod >= 0) {
+        firstIndex = packedGeometry.lods[command.primitive][lod].firstIndex;
+        indexCount = packedGeometry.lods[command.primitive][lod].indexCount;
+      }
+      const auto material =
+          useBindlessTextures ? 0 : getTextureSetMaterial(command.material);
+      if (drawGroups.empty() || drawGroups.back().mode != GLenum(command.mode) ||
+          drawGroups.back().material != material) {
+        drawGroups.push_back(DrawGroup{GLenum(command.mode), material,
+            indirectCommands.size(), indirectCommands.size()});
+        lastPrimitive = -1;
+      }
+      const auto *meshlets = !instanced && !packedGeometry.meshlets.empty()
+                                 ? &packedGeometry.meshlets[command.primitive]
+                                 : nullptr;
+      if (meshlets && !meshlets->empty()) {
+        const auto doubleSided =
+            runtimeScene.material(command.material).doubleSided;
+        for (const auto &meshlet : *meshlets) {
+          indirectCommands.push_back(DrawElementsIndirectCommand{
+              meshlet.indexCount, 1, firstIndex + meshlet.firstIndex,
+              range.baseVertex, GLuint(drawIdx)});
+          commandMeshlets.emplace_back(meshlet.center, meshlet.radius);
+          commandMeshlets.emplace_back(
+              meshlet.coneAxis, doubleSided ? 1.f : meshlet.coneCutoff);
+        }
+      } else if (instanced && command.primitive == lastPrimitive &&
+                 lod == lastLod) {
+        ++indirectCommands.back().instanceCount;
+      } else {
+        indirectCommands.push_back(DrawElementsIndirectCommand{indexCount, 1,
+            firstIndex, range.baseVertex,
+            GLuint(instanced ? instanceDraws.size() : drawIdx)});
+        if (!instanced) {
+          commandMeshlets.emplace_back(0, 0, 0, -1);
+          commandMeshlets.emplace_back(0, 0, 1, 1);
+        }
+      }
+      if (instanced) {
+        instanceDraws.push_back(GLuint(drawIdx));
+      }
+      lastPrimitive = command.primitive;
+      lastLod = lod;
+      drawGroups.back().end = indirectCommands.size();
+    }
+    instancedDrawCount = indirectCommands.size();
+  };
+
+  // With --gpu-culling, the commands of all draws are built once and the
+  // frustum test is done by a compute shader writing indirectBuffer
+  auto gpuCulling = multiDraw && m_options.gpuCulling;
+  if (cameraRelative && (gpuCulling || skinningPrepass || m_scene->tileset)) {
+    std::cerr << "Warning : camera relative rendering disabled, not with GPU "
+                 "culling, compute skinning nor tilesets"
+              << std::endl;
+    cameraRelative = false;
+  }
+  GLProgram cullProgram;
+  GLBuffer drawBoundsBuffer;
+  GLBuffer allCommandsBuffer;
+  GLBuffer commandMeshletsBuffer;
+  GLBuffer drawVisibilityBuffer; // DrawVisibility::drawBits
+  // One command per draw, the shader culls them one by one. Levels of MSFT_lod
+  // groups are not selected on the GPU, only the first is drawn. Built again
+  // when the materials of draws change.
+  const auto createAllCommands = [&]() {
+    buildIndirectCommands(
+        flatScene.lodGroups.empty() ? nullptr : lodVisibleDraws.data(), false);
+    allCommandsBuffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, allCommandsBuffer.glId());
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        std::max(indirectCommands.size(), size_t(1)) *
+            sizeof(DrawElementsIndirectCommand),
+        indirectCommands.data(), 0);
+    commandMeshletsBuffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandMeshletsBuffer.glId());
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        std::max(commandMeshlets.size(), size_t(2)) * sizeof(glm::vec4),
+        commandMeshlets.data(), 0);
+  };
+  auto meshletCulling = true;
+  std::unique_ptr<DepthPyramid> depthPyramid;
+  auto occlusionCulling = true;
+  auto previousViewProjMatrix = glm::mat4(1);
+  std::vector<glm::vec4> drawBounds;
+  const auto updateDrawBounds = [&]() {
+    drawBounds.clear();
+    for (const auto &bounds : primitiveBounds) {
+      drawBounds.emplace_back(bounds.min, 0);
+      drawBounds.emplace_back(bounds.max, 0);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBoundsBuffer.glId());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+        drawBounds.size() * sizeof(glm::vec4), drawBounds.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    drawStats.uploadedBufferBytes += drawBounds.size() * sizeof(glm::vec4);
+  };
+  const auto updateDrawData = [&]() {
+    for (size_t i = 0; i < drawCommands.size(); ++i) {
+      const auto &command = drawCommands[i];
+      const auto uniforms = getDrawUniforms(size_t(command.node));
+      drawData[i].modelMatrix = uniforms.modelMatrix;
+      drawData[i].normalMatrix = uniforms.normalMatrix;
+      drawData[i].materialIndex =
+          command.material >= 0 ? command.material : defaultMaterialIndex;
+      drawData[i].firstJoint = uniforms.firstJoint;
+      drawData[i].previousModelMatrix = uniforms.previousModelMatrix;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer.glId());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+        drawData.size() * sizeof(DrawData), drawData.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    drawStats.uploadedBufferBytes += drawData.size() * sizeof(DrawData);
+  };
+
+  // Per-draw data of instanced draws and of --multi-draw
+  for (const auto &block : {std::make_pair("Draws", DRAWS_BINDING),
+           std::make_pair("Joints", JOINTS_BINDING),
+           std::make_pair("Lights", LightClusters::LIGHTS_BINDING),
+           std::make_pair("LightClusters", LightClusters::CLUSTERS_BINDING),
+           std::make_pair("DebugDraws", DebugViews::DRAWS_BINDING)}) {
+    const auto blockIndex = glGetProgramResourceIndex(
+        glslProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glShaderStorageBlockBinding(glslProgram.glId(), blockIndex, block.second);
+    }
+  }
+  drawDataBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      std::max(drawData.size(), size_t(1)) * sizeof(DrawData), nullptr,
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, drawDataBuffer.glId());
+  updateDrawData();
+
+  if (multiDraw || sharedBuffers) {
+    const auto packedVertices = renderDevice.createBuffer({BufferUsage::Vertex,
+        packedGeometry.vertices.size() * sizeof(PackedVertex),
+        packedGeometry.vertices.data()});
+    const auto packedIndices = renderDevice.createBuffer({BufferUsage::Index,
+        packedGeometry.indices.size() * sizeof(uint32_t),
+        packedGeometry.indices.data()});
+    packedBuffers = GLBuffers({packedVertices.id, packedIndices.id});
+
+    packedVertexArray = GLVertexArray::generate();
+    glBindVertexArray(packedVertexArray.glId());
+    glBindBuffer(GL_ARRAY_BUFFER, packedBuffers[0]);
+    glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION_IDX);
+    glVertexAttribPointer(VERTEX_ATTRIB_POSITION_IDX, 3, GL_FLOAT, GL_FALSE,
+        sizeof(PackedVertex), (const GLvoid *)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL_IDX);
+    glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, 3, GL_FLOAT, GL_FALSE,
+        sizeof(PackedVertex), (const GLvoid *)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(VERTEX_ATTRIB_TEXCOORD0_IDX);
+    glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD0_IDX, 2, GL_FLOAT, GL_FALSE,
+        sizeof(PackedVertex),
+        (const GLvoid *)offsetof(PackedVertex, texCoords));
+    if (!packedGeometry.skinVertices.empty()) {
+      packedSkinBuffer = GLBuffer::generate();
+      glBindBuffer(GL_ARRAY_BUFFER, packedSkinBuffer.glId());
+      glBufferStorage(GL_ARRAY_BUFFER,
+          packedGeometry.skinVertices.size() * sizeof(PackedSkinVertex),
+          packedGeometry.skinVertices.data(), 0);
+      glEnableVertexAttribArray(VERTEX_ATTRIB_JOINTS0_IDX);
+      glVertexAttribPointer(VERTEX_ATTRIB_JOINTS0_IDX, 4, GL_FLOAT, GL_FALSE,
+          sizeof(PackedSkinVertex),
+          (const GLvoid *)offsetof(PackedSkinVertex, joints));
+      glEnableVertexAttribArray(VERTEX_ATTRIB_WEIGHTS0_IDX);
+      glVertexAttribPointer(VERTEX_ATTRIB_WEIGHTS0_IDX, 4, GL_FLOAT, GL_FALSE,
+          sizeof(PackedSkinVertex),
+          (const GLvoid *)offsetof(PackedSkinVertex, weights));
+    }
+    if (!packedGeometry.tangents.empty()) {
+      packedTangentBuffer = GLBuffer::generate();
+      glBindBuffer(GL_ARRAY_BUFFER, packedTangentBuffer.glId());
+      glBufferStorage(GL_ARRAY_BUFFER,
+          packedGeometry.tangents.size() * sizeof(glm::vec4),
+          packedGeometry.tangents.data(), 0);
+      glEnableVertexAttribArray(VERTEX_ATTRIB_TANGENT_IDX);
+      glVertexAttribPointer(VERTEX_ATTRIB_TANGENT_IDX, 4, GL_FLOAT, GL_FALSE,
+          sizeof(glm::vec4), nullptr);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, instanceDrawBuffer.glId());
+    glEnableVertexAttribArray(VERTEX_ATTRIB_DRAW_INDEX_IDX);
+    glVertexAttribIPointer(
+        VERTEX_ATTRIB_DRAW_INDEX_IDX, 1, GL_UNSIGNED_INT, 0, nullptr);
+    glVertexAttribDivisor(VERTEX_ATTRIB_DRAW_INDEX_IDX, 1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, packedBuffers[1]);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Only ranges are needed from now on
+    packedGeometry.vertices = {};
+    packedGeometry.skinVertices = {};
+    packedGeometry.tangents = {};
+    packedGeometry.indices = {};
+  }
+
+  if (multiDraw) {
+    // Rewritten every frame with the visible draws, with --meshlets there
+    // is one command per meshlet of each draw
+    auto maxCommandCount = drawCommands.size();
+    if (!packedGeometry.meshlets.empty()) {
+      maxCommandCount = 0;
+      for (const auto &command : drawCommands) {
+        maxCommandCount += std::max(
+            packedGeometry.meshlets[command.primitive].size(), size_t(1));
+      }
+    }
+    indirectBuffer.reset(renderDevice
+                             .createBuffer({BufferUsage::Indirect,
+                                 std::max(maxCommandCount, size_t(1)) *
+                                     sizeof(DrawElementsIndirectCommand),
+                                 nullptr, true})
+                             .id);
+    indirectCommands.reserve(maxCommandCount);
+
+    if (gpuCulling) {
+      cullProgram =
+          programCache.compileProgram(
+              {m_ShadersRootPath / "cull_draws.cs.glsl"}, depthDefines);
+      for (const auto &block :
+          {std::make_pair("DrawBounds", CULL_BOUNDS_BINDING),
+              std::make_pair("AllCommands", CULL_ALL_COMMANDS_BINDING),
+              std::make_pair("VisibleCommands", CULL_VISIBLE_COMMANDS_BINDING),
+              std::make_pair("CommandMeshlets", CULL_MESHLETS_BINDING),
+              std::make_pair("DrawVisibility", CULL_VISIBILITY_BINDING),
+              std::make_pair("Draws", DRAWS_BINDING)}) {
+        const auto blockIndex = glGetProgramResourceIndex(
+            cullProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+        if (blockIndex != GL_INVALID_INDEX) {
+          glShaderStorageBlockBinding(
+              cullProgram.glId(), blockIndex, block.second);
         }
-        auto textureObject = whiteTexture;
-        if (pbrMetallicRoughness.baseColorTexture.index >= 0) {
-          const auto &texture =
-              model.textures[pbrMetallicRoughness.baseColorTexture.index];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
+      }
+
+      drawBoundsBuffer = GLBuffer::generate();
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBoundsBuffer.glId());
+      glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+          std::max(primitiveBounds.size(), size_t(1)) * 2 * sizeof(glm::vec4),
+          nullptr, GL_DYNAMIC_STORAGE_BIT);
+      updateDrawBounds();
+
+      createAllCommands();
+      // Only the words of the bits changed are uploaded again
+      const auto &drawBits = drawVisibility.drawBits();
+      drawVisibilityBuffer = GLBuffer::generate();
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawVisibilityBuffer.glId());
+      glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+          std::max(drawBits.size(), size_t(1)) * sizeof(uint32_t),
+          drawBits.empty() ? nullptr : drawBits.data(),
+          GL_DYNAMIC_STORAGE_BIT);
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // Hidden draws are found with the depth of the previous frame, not of
+    // the previous tile which has another projection. Served jobs may each
+    // have their size. The pyramid is single sampled, it would be copied to
+    // multisampled output images without antialiasing.
+    if (gpuCulling && m_options.occlusionCulling && !getOutputTileSize() &&
+        !m_nextOutputJob && m_options.outputSampleCount <= 1) {
+      depthPyramid = std::make_unique<DepthPyramid>(m_nWindowWidth,
+          m_nWindowHeight,
+          programCache.compileProgram(
+              {m_ShadersRootPath / "depth_pyramid.cs.glsl"}, depthDefines));
+    }
+  }
+
+  // With --interleave-vertices or --quantize-vertices, the attributes of the
+  // vertex arrays of primitives are rebuilt in one buffer (see
+  // buildVertexStreams), the vertex shader dequantizes positions with the
+  // uniforms of their primitive
+  std::vector<glm::vec3> positionOffsets(
+      vertexArrayObjects.size(), glm::vec3(0));
+  std::vector<glm::vec3> positionScales(
+      vertexArrayObjects.size(), glm::vec3(1));
+  GLBuffer vertexStreamBuffer;
+  if ((m_options.interleaveVertices || m_options.quantizeVertices) &&
+      !multiDraw && !sharedBuffers) {
+    std::vector<const tinygltf::Primitive *> primitives;
+    for (const auto &mesh : model.meshes) {
+      for (const auto &primitive : mesh.primitives) {
+        primitives.push_back(&primitive);
+      }
+    }
+    std::vector<VertexStreams> vertexStreams(primitives.size());
+    std::vector<uint8_t> isBuilt(primitives.size(), 0);
+    parallelFor(primitives.size(), [&](size_t i) {
+      isBuilt[i] = buildVertexStreams(model, bufferBytes, *primitives[i],
+          m_options.quantizeVertices, vertexStreams[i]);
+    });
+
+    // Position then shading stream of each primitive
+    std::vector<unsigned char> bytes;
+    std::vector<std::array<size_t, 2>> byteOffsets(primitives.size());
+    const auto append = [&](const auto &values) {
+      const auto offset = bytes.size();
+      bytes.resize(offset + (values.size() + 15) / 16 * 16);
+      std::memcpy(bytes.data() + offset, values.data(), values.size());
+      return offset;
+    };
+    for (size_t i = 0; i < primitives.size(); ++i) {
+      if (isBuilt[i]) {
+        const auto &streams = vertexStreams[i];
+        byteOffsets[i] = {append(streams.positions), append(streams.shading)};
+      }
+    }
+    vertexStreamBuffer = GLBuffer::generate();
+    glBindBuffer(GL_ARRAY_BUFFER, vertexStreamBuffer.glId());
+    glBufferStorage(GL_ARRAY_BUFFER, std::max(bytes.size(), size_t(1)),
+        bytes.data(), 0);
+    for (size_t i = 0; i < primitives.size(); ++i) {
+      if (!isBuilt[i]) {
+        continue;
+      }
+      const auto &streams = vertexStreams[i];
+      const auto quantized = streams.quantized;
+      positionOffsets[i] = streams.positionOffset;
+      positionScales[i] = streams.positionScale;
+      glBindVertexArray(vertexArrayObjects[i]);
+      glVertexAttribPointer(VERTEX_ATTRIB_POSITION_IDX, 3,
+          quantized ? GL_UNSIGNED_SHORT : GL_FLOAT,
+          quantized ? GL_TRUE : GL_FALSE, GLsizei(streams.positionStride),
+          (const GLvoid *)byteOffsets[i][0]);
+      const auto stride = GLsizei(streams.shadingStride);
+      if (streams.hasNormals) {
+        if (quantized) {
+          glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, 4,
+              GL_INT_2_10_10_10_REV, GL_TRUE, stride,
+              (const GLvoid *)byteOffsets[i][1]);
+        } else {
+          glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, 3, GL_FLOAT,
+              GL_FALSE, stride, (const GLvoid *)byteOffsets[i][1]);
+        }
+      }
+      if (streams.hasTangents) {
+        glVertexAttribPointer(VERTEX_ATTRIB_TANGENT_IDX, 4,
+            quantized ? GL_INT_2_10_10_10_REV : GL_FLOAT, quantized, stride,
+            (const GLvoid *)(byteOffsets[i][1] + streams.tangentOffset));
+      }
+      if (streams.hasTexCoords) {
+        glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD0_IDX, 2,
+            quantized ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride,
+            (const GLvoid *)(byteOffsets[i][1] + streams.texCoordOffset));
+      }
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  const GLuint geometryBuffers[] = {
+      packedBuffers.empty() ? 0 : packedBuffers[0],
+      packedBuffers.empty() ? 0 : packedBuffers[1], vertexStreamBuffer.glId(),
+      packedSkinBuffer.glId(), packedTangentBuffer.glId()};
+  trackBuffers(GpuMemoryCategory::Geometry, 5, geometryBuffers);
+  const GLuint drawDataBuffers[] = {materialBuffer.glId(),
+      instanceDrawBuffer.glId(), drawDataBuffer.glId(), indirectBuffer.glId(),
+      drawBoundsBuffer.glId(), allCommandsBuffer.glId(),
+      commandMeshletsBuffer.glId(), jointBuffer.glId(),
+      drawVisibilityBuffer.glId()};
+  trackBuffers(GpuMemoryCategory::DrawData, 9, drawDataBuffers);
+#ifndef GLTF_VIEWER_HEADLESS
+  // Free memory reported by the driver is shown next to the tracked one
+  DriverMemoryInfo initialDriverMemory;
+  const auto hasDriverMemoryInfo = queryDriverMemory(initialDriverMemory);
+#endif
+  const auto uPositionOffset =
+      glslProgram.getUniformLocation("uPositionOffset");
+  const auto uPositionScale =
+      glslProgram.getUniformLocation("uPositionScale");
+
+  // With --compute-points, draws of POINTS primitives are rasterized by
+  // PointClouds instead of drawn, but those of skinned or morphed ones.
+  // drawPointClouds[i] is the point cloud of draw i, -1 if it is drawn.
+  std::unique_ptr<PointClouds> pointClouds;
+  std::vector<int> drawPointClouds(drawCommands.size(), -1);
+  std::vector<PointClouds::Draw> pointCloudInstances; // Of the drawn view
+  if (m_options.computePoints &&
+      (multiDraw || m_options.deferredShading)) {
+    std::cerr << "Warning : compute points disabled, not with multi-draw "
+                 "nor deferred shading"
+              << std::endl;
+  } else if (m_options.computePoints) {
+    const auto pointDefines =
+        depthDefines +
+        (PointClouds::hasInt64Atomics() ? "#define ATOMIC_INT64 1\n" : "");
+    pointClouds = std::make_unique<PointClouds>(
+        programCache.compileProgram(
+            {m_ShadersRootPath / "point_rasterize.cs.glsl"}, pointDefines),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+                m_ShadersRootPath / "point_resolve.fs.glsl"},
+            pointDefines + (gpuPicking ? "#define DRAW_IDS 1\n" : "")));
+    // Of each primitive, its point cloud, -1 if it cannot be read
+    std::vector<int> primitiveClouds(vertexArrayObjects.size(), -2);
+    auto hasPointClouds = false;
+    for (size_t drawIdx = 0; drawIdx < drawCommands.size(); ++drawIdx) {
+      const auto &command = drawCommands[drawIdx];
+      const auto meshIdx = flatScene.meshes[command.node];
+      const auto &primitive =
+          model.meshes[meshIdx]
+              .primitives[command.primitive - meshToVA[meshIdx].begin];
+      if (command.mode != GL_POINTS || !primitive.targets.empty() ||
+          getFirstJoint(size_t(command.node)) >= 0) {
+        continue;
+      }
+      auto &cloud = primitiveClouds[command.primitive];
+      if (cloud == -2) {
+        cloud = pointClouds->addPrimitive(model, bufferBytes, primitive,
+            runtimeScene.material(command.material).baseColorFactor);
+      }
+      drawPointClouds[drawIdx] = cloud;
+      hasPointClouds = hasPointClouds || cloud >= 0;
+    }
+    if (hasPointClouds) {
+      pointClouds->createBuffers();
+    } else {
+      pointClouds.reset();
+    }
+  }
+
+  // Scene bounding box, computed by loadScene from the accessors of
+  // positions, with the vertices morphed by the skinning pre-pass
+  BoundingBox sceneBounds{m_scene->bboxMin, m_scene->bboxMax};
+  // Left empty by loadScene with --gpu-bounds: the same union of the boxes
+  // of the draws in their nodes, from the boxes reduced on the GPU where
+  // min/max are missing (looser than the box of the transformed vertices)
+  if (sceneBounds.isEmpty()) {
+    for (const auto &command : drawCommands) {
+      sceneBounds.extend(
+          transformBoundingBox(localPrimitiveBounds[command.primitive],
+              flatScene.worldMatrices[command.node]));
+    }
+  }
+  for (size_t i = 0; i < morphedBounds.size(); ++i) {
+    if (!morphedBounds[i].isEmpty()) {
+      sceneBounds.extend(primitiveBounds[i]);
+    }
+  }
+  const auto bboxMin = sceneBounds.min;
+  const auto bboxMax = sceneBounds.max;
+
+  if (m_options.releaseCpuData) {
+    // The draw loop only needs the metadata of the model from now on, and
+    // reads materials from runtimeScene
+    releaseMaterialData(model);
+    // Otherwise released once uploaded, streamed images keep their pixels to
+    // create their finer levels
+    if (!progressiveTextures.isDecoding() && !streamTextures() &&
+        !lazyTextures) {
+      for (auto &image : model.images) {
+        releaseImageData(image);
+      }
+    }
+    // Lazily uploaded bufferViews are read until the end
+    if (!lazyGeometry) {
+      releaseBufferData(model);
+      m_scene->bufferBytes.clear();
+      m_scene->mappedFiles.clear();
+    }
+  }
+
+  // Build projection matrix
+  // Using scene bounds
+  const auto diagonal = bboxMax - bboxMin;
+  auto maxDist = glm::length(diagonal);
+  const auto getProjMatrix = [&]() {
+    return glm::perspective(70.f, float(m_nWindowWidth) / m_nWindowHeight,
+        0.001f * maxDist, 1.5f * maxDist);
+  };
+  auto projMatrix = getProjMatrix();
+  // Projection of the shaders, projMatrix but with --reversed-z: its depths
+  // are reversed, between near and far planes fitted to the scene bounds seen
+  // from the camera. projMatrix keeps the conventions of glm::perspective
+  // for culling and picking, and is shared with the jobs of the frame.
+  const auto getDepthProjMatrix = [&](const glm::mat4 &viewMatrix) {
+    if (!reversedZ) {
+      return projMatrix;
+    }
+    auto zNear = 0.001f * maxDist;
+    auto zFar = 1.5f * maxDist;
+    const auto viewBounds =
+        transformBoundingBox(flatScene.bounds, viewMatrix);
+    if (!viewBounds.isEmpty() && viewBounds.min.z < 0.f) {
+      zFar = -viewBounds.min.z * (1.f + DEPTH_RANGE_MARGIN);
+      zNear = std::max(-viewBounds.max.z * (1.f - DEPTH_RANGE_MARGIN),
+          MIN_NEAR_RATIO * zFar);
+    }
+    // Swapping the planes of a [0, 1] projection puts the near one at 1
+    return glm::perspectiveRH_ZO(
+        70.f, float(m_nWindowWidth) / m_nWindowHeight, zFar, zNear);
+  };
+
+
+  // Implement a new CameraController model and use it instead. Propose the
+  // choice from the GUI
+#ifdef GLTF_VIEWER_HEADLESS
+  GLFWwindow *const cameraWindow = nullptr;
+#else
+  const auto cameraWindow = m_GLFWHandle ? m_GLFWHandle->window() : nullptr;
+#endif
+  std::unique_ptr<CameraController> cameraController = 
+    std::make_unique<TrackballCameraController>(cameraWindow, 0.5f * maxDist);
+  cameraController->setRemoteInput(m_remoteInput.get());
+  if (m_hasUserCamera) {
+    cameraController->setCamera(m_userCamera);
+  } else {
+    // Using scene bounds to compute a better default camera
+    const auto center = 0.5f * (bboxMax + bboxMin);
+    const auto up = glm::vec3(0 , 1 , 0);
+    const auto eye = diagonal.z > 0.f ? center + diagonal : center + 2.f * glm::cross(diagonal, up);
+    cameraController->setCamera(Camera(eye, center, up));
+  }
+
+#ifndef GLTF_VIEWER_HEADLESS
+  // Look at the center of bounds from the direction of the camera, as far as
+  // the default camera is from the scene
+  const auto frameBounds = [&](const BoundingBox &bounds) {
+    if (bounds.isEmpty()) {
+      return;
+    }
+    const auto &camera = cameraController->getCamera();
+    const auto center = 0.5f * (bounds.min + bounds.max);
+    const auto distance =
+        std::max(glm::length(bounds.max - bounds.min), 0.01f * maxDist);
+    cameraController->setCamera(
+        Camera(center - distance * camera.front(), center, camera.up()));
+  };
+#endif
+
+  // Setup OpenGL state for rendering
+  glEnable(GL_DEPTH_TEST);
+  // Nearer fragments have greater depths with --reversed-z, cleared to 0
+  const GLenum depthFunc = reversedZ ? GL_GREATER : GL_LESS;
+  if (reversedZ) {
+    clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    glClearDepth(0.);
+  }
+  glDepthFunc(depthFunc);
+  glslProgram.use();
+
+  // Texture units of samplers never change
+  for (const auto &sampler : {std::make_pair(uBaseColorTexture, 0),
+           std::make_pair(uMetallicRoughness, 1),
+           std::make_pair(uEmissiveTexture, 2),
+           std::make_pair(uOcclusionTexture, 3),
+           std::make_pair(uNormalTexture, 4),
+           std::make_pair(glslProgram.getUniformLocation("uShadowMap"),
+               GLint(ShadowCascades::TEXTURE_UNIT)),
+           std::make_pair(
+               glslProgram.getUniformLocation("uPrefilteredEnvironment"),
+               GLint(EnvironmentMap::PREFILTERED_UNIT)),
+           std::make_pair(glslProgram.getUniformLocation("uBrdfLut"),
+               GLint(EnvironmentMap::BRDF_LUT_UNIT))}) {
+    glslProgram.setUniform(sampler.first, sampler.second);
+  }
+  glslProgram.setUniform(uBindlessTextures, GLint(useBindlessTextures));
+  const auto uUseDrawTable =
+      glslProgram.getUniformLocation("uUseDrawTable");
+  if (uUseDrawTable >= 0) {
+    glUniform1i(uUseDrawTable, multiDraw);
+  }
+  // Set per draw not reading the Draws table, with --gpu-picking or the
+  // debug views
+  const auto uDrawId = glslProgram.getUniformLocation("uDrawId");
+  // Mode of the debug views, set in glslProgram and its variants, none with
+  // other shaders (--fs)
+  const auto uDebugView = glslProgram.getUniformLocation("uDebugView");
+  auto debugView = DebugViews::Shaded;
+  std::unique_ptr<DebugViews> debugViews;
+  if (uDebugView >= 0) {
+    debugViews = std::make_unique<DebugViews>(programCache.compileProgram(
+        {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+            m_ShadersRootPath / "debug_overdraw.fs.glsl"}));
+  }
+  // Of each draw, uploaded every frame of the TriangleDensity view
+  std::vector<float> drawTriangleDensities;
+
+  // Blocks and texture units of a program compiled from the shaders of
+  // glslProgram, like it
+  const auto setupProgram = [&](GLProgram &program) {
+    bindUniformBlocks(program);
+    for (const auto &block :
+        {std::make_pair("Materials", MATERIALS_BINDING),
+            std::make_pair("Draws", DRAWS_BINDING),
+            std::make_pair("Joints", JOINTS_BINDING),
+            std::make_pair("Lights", LightClusters::LIGHTS_BINDING),
+            std::make_pair(
+                "LightClusters", LightClusters::CLUSTERS_BINDING),
+            std::make_pair("DebugDraws", DebugViews::DRAWS_BINDING)}) {
+      const auto blockIndex = glGetProgramResourceIndex(
+          program.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+      if (blockIndex != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(program.glId(), blockIndex, block.second);
+      }
+    }
+    for (const auto &sampler :
+        {std::make_pair("uBaseColorTexture", 0),
+            std::make_pair("uMetallicRoughnessTexture", 1),
+            std::make_pair("uEmissiveTexture", 2),
+            std::make_pair("uOcclusionTexture", 3),
+            std::make_pair("uNormalTexture", 4),
+            std::make_pair(
+                "uShadowMap", GLint(ShadowCascades::TEXTURE_UNIT)),
+            std::make_pair("uPrefilteredEnvironment",
+                GLint(EnvironmentMap::PREFILTERED_UNIT)),
+            std::make_pair(
+                "uBrdfLut", GLint(EnvironmentMap::BRDF_LUT_UNIT)),
+            std::make_pair("uSceneColor", GLint(SceneColor::TEXTURE_UNIT))}) {
+      program.setUniform(
+          program.getUniformLocation(sampler.first), sampler.second);
+    }
+    program.setUniform(uDebugView, GLint(debugView));
+  };
+
+  // With --deferred-shading, opaque draws and cutouts write their material
+  // parameters in gbuffer with variants of glslProgram compiled with GBUFFER,
+  // then lightingProgram shades its pixels
+  std::unique_ptr<GBuffer> gbuffer;
+  GLProgram gbufferProgram;
+  GLProgram lightingProgram;
+  GLint uLightingInverseProjMatrix = -1;
+  const auto gbufferDefines = programDefines + "#define GBUFFER 1\n";
+  if (m_options.deferredShading) {
+    gbuffer = std::make_unique<GBuffer>();
+    gbufferProgram = programCache.compileProgram(
+        {m_ShadersRootPath / m_vertexShader,
+            m_ShadersRootPath / m_fragmentShader},
+        gbufferDefines);
+    setupProgram(gbufferProgram);
+    gbufferProgram.setUniform(uBindlessTextures, GLint(useBindlessTextures));
+    gbufferProgram.setUniform(uUseDrawTable, GLint(multiDraw));
+    lightingProgram = programCache.compileProgram(
+        {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+            m_ShadersRootPath / m_fragmentShader},
+        programDefines + "#define DEFERRED_LIGHTING 1\n" +
+            (m_options.ambientOcclusion ? "#define AMBIENT_OCCLUSION 1\n"
+                                        : ""));
+    setupProgram(lightingProgram);
+    for (GLuint i = 0; i < GBuffer::TEXTURE_COUNT; ++i) {
+      lightingProgram.setUniform(
+          lightingProgram.getUniformLocation(GBuffer::SAMPLER_NAMES[i]),
+          GLint(GBuffer::FIRST_TEXTURE_UNIT + i));
+    }
+    uLightingInverseProjMatrix =
+        lightingProgram.getUniformLocation("uInverseProjMatrix");
+  }
+  // With --ssao, the lighting pass also darkens pixels by the screen space
+  // occlusion of ambientOcclusion
+  std::unique_ptr<AmbientOcclusion> ambientOcclusion;
+  GLint uApplyAmbientOcclusion = -1;
+  auto applyAmbientOcclusion = true;
+  if (gbuffer && m_options.ambientOcclusion) {
+    ambientOcclusion = std::make_unique<AmbientOcclusion>(
+        programCache.compileProgram(
+            {m_ShadersRootPath / "ambient_occlusion.cs.glsl"}, depthDefines),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "ambient_occlusion_blur.cs.glsl"}),
+        GBuffer::FIRST_TEXTURE_UNIT + GBuffer::DEPTH_TEXTURE,
+        GBuffer::FIRST_TEXTURE_UNIT + GBuffer::NORMAL_TEXTURE);
+    lightingProgram.setUniform(
+        lightingProgram.getUniformLocation("uAmbientOcclusion"),
+        GLint(AmbientOcclusion::TEXTURE_UNIT));
+    uApplyAmbientOcclusion =
+        lightingProgram.getUniformLocation("uApplyAmbientOcclusion");
+  }
+
+  // With --material-variants, draws of the default draw loop use a variant of
+  // glslProgram compiled without the textures their material does not have.
+  // Uniforms set by the draw loop have the same location in all variants.
+  std::vector<GLProgram> variantPrograms;
+  // Of each material, the last one is the default material
+  std::vector<GLuint> materialPrograms(
+      runtimeScene.materials.size(), glslProgram.glId());
+  const auto getMaterialProgram = [&](int materialIdx) {
+    return materialPrograms[runtimeScene.materialSlot(materialIdx)];
+  };
+  const auto sortDrawOrderByProgram = [&]() {
+    std::stable_sort(begin(drawOrder), end(drawOrder), [&](size_t a, size_t b) {
+      return getMaterialProgram(drawCommands[a].material) <
+             getMaterialProgram(drawCommands[b].material);
+    });
+  };
+  const auto materialVariants =
+      m_options.materialVariants && !multiDraw && !useBindlessTextures;
+  // With --sorted-transparency, draws of MASK materials are drawn after the
+  // opaque ones by a variant discarding the fragments under their cutoff, so
+  // that only them lose early depth tests, and draws of BLEND materials last,
+  // by a variant writing their alpha, back to front
+  std::vector<AlphaMode> materialAlphaModes(
+      runtimeScene.materials.size(), AlphaMode::Opaque);
+  const auto getAlphaMode = [&](int materialIdx) {
+    return materialAlphaModes[runtimeScene.materialSlot(materialIdx)];
+  };
+  if (m_options.sortedTransparency && multiDraw) {
+    std::cerr << "Warning : sorted transparency disabled, not with "
+                 "multi-draw"
+              << std::endl;
+  } else if (m_options.sortedTransparency) {
+    for (size_t i = 0; i < materialAlphaModes.size(); ++i) {
+      materialAlphaModes[i] = runtimeScene.materials[i].alphaMode;
+    }
+  }
+  // Materials of KHR_materials_transmission are drawn with the BLEND ones by
+  // a variant sampling sceneColor, copied once before them. Those of MASK
+  // materials stay cutouts, drawn without transmission.
+  std::vector<uint8_t> materialTransmissions(
+      runtimeScene.materials.size(), 0);
+  std::unique_ptr<SceneColor> sceneColor;
+  const auto hasTransmission = std::any_of(begin(runtimeScene.materials),
+      end(runtimeScene.materials), [](const RuntimeMaterial &material) {
+        return material.transmissionFactor > 0.f;
+      });
+  if (hasTransmission &&
+      (!m_options.sortedTransparency || multiDraw || stereo)) {
+    std::cerr << "Warning : transmissive materials drawn opaque, only with "
+                 "sorted transparency, not with stereo"
+              << std::endl;
+  } else if (hasTransmission) {
+    sceneColor = std::make_unique<SceneColor>();
+    for (size_t i = 0; i < materialTransmissions.size(); ++i) {
+      if (runtimeScene.materials[i].transmissionFactor > 0.f &&
+          materialAlphaModes[i] != AlphaMode::Mask) {
+        materialTransmissions[i] = 1;
+        materialAlphaModes[i] = AlphaMode::Blend;
+      }
+    }
+  }
+  const auto hasAlphaModes =
+      std::any_of(begin(materialAlphaModes), end(materialAlphaModes),
+          [](AlphaMode mode) { return mode != AlphaMode::Opaque; });
+  // With --async-variants, variants compile on driver threads and materials
+  // are drawn by the generic program, reading all textures, until theirs
+  // links. Images written to files and benchmarks use all variants.
+  struct PendingVariant
+  {
+    PendingProgram pending;
+    // Materials drawn by the variant once linked, and their program until then
+    std::vector<std::pair<size_t, GLuint>> materials;
+  };
+  std::vector<PendingVariant> pendingVariants;
+  const auto asyncVariants = materialVariants && m_options.asyncVariants &&
+                             m_parallelShaderCompile && m_OutputPath.empty() &&
+                             !m_benchmark.frameCount;
+  if (materialVariants || hasAlphaModes || gbuffer) {
+    std::unordered_map<std::string, GLuint> definePrograms{
+        {programDefines, glslProgram.glId()}};
+    if (gbuffer) {
+      definePrograms[gbufferDefines] = gbufferProgram.glId();
+    }
+    // Of the programs compiling in pendingVariants
+    std::unordered_map<GLuint, size_t> pendingVariantIndices;
+    const std::vector<fs::path> shaderPaths = {
+        m_ShadersRootPath / m_vertexShader,
+        m_ShadersRootPath / m_fragmentShader};
+    const auto getProgram = [&](const std::string &defines, bool async) {
+      auto &programId = definePrograms[defines];
+      if (!programId && async) {
+        pendingVariants.push_back(
+            {programCache.startCompilingProgram(shaderPaths, defines), {}});
+        programId = pendingVariants.back().pending.program.glId();
+        pendingVariantIndices[programId] = pendingVariants.size() - 1;
+      } else if (!programId) {
+        auto program = programCache.compileProgram(shaderPaths, defines);
+        programId = program.glId();
+        setupProgram(program);
+        program.setUniform(uBindlessTextures, GLint(useBindlessTextures));
+        variantPrograms.push_back(std::move(program));
+      }
+      return programId;
+    };
+    // Defines of each material but those of its missing textures
+    std::vector<std::string> passDefines(materialPrograms.size());
+    for (size_t i = 0; i < materialPrograms.size(); ++i) {
+      if (materialAlphaModes[i] == AlphaMode::Mask) {
+        passDefines[i] += "#define ALPHA_TEST 1\n";
+      } else if (runtimeScene.materials[i].alphaMode == AlphaMode::Blend &&
+                 materialAlphaModes[i] == AlphaMode::Blend) {
+        passDefines[i] += "#define ALPHA_BLEND 1\n";
+      }
+      if (materialTransmissions[i]) {
+        passDefines[i] += "#define TRANSMISSION 1\n";
+      }
+      if (gbuffer && materialAlphaModes[i] != AlphaMode::Blend) {
+        passDefines[i] += "#define GBUFFER 1\n";
+      }
+      const auto materialDefines =
+          materialVariants ? getMaterialDefines(runtimeScene.materials[i])
+                           : std::string();
+      materialPrograms[i] =
+          getProgram(programDefines + materialDefines + passDefines[i],
+              asyncVariants && !materialDefines.empty());
+    }
+    // Program changes are the most expensive, draws are grouped by program,
+    // the one they get once all variants are linked
+    sortDrawOrderByProgram();
+    for (size_t i = 0; i < materialPrograms.size(); ++i) {
+      const auto it = pendingVariantIndices.find(materialPrograms[i]);
+      if (it != end(pendingVariantIndices)) {
+        materialPrograms[i] =
+            getProgram(programDefines + passDefines[i], false);
+        pendingVariants[it->second].materials.emplace_back(
+            i, materialPrograms[i]);
+      }
+    }
+  }
+#ifndef GLTF_VIEWER_HEADLESS
+  // Returns true if a pending variant replaced a program of materials
+  const auto pollVariantPrograms = [&]() {
+    auto linked = false;
+    for (size_t i = 0; i < pendingVariants.size();) {
+      auto &variant = pendingVariants[i];
+      if (!isProgramReady(variant.pending)) {
+        ++i;
+        continue;
+      }
+      try {
+        auto program =
+            programCache.finishCompilingProgram(std::move(variant.pending));
+        setupProgram(program);
+        program.setUniform(uBindlessTextures, GLint(useBindlessTextures));
+        for (const auto &material : variant.materials) {
+          materialPrograms[material.first] = program.glId();
+        }
+        variantPrograms.push_back(std::move(program));
+        linked = true;
+      } catch (const std::exception &e) {
+        // Its materials keep the generic program
+        std::cerr << "Error : " << e.what() << std::endl;
+      }
+      pendingVariants.erase(begin(pendingVariants) + i);
+    }
+    return linked;
+  };
+#endif
+  // With --depth-prepass, draws are first drawn front to back by depthProgram,
+  // which only reads positions, then shaded where their depth is equal to the
+  // one of the pre-pass: each pixel runs the fragment shader once
+  GLProgram depthProgram;
+  // Distance to the camera of the nearest instance of each instance run, and
+  // its index, sorted for the pre-pass
+  std::vector<std::pair<float, size_t>> depthPrepassRuns;
+  if (m_options.depthPrepass) {
+    depthProgram = programCache.compileProgram(
+        {m_ShadersRootPath / m_vertexShader,
+            m_ShadersRootPath / "depth_only.fs.glsl"},
+        "#define DEPTH_ONLY 1\n" + skinningDefines + multiviewDefines);
+    bindUniformBlocks(depthProgram);
+    for (const auto &block : {std::make_pair("Draws", DRAWS_BINDING),
+             std::make_pair("Joints", JOINTS_BINDING)}) {
+      const auto blockIndex = glGetProgramResourceIndex(
+          depthProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+      if (blockIndex != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(
+            depthProgram.glId(), blockIndex, block.second);
+      }
+    }
+    if (uUseDrawTable >= 0) {
+      glProgramUniform1i(depthProgram.glId(), uUseDrawTable, multiDraw);
+    }
+  }
+  // With --conditional-render, the draws of primitives of at least
+  // MIN_QUERIED_VERTEX_COUNT vertices are runs of their own, each drawn only
+  // if the occlusion query of its bounding box passed in the previous frame.
+  // Boxes are queried after the opaque and cutout draws, without writing
+  // anything, and their results are never read back: the GPU draws until
+  // they are available.
+  const auto conditionalRender = m_options.conditionalRender && !multiDraw;
+  const GLsizei MIN_QUERIED_VERTEX_COUNT = 3072;
+  std::vector<uint8_t> queriedDraws(drawCommands.size(), 0);
+  GLQueries occlusionQueries;
+  // Of the drawScene each query was last issued in, 0 if never
+  std::vector<size_t> occlusionQueryFrames;
+  size_t occlusionQueryFrame = 0; // Of the last drawScene
+  // Queries of another tile or viewport do not test the same pixels
+  auto occlusionQueryTileMatrix = glm::mat4(1);
+  auto occlusionQueryViewport = glm::ivec2(0);
+  GLProgram occlusionBoxProgram;
+  GLint uBoxMin = -1;
+  GLint uBoxMax = -1;
+  GLVertexArray occlusionBoxVertexArray;
+  if (conditionalRender) {
+    for (size_t i = 0; i < drawCommands.size(); ++i) {
+      queriedDraws[i] = drawCommands[i].count >= MIN_QUERIED_VERTEX_COUNT;
+    }
+    occlusionQueries = GLQueries::generate(drawCommands.size());
+    occlusionQueryFrames.resize(drawCommands.size(), 0);
+    occlusionBoxProgram = programCache.compileProgram(
+        {m_ShadersRootPath / "occlusion_box.vs.glsl",
+            m_ShadersRootPath / "depth_only.fs.glsl"});
+    bindUniformBlocks(occlusionBoxProgram);
+    uBoxMin = occlusionBoxProgram.getUniformLocation("uBoxMin");
+    uBoxMax = occlusionBoxProgram.getUniformLocation("uBoxMax");
+    occlusionBoxVertexArray = GLVertexArray::generate();
+  }
+  // Forget the queries of previous frames, for a view unrelated to them
+  const auto resetOcclusionQueries = [&]() { occlusionQueryFrame += 2; };
+  // With --impostors, the meshes of at least MIN_IMPOSTOR_NODE_COUNT nodes
+  // get a layer of impostors, rendered before the first frame. Their nodes
+  // are drawn as impostors once their bounding sphere covers less than a
+  // frame of pixels. Not skinned, morphed nor blended meshes, lit by the
+  // light of the first frame as if their nodes were not rotated.
+  const size_t MIN_IMPOSTOR_NODE_COUNT = 16;
+  const size_t MAX_IMPOSTOR_LAYER_COUNT = 64;
+  std::unique_ptr<Impostors> impostors;
+  GLProgram impostorCoverageProgram;
+  std::vector<int> impostorMeshes; // Of each layer
+  std::vector<glm::vec4> impostorSpheres; // Local bounding sphere of each
+  std::vector<int> impostorNodeLayers(flatScene.size(), -1);
+  std::vector<Impostors::Instance> impostorInstances; // Of the drawn view
+  if (m_options.impostors &&
+      (multiDraw || gbuffer || m_options.shadowMaps || hasPunctualLights ||
+          lazyTextures || lazyGeometry || decodeImagesInBackground() ||
+          streamTextures())) {
+    std::cerr << "Warning : impostors disabled, not with multi-draw, "
+                 "deferred shading, shadow maps, punctual lights nor "
+                 "textures created while drawing"
+              << std::endl;
+  } else if (m_options.impostors) {
+    std::vector<std::vector<int>> meshNodes(model.meshes.size());
+    for (size_t i = 0; i < flatScene.size(); ++i) {
+      const auto meshIdx = flatScene.meshes[i];
+      if (meshIdx >= 0 && nodeFirstJoints[i] < 0) {
+        meshNodes[size_t(meshIdx)].push_back(int(i));
+      }
+    }
+    for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+      if (meshNodes[meshIdx].size() < MIN_IMPOSTOR_NODE_COUNT) {
+        continue;
+      }
+      const auto &vaoRange = meshToVA[meshIdx];
+      auto drawable = true;
+      BoundingBox bounds;
+      for (GLsizei prIdx = 0; prIdx < vaoRange.count; ++prIdx) {
+        const auto primitiveIdx = size_t(vaoRange.begin + prIdx);
+        drawable = drawable &&
+                   model.meshes[meshIdx].primitives[prIdx].targets.empty() &&
+                   getAlphaMode(runtimeScene.primitives[primitiveIdx]
+                                    .material) != AlphaMode::Blend;
+        bounds.extend(localPrimitiveBounds[primitiveIdx]);
+      }
+      if (drawable && !bounds.isEmpty()) {
+        impostorMeshes.push_back(int(meshIdx));
+      }
+    }
+    // The meshes of the most nodes first
+    std::stable_sort(begin(impostorMeshes), end(impostorMeshes),
+        [&](int lhs, int rhs) {
+          return meshNodes[size_t(lhs)].size() >
+                 meshNodes[size_t(rhs)].size();
+        });
+    if (impostorMeshes.size() > MAX_IMPOSTOR_LAYER_COUNT) {
+      impostorMeshes.resize(MAX_IMPOSTOR_LAYER_COUNT);
+    }
+    size_t impostorNodeCount = 0;
+    for (size_t layer = 0; layer < impostorMeshes.size(); ++layer) {
+      const auto meshIdx = size_t(impostorMeshes[layer]);
+      const auto &vaoRange = meshToVA[meshIdx];
+      BoundingBox bounds;
+      for (GLsizei prIdx = 0; prIdx < vaoRange.count; ++prIdx) {
+        bounds.extend(localPrimitiveBounds[size_t(vaoRange.begin + prIdx)]);
+      }
+      impostorSpheres.emplace_back(0.5f * (bounds.min + bounds.max),
+          std::max(0.5f * glm::length(bounds.max - bounds.min),
+              std::numeric_limits<float>::min()));
+      for (const auto nodeIdx : meshNodes[meshIdx]) {
+        impostorNodeLayers[size_t(nodeIdx)] = int(layer);
+      }
+      impostorNodeCount += meshNodes[meshIdx].size();
+    }
+    if (!impostorMeshes.empty()) {
+      auto impostorProgram = programCache.compileProgram(
+          {m_ShadersRootPath / "impostor.vs.glsl",
+              m_ShadersRootPath / "impostor.fs.glsl"},
+          gpuPicking ? "#define DRAW_IDS 1\n" : "");
+      bindUniformBlocks(impostorProgram);
+      impostors = std::make_unique<Impostors>(GLsizei(impostorMeshes.size()),
+          impostorNodeCount, std::move(impostorProgram));
+      impostorCoverageProgram = programCache.compileProgram(
+          {m_ShadersRootPath / m_vertexShader,
+              m_ShadersRootPath / "impostor_coverage.fs.glsl"},
+          "#define DEPTH_ONLY 1\n" + skinningDefines);
+      bindUniformBlocks(impostorCoverageProgram);
+    }
+  }
+  // With --shadow-maps, shadowProgram draws the cascades like depthProgram,
+  // reading positions only, and always from DrawUniforms
+  std::unique_ptr<ShadowCascades> shadowCascades;
+  GLProgram shadowProgram;
+  auto shadows = true;
+  // Cascades rendered by the last drawn view, 0 when all were cached
+  size_t renderedCascadeCount = 0;
+  if (m_options.shadowMaps) {
+    shadowCascades = std::make_unique<ShadowCascades>();
+    shadowProgram = programCache.compileProgram(
+        {m_ShadersRootPath / m_vertexShader,
+            m_ShadersRootPath / "depth_only.fs.glsl"},
+        "#define DEPTH_ONLY 1\n" + skinningDefines);
+    bindUniformBlocks(shadowProgram);
+    for (const auto &block : {std::make_pair("Draws", DRAWS_BINDING),
+             std::make_pair("Joints", JOINTS_BINDING)}) {
+      const auto blockIndex = glGetProgramResourceIndex(
+          shadowProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+      if (blockIndex != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(
+            shadowProgram.glId(), blockIndex, block.second);
+      }
+    }
+  }
+  // Draws whose box is in the light frustum of the cascade being rendered
+  std::vector<uint8_t> shadowCasters;
+  // Casters whose box diagonal covers less texels of a cascade are skipped,
+  // levels of detail of --lod are chosen for their error to be at most
+  // SHADOW_LOD_TEXEL_ERROR texels of it
+  const auto MIN_SHADOW_CASTER_TEXELS = 1.f;
+  const auto SHADOW_LOD_TEXEL_ERROR = 1.f;
+
+  // Draw in the depth pre-pass, then shade in an equal depth test
+  const auto beginDepthPrepass = [&]() {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  };
+  const auto endDepthPrepass = [&]() {
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+  };
+  const auto endShadingPass = [&]() {
+    glDepthFunc(depthFunc);
+    glDepthMask(GL_TRUE);
+  };
+  // Shade the G-buffer drawn since gbuffer->begin() in the framebuffer bound
+  // before, for the projection of FrameUniforms
+  const auto shadeGBuffer = [&](const glm::mat4 &projMatrix) {
+    gbuffer->end();
+    if (ambientOcclusion && applyAmbientOcclusion) {
+      // Occluders within a twentieth of the scene
+      const auto sceneBounds = primitiveBvh.nodes.empty()
+                                   ? BoundingBox()
+                                   : primitiveBvh.nodes[0].bounds;
+      const auto radius =
+          sceneBounds.isEmpty()
+              ? 1.f
+              : 0.05f * glm::length(sceneBounds.max - sceneBounds.min);
+      GLint viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      ambientOcclusion->compute(viewport[2], viewport[3], projMatrix, radius);
+    }
+    lightingProgram.use();
+    lightingProgram.setUniform(uApplyAmbientOcclusion,
+        GLint(ambientOcclusion && applyAmbientOcclusion));
+    lightingProgram.setUniform(
+        uLightingInverseProjMatrix, glm::inverse(projMatrix));
+    gbuffer->drawLightingPass();
+    ++drawStats.drawCalls;
+    ++drawStats.uniformUploads;
+    glslProgram.use();
+  };
+
+  // cullProgram is only linked with --gpu-culling
+  const auto getCullUniformLocation = [&](const GLchar *name) {
+    return gpuCulling ? cullProgram.getUniformLocation(name) : -1;
+  };
+  const auto uCullCommandCount = getCullUniformLocation("uCommandCount");
+  const auto uCullFrustumPlanes = getCullUniformLocation("uFrustumPlanes");
+  const auto uCullFrustumCulling = getCullUniformLocation("uFrustumCulling");
+  const auto uCullOcclusionCulling =
+      getCullUniformLocation("uOcclusionCulling");
+  const auto uCullPreviousViewProjMatrix =
+      getCullUniformLocation("uPreviousViewProjMatrix");
+  const auto uCullMeshletCulling = getCullUniformLocation("uMeshletCulling");
+  const auto uCullCameraPosition = getCullUniformLocation("uCameraPosition");
+  // Out of the units of material textures and of the passes after them
+  const auto depthPyramidUnit = 14;
+  if (gpuCulling) {
+    cullProgram.setUniform(uCullCommandCount, GLuint(indirectCommands.size()));
+    cullProgram.setUniform(
+        getCullUniformLocation("uDepthPyramid"), depthPyramidUnit);
+  }
+
+  // Textures and sampler objects bound to the units of material textures by
+  // bindTexture, to skip redundant binds. Reset at the start of each frame.
+  GLuint boundTextures[MATERIAL_TEXTURE_COUNT] = {};
+  GLuint boundSamplers[MATERIAL_TEXTURE_COUNT] = {};
+  const auto bindTexture = [&](GLuint unit, int textureIdx) {
+    const auto textureObject = getMaterialTexture(textureIdx);
+    if (boundTextures[unit] != textureObject) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      glBindTexture(textureTarget, textureObject);
+      boundTextures[unit] = textureObject;
+      ++drawStats.textureBinds;
+    }
+    const auto samplerObject = getMaterialSampler(textureIdx);
+    if (boundSamplers[unit] != samplerObject) {
+      glBindSampler(unit, samplerObject);
+      boundSamplers[unit] = samplerObject;
+    }
+  };
+
+  // With --profile, GPU time of the passes of frames and CPU time of their
+  // main steps, graphed in the GUI, and the pipeline statistics of the GPU
+  // passes if supported
+  std::unique_ptr<FrameProfiler> profiler;
+#ifndef GLTF_VIEWER_HEADLESS
+  size_t sceneGpuPass = 0, guiGpuPass = 0;
+  size_t frameCpuScope = 0, cameraCpuScope = 0;
+#endif
+  size_t traversalCpuScope = 0, materialsCpuScope = 0;
+  if (m_options.profileFrames && m_OutputPath.empty()) {
+    const auto pipelineStatistics =
+        hasGLExtension("GL_ARB_pipeline_statistics_query");
+    if (!pipelineStatistics) {
+      std::cerr << "Warning : pipeline statistics disabled, "
+                   "GL_ARB_pipeline_statistics_query is not supported"
+                << std::endl;
+    }
+    profiler = std::make_unique<FrameProfiler>(128, 4, pipelineStatistics);
+#ifndef GLTF_VIEWER_HEADLESS
+    sceneGpuPass = profiler->addGpuPass("GPU scene");
+    guiGpuPass = profiler->addGpuPass("GPU GUI");
+    frameCpuScope = profiler->addCpuScope("CPU frame");
+#endif
+    traversalCpuScope = profiler->addCpuScope("CPU traversal and culling");
+    materialsCpuScope = profiler->addCpuScope("CPU material binding");
+#ifndef GLTF_VIEWER_HEADLESS
+    cameraCpuScope = profiler->addCpuScope("CPU camera update");
+#endif
+  }
+  // With --frame-timing, timestamps of the frames, the histogram of their
+  // intervals and their hitches, attributed to the work marked below
+  std::ofstream frameTimingFile;
+  std::unique_ptr<FrameTiming> frameTiming;
+  if (m_options.frameTiming && m_OutputPath.empty()) {
+    frameTiming = std::make_unique<FrameTiming>();
+    if (!m_options.frameTimingPath.empty()) {
+      frameTimingFile.open(m_options.frameTimingPath.string());
+      if (!frameTimingFile) {
+        std::cerr << "Error : unable to write "
+                  << m_options.frameTimingPath.string() << std::endl;
+        return -1;
+      }
+      frameTiming->setCsvOutput(&frameTimingFile);
+    }
+  }
+#ifndef GLTF_VIEWER_HEADLESS
+  const auto markFrameWork = [&](FrameTiming::Work work) {
+    if (frameTiming) {
+      frameTiming->markWork(work);
+    }
+  };
+#endif
+
+  // With --stats-csv, a row of drawStats per frame or output view
+  std::ofstream drawStatsFile;
+  size_t drawStatsRow = 0;
+  if (!m_options.drawStatsPath.empty()) {
+    drawStatsFile.open(m_options.drawStatsPath.string());
+    if (!drawStatsFile) {
+      std::cerr << "Error : unable to write "
+                << m_options.drawStatsPath.string() << std::endl;
+      return -1;
+    }
+    writeDrawStatsCsvHeader(drawStatsFile);
+  }
+  // Write the row of the frame or view drawn, and start the next one
+  const auto endDrawStats = [&]() {
+    if (drawStatsFile.is_open()) {
+      writeDrawStatsCsvRow(drawStatsFile, drawStatsRow++, drawStats);
+    }
+    drawStats = DrawStats();
+  };
+
+  // Factors come from the material table, only textures are bound per
+  // material, on units matching the sampler uniforms
+  const auto bindMaterial = [&](const auto materialIndex) {
+    const CpuScopeTimer timer(profiler.get(), materialsCpuScope);
+    if (uMaterialIndex >= 0) {
+      glUniform1i(uMaterialIndex,
+          materialIndex >= 0 ? materialIndex : defaultMaterialIndex);
+      ++drawStats.uniformUploads;
+    }
+    if (useBindlessTextures) {
+      return;
+    }
+    const auto &textureIndices = getMaterialTextures(materialIndex);
+    for (GLuint unit = 0; unit < MATERIAL_TEXTURE_COUNT; ++unit) {
+      bindTexture(unit, textureIndices[unit]);
+    }
+  };
+
+  // Upload of the joint matrices, once recomputed
+  std::vector<glm::mat4> relativeJointMatrices;
+  const auto updateJointBuffer = [&]() {
+    const auto *matrices = &jointPalette->matrices();
+    // Their translations are only in float: skinned nodes keep the
+    // precision of their world matrices
+    if (cameraRelative) {
+      relativeJointMatrices = *matrices;
+      for (auto &matrix : relativeJointMatrices) {
+        matrix[3] -= glm::vec4(glm::vec3(renderOrigin), 0);
+      }
+      matrices = &relativeJointMatrices;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, jointBuffer.glId());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+        matrices->size() * sizeof(glm::mat4), matrices->data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    drawStats.uploadedBufferBytes += matrices->size() * sizeof(glm::mat4);
+  };
+
+  // Nodes that moved get their matrices, bounds and draw data recomputed.
+  // With --taa, their matrices of the previous frame are kept until the
+  // frame after, for motion vectors.
+  auto hasPreviousMotion = false;
+  const auto updateMovedNodes = [&]() {
+    if (animationPlayer) {
+      animationPlayback.samplePose(*animationPlayer, flatScene);
+    }
+    if (hasPreviousMotion) {
+      flatScene.previousWorldMatrices = flatScene.worldMatrices;
+      flatScene.previousWorldTranslations = flatScene.worldTranslations;
+      hasPreviousMotion = false;
+      if (flatScene.dirtyNodes.empty()) {
+        updateDrawData();
+      }
+    }
+    if (!flatScene.dirtyNodes.empty()) {
+      hasPreviousMotion = !flatScene.previousWorldMatrices.empty();
+      updateWorldMatrices(flatScene);
+      if (jointPalette) {
+        jointPalette->update(flatScene);
+        updateJointBuffer();
+        if (skinningPrepass) {
+          skinningPrepass->run();
+          reduceSkinnedBounds();
+        }
+      }
+      updatePrimitiveBounds();
+      updateSubtreeBounds(
+          flatScene, primitiveBounds, firstPrimitiveBounds, skinnedEntries);
+      refitBvh(primitiveBvh, primitiveBounds);
+      coherentCuller.reset();
+      updateDrawData();
+      if (gpuCulling) {
+        updateDrawBounds();
+      }
+      if (shadowCascades) {
+        shadowCascades->invalidate();
+      }
+    }
+  };
+
+  // Variant of KHR_materials_variants drawn, -1 for the materials of the
+  // primitives. Switching only changes the material of draws: the range of
+  // their DrawData changed is uploaded again and the draw order regrouped,
+  // nothing is loaded.
+  auto activeVariant = -1;
+  const auto selectVariant = [&](int variant) {
+    if (variant == activeVariant) {
+      return;
+    }
+    activeVariant = variant;
+    auto changedBegin = drawCommands.size();
+    auto changedEnd = size_t(0);
+    for (size_t i = 0; i < drawCommands.size(); ++i) {
+      auto &command = drawCommands[i];
+      const auto material =
+          runtimeScene.variantMaterial(size_t(command.primitive), variant);
+      if (material != command.material) {
+        command.material = material;
+        drawData[i].materialIndex =
+            material >= 0 ? material : defaultMaterialIndex;
+        changedBegin = std::min(changedBegin, i);
+        changedEnd = i + 1;
+      }
+    }
+    if (changedBegin >= changedEnd) {
+      return;
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer.glId());
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, changedBegin * sizeof(DrawData),
+        (changedEnd - changedBegin) * sizeof(DrawData),
+        drawData.data() + changedBegin);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    drawStats.uploadedBufferBytes +=
+        (changedEnd - changedBegin) * sizeof(DrawData);
+    drawOrder = getDrawOrder(drawCommands);
+    if (textureArrays) {
+      sortDrawOrderByTextureSet();
+    }
+    sortDrawOrderByProgram();
+    if (gpuCulling) {
+      createAllCommands();
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    if (shadowCascades) {
+      shadowCascades->invalidate();
+    }
+  };
+  // With --lazy-resources, materials of the variants whose textures are
+  // created while the loop is idle, so that switching does not wait for them
+  std::vector<int> preloadedVariantMaterials;
+  if (lazyTextures) {
+    for (const auto &primitive : runtimeScene.primitives) {
+      for (const auto material : primitive.variantMaterials) {
+        if (material >= 0 && material != primitive.material) {
+          preloadedVariantMaterials.push_back(material);
+        }
+      }
+    }
+    auto &materials = preloadedVariantMaterials;
+    std::sort(begin(materials), end(materials));
+    materials.erase(
+        std::unique(begin(materials), end(materials)), end(materials));
+  }
+  if (!m_options.variant.empty()) {
+    const auto &variants = runtimeScene.variants;
+    const auto it =
+        std::find(begin(variants), end(variants), m_options.variant);
+    if (it != end(variants)) {
+      selectVariant(int(it - begin(variants)));
+    } else {
+      std::cerr << "Warning : no material variant named " << m_options.variant
+                << std::endl;
+    }
+  }
+
+  // A view matrix of world space made relative to renderOrigin, for the
+  // world matrices of getDrawUniforms. Cameras are lookAt matrices built
+  // from relative points instead (see drawScene).
+  const auto getRelativeViewMatrix = [&](const glm::mat4 &viewMatrix) {
+    return glm::mat4(
+        glm::dmat4(viewMatrix) * glm::translate(glm::dmat4(1), renderOrigin));
+  };
+
+  // Render the cascades of shadowCascades that are not cached, one draw per
+  // draw command: they are rarely rendered, instancing is not worth their
+  // own draw tables. Casters are culled by the BVH of the main view against
+  // the light frustum of each cascade, with the vertex streams of
+  // --interleave-vertices the depth pass only fetches their positions.
+  // Returns the number of cascades rendered.
+  const auto renderShadowCascades = [&]() {
+    // Cascades keep the depth conventions of their sampler comparisons
+    if (reversedZ) {
+      clipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+      glClearDepth(1.);
+      glDepthFunc(GL_LESS);
+    }
+    size_t cascadeCount = 0;
+    for (size_t c = 0; c < ShadowCascades::CASCADE_COUNT; ++c) {
+      if (!shadowCascades->needsRender(c)) {
+        continue;
+      }
+      const auto &lightViewMatrix = shadowCascades->lightViewMatrix();
+      FrameUniforms cascadeUniforms;
+      cascadeUniforms.viewMatrix =
+          cameraRelative ? getRelativeViewMatrix(lightViewMatrix)
+                         : lightViewMatrix;
+      cascadeUniforms.projMatrix = shadowCascades->getProjMatrix(c);
+      uniformRing.bindBlock(FRAME_UNIFORMS_BINDING, cascadeUniforms);
+      ++drawStats.uniformUploads;
+      drawStats.uploadedBufferBytes += sizeof(cascadeUniforms);
+      cullBvh(primitiveBvh, primitiveBounds,
+          getFrustum(cascadeUniforms.projMatrix * lightViewMatrix),
+          shadowCasters);
+      // Receivers only: BLEND materials and points and lines, whose depth
+      // would cast opaque shadows. And casters smaller than a texel.
+      const auto texelSize = shadowCascades->getTexelSize(c);
+      for (size_t i = 0; i < shadowCasters.size(); ++i) {
+        if (!shadowCasters[i]) {
+          continue;
+        }
+        const auto &command = drawCommands[i];
+        const auto &bounds = primitiveBounds[i];
+        const auto isCaster =
+            drawVisibility.isDrawVisible(i) &&
+            runtimeScene.material(command.material).alphaMode !=
+                AlphaMode::Blend &&
+            command.mode != GL_POINTS && command.mode != GL_LINES &&
+            command.mode != GL_LINE_LOOP && command.mode != GL_LINE_STRIP &&
+            glm::length(bounds.max - bounds.min) >=
+                MIN_SHADOW_CASTER_TEXELS * texelSize;
+        if (!isCaster) {
+          shadowCasters[i] = 0;
+          ++drawStats.culledPrimitives;
+        }
+      }
+      if (lazyGeometry) {
+        createVisibleResources(&shadowCasters, false);
+      }
+
+      shadowCascades->beginCascade(c);
+      shadowProgram.use();
+      GLuint currentVertexArray = 0;
+      for (size_t drawIdx = 0; drawIdx < drawCommands.size(); ++drawIdx) {
+        if (!shadowCasters[drawIdx]) {
+          continue;
+        }
+        const auto &command = drawCommands[drawIdx];
+        uniformRing.bindBlock(
+            DRAW_UNIFORMS_BINDING, getDrawUniforms(size_t(command.node)));
+        ++drawStats.uniformUploads;
+        drawStats.uploadedBufferBytes += sizeof(DrawUniforms);
+        const auto vertexArray =
+            sharedBuffers ? packedVertexArray.glId() : command.vertexArray;
+        if (vertexArray != currentVertexArray) {
+          currentVertexArray = vertexArray;
+          glBindVertexArray(currentVertexArray);
+          ++drawStats.vertexArrayBinds;
+          if (vertexStreamBuffer.glId()) {
+            const auto isStream =
+                vertexArray == vertexArrayObjects[command.primitive];
+            const auto offset =
+                isStream ? positionOffsets[command.primitive] : glm::vec3(0);
+            const auto scale =
+                isStream ? positionScales[command.primitive] : glm::vec3(1);
+            glUniform3fv(uPositionOffset, 1, glm::value_ptr(offset));
+            glUniform3fv(uPositionScale, 1, glm::value_ptr(scale));
+            drawStats.uniformUploads += 2;
+          }
+        }
+        // Coarsest level of detail whose error is hidden by the texels
+        GLuint firstIndex = 0;
+        GLuint indexCount = 0;
+        GLint baseVertex = 0;
+        if (sharedBuffers) {
+          const auto &range = packedGeometry.ranges[command.primitive];
+          firstIndex = range.firstIndex;
+          indexCount = range.indexCount;
+          baseVertex = range.baseVertex;
+        }
+        if (sharedBuffers && !packedGeometry.lods.empty()) {
+          const auto &worldMatrix = flatScene.worldMatrices[command.node];
+          const auto scale = std::max(glm::length(glm::vec3(worldMatrix[0])),
+              std::max(glm::length(glm::vec3(worldMatrix[1])),
+                  glm::length(glm::vec3(worldMatrix[2]))));
+          for (const auto &lod : packedGeometry.lods[command.primitive]) {
+            if (lod.error * scale > SHADOW_LOD_TEXEL_ERROR * texelSize) {
+              break;
+            }
+            firstIndex = lod.firstIndex;
+            indexCount = lod.indexCount;
+          }
+        }
+        if (sharedBuffers) {
+          if (command.minIndex <= command.maxIndex) {
+            glDrawRangeElementsBaseVertex(command.mode, command.minIndex,
+                command.maxIndex, indexCount, GL_UNSIGNED_INT,
+                (const GLvoid *)(firstIndex * sizeof(uint32_t)), baseVertex);
+          } else {
+            glDrawElementsBaseVertex(command.mode, indexCount, GL_UNSIGNED_INT,
+                (const GLvoid *)(firstIndex * sizeof(uint32_t)), baseVertex);
+          }
+        } else if (command.indexType && command.minIndex <= command.maxIndex) {
+          glDrawRangeElements(command.mode, command.minIndex,
+              command.maxIndex, command.count, command.indexType,
+              (const GLvoid *)command.indexByteOffset);
+        } else if (command.indexType) {
+          glDrawElements(command.mode, command.count, command.indexType,
+              (const GLvoid *)command.indexByteOffset);
+        } else {
+          glDrawArrays(command.mode, 0, command.count);
+        }
+        ++drawStats.drawCalls;
+        drawStats.addTriangles(command.mode,
+            sharedBuffers ? indexCount : GLuint(command.count), 1);
+      }
+      glBindVertexArray(0);
+      shadowCascades->endCascade(c);
+      ++cascadeCount;
+    }
+    if (reversedZ) {
+      clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+      glClearDepth(0.);
+      glDepthFunc(depthFunc);
+    }
+    return cascadeCount;
+  };
+
+  PrimitivePicker primitivePicker(firstPrimitiveBounds, primitiveBounds);
+#ifndef GLTF_VIEWER_HEADLESS
+  const auto pickPrimitive = [&](const Camera &camera) {
+    double x = 0, y = 0;
+    glfwGetCursorPos(m_GLFWHandle->window(), &x, &y);
+    const auto cursor = glm::vec2(float(x), float(m_nWindowHeight - y));
+    const auto viewportSize =
+        glm::vec2(float(m_nWindowWidth), float(m_nWindowHeight));
+    primitivePicker.pick(rayQueries.intersect(primitiveBvh, primitiveBounds,
+        getRayQueryItems(),
+        getCursorRay(
+            cursor, viewportSize, camera.getViewMatrix(), projMatrix)));
+  };
+#endif
+  // With --gpu-picking, the draw under the cursor is instead read back from
+  // the draw IDs of sceneImage, drawn in its bottom left drawIdsWidth x
+  // drawIdsHeight pixels, by the frames after a Ctrl+click
+  std::unique_ptr<DrawIdPicker> drawIdPicker;
+  // The picked node is then outlined from the same draw IDs, over the scene
+  // image copied to the window
+  std::unique_ptr<SelectionOutline> selectionOutline;
+#ifndef GLTF_VIEWER_HEADLESS
+  auto selectionOutlineWidth = SELECTION_OUTLINE_WIDTH;
+#endif
+  if (gpuPicking) {
+    drawIdPicker = std::make_unique<DrawIdPicker>();
+    selectionOutline = std::make_unique<SelectionOutline>(
+        programCache.compileProgram(
+            {m_ShadersRootPath / "selection_mask.cs.glsl"}),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "jump_flood.cs.glsl"}),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+                m_ShadersRootPath / "selection_outline.fs.glsl"}));
+  }
+  // With --path-trace, drawScene traces the triangles of the scene with
+  // pathTracer instead of drawing them. Their world space triangles are
+  // those of the first frame, and only the first level of LOD groups is
+  // traced, others would overlap it.
+  std::unique_ptr<PathTracer> pathTracer;
+  if (m_options.pathTraceSampleCount > 0 &&
+      (depthPyramid || gpuPicking || stereo || multiViewport ||
+          m_options.refineFrameCount > 0 || m_options.targetFrameTime > 0)) {
+    std::cerr << "Warning : path tracing disabled, not with occlusion "
+                 "culling, GPU picking, stereo, multiple viewports, refined "
+                 "frames nor a target frame time"
+              << std::endl;
+  } else if (m_options.pathTraceSampleCount > 0) {
+    const auto start = std::chrono::steady_clock::now();
+    auto traceProgram = programCache.compileProgram(
+        {m_ShadersRootPath / "path_trace.cs.glsl"},
+        std::string(m_options.hardwareSrgb ? "#define HARDWARE_SRGB 1\n"
+                                           : "") +
+            (environmentMap ? "#define IMAGE_BASED_LIGHTING 1\n" : ""));
+    setupProgram(traceProgram);
+    // Layers of --texture-arrays are not sampled, only bindless textures
+    traceProgram.setUniform(
+        traceProgram.getUniformLocation("uBindlessTextures"),
+        GLint(useBindlessTextures));
+    pathTracer = std::make_unique<PathTracer>(std::move(traceProgram),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+                m_ShadersRootPath / "path_trace_resolve.fs.glsl"}));
+    std::vector<uint8_t> isTraced(flatScene.size(), 1);
+    for (const auto &group : flatScene.lodGroups) {
+      for (size_t level = 1; level < group.levels.size(); ++level) {
+        const auto root = size_t(group.levels[level]);
+        std::fill(begin(isTraced) + root,
+            begin(isTraced) + flatScene.subtreeEnds[root], 0);
+      }
+    }
+    std::vector<PathTracerItem> items;
+    for (const auto &command : drawCommands) {
+      if (isTraced[command.node]) {
+        items.push_back(PathTracerItem{command.primitive,
+            command.material >= 0 ? command.material : defaultMaterialIndex,
+            flatScene.worldMatrices[command.node]});
+      }
+    }
+    const auto triangleCount = pathTracer->build(model, bufferBytes, items);
+    std::clog << "Built the BVH of " << triangleCount
+              << " triangles to trace in "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << " s\n";
+  }
+  // With --hdr, the scene is drawn in the framebuffer of toneMapping, then
+  // exposed from its luminance and tone mapped to the current one. The
+  // exposure is measured by each frame, unless measureExposure is false.
+  // With --taa, frames are also blended with the previous ones by
+  // temporalAntiAliasing, which drawScene jitters.
+  std::unique_ptr<TemporalAntiAliasing> temporalAntiAliasing;
+  std::unique_ptr<ToneMapping> toneMapping;
+  if (m_options.hdr && (depthPyramid || drawIdPicker)) {
+    std::cerr << "Warning : HDR disabled, not with occlusion culling or GPU "
+                 "picking"
+              << std::endl;
+  } else if (m_options.hdr) {
+    // With --bloom, bright pixels glow over a blur of the scene mixed in by
+    // the tone mapping pass
+    std::unique_ptr<Bloom> bloom;
+    if (m_options.bloom) {
+      bloom = std::make_unique<Bloom>(
+          programCache.compileProgram(
+              {m_ShadersRootPath / "bloom_downsample.cs.glsl"}),
+          programCache.compileProgram(
+              {m_ShadersRootPath / "bloom_upsample.cs.glsl"}));
+    }
+    if (motionVectors) {
+      temporalAntiAliasing =
+          std::make_unique<TemporalAntiAliasing>(programCache.compileProgram(
+              {m_ShadersRootPath / "temporal_resolve.cs.glsl"},
+              depthDefines));
+      flatScene.previousWorldMatrices = flatScene.worldMatrices;
+      flatScene.previousWorldTranslations = flatScene.worldTranslations;
+    }
+    toneMapping = std::make_unique<ToneMapping>(
+        programCache.compileProgram(
+            {m_ShadersRootPath / "luminance_histogram.cs.glsl"}),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "adapt_exposure.cs.glsl"}),
+        programCache.compileProgram(
+            {m_ShadersRootPath / "fullscreen_triangle.vs.glsl",
+                m_ShadersRootPath / "tone_mapping.fs.glsl"},
+            bloom ? "#define BLOOM 1\n" : ""),
+        std::move(bloom), temporalAntiAliasing.get());
+  }
+  if (m_options.bloom && !toneMapping) {
+    std::cerr << "Warning : bloom disabled, only with HDR" << std::endl;
+  }
+  if (m_options.temporalAntiAliasing && m_OutputPath.empty() &&
+      !m_nextOutputJob && !temporalAntiAliasing) {
+    std::cerr << "Warning : temporal antialiasing disabled, only with HDR "
+                 "and without --refine"
+              << std::endl;
+  }
+  // With --variable-rate-shading, the draws of each frame are shaded
+  // coarser where the previous one is flat or far from the center of the
+  // view. Output images are shaded per pixel, not from the rates of another
+  // view.
+  std::unique_ptr<ShadingRateImage> shadingRateImage;
+  ShadingRateImageFunctions shadingRateFunctions;
+  if (m_options.variableRateShading && m_OutputPath.empty() &&
+      !m_nextOutputJob) {
+    if (!toneMapping) {
+      std::cerr << "Warning : variable rate shading disabled, only with HDR"
+                << std::endl;
+    } else if (!loadShadingRateImageFunctions(shadingRateFunctions)) {
+      std::cerr << "Warning : variable rate shading disabled, "
+                   "GL_NV_shading_rate_image is not supported"
+                << std::endl;
+    } else {
+      shadingRateImage =
+          std::make_unique<ShadingRateImage>(shadingRateFunctions,
+              programCache.compileProgram(
+                  {m_ShadersRootPath / "shading_rate.cs.glsl"}));
+    }
+  }
+  auto measureExposure = true;
+  GLsizei drawIdsWidth = 0, drawIdsHeight = 0;
+
+  // Work of drawScene on the CPU before its GL calls, for a camera: the
+  // visible draws and, without --multi-draw, their runs of instances. With
+  // --pipelined, the packet of the next frame is built by a job while the
+  // current one is drawn.
+  struct FramePacket
+  {
+    Camera camera;
+    bool testVisibility = false;
+    std::vector<uint8_t> visiblePrimitives;
+    std::vector<InstanceRun> instanceRuns;
+    std::vector<GLuint> instanceDraws;
+    // Runs of cutouts then of blended draws start there, after the opaque
+    // ones
+    size_t cutoutRunBegin = 0;
+    size_t blendRunBegin = 0;
+    std::vector<GLuint> cutoutDraws;
+    std::vector<GLuint> blendDraws;
+    size_t drawnPrimitiveCount = 0;
+    size_t culledPrimitiveCount = 0;
+    size_t testedCullNodeCount = 0;
+    size_t reusedCullNodeCount = 0;
+    // With --impostors, nodes drawn as impostors and their instances
+    std::vector<uint8_t> impostorNodes;
+    std::vector<Impostors::Instance> impostorInstances;
+    // With --compute-points, the visible draws of point clouds
+    std::vector<PointClouds::Draw> pointCloudInstances;
+  };
+  // Only reads the scene, moved nodes must be updated before. The levels of
+  // detail of groups are selected for the whole image, without tileMatrix.
+  const auto buildFramePacket = [&](const glm::mat4 &tileMatrix,
+                                    bool cullFrustum, FramePacket &packet) {
+    const TraceZone zone("buildFramePacket");
+    const auto viewMatrix = packet.camera.getViewMatrix();
+    packet.testedCullNodeCount = 0;
+    packet.reusedCullNodeCount = 0;
+    if (cullFrustum && !gpuCulling && stereo) {
+      // Both eyes at once
+      cullBvh(primitiveBvh, primitiveBounds,
+          getStereoFrustum(tileMatrix * projMatrix, viewMatrix,
+              m_options.stereoSeparation, m_options.stereoConvergence),
+          packet.visiblePrimitives);
+    } else if (cullFrustum && !gpuCulling && m_options.coherentCulling &&
+               !multiViewport) {
+      coherentCuller.cull(primitiveBvh, primitiveBounds, viewMatrix,
+          tileMatrix * projMatrix, packet.visiblePrimitives);
+      packet.testedCullNodeCount = coherentCuller.testedNodeCount();
+      packet.reusedCullNodeCount = coherentCuller.reusedNodeCount();
+    } else if (cullFrustum && !gpuCulling) {
+      cullBvh(primitiveBvh, primitiveBounds,
+          getFrustum(tileMatrix * projMatrix * viewMatrix),
+          packet.visiblePrimitives);
+    }
+    // Draws of levels of detail that are not selected are culled too
+    const auto selectLods = !flatScene.lodGroups.empty() && !gpuCulling;
+    if (selectLods) {
+      selectLodLevels(viewMatrix, projMatrix);
+      if (cullFrustum) {
+        for (size_t i = 0; i < packet.visiblePrimitives.size(); ++i) {
+          packet.visiblePrimitives[i] &= lodVisibleDraws[i];
+        }
+      } else {
+        packet.visiblePrimitives = lodVisibleDraws;
+      }
+    }
+    // And those of hidden nodes, tested by the shader with --gpu-culling
+    const auto cullHidden = !drawVisibility.allVisible() && !gpuCulling;
+    if (cullHidden) {
+      if (!(cullFrustum && !gpuCulling) && !selectLods) {
+        packet.visiblePrimitives.assign(drawCommands.size(), 1);
+      }
+      for (size_t i = 0; i < packet.visiblePrimitives.size(); ++i) {
+        packet.visiblePrimitives[i] &= uint8_t(drawVisibility.isDrawVisible(i));
+      }
+    }
+    packet.testVisibility =
+        (cullFrustum && !gpuCulling) || selectLods || cullHidden;
+    // Visible nodes of impostors whose sphere covers less than a frame of
+    // pixels of the whole image, like levels of detail
+    packet.impostorInstances.clear();
+    if (impostors) {
+      packet.impostorNodes.assign(flatScene.size(), 0);
+      const auto eye = packet.camera.eye();
+      const auto pixelScale =
+          0.5f * float(m_nWindowHeight) * projMatrix[1][1];
+      for (size_t nodeIdx = 0; nodeIdx < flatScene.size(); ++nodeIdx) {
+        const auto layer = impostorNodeLayers[nodeIdx];
+        if (layer < 0) {
+          continue;
+        }
+        const auto firstDraw = firstPrimitiveBounds[nodeIdx];
+        if (packet.testVisibility) {
+          const auto draws = begin(packet.visiblePrimitives) + firstDraw;
+          const auto drawCount =
+              meshToVA[size_t(flatScene.meshes[nodeIdx])].count;
+          if (std::none_of(draws, draws + drawCount,
+                  [](uint8_t visible) { return visible != 0; })) {
+            continue;
+          }
+        }
+        const auto &sphere = impostorSpheres[size_t(layer)];
+        const auto &matrix = flatScene.worldMatrices[nodeIdx];
+        const auto center =
+            glm::vec3(matrix * glm::vec4(glm::vec3(sphere), 1));
+        const auto scale = std::max({glm::length(glm::vec3(matrix[0])),
+            glm::length(glm::vec3(matrix[1])),
+            glm::length(glm::vec3(matrix[2]))});
+        if (2.f * sphere.w * scale * pixelScale >=
+            float(Impostors::FRAME_SIZE) * glm::length(center - eye)) {
+          continue;
+        }
+        packet.impostorNodes[nodeIdx] = 1;
+        packet.impostorInstances.push_back(
+            {matrix, sphere, layer, GLuint(firstDraw + 1), {}});
+      }
+    }
+    packet.drawnPrimitiveCount = 0;
+    packet.culledPrimitiveCount = 0;
+    packet.instanceRuns.clear();
+    packet.instanceDraws.clear();
+    packet.cutoutDraws.clear();
+    packet.blendDraws.clear();
+    packet.cutoutRunBegin = 0;
+    packet.blendRunBegin = 0;
+    packet.pointCloudInstances.clear();
+    if (multiDraw) {
+      return; // Commands are built by buildIndirectCommands
+    }
+
+    // Runs of visible draws sharing their primitive and material, each drawn
+    // as one instanced draw of the instanceDraws in [begin, end). Queried
+    // draws are runs of one draw.
+    auto &runs = packet.instanceRuns;
+    auto &draws = packet.instanceDraws;
+    const auto addDraw = [&](size_t drawIdx, size_t firstRun) {
+      const auto &command = drawCommands[drawIdx];
+      if (runs.size() == firstRun || queriedDraws[drawIdx] ||
+          queriedDraws[draws.back()] ||
+          drawCommands[draws.back()].primitive != command.primitive ||
+          drawCommands[draws.back()].vertexArray != command.vertexArray ||
+          drawCommands[draws.back()].material != command.material) {
+        runs.push_back(InstanceRun{draws.size(), draws.size()});
+      }
+      draws.push_back(GLuint(drawIdx));
+      runs.back().end = draws.size();
+    };
+    for (const auto drawIdx : drawOrder) {
+      if (!packet.impostorInstances.empty() &&
+          packet.impostorNodes[size_t(drawCommands[drawIdx].node)]) {
+        continue;
+      }
+      if (packet.testVisibility && !packet.visiblePrimitives[drawIdx]) {
+        ++packet.culledPrimitiveCount;
+        continue;
+      }
+      ++packet.drawnPrimitiveCount;
+      if (drawPointClouds[drawIdx] >= 0) {
+        packet.pointCloudInstances.push_back({drawPointClouds[drawIdx],
+            flatScene.worldMatrices[size_t(drawCommands[drawIdx].node)]});
+        continue;
+      }
+      switch (getAlphaMode(drawCommands[drawIdx].material)) {
+      case AlphaMode::Opaque:
+        addDraw(drawIdx, 0);
+        break;
+      case AlphaMode::Mask:
+        packet.cutoutDraws.push_back(GLuint(drawIdx));
+        break;
+      case AlphaMode::Blend:
+        packet.blendDraws.push_back(GLuint(drawIdx));
+        break;
+      }
+    }
+    packet.cutoutRunBegin = runs.size();
+    for (const auto drawIdx : packet.cutoutDraws) {
+      addDraw(drawIdx, packet.cutoutRunBegin);
+    }
+    packet.blendRunBegin = runs.size();
+    sortBackToFront(packet.blendDraws, primitiveBounds, viewMatrix);
+    for (const auto drawIdx : packet.blendDraws) {
+      addDraw(drawIdx, packet.blendRunBegin);
+    }
+  };
+  FramePacket framePacket; // Of drawScene without a packet
+
+  // With a tileset, the contents of the tiles TilePager selects are loaded by
+  // jobs and drawn after the cutout draws of the model, by the program of the
+  // default draw loop, each tile with a Materials table of its own. Their
+  // materials are drawn opaque, their nodes still and not in shadow maps.
+  const auto tileset = m_scene->tileset;
+  std::unique_ptr<TilePager> tilePager;
+  if (tileset && (multiDraw || gbuffer || textureArrays)) {
+    std::cerr << "Warning : tileset not drawn, not with multi-draw, "
+                 "deferred shading nor texture arrays"
+              << std::endl;
+  } else if (tileset) {
+    tilePager = std::make_unique<TilePager>(*tileset,
+        m_options.tileRamBudget << 20, m_options.tileVramBudget << 20,
+        m_options.tileMaxScreenSpaceError);
+  }
+  // Contents loading at the same time, and created per frame
+  const size_t maxTileLoads = 4;
+  const size_t maxTileUploads = 2;
+  // Content of a tile being loaded, owned by its job too: runScene can
+  // return before it is done
+  struct TileLoad
+  {
+    size_t tile;
+    JobSystem::Handle job;
+    std::shared_ptr<std::shared_ptr<LoadedScene>> scene;
+  };
+  std::vector<TileLoad> tileLoads;
+  const auto tileCount = tileset ? tileset->tiles.size() : size_t(0);
+  std::vector<std::shared_ptr<LoadedScene>> tileScenes(tileCount);
+  auto tileOptions = m_options;
+  tileOptions.sceneCache = false;
+  tileOptions.profileLoading = false;
+  // GL objects of an uploaded tile
+  struct TileObjects
+  {
+    GLTextures imageTextures;
+    GLSamplers samplerObjects;
+    GLBufferRanges bufferObjects;
+    GLVertexArrays vertexArrayObjects;
+    GLBuffer materialBuffer;
+    std::vector<GLuint64> residentHandles; // With bindless textures
+    // Texture and sampler object of the textures of each material slot
+    std::vector<std::array<std::pair<GLuint, GLuint>, MATERIAL_TEXTURE_COUNT>>
+        materialTextures;
+    // DrawUniforms of the nodes with a mesh, one every nodeUniformStride
+    // bytes: they never change, unlike those of uniformRing
+    GLBuffer nodeUniformBuffer;
+    GLsizeiptr nodeUniformStride = 0;
+    struct Draw
+    {
+      size_t node; // In nodeUniformBuffer
+      GLint material; // Slot in the Materials table
+      GLuint vertexArray;
+      GLenum mode;
+      GLsizei count;
+      GLenum indexType;
+      size_t indexByteOffset;
+      GLuint minIndex; // See DrawCommand
+      GLuint maxIndex;
+    };
+    std::vector<Draw> draws;
+    size_t gpuBytes = 0; // About, of its buffers and textures
+  };
+  std::vector<std::unique_ptr<TileObjects>> tileObjects(tileCount);
+  const auto createTileObjects = [&](size_t tileIdx) {
+    const TraceZone zone("createTileObjects");
+    const auto &content = *tileScenes[tileIdx];
+    const auto &tileModel = content.model;
+    auto objects = std::make_unique<TileObjects>();
+    objects->imageTextures = createTextureObjects(tileModel, textureUploader);
+    objects->samplerObjects = createSamplerObjects(tileModel);
+    std::vector<BufferViewRange> tileBufferViewRanges;
+    objects->bufferObjects = createBufferObjects(
+        tileModel, content.bufferBytes, tileBufferViewRanges);
+    std::vector<VaoRange> tileMeshToVA;
+    objects->vertexArrayObjects = createVertexArrayObjects(
+        tileModel, tileBufferViewRanges, tileMeshToVA);
+    for (size_t i = 0; i < tileBufferViewRanges.size(); ++i) {
+      if (tileBufferViewRanges[i].bufferObject) {
+        objects->gpuBytes += tileModel.bufferViews[i].byteLength;
+      }
+    }
+    for (size_t i = 0; i < tileModel.images.size(); ++i) {
+      if (objects->imageTextures[i]) {
+        // Mipmapped RGBA8
+        const auto &image = tileModel.images[i];
+        objects->gpuBytes +=
+            size_t(image.width) * size_t(image.height) * 16 / 3;
+      }
+    }
+
+    // Like getMaterialTexture and getMaterialSampler
+    const auto getTextureBinding = [&](int textureIdx) {
+      if (textureIdx >= 0) {
+        const auto &texture = tileModel.textures[textureIdx];
+        for (const auto source :
+            {getBasisuImageSource(texture), texture.source}) {
+          if (source >= 0 && objects->imageTextures[source]) {
+            return std::make_pair(objects->imageTextures[source],
+                texture.sampler >= 0
+                    ? objects->samplerObjects[texture.sampler]
+                    : objects->samplerObjects.back());
+          }
+        }
+      }
+      return std::make_pair(whiteTexture, samplerObjects.back());
+    };
+    const auto tileRuntimeScene =
+        buildRuntimeScene(tileModel, content.bufferBytes);
+    const auto &tileMaterials = tileRuntimeScene.materials;
+    std::vector<MaterialData> tileMaterialTable(tileMaterials.size());
+    objects->materialTextures.resize(tileMaterials.size());
+    std::map<std::pair<GLuint, GLuint>, GLuint64> tileHandles;
+    for (size_t i = 0; i < tileMaterials.size(); ++i) {
+      if (i + 1 < tileMaterials.size()) {
+        tileMaterialTable[i] = getMaterialData(tileMaterials[i]);
+      }
+      GLuint64 handles[MATERIAL_TEXTURE_COUNT] = {};
+      for (size_t unit = 0; unit < MATERIAL_TEXTURE_COUNT; ++unit) {
+        const auto binding = getTextureBinding(tileMaterials[i].textures[unit]);
+        objects->materialTextures[i][unit] = binding;
+        if (!useBindlessTextures) {
+          continue;
+        }
+        auto &handle = tileHandles[binding];
+        if (!handle && binding.first == whiteTexture) {
+          handle = getResidentHandle(-1);
+        } else if (!handle) {
+          handle = bindless.getTextureSamplerHandle(
+              binding.first, binding.second);
+          bindless.makeTextureHandleResident(handle);
+          objects->residentHandles.push_back(handle);
+        }
+        handles[unit] = handle;
+      }
+      auto &data = tileMaterialTable[i];
+      data.baseColorTexture = handles[0];
+      data.metallicRoughnessTexture = handles[1];
+      data.emissiveTexture = handles[2];
+      data.occlusionTexture = handles[3];
+      data.normalTexture = handles[4];
+    }
+    objects->materialBuffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, objects->materialBuffer.glId());
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        tileMaterialTable.size() * sizeof(MaterialData),
+        tileMaterialTable.data(), 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    const auto &contentMatrix = tileset->tiles[tileIdx].contentMatrix;
+    const auto tileScene =
+        flattenScene(tileModel, tileModel.defaultScene, content.bufferBytes);
+    std::vector<DrawUniforms> nodeUniforms;
+    for (size_t nodeIdx = 0; nodeIdx < tileScene.size(); ++nodeIdx) {
+      const auto meshIdx = tileScene.meshes[nodeIdx];
+      if (meshIdx < 0) {
+        continue;
+      }
+      const auto worldMatrix = contentMatrix * tileScene.worldMatrices[nodeIdx];
+      nodeUniforms.push_back(DrawUniforms{worldMatrix,
+          glm::transpose(glm::inverse(worldMatrix)), -1, {}, worldMatrix});
+      const auto &vaoRange = tileMeshToVA[meshIdx];
+      for (GLsizei prIdx = 0; prIdx < vaoRange.count; ++prIdx) {
+        const auto primitiveIdx = size_t(vaoRange.begin + prIdx);
+        const auto &primitive = tileRuntimeScene.primitives[primitiveIdx];
+        TileObjects::Draw draw;
+        draw.node = nodeUniforms.size() - 1;
+        draw.material =
+            GLint(tileRuntimeScene.materialSlot(primitive.material));
+        draw.vertexArray = objects->vertexArrayObjects[primitiveIdx];
+        draw.mode = primitive.mode;
+        draw.count = GLsizei(primitive.count);
+        draw.indexType = primitive.indexType;
+        draw.indexByteOffset =
+            primitive.indexType
+                ? primitive.indexByteOffset +
+                      tileBufferViewRanges[primitive.indexBufferView]
+                          .byteOffset
+                : 0;
+        draw.minIndex = primitive.minIndex;
+        draw.maxIndex = primitive.maxIndex;
+        objects->draws.push_back(draw);
+      }
+    }
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    objects->nodeUniformStride =
+        (GLsizeiptr(sizeof(DrawUniforms)) + alignment - 1) / alignment *
+        alignment;
+    std::vector<unsigned char> nodeUniformBytes(
+        std::max(nodeUniforms.size(), size_t(1)) *
+        size_t(objects->nodeUniformStride));
+    for (size_t i = 0; i < nodeUniforms.size(); ++i) {
+      std::memcpy(nodeUniformBytes.data() + i * objects->nodeUniformStride,
+          &nodeUniforms[i], sizeof(DrawUniforms));
+    }
+    objects->nodeUniformBuffer = GLBuffer::generate();
+    glBindBuffer(GL_UNIFORM_BUFFER, objects->nodeUniformBuffer.glId());
+    glBufferStorage(GL_UNIFORM_BUFFER, GLsizeiptr(nodeUniformBytes.size()),
+        nodeUniformBytes.data(), 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    objects->gpuBytes += nodeUniformBytes.size();
+    return objects;
+  };
+  const auto destroyTileObjects = [&](size_t tileIdx) {
+    for (const auto handle : tileObjects[tileIdx]->residentHandles) {
+      bindless.makeTextureHandleNonResident(handle);
+    }
+    tileObjects[tileIdx] = nullptr;
+  };
+
+  // Select the tiles of a view, then apply what tilePager plans: finished
+  // loads are reported, contents freed or loaded, GL objects destroyed or
+  // created
+  const auto pageTiles = [&](const glm::mat4 &viewMatrix,
+                             const glm::mat4 &projMatrix,
+                             GLsizei viewportHeight) {
+    const TraceZone zone("pageTiles");
+    for (auto load = tileLoads.begin(); load != tileLoads.end();) {
+      if (!load->job.done()) {
+        ++load;
+        continue;
+      }
+      auto &tileScene = tileScenes[load->tile];
+      tileScene = std::move(*load->scene);
+      if (tileScene) {
+        size_t cpuBytes = 0;
+        for (const auto &bytes : tileScene->bufferBytes) {
+          cpuBytes += bytes.size;
+        }
+        for (const auto &image : tileScene->model.images) {
+          cpuBytes += image.image.size();
+        }
+        tilePager->setLoaded(load->tile, cpuBytes);
+      } else {
+        tilePager->setLoadFailed(load->tile);
+      }
+      load = tileLoads.erase(load);
+    }
+
+    tilePager->select(viewMatrix, projMatrix, float(viewportHeight));
+    const auto plan = tilePager->update(maxTileLoads, maxTileUploads);
+    for (const auto tileIdx : plan.unloads) {
+      tileScenes[tileIdx] = nullptr;
+    }
+    for (const auto tileIdx : plan.evictions) {
+      destroyTileObjects(tileIdx);
+    }
+    for (const auto tileIdx : plan.uploads) {
+      tileObjects[tileIdx] = createTileObjects(tileIdx);
+      tilePager->setUploaded(tileIdx, tileObjects[tileIdx]->gpuBytes);
+    }
+    for (const auto tileIdx : plan.loads) {
+      TileLoad load;
+      load.tile = tileIdx;
+      load.scene = std::make_shared<std::shared_ptr<LoadedScene>>();
+      load.job = JobSystem::global().add(
+          [path = tileset->tiles[tileIdx].content, options = tileOptions,
+              scene = load.scene]() {
+            try {
+              *scene = loadScene(path, options);
+            } catch (const std::exception &e) {
+              std::cerr << "Error : " << e.what() << std::endl;
+            }
+          });
+      tileLoads.push_back(std::move(load));
+    }
+  };
+  // Page in the tiles of a view before it is drawn, as refined as the
+  // budgets let them be
+  const auto pageTilesUntilIdle = [&](const Camera &camera,
+                                      GLsizei viewportHeight) {
+    if (!tilePager) {
+      return;
+    }
+    const auto viewMatrix = camera.getViewMatrix();
+    pageTiles(viewMatrix, projMatrix, viewportHeight);
+    while (!tilePager->idle()) {
+      if (!tileLoads.empty()) {
+        JobSystem::global().wait(tileLoads.front().job);
+      }
+      pageTiles(viewMatrix, projMatrix, viewportHeight);
+    }
+  };
+
+  // Draw the tiles tilePager selected, in the state submitInstanceRuns
+  // leaves
+  const auto drawTiles = [&]() {
+    if (vertexStreamBuffer.glId()) {
+      glUniform3fv(uPositionOffset, 1, glm::value_ptr(glm::vec3(0)));
+      glUniform3fv(uPositionScale, 1, glm::value_ptr(glm::vec3(1)));
+      drawStats.uniformUploads += 2;
+    }
+    if (uDrawId >= 0) {
+      glUniform1ui(uDrawId, 0);
+      ++drawStats.uniformUploads;
+    }
+    for (const auto tileIdx : tilePager->selectedTiles()) {
+      const auto &objects = *tileObjects[tileIdx];
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIALS_BINDING,
+          objects.materialBuffer.glId());
+      auto currentMaterial = -1;
+      auto currentNode = std::numeric_limits<size_t>::max();
+      for (const auto &draw : objects.draws) {
+        if (draw.node != currentNode) {
+          currentNode = draw.node;
+          glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_UNIFORMS_BINDING,
+              objects.nodeUniformBuffer.glId(),
+              GLintptr(currentNode) * objects.nodeUniformStride,
+              sizeof(DrawUniforms));
+        }
+        if (draw.material != currentMaterial) {
+          currentMaterial = draw.material;
+          if (uMaterialIndex >= 0) {
+            glUniform1i(uMaterialIndex, currentMaterial);
+            ++drawStats.uniformUploads;
+          }
+          for (GLuint unit = 0;
+               unit < MATERIAL_TEXTURE_COUNT && !useBindlessTextures;
+               ++unit) {
+            // Like bindTexture
+            const auto &binding =
+                objects.materialTextures[size_t(currentMaterial)][unit];
+            if (boundTextures[unit] != binding.first) {
+              glActiveTexture(GL_TEXTURE0 + unit);
+              glBindTexture(GL_TEXTURE_2D, binding.first);
+              boundTextures[unit] = binding.first;
+              ++drawStats.textureBinds;
+            }
+            if (boundSamplers[unit] != binding.second) {
+              glBindSampler(unit, binding.second);
+              boundSamplers[unit] = binding.second;
+            }
+          }
+        }
+        glBindVertexArray(draw.vertexArray);
+        ++drawStats.vertexArrayBinds;
+        if (draw.indexType && draw.minIndex <= draw.maxIndex) {
+          glDrawRangeElements(draw.mode, draw.minIndex, draw.maxIndex,
+              draw.count, draw.indexType,
+              (const GLvoid *)draw.indexByteOffset);
+        } else if (draw.indexType) {
+          glDrawElements(draw.mode, draw.count, draw.indexType,
+              (const GLvoid *)draw.indexByteOffset);
+        } else {
+          glDrawArrays(draw.mode, 0, draw.count);
+        }
+        ++drawStats.drawCalls;
+        drawStats.addTriangles(draw.mode, GLuint(draw.count), 1);
+      }
+    }
+    glBindBufferBase(
+        GL_SHADER_STORAGE_BUFFER, MATERIALS_BINDING, materialBuffer.glId());
+  };
+
+  // Query the boxes of the queried draws of instanceRuns against the depth
+  // drawn so far, for the next drawScene. Boxes crossing the near plane would
+  // be clipped: they are not queried, and drawn unconditionally.
+  const auto queryOcclusion = [&](const glm::mat4 &viewMatrix,
+                                  const glm::mat4 &depthProjMatrix) {
+    const auto viewProjMatrix = depthProjMatrix * viewMatrix;
+    const auto isInFrontOfNearPlane = [&](const BoundingBox &bounds) {
+      for (size_t i = 0; i < 8; ++i) {
+        const auto corner = glm::vec3(i & 1 ? bounds.max.x : bounds.min.x,
+            i & 2 ? bounds.max.y : bounds.min.y,
+            i & 4 ? bounds.max.z : bounds.min.z);
+        const auto clip = viewProjMatrix * glm::vec4(corner, 1);
+        // The near plane is at depth 1 with --reversed-z
+        if (clip.w <= 0.f || (reversedZ ? clip.z > clip.w : clip.z < -clip.w)) {
+          return false;
+        }
+      }
+      return true;
+    };
+    occlusionBoxProgram.use();
+    glBindVertexArray(occlusionBoxVertexArray.glId());
+    ++drawStats.vertexArrayBinds;
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    // Surfaces can lie on the faces of their boxes
+    glDepthFunc(reversedZ ? GL_GEQUAL : GL_LEQUAL);
+    for (const auto &run : instanceRuns) {
+      const auto drawIdx = instanceDraws[run.begin];
+      const auto &bounds = primitiveBounds[drawIdx];
+      if (!queriedDraws[drawIdx] || bounds.isEmpty() ||
+          !isInFrontOfNearPlane(bounds)) {
+        continue;
+      }
+      // In the space of the view matrix of FrameUniforms
+      const auto origin = glm::vec3(renderOrigin);
+      occlusionBoxProgram.setUniform(uBoxMin, bounds.min - origin);
+      occlusionBoxProgram.setUniform(uBoxMax, bounds.max - origin);
+      drawStats.uniformUploads += 2;
+      glBeginQuery(
+          GL_ANY_SAMPLES_PASSED_CONSERVATIVE, occlusionQueries[drawIdx]);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+      occlusionQueryFrames[drawIdx] = occlusionQueryFrame;
+      ++drawStats.occlusionQueries;
+      ++drawStats.drawCalls;
+    }
+    glDepthFunc(depthFunc);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glBindVertexArray(0);
+    glslProgram.use();
+  };
+
+  // Lambda function to draw the scene, in a viewport of viewportWidth x
+  // viewportHeight pixels. For a tile of an output image, tileMatrix is
+  // applied after projMatrix (see getTileMatrix), levels of detail are
+  // still selected for the whole image. With a packet built for camera by
+  // buildFramePacket, its content is swapped with the state of the frame
+  // instead of built.
+  const auto drawScene = [&](const Camera &camera, const glm::mat4 &tileMatrix,
+                             GLsizei viewportWidth, GLsizei viewportHeight,
+                             FramePacket *packet = nullptr) {
+    const TraceZone zone("drawScene");
+    // With occlusion culling the scene is drawn in the framebuffer of the
+    // depth pyramid, then copied to the current one
+    GLint targetFramebuffer = 0;
+    if (depthPyramid) {
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+      depthPyramid->bindFramebuffer();
+    }
+    // With --srgb, colors are encoded when blending them into sRGB
+    // framebuffers, only for the draws of the scene: copies and the GUI
+    // write raw values
+    auto encodeOutput = true;
+    if (m_options.hardwareSrgb &&
+        glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) ==
+            GL_FRAMEBUFFER_COMPLETE) {
+      GLint drawFramebuffer = 0;
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+      GLint colorEncoding = GL_LINEAR;
+      glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER,
+          drawFramebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK_LEFT,
+          GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &colorEncoding);
+      encodeOutput = colorEncoding != GL_SRGB;
+    }
+    // With --path-trace, samples of a still view add up from frame to frame
+    // in the window, output images trace all of them at once
+    if (pathTracer) {
+      glViewport(0, 0, viewportWidth, viewportHeight);
+      PathTracer::View view;
+      view.viewMatrix = camera.getViewMatrix();
+      view.projMatrix = tileMatrix * projMatrix;
+      view.lightDirection =
+          lightFromCamera ? glm::vec3(glm::inverse(view.viewMatrix) *
+                                      glm::vec4(0, 0, 1, 0))
+                          : lightDirection;
+      view.lightIntensity = lightIntensity;
+      view.environmentIntensity = environmentMap ? environmentIntensity : 0.f;
+      view.width = viewportWidth;
+      view.height = viewportHeight;
+      if (environmentMap) {
+        environmentMap->bind(glm::mat4(1), environmentIntensity);
+      }
+      const auto isOutput = !m_OutputPath.empty() || m_nextOutputJob;
+      const auto sampleCount =
+          view == pathTracer->view() ? pathTracer->sampleCount() : 0;
+      if (sampleCount < m_options.pathTraceSampleCount) {
+        pathTracer->trace(view,
+            isOutput ? m_options.pathTraceSampleCount - sampleCount : 1);
+      }
+      if (!encodeOutput) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+      }
+      pathTracer->resolve(encodeOutput);
+      glDisable(GL_FRAMEBUFFER_SRGB);
+      return;
+    }
+    // With --hdr, the scene is drawn in linear values in the framebuffer of
+    // toneMapping, whose resolve encodes them as the scene would have
+    const auto encodeToneMapped = encodeOutput;
+    if (toneMapping) {
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &targetFramebuffer);
+      toneMapping->bindFramebuffer(viewportWidth, viewportHeight);
+      encodeOutput = false;
+    } else if (!encodeOutput) {
+      glEnable(GL_FRAMEBUFFER_SRGB);
+    }
+    const auto resolveToneMapping = [&]() {
+      if (shadingRateImage) {
+        shadingRateImage->end();
+      }
+      if (!encodeToneMapped) {
+        glEnable(GL_FRAMEBUFFER_SRGB);
+      }
+      toneMapping->resolve(GLuint(targetFramebuffer), viewportWidth,
+          viewportHeight, encodeToneMapped, measureExposure);
+      if (shadingRateImage) {
+        shadingRateImage->update(
+            toneMapping->colorTexture(), viewportWidth, viewportHeight);
+      }
+    };
+    glViewport(0, 0, viewportWidth, viewportHeight);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // glClear leaves integer buffers undefined, draw IDs are cleared apart
+    if (drawIdPicker || outputAovs) {
+      GLint drawIdBuffer = GL_NONE;
+      glGetIntegerv(GL_DRAW_BUFFER1, &drawIdBuffer);
+      if (drawIdBuffer != GL_NONE) {
+        const GLuint noDraw = 0;
+        glClearBufferuiv(GL_COLOR, 1, &noDraw);
+        drawIdsWidth = viewportWidth;
+        drawIdsHeight = viewportHeight;
+      }
+    }
+    // Geometry is cleared to zero depths, for pixels where nothing is drawn
+    if (outputAovs) {
+      GLint geometryBuffer = GL_NONE;
+      glGetIntegerv(GL_DRAW_BUFFER2, &geometryBuffer);
+      if (geometryBuffer != GL_NONE) {
+        const GLfloat noGeometry[] = {0.f, 0.f, 0.f, 0.f};
+        glClearBufferfv(GL_COLOR, 2, noGeometry);
+      }
+    }
+    // Motion vectors are cleared to none: the pixels of the background only
+    // move with the camera, which the resolve reprojects from their depth
+    if (temporalAntiAliasing) {
+      const GLfloat noMotion[] = {0.f, 0.f, 0.f, 0.f};
+      glClearBufferfv(GL_COLOR, 1, noMotion);
+    }
+    // Draws whose shaders only write colors, or blend them, keep the motion
+    // vectors (--taa) and the geometry (--output-aovs) behind them
+    const auto maskExtraOutputs = [&](bool mask) {
+      const auto write = mask ? GL_FALSE : GL_TRUE;
+      if (temporalAntiAliasing) {
+        glColorMaski(1, write, write, write, write);
+      }
+      if (outputAovs) {
+        glColorMaski(2, write, write, write, write);
+      }
+    };
+    if (shadingRateImage) {
+      shadingRateImage->begin();
+    }
+    // Densities follow the bounds of the draws, overdraw is counted by all
+    // the draws then drawn over the scene
+    if (debugView == DebugViews::TriangleDensity) {
+      drawTriangleDensities.resize(drawCommands.size());
+      for (size_t i = 0; i < drawCommands.size(); ++i) {
+        drawTriangleDensities[i] = getTriangleDensity(drawCommands[i].mode,
+            size_t(drawCommands[i].count), primitiveBounds[i]);
+      }
+      debugViews->setTriangleDensities(drawTriangleDensities);
+    }
+    const auto isOverdrawView = debugView == DebugViews::Overdraw;
+    if (isOverdrawView) {
+      debugViews->beginOverdraw(viewportWidth, viewportHeight);
+    }
+
+    const auto viewMatrix = camera.getViewMatrix();
+    // With --camera-relative, the Draws table and the joints are uploaded
+    // again with matrices relative to the new origin when it moves
+    if (cameraRelative && glm::distance(glm::dvec3(camera.eye()),
+                              renderOrigin) > RENDER_ORIGIN_DISTANCE) {
+      renderOrigin = glm::dvec3(camera.eye());
+      updateDrawData();
+      if (jointPalette) {
+        updateJointBuffer();
+      }
+    }
+    // Of the shaders, world space being relative to renderOrigin
+    const auto shaderViewMatrix =
+        cameraRelative
+            ? glm::lookAt(glm::vec3(glm::dvec3(camera.eye()) - renderOrigin),
+                  glm::vec3(glm::dvec3(camera.center()) - renderOrigin),
+                  camera.up())
+            : viewMatrix;
+    const auto viewProjMatrix = tileMatrix * projMatrix * viewMatrix;
+    const auto depthProjMatrix = getDepthProjMatrix(viewMatrix);
+    // With --taa, only the projection of the shaders is jittered, culling
+    // and the reprojection of the next frame use the unjittered one
+    const auto depthViewProjMatrix = tileMatrix * depthProjMatrix * viewMatrix;
+    const auto jitterMatrix =
+        temporalAntiAliasing
+            ? temporalAntiAliasing->beginFrame(
+                  depthViewProjMatrix, viewportWidth, viewportHeight)
+            : glm::mat4(1);
+    if (conditionalRender) {
+      const auto viewport = glm::ivec2(viewportWidth, viewportHeight);
+      if (tileMatrix != occlusionQueryTileMatrix ||
+          viewport != occlusionQueryViewport) {
+        resetOcclusionQueries();
+      }
+      ++occlusionQueryFrame;
+      occlusionQueryTileMatrix = tileMatrix;
+      occlusionQueryViewport = viewport;
+    }
+
+    uniformRing.beginFrame();
+    FrameUniforms frameUniforms;
+    frameUniforms.viewMatrix = shaderViewMatrix;
+    frameUniforms.projMatrix = jitterMatrix * tileMatrix * depthProjMatrix;
+    frameUniforms.lightDirection =
+        lightFromCamera
+            ? glm::vec3(0, 0, 1)
+            : glm::normalize(
+                  glm::vec3(viewMatrix * glm::vec4(lightDirection, 0.)));
+    frameUniforms.lightIntensity = lightIntensity;
+    frameUniforms.applyOcclusion =
+        GLint(applyOcclusion && !isInteractiveFrame);
+    frameUniforms.encodeOutput = GLint(encodeOutput);
+    frameUniforms.previousViewProjMatrix =
+        temporalAntiAliasing ? temporalAntiAliasing->previousViewProjMatrix()
+                             : depthViewProjMatrix;
+    if (cameraRelative) {
+      frameUniforms.previousViewProjMatrix =
+          getRelativeViewMatrix(frameUniforms.previousViewProjMatrix);
+    }
+    if (stereo) {
+      const auto eyeProjMatrices =
+          getStereoProjMatrices(frameUniforms.projMatrix,
+              m_options.stereoSeparation, m_options.stereoConvergence);
+      std::copy(begin(eyeProjMatrices), end(eyeProjMatrices),
+          frameUniforms.eyeProjMatrices);
+    }
+    uniformRing.bindBlock(FRAME_UNIFORMS_BINDING, frameUniforms);
+    ++drawStats.uniformUploads;
+    drawStats.uploadedBufferBytes += sizeof(frameUniforms);
+
+    // Draw the scene referenced by gltf file, nodes are visited in a linear
+    // loop over the flattened hierarchy. Only nodes that moved get their
+    // matrices recomputed
+    CpuScopeTimer traversalTimer(profiler.get(), traversalCpuScope);
+    if (!packet) {
+      updateMovedNodes();
+      framePacket.camera = camera;
+      buildFramePacket(tileMatrix, frustumCulling, framePacket);
+      packet = &framePacket;
+    }
+    if (lightClusters) {
+      // Lights follow the nodes once their world matrices are updated
+      lightClusters->update(flatScene, viewMatrix, tileMatrix * projMatrix,
+          viewportWidth, viewportHeight, punctualLights);
+    }
+    const auto testVisibility = packet->testVisibility;
+    visiblePrimitives.swap(packet->visiblePrimitives);
+    instanceRuns.swap(packet->instanceRuns);
+    cutoutRunBegin = packet->cutoutRunBegin;
+    blendRunBegin = packet->blendRunBegin;
+    instanceDraws.swap(packet->instanceDraws);
+    impostorInstances.swap(packet->impostorInstances);
+    pointCloudInstances.swap(packet->pointCloudInstances);
+    if (cameraRelative) {
+      const auto origin = glm::vec4(glm::vec3(renderOrigin), 0);
+      for (auto &instance : impostorInstances) {
+        instance.modelMatrix[3] -= origin;
+      }
+      for (auto &instance : pointCloudInstances) {
+        instance.modelMatrix[3] -= origin;
+      }
+    }
+    lodEye = camera.eye();
+    lodPixelSizeFactor = 2.f / (projMatrix[1][1] * float(m_nWindowHeight));
+    drawnPrimitiveCount = packet->drawnPrimitiveCount;
+    culledPrimitiveCount = packet->culledPrimitiveCount;
+    testedCullNodeCount = packet->testedCullNodeCount;
+    reusedCullNodeCount = packet->reusedCullNodeCount;
+    traversalTimer.stop();
+    // Before the draws of this frame, which sample them
+    if ((lazyTextures || lazyGeometry) &&
+        createVisibleResources(
+            testVisibility ? &visiblePrimitives : nullptr, true) &&
+        useBindlessTextures) {
+      uploadMaterialTextureHandles();
+    }
+
+    if (shadowCascades) {
+      // Cascades cover the whole view, whatever the tile drawn. A light
+      // following the camera casts no visible shadow.
+      shadowCascades->update(lightDirection,
+          primitiveBvh.nodes.empty() ? BoundingBox()
+                                     : primitiveBvh.nodes[0].bounds,
+          viewMatrix, projMatrix, shadows && !lightFromCamera);
+      renderedCascadeCount = renderShadowCascades();
+      if (renderedCascadeCount) {
+        uniformRing.bindBlock(FRAME_UNIFORMS_BINDING, frameUniforms);
+        ++drawStats.uniformUploads;
+        drawStats.uploadedBufferBytes += sizeof(frameUniforms);
+        glslProgram.use();
+      }
+      shadowCascades->bind();
+    }
+    if (environmentMap) {
+      environmentMap->bind(viewMatrix, environmentIntensity);
+    }
+
+    std::fill(std::begin(boundTextures), std::end(boundTextures), 0);
+    std::fill(std::begin(boundSamplers), std::end(boundSamplers), 0);
+    if (multiDraw) {
+      if (gpuCulling) {
+        // Commands are written to indirectBuffer by the culling shader
+        cullProgram.use();
+        cullProgram.setUniform(uCullFrustumCulling, GLint(frustumCulling));
+        const auto frustum =
+            stereo ? getStereoFrustum(tileMatrix * projMatrix, viewMatrix,
+                         m_options.stereoSeparation,
+                         m_options.stereoConvergence)
+                   : getFrustum(viewProjMatrix);
+        cullProgram.setUniform(uCullFrustumPlanes, frustum.planes, 6);
+        const auto testOcclusion =
+            depthPyramid && occlusionCulling && depthPyramid->hasDepth();
+        cullProgram.setUniform(uCullOcclusionCulling, GLint(testOcclusion));
+        cullProgram.setUniform(uCullMeshletCulling,
+            GLint(meshletCulling && !packedGeometry.meshlets.empty()));
+        cullProgram.setUniform(uCullCameraPosition, camera.eye());
+        drawStats.uniformUploads += 5;
+        if (testOcclusion) {
+          cullProgram.setUniform(
+              uCullPreviousViewProjMatrix, previousViewProjMatrix);
+          glActiveTexture(GL_TEXTURE0 + depthPyramidUnit);
+          glBindTexture(GL_TEXTURE_2D, depthPyramid->texture());
+          ++drawStats.uniformUploads;
+          ++drawStats.textureBinds;
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_BOUNDS_BINDING,
+            drawBoundsBuffer.glId());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_ALL_COMMANDS_BINDING,
+            allCommandsBuffer.glId());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+            CULL_VISIBLE_COMMANDS_BINDING, indirectBuffer.glId());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_MESHLETS_BINDING,
+            commandMeshletsBuffer.glId());
+        const auto changedWords = drawVisibility.takeChangedWords();
+        if (changedWords.first < changedWords.second) {
+          glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawVisibilityBuffer.glId());
+          glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+              changedWords.first * sizeof(uint32_t),
+              (changedWords.second - changedWords.first) * sizeof(uint32_t),
+              drawVisibility.drawBits().data() + changedWords.first);
+          drawStats.uploadedBufferBytes +=
+              (changedWords.second - changedWords.first) * sizeof(uint32_t);
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_VISIBILITY_BINDING,
+            drawVisibilityBuffer.glId());
+        glDispatchCompute(GLuint((indirectCommands.size() + 63) / 64), 1, 1);
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+        glslProgram.use();
+        drawnPrimitiveCount = indirectCommands.size();
+      } else {
+        buildIndirectCommands(
+            testVisibility ? visiblePrimitives.data() : nullptr, true);
+        uploadInstanceDraws();
+        renderDevice.updateBuffer(
+            GLRenderDevice::buffer(indirectBuffer.glId()), 0,
+            indirectCommands.size() * sizeof(DrawElementsIndirectCommand),
+            indirectCommands.data());
+        drawStats.uploadedBufferBytes +=
+            indirectCommands.size() * sizeof(DrawElementsIndirectCommand);
+      }
+
+      renderDevice.setVertexInput(
+          GLRenderDevice::vertexInput(packedVertexArray.glId()));
+      ++drawStats.vertexArrayBinds;
+      // The pre-pass submits the same commands, in their order
+      const auto submitDrawGroups = [&](bool depthOnly) {
+        for (const auto &group : drawGroups) {
+          if (!useBindlessTextures && !depthOnly) {
+            bindMaterial(group.material);
+          }
+          IndirectDrawItem item;
+          item.topology = GLRenderDevice::getTopology(group.mode);
+          item.commands = GLRenderDevice::buffer(indirectBuffer.glId());
+          item.byteOffset = group.begin * sizeof(DrawElementsIndirectCommand);
+          item.drawCount = uint32_t(group.end - group.begin);
+          renderDevice.drawIndirect(item);
+          ++drawStats.drawCalls;
+          for (auto i = group.begin; i < group.end; ++i) {
+            drawStats.addTriangles(group.mode, indirectCommands[i].count,
+                indirectCommands[i].instanceCount);
+          }
+        }
+      };
+      if (gbuffer) {
+        gbuffer->begin(viewportWidth, viewportHeight);
+      }
+      if (m_options.depthPrepass) {
+        depthProgram.use();
+        beginDepthPrepass();
+        submitDrawGroups(true);
+        endDepthPrepass();
+        glslProgram.use();
+      }
+      if (gbuffer) {
+        gbufferProgram.use();
+      }
+      submitDrawGroups(false);
+      if (m_options.depthPrepass) {
+        endShadingPass();
+      }
+      if (gbuffer) {
+        maskExtraOutputs(true);
+        shadeGBuffer(frameUniforms.projMatrix);
+        maskExtraOutputs(false);
+      }
+      glBindVertexArray(0);
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+      drawStats.culledPrimitives += culledPrimitiveCount;
+      if (toneMapping) {
+        resolveToneMapping();
+      }
+      glDisable(GL_FRAMEBUFFER_SRGB);
+
+      if (depthPyramid) {
+        depthPyramid->resolve(GLuint(targetFramebuffer));
+        previousViewProjMatrix = frameUniforms.projMatrix * viewMatrix;
+      }
+      if (isOverdrawView) {
+        debugViews->resolveOverdraw();
+      }
+      return;
+    }
+
+    uploadInstanceDraws();
+    instancedDrawCount = instanceRuns.size();
+
+    // The runs in [beginRun, endRun), the pre-pass draws those of
+    // depthPrepassRuns instead, without materials
+    const auto submitInstanceRuns = [&](bool depthOnly, size_t beginRun,
+                                        size_t endRun) {
+      // State set by the previous draw, a draw only changes what differs
+      auto currentMaterial = std::numeric_limits<int>::min();
+      auto currentNode = -1;
+      GLuint currentVertexArray = 0;
+      auto currentUseDrawTable = false;
+      auto currentProgram = glslProgram.glId();
+      for (auto runIdx = beginRun; runIdx < endRun; ++runIdx) {
+        const auto &run =
+            instanceRuns[depthOnly ? depthPrepassRuns[runIdx].second : runIdx];
+        const auto &command = drawCommands[instanceDraws[run.begin]];
+        const auto instanceCount = GLsizei(run.end - run.begin);
+
+        const auto program = depthOnly ? depthProgram.glId()
+                                       : getMaterialProgram(command.material);
+        if (program != currentProgram) {
+          // Uniforms belong to programs, the new one gets all of them
+          if (currentUseDrawTable) {
+            glUniform1i(uUseDrawTable, 0);
+            ++drawStats.uniformUploads;
+          }
+          currentProgram = program;
+          glUseProgram(currentProgram);
+          currentMaterial = std::numeric_limits<int>::min();
+          currentVertexArray = 0;
+          currentUseDrawTable = false;
+        }
+
+        // Single draws keep their matrices in DrawUniforms
+        const auto useDrawTable = instanceCount > 1;
+        if (useDrawTable != currentUseDrawTable) {
+          currentUseDrawTable = useDrawTable;
+          glUniform1i(uUseDrawTable, useDrawTable);
+          ++drawStats.uniformUploads;
+        }
+        if (!useDrawTable && command.node != currentNode) {
+          //Get the cached matrices of the node to GPU, the shader combines them
+          //with the view and projection matrices of FrameUniforms
+          currentNode = command.node;
+          uniformRing.bindBlock(
+              DRAW_UNIFORMS_BINDING, getDrawUniforms(size_t(currentNode)));
+          ++drawStats.uniformUploads;
+          drawStats.uploadedBufferBytes += sizeof(DrawUniforms);
+        }
+        if (!depthOnly && command.material != currentMaterial) {
+          currentMaterial = command.material;
+          bindMaterial(currentMaterial);
+        }
+        if (!depthOnly && !useDrawTable && uDrawId >= 0) {
+          glUniform1ui(uDrawId, GLuint(instanceDraws[run.begin] + 1));
+          ++drawStats.uniformUploads;
+        }
+        const auto vertexArray =
+            sharedBuffers ? packedVertexArray.glId() : command.vertexArray;
+        if (vertexArray != currentVertexArray) {
+          currentVertexArray = vertexArray;
+          renderDevice.setVertexInput(
+              GLRenderDevice::vertexInput(currentVertexArray));
+          ++drawStats.vertexArrayBinds;
+          if (vertexStreamBuffer.glId()) {
+            // Vertices of the skinning pre-pass are not quantized
+            const auto isStream =
+                vertexArray == vertexArrayObjects[command.primitive];
+            const auto offset =
+                isStream ? positionOffsets[command.primitive] : glm::vec3(0);
+            const auto scale =
+                isStream ? positionScales[command.primitive] : glm::vec3(1);
+            glUniform3fv(uPositionOffset, 1, glm::value_ptr(offset));
+            glUniform3fv(uPositionScale, 1, glm::value_ptr(scale));
+            drawStats.uniformUploads += 2;
+          }
+        }
+
+        // Skipped by the GPU if the box was hidden in the previous frame
+        const auto drawIdx = instanceDraws[run.begin];
+        const auto conditional =
+            queriedDraws[drawIdx] &&
+            occlusionQueryFrames[drawIdx] + 1 == occlusionQueryFrame;
+        if (conditional) {
+          glBeginConditionalRender(
+              occlusionQueries[drawIdx], GL_QUERY_NO_WAIT);
+        }
+        DrawItem item;
+        item.topology = GLRenderDevice::getTopology(command.mode);
+        item.instanceCount = uint32_t(instanceCount);
+        item.baseInstance = uint32_t(run.begin);
+        if (sharedBuffers) {
+          const auto &range = packedGeometry.ranges[command.primitive];
+          item.indexType = IndexType::UInt32;
+          item.count = range.indexCount;
+          item.indexByteOffset = range.firstIndex * sizeof(uint32_t);
+          item.baseVertex = range.baseVertex;
+        } else { // Without index buffer if indexType is 0
+          item.indexType = GLRenderDevice::getIndexType(command.indexType);
+          item.count = uint32_t(command.count);
+          item.indexByteOffset = size_t(command.indexByteOffset);
+        }
+        renderDevice.draw(item);
+        if (conditional) {
+          glEndConditionalRender();
+          ++drawStats.conditionalDraws;
+        }
+        ++drawStats.drawCalls;
+        const auto vertexCount =
+            sharedBuffers ? packedGeometry.ranges[command.primitive].indexCount
+                          : GLuint(command.count);
+        drawStats.addTriangles(
+            command.mode, vertexCount, size_t(instanceCount));
+      }
+      if (currentUseDrawTable) {
+        glUniform1i(uUseDrawTable, 0);
+        ++drawStats.uniformUploads;
+      }
+      if (currentProgram != glslProgram.glId()) {
+        glslProgram.use();
+      }
+    };
+    if (m_options.depthPrepass) {
+      // Front to back, nearer runs hide the fragments of farther ones. Cutouts
+      // and blended draws are not in the pre-pass.
+      depthPrepassRuns.clear();
+      for (size_t runIdx = 0; runIdx < cutoutRunBegin; ++runIdx) {
+        const auto &run = instanceRuns[runIdx];
+        auto distance = std::numeric_limits<float>::max();
+        for (auto i = run.begin; i < run.end; ++i) {
+          const auto &bounds = primitiveBounds[instanceDraws[i]];
+          distance = std::min(distance,
+              glm::length(glm::max(glm::max(bounds.min - camera.eye(),
+                                       camera.eye() - bounds.max),
+                  glm::vec3(0))));
+        }
+        depthPrepassRuns.emplace_back(distance, runIdx);
+      }
+      std::sort(begin(depthPrepassRuns), end(depthPrepassRuns));
+    }
+    if (gbuffer) {
+      gbuffer->begin(viewportWidth, viewportHeight);
+    }
+    if (m_options.depthPrepass) {
+      beginDepthPrepass();
+      submitInstanceRuns(true, 0, depthPrepassRuns.size());
+      endDepthPrepass();
+    }
+    submitInstanceRuns(false, 0, cutoutRunBegin);
+    if (m_options.depthPrepass) {
+      endShadingPass();
+    }
+    submitInstanceRuns(false, cutoutRunBegin, blendRunBegin);
+    maskExtraOutputs(true);
+    if (!impostorInstances.empty()) {
+      impostors->draw(impostorInstances);
+      ++drawStats.drawCalls;
+      ++drawStats.vertexArrayBinds;
+      ++drawStats.textureBinds;
+      drawStats.uploadedBufferBytes +=
+          impostorInstances.size() * sizeof(Impostors::Instance);
+      drawStats.addTriangles(GL_TRIANGLE_STRIP, 4, impostorInstances.size());
+      drawStats.impostors += impostorInstances.size();
+    }
+    if (!pointCloudInstances.empty()) {
+      pointClouds->draw(pointCloudInstances, shaderViewMatrix,
+          frameUniforms.projMatrix,
+          getFrustum(tileMatrix * projMatrix * shaderViewMatrix),
+          viewportWidth, viewportHeight, encodeOutput,
+          m_options.fillPointHoles);
+      ++drawStats.drawCalls;
+      ++drawStats.vertexArrayBinds;
+    }
+    maskExtraOutputs(false);
+    if (conditionalRender) {
+      queryOcclusion(viewMatrix, frameUniforms.projMatrix);
+    }
+    if (tilePager) {
+      pageTiles(viewMatrix, tileMatrix * projMatrix, viewportHeight);
+      drawTiles();
+    }
+    maskExtraOutputs(true);
+    if (gbuffer) {
+      shadeGBuffer(frameUniforms.projMatrix);
+    }
+    if (blendRunBegin < instanceRuns.size()) {
+      // Transmissive draws all sample one copy of the color drawn so far
+      if (sceneColor &&
+          std::any_of(begin(instanceRuns) + blendRunBegin, end(instanceRuns),
+              [&](const InstanceRun &run) {
+                const auto &command = drawCommands[instanceDraws[run.begin]];
+                return materialTransmissions[runtimeScene.materialSlot(
+                           command.material)] != 0;
+              })) {
+        sceneColor->capture(viewportWidth, viewportHeight);
+        ++drawStats.textureBinds;
+      }
+      // Over the other draws, without hiding the blended draws behind
+      glEnable(GL_BLEND);
+      glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+          GL_ONE_MINUS_SRC_ALPHA);
+      glDepthMask(GL_FALSE);
+      submitInstanceRuns(false, blendRunBegin, instanceRuns.size());
+      glDepthMask(GL_TRUE);
+      glDisable(GL_BLEND);
+    }
+    maskExtraOutputs(false);
+    glBindVertexArray(0);
+    drawStats.culledPrimitives += culledPrimitiveCount;
+    if (toneMapping) {
+      resolveToneMapping();
+    }
+    glDisable(GL_FRAMEBUFFER_SRGB);
+    if (isOverdrawView) {
+      debugViews->resolveOverdraw();
+    }
+  };
+
+  // Render views at the current size, all of them or those whose indices
+  // nextViewIndex gives, returns false if one of them could not be written.
+  // beginView sets what else than the camera changes with the view index.
+  // With outputVideo, views are its frames instead of images.
+  VideoWriter *outputVideo = nullptr;
+  const auto renderOutputViews =
+      [&](const std::vector<std::pair<Camera, fs::path>> &views,
+          const std::function<bool(size_t &)> &nextViewIndex = {},
+          const std::function<void(size_t)> &beginView = {}) {
+        if (views.empty()) {
+          return true;
+        }
+        size_t viewCount = 0;
+        const auto nextView = [&](size_t &viewIdx) {
+          if (nextViewIndex) {
+            return nextViewIndex(viewIdx) && viewIdx < views.size();
+          }
+          viewIdx = viewCount++;
+          return viewIdx < views.size();
+        };
+        const auto startView = [&](size_t viewIdx) {
+          if (beginView) {
+            beginView(viewIdx);
+          }
+          const auto &view = views[viewIdx];
+          pageTilesUntilIdle(view.first, m_nWindowHeight);
+          resetOcclusionQueries();
+        };
+        const auto floatPixels = isFloatImageFormat(views[0].second);
+        const auto outputTileSize = getOutputTileSize();
+        auto written = true;
+        size_t viewIdx = 0;
+        if (outputTileSize) {
+          TiledImageRenderer tiledRenderer(m_nWindowWidth, m_nWindowHeight,
+              outputTileSize, floatPixels, m_options.outputSampleCount);
+          const auto tileViewportSize = GLsizei(outputTileSize);
+          while (nextView(viewIdx)) {
+            const auto &view = views[viewIdx];
+            startView(viewIdx);
+            // The tiles of a view keep the exposure of its first one, else
+            // their seams would show
+            measureExposure = true;
+            const auto drawTile = [&](const glm::mat4 &tileMatrix) {
+              drawScene(
+                  view.first, tileMatrix, tileViewportSize, tileViewportSize);
+              measureExposure = false;
+            };
+            if (!tiledRenderer.render(view.second, drawTile)) {
+              std::cerr << "Error : unable to write " << view.second.string()
+                        << std::endl;
+              written = false;
+            }
+            endDrawStats();
+          }
+          measureExposure = true;
+          return written;
+        }
+
+        // Views share the framebuffer of imageRenderer, and are encoded on
+        // its worker thread. With --async-readback, view i is read back while
+        // views i + 1 and later render.
+        AsyncImageRenderer imageRenderer(m_nWindowWidth, m_nWindowHeight,
+            floatPixels,
+            m_options.asyncReadback || outputVideo ? size_t(3) : size_t(1),
+            m_options.outputSampleCount, outputAovs);
+        imageRenderer.setVideoWriter(outputVideo);
+        while (nextView(viewIdx)) {
+          const auto &view = views[viewIdx];
+          startView(viewIdx);
+          imageRenderer.render(view.second, [&]() {
+            drawScene(
+                view.first, glm::mat4(1), m_nWindowWidth, m_nWindowHeight);
+          });
+          endDrawStats();
+        }
+        return imageRenderer.finish();
+      };
+
+  // Layers of impostors, loaded from the cache or rendered by the programs of
+  // the materials into frames of their own FrameUniforms, see Impostors. The
+  // cache is named after the file of the model, the mesh and what lights it.
+  if (impostors) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto appendBytes = [](std::string &key, const void *data,
+                                 size_t size) {
+      key.append(static_cast<const char *>(data), size);
+    };
+    std::error_code ec;
+    auto sceneKey = fs::absolute(m_gltfFilePath).string() + '\n' +
+                    programDefines +
+                    loadShaderSource(m_ShadersRootPath / m_vertexShader) +
+                    loadShaderSource(m_ShadersRootPath / m_fragmentShader);
+    const auto fileSize = uintmax_t(fs::file_size(m_gltfFilePath, ec));
+    const auto fileTime =
+        fs::last_write_time(m_gltfFilePath, ec).time_since_epoch().count();
+    appendBytes(sceneKey, &fileSize, sizeof(fileSize));
+    appendBytes(sceneKey, &fileTime, sizeof(fileTime));
+    appendBytes(sceneKey, &lightDirection, sizeof(lightDirection));
+    appendBytes(sceneKey, &lightIntensity, sizeof(lightIntensity));
+    appendBytes(sceneKey, &lightFromCamera, sizeof(lightFromCamera));
+    appendBytes(sceneKey, &applyOcclusion, sizeof(applyOcclusion));
+    if (environmentMap) {
+      sceneKey += m_options.environmentPath.string();
+      appendBytes(
+          sceneKey, &environmentIntensity, sizeof(environmentIntensity));
+    }
+
+    auto bakeUniformBuffers = GLBuffers::generate(2);
+    const DrawUniforms drawUniforms{
+        glm::mat4(1), glm::mat4(1), -1, {}, glm::mat4(1)};
+    glBindBuffer(GL_UNIFORM_BUFFER, bakeUniformBuffers[0]);
+    glBufferStorage(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr,
+        GL_DYNAMIC_STORAGE_BIT);
+    glBindBuffer(GL_UNIFORM_BUFFER, bakeUniformBuffers[1]);
+    glBufferStorage(
+        GL_UNIFORM_BUFFER, sizeof(drawUniforms), &drawUniforms, 0);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(
+        GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, bakeUniformBuffers[0]);
+    glBindBufferBase(
+        GL_UNIFORM_BUFFER, DRAW_UNIFORMS_BINDING, bakeUniformBuffers[1]);
+    // The draws of a node of the mesh, in the space of the mesh. The
+    // coverage pass writes alpha where the color pass wrote its depth.
+    const auto drawImpostorMesh = [&](size_t nodeIdx, bool coverage) {
+      const auto firstDraw = firstPrimitiveBounds[nodeIdx];
+      const auto drawEnd =
+          firstDraw + size_t(meshToVA[size_t(flatScene.meshes[nodeIdx])].count);
+      for (auto drawIdx = firstDraw; drawIdx < drawEnd; ++drawIdx) {
+        const auto &command = drawCommands[drawIdx];
+        if (coverage) {
+          impostorCoverageProgram.use();
+        } else {
+          glUseProgram(getMaterialProgram(command.material));
+          bindMaterial(command.material);
+        }
+        const auto vertexArray =
+            sharedBuffers ? packedVertexArray.glId() : command.vertexArray;
+        glBindVertexArray(vertexArray);
+        if (vertexStreamBuffer.glId()) {
+          const auto isStream =
+              vertexArray == vertexArrayObjects[command.primitive];
+          const auto offset =
+              isStream ? positionOffsets[command.primitive] : glm::vec3(0);
+          const auto scale =
+              isStream ? positionScales[command.primitive] : glm::vec3(1);
+          glUniform3fv(uPositionOffset, 1, glm::value_ptr(offset));
+          glUniform3fv(uPositionScale, 1, glm::value_ptr(scale));
+        }
+        if (sharedBuffers) {
+          const auto &range = packedGeometry.ranges[command.primitive];
+          if (command.minIndex <= command.maxIndex) {
+            glDrawRangeElementsBaseVertex(command.mode, command.minIndex,
+                command.maxIndex, range.indexCount, GL_UNSIGNED_INT,
+                (const GLvoid *)(range.firstIndex * sizeof(uint32_t)),
+                range.baseVertex);
+          } else {
+            glDrawElementsBaseVertex(command.mode, range.indexCount,
+                GL_UNSIGNED_INT,
+                (const GLvoid *)(range.firstIndex * sizeof(uint32_t)),
+                range.baseVertex);
+          }
+        } else if (command.indexType && command.minIndex <= command.maxIndex) {
+          glDrawRangeElements(command.mode, command.minIndex,
+              command.maxIndex, command.count, command.indexType,
+              (const GLvoid *)command.indexByteOffset);
+        } else if (command.indexType) {
+          glDrawElements(command.mode, command.count, command.indexType,
+              (const GLvoid *)command.indexByteOffset);
+        } else {
+          glDrawArrays(command.mode, 0, command.count);
+        }
+      }
+      glBindVertexArray(0);
+    };
+
+    // Frames keep the depth conventions of glm::ortho
+    if (reversedZ) {
+      clipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+      glClearDepth(1.);
+      glDepthFunc(GL_LESS);
+    }
+    size_t renderedLayerCount = 0;
+    for (size_t layer = 0; layer < impostorMeshes.size(); ++layer) {
+      const auto nodeIdx = size_t(
+          std::find(begin(impostorNodeLayers), end(impostorNodeLayers),
+              int(layer)) -
+          begin(impostorNodeLayers));
+      const auto meshIdx = impostorMeshes[layer];
+      auto key = sceneKey;
+      appendBytes(key, &meshIdx, sizeof(meshIdx));
+      for (auto drawIdx = firstPrimitiveBounds[nodeIdx];
+           drawIdx < firstPrimitiveBounds[nodeIdx] +
+                         size_t(meshToVA[size_t(meshIdx)].count);
+           ++drawIdx) {
+        const auto &command = drawCommands[drawIdx];
+        appendBytes(key, &command.material, sizeof(command.material));
+        appendBytes(key, &command.count, sizeof(command.count));
+        appendBytes(key, &localPrimitiveBounds[command.primitive],
+            sizeof(BoundingBox));
+      }
+      const auto cachePath = Impostors::getCachePath(
+          m_AppPath.parent_path() / "impostor-cache", key);
+      if (impostors->loadLayer(GLsizei(layer), cachePath)) {
+        continue;
+      }
+      impostors->renderLayer(GLsizei(layer), impostorSpheres[layer], cachePath,
+          [&](const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix) {
+            FrameUniforms frameUniforms;
+            frameUniforms.viewMatrix = viewMatrix;
+            frameUniforms.projMatrix = projMatrix;
+            frameUniforms.lightDirection =
+                lightFromCamera
+                    ? glm::vec3(0, 0, 1)
+                    : glm::normalize(glm::vec3(
+                          viewMatrix * glm::vec4(lightDirection, 0.)));
+            frameUniforms.lightIntensity = lightIntensity;
+            frameUniforms.applyOcclusion = GLint(applyOcclusion);
+            frameUniforms.encodeOutput = 1;
+            frameUniforms.previousViewProjMatrix = projMatrix * viewMatrix;
+            glBindBuffer(GL_UNIFORM_BUFFER, bakeUniformBuffers[0]);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameUniforms),
+                &frameUniforms);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            if (environmentMap) {
+              environmentMap->bind(viewMatrix, environmentIntensity);
+            }
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+            drawImpostorMesh(nodeIdx, false);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE);
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(GL_FALSE);
+            drawImpostorMesh(nodeIdx, true);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+          });
+      ++renderedLayerCount;
+    }
+    if (reversedZ) {
+      clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+      glClearDepth(0.);
+    }
+    glDepthFunc(depthFunc);
+    glslProgram.use();
+    impostors->generateMipmaps();
+    if (renderedLayerCount) {
+      std::clog << "Rendered " << renderedLayerCount << " impostors in "
+                << std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count()
+                << " s\n";
+    }
+  }
+
+  // Uploads done while loading are not those of the first frame
+  drawStats = DrawStats();
+
+  // Jobs of a RenderServer or of the C API, with their own size and camera
+  if (m_nextOutputJob) {
+    const auto defaultCamera = cameraController->getCamera();
+    // Of the jobs copying their pixels, drawn as the thumbnails are
+    std::unique_ptr<OffscreenFramebuffer> pixelFramebuffer;
+    OutputJob job;
+    while (m_nextOutputJob(job)) {
+      m_nWindowWidth = GLsizei(job.width);
+      m_nWindowHeight = GLsizei(job.height);
+      projMatrix = getProjMatrix();
+      const auto &camera = job.hasCamera ? job.camera : defaultCamera;
+      if (!job.pixels) {
+        job.done(renderOutputViews({{camera, job.outputPath}}));
+        continue;
+      }
+      if (!pixelFramebuffer || pixelFramebuffer->width() != job.width ||
+          pixelFramebuffer->height() != job.height) {
+        pixelFramebuffer = std::make_unique<OffscreenFramebuffer>(job.width,
+            job.height, GL_RGBA8, m_options.outputSampleCount);
+      }
+      pageTilesUntilIdle(camera, m_nWindowHeight);
+      resetOcclusionQueries();
+      pixelFramebuffer->render([&]() {
+        drawScene(camera, glm::mat4(1), m_nWindowWidth, m_nWindowHeight);
+      });
+      endDrawStats();
+      pixelFramebuffer->readPixels(4, job.pixels);
+      job.done(true);
+    }
+    return 0;
+  }
+
+  // Thumbnail of this model of the list, then of the next ones, see
+  // ViewerOptions::thumbnails
+  if (m_options.thumbnails) {
+    const auto &models = m_options.modelList;
+    const auto loadNextModel = [&](bool async) {
+      return std::async(async ? std::launch::async : std::launch::deferred,
+          loadScene, models[m_thumbnailIdx + 1], m_options, false);
+    };
+    if (m_thumbnailIdx + 1 < models.size()) {
+      m_nextThumbnailScene = loadNextModel(true);
+    }
+
+    const auto width = size_t(m_nWindowWidth);
+    const auto height = size_t(m_nWindowHeight);
+    if (!m_thumbnailFramebuffer) {
+      m_thumbnailFramebuffer = std::make_unique<OffscreenFramebuffer>(
+          width, height, GL_RGBA8, m_options.outputSampleCount);
+    }
+    const auto camera = cameraController->getCamera();
+    pageTilesUntilIdle(camera, m_nWindowHeight);
+    resetOcclusionQueries();
+    m_thumbnailFramebuffer->render([&]() {
+      drawScene(camera, glm::mat4(1), m_nWindowWidth, m_nWindowHeight);
+    });
+    endDrawStats();
+    std::vector<uint8_t> pixels(width * height * 4);
+    m_thumbnailFramebuffer->readPixels(4, pixels.data());
+
+    // The next model that could be loaded is drawn by the next runScene, in
+    // this context. The tiles of those that could not stay empty.
+    const auto thumbnailIdx = m_thumbnailIdx;
+    while (m_nextThumbnailScene.valid()) {
+      m_nextScene = m_nextThumbnailScene.get();
+      ++m_thumbnailIdx;
+      if (m_nextScene) {
+        m_gltfFilePath = models[m_thumbnailIdx];
+        break;
+      }
+      std::cerr << "Error : unable to load " << models[m_thumbnailIdx].string()
+                << std::endl;
+      m_thumbnailsFailed = true;
+      if (m_thumbnailIdx + 1 < models.size()) {
+        m_nextThumbnailScene = loadNextModel(false);
+      }
+    }
+
+    auto written = true;
+    auto imagePath = m_OutputPath;
+    const auto columns = m_options.thumbnailAtlasColumns;
+    if (columns) {
+      const auto rows = (models.size() + columns - 1) / columns;
+      const auto rowSize = columns * width * 4;
+      m_thumbnailAtlas.resize(rows * height * rowSize);
+      const auto row = rows - 1 - thumbnailIdx / columns;
+      const auto column = thumbnailIdx % columns;
+      for (size_t y = 0; y < height; ++y) {
+        std::memcpy(&m_thumbnailAtlas[(row * height + y) * rowSize +
+                                      column * width * 4],
+            &pixels[y * width * 4], width * 4);
+      }
+      if (!m_nextScene) {
+        written = writeImage(m_OutputPath, columns * width, rows * height,
+            m_thumbnailAtlas.data(), true);
+      }
+    } else {
+      imagePath = m_OutputPath / (models[thumbnailIdx].stem().string() +
+                                     m_options.batchImageExtension);
+      written = writeImage(imagePath, width, height, pixels.data(), true);
+    }
+    if (!written) {
+      std::cerr << "Error : unable to write " << imagePath.string()
+                << std::endl;
+      m_thumbnailsFailed = true;
+    }
+    return m_thumbnailsFailed ? -1 : 0;
+  }
+
+  //Rendering image (png)
+  if(!m_OutputPath.empty()){
+    // Views to render: the cameras of a batch, written in the output
+    // directory, or outputFrameCount frames of the camera
+    std::vector<std::pair<Camera, fs::path>> views;
+    if (!m_options.sweepPath.empty()) {
+      // Written once by applications sharing the sweep, by the first worker
+      // of a BatchRenderer
+      const auto sweepViews = generateSweepViews(
+          loadViewSweepSpec(m_options.sweepPath), bboxMin, bboxMax);
+      fs::create_directories(m_OutputPath);
+      if (!m_nextBatchView || m_options.headlessDevice == 0) {
+        std::ofstream manifest((m_OutputPath / "sweep.csv").string());
+        writeSweepManifest(
+            manifest, sweepViews, m_options.batchImageExtension);
+        if (!manifest) {
+          std::cerr << "Error : unable to write "
+                    << (m_OutputPath / "sweep.csv").string() << std::endl;
+        }
+      }
+      for (size_t i = 0; i < sweepViews.size(); ++i) {
+        views.emplace_back(sweepViews[i].camera,
+            m_OutputPath /
+                (getSweepViewName(i) + m_options.batchImageExtension));
+      }
+      // The sun of impostors stays that of their cache
+      size_t renderedViewCount = 0;
+      const auto start = std::chrono::steady_clock::now();
+      const auto written = renderOutputViews(
+          views, m_nextBatchView, [&](size_t viewIdx) {
+            const auto &view = sweepViews[viewIdx];
+            lightDirection = view.lightDirection();
+            lightIntensity = glm::vec3(view.sunIntensity);
+            ++renderedViewCount;
+          });
+      const auto seconds = std::chrono::duration<double>(
+          std::chrono::steady_clock::now() - start)
+                               .count();
+      std::clog << "Rendered " << renderedViewCount << " sweep views in "
+                << seconds << " s ("
+                << double(renderedViewCount) / std::max(seconds, 1e-9)
+                << " images/s)\n";
+      return written ? 0 : -1;
+    }
+    // With a video output path, they are the frames of the video. Frames
+    // start from outputFirstFrame.
+    const auto isVideo = isVideoFormat(m_OutputPath);
+    auto firstFrame = size_t(0);
+    if (!m_options.cameraListPath.empty() || m_options.turntableViewCount) {
+      const auto cameras =
+          !m_options.cameraListPath.empty()
+              ? loadCameraList(m_options.cameraListPath)
+              : getTurntableCameras(cameraController->getCamera(),
+                    m_options.turntableViewCount);
+      if (!isVideo) {
+        fs::create_directories(m_OutputPath);
+      }
+      for (size_t i = 0; i < cameras.size(); ++i) {
+        char fileName[32];
+        std::snprintf(fileName, sizeof(fileName), "view_%04zu", i);
+        views.emplace_back(cameras[i],
+            isVideo ? m_OutputPath
+                    : m_OutputPath / (fileName + m_options.batchImageExtension));
+      }
+    } else {
+      const auto frameCount = m_options.outputFrameCount;
+      firstFrame = std::min(m_options.outputFirstFrame, frameCount);
+      const auto endFrame =
+          std::min(m_options.outputLastFrame, frameCount - 1) + 1;
+      for (auto i = firstFrame; i < endFrame; ++i) {
+        views.emplace_back(cameraController->getCamera(),
+            isVideo ? m_OutputPath : getFramePath(m_OutputPath, i, frameCount));
+      }
+    }
+    // Frames of workers or processes sharing a sequence have the same time
+    // for the same index, whichever renders them
+    const auto frameRate =
+        m_options.outputFrameRate ? m_options.outputFrameRate
+                                  : (isVideo ? size_t(30) : size_t(0));
+    const auto playAnimation = [&](size_t viewIdx) {
+      if (animationPlayer && frameRate) {
+        animationPlayback.seek(
+            float(double(firstFrame + viewIdx) / double(frameRate)));
+      }
+    };
+    if (!isVideo) {
+      renderOutputViews(views, m_nextBatchView, playAnimation);
+      return 0;
+    }
+
+    // Frames are piped to the encoder as they are read back
+    if (getOutputTileSize()) {
+      std::cerr << "Error : videos can not be rendered in tiles" << std::endl;
+      return -1;
+    }
+    const auto video = createVideoWriter(m_OutputPath,
+        size_t(m_nWindowWidth), size_t(m_nWindowHeight), frameRate,
+        m_options.videoEncoder);
+    if (!video) {
+      std::cerr << "Error : unable to start ffmpeg to write "
+                << m_OutputPath.string() << std::endl;
+      return -1;
+    }
+    outputVideo = video.get();
+    const auto written = renderOutputViews(views, {}, playAnimation);
+    outputVideo = nullptr;
+    if (!video->finish() || !written) {
+      std::cerr << "Error : unable to write " << m_OutputPath.string()
+                << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+
+  // Frames of a benchmark, timed without the GUI. Timer queries are only
+  // read once all frames are drawn, so that reading them never waits for the
+  // GPU in between.
+  if (m_benchmark.frameCount && !m_benchmark.cameras.empty()) {
+    std::unique_ptr<OffscreenFramebuffer> framebuffer;
+    if (m_headlessContext) {
+      framebuffer = std::make_unique<OffscreenFramebuffer>(
+          size_t(m_nWindowWidth), size_t(m_nWindowHeight), GL_RGBA8);
+    }
+    const auto frameCount =
+        m_benchmark.warmupFrameCount + m_benchmark.frameCount;
+    std::vector<GLuint> queries(m_benchmark.frameCount);
+    glGenQueries(GLsizei(queries.size()), queries.data());
+    BenchmarkTimes times;
+    auto frameStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < frameCount; ++i) {
+      const TraceZone frameZone("frame");
+      const auto &camera = m_benchmark.cameras[i % m_benchmark.cameras.size()];
+      const auto isMeasured = i >= m_benchmark.warmupFrameCount;
+      if (isMeasured) {
+        glBeginQuery(
+            GL_TIME_ELAPSED, queries[i - m_benchmark.warmupFrameCount]);
+      }
+      const auto draw = [&]() {
+        drawScene(camera, glm::mat4(1), m_nWindowWidth, m_nWindowHeight);
+      };
+      if (framebuffer) {
+        framebuffer->render(draw);
+      } else {
+        draw();
+      }
+      if (isMeasured) {
+        glEndQuery(GL_TIME_ELAPSED);
+      }
+      endDrawStats();
+      const auto drawEnd = std::chrono::steady_clock::now();
+#ifdef GLTF_VIEWER_HEADLESS
+      glFlush();
+#else
+      if (m_GLFWHandle) {
+        const TraceZone swapZone("swapBuffers");
+        m_GLFWHandle->swapBuffers();
+        glfwPollEvents();
+      } else {
+        glFlush();
+      }
+#endif
+      const auto frameEnd = std::chrono::steady_clock::now();
+      if (isMeasured) {
+        times.cpuTimes.push_back(
+            std::chrono::duration<double>(drawEnd - frameStart).count());
+        times.frameTimes.push_back(
+            std::chrono::duration<double>(frameEnd - frameStart).count());
+      }
+      frameStart = frameEnd;
+    }
+    for (const auto query : queries) {
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      times.gpuTimes.push_back(double(nanoseconds) * 1e-9);
+    }
+    glDeleteQueries(GLsizei(queries.size()), queries.data());
+    if (m_benchmark.done) {
+      m_benchmark.done(times);
+    }
+    return 0;
+  }
+
+#ifdef GLTF_VIEWER_HEADLESS
+  // Only output images and benchmarks are drawn without a window
+  std::cerr << "Error : gltf-render has no viewer, an output is needed"
+            << std::endl;
+  return -1;
+#else
+  // With --record-camera, the camera of each frame, for benchmarks
+  std::ofstream recordedCameras;
+  if (!m_options.recordCameraPath.empty()) {
+    recordedCameras.open(m_options.recordCameraPath.string());
+    if (!recordedCameras) {
+      std::cerr << "Error : unable to write "
+                << m_options.recordCameraPath.string() << std::endl;
+      return -1;
+    }
+  }
+
+  // With --texture-budget, the textures of images are created again from the
+  // levels the visible draws sample (see TextureStreamer). Finer levels of
+  // decoded images are downsampled by jobs, coarser ones are copied from the
+  // texture when it has them.
+  std::unique_ptr<TextureStreamer> textureStreamer;
+  std::vector<int> imageStreamedTextures(model.images.size(), -1);
+  std::vector<int> streamedTextureImages;
+  // A texture from level l of a mipmapped image holds all levels from l
+  const auto isMipmapped = [&](int imageIdx) {
+    return imageUsages[imageIdx].generateMipmaps ||
+           isKtx2Image(model.images[imageIdx]);
+  };
+  if (streamTextures()) {
+    textureStreamer =
+        std::make_unique<TextureStreamer>(m_options.textureBudget << 20);
+    for (size_t imageIdx = 0; imageIdx < model.images.size(); ++imageIdx) {
+      if (imageTextures[imageIdx]) {
+        auto levels = getTextureLevelSizes(model.images[imageIdx]);
+        const auto startLevel = TextureStreamer::getStartLevel(
+            levels, TEXTURE_STREAMING_START_SIZE);
+        imageStreamedTextures[imageIdx] = int(textureStreamer->add(
+            std::move(levels), isMipmapped(int(imageIdx)), startLevel));
+        streamedTextureImages.push_back(int(imageIdx));
+      }
+    }
+  }
+  // Levels being downsampled, their textures are created once done
+  struct StreamedLevel
+  {
+    size_t texture = 0;
+    GLint level = 0;
+    std::shared_ptr<tinygltf::Image> image;
+    JobSystem::Handle job;
+  };
+  std::vector<StreamedLevel> streamedLevels;
+  // Calls f(imageIdx, pixelSize) for the images sampled by the draws visible
+  // from camera. Texture coordinates are assumed to cover their primitive
+  // once: the screen size of its bounding sphere, at its nearest point,
+  // stands for the footprint of its textures.
+  const auto forEachVisibleImage = [&](const Camera &camera, auto f) {
+    const auto viewMatrix = camera.getViewMatrix();
+    const auto frustum = getFrustum(projMatrix * viewMatrix);
+    const auto pixelsPerUnit =
+        0.5f * float(m_nWindowHeight) * projMatrix[1][1];
+    for (size_t drawIdx = 0; drawIdx < drawCommands.size(); ++drawIdx) {
+      const auto &bounds = primitiveBounds[drawIdx];
+      const auto materialIdx = drawCommands[drawIdx].material;
+      if (materialIdx < 0 || !lodVisibleDraws[drawIdx] ||
+          !intersects(frustum, bounds)) {
+        continue;
+      }
+      const auto center = glm::vec3(
+          viewMatrix * glm::vec4(0.5f * (bounds.min + bounds.max), 1));
+      const auto radius = 0.5f * glm::length(bounds.max - bounds.min);
+      const auto distance = glm::length(center) - radius;
+      const auto pixelSize = distance > 0
+                                 ? 2.f * radius * pixelsPerUnit / distance
+                                 : std::numeric_limits<float>::max();
+      for (const auto textureIdx : getMaterialTextures(materialIdx)) {
+        const auto imageIdx = getTextureImage(textureIdx);
+        if (imageIdx >= 0) {
+          f(imageIdx, pixelSize);
+        }
+      }
+    }
+  };
+  // Request the levels sampled by the draws visible from camera
+  const auto requestTextureLevels = [&](const Camera &camera) {
+    textureStreamer->beginFrame();
+    forEachVisibleImage(camera, [&](int imageIdx, float pixelSize) {
+      if (imageStreamedTextures[imageIdx] >= 0) {
+        textureStreamer->request(
+            size_t(imageStreamedTextures[imageIdx]), pixelSize);
+      }
+    });
+  };
+  // Transfer the queued textures within the budget of a frame, those of the
+  // images sampled by the largest draws visible from camera first. Returns
+  // true if textures were completed.
+  const auto updateUploads = [&](const Camera &camera) {
+    forEachVisibleImage(camera, [&](int imageIdx, float pixelSize) {
+      progressiveTextures.setUploadPriority(imageIdx, pixelSize);
+    });
+    const auto completedCount =
+        progressiveTextures.updateUploads(textureUploader);
+    lazyImageCount += lazyTextures ? completedCount : 0;
+    return completedCount > 0;
+  };
+  // Replace the texture of an image by textureObject, the handles of the
+  // previous one are made non resident
+  const auto replaceImageTexture = [&](int imageIdx, GLuint textureObject) {
+    for (auto it = begin(residentHandles); it != end(residentHandles);) {
+      if (it->first.first == imageTextures[imageIdx]) {
+        bindless.makeTextureHandleNonResident(it->second);
+        it = residentHandles.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    imageTextures.reset(imageIdx, textureObject);
+  };
+  // Replace the texture of a streamed image by textureObject, created from
+  // level, unless it could not be created
+  const auto replaceStreamedTexture = [&](size_t texture, GLint level,
+                                          GLuint textureObject) {
+    if (!textureObject) {
+      return;
+    }
+    replaceImageTexture(streamedTextureImages[texture], textureObject);
+    textureStreamer->setResidentLevel(texture, level);
+  };
+  // Create the textures of the levels downsampled since the last frame, and
+  // start creating the changes of levels the streamer plans for camera.
+  // Returns true if textures were replaced or are being created.
+  const auto streamTextureLevels = [&](const Camera &camera) {
+    auto streamedTextures = false;
+    for (auto it = begin(streamedLevels); it != end(streamedLevels);) {
+      if (!it->job.done()) {
+        ++it;
+        continue;
+      }
+      streamedTextures = true;
+      const auto &usage = imageUsages[streamedTextureImages[it->texture]];
+      replaceStreamedTexture(it->texture, it->level,
+          textureUploader.createTexture(*it->image, usage.generateMipmaps,
+              m_options.hardwareSrgb && usage.color));
+      it = streamedLevels.erase(it);
+    }
+
+    requestTextureLevels(camera);
+    std::vector<bool> busyTextures(textureStreamer->textureCount(), false);
+    for (const auto &streamed : streamedLevels) {
+      busyTextures[streamed.texture] = true;
+    }
+    for (const auto &change : textureStreamer->update(4, busyTextures)) {
+      const auto imageIdx = streamedTextureImages[change.texture];
+      const auto &image = model.images[imageIdx];
+      const auto &usage = imageUsages[imageIdx];
+      const auto residentLevel = textureStreamer->residentLevel(change.texture);
+      if (change.level > residentLevel && isMipmapped(imageIdx)) {
+        replaceStreamedTexture(change.texture, change.level,
+            copyTextureLevels(
+                imageTextures[imageIdx], change.level - residentLevel));
+      } else if (isKtx2Image(image) || change.level == 0) {
+        replaceStreamedTexture(change.texture, change.level,
+            createTextureObject(model, imageIdx, textureUploader,
+                usage.generateMipmaps, usage.color, change.level));
+      } else {
+        const auto levelImage = std::make_shared<tinygltf::Image>();
+        const auto level = change.level;
+        const auto color = usage.color;
+        streamedLevels.push_back(StreamedLevel{change.texture, level,
+            levelImage,
+            JobSystem::global().add([&image, levelImage, level, color]() {
+              *levelImage = downsampleImage(image, level, color);
+            })});
+      }
+      streamedTextures = true;
+    }
+    return streamedTextures;
+  };
+
+  // With --pipelined, packets drawn by this frame and built for the next one
+  FramePacket pipelinedPackets[2];
+  JobSystem::Handle framePacketJob; // Building pipelinedPackets[1]
+  auto hasDrawnPacket = false;
+
+  // With --cache-scene, the scene is drawn in sceneImage and copied under the
+  // GUI, and only drawn again once what it shows changed
+  std::unique_ptr<OffscreenFramebuffer> sceneImage;
+  // With --target-frame-time, the scene is drawn in the bottom left of
+  // sceneImage at the scale of dynamicResolution, then upscaled to the
+  // window. The depth pyramid of occlusion culling is of the window size.
+  std::unique_ptr<DynamicResolution> dynamicResolution;
+  if (m_options.targetFrameTime > 0 && !depthPyramid) {
+    dynamicResolution =
+        std::make_unique<DynamicResolution>(m_options.targetFrameTime * 1e-3);
+  }
+  // With --refine, frames of a still view are drawn at the window size with
+  // jittered projections and averaged by frameAccumulator, up to
+  // refineFrameCount of them. While the view changes, interactive frames are
+  // drawn instead, at half the window size without dynamicResolution.
+  std::unique_ptr<FrameAccumulator> frameAccumulator;
+  if (m_options.refineFrameCount > 0) {
+    frameAccumulator = std::make_unique<FrameAccumulator>(m_nWindowWidth,
+        m_nWindowHeight,
+        programCache.compileProgram(
+            {m_ShadersRootPath / "accumulate_frame.cs.glsl"}));
+  }
+  if (m_options.cacheSceneImage || dynamicResolution || frameAccumulator ||
+      drawIdPicker) {
+    sceneImage = std::make_unique<OffscreenFramebuffer>(size_t(m_nWindowWidth),
+        size_t(m_nWindowHeight), GL_RGBA8, 1, bool(drawIdPicker));
+  }
+  // With --stereo, the eyes are drawn at half the width of the window, side
+  // by side
+  std::unique_ptr<StereoFramebuffer> stereoFramebuffer;
+  const auto createStereoFramebuffer = [&]() {
+    stereoFramebuffer.reset();
+    stereoFramebuffer =
+        std::make_unique<StereoFramebuffer>(framebufferTextureMultiview,
+            std::max(m_nWindowWidth / 2, 1), m_nWindowHeight,
+            m_options.hardwareSrgb);
+  };
+  if (stereo) {
+    createStereoFramebuffer();
+  }
+  // With --viewports, each view is drawn in viewportImage, of a quarter of
+  // the window with its aspect ratio and projection, then copied to its
+  // corner. Only the bottom right view follows the camera, the others look
+  // at the center of the scene bounds along its axes.
+  std::unique_ptr<OffscreenFramebuffer> viewportImage;
+  const auto createViewportImage = [&]() {
+    viewportImage.reset();
+    viewportImage = std::make_unique<OffscreenFramebuffer>(
+        size_t(std::max(m_nWindowWidth / 2, 1)),
+        size_t(std::max(m_nWindowHeight / 2, 1)), GL_RGBA8);
+  };
+  FramePacket viewportPackets[4];
+  std::vector<Camera> viewportCameras;
+  if (multiViewport) {
+    createViewportImage();
+    const auto center = 0.5f * (bboxMin + bboxMax);
+    const auto distance = maxDist > 0.f ? maxDist : 1.f;
+    viewportCameras = {
+        Camera(center + glm::vec3(0, distance, 0), center, glm::vec3(0, 0, -1)),
+        Camera(center + glm::vec3(0, 0, distance), center, glm::vec3(0, 1, 0)),
+        Camera(center + glm::vec3(distance, 0, 0), center, glm::vec3(0, 1, 0))};
+  }
+  // Size of the image of the scene in sceneImage
+  auto sceneImageWidth = m_nWindowWidth;
+  auto sceneImageHeight = m_nWindowHeight;
+  const auto getSceneImageState = [&](const Camera &camera) {
+    return std::make_tuple(camera.eye(), camera.center(), camera.up(),
+        lightDirection, lightIntensity, lightFromCamera, applyOcclusion,
+        applyAmbientOcclusion, punctualLights, shadows, environmentIntensity, frustumCulling,
+        occlusionCulling, meshletCulling, lodPixelError, debugView,
+        activeVariant);
+  };
+  // Of the image in sceneImage, none if it needs to be drawn
+  std::optional<decltype(getSceneImageState(Camera{}))> sceneImageState;
+  // Of the view averaged by frameAccumulator
+  std::optional<decltype(getSceneImageState(Camera{}))> refinedViewState;
+  // With --taa, of the view whose frames converge in the history, and their
+  // number so far. A still view is drawn again until it converged.
+  std::optional<decltype(getSceneImageState(Camera{}))> temporalViewState;
+  size_t temporalFrameCount = 0;
+
+  // Model dropped on the window being loaded, empty if none
+  fs::path loadingFile;
+  const auto loadDroppedScene = [&](bool decodeImagesInBackground) {
+    std::shared_ptr<LoadedScene> scene;
+    try {
+      scene = loadScene(loadingFile, m_options, decodeImagesInBackground);
+    } catch (const std::exception &e) {
+      std::cerr << "Error : " << e.what() << std::endl;
+    }
+    if (!scene) {
+      std::cerr << "Error : unable to load " << loadingFile.string()
+                << std::endl;
+    }
+    return scene;
+  };
+
+  // With --on-demand, frames to draw before waiting for events. Changes made
+  // by input in the GUI are drawn by the frame after the one processing it,
+  // and with --pipelined, the last camera by the frame after the one culled.
+  const auto onDemandFrameCount = 2u;
+  auto frameCountToDraw = onDemandFrameCount;
+
+  // Path typed in the GUI to open a model
+  std::array<char, 1024> openedPath{};
+  m_gltfFilePath.string().copy(openedPath.data(), openedPath.size() - 1);
+
+  // Scene panel of the GUI, its filter typed and the picked node it last
+  // revealed
+  std::unique_ptr<SceneOutliner> outliner;
+  if (m_OutputPath.empty()) {
+    outliner = std::make_unique<SceneOutliner>(model, flatScene);
+  }
+  std::array<char, 256> outlinerFilter{};
+  auto outlinerPickedNode = -1;
+
+  // With --watch, the files of the model and the shaders of glslProgram are
+  // reloaded once saved: a changed image replaces its texture, a glTF file
+  // whose nodes alone moved their local matrices and a shader glslProgram.
+  // Other changes, or the ones the scene cannot apply in place, reload the
+  // model like a dropped one, from the current camera.
+  std::unique_ptr<FileWatcher> fileWatcher;
+  const auto vertexShaderPath = m_ShadersRootPath / m_vertexShader;
+  const auto fragmentShaderPath = m_ShadersRootPath / m_fragmentShader;
+  std::map<fs::path, std::vector<int>> imageFiles; // Images of each file
+  if (m_options.watchFiles) {
+    fileWatcher = std::make_unique<FileWatcher>();
+    fileWatcher->add(m_gltfFilePath);
+    fileWatcher->add(vertexShaderPath);
+    fileWatcher->add(fragmentShaderPath);
+    const auto baseDir = m_gltfFilePath.parent_path();
+    const auto isFileUri = [](const std::string &uri) {
+      return !uri.empty() && uri.compare(0, 5, "data:") != 0;
+    };
+    for (const auto &buffer : model.buffers) {
+      if (isFileUri(buffer.uri)) {
+        fileWatcher->add(baseDir / buffer.uri);
+      }
+    }
+    for (size_t i = 0; i < model.images.size(); ++i) {
+      if (isFileUri(model.images[i].uri)) {
+        imageFiles[baseDir / model.images[i].uri].push_back(int(i));
+        fileWatcher->add(baseDir / model.images[i].uri);
+      }
+    }
+  }
+  // Variants, the G-buffer programs and the depth pre-pass are compiled from
+  // the same shaders
+  const auto canReloadProgram = !materialVariants && !hasAlphaModes &&
+                                !gbuffer && !m_options.depthPrepass;
+  // Texture arrays and streamed textures are derived from the images, and so
+  // are images still decoding in the background
+  const auto canReloadImages = [&]() {
+    return !textureArrays && !textureStreamer &&
+           !progressiveTextures.isDecoding() &&
+           !progressiveTextures.queuedUploads() &&
+           (!loaderThread || loaderThread->idle());
+  };
+  // Returns false if the shaders no longer fit the draw loop, which sets
+  // uniforms at the locations of glslProgram
+  const auto reloadProgram = [&]() {
+    try {
+      auto program = programCache.compileProgram(
+          {vertexShaderPath, fragmentShaderPath}, programDefines);
+      for (const auto &uniform :
+          {std::make_pair("uMaterialIndex", uMaterialIndex),
+              std::make_pair("uPositionOffset", uPositionOffset),
+              std::make_pair("uPositionScale", uPositionScale),
+              std::make_pair("uUseDrawTable", uUseDrawTable),
+              std::make_pair("uDebugView", uDebugView)}) {
+        if (program.getUniformLocation(uniform.first) != uniform.second) {
+          return false;
+        }
+      }
+      setupProgram(program);
+      program.setUniform(uBindlessTextures, GLint(useBindlessTextures));
+      program.setUniform(uUseDrawTable, GLint(multiDraw));
+      // Current between draws, like the previous one
+      glslProgram = std::move(program);
+      glslProgram.use();
+      std::fill(begin(materialPrograms), end(materialPrograms),
+          glslProgram.glId());
+    } catch (const std::exception &e) {
+      // Drawn with the previous shaders until they compile again
+      std::cerr << "Error : " << e.what() << std::endl;
+    }
+    return true;
+  };
+  // Decode the image again from its file and replace its texture
+  const auto reloadImage = [&](int imageIdx, const fs::path &path) {
+    std::ifstream input(path.string(), std::ios::binary);
+    const std::vector<unsigned char> bytes(
+        (std::istreambuf_iterator<char>(input)),
+        std::istreambuf_iterator<char>());
+    auto &image = model.images[imageIdx];
+    tinygltf::Image reloaded;
+    reloaded.name = image.name;
+    reloaded.uri = image.uri;
+    reloaded.mimeType = image.mimeType;
+    std::string err;
+    if (bytes.empty() ||
+        !loadImageData(&reloaded, imageIdx, &err, nullptr, 0, 0, bytes.data(),
+            int(bytes.size()), nullptr)) {
+      std::cerr << "Error : unable to reload " << path.string() << " " << err
+                << std::endl;
+      return false;
+    }
+    const auto &usage = imageUsages[imageIdx];
+    if (m_options.cpuMipmaps && usage.generateMipmaps) {
+      generateMipChain(reloaded, usage.color);
+    }
+    image = std::move(reloaded);
+    const auto textureObject = createTextureObject(model, imageIdx,
+        textureUploader, usage.generateMipmaps, usage.color);
+    if (m_options.releaseCpuData) {
+      releaseImageData(image);
+    }
+    if (!textureObject) {
+      return false;
+    }
+    replaceImageTexture(imageIdx, textureObject);
+    return true;
+  };
+  // The local matrices of the nodes of the model parsed again from the file,
+  // or the model itself when more than its nodes moved
+  const auto reloadNodes = [&]() {
+    const auto scene =
+        loadScene(m_gltfFilePath, m_options, decodeImagesInBackground());
+    if (!scene) {
+      return;
+    }
+    if (!differOnlyInNodeTransforms(model, scene->model)) {
+      m_nextScene = scene;
+      return;
+    }
+    // Not while a job builds a frame packet from the scene
+    JobSystem::global().wait(framePacketJob);
+    for (size_t i = 0; i < flatScene.size(); ++i) {
+      // Entries of EXT_mesh_gpu_instancing keep the TRS of their instance
+      const auto nodeIdx = flatScene.nodes[i];
+      const auto parent = flatScene.parents[i];
+      if (parent >= 0 && flatScene.nodes[parent] == nodeIdx) {
+        continue;
+      }
+      const auto localMatrix =
+          getLocalToWorldMatrix(scene->model.nodes[nodeIdx], glm::mat4(1));
+      if (localMatrix != flatScene.localMatrices[i]) {
+        setLocalMatrix(flatScene, i, localMatrix);
+      }
+    }
+    model.nodes = scene->model.nodes;
+    m_flatScenes.clear();
+  };
+  // Returns true if textures were replaced
+  const auto reloadChangedFiles = [&](double seconds) {
+    const auto changedFiles = fileWatcher->poll(seconds);
+    for (const auto &path : changedFiles) {
+      std::clog << "Reloading " << path << "\n";
+    }
+    // A buffer feeds bounds, hierarchies and packed geometry
+    const auto needsModelReload = [&](const fs::path &path) {
+      if (path == vertexShaderPath || path == fragmentShaderPath) {
+        return !canReloadProgram;
+      }
+      return path != m_gltfFilePath &&
+             (!imageFiles.count(path) || !canReloadImages());
+    };
+    if (std::any_of(begin(changedFiles), end(changedFiles), needsModelReload)) {
+      m_droppedFile = m_gltfFilePath;
+      return false;
+    }
+    auto reloadedTextures = false;
+    for (const auto &path : changedFiles) {
+      if (path == m_gltfFilePath) {
+        reloadNodes();
+      } else if (path == vertexShaderPath || path == fragmentShaderPath) {
+        if (!reloadProgram()) {
+          m_droppedFile = m_gltfFilePath;
+        }
+      } else {
+        for (const auto imageIdx : imageFiles[path]) {
+          if (reloadImage(imageIdx, path)) {
+            reloadedTextures = true;
+          }
+        }
+      }
+    }
+    return reloadedTextures;
+  };
+
+  // Size of the window last seen, and when it was first seen. Until it is
+  // applied, frames are drawn at the previous size in the bottom left of the
+  // window.
+  auto resizedWindowSize = glm::ivec2(m_nWindowWidth, m_nWindowHeight);
+  auto resizeSeconds = 0.;
+  const auto isResizePending = [&]() {
+    return resizedWindowSize.x > 0 && resizedWindowSize.y > 0 &&
+           resizedWindowSize != glm::ivec2(m_nWindowWidth, m_nWindowHeight);
+  };
+  // Apply the size of the window once debounced, returns true if it changed.
+  // Minimized windows keep their targets.
+  const auto applyWindowSize = [&](double seconds) {
+    const auto size = m_GLFWHandle->windowSize();
+    if (size != resizedWindowSize) {
+      resizedWindowSize = size;
+      resizeSeconds = seconds;
+    }
+    if (!isResizePending() ||
+        seconds - resizeSeconds < RESIZE_DEBOUNCE_DELAY) {
+      return false;
+    }
+    m_nWindowWidth = size.x;
+    m_nWindowHeight = size.y;
+    projMatrix = getProjMatrix();
+    if (depthPyramid) {
+      depthPyramid->resize(m_nWindowWidth, m_nWindowHeight);
+    }
+    if (frameAccumulator) {
+      frameAccumulator->resize(m_nWindowWidth, m_nWindowHeight);
+    }
+    if (sceneImage) {
+      sceneImage.reset();
+      sceneImage = std::make_unique<OffscreenFramebuffer>(
+          size_t(m_nWindowWidth), size_t(m_nWindowHeight), GL_RGBA8, 1,
+          bool(drawIdPicker));
+    }
+    if (stereoFramebuffer) {
+      createStereoFramebuffer();
+    }
+    if (viewportImage) {
+      createViewportImage();
+    }
+    sceneImageWidth = m_nWindowWidth;
+    sceneImageHeight = m_nWindowHeight;
+    sceneImageState.reset();
+    refinedViewState.reset();
+    temporalViewState.reset();
+    return true;
+  };
+
+  auto previousSeconds = glfwGetTime(); // Start of the previous frame
+
+  // Move the camera and pick from the input polled, seconds after the last
+  // time it was
+  const auto handleInput = [&](double ellapsedTime) {
+    auto guiHasFocus = m_isGuiVisible && (ImGui::GetIO().WantCaptureMouse ||
+                                             ImGui::GetIO().WantCaptureKeyboard);
+    if (!guiHasFocus) {
+      const CpuScopeTimer timer(profiler.get(), cameraCpuScope);
+      if (cameraController->update(float(ellapsedTime))) {
+        frameCountToDraw = onDemandFrameCount + 1;
+      }
+      if (glfwGetMouseButton(m_GLFWHandle->window(), GLFW_MOUSE_BUTTON_LEFT) &&
+          glfwGetKey(m_GLFWHandle->window(), GLFW_KEY_LEFT_CONTROL)) {
+        if (drawIdPicker) {
+          double x = 0, y = 0;
+          glfwGetCursorPos(m_GLFWHandle->window(), &x, &y);
+          const auto pixelX = x * drawIdsWidth / m_nWindowWidth;
+          const auto pixelY =
+              (m_nWindowHeight - y) * drawIdsHeight / m_nWindowHeight;
+          if (pixelX >= 0 && pixelY >= 0) {
+            drawIdPicker->request(*sceneImage, size_t(pixelX), size_t(pixelY));
+            markFrameWork(FrameTiming::Readback);
+          }
+        } else {
+          pickPrimitive(cameraController->getCamera());
+        }
+      }
+    }
+  };
+  // With --low-latency, the fence after the last frame swapped: the next one
+  // polls its input once the GPU is done with it, and no frame is queued
+  // behind another. From the input of the frame to its end on the GPU, the
+  // latency is averaged over the last frames.
+  GLsync swappedFrameFence = nullptr;
+  auto inputSeconds = glfwGetTime(); // Of the frame swapped
+  auto inputLatency = 0.;
+  // Between the starts of frames, averaged over the last ones
+  auto averageFrameTime = 1. / 60.;
+  // Time the GUI was last built, negative to build it at the next frame, and
+  // the cursor position then
+  auto guiBuildSeconds = -1.;
+  auto guiCursorX = 0., guiCursorY = 0.;
+
+  // Loop until the user closes the window or a dropped model is loaded
+  for (auto iterationCount = 0u; !m_GLFWHandle->shouldClose() && !m_nextScene;
+       ++iterationCount) {
+    auto isIdle = false;
+    if (m_options.renderOnDemand && frameCountToDraw == 0) {
+      // Pending resizes, textures and dropped models loading in the
+      // background, watched files and remote input wake the loop at a few
+      // frames per second
+      const TraceZone waitZone("waitEvents");
+      if (isResizePending()) {
+        glfwWaitEventsTimeout(RESIZE_DEBOUNCE_DELAY);
+      } else if (progressiveTextures.isDecoding() || !loadingFile.empty() ||
+                 (loaderThread && !loaderThread->idle()) ||
+                 !streamedLevels.empty() || fileWatcher ||
+                 progressiveTextures.queuedUploads() ||
+                 !pendingVariants.empty() ||
+                 !preloadedVariantMaterials.empty() ||
+                 m_remoteInput ||
+                 (tilePager && !tilePager->idle())) {
+        glfwWaitEventsTimeout(0.1);
+      } else {
+        glfwWaitEvents();
+      }
+      frameCountToDraw = onDemandFrameCount;
+      isIdle = true;
+    }
+    const TraceZone frameZone("frame");
+    const auto seconds = glfwGetTime();
+    if (profiler) {
+      profiler->beginFrame();
+    }
+    if (frameTiming) {
+      frameTiming->beginFrame(isIdle);
+    }
+    // Sampled by updateMovedNodes, once no job reads the scene
+    if (animationPlayer &&
+        animationPlayback.advance(
+            *animationPlayer, seconds - previousSeconds)) {
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    averageFrameTime =
+        0.95 * averageFrameTime + 0.05 * (seconds - previousSeconds);
+    previousSeconds = seconds;
+    if (applyWindowSize(seconds)) {
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    CpuScopeTimer frameTimer(profiler.get(), frameCpuScope);
+
+    auto createdTextures =
+        progressiveTextures.createDecodedTextures(textureUploader);
+    if (loaderThread) {
+      loaderThread->publishCompletedJobs();
+      createdTextures =
+          progressiveTextures.takePublishedTextures() || createdTextures;
+    }
+    if (textureStreamer &&
+        streamTextureLevels(cameraController->getCamera())) {
+      createdTextures = true;
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    // Frames are drawn until the queue is empty, each transferring its part
+    if (progressiveTextures.queuedUploads()) {
+      createdTextures =
+          updateUploads(cameraController->getCamera()) || createdTextures;
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    if (createdTextures) {
+      markFrameWork(FrameTiming::TextureUpload);
+    }
+    if (fileWatcher && reloadChangedFiles(seconds)) {
+      createdTextures = true;
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+      markFrameWork(FrameTiming::FileReload);
+    }
+    // Materials are drawn again with the variants which linked
+    if (!pendingVariants.empty() && pollVariantPrograms()) {
+      createdTextures = true;
+      markFrameWork(FrameTiming::ShaderCompile);
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    // Frames with nothing else to load create the textures of a material of
+    // the other variants. They are not drawn, the image is kept.
+    if (!preloadedVariantMaterials.empty() && !createdTextures &&
+        !progressiveTextures.queuedUploads()) {
+      if (createMaterialTextures(preloadedVariantMaterials.back()) &&
+          useBindlessTextures) {
+        uploadMaterialTextureHandles();
+      }
+      preloadedVariantMaterials.pop_back();
+    }
+    // Input of the remote client draws frames like events of the window
+    if (m_remoteInput && m_remoteInput->takeChanges()) {
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    // Tiles are selected again until those of the view are paged in
+    const auto isPagingTiles = tilePager && !tilePager->idle();
+    if (isPagingTiles) {
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    if (createdTextures && useBindlessTextures) {
+      uploadMaterialTextureHandles();
+    }
+
+    if (m_options.lowLatency) {
+      if (swappedFrameFence) {
+        const TraceZone waitZone("waitSwappedFrame");
+        glClientWaitSync(
+            swappedFrameFence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(swappedFrameFence);
+        swappedFrameFence = nullptr;
+        const auto latency = glfwGetTime() - inputSeconds;
+        inputLatency =
+            inputLatency > 0. ? 0.9 * inputLatency + 0.1 * latency : latency;
+      }
+      glfwPollEvents();
+      const auto previousInputSeconds = inputSeconds;
+      inputSeconds = glfwGetTime();
+      handleInput(inputSeconds - previousInputSeconds);
+      if (frameTiming) {
+        frameTiming->markInput(inputSeconds);
+      }
+    }
+    const auto camera = cameraController->getCamera();
+    if (recordedCameras.is_open()) {
+      recordedCameras << formatCamera(camera) << "\n";
+    }
+    if (profiler) {
+      profiler->beginGpuPass(sceneGpuPass);
+    }
+    if (createdTextures || isPagingTiles || !flatScene.dirtyNodes.empty() ||
+        animationPlayback.isPoseDirty()) {
+      sceneImageState.reset();
+      refinedViewState.reset();
+      temporalViewState.reset();
+    }
+    const auto viewState = getSceneImageState(camera);
+    if (temporalAntiAliasing && temporalViewState != viewState) {
+      temporalViewState = viewState;
+      temporalFrameCount = 0;
+    }
+    const auto isViewStill = frameAccumulator && refinedViewState == viewState;
+    if (frameAccumulator && !isViewStill) {
+      frameAccumulator->reset();
+      refinedViewState = viewState;
+    }
+    isInteractiveFrame = frameAccumulator && !isViewStill;
+    const auto isSceneImageValid =
+        m_options.cacheSceneImage && sceneImageState == viewState;
+    if (dynamicResolution && !isSceneImageValid && !isViewStill) {
+      dynamicResolution->begin();
+      sceneImageWidth = std::max(
+          GLsizei(float(m_nWindowWidth) * dynamicResolution->scale()), 1);
+      sceneImageHeight = std::max(
+          GLsizei(float(m_nWindowHeight) * dynamicResolution->scale()), 1);
+    } else if (isInteractiveFrame && !depthPyramid) {
+      sceneImageWidth = std::max(m_nWindowWidth / 2, 1);
+      sceneImageHeight = std::max(m_nWindowHeight / 2, 1);
+    }
+    // Camera of the frame being drawn
+    auto drawnCamera = camera;
+    // With --stereo, both eyes are drawn in stereoFramebuffer, then copied
+    // side by side to the window
+    const auto drawView = [&](const Camera &camera, FramePacket *packet) {
+      if (!stereoFramebuffer) {
+        drawScene(camera, glm::mat4(1), sceneImageWidth, sceneImageHeight,
+            packet);
+        return;
+      }
+      stereoFramebuffer->render([&]() {
+        drawScene(camera, glm::mat4(1), stereoFramebuffer->eyeWidth(),
+            stereoFramebuffer->eyeHeight(), packet);
+      });
+      stereoFramebuffer->blitSideBySide(m_nWindowWidth, m_nWindowHeight);
+      glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
+    };
+    const auto drawFrame = [&]() {
+      if (m_options.pipelinedFrames) {
+        // Draw the packet of the previous camera while the job builds the one
+        // of this camera. The scene is only updated while no job runs.
+        JobSystem::global().wait(framePacketJob);
+        updateMovedNodes();
+        if (!hasDrawnPacket) {
+          pipelinedPackets[1].camera = camera;
+          buildFramePacket(glm::mat4(1), frustumCulling, pipelinedPackets[1]);
+        }
+        std::swap(pipelinedPackets[0], pipelinedPackets[1]);
+        pipelinedPackets[1].camera = camera;
+        framePacketJob = JobSystem::global().add(
+            [&, cullFrustum = frustumCulling]() {
+              buildFramePacket(glm::mat4(1), cullFrustum, pipelinedPackets[1]);
+            });
+        drawView(pipelinedPackets[0].camera, &pipelinedPackets[0]);
+        drawnCamera = pipelinedPackets[0].camera;
+        hasDrawnPacket = true;
+      } else if (viewportImage) {
+        // The scene is updated once for the four views, each culled and
+        // drawn from its camera
+        updateMovedNodes();
+        glClear(GL_COLOR_BUFFER_BIT);
+        const auto width = GLsizei(viewportImage->width());
+        const auto height = GLsizei(viewportImage->height());
+        for (size_t i = 0; i < 4; ++i) {
+          auto &packet = viewportPackets[i];
+          packet.camera = i < viewportCameras.size() ? viewportCameras[i]
+                                                     : camera;
+          buildFramePacket(glm::mat4(1), frustumCulling, packet);
+          viewportImage->render([&]() {
+            drawScene(packet.camera, glm::mat4(1), width, height, &packet);
+          });
+          // Top left, top right, bottom left, bottom right
+          viewportImage->blitColorAt(
+              i % 2 ? size_t(m_nWindowWidth - width) : 0,
+              i < 2 ? size_t(m_nWindowHeight - height) : 0);
+        }
+        glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
+      } else {
+        drawView(camera, nullptr);
+      }
+    };
+    if (isViewStill) {
+      if (frameAccumulator->frameCount() < m_options.refineFrameCount) {
+        // Drawn from the camera of this frame, while no job reads the scene
+        JobSystem::global().wait(framePacketJob);
+        sceneImage->render([&]() {
+          drawScene(camera, frameAccumulator->getJitterMatrix(),
+              m_nWindowWidth, m_nWindowHeight);
+        });
+        frameAccumulator->add(sceneImage->colorTexture());
+        sceneImageState.reset();
+      }
+      frameAccumulator->blitAverage();
+    } else if (sceneImage && !isSceneImageValid) {
+      sceneImage->render(drawFrame);
+      sceneImageState = getSceneImageState(drawnCamera);
+      if (dynamicResolution) {
+        dynamicResolution->end();
+      }
+    } else if (!sceneImage) {
+      drawFrame();
+    }
+    if (sceneImage && !isViewStill) {
+      sceneImage->blitColor(size_t(sceneImageWidth), size_t(sceneImageHeight),
+          size_t(m_nWindowWidth), size_t(m_nWindowHeight));
+    }
+    if (sceneImage) {
+      glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
+    }
+    if (selectionOutline && primitivePicker.nodeIdx() >= 0) {
+      selectionOutline->draw(sceneImage->drawIdTexture(), drawIdsWidth,
+          drawIdsHeight, primitivePicker.firstDrawId(),
+          primitivePicker.endDrawId(), selectionOutlineWidth);
+    }
+    if (frameAccumulator &&
+        frameAccumulator->frameCount() < m_options.refineFrameCount) {
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    if (pathTracer &&
+        pathTracer->sampleCount() < m_options.pathTraceSampleCount) {
+      sceneImageState.reset();
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    if (temporalAntiAliasing &&
+        ++temporalFrameCount < TemporalAntiAliasing::CONVERGED_FRAME_COUNT) {
+      sceneImageState.reset();
+      frameCountToDraw = std::max(frameCountToDraw, onDemandFrameCount);
+    }
+    if (profiler) {
+      profiler->endGpuPass(sceneGpuPass);
+    }
+    uint32_t pickedDrawId = 0;
+    if (drawIdPicker && drawIdPicker->poll(pickedDrawId)) {
+      primitivePicker.pickDraw(pickedDrawId);
+      markFrameWork(FrameTiming::Readback);
+    }
+
+    
+    // The stream shows the scene without the GUI
+    if (m_frameStreamer) {
+      glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+      if (!m_frameStreamer->capture(m_nWindowWidth, m_nWindowHeight)) {
+        std::cerr << "Warning : stream stopped, ffmpeg failed" << std::endl;
+        m_frameStreamer = nullptr;
+      }
+    }
+
+    // GUI code, skipped once hidden. While the cursor is off the GUI and
+    // still, it is only built again at m_options.idleGuiRate, its last draw
+    // data drawn again in between.
+    TraceZone guiZone("gui");
+    double cursorX = 0, cursorY = 0;
+    glfwGetCursorPos(m_GLFWHandle->window(), &cursorX, &cursorY);
+    const auto &guiIO = ImGui::GetIO();
+    const auto windowSize = m_GLFWHandle->windowSize();
+    const auto isGuiBuilt =
+        m_isGuiVisible &&
+        (m_options.idleGuiRate <= 0. || guiBuildSeconds < 0. ||
+            seconds - guiBuildSeconds >= 1. / m_options.idleGuiRate ||
+            guiIO.WantCaptureMouse || guiIO.WantCaptureKeyboard ||
+            cursorX != guiCursorX || cursorY != guiCursorY ||
+            guiIO.DisplaySize.x != float(windowSize.x) ||
+            guiIO.DisplaySize.y != float(windowSize.y));
+    if (!m_isGuiVisible) {
+      guiBuildSeconds = -1.;
+    }
+    if (isGuiBuilt) {
+      guiBuildSeconds = seconds;
+      guiCursorX = cursorX;
+      guiCursorY = cursorY;
+      imguiNewFrame();
+      ImGui::Begin("GUI");
+      ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
+          1000. * averageFrameTime, 1. / averageFrameTime);
+      ImGui::Text("F1 hides the GUI");
+      if (m_options.lowLatency) {
+        ImGui::Text("Input to end of frame %.3f ms", 1000. * inputLatency);
+      }
+      if (m_frameStreamer) {
+        ImGui::Text("Streamed %zu frames, dropped %zu",
+            m_frameStreamer->sentFrameCount(),
+            m_frameStreamer->droppedFrameCount());
+      }
+      if (!loadingFile.empty()) {
+        ImGui::Text("loading %s", loadingFile.filename().string().c_str());
+      }
+      if (ImGui::CollapsingHeader("Model")) {
+        ImGui::Text("%s", m_gltfFilePath.filename().string().c_str());
+        if (fileWatcher) {
+          ImGui::SameLine();
+          ImGui::Text("(watching %zu files)", fileWatcher->size());
+        }
+        // Opened like a model dropped on the window
+        ImGui::InputText("##path", openedPath.data(), openedPath.size());
+        ImGui::SameLine();
+        if (ImGui::Button("Open") && openedPath[0]) {
+          m_droppedFile = openedPath.data();
+        }
+        const auto modelCount = m_options.modelList.size();
+        if (modelCount) {
+          // From the last entry or the first one if the model is not listed
+          const auto previous = ImGui::Button("Previous");
+          ImGui::SameLine();
+          const auto next = ImGui::Button("Next");
+          if (previous || next) {
+            m_modelListIdx =
+                m_modelListIdx < modelCount
+                    ? (m_modelListIdx + (next ? 1 : modelCount - 1)) %
+                          modelCount
+                    : (next ? 0 : modelCount - 1);
+            m_droppedFile = m_options.modelList[m_modelListIdx];
+          }
+          ImGui::SameLine();
+          if (m_modelListIdx < modelCount) {
+            ImGui::Text("%zu/%zu", m_modelListIdx + 1, modelCount);
+          } else {
+            ImGui::Text("-/%zu", modelCount);
+          }
+        }
+        // The model keeps its data to draw its other scenes
+        if (model.scenes.size() > 1 && !m_options.releaseCpuData) {
+          const auto getSceneName = [&](int sceneIdx) {
+            const auto &name = model.scenes[size_t(sceneIdx)].name;
+            return name.empty() ? "scene " + std::to_string(sceneIdx) : name;
+          };
+          if (ImGui::BeginCombo(
+                  "scene", getSceneName(drawnSceneIdx).c_str())) {
+            for (auto i = 0; i < int(model.scenes.size()); ++i) {
+              if (ImGui::Selectable(
+                      getSceneName(i).c_str(), i == drawnSceneIdx) &&
+                  i != drawnSceneIdx) {
+                m_drawnSceneIdx = i;
+                m_nextScene = m_scene;
+              }
+            }
+            ImGui::EndCombo();
+          }
+        }
+        const auto &variants = runtimeScene.variants;
+        if (!variants.empty() &&
+            ImGui::BeginCombo("variant",
+                activeVariant >= 0 ? variants[size_t(activeVariant)].c_str()
+                                   : "(default)")) {
+          for (auto i = -1; i < int(variants.size()); ++i) {
+            if (ImGui::Selectable(
+                    i >= 0 ? variants[size_t(i)].c_str() : "(default)",
+                    i == activeVariant) &&
+                i != activeVariant) {
+              // The packet job of --pipelined reads the materials of draws
+              JobSystem::global().wait(framePacketJob);
+              selectVariant(i);
+            }
+          }
+          ImGui::EndCombo();
+        }
+      }
+      if (outliner && ImGui::CollapsingHeader("Scene")) {
+        // Only the rows in view are drawn, see SceneOutliner
+        if (ImGui::InputText(
+                "filter", outlinerFilter.data(), outlinerFilter.size())) {
+          outliner->setFilter(outlinerFilter.data());
+        }
+        ImGui::Text("%zu nodes, %zu rows, %zu hidden", flatScene.size(),
+            outliner->rowCount(), drawVisibility.hiddenCount());
+        auto scrolledRow = -1;
+        if (primitivePicker.nodeIdx() >= 0 &&
+            primitivePicker.nodeIdx() != outlinerPickedNode) {
+          scrolledRow = int(outliner->reveal(primitivePicker.nodeIdx()));
+          outlinerFilter[0] = '\0';
+        }
+        outlinerPickedNode = primitivePicker.nodeIdx();
+        // Applied once the rows are drawn, the rows changing with them
+        auto expandedEntry = -1, hiddenEntry = -1;
+        ImGui::BeginChild("outliner", ImVec2(0, 300), true);
+        if (scrolledRow >= 0) {
+          ImGui::SetScrollY(
+              float(scrolledRow) * ImGui::GetFrameHeightWithSpacing());
+        }
+        const auto isTree = outliner->filter().empty();
+        ImGuiListClipper clipper(int(outliner->rowCount()));
+        while (clipper.Step()) {
+          for (auto row = clipper.DisplayStart; row < clipper.DisplayEnd;
+               ++row) {
+            const auto entry = outliner->rowEntry(size_t(row));
+            ImGui::PushID(entry);
+            if (isTree) {
+              ImGui::SetCursorPosX(ImGui::GetCursorPosX() +
+                                   float(outliner->depth(entry)) *
+                                       ImGui::GetTreeNodeToLabelSpacing());
+            }
+            if (isTree && outliner->hasChildren(entry)) {
+              if (ImGui::ArrowButton("##expand", outliner->isExpanded(entry)
+                                                     ? ImGuiDir_Down
+                                                     : ImGuiDir_Right)) {
+                expandedEntry = entry;
+              }
+            } else {
+              ImGui::Dummy(
+                  ImVec2(ImGui::GetFrameHeight(), ImGui::GetFrameHeight()));
+            }
+            ImGui::SameLine();
+            auto isVisible = !drawVisibility.isHidden(entry);
+            if (ImGui::Checkbox("##visible", &isVisible)) {
+              hiddenEntry = entry;
+            }
+            ImGui::SameLine();
+            if (ImGui::Selectable(
+                    outliner->name(entry), entry == outliner->selected())) {
+              outliner->select(entry);
+            }
+            ImGui::PopID();
           }
         }
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(uBaseColorTexture, 0);
-      }
-
-      if (uMetallicFactor >= 0) {
-        glUniform1f(
-            uMetallicFactor, (float)pbrMetallicRoughness.metallicFactor);
-      }
-      if (uRoughnessFactor >= 0) {
-        glUniform1f(
-            uRoughnessFactor, (float)pbrMetallicRoughness.roughnessFactor);
-      }
-      if (uMetallicRoughness >= 0) {
-        auto textureObject = 0u;
-        if (pbrMetallicRoughness.metallicRoughnessTexture.index >= 0) {
-          const auto &texture =
-              model.textures[pbrMetallicRoughness.metallicRoughnessTexture
-                                 .index];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
+        ImGui::EndChild();
+        if (expandedEntry >= 0) {
+          outliner->setExpanded(
+              expandedEntry, !outliner->isExpanded(expandedEntry));
+        }
+        const auto selected = outliner->selected();
+        auto isolate = false, showAll = false;
+        if (selected >= 0) {
+          ImGui::Text("selected: node %d, mesh %d", flatScene.nodes[selected],
+              flatScene.meshes[selected]);
+          if (ImGui::Button("Frame selected")) {
+            frameBounds(flatScene.subtreeBounds[selected]);
           }
+          ImGui::SameLine();
+          isolate = ImGui::Button("Isolate");
         }
-      }
-
-      if (uEmissiveFactor >= 0) {
-        glUniform3f(uEmissiveFactor, (float)material.emissiveFactor[0],
-            (float)material.emissiveFactor[1],
-            (float)material.emissiveFactor[2]);
-      }
-      if (uEmissiveTexture >= 0) {
-        auto textureObject = 0u;
-        if (material.emissiveTexture.index >= 0) {
-          const auto &texture = model.textures[material.emissiveTexture.index];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
+        if (drawVisibility.hiddenCount()) {
+          if (selected >= 0) {
+            ImGui::SameLine();
           }
+          showAll = ImGui::Button("Show all");
         }
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(uEmissiveTexture, 2);
-      }
-
-      if (uOcclusionStrength >= 0) {
-        glUniform1f(
-            uOcclusionStrength, (float)material.occlusionTexture.strength);
-      }
-      if (uOcclusionTexture >= 0) {
-        auto textureObject = whiteTexture;
-        if (material.occlusionTexture.index >= 0) {
-          const auto &texture = model.textures[material.occlusionTexture.index];
-          if (texture.source >= 0) {
-            textureObject = textureObjects[texture.source];
+        if (hiddenEntry >= 0 || isolate || showAll) {
+          // The packet job of --pipelined reads the visibility of draws
+          JobSystem::global().wait(framePacketJob);
+          if (showAll) {
+            drawVisibility.showAll();
+          } else if (isolate) {
+            drawVisibility.isolate(selected);
+          } else {
+            drawVisibility.setHidden(
+                hiddenEntry, !drawVisibility.isHidden(hiddenEntry));
           }
+          sceneImageState.reset();
+          refinedViewState.reset();
+          temporalViewState.reset();
         }
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, textureObject);
-        glUniform1i(uOcclusionTexture, 3);
-      }
-
-    } else {
-      if (uBaseColorFactor >= 0) {
-        glUniform4f(uBaseColorFactor, 1, 1, 1, 1);
       }
-      if (uBaseColorTexture >= 0) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, whiteTexture);
-        glUniform1i(uBaseColorTexture, 0);
-      }
-      if (uMetallicFactor >= 0) {
-        glUniform1f(uMetallicFactor, 1.f);
-      }
-      if (uRoughnessFactor >= 0) {
-        glUniform1f(uRoughnessFactor, 1.f);
-      }
-      if (uEmissiveFactor >= 0) {
-        glUniform3f(uEmissiveFactor, 0.f, 0.f, 0.f);
-      }
-      if (uEmissiveTexture >= 0) {
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(uEmissiveTexture, 2);
-      }  
-      if (uOcclusionStrength >= 0) {
-        glUniform1f(uOcclusionStrength, 0.f);
-      }
-      if (uOcclusionTexture >= 0) {
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, 0);
-        glUniform1i(uOcclusionTexture, 3);
-      }
-    }
-  };
-
-  // Lambda function to draw the scene
-  const auto drawScene = [&](const Camera &camera) {
-    glViewport(0, 0, m_nWindowWidth, m_nWindowHeight);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    const auto viewMatrix = camera.getViewMatrix();
-
-    if(lightFromCamera){
-      glUniform3f(uLightDirectionLocation, 0, 0, 1);
-    }
-    else{
-      const auto lightDirectionViewSpace = glm::normalize(glm::vec3(viewMatrix * glm::vec4(lightDirection,0.)));
-      glUniform3f(uLightDirectionLocation, lightDirectionViewSpace[0], lightDirectionViewSpace[1], lightDirectionViewSpace[2]);
-    }
-
-    if(uLightIntensity >= 0){
-      glUniform3f(uLightIntensity, lightIntensity[0], lightIntensity[1], lightIntensity[2]);
-    }
-
-    if (uApplyOcclusion >= 0) {
-      glUniform1i(uApplyOcclusion, applyOcclusion);
-    }
-
-    // The recursive function that should draw a node
-    // We use a std::function because a simple lambda cannot be recursive
-    const std::function<void(int, const glm::mat4 &)> drawNode =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          auto &node = model.nodes[nodeIdx];
-          const glm::mat4 modelMatrix = getLocalToWorldMatrix(node, parentMatrix);
-
-          //if node references a mesh
-          if(node.mesh >= 0){
-            //compute corresponding matrices, local to camera, local to screen, normal matrix
-            const auto modelViewMatrix = viewMatrix * modelMatrix;
-            const auto modelViewProjectionMatrix = projMatrix * modelViewMatrix;
-            const auto normalMatrix = glm::transpose(glm::inverse(modelViewMatrix));
-
-            //Get matrices to GPU
-            glUniformMatrix4fv(modelViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelMatrix));
-            glUniformMatrix4fv(modelViewProjMatrixLocation, 1, GL_FALSE, glm::value_ptr(modelViewProjectionMatrix));
-            glUniformMatrix4fv(normalMatrixLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-
-            //Draw every single primitive of the mesh
-            const auto &mesh = model.meshes[node.mesh];
-            const auto &vaoRange = meshToVA[node.mesh];
-
-            for(size_t prIdx = 0; prIdx < mesh.primitives.size(); ++prIdx){
-              const auto vao = vertexArrayObjects[vaoRange.begin + prIdx];
-              const auto &primitive = mesh.primitives[prIdx];
-              bindMaterial(primitive.material);
-              glBindVertexArray(vao);
-              //for those with IBO
-              if(primitive.indices >= 0){
-                const auto &accessor = model.accessors[primitive.indices];
-                const auto &bufferView = model.bufferViews[accessor.bufferView];
-                const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
-                glDrawElements(primitive.mode, GLsizei(accessor.count), accessor.componentType, (const GLvoid*)byteOffset);
-              }else{ //without IBO
-                const auto accessorIdx = (*begin(primitive.attributes)).second;
-                const auto &accessor = model.accessors[accessorIdx];
-                glDrawArrays(primitive.mode, 0, GLsizei(accessor.count));
-              }
+      if (animationPlayer && ImGui::CollapsingHeader("Animation")) {
+        const auto animationCount = animationPlayer->animationCount();
+        const auto getAnimationName = [&](size_t animation) {
+          const auto &name = animationPlayer->animationName(animation);
+          return name.empty() ? "animation " + std::to_string(animation)
+                              : name;
+        };
+        if (ImGui::BeginCombo(
+                "clip",
+                getAnimationName(animationPlayback.animation()).c_str())) {
+          for (size_t i = 0; i < animationCount; ++i) {
+            const auto isSelected = i == animationPlayback.animation();
+            if (ImGui::Selectable(getAnimationName(i).c_str(), isSelected) &&
+                !isSelected) {
+              animationPlayback.selectAnimation(i);
             }
-            glBindVertexArray(0);
-          }
-          for(const auto childNodeIdx : node.children){
-            drawNode(childNodeIdx, modelMatrix);
           }
-        };
-
-    // Draw the scene referenced by gltf file
-    if (model.defaultScene >= 0) {
-      // Draw all nodes
-      const auto &nodes = model.scenes[model.defaultScene].nodes;
-      for(const auto &nodeIdx : nodes){
-        drawNode(nodeIdx, glm::mat4(1));
+          ImGui::EndCombo();
+        }
+        const auto isPlaying = animationPlayback.isPlaying();
+        if (ImGui::Button(isPlaying ? "Pause" : "Play")) {
+          animationPlayback.setPlaying(!isPlaying);
+        }
+        ImGui::SameLine();
+        auto time = animationPlayback.time();
+        if (ImGui::SliderFloat("time", &time, 0.f,
+                animationPlayer->duration(animationPlayback.animation()),
+                "%.2f s")) {
+          animationPlayback.seek(time);
+        }
+        auto speed = animationPlayback.speed();
+        if (ImGui::SliderFloat("speed", &speed, -2.f, 2.f, "%.2f")) {
+          animationPlayback.setSpeed(speed);
+        }
+        ImGui::Text(
+            "sampled in %.3f ms", 1000. * animationPlayback.sampleSeconds());
       }
-    }
-  };
-
-  //Rendering image (png)
-  if(!m_OutputPath.empty()){
-    std::vector<unsigned char> pixels(m_nWindowWidth * m_nWindowHeight * 3);
-    renderToImage(m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), [&]() {
-      const auto camera = cameraController->getCamera();
-      drawScene(camera);
-    });
-
-    flipImageYAxis(m_nWindowWidth, m_nWindowHeight, 3, pixels.data()); //conventional since OpenGL has different image axis management
-
-    const auto strPath = m_OutputPath.string();
-    stbi_write_png(strPath.c_str(), m_nWindowWidth, m_nWindowHeight, 3, pixels.data(), 0);
-
-    return 0;
-  }
-
-  // Loop until the user closes the window
-  for (auto iterationCount = 0u; !m_GLFWHandle.shouldClose();
-       ++iterationCount) {
-         
-    const auto seconds = glfwGetTime();
-
-    const auto camera = cameraController->getCamera();
-    drawScene(camera);
-
-    
-    // GUI code:
-    imguiNewFrame();
-
-    {
-      ImGui::Begin("GUI");
-      ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
-          1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
       if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
         ImGui::Text("eye: %.3f %.3f %.3f", camera.eye().x, camera.eye().y,
             camera.eye().z);
@@ -380,7 +5977,18 @@ int ViewerApplication::run()
              << camera.center().y << "," << camera.center().z << ","
              << camera.up().x << "," << camera.up().y << "," << camera.up().z;
           const auto str = ss.str();
-          glfwSetClipboardString(m_GLFWHandle.window(), str.c_str());
+          glfwSetClipboardString(m_GLFWHandle->window(), str.c_str());
+        }
+
+        // From the cached bounds of flatScene, including animated nodes
+        if (ImGui::Button("Frame all")) {
+          frameBounds(flatScene.bounds);
+        }
+        if (primitivePicker.nodeIdx() >= 0) {
+          ImGui::SameLine();
+          if (ImGui::Button("Frame picked node")) {
+            frameBounds(flatScene.subtreeBounds[primitivePicker.nodeIdx()]);
+          }
         }
 
         static int cameraType = 0;
@@ -392,11 +6000,12 @@ int ViewerApplication::run()
         if(cameraTypeChanged){
           const auto currentCamera = cameraController->getCamera();
           if(cameraType == 0){
-            cameraController = std::make_unique<TrackballCameraController>(m_GLFWHandle.window(), 0.5f * maxDist);
+            cameraController = std::make_unique<TrackballCameraController>(m_GLFWHandle->window(), 0.5f * maxDist);
           }else{
-            cameraController = std::make_unique<FirstPersonCameraController>(m_GLFWHandle.window(), 0.5f * maxDist);
+            cameraController = std::make_unique<FirstPersonCameraController>(m_GLFWHandle->window(), 0.5f * maxDist);
           }
           cameraController->setCamera(currentCamera);
+          cameraController->setRemoteInput(m_remoteInput.get());
         }       
       }
 
@@ -420,35 +6029,405 @@ int ViewerApplication::run()
             lightIntensity = lightIntensityFactor * lightColor;
           }
           ImGui::Checkbox("Occlusion", &applyOcclusion);
+          if (ambientOcclusion) {
+            ImGui::SameLine();
+            ImGui::Checkbox("Ambient occlusion", &applyAmbientOcclusion);
+          }
           ImGui::Checkbox("Light from camera", &lightFromCamera);
+          if (lightClusters) {
+            ImGui::Checkbox("Punctual lights", &punctualLights);
+            ImGui::SameLine();
+            ImGui::Text("(%zu)", lightClusters->lightCount());
+          }
+          if (shadowCascades) {
+            ImGui::Checkbox("Shadows", &shadows);
+            ImGui::SameLine();
+            ImGui::Text("(%zu cascades rendered)", renderedCascadeCount);
+          }
+          if (environmentMap) {
+            ImGui::SliderFloat(
+                "Environment", &environmentIntensity, 0.f, 4.f);
+          }
         }         
+      if (ImGui::CollapsingHeader("Rendering", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        if (depthPyramid) {
+          ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        }
+        if (gpuCulling && !packedGeometry.meshlets.empty()) {
+          ImGui::Checkbox("Meshlet culling", &meshletCulling);
+        }
+        if (!packedGeometry.lods.empty() && !gpuCulling) {
+          ImGui::SliderFloat("LOD error (pixels)", &lodPixelError, 0.f, 16.f);
+        }
+        if (debugViews && ImGui::BeginCombo("Debug view",
+                              DebugViews::getModeName(debugView))) {
+          for (auto i = 0; i < DebugViews::MODE_COUNT; ++i) {
+            const auto mode = DebugViews::Mode(i);
+            if (mode == DebugViews::Wireframe && !hasWireframeView) {
+              continue; // No barycentrics in the shaders
+            }
+            if (ImGui::Selectable(
+                    DebugViews::getModeName(mode), mode == debugView)) {
+              debugView = mode;
+              glslProgram.setUniform(uDebugView, GLint(debugView));
+              for (auto &program : variantPrograms) {
+                program.setUniform(uDebugView, GLint(debugView));
+              }
+            }
+          }
+          ImGui::EndCombo();
+        }
+        if (dynamicResolution) {
+          ImGui::Text("resolution: %dx%d (target %.1f ms)", sceneImageWidth,
+              sceneImageHeight, m_options.targetFrameTime);
+        }
+        if (frameAccumulator) {
+          ImGui::Text("refined: %zu/%zu frames", frameAccumulator->frameCount(),
+              m_options.refineFrameCount);
+        }
+        if (pathTracer) {
+          ImGui::Text("traced: %zu/%zu samples", pathTracer->sampleCount(),
+              m_options.pathTraceSampleCount);
+        }
+        ImGui::Text("primitives: %zu drawn, %zu culled", drawnPrimitiveCount,
+            culledPrimitiveCount);
+        ImGui::Text("draws: %zu once instanced", instancedDrawCount);
+        if (m_options.coherentCulling && !gpuCulling) {
+          ImGui::Text("culling: %zu BVH nodes tested, %zu reused",
+              testedCullNodeCount, reusedCullNodeCount);
+        }
+        ImGui::Text("draw calls: %zu, triangles: %zu", drawStats.drawCalls,
+            drawStats.triangles);
+        ImGui::Text("binds: %zu vertex arrays, %zu textures",
+            drawStats.vertexArrayBinds, drawStats.textureBinds);
+        ImGui::Text("uniform uploads: %zu, buffer uploads: %zu bytes",
+            drawStats.uniformUploads, drawStats.uploadedBufferBytes);
+        if (conditionalRender) {
+          ImGui::Text("occlusion queries: %zu, conditional draws: %zu",
+              drawStats.occlusionQueries, drawStats.conditionalDraws);
+        }
+        if (impostors) {
+          ImGui::Text("impostors: %zu nodes, %zu meshes", drawStats.impostors,
+              impostorMeshes.size());
+        }
+        if (m_options.glContextMode != GLContextMode::NoError) {
+          ImGui::Text(
+              "GL performance messages: %zu", getGLPerformanceMessageCount());
+        }
+        if (lazyGeometry || lazyTextures) {
+          ImGui::Text("lazy resources: %zu/%zu primitives, %zu/%zu images",
+              lazyGeometry ? lazyPrimitiveCount : vertexArrayObjects.size(),
+              vertexArrayObjects.size(),
+              lazyTextures ? lazyImageCount : model.images.size(),
+              model.images.size());
+        }
+        if (tilePager) {
+          ImGui::Text("tiles: %zu/%zu uploaded, %zu loading, %.1f MiB RAM, "
+                      "%.1f MiB VRAM",
+              tilePager->uploadedTileCount(), tilePager->tileCount(),
+              tilePager->loadingTileCount(),
+              double(tilePager->ramBytes()) / (1 << 20),
+              double(tilePager->vramBytes()) / (1 << 20));
+        }
+        if (textureStreamer) {
+          ImGui::Text("streamed textures: %zu/%zu MiB, %zu levels loading",
+              textureStreamer->residentBytes() >> 20,
+              textureStreamer->budgetBytes() >> 20, streamedLevels.size());
+        }
+        if (const auto *uploadScheduler =
+                progressiveTextures.uploadScheduler()) {
+          ImGui::Text("uploads: %zu textures queued, %.1f MiB, "
+                      "%.1f MiB last frame",
+              uploadScheduler->queueDepth(),
+              double(uploadScheduler->queuedBytes()) / (1 << 20),
+              double(uploadScheduler->lastUpdateBytes()) / (1 << 20));
+        }
+        ImGui::Text("buffer heaps: %zu, %.1f/%.1f MiB allocated",
+            m_bufferHeap->heapCount(),
+            double(m_bufferHeap->allocatedBytes()) / (1 << 20),
+            double(m_bufferHeap->capacityBytes()) / (1 << 20));
+        ImGui::Text("GPU memory: %.1f MiB", double(m_gpuMemory.totalBytes()) /
+                                                (1024 * 1024));
+        if (m_gpuMemory.budgetBytes()) {
+          ImGui::SameLine();
+          ImGui::Text("(budget %zu MiB)", m_gpuMemory.budgetBytes() >> 20);
+        }
+        const auto categoryBytes = m_gpuMemory.categoryBytes();
+        for (size_t i = 0; i < categoryBytes.size(); ++i) {
+          ImGui::BulletText("%s: %.1f MiB",
+              getGpuMemoryCategoryName(GpuMemoryCategory(i)),
+              double(categoryBytes[i]) / (1024 * 1024));
+        }
+        DriverMemoryInfo driverMemory;
+        if (hasDriverMemoryInfo && queryDriverMemory(driverMemory)) {
+          if (driverMemory.dedicatedBytes) {
+            ImGui::Text("driver: %zu/%zu MiB of video memory free",
+                driverMemory.currentAvailableBytes >> 20,
+                driverMemory.dedicatedBytes >> 20);
+          } else {
+            ImGui::Text("driver: %zu MiB free for textures",
+                driverMemory.freeTextureBytes >> 20);
+          }
+        }
+        if (primitivePicker.nodeIdx() >= 0) {
+          ImGui::Text("picked: node %d, mesh %d, primitive %d",
+              flatScene.nodes[primitivePicker.nodeIdx()],
+              flatScene.meshes[primitivePicker.nodeIdx()],
+              primitivePicker.primitiveIdx());
+          if (selectionOutline) {
+            ImGui::SliderFloat(
+                "outline width", &selectionOutlineWidth, 1.f, 32.f);
+          }
+          if (!drawIdPicker) {
+            const auto &position = primitivePicker.position();
+            const auto triangle = primitivePicker.triangle();
+            ImGui::Text("%s %d at (%.3f, %.3f, %.3f)",
+                triangle >= 0 ? "triangle" : "box of triangle", triangle,
+                position.x, position.y, position.z);
+            if (primitivePicker.hasPreviousPosition()) {
+              ImGui::Text("distance to the previous pick: %.3f",
+                  glm::distance(position, primitivePicker.previousPosition()));
+            }
+            // Orbit around the picked point
+            if (ImGui::Button("Look at picked point")) {
+              const auto &camera = cameraController->getCamera();
+              if (position != camera.eye()) {
+                cameraController->setCamera(
+                    Camera{camera.eye(), position, camera.up()});
+              }
+            }
+          }
+        } else {
+          ImGui::Text("picked: none (left click with Ctrl to pick)");
+        }
+      }
+      if (profiler && ImGui::CollapsingHeader(
+                          "Profiling", ImGuiTreeNodeFlags_DefaultOpen)) {
+        // GPU results come a few frames late, see FrameProfiler
+        auto gpuTime = 0.f;
+        for (size_t i = 0; i < profiler->passes().size(); ++i) {
+          const auto &pass = profiler->passes()[i];
+          const auto averageTime = profiler->getAverageTime(i);
+          if (pass.isGpu) {
+            gpuTime += averageTime;
+          }
+          char overlay[32];
+          std::snprintf(overlay, sizeof(overlay), "%.3f ms", averageTime);
+          ImGui::PlotLines(pass.name.c_str(), pass.history.data(),
+              int(pass.history.size()), int(profiler->historyOffset()),
+              overlay, 0.f, std::numeric_limits<float>::max(), ImVec2(0, 40));
+          if (!pass.isGpu || !profiler->hasPipelineStatistics()) {
+            continue;
+          }
+          // Fragments per pixel of the scene image, or of the window
+          const auto pixelCount =
+              i == sceneGpuPass
+                  ? double(sceneImageWidth) * double(sceneImageHeight)
+                  : double(m_nWindowWidth) * double(m_nWindowHeight);
+          const auto &counts = pass.statistics;
+          ImGui::Text("  vertices: %.0f submitted, %.0f shaded",
+              double(counts[FrameProfiler::VerticesSubmitted]),
+              double(counts[FrameProfiler::VertexShaderInvocations]));
+          ImGui::Text("  primitives: %.0f submitted, %.0f clipped to %.0f",
+              double(counts[FrameProfiler::PrimitivesSubmitted]),
+              double(counts[FrameProfiler::ClippingInputPrimitives]),
+              double(counts[FrameProfiler::ClippingOutputPrimitives]));
+          const auto fragmentCount =
+              double(counts[FrameProfiler::FragmentShaderInvocations]);
+          ImGui::Text("  fragments: %.0f shaded, %.2f per pixel",
+              fragmentCount, fragmentCount / std::max(pixelCount, 1.));
+        }
+        const auto cpuTime = profiler->getAverageTime(frameCpuScope);
+        ImGui::Text("%s bound: %.3f ms GPU, %.3f ms CPU",
+            gpuTime > cpuTime ? "GPU" : "CPU", gpuTime, cpuTime);
+      }
+      if (frameTiming && ImGui::CollapsingHeader("Frame timing",
+                             ImGuiTreeNodeFlags_DefaultOpen)) {
+        // Intervals between swaps, the last bucket counting the longer ones
+        const auto &histogram = frameTiming->histogram();
+        const std::vector<float> counts(begin(histogram), end(histogram));
+        char overlay[32];
+        std::snprintf(overlay, sizeof(overlay), "0 to %.0f ms",
+            double(counts.size()) * FrameTiming::BUCKET_MILLISECONDS);
+        ImGui::PlotHistogram("intervals", counts.data(), int(counts.size()),
+            0, overlay, 0.f, std::numeric_limits<float>::max(),
+            ImVec2(0, 60));
+        ImGui::Text("median %.1f ms (recent %.1f ms), 99th percentile "
+                    "%.1f ms, maximum %.1f ms",
+            frameTiming->getPercentile(0.5),
+            frameTiming->getRecentPercentile(0.5),
+            frameTiming->getPercentile(0.99), frameTiming->maxInterval());
+        ImGui::Text("hitches: %zu of %zu frames", frameTiming->hitchCount(),
+            frameTiming->frameCount());
+        if (const auto *hitch = frameTiming->lastHitch()) {
+          ImGui::Text("last: frame %zu, %.1f ms, during %s", hitch->index,
+              1000. * hitch->interval,
+              FrameTiming::getWorkNames(hitch->work).c_str());
+        }
+        const auto &workCounts = frameTiming->hitchWorkCounts();
+        for (size_t i = 0; i < workCounts.size(); ++i) {
+          if (workCounts[i]) {
+            ImGui::BulletText("%s: %zu",
+                FrameTiming::getWorkNames(1u << i).c_str(), workCounts[i]);
+          }
+        }
+      }
+      if (m_options.collectGLMessages &&
+          ImGui::CollapsingHeader("GL messages")) {
+        const auto messages = getCollectedGLMessages();
+        if (messages.empty()) {
+          ImGui::Text("none reported");
+        }
+        for (size_t i = 0; i < messages.size(); ++i) {
+          const auto &stats = messages[i];
+          if (ImGui::TreeNode(reinterpret_cast<void *>(i), "%zu x %s %s %u",
+                  stats.count, stats.source, stats.type, stats.id)) {
+            ImGui::TextWrapped("%s", stats.message.c_str());
+            for (const auto &zoneCount : stats.zoneCounts) {
+              ImGui::BulletText("%s: %zu",
+                  zoneCount.first.empty() ? "(no zone)"
+                                          : zoneCount.first.c_str(),
+                  zoneCount.second);
+            }
+            ImGui::TreePop();
+          }
+        }
+      }
       ImGui::End();
+      imguiEndFrame();
     }
 
-    imguiRenderFrame();
-    
+    if (m_isGuiVisible) {
+      if (profiler) {
+        profiler->beginGpuPass(guiGpuPass);
+      }
+      imguiDrawFrame();
+      if (profiler) {
+        profiler->endGpuPass(guiGpuPass);
+      }
+    }
+    guiZone.end();
+    if (frameTiming) {
+      frameTiming->endSubmit(glfwGetTime());
+    }
 
-    glfwPollEvents(); // Poll for and process events
 
-    auto ellapsedTime = glfwGetTime() - seconds;
-    auto guiHasFocus =
-        ImGui::GetIO().WantCaptureMouse || ImGui::GetIO().WantCaptureKeyboard;
-    if (!guiHasFocus) {
-      cameraController->update(float(ellapsedTime));
+    // Input of the next frame, with --low-latency polled right before it
+    // draws the scene instead
+    if (!m_options.lowLatency) {
+      glfwPollEvents(); // Poll for and process events
+      const auto polledSeconds = glfwGetTime();
+      handleInput(polledSeconds - seconds);
+      if (frameTiming) {
+        frameTiming->markInput(polledSeconds);
+      }
     }
 
-    m_GLFWHandle.swapBuffers(); // Swap front and back buffers
-    
+    endDrawStats();
+    frameTimer.stop(); // Swapping waits for vertical sync
+    const TraceZone swapZone("swapBuffers");
+    m_GLFWHandle->swapBuffers(); // Swap front and back buffers
+    if (frameTiming) {
+      frameTiming->endFrame(glfwGetTime());
+    }
+    if (m_options.lowLatency) {
+      swappedFrameFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    if (frameCountToDraw > 0) {
+      --frameCountToDraw;
+    }
+
+    // The scene of a dropped model replaces this one once loaded. The loader
+    // thread loads it and creates its buffers and textures while this one is
+    // still drawn.
+    if (!m_droppedFile.empty() && loadingFile.empty()) {
+      loadingFile = m_droppedFile;
+      m_droppedFile.clear();
+      if (loaderThread) {
+        loaderThread->add([&]() -> GLLoaderThread::Publish {
+          const GpuMemoryTracker::Scope memoryScope(&m_gpuMemory);
+          const auto scene = loadDroppedScene(false);
+          const auto uploaded = std::make_shared<UploadedScene>();
+          if (scene) {
+            TextureUploader uploader{pixelBufferCount};
+            uploaded->imageTextures =
+                createTextureObjects(scene->model, uploader);
+            uploaded->bufferObjects = createBufferObjects(
+                scene->model, scene->bufferBytes, uploaded->bufferViewRanges);
+          }
+          return [&, scene, uploaded]() {
+            if (scene) {
+              m_nextScene = scene;
+              m_gltfFilePath = loadingFile;
+              m_uploadedScene =
+                  std::make_unique<UploadedScene>(std::move(*uploaded));
+            }
+            loadingFile.clear();
+          };
+        });
+      } else {
+        m_nextScene = loadDroppedScene(decodeImagesInBackground());
+        if (m_nextScene) {
+          m_gltfFilePath = loadingFile;
+        }
+        loadingFile.clear();
+      }
+    }
+  }
+
+  if (swappedFrameFence) {
+    glDeleteSync(swappedFrameFence);
+  }
+  if (frameTiming) {
+    frameTiming->flush();
+    writeFrameTimingSummary(std::clog, *frameTiming);
+  }
+  JobSystem::global().wait(framePacketJob);
+  // Downsampling jobs read the images of the model
+  for (const auto &streamed : streamedLevels) {
+    JobSystem::global().wait(streamed.job);
   }
-  // TODO clean up allocated GL data
 
+  // GL objects of the scene are deleted with their owners, and its ranges of
+  // m_bufferHeap freed for the next scene. Unless the loader thread already
+  // created them, the next scene reuses its textures from the pool, their
+  // handles made non-resident for the next scene to make them resident
+  // again. Texture arrays are not pooled.
+  // Jobs still queued on the loader thread are dropped with it.
+  m_userCamera = cameraController->getCamera();
+  // Another scene of the model keeps the buffers and textures, unless some
+  // were still to be created or were copied in texture arrays
+  if (m_nextScene == m_scene && !m_uploadedScene && !textureArrays &&
+      !lazyTextures && !lazyGeometry && !progressiveTextures.isDecoding() &&
+      !textureStreamer && !progressiveTextures.queuedUploads()) {
+    for (const auto &handle : residentHandles) {
+      bindless.makeTextureHandleNonResident(handle.second);
+    }
+    residentHandles.clear();
+    m_uploadedScene = std::make_unique<UploadedScene>();
+    m_uploadedScene->imageTextures = std::move(imageTextures);
+    m_uploadedScene->bufferObjects = std::move(bufferObjects);
+    m_uploadedScene->bufferViewRanges = std::move(bufferViewRanges);
+  } else if (m_nextScene && !m_uploadedScene) {
+    const TraceZone poolZone("releaseSceneResources");
+    for (const auto &handle : residentHandles) {
+      bindless.makeTextureHandleNonResident(handle.second);
+    }
+    residentHandles.clear();
+    if (!m_options.textureArrays) {
+      m_resourcePool.releaseTextures(std::move(imageTextures));
+    }
+  }
   return 0;
+#endif
 }
 
 ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     uint32_t height, const fs::path &gltfFile,
     const std::vector<float> &lookatArgs, const std::string &vertexShader,
-    const std::string &fragmentShader, const fs::path &output) :
+    const std::string &fragmentShader, const fs::path &output,
+    const ViewerOptions &options) :
     m_nWindowWidth(width),
     m_nWindowHeight(height),
     m_AppPath{appPath},
@@ -456,7 +6435,8 @@ ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     m_ImGuiIniFilename{m_AppName + ".imgui.ini"},
     m_ShadersRootPath{m_AppPath.parent_path() / "shaders"},
     m_gltfFilePath{gltfFile},
-    m_OutputPath{output}
+    m_OutputPath{output},
+    m_options{options}
 {
   if (!lookatArgs.empty()) {
     m_hasUserCamera = true;
@@ -474,75 +6454,487 @@ ViewerApplication::ViewerApplication(const fs::path &appPath, uint32_t width,
     m_fragmentShader = fragmentShader;
   }
 
-  ImGui::GetIO().IniFilename =
-      m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
-                                  // positions in this file
+#ifndef GLTF_VIEWER_HEADLESS
+  if (m_GLFWHandle) {
+    ImGui::GetIO().IniFilename =
+        m_ImGuiIniFilename.c_str(); // At exit, ImGUI will store its windows
+                                    // positions in this file
 
-  glfwSetKeyCallback(m_GLFWHandle.window(), keyCallback);
+    glfwSetKeyCallback(m_GLFWHandle->window(),
+        [](GLFWwindow *window, int key, int scancode, int action, int mods) {
+          keyCallback(window, key, scancode, action, mods);
+          if (key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+            auto *application = static_cast<ViewerApplication *>(
+                glfwGetWindowUserPointer(window));
+            application->m_isGuiVisible = !application->m_isGuiVisible;
+          }
+        });
+    if (m_options.vsync) {
+      // Adaptive if supported: late frames are swapped without waiting for
+      // the next vertical blank
+      glfwSwapInterval(glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+                               glfwExtensionSupported("WGL_EXT_swap_control_tear")
+                           ? -1
+                           : 1);
+    }
+    // The last model dropped on the window is drawn next
+    glfwSetWindowUserPointer(m_GLFWHandle->window(), this);
+    glfwSetDropCallback(m_GLFWHandle->window(),
+        [](GLFWwindow *window, int pathCount, const char **paths) {
+          if (pathCount > 0) {
+            static_cast<ViewerApplication *>(glfwGetWindowUserPointer(window))
+                ->m_droppedFile = paths[pathCount - 1];
+          }
+        });
+  }
+#endif
 
   printGLVersion();
+  if (m_options.collectGLMessages) {
+    startCollectingGLMessages();
+  }
+  m_parallelShaderCompile =
+      (m_options.parallelStartup || m_options.asyncVariants) &&
+      enableParallelShaderCompile();
+  if (m_parallelShaderCompile) {
+    std::clog << "Compiling shaders on driver threads" << std::endl;
+  }
+  if (m_options.gpuJpegDecoding && !m_gpuJpegDecoder) {
+    std::cerr << "Warning : no CUDA device or the viewer is built without "
+                 "nvJPEG (GLTF_VIEWER_USE_NVJPEG), JPEG images are decoded "
+                 "on the CPU"
+              << std::endl;
+  }
+#ifndef GLTF_VIEWER_HEADLESS
+  if (m_options.streamPort && m_GLFWHandle && m_OutputPath.empty()) {
+    // At the size of the window when started, later sizes are scaled to it
+    auto writer = createStreamWriter(m_options.streamPort, m_nWindowWidth,
+        m_nWindowHeight, STREAM_FRAME_RATE, m_options.streamEncoder);
+    if (writer) {
+      m_frameStreamer = std::make_unique<FrameStreamer>(
+          std::move(writer), m_nWindowWidth, m_nWindowHeight);
+      std::clog << "Streaming on port " << m_options.streamPort << std::endl;
+    } else {
+      std::cerr << "Warning : no stream, ffmpeg could not be started"
+                << std::endl;
+    }
+    try {
+      m_remoteInput =
+          std::make_unique<RemoteInput>(uint16_t(m_options.streamPort + 1));
+    } catch (const std::exception &e) {
+      std::cerr << "Warning : " << e.what() << std::endl;
+    }
+  }
+#endif
 }
 
-bool ViewerApplication::loadGltfFile(tinygltf::Model &model)
+std::shared_ptr<LoadedScene> ViewerApplication::loadScene(
+    const fs::path &gltfFile, const ViewerOptions &options,
+    bool decodeImagesInBackground)
 {
+    const TraceZone zone("loadScene");
+    auto scene = std::make_shared<LoadedScene>();
+    auto &model = scene->model;
+    const auto phases = options.profileLoading ? &scene->loadPhases : nullptr;
+    // Remote files are neither cached nor mapped, only their bytes in use
+    // are fetched
+    const auto isRemote = isRemoteUrl(gltfFile.string());
+    if (!isRemote && isTilesetFile(gltfFile)) {
+      // Only the hierarchy, runScene pages the contents of tiles in
+      try {
+        const TraceZone tilesetZone("loadTileset");
+        const LoadPhaseTimer tilesetPhase(phases, "loadTileset");
+        const auto tileset =
+            std::make_shared<const Tileset>(loadTileset(gltfFile));
+        scene->bboxMin = tileset->tiles.front().bounds.min;
+        scene->bboxMax = tileset->tiles.front().bounds.max;
+        scene->tileset = tileset;
+        model.defaultScene = -1; // Not initialized by tinygltf
+      } catch (const std::runtime_error &e) {
+        std::cerr << "Error : " << e.what() << std::endl;
+        return nullptr;
+      }
+      return scene;
+    }
+    if (options.sceneCache && !isRemote) {
+      LoadPhaseTimer cachePhase(phases, "loadSceneCache");
+      MappedFile cacheFile;
+      if (loadSceneCache(gltfFile, model, cacheFile, scene->bufferBytes,
+              scene->bboxMin, scene->bboxMax, options.optimizeMeshes,
+              options.mergeStaticGeometry, options.deduplicate,
+              options.cpuMipmaps, options.compressTextures,
+              TextureSizeLimits{
+                  options.maxTextureSize, options.maxDataTextureSize})) {
+        scene->mappedFiles.emplace_back(std::move(cacheFile));
+        return scene;
+      }
+      // A miss, only its time to find it out
+      cachePhase.end();
+    }
+
     tinygltf::TinyGLTF loader;
     std::string err;
     std::string warn;
 
-    bool result = loader.LoadASCIIFromFile(&model, &err, &warn, m_gltfFilePath.string());
+    if (options.parallelImageDecoding || options.gpuJpegDecoding ||
+        decodeImagesInBackground) {
+      loader.SetImageLoader(storeEncodedImage, nullptr);
+    } else {
+      loader.SetImageLoader(loadImageData, nullptr);
+    }
+
+    RemoteGltf remoteGltf;
+    auto fsCallbacks = getDefaultFsCallbacks();
+    if (isRemote) {
+      const TraceZone fetchZone("fetchRemoteGltf");
+      const LoadPhaseTimer fetchPhase(phases, "fetchRemoteGltf");
+      std::string fetchErr;
+      if (!fetchRemoteGltf(gltfFile.string(), decodeImagesInBackground,
+              remoteGltf, fetchErr)) {
+        std::cerr << "Error : " << fetchErr << std::endl;
+        return nullptr;
+      }
+      // External buffers and images are served from the fetched bytes
+      fsCallbacks = remoteGltf.getFsCallbacks();
+      loader.SetFsCallbacks(fsCallbacks);
+      scene->remoteImages = std::move(remoteGltf.deferredImages);
+    }
+
+    const auto isBinary =
+        isRemote ? remoteGltf.isBinary : isBinaryGltfFile(gltfFile);
+    const auto baseDir = gltfFile.parent_path();
+
+    TraceZone parseZone("parseGltf");
+    // Images are decoded while parsing, unless in parallel or the background
+    LoadPhaseTimer parsePhase(phases, "parseGltf");
+    bool result = false;
+    if (isRemote) {
+      const auto &document = remoteGltf.document;
+      result = loadGltfDocument(loader, model, err, warn, document.data(),
+          document.size(), isBinary, "", options.fastJson, fsCallbacks);
+    } else if (options.mapBuffers && isBinary) {
+      // Parse from the mapping: the file is never read into a heap buffer
+      scene->mappedFiles.emplace_back(gltfFile);
+      const auto &glbFile = scene->mappedFiles.back();
+      result = loadGltfDocument(loader, model, err, warn, glbFile.data(),
+          glbFile.size(), true, baseDir.string(), options.fastJson,
+          fsCallbacks);
+    } else {
+      // Parsed from a mapping: with --fast-json, the copy without the arrays
+      // read by parseGltfJsonArrays is the only one on the heap. .glb
+      // containers go to the binary loader, whatever their extension: it
+      // reads the BIN chunk directly instead of base64-decoding buffers.
+      try {
+        const MappedFile file(gltfFile);
+        result = loadGltfDocument(loader, model, err, warn, file.data(),
+            file.size(), isBinary, baseDir.string(), options.fastJson,
+            fsCallbacks);
+      } catch (const std::runtime_error &e) {
+        err = e.what();
+      }
+    }
 
     if(!warn.empty()){
       std::cerr << "Warning : " << warn << std::endl;
     }
 
     if(!err.empty()){
-      std::cerr << "Error : " << warn << std::endl;
+      std::cerr << "Error : " << err << std::endl;
     }
 
     if(!result){
       std::cerr << "could not complete glTF file parsing" << std::endl;
+      return nullptr;
+    }
+
+    parseZone.end();
+    parsePhase.end();
+    if ((options.parallelImageDecoding || options.gpuJpegDecoding) &&
+        !decodeImagesInBackground) {
+      const TraceZone decodeZone("decodeImages");
+      const LoadPhaseTimer decodePhase(phases, "decodeImages");
+      std::string decodingErr;
+      // Those left encoded are decoded by createTextureObject
+      if (!decodeImages(model, decodingErr, options.gpuJpegDecoding)) {
+        std::cerr << "Error : " << decodingErr << std::endl;
+        return nullptr;
+      }
+    }
+
+    const TextureSizeLimits textureSizeLimits{
+        options.maxTextureSize, options.maxDataTextureSize};
+    if (textureSizeLimits.maxSize || textureSizeLimits.maxDataSize) {
+      // Of the images already decoded, before their chains are generated
+      const TraceZone limitZone("limitImageSizes");
+      const LoadPhaseTimer limitPhase(phases, "limitImageSizes");
+      const auto downscaledCount = limitImageSizes(model, textureSizeLimits);
+      if (downscaledCount) {
+        std::clog << "Downscaled " << downscaledCount << " images"
+                  << std::endl;
+      }
+    }
+
+    if (options.cpuMipmaps) {
+      // Of the images already decoded
+      const TraceZone mipZone("generateMipChains");
+      const LoadPhaseTimer mipPhase(phases, "generateMipChains");
+      generateMipChains(model);
+    }
+
+    if (options.compressTextures) {
+      // Of the images already decoded, with the chains generated above
+      const TraceZone compressZone("compressTextures");
+      const LoadPhaseTimer compressPhase(phases, "compressTextures");
+      const auto compressedCount = compressTextures(model);
+      if (compressedCount) {
+        std::clog << "Compressed " << compressedCount << " textures"
+                  << std::endl;
+      }
+    }
+
+    scene->bufferBytes = getBufferBytes(model);
+    if (options.mapBuffers && !isRemote) {
+      // tinygltf always copies buffers in model.buffers[i].data. Point to the
+      // mapped bytes instead and release that copy right away, so only one
+      // version of the geometry is resident at any time
+      for (size_t i = 0; i < model.buffers.size(); ++i) {
+        auto &buffer = model.buffers[i];
+        BufferBytes mappedBytes;
+        if (buffer.uri.empty() && isBinary) {
+          getGlbBinChunk(scene->mappedFiles.front().data(),
+              scene->mappedFiles.front().size(), mappedBytes);
+        } else if (!buffer.uri.empty() &&
+                   buffer.uri.compare(0, 5, "data:") != 0) {
+          try {
+            scene->mappedFiles.emplace_back(baseDir / buffer.uri);
+            mappedBytes.data = scene->mappedFiles.back().data();
+            mappedBytes.size = scene->mappedFiles.back().size();
+          } catch (const std::runtime_error &e) {
+            std::cerr << "Warning : " << e.what() << std::endl;
+          }
+        }
+        if (mappedBytes.size < buffer.data.size()) {
+          continue; // Keep the copy made by tinygltf
+        }
+        scene->bufferBytes[i] = {mappedBytes.data, buffer.data.size()};
+        std::vector<unsigned char>().swap(buffer.data);
+      }
+    }
+
+    {
+      // Before any pass reading the geometry, stored by the scene cache
+      const TraceZone meshoptZone("decodeMeshoptBuffers");
+      const LoadPhaseTimer meshoptPhase(phases, "decodeMeshoptBuffers");
+      std::string meshoptErr;
+      if (!decodeMeshoptBuffers(model, scene->bufferBytes, meshoptErr)) {
+        std::cerr << "Error : " << meshoptErr << std::endl;
+        return nullptr;
+      }
+    }
+    {
+      const TraceZone dracoZone("decodeDracoPrimitives");
+      const LoadPhaseTimer dracoPhase(phases, "decodeDracoPrimitives");
+      std::string dracoErr;
+      if (!decodeDracoPrimitives(model, scene->bufferBytes, dracoErr)) {
+        std::cerr << "Error : " << dracoErr << std::endl;
+        return nullptr;
+      }
+    }
+
+    {
+      // Before any pass reading attributes or indices as dense accessors
+      const TraceZone sparseZone("densifySparseAttributes");
+      const LoadPhaseTimer sparsePhase(phases, "densifySparseAttributes");
+      densifySparseAttributes(model, scene->bufferBytes);
+    }
+    {
+      // Before the passes merging and optimizing lists
+      const TraceZone topologyZone("normalizeTopologies");
+      const LoadPhaseTimer topologyPhase(phases, "normalizeTopologies");
+      const auto convertedCount =
+          normalizeTopologies(model, scene->bufferBytes);
+      if (convertedCount) {
+        std::clog << "Converted " << convertedCount
+                  << " strip and fan primitives to lists" << std::endl;
+      }
+    }
+    promoteByteIndices(model, scene->bufferBytes);
+    if (options.deduplicate) {
+      // Before mergeStaticGeometry, which then merges more primitives per
+      // material
+      const TraceZone deduplicateZone("deduplicateModel");
+      const LoadPhaseTimer deduplicatePhase(phases, "deduplicateModel");
+      const auto stats = deduplicateModel(model, scene->bufferBytes);
+      std::clog << "Collapsed duplicates: " << stats.images << " images, "
+                << stats.samplers << " samplers, " << stats.textures
+                << " textures, " << stats.materials << " materials, "
+                << stats.accessors << " accessors, " << stats.meshes
+                << " meshes" << std::endl;
+    }
+    if (options.mergeStaticGeometry) {
+      // Before optimizeMeshes, which then optimizes the merged chunks
+      const TraceZone mergeZone("mergeStaticGeometry");
+      const LoadPhaseTimer mergePhase(phases, "mergeStaticGeometry");
+      const auto stats = mergeStaticGeometry(model, scene->bufferBytes);
+      std::clog << "Merged " << stats.mergedPrimitives
+                << " static primitives in " << stats.chunks << " chunks"
+                << std::endl;
+    }
+    if (options.optimizeMeshes) {
+      const LoadPhaseTimer optimizePhase(phases, "optimizeMeshes");
+      optimizeMeshes(model, scene->bufferBytes);
+    }
+    {
+      // Stored by the scene cache, later runs do not generate them again
+      const TraceZone tangentsZone("generateTangents");
+      const LoadPhaseTimer tangentsPhase(phases, "generateTangents");
+      generateTangents(model, scene->bufferBytes);
+    }
+    {
+      // Also stored by the scene cache, after the transforms of the meshes
+      const TraceZone indexRangesZone("computeIndexRanges");
+      const LoadPhaseTimer indexRangesPhase(phases, "computeIndexRanges");
+      const auto invalidCount = computeIndexRanges(model, scene->bufferBytes);
+      if (invalidCount) {
+        std::cerr << "Warning : " << invalidCount
+                  << " primitives have indices out of their vertices"
+                  << std::endl;
+      }
+    }
+
+    // With --gpu-bounds, by runScene from the bounds of the draws, unless
+    // stored in the scene cache
+    if (!options.gpuBounds || (options.sceneCache && !isRemote)) {
+      const TraceZone boundsZone("computeSceneBounds");
+      const LoadPhaseTimer boundsPhase(phases, "computeSceneBounds");
+      computeSceneBounds(
+          model, scene->bufferBytes, scene->bboxMin, scene->bboxMax);
+    } else {
+      scene->bboxMin = BoundingBox().min;
+      scene->bboxMax = BoundingBox().max;
     }
 
-    return result;
+    if (options.sceneCache && !isRemote) {
+      std::string cacheErr;
+      if (!writeSceneCache(gltfFile, model, scene->bufferBytes,
+              scene->bboxMin, scene->bboxMax, options.optimizeMeshes,
+              options.mergeStaticGeometry, options.deduplicate,
+              options.cpuMipmaps, options.compressTextures,
+              textureSizeLimits, cacheErr)) {
+        std::cerr << "Warning : scene cache not written: " << cacheErr
+                  << std::endl;
+      }
+    }
+
+    return scene;
 }
 
-std::vector<GLuint> ViewerApplication::createBufferObjects(const tinygltf::Model &model)
+GLBufferRanges ViewerApplication::createBufferObjects(
+  const tinygltf::Model &model, const std::vector<BufferBytes> &bufferBytes,
+  std::vector<BufferViewRange> &bufferViewRanges, bool uploadBufferViews) const
 {
-  //Initialize & generate the identifiers
-  std::vector<GLuint> bufferObjects(model.buffers.size(),0);
-  glGenBuffers(GLsizei(bufferObjects.size()), bufferObjects.data());
+  const TraceZone zone("createBufferObjects");
+  //Only the bufferViews read by primitive attributes and indices are uploaded:
+  //images, animations and unused accessors stay on the CPU side
+  std::vector<bool> isBufferViewReferenced(model.bufferViews.size(), false);
+  const auto referenceAccessor = [&](int accessorIdx) {
+    const auto bufferViewIdx = model.accessors[accessorIdx].bufferView;
+    if (bufferViewIdx >= 0) {
+      isBufferViewReferenced[bufferViewIdx] = true;
+    }
+  };
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      for (const auto &attribute : primitive.attributes) {
+        referenceAccessor(attribute.second);
+      }
+      if (primitive.indices >= 0) {
+        referenceAccessor(primitive.indices);
+      }
+    }
+  }
+
+  //Keep the bufferViews of the model together in as few heaps as possible,
+  //without creating huge allocations
+  const GLsizeiptr maxReservedSize = 256 * 1024 * 1024;
+  const GLsizeiptr bufferViewAlignment = 16;
+  GLsizeiptr totalSize = 0;
+  for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+    if (isBufferViewReferenced[i]) {
+      totalSize += (GLsizeiptr(model.bufferViews[i].byteLength) +
+                       bufferViewAlignment - 1) /
+                   bufferViewAlignment * bufferViewAlignment;
+    }
+  }
+  if (totalSize > 0) {
+    m_bufferHeap->reserve(std::min(totalSize, maxReservedSize));
+  }
 
-  //Bind buffer data to identifiers data
-  for(size_t i = 0; i < model.buffers.size(); ++i){
-    glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[i]);
-    glBufferStorage(GL_ARRAY_BUFFER, model.buffers[i].data.size(), model.buffers[i].data.data(),0);
+  bufferViewRanges.assign(model.bufferViews.size(), BufferViewRange{});
+  std::vector<GLBufferRange> heapRanges;
+  for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+    if (!isBufferViewReferenced[i]) {
+      continue;
+    }
+    const auto heapRange = m_bufferHeap->allocate(
+        GLsizeiptr(model.bufferViews[i].byteLength), bufferViewAlignment);
+    heapRanges.push_back(heapRange);
+    auto &range = bufferViewRanges[i];
+    range.bufferObject = heapRange.buffer;
+    range.byteOffset = heapRange.byteOffset;
+    //Zeroed indices and vertices draw nothing until their bufferViews are
+    //uploaded
+    if (uploadBufferViews) {
+      uploadBufferView(model, bufferBytes, range, i);
+    } else {
+      glBindBuffer(GL_ARRAY_BUFFER, heapRange.buffer);
+      glClearBufferSubData(GL_ARRAY_BUFFER, GL_R8, heapRange.byteOffset,
+          heapRange.byteSize, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    }
   }
 
   //Unbind array buffer
   glBindBuffer(GL_ARRAY_BUFFER,0);
 
-  return bufferObjects;
+  return GLBufferRanges{m_bufferHeap, std::move(heapRanges)};
 }
 
-std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
-  const tinygltf::Model &model, const std::vector<GLuint> &bufferObjects,
+void ViewerApplication::uploadBufferView(const tinygltf::Model &model,
+  const std::vector<BufferBytes> &bufferBytes, const BufferViewRange &range,
+  size_t bufferViewIdx) const
+{
+  //bufferBytes may point to a memory mapping, see --mmap
+  const auto &bufferView = model.bufferViews[bufferViewIdx];
+  glBindBuffer(GL_ARRAY_BUFFER, range.bufferObject);
+  glBufferSubData(GL_ARRAY_BUFFER, range.byteOffset,
+      GLsizeiptr(bufferView.byteLength),
+      bufferBytes[bufferView.buffer].data + bufferView.byteOffset);
+}
+
+GLVertexArrays ViewerApplication::createVertexArrayObjects(
+  const tinygltf::Model &model, const std::vector<BufferViewRange> &bufferViewRanges,
   std::vector<VaoRange> &meshToVA)
 {
-  std::vector<GLuint> vertexArrayObjects;
-  //For each range of model, keep its range of vao
+  const TraceZone zone("createVertexArrayObjects");
+  //For each range of model, keep its range of vao. All are generated at once,
+  //in one allocation.
   meshToVA.resize(model.meshes.size());
+  GLsizei vertexArrayCount = 0;
+  for (size_t i = 0; i < model.meshes.size(); ++i) {
+    meshToVA[i].begin = vertexArrayCount;
+    meshToVA[i].count = GLsizei(model.meshes[i].primitives.size());
+    vertexArrayCount += meshToVA[i].count;
+  }
+  std::vector<GLuint> vertexArrayObjects(vertexArrayCount, 0);
+  if (vertexArrayCount) {
+    glGenVertexArrays(vertexArrayCount, vertexArrayObjects.data());
+  }
 
   //Loop on all meshes
   for(size_t i = 0; i < model.meshes.size(); ++i)
   {
-    tinygltf::Mesh mesh = model.meshes[i];
-    VaoRange &vaoRange = meshToVA[i];
-
-    vaoRange.begin = static_cast<GLsizei>(vertexArrayObjects.size());
-    vaoRange.count = static_cast<GLsizei>(mesh.primitives.size());
-
-    vertexArrayObjects.resize(vertexArrayObjects.size() + model.meshes[i].primitives.size());
-    glGenVertexArrays(vaoRange.count, &vertexArrayObjects[vaoRange.begin]);
+    const auto &mesh = model.meshes[i];
+    const VaoRange &vaoRange = meshToVA[i];
 
     //Loop on the primitives of the current mesh
     for(size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx)
@@ -559,14 +6951,15 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
           const auto accessorIdx = (*iterator).second;
           const auto &accessor = model.accessors[accessorIdx];
           const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
+          const auto &bufferViewRange = bufferViewRanges[accessor.bufferView];
 
           glEnableVertexAttribArray(VERTEX_ATTRIB_POSITION_IDX);
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
+          glBindBuffer(GL_ARRAY_BUFFER, bufferViewRange.bufferObject);
 
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+          const auto byteOffset = accessor.byteOffset + bufferViewRange.byteOffset;
           glVertexAttribPointer(VERTEX_ATTRIB_POSITION_IDX, accessor.type,
-            accessor.componentType, GL_FALSE, GLsizei(bufferView.byteStride),
+            accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE,
+            GLsizei(bufferView.byteStride),
             (const GLvoid *)byteOffset);
         }
       }
@@ -577,15 +6970,16 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
           const auto accessorIdx = (*iterator).second;
           const auto &accessor = model.accessors[accessorIdx];
           const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
+          const auto &bufferViewRange = bufferViewRanges[accessor.bufferView];
 
           glEnableVertexAttribArray(VERTEX_ATTRIB_NORMAL_IDX);
-          glBindBuffer(GL_ARRAY_BUFFER, bufferObjects[bufferIdx]);
+          glBindBuffer(GL_ARRAY_BUFFER, bufferViewRange.bufferObject);
 
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+          const auto byteOffset = accessor.byteOffset + bufferViewRange.byteOffset;
           glVertexAttribPointer(VERTEX_ATTRIB_NORMAL_IDX, accessor.type,
-            accessor.componentType, GL_FALSE, GLsizei(bufferView.byteStride),
-            (const GLvoid *)(accessor.byteOffset + bufferView.byteOffset));
+            accessor.componentType, accessor.normalized ? GL_TRUE : GL_FALSE,
+            GLsizei(bufferView.byteStride),
+            (const GLvoid *)byteOffset);
         }
       }
 
@@ -594,76 +6988,180 @@ std::vector<GLuint> ViewerApplication::createVertexArrayObjects(
           const auto accessorIdx = (*iterator).second;
           const auto &accessor = model.accessors[accessorIdx];
           const auto &bufferView = model.bufferViews[accessor.bufferView];
-          const auto bufferIdx = bufferView.buffer;
-          const auto bufferObject = model.buffers[bufferIdx];
+          const auto &bufferViewRange = bufferViewRanges[accessor.bufferView];
 
           glEnableVertexAttribArray(VERTEX_ATTRIB_TEXCOORD0_IDX);
 
-          glBindBuffer(GL_ARRAY_BUFFER,bufferObjects[bufferIdx]);
+          glBindBuffer(GL_ARRAY_BUFFER, bufferViewRange.bufferObject);
           assert(GL_ARRAY_BUFFER == bufferView.target);
 
-          const auto byteOffset = accessor.byteOffset + bufferView.byteOffset;
+          const auto byteOffset = accessor.byteOffset + bufferViewRange.byteOffset;
           glVertexAttribPointer(VERTEX_ATTRIB_TEXCOORD0_IDX, accessor.type,
-              accessor.componentType, GL_FALSE, GLsizei(bufferView.byteStride),
-              (const GLvoid *)byteOffset);
+              accessor.componentType,
+              accessor.normalized ? GL_TRUE : GL_FALSE,
+              GLsizei(bufferView.byteStride), (const GLvoid *)byteOffset);
+        }
+      }
+      for (const auto &attribute :
+          {std::make_pair("JOINTS_0", VERTEX_ATTRIB_JOINTS0_IDX),
+              std::make_pair("WEIGHTS_0", VERTEX_ATTRIB_WEIGHTS0_IDX),
+              std::make_pair("TANGENT", VERTEX_ATTRIB_TANGENT_IDX)}) {
+        const auto iterator = primitive.attributes.find(attribute.first);
+        if (iterator != end(primitive.attributes)) {
+          const auto &accessor = model.accessors[iterator->second];
+          const auto &bufferView = model.bufferViews[accessor.bufferView];
+          const auto &bufferViewRange = bufferViewRanges[accessor.bufferView];
+
+          glEnableVertexAttribArray(attribute.second);
+          glBindBuffer(GL_ARRAY_BUFFER, bufferViewRange.bufferObject);
+
+          const auto byteOffset =
+              accessor.byteOffset + bufferViewRange.byteOffset;
+          glVertexAttribPointer(attribute.second, accessor.type,
+              accessor.componentType,
+              accessor.normalized ? GL_TRUE : GL_FALSE,
+              GLsizei(bufferView.byteStride), (const GLvoid *)byteOffset);
         }
       }
-      if (model.meshes[i].primitives[pIdx].indices >= 0) {
-        const auto accessorIdx = model.meshes[i].primitives[pIdx].indices;
+      if (primitive.indices >= 0) {
+        const auto accessorIdx = primitive.indices;
         const auto &accessor = model.accessors[accessorIdx];
-        const auto &bufferView = model.bufferViews[accessor.bufferView];
-        const auto bufferIdx = bufferView.buffer;
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferObjects[bufferIdx]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
+            bufferViewRanges[accessor.bufferView].bufferObject);
       }
     }
   }
-  return vertexArrayObjects;
+  return GLVertexArrays{std::move(vertexArrayObjects)};
 }
 
-std::vector<GLuint> ViewerApplication::createTextureObjects(const tinygltf::Model &model) const {
-  //Texture identifiers
-  std::vector<GLuint> textureObjects(model.textures.size(), 0);
-  glGenTextures(GLsizei(textureObjects.size()), &textureObjects[0]);
-
-  //Default sampler
-  tinygltf::Sampler defaultSampler;
-  defaultSampler.minFilter = GL_LINEAR;
-  defaultSampler.magFilter = GL_LINEAR;
-  defaultSampler.wrapS = GL_REPEAT;
-  defaultSampler.wrapT = GL_REPEAT;
-  defaultSampler.wrapR = GL_REPEAT;
-
-  //Loop each texture
-  for(size_t i = 0; i < model.textures.size(); ++i){
-    const auto &texture = model.textures[i]; //get texture
-    assert(texture.source >= 0);
-    const auto &image = model.images[texture.source]; 
-    //get matching sampler or default sampler
-    const auto &sampler = texture.sampler >= 0 ? model.samplers[texture.sampler] : defaultSampler;
-
-    //Bind texture object to target
-    glBindTexture(GL_TEXTURE_2D, textureObjects[i]);
-    //Image data Setting
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, image.pixel_type, image.image.data());
-
-    //Sampling parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR);
-    //Wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, sampler.wrapR);
-
-    if (sampler.minFilter == GL_NEAREST_MIPMAP_NEAREST ||
-        sampler.minFilter == GL_NEAREST_MIPMAP_LINEAR ||
-        sampler.minFilter == GL_LINEAR_MIPMAP_NEAREST ||
-        sampler.minFilter == GL_LINEAR_MIPMAP_LINEAR) {
-      glGenerateMipmap(GL_TEXTURE_2D);
+GLTextures ViewerApplication::createTextureObjects(
+    const tinygltf::Model &model, TextureUploader &uploader) const {
+  const TraceZone zone("createTextureObjects");
+  //Texture identifiers of images, 0 for images no texture samples, or still
+  //encoded (see --progressive), these are created later by
+  //createTextureObject
+  std::vector<GLuint> imageTextures(model.images.size(), 0);
+
+  const auto usages = getImageUsages(model);
+  std::vector<bool> createdImages(model.images.size(), false); // Or failed
+  const auto createImageTexture = [&](int imageIdx) {
+    if (imageIdx >= 0 && !createdImages[imageIdx]) {
+      createdImages[imageIdx] = true;
+      // Streamed textures start from a coarse level
+      const auto firstLevel =
+          streamTextures() ? TextureStreamer::getStartLevel(
+                                 getTextureLevelSizes(model.images[imageIdx]),
+                                 TEXTURE_STREAMING_START_SIZE)
+                           : 0;
+      imageTextures[imageIdx] = createTextureObject(model, imageIdx, uploader,
+          usages[imageIdx].generateMipmaps, usages[imageIdx].color,
+          firstLevel);
+    }
+  };
+  //KHR_texture_basisu images come first, the source of a texture is its
+  //fallback, only created if its basisu image cannot be
+  for (const auto &texture : model.textures) {
+    createImageTexture(getBasisuImageSource(texture));
+  }
+  for (const auto &texture : model.textures) {
+    const auto basisuSource = getBasisuImageSource(texture);
+    if (basisuSource < 0 || !imageTextures[basisuSource]) {
+      createImageTexture(texture.source);
     }
   }
-  glBindTexture(GL_TEXTURE_2D, 0);
-  return textureObjects;
+  return GLTextures{std::move(imageTextures)};
 }
 
+GLSamplers ViewerApplication::createSamplerObjects(
+    const tinygltf::Model &model) const
+{
+  // Sampler objects of each set of parameters
+  std::map<std::array<int, 5>, GLuint> parameterSamplers;
+  const auto getSamplerObject = [&](const tinygltf::Sampler &sampler) {
+    const std::array<int, 5> parameters = {
+        sampler.minFilter != -1 ? sampler.minFilter : GL_LINEAR,
+        sampler.magFilter != -1 ? sampler.magFilter : GL_LINEAR,
+        sampler.wrapS, sampler.wrapT, sampler.wrapR};
+    auto &samplerObject = parameterSamplers[parameters];
+    if (!samplerObject) {
+      glGenSamplers(1, &samplerObject);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_MIN_FILTER, parameters[0]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_MAG_FILTER, parameters[1]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_WRAP_S, parameters[2]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_WRAP_T, parameters[3]);
+      glSamplerParameteri(samplerObject, GL_TEXTURE_WRAP_R, parameters[4]);
+    }
+    return samplerObject;
+  };
+
+  std::vector<GLuint> samplerObjects;
+  for (const auto &sampler : model.samplers) {
+    samplerObjects.push_back(getSamplerObject(sampler));
+  }
+  samplerObjects.push_back(getSamplerObject(getDefaultSampler()));
+  return GLSamplers{std::move(samplerObjects)};
+}
 
+GLuint ViewerApplication::createTextureObject(const tinygltf::Model &model,
+    int imageIdx, TextureUploader &uploader, bool generateMipmaps,
+    bool colorImage, GLint firstLevel) const {
+  //Immutable storage with image data, and mipmaps if needed. With --srgb,
+  //colors are decoded by the texture units
+  const auto srgb = m_options.hardwareSrgb && colorImage;
+  const auto &image = model.images[imageIdx];
+  if (m_options.fitOutputDetail && !m_OutputPath.empty()) {
+    firstLevel = std::max(firstLevel,
+        TextureStreamer::getStartLevel(getTextureLevelSizes(image),
+            2 * std::max(m_nWindowWidth, m_nWindowHeight) - 1));
+  }
+  // Images decoded at load time already fit, KTX2 files and images decoded
+  // later are held to the limit of all images
+  if (m_options.maxTextureSize > 0) {
+    firstLevel = std::max(firstLevel,
+        TextureStreamer::getStartLevel(
+            getTextureLevelSizes(image), m_options.maxTextureSize));
+  }
+  GLuint textureObject = 0;
+  if (isKtx2Image(image)) {
+    std::string err;
+    textureObject =
+        uploader.createCompressedTexture(image, err, srgb, firstLevel);
+    if (!textureObject) {
+      std::cerr << "Unable to upload KTX2 image " << imageIdx << ": " << err
+                << std::endl;
+    }
+  } else if (m_options.gpuJpegDecoding && !decodeImagesInBackground() &&
+             isJpegImage(image)) {
+    // Left encoded by loadScene. From the first level, the size of the image
+    // is only known once decoded.
+    std::string err;
+    if (m_gpuJpegDecoder) {
+      textureObject = uploader.createJpegTexture(
+          image, *m_gpuJpegDecoder, err, generateMipmaps, srgb);
+    }
+    if (!textureObject) {
+      if (m_gpuJpegDecoder) {
+        std::cerr << "Warning : unable to decode image " << imageIdx
+                  << " on the GPU (" << err << "), decoding it on the CPU"
+                  << std::endl;
+      }
+      auto decodedImage = image;
+      if (decodeImage(decodedImage, imageIdx, err)) {
+        textureObject =
+            uploader.createTexture(decodedImage, generateMipmaps, srgb);
+      } else {
+        std::cerr << "Error : " << err << std::endl;
+      }
+    }
+  } else if (!image.as_is && !image.image.empty() && firstLevel > 0) {
+    textureObject = uploader.createTexture(
+        downsampleImage(image, firstLevel, colorImage), generateMipmaps,
+        srgb);
+  } else if (!image.as_is && !image.image.empty()) {
+    textureObject = uploader.createTexture(image, generateMipmaps, srgb);
+  }
+  //Sampling parameters are those of the sampler objects bound with it (see
+  //createSamplerObjects)
+  return textureObject;
+}
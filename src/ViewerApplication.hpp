@@ -1,21 +1,521 @@
 #pragma once
 
+#ifndef GLTF_VIEWER_HEADLESS
 #include "utils/GLFWHandle.hpp"
+#endif
+#include "utils/benchmark.hpp"
+#include "utils/bvh.hpp"
 #include "utils/cameras.hpp"
+#include "utils/egl_context.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/frame_streamer.hpp"
+#include "utils/buffer_heap.hpp"
+#include "utils/gl_objects.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gpu_jpeg.hpp"
+#include "utils/gpu_memory.hpp"
+#include "utils/images.hpp"
+#include "utils/load_profile.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/remote_input.hpp"
+#include "utils/remote_gltf.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/resource_pool.hpp"
+#include "utils/scene_cache.hpp"
 #include "utils/shaders.hpp"
+#include "utils/texture_uploader.hpp"
+#include "utils/tileset.hpp"
 #include <tiny_gltf.h>
 
+#include <functional>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+
+// Optional features of the viewer, set from the command line
+struct ViewerOptions
+{
+  // Memory map .glb/.bin files and upload GL buffers from the mapping
+  bool mapBuffers = false;
+  // Free buffer and image bytes of the model once uploaded to the GPU
+  bool releaseCpuData = false;
+  // Decode images on all cores after parsing instead of one by one in tinygltf
+  bool parallelImageDecoding = false;
+  // Decode JPEG images on NVIDIA GPUs straight into the pixel buffers their
+  // textures are copied from (see GpuJpegDecoder), others like
+  // parallelImageDecoding. Images decoded in the background with
+  // progressiveLoading or written to the scene cache are decoded on the CPU.
+  bool gpuJpegDecoding = false;
+  // Read nodes, accessors and meshes straight from the JSON text instead of
+  // through the JSON document of tinygltf (see loadGltfWithFastJson)
+  bool fastJson = false;
+  // Parse the glTF file on a thread while the GL context is created and the
+  // shaders not depending on the model compile, with parallel shader
+  // compilation if the driver has it
+  bool parallelStartup = false;
+  // Draw the scene while images are decoded and uploaded (viewer only)
+  bool progressiveLoading = false;
+  // Cull the draws of the next frame in a job while the current one is
+  // drawn, frames are shown with one frame of latency (viewer only)
+  bool pipelinedFrames = false;
+  // Wait for events instead of drawing frames continuously, and only draw
+  // after input, camera moves and loading progress (viewer only)
+  bool renderOnDemand = false;
+  // Draw the scene in an offscreen image copied under the GUI, and only draw
+  // it again once the camera, lights, rendering settings or textures changed
+  // (viewer only)
+  bool cacheSceneImage = false;
+  // Pick with Ctrl+click the draw under the cursor, from draw IDs written by
+  // the fragment shaders next to the colors of the scene image, instead of
+  // the nearest primitive box along the ray (viewer only, not with deferred
+  // shading or occlusion culling, see DrawIdPicker)
+  bool gpuPicking = false;
+  // GPU time in milliseconds the scene is drawn in, by scaling the resolution
+  // of its image down to a quarter and upscaling it to the window, or 0 to
+  // draw it at the window size (viewer only, not with occlusion culling, see
+  // DynamicResolution)
+  float targetFrameTime = 0.f;
+  // Once the view stops changing, average this number of frames drawn with
+  // jittered projections for antialiasing. While it changes, frames are drawn
+  // at half the window size (or the scale of targetFrameTime), with coarser
+  // levels of detail and without occlusion textures. 0 to draw every frame
+  // the same (viewer only).
+  size_t refineFrameCount = 0;
+  // Distance in scene units between the eyes of stereo views drawn side by
+  // side in the window, both in a single pass with GL_OVR_multiview2 (see
+  // StereoFramebuffer), or 0 to draw a single view. Points at
+  // stereoConvergence from the camera are drawn at the same place for both
+  // eyes (viewer only, not with hdr, deferred shading, occlusion culling,
+  // GPU picking, punctual lights, impostors, compute points, conditional
+  // rendering nor an offscreen scene image).
+  float stereoSeparation = 0.f;
+  float stereoConvergence = 2.f;
+  // Split the window in four views of the scene: from the top (top left),
+  // the front (top right) and the side (bottom left) of its bounds, and from
+  // the camera (bottom right). Moved nodes, animations and skins are updated
+  // once per frame, only culling and draws are done per view (viewer only,
+  // not with stereo, occlusion culling, TAA, conditional rendering,
+  // pipelined frames nor an offscreen scene image).
+  bool multiViewport = false;
+  // Stream the window to a thin client: frames are read back without
+  // stalling (see FrameStreamer), encoded by streamEncoder in an ffmpeg
+  // process and served as MPEG-TS over TCP on streamPort, while the input
+  // of the client is read on streamPort + 1 and moves the camera (see
+  // RemoteInput). 0 for no stream (viewer only).
+  uint16_t streamPort = 0;
+  std::string streamEncoder = "libx264";
+  // MiB of GPU memory the textures of images are streamed in, 0 to create
+  // them whole at load time. Textures start from their levels of at most
+  // TEXTURE_STREAMING_START_SIZE pixels and are created again from the finer
+  // levels visible draws sample, least recently sampled ones going back to
+  // their start level. Images keep their pixels for it (viewer only, not with
+  // progressive loading nor texture arrays, see TextureStreamer).
+  size_t textureBudget = 0;
+  // MiB of pixels transferred per frame to the textures of images decoded
+  // while the scene is drawn, 0 to create them whole when decoded. Textures
+  // of larger images are transferred over several frames, those of the
+  // largest visible draws first, and sampled once complete (viewer only,
+  // with progressive loading or lazy resources, not with the loader thread,
+  // see UploadScheduler).
+  size_t uploadBudget = 0;
+  // Create the textures of images and upload the bufferViews of primitives
+  // the first time a draw reading them passes culling, instead of at load
+  // time. Until then materials sample a white texture and primitives read
+  // zeroed buffers. Buffers are still allocated whole, and images and buffers
+  // keep their bytes (not with progressive loading, texture streaming or
+  // arrays, shared buffers nor compute skinning).
+  bool lazyResources = false;
+  // Of a 3D Tiles tileset.json (see loadTileset): MiB of CPU memory the
+  // contents of tiles are cached in, MiB of GPU memory for their buffers and
+  // textures, and the screen-space error in pixels above which tiles are
+  // refined (viewer only, see TilePager)
+  size_t tileRamBudget = 1024;
+  size_t tileVramBudget = 512;
+  float tileMaxScreenSpaceError = 16.f;
+  // MiB of GPU memory the buffers, textures and render targets the viewer
+  // allocates should fit in, a warning is written once they do not. 0 for no
+  // budget (see GpuMemoryTracker).
+  size_t gpuMemoryBudget = 0;
+  // Swap buffers on vertical sync, adaptive if the platform supports it
+  bool vsync = false;
+  // Poll the input of each frame right before its scene is drawn, once the
+  // GPU is done with the previous frame, instead of after its GUI: the
+  // camera drawn is that of the latest input and no frame waits behind
+  // another. The latency from input to the end of frames is shown in the
+  // GUI (viewer only, not with pipelinedFrames).
+  bool lowLatency = false;
+  // Times per second the viewer GUI is built while the cursor is off it and
+  // still, its last draw data being drawn again in the other frames. It is
+  // built every frame with 0.
+  double idleGuiRate = 4.;
+  // Create the textures of progressive loading, and the buffers and textures
+  // of models dropped on the window, in a GL context shared with the window
+  // on a loader thread (viewer only, see GLLoaderThread)
+  bool loaderThread = false;
+  // Reload the files of the model and the shaders once they are saved, only
+  // the textures of changed images and the nodes of a glTF file whose nodes
+  // alone moved when possible (viewer only, see FileWatcher)
+  bool watchFiles = false;
+  // Models the viewer GUI switches between, like models dropped on the window
+  // (see loadModelList)
+  std::vector<fs::path> modelList;
+  // Graph GPU and CPU times of the passes of frames in the GUI, with the
+  // pipeline statistics of GPU passes (viewer only)
+  bool profileFrames = false;
+  // Time the input, submission, GPU end and swap of frames, show the
+  // histogram of their intervals and their hitches in the GUI and write a
+  // summary once closed (viewer only, see frame_timing.hpp)
+  bool frameTiming = false;
+  // CSV file of the timing of each frame with frameTiming, none if empty
+  fs::path frameTimingPath;
+  // Time the phases of loading and their peak resident memory, read back by
+  // ViewerApplication::loadPhases (see load_profile.hpp). Nothing is shown,
+  // the window is hidden.
+  bool profileLoading = false;
+  // CSV file of the draw calls, triangles, binds and uploads of each frame or
+  // output view (see draw_stats.hpp), none if empty
+  fs::path drawStatsPath;
+  // File the camera of each frame of the viewer is written to, in the format
+  // of loadCameraList, to be played back by a benchmark. None if empty.
+  fs::path recordCameraPath;
+  // Transfer texture pixels through a ring of pixel buffer objects
+  bool pixelBufferUpload = false;
+  // Load from, or write, a binary cache next to the glTF file
+  bool sceneCache = false;
+  // Load linked programs from, or write them to, a cache of program binaries
+  // next to the executable
+  bool programCache = false;
+  // Draw materials with variants of the fragment shader compiled without the
+  // textures they do not have (not with multiDrawIndirect nor bindless
+  // textures)
+  bool materialVariants = false;
+  // Compile the variants of materialVariants on driver threads while
+  // materials are drawn by the generic program, needs parallel shader
+  // compilation (viewer only, implies materialVariants)
+  bool asyncVariants = false;
+  // Draw primitives from 16 bits positions, 10-10-10-2 normals and half float
+  // texture coordinates re-encoded at load time (not with multiDrawIndirect)
+  bool quantizeVertices = false;
+  // Draw primitives from a position only vertex stream and a stream of
+  // interleaved normals and texture coordinates (not with multiDrawIndirect)
+  bool interleaveVertices = false;
+  // Reorder indices and vertices of triangle primitives at load time for the
+  // vertex cache, overdraw and vertex fetch (stored in the scene cache)
+  bool optimizeMeshes = false;
+  // Pre-transform the primitives of static nodes to world space at load time
+  // and merge them by material in spatially compact chunks (stored in the
+  // scene cache, see mergeStaticGeometry)
+  bool mergeStaticGeometry = false;
+  // Collapse identical images, materials, mesh accessors and meshes at load
+  // time, so that each is uploaded once (stored in the scene cache, see
+  // deduplicateModel)
+  bool deduplicate = false;
+  // Generate the mip chains of images on the CPU at load time, or once in the
+  // scene cache, filtering colors in linear space, and transfer all their
+  // levels instead of calling glGenerateMipmap (not for images decoded by
+  // progressive loading)
+  bool cpuMipmaps = false;
+  // Encode the decoded images in BC7, or BC5 for normal maps and BC4 for
+  // occlusion maps, with their mip chains at load time (see
+  // compressTextures). With the scene cache, only once: later runs upload
+  // the stored blocks.
+  bool compressTextures = false;
+  // Largest side of textures, decoded images beyond it are replaced by a mip
+  // level fitting in it at load time (see limitImageSizes), other images
+  // upload from that level. 0 for no limit.
+  int maxTextureSize = 0;
+  // Same for images materials only read as data, occlusion and metallic
+  // roughness, set lower by --texture-quality. Images decoded on the GPU by
+  // gpuJpegDecoding keep their size.
+  int maxDataTextureSize = 0;
+  // Draw the depth of the scene front to back with a program reading
+  // positions only, then shade draws with an equal depth test
+  bool depthPrepass = false;
+  // Draw the primitives of many vertices only if the occlusion query of their
+  // bounding box passed in the previous frame, without waiting for its result
+  // (glBeginConditionalRender, not with multiDrawIndirect)
+  bool conditionalRender = false;
+  // Draw the distant instances of meshes used by many nodes as billboards of
+  // views of the mesh rendered at startup and cached (see Impostors, not with
+  // multiDrawIndirect nor deferredShading)
+  bool impostors = false;
+  // Draw the POINTS primitives with a compute rasterizer of their points at
+  // a level of detail of their size on screen (see PointClouds, not with
+  // multiDrawIndirect nor deferredShading), and with fillPointHoles the
+  // pixels between points with their nearest neighbours
+  bool computePoints = false;
+  bool fillPointHoles = false;
+  // Map the near plane to depth 1 and the far plane to 0 (glClipControl with
+  // a [0, 1] depth range, greater depth test), with near and far planes
+  // fitted to the scene bounds seen from each camera. Most precise with the
+  // float depth of offscreen framebuffers.
+  bool reversedZ = false;
+  // Decode base color and emissive textures from sRGB in the texture units,
+  // filtering them in linear space, and encode colors to sRGB when blending
+  // into the window (see GL_FRAMEBUFFER_SRGB). Float images are linear,
+  // output images and the other offscreen images are still encoded by the
+  // shader.
+  bool hardwareSrgb = false;
+  // Copy the textures of the same size and format in the layers of array
+  // textures at load time, so that materials sampling them bind the same
+  // textures and share their draws of multiDrawIndirect (not with bindless
+  // textures nor progressive loading)
+  bool textureArrays = false;
+  // Pack the geometry of the scene in shared buffers and submit its draws
+  // with glMultiDrawElementsIndirect
+  bool multiDrawIndirect = false;
+  // Without multiDrawIndirect, draw from the same shared buffers and vertex
+  // array with base vertex draws
+  bool sharedBuffers = false;
+  // With multiDrawIndirect, cull draws in a compute shader
+  bool gpuCulling = false;
+  // Cull draws on the CPU reusing the classes of the BVH nodes of the
+  // previous frames while the camera has not moved enough to change them
+  // (see CoherentCuller, not with gpuCulling)
+  bool coherentCulling = false;
+  // With gpuCulling, also cull draws hidden in the previous frame
+  bool occlusionCulling = false;
+  // With multiDrawIndirect, build simplified levels of detail of primitives
+  // and draw the coarsest one whose error is below a pixel
+  bool generateLods = false;
+  // With gpuCulling, split primitives in meshlets culled one by one against
+  // the frustum and their normal cone
+  bool meshletCulling = false;
+  // Skin and morph the vertices of skinned and morphed draws in a compute
+  // pre-pass each time joints move, drawn by every pass as they are (not
+  // with multiDrawIndirect nor sharedBuffers). Morph targets are only
+  // applied with it.
+  bool computeSkinning = false;
+  // Compute bounds by reductions of compute shaders over the uploaded
+  // vertices (see GpuReduction): of the primitives lacking min/max at load
+  // time, the scene box being the union of the draws, and with
+  // computeSkinning the exact boxes of skinned draws each time joints move
+  bool gpuBounds = false;
+  // Shade the scene with its KHR_lights_punctual lights too, binned in the
+  // clusters of the view frustum by a compute pass (see LightClusters)
+  bool punctualLights = false;
+  // Shadows of the directional light from cascaded shadow maps, rendered again
+  // only when the light, the scene or the covered region change (see
+  // ShadowCascades). Only the PBR shader reads them.
+  bool shadowMaps = false;
+  // Draw the scene in linear values into a half float framebuffer, then
+  // expose it from its luminance histogram and tone map it in one pass (see
+  // ToneMapping), instead of clipping colors above 1 (not with
+  // occlusionCulling nor gpuPicking)
+  bool hdr = false;
+  // With hdr, let bright and emissive surfaces glow by mixing in a blur of
+  // the scene from a pyramid of compute passes at half resolution and below
+  // (see Bloom)
+  bool bloom = false;
+  // With hdr and GL_NV_shading_rate_image, shade flat and peripheral tiles
+  // of each frame per 2x2 or 4x4 pixels, from the luminance of the previous
+  // frame (see ShadingRateImage)
+  bool variableRateShading = false;
+  // With hdr, antialias the window by blending each frame, drawn with a
+  // subpixel jitter, with the previous ones reprojected by motion vectors
+  // (see TemporalAntiAliasing). Not for output images, nor with
+  // refineFrameCount.
+  bool temporalAntiAliasing = false;
+  // Equirectangular HDR image lighting the scene, prefiltered once and cached
+  // next to the executable (see EnvironmentMap). Only the PBR shader reads
+  // it.
+  fs::path environmentPath;
+  // Name of the KHR_materials_variants variant drawn first, the materials of
+  // the primitives if empty. The viewer GUI switches variants without
+  // reloading the model.
+  std::string variant;
+  // Discard the fragments of MASK materials under their cutoff, and blend
+  // BLEND materials back to front after the other draws (not with
+  // multiDrawIndirect). Materials of KHR_materials_transmission are drawn
+  // with them, over a copy of the color of the other draws (see SceneColor).
+  bool sortedTransparency = false;
+  // Draw the material parameters of opaque draws and cutouts in a G-buffer,
+  // then shade each pixel once in a lighting pass (see GBuffer). Blended
+  // draws are drawn after it, forward. Only with the PBR shader.
+  bool deferredShading = false;
+  // Darken the pixels of the lighting pass of deferredShading by a screen
+  // space ambient occlusion, like occlusion textures, computed at half
+  // resolution from the depth and normals of the G-buffer
+  bool ambientOcclusion = false;
+  // Draw with model and view matrices relative to an origin near the camera,
+  // from the double precision translations of FlatScene, so that models
+  // whose nodes are millions of units away from their origin do not jitter.
+  // The origin follows the camera by steps of RENDER_ORIGIN_DISTANCE. Not
+  // with GPU culling, compute skinning nor tilesets.
+  bool cameraRelative = false;
+  // Trace paths through the triangles of the scene instead of drawing it,
+  // averaging this number of samples per pixel: all of them for the output
+  // images, added frame after frame while the view stays still in the
+  // window (see PathTracer). 0 to draw the scene. Not with occlusion
+  // culling, GPU picking, stereo, multiple viewports, refineFrameCount nor
+  // targetFrameTime.
+  size_t pathTraceSampleCount = 0;
+  // Frames rendered to the output path, numbered when more than one, of
+  // which those from outputFirstFrame to outputLastFrame only, so that the
+  // frames of a sequence can be shared between processes
+  size_t outputFrameCount = 1;
+  size_t outputFirstFrame = 0;
+  size_t outputLastFrame = std::numeric_limits<size_t>::max();
+  // Frame rate at which the frames, or the views of a batch, play the first
+  // animation of the model from its start, at the exact time of their index
+  // rather than that of the clock. 0 for the rest pose, or 30 for videos.
+  size_t outputFrameRate = 0;
+  // Batch of views rendered to the output directory instead, with the cameras
+  // of a file (see loadCameraList) or a turntable of turntableViewCount
+  // views around the initial camera center
+  fs::path cameraListPath;
+  size_t turntableViewCount = 0;
+  // Or a sweep of randomized views and suns around the scene bounds (see
+  // ViewSweepSpec), listed in sweep.csv in the output directory
+  fs::path sweepPath;
+  // Extension of the images of a batch, for writeImage (see image_writer.hpp)
+  std::string batchImageExtension = ".png";
+  // ffmpeg encoder of the video written instead of a batch or of frames to
+  // an output path with a video extension (see VideoWriter)
+  std::string videoEncoder = "libx264";
+  // Render one thumbnail of each model of modelList, at the window size and
+  // from its default camera, instead of the output path of the first model:
+  // into the tiles of thumbnailAtlasColumns columns of one image at the
+  // output path, top left first, or without columns into images of the
+  // output directory named after the models. The context is kept from one
+  // model to the next, which is loaded on a thread while the current one
+  // renders. Not tiled.
+  bool thumbnails = false;
+  size_t thumbnailAtlasColumns = 0;
+  // Read output frames back through pixel pack buffers and write them on a
+  // worker thread, while the next frames render
+  bool asyncReadback = false;
+  // Write the draw IDs, view space normals and depths of output images to
+  // NumPy arrays next to them, from attachments of the same pass (see
+  // AsyncImageRenderer). Not with tiles, multisampling, hdr, deferred
+  // shading nor occlusion culling.
+  bool outputAovs = false;
+  // Render output images in square tiles of outputTileSize pixels, written
+  // band by band, or 0 to only tile those larger than GL_MAX_TEXTURE_SIZE.
+  // Tiled images are not read back asynchronously nor occlusion culled.
+  size_t outputTileSize = 0;
+  // Render to the output path in a headless EGL context, without GLFW nor
+  // ImGui (see HeadlessGLContext). Always with gltf-render and
+  // gltf-viewer-core, built without them (GLTF_VIEWER_HEADLESS).
+  bool headlessContext = false;
+  // Samples per pixel of output images, resolved before they are read back
+  // (not with occlusion culling)
+  size_t outputSampleCount = 1;
+  // Fit the detail of output images to their size: textures are created from
+  // their first mip level less than twice as large as the images, the cooked
+  // levels of KTX2 images or images downsampled after decoding, and MSFT_lod
+  // levels are chosen for screen coverages relative to LOD_REFERENCE_HEIGHT
+  // pixels high screens
+  bool fitOutputDetail = false;
+  // EGL device of the headless context, -1 for the default one
+  int headlessDevice = -1;
+  // Debug context with synchronous output, or a context without the cost of
+  // validating and serializing every call for production renders
+  GLContextMode glContextMode = GLContextMode::Debug;
+  // Log the first GL message of each source, type and id only, and count
+  // them by trace zone (see startCollectingGLMessages)
+  bool collectGLMessages = false;
+};
+
+// Image rendered by ViewerApplication::run for a RenderServer
+struct OutputJob
+{
+  fs::path outputPath;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  bool hasCamera = false; // Else the default camera of the scene
+  Camera camera;
+  // If set, the RGBA8 pixels of the image are copied there, rows bottom-up,
+  // instead of being written to outputPath (see gltf_viewer.h)
+  uint8_t *pixels = nullptr;
+  // Called once the job is rendered, with false if the image was not written
+  std::function<void(bool)> done;
+};
+
+// Frames drawn by ViewerApplication::run instead of the viewer loop, without
+// the GUI: frame i has camera cameras[i % cameras.size()]. The first
+// warmupFrameCount frames are not measured.
+struct Benchmark
+{
+  std::vector<Camera> cameras;
+  size_t frameCount = 0; // Measured
+  size_t warmupFrameCount = 0;
+  // Called once the frames are drawn, with the times of the measured ones
+  std::function<void(const BenchmarkTimes &)> done;
+};
+
+// glTF model loaded on the CPU, with where to read its buffers from. Several
+// ViewerApplication can draw the same one (see setLoadedScene).
+struct LoadedScene
+{
+  tinygltf::Model model;
+  // Files mapped with --mmap, they must outlive the upload of their content
+  std::vector<MappedFile> mappedFiles;
+  // Where to read the content of each model.buffers[i] from
+  std::vector<BufferBytes> bufferBytes;
+  glm::vec3 bboxMin = glm::vec3(0);
+  glm::vec3 bboxMax = glm::vec3(0);
+  // Phases of loadScene, with ViewerOptions::profileLoading
+  std::vector<LoadPhase> loadPhases;
+  // Of a remote file decoding its images in background, where to fetch them
+  std::vector<RemoteRange> remoteImages;
+  // Of a tileset file, whose tiles are loaded while drawing, the model is then
+  // empty and the bounds are those of its root tile
+  std::shared_ptr<const Tileset> tileset;
+};
+
 class ViewerApplication
 {
 public:
   ViewerApplication(const fs::path &appPath, uint32_t width, uint32_t height,
       const fs::path &gltfFile, const std::vector<float> &lookatArgs,
       const std::string &vertexShader, const std::string &fragmentShader,
-      const fs::path &output);
+      const fs::path &output, const ViewerOptions &options = {});
 
+  // Returns when the window is closed, or once the output is rendered. The
+  // viewer draws models dropped on its window in place of the glTF file.
   int run();
 
+  // Make run() render the jobs of nextJob, instead of the output path and
+  // its options, until it returns false. The scene stays loaded in between.
+  void setOutputJobs(std::function<bool(OutputJob &)> nextJob)
+  {
+    m_nextOutputJob = std::move(nextJob);
+  }
+
+  // Make run() render only the views of the batch (camera list, turntable or
+  // sweep) whose indices nextView gives, until it returns false, so that the
+  // views of a batch can be shared between applications
+  void setBatchViews(std::function<bool(size_t &)> nextView)
+  {
+    m_nextBatchView = std::move(nextView);
+  }
+
+  // Make run() draw the frames of benchmark instead of the viewer loop, in the
+  // window or, in a headless context, in a framebuffer of the window size
+  void setBenchmark(Benchmark benchmark)
+  {
+    m_benchmark = std::move(benchmark);
+  }
+
+  // Load the glTF file as run() does with options, returns null on failure
+  static std::shared_ptr<LoadedScene> loadScene(const fs::path &gltfFile,
+      const ViewerOptions &options, bool decodeImagesInBackground = false);
+
+  // Make run() draw scene instead of loading the glTF file. It is only read
+  // if the options do not release CPU data nor load progressively, scene can
+  // then be drawn by several applications at the same time.
+  void setLoadedScene(std::shared_ptr<LoadedScene> scene)
+  {
+    m_scene = std::move(scene);
+  }
+
+  // With ViewerOptions::profileLoading, phases of the loading of the last
+  // run(), from parsing to the creation of GL objects
+  const std::vector<LoadPhase> &loadPhases() const { return m_loadPhases; }
+
 
 private:
  // A range of indices in a vector containing Vertex Array Objects
@@ -25,19 +525,188 @@ private:
     GLsizei count; // Number of elements in range
   };
 
+  // Where a bufferView has been uploaded by createBufferObjects
+  struct BufferViewRange
+  {
+    GLuint bufferObject = 0; // 0 if the bufferView is not used for drawing
+    GLintptr byteOffset = 0; // Offset of the bufferView in bufferObject
+  };
+
+  // Content of the FrameUniforms block of shaders (std140 layout)
+  struct FrameUniforms
+  {
+    glm::mat4 viewMatrix;
+    glm::mat4 projMatrix;
+    glm::vec3 lightDirection; // View space
+    float padding;
+    glm::vec3 lightIntensity;
+    GLint applyOcclusion;
+    // 0 if the draw framebuffer encodes colors to sRGB itself
+    GLint encodeOutput;
+    GLint padding2[3];
+    // Unjittered view and projection of the previous frame, for the motion
+    // vectors of --taa
+    glm::mat4 previousViewProjMatrix;
+    // Projections of the left and right eyes with --stereo
+    glm::mat4 eyeProjMatrices[2];
+  };
+  static_assert(sizeof(FrameUniforms) == 368, "Must match std140 layout");
+
+  static const GLuint FRAME_UNIFORMS_BINDING = 0;
+
+  // Content of the DrawUniforms block of shaders (std140 layout), for draws
+  // not reading the Draws table
+  struct DrawUniforms
+  {
+    glm::mat4 modelMatrix;
+    glm::mat4 normalMatrix;
+    GLint firstJoint; // In the Joints table, -1 if not skinned
+    GLint padding[3];
+    glm::mat4 previousModelMatrix; // Of the previous frame, with --taa
+  };
+
+  static const GLuint DRAW_UNIFORMS_BINDING = 1;
+
+  // Entry of the Materials table of shaders (std430 layout), the factors of a
+  // glTF material and, with bindless textures, handles of its textures (with
+  // --texture-arrays, their layers). Defaults are those of the default
+  // material.
+  struct MaterialData
+  {
+    glm::vec4 baseColorFactor = glm::vec4(1);
+    glm::vec3 emissiveFactor = glm::vec3(0);
+    float metallicFactor = 1.f;
+    float roughnessFactor = 1.f;
+    float occlusionStrength = 0.f;
+    GLuint64 baseColorTexture = 0;
+    GLuint64 metallicRoughnessTexture = 0;
+    GLuint64 emissiveTexture = 0;
+    GLuint64 occlusionTexture = 0;
+    GLuint64 normalTexture = 0;
+    float alphaCutoff = 0.5f; // Of MASK materials
+    float normalScale = 1.f;
+    // Of the texture coordinates of the textures above (KHR_texture_transform)
+    glm::mat3x2 uvTransforms[5] = {glm::mat3x2(1), glm::mat3x2(1),
+        glm::mat3x2(1), glm::mat3x2(1), glm::mat3x2(1)};
+    float transmissionFactor = 0.f; // KHR_materials_transmission
+    float padding[3] = {};
+  };
+  static_assert(sizeof(MaterialData) == 224, "Must match std430 layout");
+
+  static const GLuint MATERIALS_BINDING = 0;
+
+  // Entry of the Draws table of shaders (std430 layout), read by instanced
+  // draws and by draws of --multi-draw instead of per-draw uniforms
+  struct DrawData
+  {
+    glm::mat4 modelMatrix;
+    glm::mat4 normalMatrix;
+    GLint materialIndex; // In the Materials table
+    GLint firstJoint; // In the Joints table, -1 if not skinned
+    GLint padding[2];
+    glm::mat4 previousModelMatrix; // Of the previous frame, with --taa
+  };
+  static_assert(sizeof(DrawData) == 208, "Must match std430 layout");
+
+  static const GLuint DRAWS_BINDING = 1;
+
+  // Joint matrices of the skins of the model (see JointPalette), indexed
+  // from the firstJoint of skinned draws
+  static const GLuint JOINTS_BINDING = 6;
+
+  // Storage buffers of cull_draws.cs.glsl
+  static const GLuint CULL_BOUNDS_BINDING = 2;
+  static const GLuint CULL_ALL_COMMANDS_BINDING = 3;
+  static const GLuint CULL_VISIBLE_COMMANDS_BINDING = 4;
+  static const GLuint CULL_MESHLETS_BINDING = 5;
+  static const GLuint CULL_VISIBILITY_BINDING = 20;
+
+  // Largest side of the level streamed textures are created from at load
+  // time (see ViewerOptions::textureBudget)
+  static const GLsizei TEXTURE_STREAMING_START_SIZE = 128;
+
+  // Height of the screens the coverages of MSFT_lod levels are meant for,
+  // to which smaller output images are scaled (see
+  // ViewerOptions::fitOutputDetail)
+  static const GLsizei LOD_REFERENCE_HEIGHT = 1080;
+
+  // Frames per second --stream is encoded at, frames being sent as drawn
+  static const size_t STREAM_FRAME_RATE = 60;
+
+  // Buffers and textures of a dropped model, created by the loader thread
+  struct UploadedScene
+  {
+    GLTextures imageTextures;
+    GLBufferRanges bufferObjects;
+    std::vector<BufferViewRange> bufferViewRanges;
+  };
+
 private: 
-  //Returns true if gltf loading succeeds.
-  bool loadGltfFile(tinygltf::Model &model);
+  // Draw the scene until the window is closed or a model is dropped on it
+  int runScene();
 
-  //Create Buffer Ojects from glTF model
-  std::vector<GLuint> createBufferObjects(const tinygltf::Model &model);
+  //Allocate ranges of m_bufferHeap for the bufferViews used by primitives of
+  //glTF model, read from bufferBytes. bufferViewRanges tells where each
+  //bufferView ends up.
+  //Without uploadBufferViews they are zeroed instead, bufferViews are
+  //uploaded later by uploadBufferView.
+  GLBufferRanges createBufferObjects(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    std::vector<BufferViewRange> &bufferViewRanges,
+    bool uploadBufferViews = true) const;
+
+  //Copy a bufferView at its range in its buffer object
+  void uploadBufferView(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const BufferViewRange &range, size_t bufferViewIdx) const;
 
   //Create VAO
-  std::vector<GLuint> createVertexArrayObjects(const tinygltf::Model &model,
-    const std::vector<GLuint> &bufferObjects,
+  GLVertexArrays createVertexArrayObjects(const tinygltf::Model &model,
+    const std::vector<BufferViewRange> &bufferViewRanges,
     std::vector<VaoRange> &meshToVA);
 
-  std::vector<GLuint> createTextureObjects(const tinygltf::Model &model) const;
+  // Texture object of each image sampled by textures, shared by all the
+  // textures sampling it with their own sampler object
+  GLTextures createTextureObjects(
+      const tinygltf::Model &model, TextureUploader &uploader) const;
+
+  // One sampler object per sampler of model, then one for textures without
+  // sampler. Samplers with the same parameters share their object.
+  GLSamplers createSamplerObjects(const tinygltf::Model &model) const;
+
+  // Texture object of an image, stored in sRGB with --srgb if colorImage is
+  // true (see getImageUsages), from its mip level firstLevel
+  GLuint createTextureObject(const tinygltf::Model &model, int imageIdx,
+      TextureUploader &uploader, bool generateMipmaps, bool colorImage,
+      GLint firstLevel = 0) const;
+
+  // Progressive loading only makes sense when frames are presented
+  bool decodeImagesInBackground() const
+  {
+    return m_options.progressiveLoading && m_OutputPath.empty();
+  }
+
+  // Neither does texture streaming, output images sample the finest levels
+  // nor with a tileset, whose tiles are created whole
+  bool streamTextures() const
+  {
+    return m_options.textureBudget > 0 && m_OutputPath.empty() &&
+           !decodeImagesInBackground() && !m_options.textureArrays &&
+           !(m_scene && m_scene->tileset);
+  }
+
+  // With lazyResources, what the features enabled let be created lazily
+  bool createTexturesLazily() const
+  {
+    return m_options.lazyResources && !decodeImagesInBackground() &&
+           !streamTextures() && !m_options.textureArrays;
+  }
+
+  bool uploadGeometryLazily() const
+  {
+    return m_options.lazyResources && !m_options.multiDrawIndirect &&
+           !m_options.sharedBuffers && !m_options.computeSkinning;
+  }
 
 private:
 
@@ -57,21 +726,107 @@ private:
 
   fs::path m_OutputPath;
 
+  ViewerOptions m_options;
+
+  std::function<bool(OutputJob &)> m_nextOutputJob;
+  std::function<bool(size_t &)> m_nextBatchView;
+  Benchmark m_benchmark;
+
+  std::shared_ptr<LoadedScene> m_scene; // Loaded by run() if not set
+  std::vector<LoadPhase> m_loadPhases;
+  // GL objects allocated by run(), current on its threads
+  GpuMemoryTracker m_gpuMemory{m_options.gpuMemoryBudget << 20};
+  // Shaders compile on driver threads (see enableParallelShaderCompile)
+  bool m_parallelShaderCompile = false;
+
+  // Last model dropped on the window or opened from the GUI, empty once its
+  // loading has started
+  fs::path m_droppedFile;
+  // Toggled by F1, the GUI is neither built nor drawn once hidden
+  bool m_isGuiVisible = true;
+  // Entry of m_options.modelList drawn, its size if none
+  size_t m_modelListIdx = 0;
+  // Scene of a dropped model, drawn once runScene returns. With
+  // --loader-thread, m_uploadedScene holds its GL objects.
+  std::shared_ptr<LoadedScene> m_nextScene;
+  std::unique_ptr<UploadedScene> m_uploadedScene;
+  // Entry of m_scene->model.scenes drawn, -1 for its default scene. A scene
+  // selected from the GUI is drawn by the next runScene, from the same
+  // model and with its buffers and textures when they were created whole.
+  int m_drawnSceneIdx = -1;
+  // Scenes of m_scene->model flattened by runScene so far, copied by the
+  // next ones drawing them
+  std::map<int, FlatScene> m_flatScenes;
+  // Entry of m_options.modelList whose thumbnail is rendered, the next one
+  // loading and the pixels of their atlas, rows bottom-up (see
+  // ViewerOptions::thumbnails)
+  size_t m_thumbnailIdx = 0;
+  bool m_thumbnailsFailed = false; // To load or write, by any runScene
+  std::future<std::shared_ptr<LoadedScene>> m_nextThumbnailScene;
+  std::vector<uint8_t> m_thumbnailAtlas;
+  // With --parallel-startup, the glTF file parsed on a thread of its own
+  // while the context below is created, taken by the first runScene
+  std::future<std::shared_ptr<LoadedScene>> m_startupScene{
+      m_options.parallelStartup
+          ? std::async(std::launch::async, loadScene, m_gltfFilePath,
+                m_options, decodeImagesInBackground())
+          : std::future<std::shared_ptr<LoadedScene>>()};
+
   // Order is important here, see comment below
   const std::string m_ImGuiIniFilename;
-  // Last to be initialized, first to be destroyed:
-  GLFWHandle m_GLFWHandle{int(m_nWindowWidth), int(m_nWindowHeight),
-      "glTF Viewer",
-      m_OutputPath.empty()}; // show the window only if m_OutputPath is empty
+  // Last to be initialized, first to be destroyed. Only one of them is
+  // created, the headless context with --headless. Show the window only if
+  // m_OutputPath is empty and loading is not profiled, output images are
+  // rendered offscreen and do not need a default framebuffer of their size.
+#ifdef GLTF_VIEWER_HEADLESS
+  std::unique_ptr<HeadlessGLContext> m_headlessContext{
+      std::make_unique<HeadlessGLContext>(
+          m_options.headlessDevice, m_options.glContextMode)};
+#else
+  std::unique_ptr<HeadlessGLContext> m_headlessContext{
+      m_options.headlessContext
+          ? std::make_unique<HeadlessGLContext>(
+                m_options.headlessDevice, m_options.glContextMode)
+          : nullptr};
+  std::unique_ptr<GLFWHandle> m_GLFWHandle{
+      m_headlessContext
+          ? nullptr
+          : std::make_unique<GLFWHandle>(
+                m_OutputPath.empty() ? int(m_nWindowWidth) : 1,
+                m_OutputPath.empty() ? int(m_nWindowHeight) : 1,
+                "glTF Viewer",
+                m_OutputPath.empty() && !m_options.profileLoading,
+                m_options.hardwareSrgb, m_options.glContextMode)};
+#endif
+  // Textures of the last scene, reused by the next one. Its objects belong
+  // to the context above.
+  GLResourcePool m_resourcePool;
+  // Vertex and index buffers of all scenes and tiles, the ranges of the last
+  // scene reused by the next one. Shared by the ranges allocated, which the
+  // loader thread can hold.
+  std::shared_ptr<GLBufferHeap> m_bufferHeap =
+      std::make_shared<GLBufferHeap>();
+  // Framebuffer of the thumbnails of all models
+  std::unique_ptr<OffscreenFramebuffer> m_thumbnailFramebuffer;
+  // JPEG decoder of --gpu-jpeg, null without it or without CUDA device. Its
+  // pixel buffer belongs to the context above.
+  std::unique_ptr<GpuJpegDecoder> m_gpuJpegDecoder{
+      m_options.gpuJpegDecoding && GpuJpegDecoder::isAvailable()
+          ? std::make_unique<GpuJpegDecoder>()
+          : nullptr};
+  // Of --stream, created with the window and kept while models are dropped
+  // on it or their scenes switched, so that the client stays connected
+  std::unique_ptr<FrameStreamer> m_frameStreamer;
+  std::unique_ptr<RemoteInput> m_remoteInput;
   /*
     ! THE ORDER OF DECLARATION OF MEMBER VARIABLES IS IMPORTANT !
     - m_ImGuiIniFilename.c_str() will be used by ImGUI in ImGui::Shutdown, which
     will be called in destructor of m_GLFWHandle. So we must declare
     m_ImGuiIniFilename before m_GLFWHandle so that m_ImGuiIniFilename
     destructor is called after.
-    - m_GLFWHandle must be declared before the creation of any object managing
-    OpenGL resources (e.g. GLProgram, GLShader) because it is responsible for
-    the creation of a GLFW windows and thus a GL context which must exists
-    before most of OpenGL function calls.
+    - m_GLFWHandle (or m_headlessContext) must be declared before the
+    creation of any object managing OpenGL resources (e.g. GLProgram,
+    GLShader) because it is responsible for the creation of a GLFW windows and
+    thus a GL context which must exists before most of OpenGL function calls.
   */
 };
\ No newline at end of file
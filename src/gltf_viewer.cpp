@@ -0,0 +1,197 @@
+#include "gltf_viewer.h"
+#include "ViewerApplication.hpp"
+
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// Output path of the applications, never written: their jobs copy their
+// pixels instead
+const char *const PIXELS_OUTPUT = "pixels.png";
+
+} // namespace
+
+struct gltf_viewer
+{
+  fs::path appPath;
+  ViewerOptions options;
+  fs::path gltfFile;
+  // Loaded by gltf_viewer_load_scene, drawn by the next thread started
+  std::shared_ptr<LoadedScene> scene;
+  bool hasCamera = false; // Else the default camera of the scene
+  Camera camera;
+
+  // Runs the application drawing scene, started by the first render
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable condition;
+  OutputJob job;
+  bool hasJob = false; // job is not taken by the thread yet
+  bool jobDone = false;
+  bool jobWritten = false;
+  bool stop = false; // Return once the job in progress is done
+  bool exited = false; // The application returned or threw
+};
+
+namespace {
+
+void stopThread(gltf_viewer &viewer)
+{
+  {
+    std::lock_guard<std::mutex> lock(viewer.mutex);
+    viewer.stop = true;
+  }
+  viewer.condition.notify_all();
+  if (viewer.thread.joinable()) {
+    viewer.thread.join();
+  }
+  viewer.hasJob = false;
+  viewer.stop = false;
+  viewer.exited = false;
+}
+
+void runScene(gltf_viewer &viewer, uint32_t width, uint32_t height)
+{
+  const auto nextJob = [&](OutputJob &job) {
+    std::unique_lock<std::mutex> lock(viewer.mutex);
+    viewer.condition.wait(
+        lock, [&]() { return viewer.stop || viewer.hasJob; });
+    if (!viewer.hasJob) {
+      return false;
+    }
+    job = viewer.job;
+    viewer.hasJob = false;
+    job.done = [&](bool written) {
+      {
+        std::lock_guard<std::mutex> lock(viewer.mutex);
+        viewer.jobDone = true;
+        viewer.jobWritten = written;
+      }
+      viewer.condition.notify_all();
+    };
+    return true;
+  };
+
+  try {
+    ViewerApplication app{viewer.appPath, width, height, viewer.gltfFile, {},
+        "", "", PIXELS_OUTPUT, viewer.options};
+    app.setLoadedScene(viewer.scene);
+    app.setOutputJobs(nextJob);
+    app.run();
+  } catch (const std::exception &e) {
+    std::cerr << "Error : unable to render " << viewer.gltfFile.string()
+              << ": " << e.what() << std::endl;
+  }
+  {
+    std::lock_guard<std::mutex> lock(viewer.mutex);
+    viewer.exited = true;
+  }
+  viewer.condition.notify_all();
+}
+
+} // namespace
+
+gltf_viewer *gltf_viewer_create(const char *install_dir)
+{
+  try {
+    const fs::path installDir{install_dir ? install_dir : ""};
+    if (!fs::is_directory(installDir / "shaders")) {
+      std::cerr << "Error : no shaders directory in " << installDir.string()
+                << std::endl;
+      return nullptr;
+    }
+    auto viewer = std::make_unique<gltf_viewer>();
+    // The application finds its shaders next to its path
+    viewer->appPath = installDir / "gltf-viewer";
+    // Applications render on their threads, GLFW windows can only be created
+    // on the main thread
+    viewer->options.headlessContext = true;
+    return viewer.release();
+  } catch (const std::exception &e) {
+    std::cerr << "Error : " << e.what() << std::endl;
+    return nullptr;
+  }
+}
+
+int gltf_viewer_load_scene(gltf_viewer *viewer, const char *gltf_file)
+{
+  if (!viewer || !gltf_file) {
+    return -1;
+  }
+  try {
+    // Loaded here rather than by the application, to report failures
+    auto scene = ViewerApplication::loadScene(gltf_file, viewer->options);
+    if (!scene) {
+      std::cerr << "Error : unable to load " << gltf_file << std::endl;
+      return -1;
+    }
+    stopThread(*viewer);
+    viewer->gltfFile = gltf_file;
+    viewer->scene = std::move(scene);
+    viewer->hasCamera = false;
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << "Error : " << e.what() << std::endl;
+    return -1;
+  }
+}
+
+int gltf_viewer_set_camera(gltf_viewer *viewer, const float eye[3],
+    const float center[3], const float up[3])
+{
+  if (!viewer || !eye || !center || !up) {
+    return -1;
+  }
+  viewer->camera = Camera{glm::vec3(eye[0], eye[1], eye[2]),
+      glm::vec3(center[0], center[1], center[2]),
+      glm::vec3(up[0], up[1], up[2])};
+  viewer->hasCamera = true;
+  return 0;
+}
+
+int gltf_viewer_render(
+    gltf_viewer *viewer, uint32_t width, uint32_t height, uint8_t *pixels)
+{
+  if (!viewer || !viewer->scene || !width || !height || !pixels) {
+    return -1;
+  }
+  try {
+    if (!viewer->thread.joinable()) {
+      viewer->thread = std::thread(
+          [viewer, width, height]() { runScene(*viewer, width, height); });
+    }
+    std::unique_lock<std::mutex> lock(viewer->mutex);
+    viewer->job = OutputJob();
+    viewer->job.outputPath = PIXELS_OUTPUT;
+    viewer->job.width = width;
+    viewer->job.height = height;
+    viewer->job.hasCamera = viewer->hasCamera;
+    viewer->job.camera = viewer->camera;
+    viewer->job.pixels = pixels;
+    viewer->hasJob = true;
+    viewer->jobDone = false;
+    lock.unlock();
+    viewer->condition.notify_all();
+    lock.lock();
+    viewer->condition.wait(
+        lock, [&]() { return viewer->jobDone || viewer->exited; });
+    // The scene fails until another one is loaded
+    viewer->hasJob = false;
+    return viewer->jobDone && viewer->jobWritten ? 0 : -1;
+  } catch (const std::exception &e) {
+    std::cerr << "Error : " << e.what() << std::endl;
+    return -1;
+  }
+}
+
+void gltf_viewer_free(gltf_viewer *viewer)
+{
+  if (viewer) {
+    stopThread(*viewer);
+    delete viewer;
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef GLTF_VIEWER_H
+#define GLTF_VIEWER_H
+
+/*
+  C API of the gltf-viewer-core library, to render glTF scenes from a process
+  of its own without spawning the viewer per image.
+
+  A context draws one scene at a time, kept loaded on the GPU between
+  renders: it runs a ViewerApplication on a thread of its own with its own
+  headless EGL context (see HeadlessGLContext), as a scene of the render
+  command does. The library is built without GLFW nor ImGui
+  (GLTF_VIEWER_HEADLESS): the application only draws these output images.
+  Functions of a context must not be called concurrently, several contexts
+  can render at the same time.
+
+  It is a static library: link the libraries listed in
+  cmake/gltf-viewer-core-targets.cmake of the install directory with it, or
+  include() that file in a CMake project and link the gltf-viewer-core
+  target.
+
+    gltf_viewer *viewer = gltf_viewer_create("/opt/gltf-viewer");
+    if (viewer && gltf_viewer_load_scene(viewer, "scene.gltf") == 0) {
+      gltf_viewer_set_camera(viewer, eye, center, up);
+      gltf_viewer_render(viewer, 640, 480, pixels);
+    }
+    gltf_viewer_free(viewer);
+
+  Functions returning int return 0 on success, -1 on failure, with the
+  reason written to stderr.
+*/
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gltf_viewer gltf_viewer;
+
+/* Context rendering with the shaders of install_dir/shaders, as installed
+   next to the gltf-viewer executable. Returns NULL on failure. */
+gltf_viewer *gltf_viewer_create(const char *install_dir);
+
+/* Load a glTF file, replacing the scene drawn. Its GL objects are created by
+   the next render. */
+int gltf_viewer_load_scene(gltf_viewer *viewer, const char *gltf_file);
+
+/* Camera of the next renders, as --lookat. Until it is called after a scene
+   is loaded, renders use the default camera of the scene. */
+int gltf_viewer_set_camera(gltf_viewer *viewer, const float eye[3],
+    const float center[3], const float up[3]);
+
+/* Draw the scene loaded in a width x height image and copy its RGBA8 pixels
+   to pixels, width * height * 4 bytes, rows bottom-up. */
+int gltf_viewer_render(
+    gltf_viewer *viewer, uint32_t width, uint32_t height, uint8_t *pixels);
+
+/* Release the scene and the context, viewer can be NULL */
+void gltf_viewer_free(gltf_viewer *viewer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,12 +1,408 @@
+#include "BatchRenderer.hpp"
+#include "RenderServer.hpp"
 #include "ViewerApplication.hpp"
+#ifndef GLTF_VIEWER_HEADLESS
 #include "utils/GLFWHandle.hpp"
+#endif
+#include "utils/benchmark_comparison.hpp"
 #include "utils/filesystem.hpp"
+#include "utils/gpu_memory.hpp"
+#include "utils/image_writer.hpp"
+#include "utils/load_profile.hpp"
+#include "utils/model_stats.hpp"
+#include "utils/parallel.hpp"
+#include "utils/trace.hpp"
+#include "utils/video_writer.hpp"
+#include "utils/view_sweep.hpp"
 
 #include <args.hxx>
 
+#include <algorithm>
+#include <cstdlib>
+
 std::vector<std::string> split(
     const std::string &str, const std::string &delim);
 
+// Of the value of a --gl-context flag, debug if not given
+GLContextMode getGLContextMode(args::ValueFlag<std::string> &flag)
+{
+  if (!flag) {
+    return GLContextMode::Debug;
+  }
+  const auto &mode = args::get(flag);
+  if (mode == "debug") {
+    return GLContextMode::Debug;
+  }
+  if (mode == "release") {
+    return GLContextMode::Release;
+  }
+  if (mode == "no-error") {
+    return GLContextMode::NoError;
+  }
+  throw args::ValidationError(
+      "--gl-context must be debug, release or no-error, not " + mode);
+}
+
+// Flags of how the scene is loaded and drawn, shared by the commands that
+// draw it
+struct DrawingFlags
+{
+  explicit DrawingFlags(args::Subparser &parser) :
+      mapBuffers{parser, "mmap",
+          "Memory map .glb/.bin files and upload GL buffers directly from "
+          "the mapping",
+          {"mmap"}},
+      releaseCpuData{parser, "release-cpu-data",
+          "Free buffer and image data of the model once uploaded to the GPU",
+          {"release-cpu-data"}},
+      lazyResources{parser, "lazy-resources",
+          "Create textures and upload geometry the first time a draw reading "
+          "them passes culling",
+          {"lazy-resources"}},
+      parallelImageDecoding{parser, "parallel-decode",
+          "Decode images on all cores after parsing the glTF file",
+          {"parallel-decode"}},
+      gpuJpegDecoding{parser, "gpu-jpeg",
+          "Decode JPEG images with nvJPEG into GPU memory and copy them into "
+          "textures there, other images on all cores",
+          {"gpu-jpeg"}},
+      fastJson{parser, "fast-json",
+          "Parse the nodes, accessors and meshes of glTF files straight from "
+          "their text, without building their JSON document in memory",
+          {"fast-json"}},
+      parallelStartup{parser, "parallel-startup",
+          "Parse the glTF file on a thread while the GL context is created "
+          "and shaders compile, on driver threads when supported",
+          {"parallel-startup"}},
+      pixelBufferUpload{parser, "pbo-upload",
+          "Upload textures through pixel buffer objects so that the "
+          "transfers overlap with the copies of the next textures",
+          {"pbo-upload"}},
+      sceneCache{parser, "scene-cache",
+          "Load the model from a binary cache written next to the glTF "
+          "file by a previous run, or write it",
+          {"scene-cache"}},
+      programCache{parser, "program-cache",
+          "Load shader programs from binaries cached by a previous run "
+          "with the same shaders and driver, or write them",
+          {"program-cache"}},
+      materialVariants{parser, "material-variants",
+          "Draw each material with a variant of the fragment shader "
+          "compiled without the textures it does not have",
+          {"material-variants"}},
+      asyncVariants{parser, "async-variants",
+          "Compile the variants of --material-variants on driver threads, "
+          "materials being drawn by the generic shader until theirs link",
+          {"async-variants"}},
+      quantizeVertices{parser, "quantize-vertices",
+          "Re-encode positions, normals and texture coordinates of "
+          "primitives in 16 bytes per vertex at load time",
+          {"quantize-vertices"}},
+      interleaveVertices{parser, "interleave-vertices",
+          "Rebuild vertices of primitives at load time in a position "
+          "stream and an interleaved normal and texture coordinate stream",
+          {"interleave-vertices"}},
+      optimizeMeshes{parser, "optimize-meshes",
+          "Reorder triangles and vertices at load time for the vertex "
+          "cache, overdraw and vertex fetch",
+          {"optimize-meshes"}},
+      mergeStaticGeometry{parser, "merge-static",
+          "Merge the primitives of static nodes at load time in world space "
+          "chunks per material, drawn with a few large draws",
+          {"merge-static"}},
+      deduplicate{parser, "deduplicate",
+          "Collapse identical images, materials, accessors and meshes at "
+          "load time, instancing duplicated meshes",
+          {"deduplicate"}},
+      cpuMipmaps{parser, "cpu-mipmaps",
+          "Generate the mip chains of textures on the CPU in linear space, "
+          "at load time or once in the scene cache, and upload all levels",
+          {"cpu-mipmaps"}},
+      compressTextures{parser, "compress-textures",
+          "Encode textures in BC7, BC5 for normal maps and BC4 for occlusion "
+          "maps at load time, or once in the scene cache",
+          {"compress-textures"}},
+      maxTextureSize{parser, "size",
+          "Downscale textures larger than size pixels at load time, by "
+          "halves",
+          {"max-texture-size"}},
+      textureQuality{parser, "tier",
+          "high (default) keeps textures as they are, medium limits them "
+          "to 2048 pixels and occlusion and metallic roughness maps to "
+          "1024, low to 1024 and 512",
+          {"texture-quality"}},
+      multiDrawIndirect{parser, "multi-draw",
+          "Pack the geometry in shared buffers and draw the scene with "
+          "glMultiDrawElementsIndirect",
+          {"multi-draw"}},
+      sharedBuffers{parser, "shared-buffers",
+          "Pack the geometry in shared buffers drawn from one vertex array "
+          "with base vertex draws",
+          {"shared-buffers"}},
+      gpuCulling{parser, "gpu-culling",
+          "With --multi-draw, do frustum culling in a compute shader "
+          "writing the indirect draw commands",
+          {"gpu-culling"}},
+      coherentCulling{parser, "coherent-culling",
+          "Frustum cull draws reusing the results of previous frames for "
+          "the parts of the scene the camera moved too little to change",
+          {"coherent-culling"}},
+      occlusionCulling{parser, "occlusion-culling",
+          "With --gpu-culling, also cull draws hidden behind the depth of "
+          "the previous frame, reduced in a depth pyramid",
+          {"occlusion-culling"}},
+      generateLods{parser, "lod",
+          "With --multi-draw, simplify primitives into levels of detail "
+          "at load time and draw far away ones with fewer triangles",
+          {"lod"}},
+      meshletCulling{parser, "meshlets",
+          "With --gpu-culling, split primitives in meshlets of up to 124 "
+          "triangles and also cull them one by one, including back facing "
+          "ones",
+          {"meshlets"}},
+      depthPrepass{parser, "depth-prepass",
+          "Draw the depth of the scene front to back first, then shade "
+          "each pixel once with an equal depth test",
+          {"depth-prepass"}},
+      conditionalRender{parser, "conditional-render",
+          "Draw large primitives only if the occlusion query of their "
+          "bounding box passed in the previous frame",
+          {"conditional-render"}},
+      impostors{parser, "impostors",
+          "Draw distant instances of meshes used by many nodes as "
+          "billboards of views of the mesh rendered once and cached",
+          {"impostors"}},
+      computePoints{parser, "compute-points",
+          "Rasterize the points of POINTS primitives with compute shaders, "
+          "fewer of them the smaller they are on screen",
+          {"compute-points"}},
+      fillPointHoles{parser, "fill-point-holes",
+          "With --compute-points, fill the pixels between points with their "
+          "nearest neighbours",
+          {"fill-point-holes"}},
+      reversedZ{parser, "reversed-z",
+          "Reversed depth, 1 at the near plane and 0 at the far plane, with "
+          "near and far planes fitted to the scene at each frame",
+          {"reversed-z"}},
+      hardwareSrgb{parser, "srgb",
+          "Decode color textures from sRGB when sampling them, and encode "
+          "colors to sRGB in the window framebuffer, instead of in shaders",
+          {"srgb"}},
+      textureArrays{parser, "texture-arrays",
+          "Pack textures of the same size and format in array textures at "
+          "load time, so that materials sampling them share their draws",
+          {"texture-arrays"}},
+      computeSkinning{parser, "compute-skinning",
+          "Skin and morph vertices once in a compute pre-pass when joints "
+          "move, instead of in the vertex shader of every pass",
+          {"compute-skinning"}},
+      gpuBounds{parser, "gpu-bounds",
+          "Compute the bounds of primitives lacking min/max, and of skinned "
+          "draws with --compute-skinning, on the GPU",
+          {"gpu-bounds"}},
+      punctualLights{parser, "punctual-lights",
+          "Shade with the KHR_lights_punctual lights of the model, binned "
+          "in clusters of the view frustum by a compute pass",
+          {"punctual-lights"}},
+      shadowMaps{parser, "shadow-maps",
+          "Shadows of the directional light from cascaded shadow maps, "
+          "cached while the light and the scene do not change",
+          {"shadow-maps"}},
+      hdr{parser, "hdr",
+          "Draw the scene in half floats, exposed from its luminance "
+          "histogram and tone mapped, instead of clipping bright colors",
+          {"hdr"}},
+      bloom{parser, "bloom",
+          "With --hdr, let bright and emissive surfaces glow, blurred at "
+          "half resolution and below",
+          {"bloom"}},
+      variableRateShading{parser, "variable-rate-shading",
+          "With --hdr and GL_NV_shading_rate_image, shade flat and "
+          "peripheral regions of the previous frame per 2x2 or 4x4 pixels",
+          {"variable-rate-shading"}},
+      temporalAntiAliasing{parser, "taa",
+          "With --hdr, antialias the window by blending jittered frames "
+          "with the previous ones, reprojected by motion vectors",
+          {"taa"}},
+      glContext{parser, "gl-context",
+          "debug (default) for a debug context logging GL messages "
+          "synchronously, release for a context only counting performance "
+          "messages, no-error for a KHR_no_error context",
+          {"gl-context"}},
+      collectGLMessages{parser, "collect-gl-messages",
+          "Log each GL debug message once and count it in the trace zone "
+          "reporting it, counts shown in the GUI and written by bench",
+          {"collect-gl-messages"}},
+      environment{parser, "environment",
+          "Light the scene with an equirectangular .hdr environment, "
+          "prefiltered once and cached next to the executable",
+          {"environment"}},
+      variant{parser, "variant",
+          "Draw the materials of a KHR_materials_variants variant, by name",
+          {"variant"}},
+      sortedTransparency{parser, "sorted-transparency",
+          "Alpha test MASK materials and blend BLEND materials back to "
+          "front after the opaque draws, with transmissive materials showing "
+          "the draws behind them",
+          {"sorted-transparency"}},
+      deferredShading{parser, "deferred-shading",
+          "Draw material parameters in a G-buffer, then shade each pixel "
+          "once in a lighting pass",
+          {"deferred-shading"}},
+      ssao{parser, "ssao",
+          "Shade with a half resolution screen space ambient occlusion "
+          "(implies --deferred-shading)",
+          {"ssao"}},
+      cameraRelative{parser, "camera-relative",
+          "Draw with matrices relative to the camera, subtracted in double "
+          "precision, for models far from their origin",
+          {"camera-relative"}},
+      pathTrace{parser, "samples",
+          "Trace paths through the triangles of the scene with the PBR "
+          "materials, averaging this number of samples per pixel, as a "
+          "reference for stills",
+          {"path-trace"}}
+  {
+  }
+
+  void setOptions(ViewerOptions &options) const
+  {
+    options.mapBuffers = mapBuffers;
+    options.releaseCpuData = releaseCpuData;
+    options.lazyResources = lazyResources;
+    options.parallelImageDecoding = parallelImageDecoding;
+    options.gpuJpegDecoding = gpuJpegDecoding;
+    options.fastJson = fastJson;
+    options.parallelStartup = parallelStartup;
+    options.pixelBufferUpload = pixelBufferUpload;
+    options.sceneCache = sceneCache;
+    options.programCache = programCache;
+    options.materialVariants = materialVariants || asyncVariants;
+    options.asyncVariants = asyncVariants;
+    options.optimizeMeshes = optimizeMeshes;
+    options.mergeStaticGeometry = mergeStaticGeometry;
+    options.deduplicate = deduplicate;
+    options.cpuMipmaps = cpuMipmaps;
+    options.compressTextures = compressTextures;
+    if (textureQuality) {
+      const auto &tier = args::get(textureQuality);
+      if (tier == "medium") {
+        options.maxTextureSize = 2048;
+        options.maxDataTextureSize = 1024;
+      } else if (tier == "low") {
+        options.maxTextureSize = 1024;
+        options.maxDataTextureSize = 512;
+      } else if (tier != "high") {
+        throw args::ValidationError(
+            "--texture-quality must be low, medium or high, not " + tier);
+      }
+    }
+    if (maxTextureSize) {
+      if (args::get(maxTextureSize) < 1) {
+        throw args::ValidationError("--max-texture-size must be at least 1");
+      }
+      options.maxTextureSize = args::get(maxTextureSize);
+    }
+    options.quantizeVertices = quantizeVertices;
+    options.interleaveVertices = interleaveVertices;
+    options.sharedBuffers = sharedBuffers;
+    options.multiDrawIndirect = multiDrawIndirect || gpuCulling ||
+                                occlusionCulling || generateLods ||
+                                meshletCulling;
+    options.gpuCulling = gpuCulling || occlusionCulling || meshletCulling;
+    options.coherentCulling = coherentCulling;
+    options.occlusionCulling = occlusionCulling;
+    options.generateLods = generateLods;
+    options.meshletCulling = meshletCulling;
+    options.depthPrepass = depthPrepass;
+    options.conditionalRender = conditionalRender;
+    options.impostors = impostors;
+    options.computePoints = computePoints;
+    options.fillPointHoles = fillPointHoles;
+    options.reversedZ = reversedZ;
+    options.hardwareSrgb = hardwareSrgb;
+    options.textureArrays = textureArrays;
+    options.computeSkinning = computeSkinning;
+    options.gpuBounds = gpuBounds;
+    options.punctualLights = punctualLights;
+    options.shadowMaps = shadowMaps;
+    options.hdr = hdr;
+    options.bloom = bloom;
+    options.variableRateShading = variableRateShading;
+    options.temporalAntiAliasing = temporalAntiAliasing;
+    options.glContextMode = getGLContextMode(glContext);
+    options.collectGLMessages = collectGLMessages;
+    if (environment) {
+      options.environmentPath = args::get(environment);
+    }
+    if (variant) {
+      options.variant = args::get(variant);
+    }
+    options.sortedTransparency = sortedTransparency;
+    options.deferredShading = deferredShading || ssao;
+    options.ambientOcclusion = ssao;
+    options.cameraRelative = cameraRelative;
+    if (pathTrace) {
+      options.pathTraceSampleCount = args::get(pathTrace);
+    }
+  }
+
+  args::Flag mapBuffers;
+  args::Flag releaseCpuData;
+  args::Flag lazyResources;
+  args::Flag parallelImageDecoding;
+  args::Flag gpuJpegDecoding;
+  args::Flag fastJson;
+  args::Flag parallelStartup;
+  args::Flag pixelBufferUpload;
+  args::Flag sceneCache;
+  args::Flag programCache;
+  args::Flag materialVariants;
+  args::Flag asyncVariants;
+  args::Flag quantizeVertices;
+  args::Flag interleaveVertices;
+  args::Flag optimizeMeshes;
+  args::Flag mergeStaticGeometry;
+  args::Flag deduplicate;
+  args::Flag cpuMipmaps;
+  args::Flag compressTextures;
+  mutable args::ValueFlag<int> maxTextureSize;
+  mutable args::ValueFlag<std::string> textureQuality;
+  args::Flag multiDrawIndirect;
+  args::Flag sharedBuffers;
+  args::Flag gpuCulling;
+  args::Flag coherentCulling;
+  args::Flag occlusionCulling;
+  args::Flag generateLods;
+  args::Flag meshletCulling;
+  args::Flag depthPrepass;
+  args::Flag conditionalRender;
+  args::Flag impostors;
+  args::Flag computePoints;
+  args::Flag fillPointHoles;
+  args::Flag reversedZ;
+  args::Flag hardwareSrgb;
+  args::Flag textureArrays;
+  args::Flag computeSkinning;
+  args::Flag gpuBounds;
+  args::Flag punctualLights;
+  args::Flag shadowMaps;
+  args::Flag hdr;
+  args::Flag bloom;
+  args::Flag variableRateShading;
+  args::Flag temporalAntiAliasing;
+  // args::get only reads non-const flags
+  mutable args::ValueFlag<std::string> glContext;
+  args::Flag collectGLMessages;
+  mutable args::ValueFlag<std::string> environment;
+  mutable args::ValueFlag<std::string> variant;
+  args::Flag sortedTransparency;
+  args::Flag deferredShading;
+  args::Flag ssao;
+  args::Flag cameraRelative;
+  mutable args::ValueFlag<size_t> pathTrace;
+};
+
 int main(int argc, char **argv)
 {
   auto returnCode = 0;
@@ -18,13 +414,421 @@ int main(int argc, char **argv)
   args::Command info{commands, "info", "Display info about OpenGL",
       [&](args::Subparser &parser) {
         parser.Parse();
+#ifdef GLTF_VIEWER_HEADLESS
+        HeadlessGLContext context;
+#else
         GLFWHandle handle{1, 1, "", false};
+#endif
         printGLVersion();
+        printDriverMemory();
+      }};
+  args::Command serve{commands, "serve",
+      "Render jobs read from stdin, one per line: <glTF file> <output image> "
+      "<width>x<height> [<lookat>], keeping the last scenes loaded",
+      [&](args::Subparser &parser) {
+        args::ValueFlag<int32_t> sceneCount{parser, "scenes",
+            "Number of scenes kept loaded on the GPU (default 4)",
+            {"scenes"}};
+        args::Flag sceneCache{parser, "scene-cache",
+            "Load models from binary caches written next to the glTF files, "
+            "or write them",
+            {"scene-cache"}};
+        args::Flag programCache{parser, "program-cache",
+            "Load shader programs from binaries cached by a previous run, or "
+            "write them",
+            {"program-cache"}};
+        args::Flag mapBuffers{parser, "mmap",
+            "Memory map .glb/.bin files and upload GL buffers directly from "
+            "the mapping",
+            {"mmap"}};
+        args::Flag parallelImageDecoding{parser, "parallel-decode",
+            "Decode images on all cores after parsing the glTF file",
+            {"parallel-decode"}};
+        args::Flag fastJson{parser, "fast-json",
+            "Parse the nodes, accessors and meshes of glTF files straight "
+            "from their text",
+            {"fast-json"}};
+        args::ValueFlag<std::string> glContext{parser, "gl-context",
+            "debug (default), release or no-error, see viewer --gl-context",
+            {"gl-context"}};
+        parser.Parse();
+
+        if (sceneCount && args::get(sceneCount) < 1) {
+          throw args::ValidationError("--scenes must be at least 1");
+        }
+        ViewerOptions options;
+        options.sceneCache = sceneCache;
+        options.programCache = programCache;
+        options.mapBuffers = mapBuffers;
+        options.releaseCpuData = true; // Scenes are only drawn from the GPU
+        options.parallelImageDecoding = parallelImageDecoding;
+        options.fastJson = fastJson;
+        options.glContextMode = getGLContextMode(glContext);
+        RenderServer server{fs::path{argv[0]}, options,
+            sceneCount ? size_t(args::get(sceneCount)) : size_t(4)};
+        returnCode = server.run(std::cin, std::cout);
+      }};
+  args::Command bench{commands, "bench",
+      "Draw a camera path recorded by viewer --record-camera and write the "
+      "CPU and GPU frame times to stdout as JSON",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> file{
+            parser, "file", "Path to file", args::Options::Required};
+        args::ValueFlag<std::string> cameraPath{parser, "cameras",
+            "File of the camera of each frame, one per line in the format of "
+            "--lookat",
+            {"cameras"}, args::Options::Required};
+        args::ValueFlag<int32_t> frameCount{parser, "frames",
+            "Number of frames measured, looping over the cameras (by default "
+            "one per camera)",
+            {"frames"}};
+        args::ValueFlag<int32_t> warmupFrameCount{parser, "warmup",
+            "Number of frames drawn before those measured (default 10)",
+            {"warmup"}};
+        args::ValueFlag<int32_t> imageWidth{
+            parser, "width", "Width of the window (default 1280)", {"width"}};
+        args::ValueFlag<int32_t> imageHeight{parser, "height",
+            "Height of the window (default 720)", {"height"}};
+        args::Flag headless{parser, "headless",
+            "Draw in a framebuffer of a headless EGL context instead of a "
+            "window",
+            {"headless"}};
+        const DrawingFlags drawingFlags{parser};
+        parser.Parse();
+
+        if ((frameCount && args::get(frameCount) < 1) ||
+            (warmupFrameCount && args::get(warmupFrameCount) < 0)) {
+          throw args::ValidationError("--frames must be at least 1 and "
+                                      "--warmup at least 0");
+        }
+        Benchmark benchmark;
+        try {
+          benchmark.cameras = loadCameraList(args::get(cameraPath));
+        } catch (const std::runtime_error &e) {
+          std::cerr << "Error : " << e.what() << std::endl;
+          returnCode = -1;
+          return;
+        }
+        if (benchmark.cameras.empty()) {
+          throw args::ValidationError("No camera in " + args::get(cameraPath));
+        }
+        benchmark.frameCount = frameCount ? size_t(args::get(frameCount))
+                                          : benchmark.cameras.size();
+        benchmark.warmupFrameCount =
+            warmupFrameCount ? size_t(args::get(warmupFrameCount)) : 10;
+
+        BenchmarkInfo info;
+        info.model = args::get(file);
+        info.width = imageWidth ? size_t(args::get(imageWidth)) : 1280;
+        info.height = imageHeight ? size_t(args::get(imageHeight)) : 720;
+        info.frameCount = benchmark.frameCount;
+        info.warmupFrameCount = benchmark.warmupFrameCount;
+        benchmark.done = [&](const BenchmarkTimes &times) {
+          info.renderer =
+              reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+          info.glMessages = getCollectedGLMessages();
+          writeBenchmarkJson(std::cout, info, times);
+        };
+
+        // Not loaded progressively, all textures are drawn from the first
+        // frame
+        ViewerOptions options;
+        drawingFlags.setOptions(options);
+        options.headlessContext = headless;
+        ViewerApplication app{fs::path{argv[0]}, uint32_t(info.width),
+            uint32_t(info.height), args::get(file), {}, "", "", "", options};
+        app.setBenchmark(std::move(benchmark));
+        returnCode = app.run();
+      }};
+  args::Command benchCompare{commands, "bench-compare",
+      "Compare the results of bench of a candidate viewer to those of a "
+      "baseline, model by model, write the change of the median of each "
+      "metric to stdout as CSV and exit with 1 if some metric regressed "
+      "(-1 on errors)",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> baseline{parser, "baseline",
+            "JSON file of bench, or directory of them",
+            args::Options::Required};
+        args::Positional<std::string> candidate{parser, "candidate",
+            "JSON file of bench, or directory of them",
+            args::Options::Required};
+        args::ValueFlagList<std::string> thresholds{parser, "threshold",
+            "Growth of the median of a metric tolerated, in percent, as "
+            "metric=percent with metric cpu, gpu or frame (default 5 for "
+            "each), repeatable",
+            {"threshold"}};
+        args::ValueFlag<double> significance{parser, "alpha",
+            "p-value of the Mann-Whitney U test of the frame times under "
+            "which a change is significant (default 0.01)",
+            {"alpha"}};
+        parser.Parse();
+
+        BenchmarkThresholds benchmarkThresholds;
+        for (const auto &threshold : args::get(thresholds)) {
+          const auto separator = threshold.find('=');
+          auto metric = 0;
+          while (metric < METRIC_COUNT &&
+                 threshold.substr(0, separator) !=
+                     getBenchmarkMetricName(BenchmarkMetric(metric))) {
+            ++metric;
+          }
+          char *end = nullptr;
+          const auto percent = separator == std::string::npos
+                                   ? -1.
+                                   : std::strtod(
+                                         threshold.c_str() + separator + 1,
+                                         &end);
+          if (metric == METRIC_COUNT || percent < 0 || !end || *end) {
+            throw args::ValidationError(
+                "Invalid --threshold " + threshold +
+                ", expected cpu, gpu or frame=percent");
+          }
+          benchmarkThresholds.maxIncreases[metric] = percent / 100;
+        }
+        if (significance) {
+          if (args::get(significance) <= 0 || args::get(significance) > 1) {
+            throw args::ValidationError("--alpha must be in (0, 1]");
+          }
+          benchmarkThresholds.significance = args::get(significance);
+        }
+
+        std::vector<BenchmarkResult> baselineResults;
+        std::vector<BenchmarkResult> candidateResults;
+        try {
+          baselineResults = loadBenchmarkResults(args::get(baseline));
+          candidateResults = loadBenchmarkResults(args::get(candidate));
+        } catch (const std::runtime_error &e) {
+          std::cerr << "Error : " << e.what() << std::endl;
+          returnCode = -1;
+          return;
+        }
+        const auto comparisons = compareBenchmarks(
+            baselineResults, candidateResults, benchmarkThresholds);
+        for (const auto &result : baselineResults) {
+          if (std::none_of(begin(comparisons), end(comparisons),
+                  [&](const BenchmarkComparison &comparison) {
+                    return comparison.model == result.model &&
+                           comparison.width == result.width &&
+                           comparison.height == result.height;
+                  })) {
+            std::cerr << "Warning : no result of " << result.model << " at "
+                      << result.width << "x" << result.height
+                      << " to compare" << std::endl;
+          }
+        }
+        writeBenchmarkComparisonCsvHeader(std::cout);
+        for (const auto &comparison : comparisons) {
+          writeBenchmarkComparisonCsvRow(std::cout, comparison);
+          if (comparison.regression) {
+            returnCode = 1;
+          }
+        }
+      }};
+  args::Command benchLoad{commands, "bench-load",
+      "Load each .gltf/.glb file of a directory several times and write the "
+      "wall time and peak resident memory of each loading phase to stdout "
+      "as CSV, and its heap allocations in builds configured with "
+      "GLTF_VIEWER_ALLOCATION_STATS",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> directory{parser, "directory",
+            "Directory of the glTF files", args::Options::Required};
+        args::ValueFlag<int32_t> repeatCount{parser, "repeat",
+            "Number of loads of each file (default 5)", {"repeat"}};
+        args::Flag headless{parser, "headless",
+            "Create GL objects in a headless EGL context instead of a hidden "
+            "window",
+            {"headless"}};
+        const DrawingFlags drawingFlags{parser};
+        parser.Parse();
+
+        if (repeatCount && args::get(repeatCount) < 1) {
+          throw args::ValidationError("--repeat must be at least 1");
+        }
+        const fs::path directoryPath = args::get(directory);
+        if (!fs::is_directory(directoryPath)) {
+          throw args::ValidationError(
+              args::get(directory) + " is not a directory");
+        }
+        std::vector<fs::path> files;
+        for (fs::directory_iterator it(directoryPath), end; it != end; ++it) {
+          const auto extension = it->path().extension();
+          if (extension == ".gltf" || extension == ".glb") {
+            files.push_back(it->path());
+          }
+        }
+        std::sort(begin(files), end(files));
+
+        // Not loaded progressively: textures are created before run returns
+        ViewerOptions options;
+        drawingFlags.setOptions(options);
+        options.headlessContext = headless;
+        options.profileLoading = true;
+        writeLoadPhasesCsvHeader(std::cout);
+        for (const auto &file : files) {
+          for (int32_t run = 0;
+               run < (repeatCount ? args::get(repeatCount) : 5); ++run) {
+            // Hidden, run returns once the scene is loaded without any job
+            try {
+              ViewerApplication app{fs::path{argv[0]}, 1, 1, file, {}, "", "",
+                  "", options};
+              app.setOutputJobs([](OutputJob &) { return false; });
+              app.run();
+              writeLoadPhasesCsvRows(std::cout, file.filename().string(),
+                  size_t(run), app.loadPhases());
+              std::cout.flush();
+            } catch (const std::exception &e) {
+              std::cerr << "Error : unable to load " << file.string() << ": "
+                        << e.what() << std::endl;
+              returnCode = -1;
+              break; // Next file
+            }
+          }
+        }
+      }};
+  args::Command stats{commands, "stats",
+      "Parse a .gltf/.glb file or those of a directory, in parallel and "
+      "without GL context, and write their node, mesh, triangle, material "
+      "and texture counts, instancing opportunities, hierarchy depth and "
+      "estimated video memory without and with texture compression to "
+      "stdout as CSV",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> path{parser, "path",
+            "glTF file, or directory of glTF files", args::Options::Required};
+        args::ValueFlag<int32_t> jobs{parser, "jobs",
+            "Number of files parsed at once (default all hardware threads)",
+            {"jobs"}};
+        parser.Parse();
+
+        if (jobs && args::get(jobs) < 1) {
+          throw args::ValidationError("--jobs must be at least 1");
+        }
+        const fs::path inputPath = args::get(path);
+        std::vector<fs::path> files;
+        if (fs::is_directory(inputPath)) {
+          for (fs::directory_iterator it(inputPath), end; it != end; ++it) {
+            const auto extension = it->path().extension();
+            if (extension == ".gltf" || extension == ".glb") {
+              files.push_back(it->path());
+            }
+          }
+          std::sort(begin(files), end(files));
+        } else if (fs::exists(inputPath)) {
+          files.push_back(inputPath);
+        } else {
+          throw args::ValidationError(args::get(path) + " does not exist");
+        }
+
+        std::vector<ModelStats> fileStats(files.size());
+        std::vector<std::string> errors(files.size());
+        parallelFor(
+            files.size(),
+            [&](size_t i) {
+              try {
+                loadModelStats(files[i], fileStats[i], errors[i]);
+              } catch (const std::exception &e) {
+                errors[i] = e.what();
+              }
+            },
+            jobs ? size_t(args::get(jobs)) : 0);
+
+        writeModelStatsCsvHeader(std::cout);
+        for (size_t i = 0; i < files.size(); ++i) {
+          if (!errors[i].empty()) {
+            std::cerr << "Error : unable to load " << files[i].string()
+                      << ": " << errors[i] << std::endl;
+            returnCode = -1;
+            continue;
+          }
+          writeModelStatsCsvRow(
+              std::cout, files[i].filename().string(), fileStats[i]);
+        }
+      }};
+  args::Command thumbnails{commands, "thumbnails",
+      "Render a thumbnail of each model of a list in one process, into the "
+      "tiles of an atlas image or into one image per model",
+      [&](args::Subparser &parser) {
+        args::Positional<std::string> modelListPath{parser, "list",
+            "File of the models, one path per line (see viewer --model-list)",
+            args::Options::Required};
+        args::ValueFlag<std::string> output{parser, "output",
+            "Atlas image with --columns, else directory of the thumbnails",
+            {"o", "output"}, args::Options::Required};
+        args::ValueFlag<int32_t> size{parser, "size",
+            "Width and height of each thumbnail (default 256)", {"size"}};
+        args::ValueFlag<int32_t> columns{parser, "columns",
+            "Render the thumbnails into the tiles of this many columns of the "
+            "atlas image given by --output, top left first",
+            {"columns"}};
+        args::ValueFlag<std::string> format{parser, "format",
+            "Format of the thumbnails without --columns: png (default), ppm, "
+            "tga, bmp or qoi",
+            {"format"}};
+        args::ValueFlag<int32_t> sampleCount{parser, "msaa",
+            "Antialias thumbnails with this many samples per pixel",
+            {"msaa"}};
+        args::Flag headless{parser, "headless",
+            "Render in a headless EGL context instead of a hidden GLFW window",
+            {"headless"}};
+        const DrawingFlags drawingFlags{parser};
+        parser.Parse();
+
+        if ((size && args::get(size) < 1) ||
+            (columns && args::get(columns) < 1) ||
+            (sampleCount && args::get(sampleCount) < 1)) {
+          throw args::ValidationError(
+              "--size, --columns and --msaa must be at least 1");
+        }
+        ViewerOptions options;
+        drawingFlags.setOptions(options);
+        // Programs are compiled for the first models, then loaded from their
+        // binaries
+        options.programCache = true;
+        options.headlessContext = headless;
+        options.thumbnails = true;
+        options.fitOutputDetail = true;
+        if (format) {
+          options.batchImageExtension = "." + args::get(format);
+        }
+        const auto imagePath = columns ? fs::path(args::get(output))
+                                       : fs::path(options.batchImageExtension);
+        // Thumbnails are read back as bytes
+        if (!isImageFormatSupported(imagePath) ||
+            isFloatImageFormat(imagePath)) {
+          throw args::ValidationError("Unsupported image format " +
+                                      imagePath.extension().string() +
+                                      " (expected png, ppm, tga, bmp or qoi)");
+        }
+        if (columns) {
+          options.thumbnailAtlasColumns = size_t(args::get(columns));
+        } else {
+          fs::create_directories(args::get(output));
+        }
+        if (sampleCount) {
+          options.outputSampleCount = size_t(args::get(sampleCount));
+        }
+        try {
+          options.modelList = loadModelList(args::get(modelListPath));
+        } catch (const std::runtime_error &e) {
+          std::cerr << "Error : " << e.what() << std::endl;
+          returnCode = -1;
+          return;
+        }
+        if (options.modelList.empty()) {
+          throw args::ValidationError(
+              "No model in " + args::get(modelListPath));
+        }
+
+        const auto thumbnailSize = uint32_t(size ? args::get(size) : 256);
+        ViewerApplication app{fs::path{argv[0]}, thumbnailSize, thumbnailSize,
+            options.modelList.front(), {}, "", "", args::get(output),
+            options};
+        returnCode = app.run();
       }};
   args::Command interactive{
       commands, "viewer", "Run glTF viewer", [&](args::Subparser &parser) {
         args::Positional<std::string> file{
-            parser, "file", "Path to file", args::Options::Required};
+            parser, "file", "Path or http(s):// URL of the file",
+            args::Options::Required};
         args::ValueFlag<std::string> lookat{parser, "lookat",
             "Look at parameters for the Camera with format "
             "eye_x,eye_y,eye_z,center_x,center_y,center_z,up_x,up_y,up_z",
@@ -43,6 +847,193 @@ int main(int argc, char **argv)
             "Output path to render the image. If specified no window is shown. "
             "Only png is supported.",
             {"o", "output"}};
+        args::ValueFlag<int32_t> frameCount{parser, "frames",
+            "Number of frames rendered with --output, written to "
+            "<output>_<frame>.png when more than one",
+            {"frames"}};
+        args::ValueFlag<std::string> cameraList{parser, "cameras",
+            "File of cameras, one per line in the format of --lookat, to "
+            "render in the directory given by --output",
+            {"cameras"}};
+        args::ValueFlag<int32_t> turntableViewCount{parser, "turntable",
+            "Number of views around the vertical axis through the center of "
+            "the camera to render in the directory given by --output",
+            {"turntable"}};
+        args::ValueFlag<std::string> sweep{parser, "sweep",
+            "File of the ranges of randomized cameras and suns around the "
+            "scene to render in the directory given by --output, listed in "
+            "its sweep.csv (implies --async-readback)",
+            {"sweep"}};
+        args::ValueFlag<std::string> frameRange{parser, "frame-range",
+            "Render only the frames <first>-<last> of --frames, numbered as in "
+            "the whole sequence, to share it between processes",
+            {"frame-range"}};
+        args::ValueFlag<int32_t> frameRate{parser, "fps",
+            "Play the first animation at this frame rate over --frames, or "
+            "the views of --cameras or --turntable, at exact times. Also the "
+            "rate of the video written when --output is a .mp4, .mkv, .mov "
+            "or .webm file (default 30, without it images are in the rest "
+            "pose)",
+            {"fps"}};
+        args::ValueFlag<std::string> videoEncoder{parser, "video-encoder",
+            "ffmpeg encoder of the video of --output: libx264 (default), "
+            "libvpx-vp9, h264_nvenc, hevc_nvenc, h264_vaapi or hevc_vaapi",
+            {"video-encoder"}};
+        args::ValueFlag<std::string> batchFormat{parser, "batch-format",
+            "Format of the images of --cameras, --turntable and --sweep: png "
+            "(default), ppm, tga, bmp, qoi or exr",
+            {"batch-format"}};
+        args::Flag asyncReadback{parser, "async-readback",
+            "With --output, read frames back through pixel pack buffers and "
+            "encode them on a worker thread while the next frames render",
+            {"async-readback"}};
+        args::Flag outputAovs{parser, "output-aovs",
+            "With --output, also write the draw IDs, normals and depths of "
+            "each image, drawn in the same pass, to NumPy arrays next to it",
+            {"output-aovs"}};
+        args::ValueFlag<int32_t> tileSize{parser, "tile-size",
+            "With --output, render images in square tiles of this size, "
+            "written band by band (by default only images larger than "
+            "GL_MAX_TEXTURE_SIZE)",
+            {"tile-size"}};
+        args::ValueFlag<std::string> tracePath{parser, "trace",
+            "Write a Chrome trace (chrome://tracing, Perfetto) of loading and "
+            "frames to this JSON file",
+            {"trace"}};
+        args::Flag headless{parser, "headless",
+            "With --output, render in a headless EGL context instead of a "
+            "hidden GLFW window, without display server",
+            {"headless"}};
+        args::ValueFlag<int32_t> sampleCount{parser, "msaa",
+            "With --output, antialias images with this many samples per "
+            "pixel, resolved before they are read back",
+            {"msaa"}};
+        args::Flag fitDetail{parser, "fit-detail",
+            "With --output, create textures from their mip levels of about "
+            "the size of the images, and choose MSFT_lod levels for it",
+            {"fit-detail"}};
+        args::ValueFlag<int32_t> workerCount{parser, "workers",
+            "With --output, share the images between this many workers, each "
+            "in a headless context on its own EGL device (0 for one per "
+            "device)",
+            {"workers"}};
+        args::Flag progressiveLoading{parser, "progressive",
+            "Start drawing the scene before textures are decoded and uploaded",
+            {"progressive"}};
+        args::Flag pipelinedFrames{parser, "pipelined",
+            "Cull the draws of the next frame on a worker thread while the "
+            "current one is submitted, with one frame of latency",
+            {"pipelined"}};
+        args::Flag renderOnDemand{parser, "on-demand",
+            "Only draw frames after input, camera moves and loading progress "
+            "instead of continuously",
+            {"on-demand"}};
+        args::Flag cacheSceneImage{parser, "cache-scene",
+            "Keep the last image of the scene and only draw the GUI over it "
+            "while the view does not change",
+            {"cache-scene"}};
+        args::Flag gpuPicking{parser, "gpu-picking",
+            "Pick the draw under the cursor from draw IDs written with the "
+            "image of the scene instead of primitive boxes",
+            {"gpu-picking"}};
+        args::ValueFlag<float> targetFrameTime{parser, "target-frame-time",
+            "GPU time in milliseconds to keep the scene within by scaling its "
+            "resolution",
+            {"target-frame-time"}};
+        args::ValueFlag<size_t> refineFrameCount{parser, "frames",
+            "Average this number of jittered frames once the view is still, "
+            "and draw cheaper frames while it moves",
+            {"refine"}};
+        args::ValueFlag<float> stereoSeparation{parser, "separation",
+            "Draw stereo views side by side in a single pass, with eyes this "
+            "distance apart in scene units (needs GL_OVR_multiview2)",
+            {"stereo"}};
+        args::ValueFlag<float> stereoConvergence{parser, "distance",
+            "With --stereo, distance from the camera drawn at the same place "
+            "for both eyes (default 2)",
+            {"stereo-convergence"}};
+        args::Flag multiViewport{parser, "viewports",
+            "Split the window in top, front, side and camera views of the "
+            "scene",
+            {"viewports"}};
+        args::ValueFlag<uint16_t> streamPort{parser, "port",
+            "Stream the window as MPEG-TS over TCP on this port, and move the "
+            "camera with the input of the client read on the next port",
+            {"stream"}};
+        args::ValueFlag<std::string> streamEncoder{parser, "encoder",
+            "ffmpeg encoder of --stream, libx264 (default) or h264_nvenc, "
+            "hevc_nvenc, h264_vaapi, hevc_vaapi on the GPU",
+            {"stream-encoder"}};
+        args::ValueFlag<size_t> textureBudget{parser, "MiB",
+            "Stream textures from coarse levels to the levels the view "
+            "needs within this budget of GPU memory",
+            {"texture-budget"}};
+        args::ValueFlag<size_t> uploadBudget{parser, "MiB",
+            "Spread the transfers of textures of images decoded while the "
+            "scene is drawn over frames, this many MiB per frame",
+            {"upload-budget"}};
+        args::ValueFlag<size_t> tileRamBudget{parser, "MiB",
+            "Of a tileset.json, cache the contents of tiles within this "
+            "budget of CPU memory (default 1024)",
+            {"tile-memory"}};
+        args::ValueFlag<size_t> tileVramBudget{parser, "MiB",
+            "Of a tileset.json, keep the tiles drawn within this budget of "
+            "GPU memory (default 512)",
+            {"tile-gpu-memory"}};
+        args::ValueFlag<float> tileMaxScreenSpaceError{parser, "pixels",
+            "Of a tileset.json, refine the tiles whose geometric error "
+            "exceeds this many pixels on screen (default 16)",
+            {"tile-error"}};
+        args::ValueFlag<size_t> memoryBudget{parser, "MiB",
+            "Warn once the buffers, textures and render targets allocated "
+            "exceed this budget of GPU memory",
+            {"memory-budget"}};
+        args::Flag vsync{parser, "vsync",
+            "Swap buffers on vertical sync (adaptive when supported)",
+            {"vsync"}};
+        args::Flag lowLatency{parser, "low-latency",
+            "Poll input right before drawing the scene, with at most one "
+            "frame in flight on the GPU, and show the input latency",
+            {"low-latency"}};
+        args::ValueFlag<double> idleGuiRate{parser, "Hz",
+            "Build the GUI this many times per second while the cursor is "
+            "off it and still, 0 for every frame (default 4). F1 hides it.",
+            {"idle-gui-rate"}};
+        args::Flag loaderThread{parser, "loader-thread",
+            "Upload the textures of --progressive and the models dropped on "
+            "the window from a thread with a GL context of its own",
+            {"loader-thread"}};
+        args::Flag watchFiles{parser, "watch",
+            "Reload the model, its buffers and images, and the shaders once "
+            "their files change",
+            {"watch"}};
+        args::ValueFlag<std::string> modelListPath{parser, "model-list",
+            "Switch between the models listed in this file, one path per "
+            "line, from the GUI",
+            {"model-list"}};
+        args::Flag profileFrames{parser, "profile",
+            "Graph GPU times and pipeline statistics of passes and CPU times "
+            "of frame steps in the GUI",
+            {"profile"}};
+        args::Flag frameTiming{parser, "frame-timing",
+            "Time the input, submission, GPU end and swap of frames, graph "
+            "their intervals and attribute hitches in the GUI",
+            {"frame-timing"}};
+        args::ValueFlag<std::string> frameTimingPath{parser,
+            "frame-timing-csv",
+            "Write the timing of each frame to this CSV file, implies "
+            "--frame-timing",
+            {"frame-timing-csv"}};
+        args::ValueFlag<std::string> drawStatsPath{parser, "stats-csv",
+            "Write the draw calls, triangles, binds and uploads of each frame "
+            "or output image to this CSV file",
+            {"stats-csv"}};
+        args::ValueFlag<std::string> recordCameraPath{parser,
+            "record-camera",
+            "Write the camera of each frame of the viewer to this file, in "
+            "the format of --cameras, to be played back by bench",
+            {"record-camera"}};
+        const DrawingFlags drawingFlags{parser};
         parser.Parse();
 
         std::vector<float> lookatParams;
@@ -62,10 +1053,247 @@ int main(int argc, char **argv)
         uint32_t width = imageWidth ? args::get(imageWidth) : 1280;
         uint32_t height = imageHeight ? args::get(imageHeight) : 720;
 
-        ViewerApplication app{fs::path{argv[0]}, width, height, args::get(file),
-            lookatParams, args::get(vertexShader), args::get(fragmentShader),
-            args::get(output)};
-        returnCode = app.run();
+        ViewerOptions options;
+        drawingFlags.setOptions(options);
+        options.progressiveLoading = progressiveLoading;
+        options.loaderThread = loaderThread;
+        options.watchFiles = watchFiles;
+        if (modelListPath) {
+          try {
+            options.modelList = loadModelList(args::get(modelListPath));
+          } catch (const std::runtime_error &e) {
+            std::cerr << "Error : " << e.what() << std::endl;
+            returnCode = -1;
+            return;
+          }
+        }
+        options.pipelinedFrames = pipelinedFrames;
+        options.renderOnDemand = renderOnDemand;
+        options.cacheSceneImage = cacheSceneImage;
+        options.gpuPicking = gpuPicking;
+        if (targetFrameTime) {
+          options.targetFrameTime = args::get(targetFrameTime);
+        }
+        if (textureBudget) {
+          options.textureBudget = args::get(textureBudget);
+        }
+        if (uploadBudget) {
+          options.uploadBudget = args::get(uploadBudget);
+        }
+        if (tileRamBudget) {
+          options.tileRamBudget = args::get(tileRamBudget);
+        }
+        if (tileVramBudget) {
+          options.tileVramBudget = args::get(tileVramBudget);
+        }
+        if (tileMaxScreenSpaceError) {
+          if (args::get(tileMaxScreenSpaceError) <= 0.f) {
+            throw args::ValidationError("--tile-error must be positive");
+          }
+          options.tileMaxScreenSpaceError = args::get(tileMaxScreenSpaceError);
+        }
+        if (memoryBudget) {
+          options.gpuMemoryBudget = args::get(memoryBudget);
+        }
+        options.vsync = vsync;
+        if (lowLatency && (output || pipelinedFrames)) {
+          throw args::ValidationError(
+              "--low-latency can not be used with --output nor --pipelined");
+        }
+        options.lowLatency = lowLatency;
+        if (idleGuiRate) {
+          if (args::get(idleGuiRate) < 0.) {
+            throw args::ValidationError("--idle-gui-rate must be positive");
+          }
+          options.idleGuiRate = args::get(idleGuiRate);
+        }
+        if (refineFrameCount) {
+          options.refineFrameCount = args::get(refineFrameCount);
+        }
+        if (stereoSeparation) {
+          if (args::get(stereoSeparation) < 0.f) {
+            throw args::ValidationError("--stereo must be positive");
+          }
+          options.stereoSeparation = args::get(stereoSeparation);
+        }
+        if (stereoConvergence) {
+          if (args::get(stereoConvergence) <= 0.f) {
+            throw args::ValidationError(
+                "--stereo-convergence must be positive");
+          }
+          options.stereoConvergence = args::get(stereoConvergence);
+        }
+        options.multiViewport = multiViewport;
+        if (streamPort) {
+          if (!args::get(streamPort) || args::get(streamPort) == 65535) {
+            throw args::ValidationError(
+                "--stream must be a port between 1 and 65534");
+          }
+          options.streamPort = args::get(streamPort);
+        }
+        if (streamEncoder) {
+          options.streamEncoder = args::get(streamEncoder);
+        }
+        options.profileFrames = profileFrames;
+        if ((frameTiming || frameTimingPath) && output) {
+          throw args::ValidationError(
+              "--frame-timing needs the viewer, without --output");
+        }
+        options.frameTiming = frameTiming || frameTimingPath;
+        if (frameTimingPath) {
+          options.frameTimingPath = args::get(frameTimingPath);
+        }
+        if (drawStatsPath) {
+          options.drawStatsPath = args::get(drawStatsPath);
+        }
+        if (recordCameraPath) {
+          if (output) {
+            throw args::ValidationError("--record-camera needs the viewer, "
+                                        "without --output");
+          }
+          options.recordCameraPath = args::get(recordCameraPath);
+        }
+        if (frameCount) {
+          if (args::get(frameCount) < 1) {
+            throw args::ValidationError("--frames must be at least 1");
+          }
+          options.outputFrameCount = size_t(args::get(frameCount));
+        }
+        if (frameRange) {
+          const auto tokens = split(args::get(frameRange), "-");
+          try {
+            if (!frameCount || tokens.size() != 2) {
+              throw std::invalid_argument("");
+            }
+            options.outputFirstFrame = size_t(std::stoul(tokens[0]));
+            options.outputLastFrame = size_t(std::stoul(tokens[1]));
+          } catch (const std::logic_error &) {
+            throw args::ValidationError(
+                "--frame-range needs --frames and the format <first>-<last>");
+          }
+          if (options.outputFirstFrame > options.outputLastFrame ||
+              options.outputLastFrame >= options.outputFrameCount) {
+            throw args::ValidationError("--frame-range must be frames of "
+                                        "--frames, the first not after the "
+                                        "last");
+          }
+        }
+        if (cameraList || turntableViewCount || sweep) {
+          if (!output || frameCount ||
+              int(bool(cameraList)) + int(bool(turntableViewCount)) +
+                      int(bool(sweep)) >
+                  1) {
+            throw args::ValidationError(
+                "--cameras, --turntable and --sweep need --output, without "
+                "--frames nor each other");
+          }
+          if (turntableViewCount && args::get(turntableViewCount) < 1) {
+            throw args::ValidationError("--turntable must be at least 1");
+          }
+        }
+        if (batchFormat) {
+          options.batchImageExtension = "." + args::get(batchFormat);
+        }
+        // Batches and frames can be the frames of a video instead
+        const auto isVideo = output && !sweep &&
+                             isVideoFormat(fs::path(args::get(output)));
+        if (isVideo && (outputAovs || workerCount || tileSize)) {
+          throw args::ValidationError("Videos can not be written with "
+                                      "--output-aovs, --workers nor "
+                                      "--tile-size");
+        }
+        if (videoEncoder && !isVideo) {
+          throw args::ValidationError("--video-encoder needs a video --output");
+        }
+        if (frameRate) {
+          if (!output || sweep || args::get(frameRate) < 1) {
+            throw args::ValidationError(
+                "--fps needs --output, not --sweep, and must be at least 1");
+          }
+          options.outputFrameRate = size_t(args::get(frameRate));
+        }
+        if (videoEncoder) {
+          options.videoEncoder = args::get(videoEncoder);
+        }
+        const auto imagePath = cameraList || turntableViewCount || sweep
+                                   ? fs::path(options.batchImageExtension)
+                                   : fs::path(args::get(output));
+        if (output && !isVideo && !isImageFormatSupported(imagePath)) {
+          throw args::ValidationError("Unsupported image format " +
+                                      imagePath.extension().string() +
+                                      " (expected png, ppm, tga, bmp, qoi or "
+                                      "exr)");
+        }
+        if (cameraList) {
+          options.cameraListPath = args::get(cameraList);
+        }
+        if (turntableViewCount) {
+          options.turntableViewCount = size_t(args::get(turntableViewCount));
+        }
+        if (sweep) {
+          // Validated before loading the scene
+          try {
+            loadViewSweepSpec(args::get(sweep));
+          } catch (const std::runtime_error &e) {
+            throw args::ValidationError(e.what());
+          }
+          options.sweepPath = args::get(sweep);
+        }
+        options.asyncReadback = asyncReadback || sweep;
+        if (outputAovs && !output) {
+          throw args::ValidationError("--output-aovs needs --output");
+        }
+        options.outputAovs = outputAovs;
+        if (headless && !output) {
+          throw args::ValidationError("--headless needs --output");
+        }
+        options.headlessContext = headless;
+        if (sampleCount) {
+          if (!output || args::get(sampleCount) < 1) {
+            throw args::ValidationError(
+                "--msaa needs --output and must be at least 1");
+          }
+          options.outputSampleCount = size_t(args::get(sampleCount));
+        }
+        if (fitDetail && !output) {
+          throw args::ValidationError("--fit-detail needs --output");
+        }
+        options.fitOutputDetail = fitDetail;
+        if (workerCount && (!output || args::get(workerCount) < 0)) {
+          throw args::ValidationError(
+              "--workers needs --output and must be at least 0");
+        }
+        if (workerCount && drawStatsPath) {
+          // Workers would all write the file
+          throw args::ValidationError("--stats-csv can not be used with "
+                                      "--workers");
+        }
+        if (tileSize) {
+          if (args::get(tileSize) < 1) {
+            throw args::ValidationError("--tile-size must be at least 1");
+          }
+          options.outputTileSize = size_t(args::get(tileSize));
+        }
+
+        if (tracePath) {
+          startTracing();
+        }
+        if (workerCount) {
+          BatchRenderer renderer{fs::path{argv[0]}, width, height,
+              args::get(file), lookatParams, args::get(vertexShader),
+              args::get(fragmentShader), args::get(output), options,
+              size_t(args::get(workerCount))};
+          returnCode = renderer.run();
+        } else {
+          ViewerApplication app{fs::path{argv[0]}, width, height,
+              args::get(file), lookatParams, args::get(vertexShader),
+              args::get(fragmentShader), args::get(output), options};
+          returnCode = app.run();
+        }
+        if (tracePath && !writeTrace(args::get(tracePath))) {
+          std::cerr << "Error : unable to write " << args::get(tracePath)
+                    << std::endl;
+        }
       }};
 
   try {
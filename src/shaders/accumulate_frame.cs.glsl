@@ -0,0 +1,22 @@
+#version 430
+
+// Running average of the frames of FrameAccumulator: each texel of uAverage
+// moves towards the texel of the new frame by uWeight, one over the number
+// of frames averaged.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform float uWeight;
+uniform sampler2D uFrame;
+layout(rgba32f) uniform image2D uAverage;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, imageSize(uAverage)))) {
+    return;
+  }
+  vec4 frame = texelFetch(uFrame, texel, 0);
+  vec4 average = uWeight < 1.0 ? imageLoad(uAverage, texel) : frame;
+  imageStore(uAverage, texel, mix(average, frame, uWeight));
+}
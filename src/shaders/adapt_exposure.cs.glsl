@@ -0,0 +1,51 @@
+#version 430
+
+// Exposure of the scene of --hdr (see ToneMapping), from the histogram of
+// luminance_histogram.cs.glsl: a single workgroup sums the bins weighted by
+// their index in shared memory, for the average log2 luminance of the pixels
+// out of bin 0. The exposure maps it to middle grey, and the bins are
+// cleared for the next histogram.
+
+layout(local_size_x = 256) in;
+
+const uint BIN_COUNT = 256;
+const float MIN_LOG_LUMINANCE = -10.0;
+const float LOG_LUMINANCE_RANGE = 16.0;
+const float MIDDLE_GREY = 0.18;
+
+layout(std430) buffer Exposure
+{
+  float exposure;
+  uint bins[BIN_COUNT];
+};
+
+shared float sWeightedCounts[BIN_COUNT];
+shared uint sCounts[BIN_COUNT];
+
+void main()
+{
+  uint bin = gl_LocalInvocationIndex;
+  uint count = bins[bin];
+  bins[bin] = 0u;
+  sWeightedCounts[bin] = float(count) * float(bin);
+  sCounts[bin] = bin > 0u ? count : 0u;
+  for (uint offset = BIN_COUNT / 2u; offset > 0u; offset /= 2u) {
+    barrier();
+    if (bin < offset) {
+      sWeightedCounts[bin] += sWeightedCounts[bin + offset];
+      sCounts[bin] += sCounts[bin + offset];
+    }
+  }
+
+  if (bin == 0u) {
+    if (sCounts[0] == 0u) {
+      exposure = 1.0; // Nothing lit
+      return;
+    }
+    float averageBin = sWeightedCounts[0] / float(sCounts[0]);
+    float logLuminance = MIN_LOG_LUMINANCE + (averageBin - 1.0) /
+                                                 float(BIN_COUNT - 2u) *
+                                                 LOG_LUMINANCE_RANGE;
+    exposure = MIDDLE_GREY / exp2(logLuminance);
+  }
+}
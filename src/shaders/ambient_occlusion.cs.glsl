@@ -0,0 +1,96 @@
+#version 430
+
+// Scalable ambient obscurance (McGuire et al. 2012) of --ssao, at half the
+// resolution of the G-buffer: each texel of uDestination is the occlusion of
+// the full resolution pixel at twice its coordinates by the points of the
+// depth buffer in a disk of uRadius around it, and the view depth of that
+// pixel for the bilateral filters.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uDepth; // Of the G-buffer
+uniform sampler2D uNormal; // Octahedral, of the G-buffer
+uniform mat4 uInverseProjMatrix;
+uniform float uProjScale; // Pixels of a view space unit at depth 1
+uniform float uRadius; // View space
+layout(rg16f) uniform writeonly image2D uDestination;
+
+const int SAMPLE_COUNT = 12;
+const int SPIRAL_TURNS = 7;
+const float M_PI = 3.141592653589793;
+
+// Cleared depth, where nothing is drawn. With REVERSED_Z (--reversed-z),
+// depths are normalized device coordinates, the near plane at 1.
+#ifdef REVERSED_Z
+const float FAR_DEPTH = 0;
+#else
+const float FAR_DEPTH = 1;
+#endif
+
+// Same as in pbr_directional_light.fs.glsl
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2 - 1;
+  vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0);
+  n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+  return normalize(n);
+}
+
+vec3 getViewSpacePosition(ivec2 pixel, vec2 size)
+{
+  float depth = texelFetch(uDepth, pixel, 0).r;
+  vec2 ndc = (vec2(pixel) + 0.5) / size * 2 - 1;
+#ifdef REVERSED_Z
+  vec4 position = uInverseProjMatrix * vec4(ndc, depth, 1);
+#else
+  vec4 position = uInverseProjMatrix * vec4(ndc, depth * 2 - 1, 1);
+#endif
+  return position.xyz / position.w;
+}
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, imageSize(uDestination)))) {
+    return;
+  }
+  ivec2 size = textureSize(uDepth, 0);
+  ivec2 pixel = min(texel * 2, size - 1);
+  if (texelFetch(uDepth, pixel, 0).r == FAR_DEPTH) {
+    imageStore(uDestination, texel, vec4(1, 0, 0, 0));
+    return;
+  }
+  vec3 P = getViewSpacePosition(pixel, vec2(size));
+  vec3 N = decodeNormal(texelFetch(uNormal, pixel, 0).xy);
+  // Normals of double sided surfaces seen from behind face the camera
+  N = dot(N, P) > 0 ? -N : N;
+
+  // Rotation of the spiral of samples from interleaved gradient noise,
+  // smoothed by the 4x4 blur of ambient_occlusion_blur.cs.glsl
+  float angle = 2 * M_PI *
+                fract(52.9829189 *
+                      fract(dot(vec2(texel), vec2(0.06711056, 0.00583715))));
+  float diskRadius = uRadius * uProjScale / -P.z;
+  float radius2 = uRadius * uRadius;
+  float bias = 0.01 * uRadius;
+  float sum = 0;
+  for (int i = 0; i < SAMPLE_COUNT; ++i) {
+    float alpha = (float(i) + 0.5) / float(SAMPLE_COUNT);
+    float sampleAngle = alpha * float(SPIRAL_TURNS) * 2 * M_PI + angle;
+    ivec2 offset =
+        ivec2(alpha * diskRadius * vec2(cos(sampleAngle), sin(sampleAngle)));
+    ivec2 samplePixel = pixel + offset;
+    if (offset == ivec2(0) || any(lessThan(samplePixel, ivec2(0))) ||
+        any(greaterThanEqual(samplePixel, size))) {
+      continue;
+    }
+    vec3 v = getViewSpacePosition(samplePixel, vec2(size)) - P;
+    float vv = dot(v, v);
+    float f = max(radius2 - vv, 0);
+    sum += f * f * f * max((dot(v, N) - bias) / (vv + 0.01 * radius2), 0);
+  }
+  float occlusion = max(0, 1 - sum * 5 / (radius2 * radius2 * radius2 *
+                                             float(SAMPLE_COUNT)));
+  imageStore(uDestination, texel, vec4(occlusion, -P.z, 0, 0));
+}
@@ -0,0 +1,38 @@
+#version 430
+
+// Bilateral 4x4 blur of the occlusion of ambient_occlusion.cs.glsl: texels
+// are averaged with those of similar view depths, so that the occlusion does
+// not bleed across edges.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uSource; // Occlusion and view depth
+layout(rg16f) uniform writeonly image2D uDestination;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(uDestination);
+  if (any(greaterThanEqual(texel, size))) {
+    return;
+  }
+  vec2 center = texelFetch(uSource, texel, 0).rg;
+  if (center.g == 0) {
+    imageStore(uDestination, texel, vec4(center, 0, 0));
+    return; // Nothing drawn
+  }
+  float sum = 0;
+  float weightSum = 0;
+  for (int y = -2; y < 2; ++y) {
+    for (int x = -2; x < 2; ++x) {
+      vec2 tap = texelFetch(uSource, clamp(texel + ivec2(x, y), ivec2(0),
+                                         size - 1),
+          0).rg;
+      float weight = max(0, 1 - abs(tap.g - center.g) / (0.05 * center.g));
+      sum += tap.r * weight;
+      weightSum += weight;
+    }
+  }
+  imageStore(
+      uDestination, texel, vec4(sum / max(weightSum, 1e-4), center.g, 0, 0));
+}
@@ -0,0 +1,59 @@
+#version 430
+
+// One level of the bloom pyramid of Bloom: each texel of uDestination gets
+// the average of the 4x4 texels around the 2x2 it covers in uSource, weighted
+// by the tent (1, 3, 3, 1) on each axis. Each workgroup first loads the
+// 18x18 texels read by its 8x8 texels into shared memory, so that every
+// source texel is fetched once instead of 16 times.
+//
+// Level 0 is downsampled from the scene itself, its texels weighted by the
+// inverse of their luminance as well (Karis average): single bright pixels
+// would otherwise flicker as large blobs in the coarse levels.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+const int TILE_SIZE = 2 * 8 + 2;
+
+uniform sampler2D uSource;
+uniform int uSourceLevel;
+uniform ivec2 uSourceSize; // Of the region read, at the bottom left
+uniform ivec2 uDestinationSize;
+uniform bool uKarisAverage;
+layout(r11f_g11f_b10f) writeonly uniform image2D uDestination;
+
+shared vec3 sTile[TILE_SIZE][TILE_SIZE];
+
+void main()
+{
+  // Source texel of the first texel of the tile, clamped to the region
+  ivec2 tileOrigin = ivec2(2u * gl_WorkGroupID.xy * gl_WorkGroupSize.xy) - 1;
+  for (uint i = gl_LocalInvocationIndex; i < uint(TILE_SIZE * TILE_SIZE);
+       i += gl_WorkGroupSize.x * gl_WorkGroupSize.y) {
+    ivec2 tileTexel = ivec2(i % uint(TILE_SIZE), i / uint(TILE_SIZE));
+    ivec2 source = clamp(tileOrigin + tileTexel, ivec2(0), uSourceSize - 1);
+    sTile[tileTexel.y][tileTexel.x] =
+        texelFetch(uSource, source, uSourceLevel).rgb;
+  }
+  barrier();
+
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, uDestinationSize))) {
+    return;
+  }
+  const float tent[4] = float[](1.0, 3.0, 3.0, 1.0);
+  ivec2 first = 2 * ivec2(gl_LocalInvocationID.xy);
+  vec3 color = vec3(0);
+  float weightSum = 0.0;
+  for (int y = 0; y < 4; ++y) {
+    for (int x = 0; x < 4; ++x) {
+      vec3 source = sTile[first.y + y][first.x + x];
+      float weight = tent[x] * tent[y];
+      if (uKarisAverage) {
+        weight /= 1.0 + dot(source, vec3(0.2126, 0.7152, 0.0722));
+      }
+      color += weight * source;
+      weightSum += weight;
+    }
+  }
+  imageStore(uDestination, texel, vec4(color / weightSum, 1));
+}
@@ -0,0 +1,38 @@
+#version 430
+
+// One level of the bloom pyramid of Bloom, on the way up: each texel of
+// uDestination adds the 3x3 tent filter of the level below it, already
+// upsampled, sampled bilinearly from uBloom. Level 0 ends up with the sum of
+// all levels, each blurred over twice the radius of the previous one.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uBloom;
+uniform int uSourceLevel;
+uniform ivec2 uSourceSize; // Of the region read, at the bottom left
+uniform ivec2 uDestinationSize;
+layout(r11f_g11f_b10f) uniform image2D uDestination;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, uDestinationSize))) {
+    return;
+  }
+  vec2 texelSize = 1.0 / vec2(textureSize(uBloom, uSourceLevel));
+  // In texels of the source level, within its region
+  vec2 center = (vec2(texel) + 0.5) * 0.5;
+  vec3 color = vec3(0);
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      vec2 position =
+          clamp(center + vec2(x, y), vec2(0.5), vec2(uSourceSize) - 0.5);
+      float weight = float((2 - abs(x)) * (2 - abs(y))) / 16.0;
+      color += weight * textureLod(uBloom, position * texelSize,
+                            float(uSourceLevel))
+                            .rgb;
+    }
+  }
+  vec3 destination = imageLoad(uDestination, texel).rgb;
+  imageStore(uDestination, texel, vec4(destination + color, 1));
+}
@@ -0,0 +1,63 @@
+#version 430
+
+// Scale and bias of F_0 in the integral of the specular BRDF of
+// pbr_directional_light.fs.glsl over the hemisphere (split sum
+// approximation), for NdotV along x and the roughness along y. Computed once
+// by EnvironmentMap.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rg16f) writeonly uniform image2D uDestination;
+uniform uint uSampleCount;
+
+const float M_PI = 3.141592653589793;
+
+vec2 hammersley(uint i, uint count)
+{
+  return vec2(
+      float(i) / float(count), float(bitfieldReverse(i)) * 2.3283064e-10);
+}
+
+// Half vector of the GGX lobe of alpha around +z, for the point xi of [0, 1]^2
+vec3 sampleGgx(vec2 xi, float alpha)
+{
+  float phi = 2 * M_PI * xi.x;
+  float cosTheta = sqrt((1 - xi.y) / (1 + (alpha * alpha - 1) * xi.y));
+  float sinTheta = sqrt(1 - cosTheta * cosTheta);
+  return vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+}
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(uDestination);
+  if (any(greaterThanEqual(texel, size))) {
+    return;
+  }
+  float NdotV = (float(texel.x) + 0.5) / float(size.x);
+  float roughness = (float(texel.y) + 0.5) / float(size.y);
+  float alpha = roughness * roughness;
+  float sqrAlpha = alpha * alpha;
+  vec3 V = vec3(sqrt(1 - NdotV * NdotV), 0, NdotV);
+  vec2 scaleBias = vec2(0);
+  for (uint i = 0; i < uSampleCount; ++i) {
+    vec3 H = sampleGgx(hammersley(i, uSampleCount), alpha);
+    float VdotH = max(dot(V, H), 0);
+    vec3 L = 2 * VdotH * H - V;
+    float NdotL = L.z;
+    float NdotH = H.z;
+    if (NdotL <= 0 || NdotH <= 0) {
+      continue;
+    }
+    // Same visibility term as the fragment shader, over the pdf of L
+    float visDenominator =
+        NdotL * sqrt(NdotV * NdotV * (1 - sqrAlpha) + sqrAlpha) +
+        NdotV * sqrt(NdotL * NdotL * (1 - sqrAlpha) + sqrAlpha);
+    float Vis = visDenominator > 0 ? 0.5 / visDenominator : 0;
+    float weight = Vis * 4 * NdotL * VdotH / NdotH;
+    float shlickFactor = pow(1 - VdotH, 5);
+    scaleBias += vec2(1 - shlickFactor, shlickFactor) * weight;
+  }
+  imageStore(uDestination, texel,
+      vec4(scaleBias / float(uSampleCount), 0, 0));
+}
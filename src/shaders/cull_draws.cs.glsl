@@ -0,0 +1,223 @@
+#version 430
+
+// Frustum culling of the draws of --multi-draw: copies the commands of all
+// draws into the indirect buffer, with instanceCount set to 0 for draws whose
+// bounding box is outside of the frustum.
+//
+// With uOcclusionCulling, draws whose box is behind the depth of the previous
+// frame are also culled: the box is projected with the matrices of that frame
+// and its nearest depth compared with the level of the depth pyramid
+// (DepthPyramid) where its screen rectangle only covers a few texels.
+//
+// With --meshlets, commands draw the meshlets of draws. With uMeshletCulling,
+// a meshlet is also culled if its bounding sphere is outside of the frustum,
+// or if its normal cone shows that it is back facing as a whole.
+//
+// Draws of nodes hidden in the GUI are always culled, their bit being clear
+// in DrawVisibility (see draw_visibility.hpp).
+
+layout(local_size_x = 64) in;
+
+// Same layout as DrawElementsIndirectCommand in render_queue.hpp
+struct DrawCommand
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance; // Index of the draw, in DrawBounds and Draws
+};
+
+// World space box of each draw, w unused
+struct Bounds
+{
+  vec4 bboxMin;
+  vec4 bboxMax;
+};
+
+layout(std430) readonly buffer DrawBounds
+{
+  Bounds bounds[];
+};
+
+layout(std430) readonly buffer AllCommands
+{
+  DrawCommand allCommands[];
+};
+
+layout(std430) writeonly buffer VisibleCommands
+{
+  DrawCommand visibleCommands[];
+};
+
+// Object space bounds of the meshlet of each command, see commandMeshlets in
+// ViewerApplication.cpp
+struct Meshlet
+{
+  vec4 sphere; // Center and radius, -1 for a whole primitive
+  vec4 cone; // Axis and sine of the half-angle, 1 if it cannot be culled
+};
+
+layout(std430) readonly buffer CommandMeshlets
+{
+  Meshlet meshlets[];
+};
+
+// Bit per draw, set if visible
+layout(std430) readonly buffer DrawVisibility
+{
+  uint visibleDraws[];
+};
+
+// Same layout as DrawData in ViewerApplication.hpp
+struct DrawData
+{
+  mat4 modelMatrix;
+  mat4 normalMatrix;
+  int materialIndex;
+  int firstJoint;
+  mat4 previousModelMatrix;
+};
+
+layout(std430) readonly buffer Draws
+{
+  DrawData draws[];
+};
+
+uniform uint uCommandCount;
+uniform vec4 uFrustumPlanes[6]; // Normals pointing inside
+uniform int uFrustumCulling;
+uniform int uOcclusionCulling;
+uniform mat4 uPreviousViewProjMatrix;
+uniform sampler2D uDepthPyramid;
+uniform int uMeshletCulling;
+uniform vec3 uCameraPosition; // World space
+
+bool isVisible(Bounds box)
+{
+  if (box.bboxMin.x > box.bboxMax.x) { // Empty box
+    return false;
+  }
+  for (int i = 0; i < 6; ++i) {
+    vec4 plane = uFrustumPlanes[i];
+    vec3 corner = mix(box.bboxMin.xyz, box.bboxMax.xyz,
+        greaterThanEqual(plane.xyz, vec3(0)));
+    if (dot(plane.xyz, corner) + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isOccluded(Bounds box)
+{
+  if (box.bboxMin.x > box.bboxMax.x) { // Empty box, nothing to draw
+    return true;
+  }
+  vec3 ndcMin = vec3(1);
+  vec3 ndcMax = vec3(-1);
+  for (int i = 0; i < 8; ++i) {
+    vec3 corner = mix(box.bboxMin.xyz, box.bboxMax.xyz,
+        bvec3((i & 1) != 0, (i & 2) != 0, (i & 4) != 0));
+    vec4 clip = uPreviousViewProjMatrix * vec4(corner, 1);
+    if (clip.w <= 0) { // Crosses the camera plane
+      return false;
+    }
+    ndcMin = min(ndcMin, clip.xyz / clip.w);
+    ndcMax = max(ndcMax, clip.xyz / clip.w);
+  }
+  if (any(lessThan(ndcMax.xy, vec2(-1))) ||
+      any(greaterThan(ndcMin.xy, vec2(1)))) {
+    return false; // Not on screen last frame, no depth to compare with
+  }
+
+  ivec2 size = textureSize(uDepthPyramid, 0);
+  ivec2 texelMin = ivec2(clamp(ndcMin.xy * 0.5 + 0.5, 0, 1) * vec2(size));
+  ivec2 texelMax = ivec2(clamp(ndcMax.xy * 0.5 + 0.5, 0, 1) * vec2(size));
+  ivec2 extent = texelMax - texelMin;
+  int level = 0;
+  while (max(extent.x >> level, extent.y >> level) > 1) {
+    ++level;
+  }
+  level = min(level, textureQueryLevels(uDepthPyramid) - 1);
+
+  // A texel of a level covers texels 2x and 2x + 1 of the level below, and
+  // the rest of the row or column for the last one
+  ivec2 levelSize = max(size >> level, ivec2(1));
+  texelMin = min(texelMin >> level, levelSize - 1);
+  texelMax = min(texelMax >> level, levelSize - 1);
+#ifdef REVERSED_Z
+  // --reversed-z: depths are normalized device coordinates, decreasing away
+  // from the camera
+  float farthestDepth = 1;
+  for (int y = texelMin.y; y <= texelMax.y; ++y) {
+    for (int x = texelMin.x; x <= texelMax.x; ++x) {
+      farthestDepth =
+          min(farthestDepth, texelFetch(uDepthPyramid, ivec2(x, y), level).r);
+    }
+  }
+  return ndcMax.z < farthestDepth - 1e-6;
+#else
+  float farthestDepth = 0;
+  for (int y = texelMin.y; y <= texelMax.y; ++y) {
+    for (int x = texelMin.x; x <= texelMax.x; ++x) {
+      farthestDepth =
+          max(farthestDepth, texelFetch(uDepthPyramid, ivec2(x, y), level).r);
+    }
+  }
+  // The depth of a flat box equals the depth of its own pixels up to
+  // rounding, do not let it hide itself
+  return ndcMin.z * 0.5 + 0.5 > farthestDepth + 1e-6;
+#endif
+}
+
+bool isMeshletVisible(Meshlet meshlet, DrawData draw)
+{
+  // Meshlets of skinned draws move with their joints, only the bounds of the
+  // whole draw are culled
+  if (meshlet.sphere.w < 0 || draw.firstJoint >= 0) {
+    return true;
+  }
+  mat4 modelMatrix = draw.modelMatrix;
+  vec3 scales = vec3(length(modelMatrix[0].xyz), length(modelMatrix[1].xyz),
+      length(modelMatrix[2].xyz));
+  float maxScale = max(scales.x, max(scales.y, scales.z));
+  vec3 center = vec3(modelMatrix * vec4(meshlet.sphere.xyz, 1));
+  float radius = meshlet.sphere.w * maxScale;
+  if (uFrustumCulling != 0) {
+    for (int i = 0; i < 6; ++i) {
+      if (dot(uFrustumPlanes[i].xyz, center) + uFrustumPlanes[i].w < -radius) {
+        return false;
+      }
+    }
+  }
+  // Angles between normals are only kept by uniform scales
+  float minScale = min(scales.x, min(scales.y, scales.z));
+  if (meshlet.cone.w < 1 && minScale > 0.999 * maxScale) {
+    vec3 axis = normalize(mat3(draw.normalMatrix) * meshlet.cone.xyz);
+    vec3 toCenter = center - uCameraPosition;
+    if (dot(toCenter, axis) >= meshlet.cone.w * length(toCenter) + radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void main()
+{
+  uint i = gl_GlobalInvocationID.x;
+  if (i >= uCommandCount) {
+    return;
+  }
+  DrawCommand command = allCommands[i];
+  Bounds box = bounds[command.baseInstance];
+  uint draw = command.baseInstance;
+  if ((visibleDraws[draw >> 5] & (1u << (draw & 31))) == 0 ||
+      (uFrustumCulling != 0 && !isVisible(box)) ||
+      (uOcclusionCulling != 0 && isOccluded(box)) ||
+      (uMeshletCulling != 0 &&
+          !isMeshletVisible(meshlets[i], draws[command.baseInstance]))) {
+    command.instanceCount = 0;
+  }
+  visibleCommands[i] = command;
+}
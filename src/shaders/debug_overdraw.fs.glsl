@@ -0,0 +1,28 @@
+#version 430
+
+// Overdraw debug view (see DebugViews), drawn over the viewport by
+// fullscreen_triangle.vs.glsl: the fragments shaded in each pixel, counted
+// by pbr_directional_light.fs.glsl, from blue for one to red for MAX_COUNT
+// and more. Pixels where nothing was shaded are black.
+
+// See DebugViews::OVERDRAW_IMAGE_UNIT
+layout(r32ui, binding = 7) readonly uniform uimage2D uOverdraw;
+
+const float MAX_COUNT = 16;
+
+layout(location = 0) out vec3 fColor;
+
+// Same as heatColor of pbr_directional_light.fs.glsl
+vec3 heatColor(float x)
+{
+  x = clamp(x, 0., 1.);
+  return clamp(vec3(2 * x - 1, 1 - abs(2 * x - 1), 1 - 2 * x), 0., 1.);
+}
+
+void main()
+{
+  uint count = imageLoad(uOverdraw, ivec2(gl_FragCoord.xy)).r;
+  fColor = count == 0u
+               ? vec3(0)
+               : heatColor(log2(float(count)) / log2(MAX_COUNT));
+}
@@ -0,0 +1,6 @@
+#version 430
+
+// Depth pre-pass of --depth-prepass: draws only write their depth, the
+// shading pass then runs the material shader once per pixel
+
+void main() {}
@@ -0,0 +1,53 @@
+#version 430
+
+// One level of the depth pyramid of DepthPyramid: each texel of uDestination
+// gets the farthest depth of the texels it covers in the level below, the
+// smallest one with REVERSED_Z (--reversed-z). When that level has an odd
+// size, the last texels also cover its last row or column so that no source
+// texel is left out.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform int uSourceLevel; // -1 to copy the depth texture into level 0
+uniform sampler2D uDepthTexture;
+layout(r32f) readonly uniform image2D uSource;
+layout(r32f) writeonly uniform image2D uDestination;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 destinationSize = imageSize(uDestination);
+  if (any(greaterThanEqual(texel, destinationSize))) {
+    return;
+  }
+  if (uSourceLevel < 0) {
+    imageStore(uDestination, texel, texelFetch(uDepthTexture, texel, 0));
+    return;
+  }
+
+  ivec2 sourceSize = imageSize(uSource);
+  ivec2 first = 2 * texel;
+  ivec2 last = min(first + 1, sourceSize - 1);
+  if (texel.x == destinationSize.x - 1) {
+    last.x = sourceSize.x - 1;
+  }
+  if (texel.y == destinationSize.y - 1) {
+    last.y = sourceSize.y - 1;
+  }
+#ifdef REVERSED_Z
+  float depth = 1;
+  for (int y = first.y; y <= last.y; ++y) {
+    for (int x = first.x; x <= last.x; ++x) {
+      depth = min(depth, imageLoad(uSource, ivec2(x, y)).r);
+    }
+  }
+#else
+  float depth = 0;
+  for (int y = first.y; y <= last.y; ++y) {
+    for (int x = first.x; x <= last.x; ++x) {
+      depth = max(depth, imageLoad(uSource, ivec2(x, y)).r);
+    }
+  }
+#endif
+  imageStore(uDestination, texel, vec4(depth));
+}
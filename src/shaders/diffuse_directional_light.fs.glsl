@@ -4,12 +4,48 @@ in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
 in vec2 vTexCoords;
 
-uniform vec3 uLightDirection;
-uniform vec3 uLightIntensity;
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec3 uLightDirection; // View space
+    vec3 uLightIntensity;
+    int uApplyOcclusion;
+    int uEncodeOutput; // Else the framebuffer encodes to sRGB
+    mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+    mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
 
-out vec3 fColor;
+layout(location = 0) out vec3 fColor;
+#ifdef DRAW_IDS
+flat in uint vDrawId; // See forward.vs.glsl
+layout(location = 1) out uint fDrawId;
+#endif
+#ifdef MOTION_VECTORS
+in vec4 vMovedPosition; // See forward.vs.glsl
+in vec4 vPreviousPosition;
+// Texture coordinates of the fragment minus those it would have had without
+// the motion of its draw, in the previous view (see TemporalAntiAliasing)
+layout(location = 1) out vec2 fMotion;
+#endif
+#ifdef AOVS
+// With --output-aovs, view space normal and distance along the view axis of
+// the fragment (see AsyncImageRenderer)
+layout(location = 2) out vec4 fGeometry;
+#endif
 
 void main(){
     vec3 viewSpaceNormal = normalize(vViewSpaceNormal);
     fColor = (1./3.14) * uLightIntensity * dot(viewSpaceNormal, uLightDirection);
+#ifdef DRAW_IDS
+    fDrawId = vDrawId;
+#endif
+#ifdef MOTION_VECTORS
+    fMotion = 0.5 * (vMovedPosition.xy / vMovedPosition.w -
+                     vPreviousPosition.xy / vPreviousPosition.w);
+#endif
+#ifdef AOVS
+    fGeometry = vec4(normalize(vViewSpaceNormal), -vViewSpacePosition.z);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#version 430
+
+// One level of the prefiltered environment of EnvironmentMap: each texel of
+// uDestination, an equirectangular map like uEnvironment, gets the radiance
+// reflected around its direction by a GGX lobe of roughness uRoughness, with
+// the view along the normal (split sum approximation). Samples are
+// distributed by importance and read from the level of uEnvironment whose
+// texels cover their share of the lobe, so that few of them are needed.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D uEnvironment;
+layout(rgba16f) writeonly uniform image2D uDestination;
+uniform float uRoughness;
+uniform uint uSampleCount;
+
+const float M_PI = 3.141592653589793;
+
+// Equirectangular mapping: +y at the top, longitude from +x towards +z
+vec3 getDirection(vec2 texCoords)
+{
+  float theta = texCoords.y * M_PI;
+  float phi = (texCoords.x - 0.5) * 2 * M_PI;
+  return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
+vec2 getTexCoords(vec3 direction)
+{
+  return vec2(atan(direction.z, direction.x) / (2 * M_PI) + 0.5,
+      acos(clamp(direction.y, -1, 1)) / M_PI);
+}
+
+vec2 hammersley(uint i, uint count)
+{
+  return vec2(
+      float(i) / float(count), float(bitfieldReverse(i)) * 2.3283064e-10);
+}
+
+// Half vector of the GGX lobe of alpha around N, for the point xi of [0, 1]^2
+vec3 sampleGgx(vec2 xi, float alpha, vec3 N)
+{
+  float phi = 2 * M_PI * xi.x;
+  float cosTheta = sqrt((1 - xi.y) / (1 + (alpha * alpha - 1) * xi.y));
+  float sinTheta = sqrt(1 - cosTheta * cosTheta);
+  vec3 up = abs(N.y) < 0.999 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+  vec3 tangent = normalize(cross(up, N));
+  vec3 bitangent = cross(N, tangent);
+  return normalize(tangent * (sinTheta * cos(phi)) +
+                   bitangent * (sinTheta * sin(phi)) + N * cosTheta);
+}
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(uDestination);
+  if (any(greaterThanEqual(texel, size))) {
+    return;
+  }
+  vec2 texCoords = (vec2(texel) + 0.5) / vec2(size);
+  ivec2 environmentSize = textureSize(uEnvironment, 0);
+  if (uRoughness == 0) {
+    // Mirror reflection, filtered to the size of the destination
+    float lod = max(log2(float(environmentSize.x) / float(size.x)), 0);
+    imageStore(uDestination, texel, textureLod(uEnvironment, texCoords, lod));
+    return;
+  }
+
+  vec3 N = getDirection(texCoords);
+  float alpha = uRoughness * uRoughness;
+  float sqrAlpha = alpha * alpha;
+  float texelSolidAngle =
+      4 * M_PI / float(environmentSize.x * environmentSize.y);
+  vec3 radiance = vec3(0);
+  float weight = 0;
+  for (uint i = 0; i < uSampleCount; ++i) {
+    vec3 H = sampleGgx(hammersley(i, uSampleCount), alpha, N);
+    float NdotH = max(dot(N, H), 0);
+    vec3 L = 2 * NdotH * H - N;
+    float NdotL = dot(N, L);
+    if (NdotL <= 0) {
+      continue;
+    }
+    // With V = N, the pdf of L is D / 4
+    float baseDenomD = NdotH * NdotH * (sqrAlpha - 1) + 1;
+    float D = sqrAlpha / (M_PI * baseDenomD * baseDenomD);
+    float sampleSolidAngle = 4 / (float(uSampleCount) * D + 1e-6);
+    float lod = max(0.5 * log2(sampleSolidAngle / texelSolidAngle) + 1, 0);
+    radiance += textureLod(uEnvironment, getTexCoords(L), lod).rgb * NdotL;
+    weight += NdotL;
+  }
+  imageStore(uDestination, texel, vec4(radiance / max(weight, 1e-6), 1));
+}
@@ -0,0 +1,67 @@
+#version 430
+
+// Irradiance of the environment of EnvironmentMap as 9 spherical harmonics
+// coefficients (3 bands). A single work group projects the radiance of the
+// texels of level uLevel of uEnvironment, weighted by their solid angle,
+// then convolves it with the cosine lobe: the irradiance of a normal n is the
+// sum of the coefficients times the basis functions of n.
+
+layout(local_size_x = 64) in;
+
+uniform sampler2D uEnvironment;
+uniform int uLevel;
+
+layout(std430) writeonly buffer IrradianceSH
+{
+  vec4 coefficients[9];
+};
+
+shared vec3 partialSums[64][9];
+
+const float M_PI = 3.141592653589793;
+
+void main()
+{
+  ivec2 size = textureSize(uEnvironment, uLevel);
+  uint invocation = gl_LocalInvocationID.x;
+  vec3 sums[9];
+  for (int k = 0; k < 9; ++k) {
+    sums[k] = vec3(0);
+  }
+  for (int i = int(invocation); i < size.x * size.y; i += 64) {
+    ivec2 texel = ivec2(i % size.x, i / size.x);
+    vec2 texCoords = (vec2(texel) + 0.5) / vec2(size);
+    float theta = texCoords.y * M_PI;
+    float phi = (texCoords.x - 0.5) * 2 * M_PI;
+    vec3 d = vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+    float solidAngle =
+        (2 * M_PI / float(size.x)) * (M_PI / float(size.y)) * sin(theta);
+    vec3 radiance = texelFetch(uEnvironment, texel, uLevel).rgb * solidAngle;
+    sums[0] += radiance * 0.282095;
+    sums[1] += radiance * 0.488603 * d.y;
+    sums[2] += radiance * 0.488603 * d.z;
+    sums[3] += radiance * 0.488603 * d.x;
+    sums[4] += radiance * 1.092548 * d.x * d.y;
+    sums[5] += radiance * 1.092548 * d.y * d.z;
+    sums[6] += radiance * 0.315392 * (3 * d.z * d.z - 1);
+    sums[7] += radiance * 1.092548 * d.x * d.z;
+    sums[8] += radiance * 0.546274 * (d.x * d.x - d.y * d.y);
+  }
+  for (int k = 0; k < 9; ++k) {
+    partialSums[invocation][k] = sums[k];
+  }
+  barrier();
+  if (invocation != 0) {
+    return;
+  }
+  // Convolution with the clamped cosine, per band
+  const float bandFactors[3] = float[3](M_PI, 2 * M_PI / 3, M_PI / 4);
+  for (int k = 0; k < 9; ++k) {
+    vec3 total = vec3(0);
+    for (int i = 0; i < 64; ++i) {
+      total += partialSums[i][k];
+    }
+    int band = k == 0 ? 0 : (k < 4 ? 1 : 2);
+    coefficients[k] = vec4(total * bandFactors[band], 0);
+  }
+}
@@ -1,21 +1,168 @@
-#version 330
+#version 430
+#ifdef MULTIVIEW
+#extension GL_OVR_multiview2 : require
+#endif
 
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
+layout(location = 3) in uint aDrawIndex; // Only with uUseDrawTable
+#ifdef SKINNING
+layout(location = 4) in vec4 aJoints; // Integers, in the skin of the draw
+layout(location = 5) in vec4 aWeights;
+#endif
+// Handedness of the bitangent in w, zero for primitives without tangents
+layout(location = 6) in vec4 aTangent;
 
 out vec3 vViewSpacePosition;
 out vec3 vViewSpaceNormal;
+out vec4 vViewSpaceTangent;
 out vec2 vTexCoords;
+flat out int vMaterialIndex; // -1 if given by uMaterialIndex
+#if defined(DRAW_IDS) || defined(DEBUG_VIEWS)
+// With --gpu-picking, 1 + the index of the draw in drawCommands, written in
+// the draw IDs of the framebuffer (0 where nothing is drawn). Also read by
+// the debug views of the GUI.
+flat out uint vDrawId;
+#endif
+#ifdef MOTION_VECTORS
+// With --taa, the vertex through the previous view, moved by the current and
+// by the previous model matrix: the motion of the draw itself, that of the
+// camera being reprojected from depths
+out vec4 vMovedPosition;
+out vec4 vPreviousPosition;
+#endif
 
-uniform mat4 uModelViewProjMatrix;
-uniform mat4 uModelViewMatrix;
-uniform mat4 uNormalMatrix;
+#ifdef MULTIVIEW
+// With --stereo, the left and right eyes are drawn at once in the layers of
+// StereoFramebuffer, by uEyeProjMatrices. Everything else stays in the view
+// space of the camera between them.
+layout(num_views = 2) in;
+#endif
+
+// The depth pre-pass (compiled with DEPTH_ONLY, reading positions only) and
+// the shading pass compute the same depths, tested for equality
+invariant gl_Position;
+
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec3 uLightDirection; // View space
+    vec3 uLightIntensity;
+    int uApplyOcclusion;
+    int uEncodeOutput; // Else the framebuffer encodes to sRGB
+    mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+    mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
+
+// Matrices of draws not reading the Draws table, see DrawUniforms in
+// ViewerApplication.hpp
+layout(std140) uniform DrawUniforms
+{
+    mat4 uModelMatrix;
+    mat4 uNormalMatrix; // Model space, transpose(inverse(uModelMatrix))
+    int uFirstJoint; // In jointMatrices, -1 if not skinned
+    mat4 uPreviousModelMatrix; // Of the previous frame, for MOTION_VECTORS
+};
+
+// Uniforms set by the draw loop have the same location in all the programs
+// using this shader (see --material-variants). Dequantization of the
+// positions of the primitive, normalized in its bounds with
+// --quantize-vertices:
+layout(location = 1) uniform vec3 uPositionOffset = vec3(0);
+layout(location = 2) uniform vec3 uPositionScale = vec3(1);
+
+// With uUseDrawTable, the matrices and material of draws come from this table
+// instead of DrawUniforms and uMaterialIndex (instanced draws and
+// --multi-draw), see DrawData in ViewerApplication.hpp
+struct DrawData
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    int materialIndex;
+    int firstJoint;
+    mat4 previousModelMatrix;
+};
+
+layout(std430) readonly buffer Draws
+{
+    DrawData draws[];
+};
+
+layout(location = 3) uniform int uUseDrawTable;
+#if defined(DRAW_IDS) || defined(DEBUG_VIEWS)
+layout(location = 4) uniform uint uDrawId; // Without uUseDrawTable
+#endif
+
+#ifdef SKINNING
+// Of all the skins of the model, those of a skinned draw start at its first
+// joint, see JointPalette. They take vertices to world space, the matrix of
+// the node drawing the mesh is not applied.
+layout(std430) readonly buffer Joints
+{
+    mat4 jointMatrices[];
+};
+#endif
 
 void main()
 {
-    vViewSpacePosition = vec3(uModelViewMatrix * vec4(aPosition, 1));
-	vViewSpaceNormal = normalize(vec3(uNormalMatrix * vec4(aNormal, 0)));
+    mat4 modelMatrix = uModelMatrix;
+    mat4 normalMatrix = uNormalMatrix;
+    mat4 previousModelMatrix = uPreviousModelMatrix;
+    vMaterialIndex = -1;
+    if (uUseDrawTable != 0) {
+        modelMatrix = draws[aDrawIndex].modelMatrix;
+        normalMatrix = draws[aDrawIndex].normalMatrix;
+        previousModelMatrix = draws[aDrawIndex].previousModelMatrix;
+        vMaterialIndex = draws[aDrawIndex].materialIndex;
+    }
+#if defined(DRAW_IDS) || defined(DEBUG_VIEWS)
+    vDrawId = uUseDrawTable != 0 ? aDrawIndex + 1u : uDrawId;
+#endif
+#ifdef SKINNING
+    int firstJoint =
+        uUseDrawTable != 0 ? draws[aDrawIndex].firstJoint : uFirstJoint;
+    if (firstJoint >= 0) {
+        ivec4 joints = firstJoint + ivec4(aJoints);
+        modelMatrix = aWeights.x * jointMatrices[joints.x] +
+                      aWeights.y * jointMatrices[joints.y] +
+                      aWeights.z * jointMatrices[joints.z] +
+                      aWeights.w * jointMatrices[joints.w];
+        // Cofactors, transpose(inverse()) up to the determinant, whose sign
+        // is kept for normals to face outside
+        mat3 m = mat3(modelMatrix);
+        float orientation = sign(dot(m[0], cross(m[1], m[2])));
+        normalMatrix = mat4(orientation * mat3(cross(m[1], m[2]),
+            cross(m[2], m[0]), cross(m[0], m[1])));
+        // Joints of the previous frame are not kept
+        previousModelMatrix = modelMatrix;
+    }
+#endif
+
+    vec3 position = uPositionOffset + uPositionScale * aPosition;
+    vec4 viewSpacePosition = uViewMatrix * (modelMatrix * vec4(position, 1));
+    vViewSpacePosition = vec3(viewSpacePosition);
+#ifndef DEPTH_ONLY
+    // The view matrix is rigid, its rotation also transforms normals
+	vViewSpaceNormal = normalize(mat3(uViewMatrix) * vec3(normalMatrix * vec4(aNormal, 0)));
+    // Tangents follow the surface, mirroring matrices flip the bitangent
+    mat3 tangentMatrix = mat3(modelMatrix);
+    float orientation =
+        sign(dot(tangentMatrix[0], cross(tangentMatrix[1], tangentMatrix[2])));
+    vViewSpaceTangent = vec4(mat3(uViewMatrix) * (tangentMatrix * aTangent.xyz),
+        aTangent.w * orientation);
 	vTexCoords = aTexCoords;
-    gl_Position =  uModelViewProjMatrix * vec4(aPosition, 1);
-}
\ No newline at end of file
+#endif
+#ifdef MOTION_VECTORS
+    vMovedPosition = uPreviousViewProjMatrix * (modelMatrix * vec4(position, 1));
+    vPreviousPosition =
+        uPreviousViewProjMatrix * (previousModelMatrix * vec4(position, 1));
+#endif
+#ifdef MULTIVIEW
+    gl_Position = uEyeProjMatrices[gl_ViewID_OVR] * viewSpacePosition;
+#else
+    gl_Position =  uProjMatrix * viewSpacePosition;
+#endif
+}
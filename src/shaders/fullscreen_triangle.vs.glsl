@@ -0,0 +1,10 @@
+#version 430
+
+// Triangle covering the viewport, drawn without vertex attributes by the
+// lighting pass of --deferred-shading
+
+void main()
+{
+  vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2 - 1;
+  gl_Position = vec4(position, 0, 1);
+}
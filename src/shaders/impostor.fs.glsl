@@ -0,0 +1,44 @@
+#version 430
+
+// Frames of --impostors, see impostor.vs.glsl
+
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec3 uLightDirection; // View space
+    vec3 uLightIntensity;
+    int uApplyOcclusion;
+    int uEncodeOutput; // Else the framebuffer encodes to sRGB
+    mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+    mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
+
+// sRGB encoded colors, multiplied by their coverage in alpha
+uniform sampler2DArray uAtlas;
+
+in vec3 vTexCoords;
+#ifdef DRAW_IDS
+flat in uint vDrawId;
+#endif
+
+layout(location = 0) out vec3 fColor;
+#ifdef DRAW_IDS
+layout(location = 1) out uint fDrawId;
+#endif
+
+const float GAMMA = 2.2;
+
+void main()
+{
+    vec4 texel = texture(uAtlas, vTexCoords);
+    if (texel.a < 0.5) {
+        discard;
+    }
+    vec3 color = texel.rgb / texel.a;
+    fColor = uEncodeOutput != 0 ? color : pow(color, vec3(GAMMA));
+#ifdef DRAW_IDS
+    fDrawId = vDrawId;
+#endif
+}
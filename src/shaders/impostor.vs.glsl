@@ -0,0 +1,97 @@
+#version 430
+
+// Quads of the instances of --impostors, drawn without vertex attributes: 4
+// vertices of a triangle strip per instance. Each shows the frame of the
+// layer of its mesh nearest to the direction the camera sees it from, see
+// Impostors in impostors.hpp.
+
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec3 uLightDirection; // View space
+    vec3 uLightIntensity;
+    int uApplyOcclusion;
+    int uEncodeOutput; // Else the framebuffer encodes to sRGB
+    mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+    mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
+
+// Same layout as Impostors::Instance
+struct Instance
+{
+    mat4 modelMatrix;
+    vec4 sphere; // Local center and radius of the mesh
+    int layer;
+    uint drawId;
+};
+
+layout(std430) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+// Frames per side of a layer, Impostors::FRAME_GRID
+const int FRAME_GRID = 8;
+
+out vec3 vTexCoords; // Layer in z
+#ifdef DRAW_IDS
+flat out uint vDrawId;
+#endif
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+
+// Octahedral map of directions on [0, 1]^2, +y at its center, the lower
+// hemisphere folded on the corners
+vec2 encodeDirection(vec3 direction)
+{
+    vec3 p = direction / (abs(direction.x) + abs(direction.y) +
+                          abs(direction.z));
+    vec2 uv = p.y >= 0 ? p.xz : (1 - abs(p.zx)) * signNotZero(p.xz);
+    return 0.5 * uv + 0.5;
+}
+
+// Same as Impostors::getFrameDirection
+vec3 decodeDirection(vec2 uv)
+{
+    vec2 p = 2 * uv - 1;
+    float height = 1 - abs(p.x) - abs(p.y);
+    if (height < 0) {
+        p = (1 - abs(p.yx)) * signNotZero(p);
+    }
+    return normalize(vec3(p.x, height, p.y));
+}
+
+void main()
+{
+    Instance instance = instances[gl_InstanceID];
+    vec3 center = instance.sphere.xyz;
+    float radius = instance.sphere.w;
+    // The rotation of the view matrix is orthonormal
+    vec3 eye = -(transpose(mat3(uViewMatrix)) * uViewMatrix[3].xyz);
+    vec3 localEye = vec3(inverse(instance.modelMatrix) * vec4(eye, 1));
+    ivec2 frame = clamp(
+        ivec2(encodeDirection(normalize(localEye - center)) * FRAME_GRID),
+        ivec2(0), ivec2(FRAME_GRID - 1));
+    vec3 direction = decodeDirection((vec2(frame) + 0.5) / FRAME_GRID);
+
+    // Axes of the image of the frame, those of the glm::lookAt of
+    // Impostors::getFrameViewMatrix
+    vec3 up = abs(direction.y) > 0.99 ? vec3(0, 0, 1) : vec3(0, 1, 0);
+    vec3 right = normalize(cross(-direction, up));
+    up = cross(right, -direction);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec2 offset = radius * (2 * corner - 1);
+    vec3 position = center + offset.x * right + offset.y * up;
+
+    vTexCoords = vec3((vec2(frame) + corner) / FRAME_GRID, instance.layer);
+#ifdef DRAW_IDS
+    vDrawId = instance.drawId;
+#endif
+    gl_Position =
+        uProjMatrix * uViewMatrix * (instance.modelMatrix * vec4(position, 1));
+}
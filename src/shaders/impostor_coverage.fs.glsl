@@ -0,0 +1,8 @@
+#version 430
+
+// Coverage of the frames of --impostors, written in alpha where the color
+// pass wrote its depth
+
+layout(location = 0) out vec4 fCoverage;
+
+void main() { fCoverage = vec4(1); }
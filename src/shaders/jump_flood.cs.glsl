@@ -0,0 +1,41 @@
+#version 430
+
+// One pass of the jump flood of SelectionOutline: each pixel keeps the
+// nearest of the seeds found by itself and by the 8 pixels uStep away. With
+// steps halving down to 1, every pixel ends with its nearest seed within
+// twice the first step, or close to it.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(rg16i, binding = 0) readonly uniform iimage2D uSeeds;
+layout(rg16i, binding = 1) writeonly uniform iimage2D uNextSeeds;
+
+uniform ivec2 uSize;
+uniform int uStep;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, uSize))) {
+    return;
+  }
+  ivec2 nearest = ivec2(-1);
+  int nearestDistance = 0x7fffffff; // Squared, in pixels
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      ivec2 neighbor = texel + uStep * ivec2(x, y);
+      if (any(lessThan(neighbor, ivec2(0))) ||
+          any(greaterThanEqual(neighbor, uSize))) {
+        continue;
+      }
+      ivec2 seed = imageLoad(uSeeds, neighbor).xy;
+      ivec2 offset = seed - texel;
+      int distance = offset.x * offset.x + offset.y * offset.y;
+      if (seed.x >= 0 && distance < nearestDistance) {
+        nearest = seed;
+        nearestDistance = distance;
+      }
+    }
+  }
+  imageStore(uNextSeeds, texel, ivec4(nearest, 0, 0));
+}
@@ -0,0 +1,98 @@
+#version 430
+
+// Binning of the KHR_lights_punctual lights of --punctual-lights in the
+// clusters of the view frustum (see LightClusters): a grid of tiles of the
+// screen, split along the view depth in slices of exponential thickness.
+// One invocation per cluster tests the bounding sphere of each point and spot
+// light against the view space box of its cluster, and lists the lights that
+// reach it. Lights are loaded in shared memory one batch per work group at a
+// time.
+
+layout(local_size_x = 64) in;
+
+// Same layout as LightClusters::Light, in view space
+struct Light
+{
+  vec4 positionRange; // Range is where the light fades out
+  vec4 directionType; // Direction the light points to, type in w
+  vec4 color; // Times the intensity
+  vec4 spot; // Angle scale and offset in xy
+};
+
+layout(std430) readonly buffer Lights
+{
+  uvec4 lightCounts; // All lights, then directional ones, first
+  Light lights[];
+};
+
+// Same layout as LightClusters::GridHeader, then of each cluster the count
+// of its lights followed by their indices
+layout(std430) buffer LightClusters
+{
+  uvec4 gridSize; // Clusters along x, y, z, lights per cluster in w
+  vec4 gridScales; // See the fragment shader
+  uint clusterLights[];
+};
+
+uniform mat4 uInverseProjMatrix;
+uniform float uNear;
+uniform float uFar;
+
+shared vec4 batchSpheres[64];
+
+// Point of view depth that projects at ndc
+vec3 unproject(vec2 ndc, float depth)
+{
+  vec4 point = uInverseProjMatrix * vec4(ndc, -1, 1);
+  vec3 ray = point.xyz / point.w;
+  return ray * (depth / -ray.z);
+}
+
+void main()
+{
+  uint cluster = gl_GlobalInvocationID.x;
+  uint clusterCount = gridSize.x * gridSize.y * gridSize.z;
+  uvec3 coords = uvec3(cluster % gridSize.x,
+      (cluster / gridSize.x) % gridSize.y, cluster / (gridSize.x * gridSize.y));
+
+  // View space box of the cluster, from the corners of its tile at the
+  // depths of its slice
+  vec2 ndcMin = vec2(coords.xy) / vec2(gridSize.xy) * 2 - 1;
+  vec2 ndcMax = vec2(coords.xy + 1) / vec2(gridSize.xy) * 2 - 1;
+  float ratio = uFar / uNear;
+  float nearDepth = uNear * pow(ratio, float(coords.z) / float(gridSize.z));
+  float farDepth = uNear * pow(ratio, float(coords.z + 1) / float(gridSize.z));
+  vec3 boxMin = vec3(1e30);
+  vec3 boxMax = vec3(-1e30);
+  for (int corner = 0; corner < 8; ++corner) {
+    vec2 ndc = vec2((corner & 1) != 0 ? ndcMax.x : ndcMin.x,
+        (corner & 2) != 0 ? ndcMax.y : ndcMin.y);
+    vec3 point = unproject(ndc, (corner & 4) != 0 ? farDepth : nearDepth);
+    boxMin = min(boxMin, point);
+    boxMax = max(boxMax, point);
+  }
+
+  uint first = cluster * (gridSize.w + 1);
+  uint count = 0;
+  for (uint batch = lightCounts.y; batch < lightCounts.x; batch += 64) {
+    uint light = batch + gl_LocalInvocationID.x;
+    batchSpheres[gl_LocalInvocationID.x] = light < lightCounts.x
+                                               ? lights[light].positionRange
+                                               : vec4(0, 0, 0, -1);
+    barrier();
+    uint batchCount = min(lightCounts.x - batch, 64u);
+    for (uint i = 0; i < batchCount && cluster < clusterCount; ++i) {
+      vec4 sphere = batchSpheres[i];
+      vec3 offset = max(max(boxMin - sphere.xyz, sphere.xyz - boxMax), 0);
+      if (dot(offset, offset) <= sphere.w * sphere.w &&
+          count < gridSize.w) {
+        clusterLights[first + 1 + count] = batch + i;
+        ++count;
+      }
+    }
+    barrier();
+  }
+  if (cluster < clusterCount) {
+    clusterLights[first] = count;
+  }
+}
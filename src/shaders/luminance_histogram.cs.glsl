@@ -0,0 +1,55 @@
+#version 430
+
+// Histogram of the log2 luminance of the pixels of the scene drawn for --hdr
+// (see ToneMapping), reduced to an exposure by adapt_exposure.cs.glsl. Each
+// workgroup counts its pixels in shared memory, then adds its non-empty bins
+// to those of Exposure with atomics.
+//
+// Bin 0 holds the pixels darker than MIN_LOG_LUMINANCE, such as the
+// background, left out of the average; the others split the range of
+// LOG_LUMINANCE_RANGE evenly, the brightest pixels being clamped to the last.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+const uint BIN_COUNT = 256;
+const float MIN_LOG_LUMINANCE = -10.0;
+const float LOG_LUMINANCE_RANGE = 16.0;
+
+layout(std430) buffer Exposure
+{
+  float exposure;
+  uint bins[BIN_COUNT];
+};
+
+uniform sampler2D uColor;
+uniform ivec2 uViewportSize;
+
+shared uint sBins[BIN_COUNT];
+
+uint getBin(vec3 color)
+{
+  float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+  float logLuminance = log2(max(luminance, 1e-8));
+  if (logLuminance < MIN_LOG_LUMINANCE) {
+    return 0u;
+  }
+  float t = (logLuminance - MIN_LOG_LUMINANCE) / LOG_LUMINANCE_RANGE;
+  return 1u + uint(clamp(t, 0.0, 1.0) * float(BIN_COUNT - 2u));
+}
+
+void main()
+{
+  uint thread = gl_LocalInvocationIndex;
+  sBins[thread] = 0u;
+  barrier();
+
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (all(lessThan(texel, uViewportSize))) {
+    atomicAdd(sBins[getBin(texelFetch(uColor, texel, 0).rgb)], 1u);
+  }
+  barrier();
+
+  if (sBins[thread] != 0u) {
+    atomicAdd(bins[thread], sBins[thread]);
+  }
+}
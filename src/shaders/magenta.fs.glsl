@@ -4,11 +4,37 @@ in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
 in vec2 vTexCoords;
 
-out vec3 fColor;
+layout(location = 0) out vec3 fColor;
+#ifdef DRAW_IDS
+flat in uint vDrawId; // See forward.vs.glsl
+layout(location = 1) out uint fDrawId;
+#endif
+#ifdef MOTION_VECTORS
+in vec4 vMovedPosition; // See forward.vs.glsl
+in vec4 vPreviousPosition;
+// Texture coordinates of the fragment minus those it would have had without
+// the motion of its draw, in the previous view (see TemporalAntiAliasing)
+layout(location = 1) out vec2 fMotion;
+#endif
+#ifdef AOVS
+// With --output-aovs, view space normal and distance along the view axis of
+// the fragment (see AsyncImageRenderer)
+layout(location = 2) out vec4 fGeometry;
+#endif
 
 void main()
 {
    // Need another normalization because interpolation of vertex attributes does not maintain unit length
    vec3 viewSpaceNormal = normalize(vViewSpaceNormal);
    fColor = vec3(1, 0, 1);
+#ifdef DRAW_IDS
+   fDrawId = vDrawId;
+#endif
+#ifdef MOTION_VECTORS
+   fMotion = 0.5 * (vMovedPosition.xy / vMovedPosition.w -
+                    vPreviousPosition.xy / vPreviousPosition.w);
+#endif
+#ifdef AOVS
+   fGeometry = vec4(normalize(vViewSpaceNormal), -vViewSpacePosition.z);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,33 @@
+#version 430
+
+// The 12 triangles of a world space box, drawn without vertex attributes in
+// the occlusion queries of --conditional-render
+
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+    mat4 uViewMatrix;
+    mat4 uProjMatrix;
+    vec3 uLightDirection; // View space
+    vec3 uLightIntensity;
+    int uApplyOcclusion;
+    int uEncodeOutput; // Else the framebuffer encodes to sRGB
+    mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+    mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
+
+uniform vec3 uBoxMin;
+uniform vec3 uBoxMax;
+
+// Corners of the two triangles of each face, bit i selecting the max of axis
+// i
+const int CORNERS[36] = int[36](0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6, 0, 1, 5,
+    0, 5, 4, 2, 6, 7, 2, 7, 3, 0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5);
+
+void main()
+{
+  int corner = CORNERS[gl_VertexID];
+  vec3 position = mix(uBoxMin, uBoxMax,
+      vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1));
+  gl_Position = uProjMatrix * uViewMatrix * vec4(position, 1);
+}
@@ -0,0 +1,443 @@
+#version 430
+#extension GL_ARB_bindless_texture : enable
+
+// One sample per pixel of the reference of PathTracer (--path-trace), added
+// to the running average of uAverage: a path from the camera through the
+// world space triangles of the scene, found by traversing their BVH in the
+// PathTraceNodes buffer. Surfaces are shaded with the metallic-roughness
+// model of pbr_directional_light.fs.glsl: the directional light is sampled
+// at each hit with a shadow ray, and the path goes on along the diffuse or
+// the GGX lobe of the material. Paths leaving the scene see the environment
+// with IMAGE_BASED_LIGHTING, nothing otherwise. Surfaces are opaque, alpha
+// modes and transmission are ignored.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+#ifndef HARDWARE_SRGB
+#define HARDWARE_SRGB 0
+#endif
+
+// Same layout as PathTracer::Node
+struct Node
+{
+  vec3 boundsMin;
+  int first; // Of the children of inner nodes, of the triangles of leaves
+  vec3 boundsMax;
+  int triangleCount; // 0 for inner nodes
+};
+
+layout(std430) readonly buffer PathTraceNodes
+{
+  Node nodes[];
+};
+
+// Same layout as PathTracer::Triangle
+struct Triangle
+{
+  vec4 positions[3]; // World space
+  vec4 normals[3]; // World space, zero without NORMAL
+  vec2 texCoords[3];
+  int material; // In the Materials table
+  float padding;
+};
+
+layout(std430) readonly buffer PathTraceTriangles
+{
+  Triangle triangles[];
+};
+
+// Same layout as MaterialData in ViewerApplication.hpp
+struct Material
+{
+  vec4 baseColorFactor;
+  vec3 emissiveFactor;
+  float metallicFactor;
+  float roughnessFactor;
+  float occlusionStrength;
+  // Bindless handles when uBindlessTextures is set
+  uvec2 baseColorTexture;
+  uvec2 metallicRoughnessTexture;
+  uvec2 emissiveTexture;
+  uvec2 occlusionTexture;
+  uvec2 normalTexture;
+  float alphaCutoff;
+  float normalScale;
+  mat3x2 uvTransforms[5];
+  float transmissionFactor;
+};
+
+layout(std430) readonly buffer Materials
+{
+  Material materials[];
+};
+
+#ifdef IMAGE_BASED_LIGHTING
+layout(std140) uniform EnvironmentUniforms
+{
+  mat4 uWorldFromViewMatrix;
+  vec4 uIrradianceSH[9];
+  float uEnvironmentIntensity;
+  float uPrefilteredMaxLevel;
+};
+
+// Equirectangular, its level 0 is the environment itself
+uniform sampler2D uPrefilteredEnvironment;
+#endif
+
+layout(rgba32f, binding = 0) uniform image2D uAverage;
+
+uniform mat4 uProjMatrix; // With the tile or jitter matrix of the view
+uniform mat4 uCameraMatrix; // World space from view space
+uniform vec3 uLightDirection; // World space, towards the light
+uniform vec3 uLightIntensity;
+uniform int uBindlessTextures;
+uniform uint uSampleIndex;
+uniform float uWeight; // Of the sample in the average
+uniform int uMaxBounces;
+
+const float M_PI = 3.141592653589793;
+const float M_1_PI = 1.0 / M_PI;
+const float GAMMA = 2.2;
+const float NO_HIT = 1e30;
+// Nodes waiting to be visited, deeper trees are cut
+const int STACK_SIZE = 64;
+// Smallest alpha of the GGX lobe sampled, roughness 0 being a mirror
+const float MIN_ALPHA = 2e-3;
+
+vec4 SRGBtoLINEAR(vec4 srgbIn)
+{
+#if HARDWARE_SRGB
+  return srgbIn;
+#else
+  return vec4(pow(srgbIn.xyz, vec3(GAMMA)), srgbIn.w);
+#endif
+}
+
+// PCG hash, each call moves the state of the path of the invocation
+uint randomState;
+
+float random()
+{
+  randomState = randomState * 747796405u + 2891336453u;
+  uint word =
+      ((randomState >> ((randomState >> 28u) + 4u)) ^ randomState) *
+      277803737u;
+  return float((word >> 22u) ^ word) * (1.0 / 4294967296.0);
+}
+
+// Distance at which the ray enters the box before tMax, NO_HIT if it misses
+// it
+float intersectBox(vec3 origin, vec3 invDirection, vec3 boxMin, vec3 boxMax,
+    float tMax)
+{
+  vec3 t0 = (boxMin - origin) * invDirection;
+  vec3 t1 = (boxMax - origin) * invDirection;
+  vec3 tNear = min(t0, t1);
+  vec3 tFar = max(t0, t1);
+  float tEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0));
+  float tExit = min(min(tFar.x, tFar.y), min(tFar.z, tMax));
+  return tEnter <= tExit ? tEnter : NO_HIT;
+}
+
+// Moller-Trumbore test of both faces of a triangle, like RayQueries: true if
+// the ray hits it before tMax, at distance t and barycentrics uv
+bool intersectTriangle(vec3 origin, vec3 direction, Triangle triangle,
+    float tMax, out float t, out vec2 uv)
+{
+  vec3 a = triangle.positions[0].xyz;
+  vec3 e1 = triangle.positions[1].xyz - a;
+  vec3 e2 = triangle.positions[2].xyz - a;
+  vec3 p = cross(direction, e2);
+  float determinant = dot(e1, p);
+  if (determinant == 0) {
+    return false;
+  }
+  float invDeterminant = 1 / determinant;
+  vec3 s = origin - a;
+  uv.x = dot(s, p) * invDeterminant;
+  if (uv.x < 0 || uv.x > 1) {
+    return false;
+  }
+  vec3 q = cross(s, e1);
+  uv.y = dot(direction, q) * invDeterminant;
+  if (uv.y < 0 || uv.x + uv.y > 1) {
+    return false;
+  }
+  t = dot(e2, q) * invDeterminant;
+  return t >= 0 && t < tMax;
+}
+
+// Nearest triangle hit by the ray before tMax, -1 if none, or with anyHit
+// the first one found
+int intersectScene(vec3 origin, vec3 direction, float tMax, bool anyHit,
+    out float t, out vec2 uv)
+{
+  t = tMax;
+  int hit = -1;
+  vec3 invDirection = 1 / direction;
+  if (intersectBox(origin, invDirection, nodes[0].boundsMin,
+          nodes[0].boundsMax, t) == NO_HIT) {
+    return hit;
+  }
+  int stack[STACK_SIZE];
+  int stackSize = 1;
+  stack[0] = 0;
+  while (stackSize > 0) {
+    Node node = nodes[stack[--stackSize]];
+    if (node.triangleCount > 0) {
+      for (int i = node.first; i < node.first + node.triangleCount; ++i) {
+        float triangleT;
+        vec2 triangleUv;
+        if (intersectTriangle(origin, direction, triangles[i], t,
+                triangleT, triangleUv)) {
+          t = triangleT;
+          uv = triangleUv;
+          hit = i;
+          if (anyHit) {
+            return hit;
+          }
+        }
+      }
+      continue;
+    }
+    // Nearest child visited first, children missed or behind the nearest
+    // hit not at all
+    float tFirst = intersectBox(origin, invDirection,
+        nodes[node.first].boundsMin, nodes[node.first].boundsMax, t);
+    float tSecond = intersectBox(origin, invDirection,
+        nodes[node.first + 1].boundsMin, nodes[node.first + 1].boundsMax, t);
+    int nearChild = tFirst <= tSecond ? node.first : node.first + 1;
+    int farChild = tFirst <= tSecond ? node.first + 1 : node.first;
+    if (max(tFirst, tSecond) < NO_HIT && stackSize < STACK_SIZE) {
+      stack[stackSize++] = farChild;
+    }
+    if (min(tFirst, tSecond) < NO_HIT && stackSize < STACK_SIZE) {
+      stack[stackSize++] = nearChild;
+    }
+  }
+  return hit;
+}
+
+// Texture of a material at texCoords, with bindless textures only
+vec4 sampleMaterialTexture(uvec2 handle, mat3x2 uvTransform, vec2 texCoords)
+{
+#ifdef GL_ARB_bindless_texture
+  if (uBindlessTextures != 0) {
+    // No derivatives in compute shaders, the average filters the texels
+    return textureLod(
+        sampler2D(handle), uvTransform * vec3(texCoords, 1), 0);
+  }
+#endif
+  return vec4(1);
+}
+
+#ifdef IMAGE_BASED_LIGHTING
+// Same equirectangular mapping as environment_prefilter.cs.glsl
+vec3 getEnvironmentRadiance(vec3 direction)
+{
+  vec2 texCoords = vec2(atan(direction.z, direction.x) * 0.5 * M_1_PI + 0.5,
+      acos(clamp(direction.y, -1., 1.)) * M_1_PI);
+  return textureLod(uPrefilteredEnvironment, texCoords, 0).rgb *
+         uEnvironmentIntensity;
+}
+#else
+vec3 getEnvironmentRadiance(vec3 direction) { return vec3(0); }
+#endif
+
+// Same BRDF as pbr_directional_light.fs.glsl: light reflected towards V by a
+// light of intensity coming from L
+vec3 shadeLight(vec3 N, vec3 V, vec3 L, vec3 intensity, vec3 c_diff,
+    vec3 F_0, float alpha)
+{
+  vec3 H = normalize(L + V);
+
+  float VdotH = clamp(dot(V, H), 0., 1.);
+  vec3 F = F_0 + (vec3(1) - F_0) * pow(1 - VdotH, 5.);
+
+  float sqrAlpha = alpha * alpha;
+  float NdotL = clamp(dot(N, L), 0., 1.);
+  float NdotV = clamp(dot(N, V), 0., 1.);
+  float visDenominator =
+      NdotL * sqrt(NdotV * NdotV * (1 - sqrAlpha) + sqrAlpha) +
+      NdotV * sqrt(NdotL * NdotL * (1 - sqrAlpha) + sqrAlpha);
+  float Vis = visDenominator > 0. ? 0.5 / visDenominator : 0.0;
+
+  float NdotH = clamp(dot(N, H), 0., 1.);
+  float baseDenomD = (NdotH * NdotH * (sqrAlpha - 1.) + 1.);
+  float D = M_1_PI * sqrAlpha / (baseDenomD * baseDenomD);
+
+  vec3 f_specular = F * Vis * D;
+  vec3 f_diffuse = (1. - F) * c_diff * M_1_PI;
+  return (f_diffuse + f_specular) * intensity * NdotL;
+}
+
+// Orthonormal basis whose z axis is N (Duff et al. 2017)
+mat3 getTangentFrame(vec3 N)
+{
+  float s = N.z >= 0 ? 1 : -1;
+  float a = -1 / (s + N.z);
+  float b = N.x * N.y * a;
+  return mat3(vec3(1 + s * N.x * N.x * a, s * b, -s * N.x),
+      vec3(b, s + N.y * N.y * a, -N.y), N);
+}
+
+// Direction L in which the path goes on from a surface seen from V, drawn
+// from the GGX lobe with probability specularChance and from the cosine
+// weighted hemisphere otherwise. Returns the BRDF times the cosine over the
+// probability of L for both draws (one sample MIS, balance heuristic), zero
+// if L goes below the surface.
+vec3 sampleBrdf(vec3 N, vec3 V, vec3 c_diff, vec3 F_0, float alpha,
+    float specularChance, out vec3 L)
+{
+  mat3 frame = getTangentFrame(N);
+  float u1 = random();
+  float u2 = random();
+  float phi = 2 * M_PI * u2;
+  float sqrAlpha = alpha * alpha;
+  if (random() < specularChance) {
+    float cosTheta = sqrt((1 - u1) / (1 + (sqrAlpha - 1) * u1));
+    float sinTheta = sqrt(max(1 - cosTheta * cosTheta, 0));
+    vec3 H = frame * vec3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta);
+    L = reflect(-V, H);
+  } else {
+    float sinTheta = sqrt(u1);
+    L = frame *
+        vec3(sinTheta * cos(phi), sinTheta * sin(phi), sqrt(1 - u1));
+  }
+  float NdotL = dot(N, L);
+  if (NdotL <= 0) {
+    return vec3(0);
+  }
+  vec3 H = normalize(L + V);
+  float NdotH = clamp(dot(N, H), 0., 1.);
+  float VdotH = max(dot(V, H), 1e-6);
+  float baseDenomD = (NdotH * NdotH * (sqrAlpha - 1.) + 1.);
+  float D = M_1_PI * sqrAlpha / (baseDenomD * baseDenomD);
+  float pdf = specularChance * D * NdotH / (4 * VdotH) +
+              (1 - specularChance) * NdotL * M_1_PI;
+  return pdf > 0 ? shadeLight(N, V, L, vec3(1), c_diff, F_0, alpha) / pdf
+                 : vec3(0);
+}
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  ivec2 size = imageSize(uAverage);
+  if (any(greaterThanEqual(texel, size))) {
+    return;
+  }
+  randomState = uint(texel.y * size.x + texel.x) * 9781u +
+                uSampleIndex * 6271u + 1u;
+  random();
+
+  // Camera ray through a random point of the pixel, from the origin of
+  // perspective projections, along -z for orthographic ones
+  vec2 ndc = (vec2(texel) + vec2(random(), random())) / vec2(size) * 2 - 1;
+  vec3 viewOrigin = vec3(0);
+  vec3 viewDirection = vec3(0, 0, -1);
+  if (uProjMatrix[2][3] != 0) {
+    viewDirection.xy = (ndc + vec2(uProjMatrix[2][0], uProjMatrix[2][1])) /
+                       vec2(uProjMatrix[0][0], uProjMatrix[1][1]);
+  } else {
+    viewOrigin.xy = (ndc - vec2(uProjMatrix[3][0], uProjMatrix[3][1])) /
+                    vec2(uProjMatrix[0][0], uProjMatrix[1][1]);
+  }
+  vec3 origin = vec3(uCameraMatrix * vec4(viewOrigin, 1));
+  vec3 direction = normalize(mat3(uCameraMatrix) * viewDirection);
+
+  vec3 radiance = vec3(0);
+  vec3 throughput = vec3(1);
+  for (int bounce = 0; bounce <= uMaxBounces; ++bounce) {
+    float t;
+    vec2 uv;
+    int hit = intersectScene(origin, direction, NO_HIT, false, t, uv);
+    if (hit < 0) {
+      radiance += throughput * getEnvironmentRadiance(direction);
+      break;
+    }
+    Triangle triangle = triangles[hit];
+    vec3 weights = vec3(1 - uv.x - uv.y, uv);
+    vec3 position = origin + t * direction;
+    // Both faces are shaded, as seen from the ray
+    vec3 geometricN = normalize(cross(
+        triangle.positions[1].xyz - triangle.positions[0].xyz,
+        triangle.positions[2].xyz - triangle.positions[0].xyz));
+    if (dot(geometricN, direction) > 0) {
+      geometricN = -geometricN;
+    }
+    vec3 N = mat3(triangle.normals[0].xyz, triangle.normals[1].xyz,
+                 triangle.normals[2].xyz) *
+             weights;
+    N = dot(N, N) > 0 ? normalize(N) : geometricN;
+    if (dot(N, geometricN) < 0) {
+      N = -N;
+    }
+    vec2 texCoords = mat3x2(triangle.texCoords[0], triangle.texCoords[1],
+                         triangle.texCoords[2]) *
+                     weights;
+
+    Material material = materials[triangle.material];
+    vec4 baseColor = material.baseColorFactor *
+                     SRGBtoLINEAR(sampleMaterialTexture(
+                         material.baseColorTexture,
+                         material.uvTransforms[0], texCoords));
+    vec4 metallicRoughness = sampleMaterialTexture(
+        material.metallicRoughnessTexture, material.uvTransforms[1],
+        texCoords);
+    float metallic = material.metallicFactor * metallicRoughness.b;
+    float roughness = material.roughnessFactor * metallicRoughness.g;
+    vec3 emissive = material.emissiveFactor *
+                    SRGBtoLINEAR(sampleMaterialTexture(
+                        material.emissiveTexture, material.uvTransforms[2],
+                        texCoords)).rgb;
+    vec3 c_diff = mix(baseColor.rgb * (1 - 0.04), vec3(0), metallic);
+    vec3 F_0 = mix(vec3(0.04), baseColor.rgb, metallic);
+    float alpha = max(roughness * roughness, MIN_ALPHA);
+    vec3 V = -direction;
+
+    radiance += throughput * emissive;
+    // Rays leaving the surface start off it, by a step relative to the
+    // precision of its coordinates
+    vec3 offsetOrigin = position +
+        geometricN * 1e-4 * max(1, max(abs(position.x),
+                                      max(abs(position.y), abs(position.z))));
+    if (dot(geometricN, uLightDirection) > 0 &&
+        intersectScene(offsetOrigin, uLightDirection, NO_HIT, true, t, uv) <
+            0) {
+      radiance += throughput * shadeLight(N, V, uLightDirection,
+                                   uLightIntensity, c_diff, F_0, alpha);
+    }
+    if (bounce == uMaxBounces) {
+      break;
+    }
+
+    float specular = max(F_0.r, max(F_0.g, F_0.b));
+    float diffuse = max(c_diff.r, max(c_diff.g, c_diff.b));
+    float specularChance =
+        diffuse > 0 ? clamp(specular / (specular + diffuse), 0.25, 0.9) : 1;
+    vec3 L;
+    throughput *= sampleBrdf(N, V, c_diff, F_0, alpha, specularChance, L);
+    if (dot(L, geometricN) <= 0 || all(equal(throughput, vec3(0)))) {
+      break;
+    }
+    // Russian roulette, paths carrying little light end early
+    if (bounce >= 2) {
+      float survival =
+          clamp(max(throughput.r, max(throughput.g, throughput.b)), 0.05,
+              0.95);
+      if (random() >= survival) {
+        break;
+      }
+      throughput /= survival;
+    }
+    origin = offsetOrigin;
+    direction = L;
+  }
+  if (any(isnan(radiance)) || any(isinf(radiance))) {
+    radiance = vec3(0);
+  }
+
+  vec4 sampleColor = vec4(radiance, 1);
+  vec4 average = uWeight < 1.0 ? imageLoad(uAverage, texel) : sampleColor;
+  imageStore(uAverage, texel, mix(average, sampleColor, uWeight));
+}
@@ -0,0 +1,19 @@
+#version 430
+
+// Average of the samples of PathTracer drawn over the viewport by
+// fullscreen_triangle.vs.glsl, clipped and encoded like the forward shaders
+// encode their colors.
+
+layout(rgba32f, binding = 0) readonly uniform image2D uAverage;
+
+uniform int uEncodeOutput; // Else the framebuffer encodes to sRGB
+
+const float INV_GAMMA = 1. / 2.2;
+
+layout(location = 0) out vec4 fColor;
+
+void main()
+{
+  vec3 color = imageLoad(uAverage, ivec2(gl_FragCoord.xy)).rgb;
+  fColor = vec4(uEncodeOutput != 0 ? pow(color, vec3(INV_GAMMA)) : color, 1);
+}
@@ -1,27 +1,272 @@
-#version 330
+#version 430
+#extension GL_ARB_bindless_texture : enable
+// Barycentrics of the wireframe debug view, see DebugViews
+#ifdef WIREFRAME_BARYCENTRICS_NV
+#extension GL_NV_fragment_shader_barycentric : require
+#elif defined(WIREFRAME_BARYCENTRICS_AMD)
+#extension GL_AMD_shader_explicit_vertex_parameter : require
+#endif
 
+// Textures of the material, all sampled unless a variant of the program is
+// compiled for materials without some of them (--material-variants)
+#ifndef HAS_BASE_COLOR_TEXTURE
+#define HAS_BASE_COLOR_TEXTURE 1
+#endif
+#ifndef HAS_METALLIC_ROUGHNESS_TEXTURE
+#define HAS_METALLIC_ROUGHNESS_TEXTURE 1
+#endif
+#ifndef HAS_EMISSIVE_TEXTURE
+#define HAS_EMISSIVE_TEXTURE 1
+#endif
+#ifndef HAS_OCCLUSION_TEXTURE
+#define HAS_OCCLUSION_TEXTURE 1
+#endif
+#ifndef HAS_NORMAL_TEXTURE
+#define HAS_NORMAL_TEXTURE 1
+#endif
+// Base color and emissive textures are decoded from sRGB by the texture units
+// (--srgb)
+#ifndef HARDWARE_SRGB
+#define HARDWARE_SRGB 0
+#endif
+// Textures are layers of array textures (--texture-arrays)
+#ifndef TEXTURE_ARRAYS
+#define TEXTURE_ARRAYS 0
+#endif
+#if TEXTURE_ARRAYS
+#define MaterialSampler sampler2DArray
+#else
+#define MaterialSampler sampler2D
+#endif
+
+#ifdef DEFERRED_LIGHTING
+// The lighting pass of --deferred-shading shades the material parameters of
+// the G-buffer (see GBuffer), drawn by the variants with GBUFFER. The
+// position is reconstructed from the depth by main.
+vec3 vViewSpacePosition = vec3(0);
+
+uniform sampler2D uGBufferAlbedo;
+uniform sampler2D uGBufferNormal;
+uniform sampler2D uGBufferMaterial;
+uniform sampler2D uGBufferEmissive;
+uniform sampler2D uGBufferDepth;
+uniform mat4 uInverseProjMatrix; // Of uProjMatrix
+// Cleared depth, where nothing is drawn. With REVERSED_Z (--reversed-z),
+// depths are normalized device coordinates, the near plane at 1.
+#ifdef REVERSED_Z
+const float FAR_DEPTH = 0;
+#else
+const float FAR_DEPTH = 1;
+#endif
+#ifdef AMBIENT_OCCLUSION
+// Half resolution occlusion and view depth of AmbientOcclusion (--ssao)
+uniform sampler2D uAmbientOcclusion;
+uniform int uApplyAmbientOcclusion;
+#endif
+#else
 in vec3 vViewSpacePosition;
 in vec3 vViewSpaceNormal;
+// Handedness of the bitangent in w, zero for primitives without tangents
+in vec4 vViewSpaceTangent;
 in vec2 vTexCoords;
+flat in int vMaterialIndex;
+#if defined(DRAW_IDS) || defined(DEBUG_VIEWS)
+flat in uint vDrawId; // See forward.vs.glsl
+#endif
+#endif
+// Motion vectors of --taa, only written by the opaque draws of the forward
+// passes: the deferred, blended and transmissive ones are masked out of them
+#if defined(MOTION_VECTORS) && !defined(GBUFFER)
+#if !defined(DEFERRED_LIGHTING) && !defined(ALPHA_BLEND) && \
+    !defined(TRANSMISSION)
+#define WRITE_MOTION 1
+in vec4 vMovedPosition; // See forward.vs.glsl
+in vec4 vPreviousPosition;
+#endif
+#endif
+
+// Same for every draw of a frame, see FrameUniforms in ViewerApplication.hpp
+layout(std140) uniform FrameUniforms
+{
+  mat4 uViewMatrix;
+  mat4 uProjMatrix;
+  vec3 uLightDirection; // View space
+  vec3 uLightIntensity;
+  int uApplyOcclusion;
+  int uEncodeOutput; // Else the framebuffer encodes to sRGB
+  mat4 uPreviousViewProjMatrix; // Unjittered, for MOTION_VECTORS
+  mat4 uEyeProjMatrices[2]; // Left and right, for MULTIVIEW
+};
+
+// Same layout as MaterialData in ViewerApplication.hpp
+struct Material
+{
+  vec4 baseColorFactor;
+  vec3 emissiveFactor;
+  float metallicFactor;
+  float roughnessFactor;
+  float occlusionStrength;
+  // Bindless handles when uBindlessTextures is set, with TEXTURE_ARRAYS the
+  // first component is the layer of the texture
+  uvec2 baseColorTexture;
+  uvec2 metallicRoughnessTexture;
+  uvec2 emissiveTexture;
+  uvec2 occlusionTexture;
+  uvec2 normalTexture;
+  float alphaCutoff; // Of MASK materials
+  float normalScale;
+  // Of the texture coordinates of each texture above, from
+  // KHR_texture_transform
+  mat3x2 uvTransforms[5];
+  float transmissionFactor; // KHR_materials_transmission
+};
+
+layout(std430) readonly buffer Materials
+{
+  Material materials[];
+};
+
+// Same location in all variants, set by the draw loop
+layout(location = 0) uniform int uMaterialIndex;
+
+uniform MaterialSampler uBaseColorTexture;
+uniform MaterialSampler uMetallicRoughnessTexture;
+uniform MaterialSampler uEmissiveTexture;
+uniform MaterialSampler uOcclusionTexture;
+uniform MaterialSampler uNormalTexture;
+uniform int uBindlessTextures;
+
+#ifdef PUNCTUAL_LIGHTS
+// KHR_lights_punctual lights of --punctual-lights in view space, see
+// LightClusters and light_clusters.cs.glsl
+struct Light
+{
+  vec4 positionRange; // Range is where the light fades out
+  vec4 directionType; // Direction the light points to, type in w
+  vec4 color; // Times the intensity
+  vec4 spot; // Angle scale and offset in xy
+};
+
+const float DIRECTIONAL_LIGHT = 0;
+const float SPOT_LIGHT = 2;
+
+layout(std430) readonly buffer Lights
+{
+  uvec4 lightCounts; // All lights, then directional ones, first
+  Light lights[];
+};
 
-uniform vec3 uLightDirection;
-uniform vec3 uLightIntensity;
+// Point and spot lights reaching each cluster of the view frustum, listed by
+// light_clusters.cs.glsl
+layout(std430) readonly buffer LightClusters
+{
+  uvec4 gridSize; // Clusters along x, y, z, lights per cluster in w
+  // Cluster of a fragment from its window coordinates times xy, and from the
+  // log of its view depth times z plus w
+  vec4 gridScales;
+  uint clusterLights[];
+};
+#endif
+
+#ifdef SHADOW_MAPS
+// Cascaded shadow maps of the directional light (--shadow-maps), see
+// ShadowCascades
+layout(std140) uniform ShadowUniforms
+{
+  // View space to the texture coordinates and depth of each cascade
+  mat4 uShadowMatrices[4];
+  vec4 uShadowTexelSizes; // View space size of a texel of each cascade
+  int uShadowCascadeCount; // 0 without shadows
+};
+
+uniform sampler2DArrayShadow uShadowMap;
+#endif
 
-uniform vec4 uBaseColorFactor;
-uniform float uMetallicFactor;
-uniform float uRoughnessFactor;
-uniform vec3 uEmissiveFactor;
-uniform float uOcclusionStrength;
+#ifdef IMAGE_BASED_LIGHTING
+// Maps of the environment of --environment, see EnvironmentMap
+layout(std140) uniform EnvironmentUniforms
+{
+  mat4 uWorldFromViewMatrix;
+  vec4 uIrradianceSH[9]; // Irradiance of world space normals
+  float uEnvironmentIntensity;
+  float uPrefilteredMaxLevel; // Of roughness 1
+};
+
+// Equirectangular, the radiance of GGX lobes of increasing roughness in its
+// levels
+uniform sampler2D uPrefilteredEnvironment;
+// Scale and bias of F_0 for NdotV in x and the roughness in y
+uniform sampler2D uBrdfLut;
+#endif
 
-uniform sampler2D uBaseColorTexture;
-uniform sampler2D uMetallicRoughnessTexture;
-uniform sampler2D uEmissiveTexture;
-uniform sampler2D uOcclusionTexture;
-uniform int uApplyOcclusion;
+#ifdef TRANSMISSION
+// Color of the opaque draws and cutouts at half the size of the viewport,
+// blurrier in each mip level, for the materials of KHR_materials_transmission
+// (see SceneColor)
+uniform sampler2D uSceneColor;
+#endif
 
+#if defined(DEBUG_VIEWS) && !defined(GBUFFER) && !defined(DEFERRED_LIGHTING)
+#define SHOW_DEBUG_VIEWS 1
+// Debug views of the GUI, see DebugViews: the shaded color or, instead, that
+// of the view
+const int DEBUG_VIEW_SHADED = 0;
+const int DEBUG_VIEW_NORMALS = 1;
+const int DEBUG_VIEW_DRAW_IDS = 2;
+const int DEBUG_VIEW_TRIANGLE_DENSITY = 3;
+const int DEBUG_VIEW_MIP_LEVELS = 4;
+const int DEBUG_VIEW_OVERDRAW = 5;
+const int DEBUG_VIEW_WIREFRAME = 6;
 
+// Of the edges of the wireframe view, in display values and pixels
+const vec3 WIREFRAME_COLOR = vec3(1, 0.5, 0);
+const float WIREFRAME_WIDTH = 1.5;
 
-out vec3 fColor;
+// Same location in all variants
+layout(location = 5) uniform int uDebugView;
+
+// World space triangles per unit of area of each draw, by index
+layout(std430) readonly buffer DebugDraws
+{
+  float triangleDensities[];
+};
+
+// Fragments shaded per pixel, see DebugViews::OVERDRAW_IMAGE_UNIT
+layout(r32ui, binding = 7) uniform uimage2D uOverdraw;
+
+#ifndef ALPHA_TEST
+// Overdraw only counts the fragments passing the depth test. Without
+// discards or depth writes, tests are the same before and after shading.
+layout(early_fragment_tests) in;
+#endif
+#endif
+
+#ifdef GBUFFER
+layout(location = 0) out vec4 fAlbedo; // sRGB encoded base color
+layout(location = 1) out vec2 fNormal; // Octahedral, see encodeNormal
+layout(location = 2) out vec4 fMaterial; // Metallic, roughness, occlusion
+layout(location = 3) out vec3 fEmissive;
+#elif defined(ALPHA_BLEND) || defined(TRANSMISSION)
+// Blended by the framebuffer, of BLEND materials with --sorted-transparency,
+// opaque for the transmissive ones drawn with them
+layout(location = 0) out vec4 fColor;
+#else
+layout(location = 0) out vec3 fColor;
+#endif
+#ifdef DRAW_IDS
+// Not blended: BLEND draws replace the draw IDs behind them
+layout(location = 1) out uint fDrawId;
+#endif
+#ifdef WRITE_MOTION
+// Texture coordinates of the fragment minus those it would have had without
+// the motion of its draw, in the previous view (see TemporalAntiAliasing)
+layout(location = 1) out vec2 fMotion;
+#endif
+#if defined(AOVS) && !defined(GBUFFER) && !defined(DEFERRED_LIGHTING)
+// With --output-aovs, view space normal and distance along the view axis of
+// the fragment (see AsyncImageRenderer)
+layout(location = 2) out vec4 fGeometry;
+#endif
 
 // Constants
 const float GAMMA = 2.2;
@@ -32,31 +277,134 @@ const float M_1_PI = 1.0 / M_PI;
 vec3 LINEARtoSRGB(vec3 color) { return pow(color, vec3(INV_GAMMA)); }
 vec4 SRGBtoLINEAR(vec4 srgbIn)
 {
+#if HARDWARE_SRGB
+  return srgbIn;
+#else
   return vec4(pow(srgbIn.xyz, vec3(GAMMA)), srgbIn.w);
+#endif
 }
 
-void main()
+// Unit vector to a point of the octahedron of |x| + |y| + |z| = 1 unfolded
+// on the [0, 1] square, and back
+vec2 encodeNormal(vec3 n)
 {
-  vec3 N = normalize(vViewSpaceNormal);
-  vec3 V = normalize(-vViewSpacePosition);
-  vec3 L = uLightDirection;
-  vec3 H = normalize(L + V);
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  vec2 e = n.xy;
+  if (n.z < 0) {
+    e = (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+  }
+  return e * 0.5 + 0.5;
+}
+vec3 decodeNormal(vec2 e)
+{
+  e = e * 2 - 1;
+  vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0);
+  n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+  return normalize(n);
+}
 
-  vec4 baseColorFromTexture = SRGBtoLINEAR(texture(uBaseColorTexture, vTexCoords));
-  vec4 baseColor = uBaseColorFactor * baseColorFromTexture;
-  vec4 metallicRoughnessFromTexture = texture(uMetallicRoughnessTexture, vTexCoords);
+// Sample the texture of the material from its handle with bindless textures,
+// or from the sampler bound by the application
+vec4 sampleMaterialTexture(
+    MaterialSampler boundTexture, uvec2 handle, vec2 uv)
+{
+#if TEXTURE_ARRAYS
+  return texture(boundTexture, vec3(uv, float(handle.x)));
+#else
+#ifdef GL_ARB_bindless_texture
+  if (uBindlessTextures != 0) {
+    return texture(sampler2D(handle), uv);
+  }
+#endif
+  return texture(boundTexture, uv);
+#endif
+}
 
+#ifndef DEFERRED_LIGHTING
+// Texture coordinates of a texture of the material, transformed by one of
+// its uvTransforms
+vec2 getMaterialUv(mat3x2 uvTransform)
+{
+  return uvTransform * vec3(vTexCoords, 1);
+}
+#endif
 
-  vec3 metallic = vec3(uMetallicFactor * metallicRoughnessFromTexture.b);
-  float roughness = uRoughnessFactor * metallicRoughnessFromTexture.g;
+#ifdef SHOW_DEBUG_VIEWS
+// Blue to green to red as x goes from 0 to 1, in display values
+vec3 heatColor(float x)
+{
+  x = clamp(x, 0., 1.);
+  return clamp(vec3(2 * x - 1, 1 - abs(2 * x - 1), 1 - 2 * x), 0., 1.);
+}
 
-  vec3 dielectricSpecular = vec3(0.04);
-  vec3 black = vec3(0.);
+// Color of the debug view at the fragment, in display values
+vec3 getDebugViewColor(vec3 N, uvec2 baseColorHandle, vec2 baseColorUv)
+{
+  if (uDebugView == DEBUG_VIEW_NORMALS) {
+    return max(N, vec3(0)); // Like normals.fs.glsl, with normal maps
+  }
+  if (uDebugView == DEBUG_VIEW_DRAW_IDS) {
+    uint hash = vDrawId * 2654435761u;
+    hash ^= hash >> 15;
+    return vec3(uvec3(hash, hash >> 8, hash >> 16) & 255u) / 255.;
+  }
+  if (uDebugView == DEBUG_VIEW_TRIANGLE_DENSITY) {
+    if (vDrawId == 0u) {
+      return vec3(0.5); // Not a draw of drawCommands
+    }
+    // Area of the surface the pixel covers, times the triangles per area
+    float pixelArea = length(
+        cross(dFdx(vViewSpacePosition), dFdy(vViewSpacePosition)));
+    float triangles = triangleDensities[vDrawId - 1u] * pixelArea;
+    return heatColor((log2(max(triangles, 1e-8)) + 6) / 6);
+  }
+  if (uDebugView == DEBUG_VIEW_MIP_LEVELS) {
+#if HAS_BASE_COLOR_TEXTURE
+    // Unclamped level of detail, 0 for a texel per pixel, from 16 pixels
+    // per texel to 16 texels per pixel
+    float lod = textureQueryLod(uBaseColorTexture, baseColorUv).y;
+#if !TEXTURE_ARRAYS && defined(GL_ARB_bindless_texture)
+    if (uBindlessTextures != 0) {
+      lod = textureQueryLod(sampler2D(baseColorHandle), baseColorUv).y;
+    }
+#endif
+    return heatColor(0.5 + lod / 8);
+#else
+    return vec3(0.5); // Without base color texture
+#endif
+  }
+  return vec3(0); // Overdraw, drawn over the scene
+}
 
-  vec3 c_diff =
-      mix(baseColor.rgb * (1 - dielectricSpecular.r), black, metallic);
-  vec3 F_0 = mix(vec3(dielectricSpecular), baseColor.rgb, metallic);
-  float alpha = roughness * roughness;
+// Coverage of the fragment by the edges of its triangle, 1 on them and 0
+// farther than WIREFRAME_WIDTH pixels, antialiased over a pixel. Distances
+// to the edges in pixels are the barycentrics over their screen space
+// derivatives, in the same pass as the shading.
+float getWireframeCoverage()
+{
+#if defined(WIREFRAME_BARYCENTRICS_NV)
+  vec3 barycentrics = gl_BaryCoordNoPerspNV;
+#elif defined(WIREFRAME_BARYCENTRICS_AMD)
+  vec2 weights = gl_BaryCoordNoPerspAMD;
+  vec3 barycentrics = vec3(weights, 1 - weights.x - weights.y);
+#else
+  vec3 barycentrics = vec3(1); // Never selected without barycentrics
+#endif
+  vec3 distances = barycentrics / max(fwidth(barycentrics), vec3(1e-6));
+  float distance = min(min(distances.x, distances.y), distances.z);
+  return 1 - smoothstep(
+                 0.5 * WIREFRAME_WIDTH - 0.5, 0.5 * WIREFRAME_WIDTH + 0.5,
+                 distance);
+}
+#endif
+
+// Light reflected towards V by a light of intensity coming from L, for the
+// material parameters at the fragment
+vec3 shadeLight(vec3 N, vec3 V, vec3 L, vec3 intensity, vec3 c_diff,
+    vec3 F_0, float alpha)
+{
+  vec3 H = normalize(L + V);
 
   float VdotH = clamp(dot(V, H), 0., 1.);
   float baseShlickFactor = 1 - VdotH;
@@ -82,13 +430,332 @@ void main()
   vec3 diffuse = c_diff * M_1_PI;
 
   vec3 f_diffuse = (1. - F) * diffuse;
-  vec3 emissive = SRGBtoLINEAR(texture2D(uEmissiveTexture, vTexCoords)).rgb * uEmissiveFactor;
-  vec3 color = (f_diffuse + f_specular) * uLightIntensity * NdotL + emissive;
+  return (f_diffuse + f_specular) * intensity * NdotL;
+}
+
+#ifdef SHADOW_MAPS
+// Share of the directional light reaching the fragment, from the first
+// cascade covering it. Its position is offset along the normal by a texel of
+// the cascade, so that surfaces do not shadow themselves.
+float sampleShadow(vec3 N)
+{
+  for (int cascade = 0; cascade < uShadowCascadeCount; ++cascade) {
+    vec3 position =
+        vViewSpacePosition + N * (1.5 * uShadowTexelSizes[cascade]);
+    vec3 coords = vec3(uShadowMatrices[cascade] * vec4(position, 1));
+    if (all(greaterThan(coords.xy, vec2(0))) &&
+        all(lessThan(coords.xy, vec2(1)))) {
+      // Four taps of the 2x2 filter of the texture unit
+      vec2 texel = 0.5 / vec2(textureSize(uShadowMap, 0).xy);
+      float lit = 0;
+      for (int tap = 0; tap < 4; ++tap) {
+        vec2 offset = vec2((tap & 1) != 0 ? 1 : -1, (tap & 2) != 0 ? 1 : -1);
+        lit += texture(uShadowMap,
+            vec4(coords.xy + offset * texel, cascade, clamp(coords.z, 0, 1)));
+      }
+      return 0.25 * lit;
+    }
+  }
+  return 1;
+}
+#endif
+
+#ifdef IMAGE_BASED_LIGHTING
+// Light of the environment reflected at the fragment, with the split sum
+// approximation
+vec3 shadeEnvironment(vec3 N, vec3 V, vec3 c_diff, vec3 F_0, float roughness)
+{
+  vec3 n = mat3(uWorldFromViewMatrix) * N;
+  vec3 irradiance = uIrradianceSH[0].rgb * 0.282095 +
+                    uIrradianceSH[1].rgb * 0.488603 * n.y +
+                    uIrradianceSH[2].rgb * 0.488603 * n.z +
+                    uIrradianceSH[3].rgb * 0.488603 * n.x +
+                    uIrradianceSH[4].rgb * 1.092548 * n.x * n.y +
+                    uIrradianceSH[5].rgb * 1.092548 * n.y * n.z +
+                    uIrradianceSH[6].rgb * 0.315392 * (3 * n.z * n.z - 1) +
+                    uIrradianceSH[7].rgb * 1.092548 * n.x * n.z +
+                    uIrradianceSH[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+  vec3 diffuse = c_diff * M_1_PI * max(irradiance, vec3(0));
+
+  // Same equirectangular mapping as environment_prefilter.cs.glsl
+  vec3 r = mat3(uWorldFromViewMatrix) * reflect(-V, N);
+  vec2 texCoords = vec2(atan(r.z, r.x) * 0.5 * M_1_PI + 0.5,
+      acos(clamp(r.y, -1., 1.)) * M_1_PI);
+  vec3 radiance = textureLod(uPrefilteredEnvironment, texCoords,
+      roughness * uPrefilteredMaxLevel).rgb;
+  vec2 scaleBias =
+      texture(uBrdfLut, vec2(clamp(dot(N, V), 0., 1.), roughness)).rg;
+  vec3 specular = radiance * (F_0 * scaleBias.x + scaleBias.y);
+  return (diffuse + specular) * uEnvironmentIntensity;
+}
+#endif
+
+#ifdef TRANSMISSION
+// Light of the draws behind the fragment coming through its thin surface
+// towards V, along V: the rougher the surface, the blurrier the level of
+// uSceneColor it is read from
+vec3 shadeTransmission(vec3 N, vec3 V, vec3 F_0, float roughness)
+{
+  vec2 size = vec2(textureSize(uSceneColor, 0));
+  vec2 uv = gl_FragCoord.xy / (2 * size);
+  float lod = log2(max(size.x, size.y)) * roughness;
+  vec3 behind = textureLod(uSceneColor, uv, lod).rgb;
+  if (uEncodeOutput != 0) {
+    behind = pow(behind, vec3(GAMMA));
+  }
+  float NdotV = clamp(dot(N, V), 0., 1.);
+  vec3 F = F_0 + (vec3(1) - F_0) * pow(1 - NdotV, 5.);
+  return (vec3(1) - F) * behind;
+}
+#endif
+
+#ifdef PUNCTUAL_LIGHTS
+// Light of lights[index] reflected at the fragment, with the range and cone
+// attenuations of KHR_lights_punctual
+vec3 shadePunctualLight(uint index, vec3 N, vec3 V, vec3 c_diff, vec3 F_0,
+    float alpha)
+{
+  Light light = lights[index];
+  if (light.directionType.w == DIRECTIONAL_LIGHT) {
+    return shadeLight(N, V, -light.directionType.xyz, light.color.rgb, c_diff,
+        F_0, alpha);
+  }
+  vec3 toLight = light.positionRange.xyz - vViewSpacePosition;
+  float sqrDistance = max(dot(toLight, toLight), 1e-8);
+  vec3 L = toLight * inversesqrt(sqrDistance);
+  float rangeRatio =
+      sqrDistance / (light.positionRange.w * light.positionRange.w);
+  float attenuation =
+      clamp(1. - rangeRatio * rangeRatio, 0., 1.) / sqrDistance;
+  if (light.directionType.w == SPOT_LIGHT) {
+    float cone = clamp(dot(light.directionType.xyz, -L) * light.spot.x +
+                           light.spot.y,
+        0., 1.);
+    attenuation *= cone * cone;
+  }
+  return shadeLight(
+      N, V, L, attenuation * light.color.rgb, c_diff, F_0, alpha);
+}
+#endif
+
+#ifdef AMBIENT_OCCLUSION
+// Occlusion of the pixel at texel from the 2x2 half resolution texels around
+// it, bilinear weights being scaled by the similarity of their view depths
+// with viewDepth so that edges stay sharp
+float upsampleAmbientOcclusion(ivec2 texel, float viewDepth)
+{
+  ivec2 size = textureSize(uAmbientOcclusion, 0);
+  vec2 position = (vec2(texel) + 0.5) * 0.5 - 0.5;
+  ivec2 origin = ivec2(floor(position));
+  vec2 f = position - vec2(origin);
+  float sum = 0;
+  float weightSum = 0;
+  for (int i = 0; i < 4; ++i) {
+    ivec2 offset = ivec2(i & 1, i >> 1);
+    vec2 tap = texelFetch(uAmbientOcclusion,
+        clamp(origin + offset, ivec2(0), size - 1), 0).rg;
+    vec2 bilinear = mix(1 - f, f, vec2(offset));
+    float weight = bilinear.x * bilinear.y *
+                   exp(-abs(tap.g - viewDepth) / (0.05 * viewDepth)) + 1e-4;
+    sum += tap.r * weight;
+    weightSum += weight;
+  }
+  return sum / weightSum;
+}
+#endif
+
+void main()
+{
+#ifdef DEFERRED_LIGHTING
+  ivec2 texel = ivec2(gl_FragCoord.xy);
+  float depth = texelFetch(uGBufferDepth, texel, 0).r;
+  if (depth == FAR_DEPTH) {
+    discard; // Nothing drawn, the clear color stays
+  }
+  // Later forward draws are tested against the depth of the G-buffer
+  gl_FragDepth = depth;
+  vec2 ndc = gl_FragCoord.xy / vec2(textureSize(uGBufferDepth, 0)) * 2 - 1;
+#ifdef REVERSED_Z
+  vec4 position = uInverseProjMatrix * vec4(ndc, depth, 1);
+#else
+  vec4 position = uInverseProjMatrix * vec4(ndc, depth * 2 - 1, 1);
+#endif
+  vViewSpacePosition = position.xyz / position.w;
+  vec3 N = decodeNormal(texelFetch(uGBufferNormal, texel, 0).xy);
+  vec3 V = normalize(-vViewSpacePosition);
+  vec4 baseColor = vec4(
+      pow(texelFetch(uGBufferAlbedo, texel, 0).rgb, vec3(GAMMA)), 1);
+  vec4 materialParameters = texelFetch(uGBufferMaterial, texel, 0);
+  vec3 metallic = vec3(materialParameters.r);
+  float roughness = materialParameters.g;
+  float occlusion = materialParameters.b;
+#ifdef AMBIENT_OCCLUSION
+  if (uApplyAmbientOcclusion == 1) {
+    occlusion *= upsampleAmbientOcclusion(texel, -vViewSpacePosition.z);
+  }
+#endif
+  vec3 emissive = texelFetch(uGBufferEmissive, texel, 0).rgb;
+#else
+#ifdef SHOW_DEBUG_VIEWS
+  if (uDebugView == DEBUG_VIEW_OVERDRAW) {
+    imageAtomicAdd(uOverdraw, ivec2(gl_FragCoord.xy), 1u);
+  }
+#endif
+  Material material =
+      materials[vMaterialIndex >= 0 ? vMaterialIndex : uMaterialIndex];
+  vec4 uBaseColorFactor = material.baseColorFactor;
+  float uMetallicFactor = material.metallicFactor;
+  float uRoughnessFactor = material.roughnessFactor;
+  vec3 uEmissiveFactor = material.emissiveFactor;
+  float uOcclusionStrength = material.occlusionStrength;
+
+  vec3 N = normalize(vViewSpaceNormal);
+#if HAS_NORMAL_TEXTURE
+  vec3 T = vViewSpaceTangent.xyz - dot(vViewSpaceTangent.xyz, N) * N;
+  if (dot(T, T) > 0) {
+    T = normalize(T);
+    vec3 B = cross(N, T) * vViewSpaceTangent.w;
+    // Blue is derived from the unit length of the normal, BC5 textures of
+    // --compress-textures only store red and green
+    mat3x2 uvTransform = material.uvTransforms[4];
+    vec2 normalXY = sampleMaterialTexture(uNormalTexture,
+        material.normalTexture, getMaterialUv(uvTransform)).rg * 2 - 1;
+    // Along the transformed coordinates, rotated back to the tangents
+    normalXY = transpose(mat2(normalize(uvTransform[0]),
+        normalize(uvTransform[1]))) * normalXY;
+    vec3 tangentNormal = vec3(normalXY * material.normalScale,
+        sqrt(max(1 - dot(normalXY, normalXY), 0)));
+    N = normalize(mat3(T, B, N) * tangentNormal);
+  }
+#endif
+  vec3 V = normalize(-vViewSpacePosition);
+
+  vec4 baseColor = uBaseColorFactor;
+#if HAS_BASE_COLOR_TEXTURE
+  baseColor *= SRGBtoLINEAR(sampleMaterialTexture(uBaseColorTexture,
+      material.baseColorTexture, getMaterialUv(material.uvTransforms[0])));
+#endif
+#ifdef ALPHA_TEST
+  // Only compiled in the variant of MASK materials, a discard disables the
+  // early depth test of the other draws
+  if (baseColor.a < material.alphaCutoff) {
+    discard;
+  }
+#endif
+  vec4 metallicRoughnessFromTexture = vec4(1);
+#if HAS_METALLIC_ROUGHNESS_TEXTURE
+  metallicRoughnessFromTexture = sampleMaterialTexture(
+      uMetallicRoughnessTexture, material.metallicRoughnessTexture,
+      getMaterialUv(material.uvTransforms[1]));
+#endif
 
+
+  vec3 metallic = vec3(uMetallicFactor * metallicRoughnessFromTexture.b);
+  float roughness = uRoughnessFactor * metallicRoughnessFromTexture.g;
+
+  vec3 emissive = uEmissiveFactor;
+#if HAS_EMISSIVE_TEXTURE
+  emissive *= SRGBtoLINEAR(sampleMaterialTexture(uEmissiveTexture,
+      material.emissiveTexture, getMaterialUv(material.uvTransforms[2]))).rgb;
+#endif
+#endif
+
+#ifdef GBUFFER
+  float occlusion = 1;
+#if HAS_OCCLUSION_TEXTURE
   if (uApplyOcclusion == 1) {
-    float ao = texture2D(uOcclusionTexture, vTexCoords).r;
+    float ao = sampleMaterialTexture(uOcclusionTexture,
+        material.occlusionTexture, getMaterialUv(material.uvTransforms[3])).r;
+    occlusion = mix(1, ao, uOcclusionStrength);
+  }
+#endif
+  fAlbedo = vec4(LINEARtoSRGB(baseColor.rgb), 1);
+  fNormal = encodeNormal(N);
+  fMaterial = vec4(metallic.r, roughness, occlusion, 1);
+  fEmissive = emissive;
+#else
+
+  vec3 dielectricSpecular = vec3(0.04);
+  vec3 black = vec3(0.);
+
+  vec3 c_diff =
+      mix(baseColor.rgb * (1 - dielectricSpecular.r), black, metallic);
+  vec3 F_0 = mix(vec3(dielectricSpecular), baseColor.rgb, metallic);
+  float alpha = roughness * roughness;
+#ifdef TRANSMISSION
+  // The transmitted share of the light is not diffused
+  float transmission = material.transmissionFactor * (1 - metallic.r);
+  c_diff *= 1 - material.transmissionFactor;
+#endif
+
+  vec3 lightIntensity = uLightIntensity;
+#ifdef SHADOW_MAPS
+  lightIntensity *= sampleShadow(N);
+#endif
+  vec3 color =
+      shadeLight(N, V, uLightDirection, lightIntensity, c_diff, F_0, alpha) +
+      emissive;
+#ifdef IMAGE_BASED_LIGHTING
+  color += shadeEnvironment(N, V, c_diff, F_0, roughness);
+#endif
+#ifdef PUNCTUAL_LIGHTS
+  for (uint i = 0; i < lightCounts.y; ++i) {
+    color += shadePunctualLight(i, N, V, c_diff, F_0, alpha);
+  }
+  // Only the point and spot lights listed in the cluster of the fragment
+  ivec3 coords = ivec3(gridScales.xy * gl_FragCoord.xy,
+      log(max(-vViewSpacePosition.z, 1e-8)) * gridScales.z + gridScales.w);
+  coords = clamp(coords, ivec3(0), ivec3(gridSize.xyz) - 1);
+  uint first = uint(coords.x) +
+               gridSize.x * (uint(coords.y) + gridSize.y * uint(coords.z));
+  first *= gridSize.w + 1;
+  for (uint i = 0; i < clusterLights[first]; ++i) {
+    color += shadePunctualLight(
+        clusterLights[first + 1 + i], N, V, c_diff, F_0, alpha);
+  }
+#endif
+
+#ifdef TRANSMISSION
+  color += transmission * baseColor.rgb *
+           shadeTransmission(N, V, F_0, roughness);
+#endif
+
+#ifdef DEFERRED_LIGHTING
+  color *= occlusion;
+#elif HAS_OCCLUSION_TEXTURE
+  if (uApplyOcclusion == 1) {
+    float ao = sampleMaterialTexture(uOcclusionTexture,
+        material.occlusionTexture, getMaterialUv(material.uvTransforms[3])).r;
     color = mix(color, color * ao, uOcclusionStrength);
   }
+#endif
 
-  fColor = LINEARtoSRGB(color);
+#ifdef SHOW_DEBUG_VIEWS
+  if (uDebugView == DEBUG_VIEW_WIREFRAME) {
+    color = mix(color, pow(WIREFRAME_COLOR, vec3(GAMMA)),
+        getWireframeCoverage());
+  } else if (uDebugView != DEBUG_VIEW_SHADED) {
+    color = pow(getDebugViewColor(N, material.baseColorTexture,
+        getMaterialUv(material.uvTransforms[0])), vec3(GAMMA));
+  }
+#endif
+  color = uEncodeOutput != 0 ? LINEARtoSRGB(color) : color;
+#ifdef ALPHA_BLEND
+  fColor = vec4(color, baseColor.a);
+#elif defined(TRANSMISSION)
+  fColor = vec4(color, 1);
+#else
+  fColor = color;
+#endif
+#ifdef DRAW_IDS
+  fDrawId = vDrawId;
+#endif
+#ifdef WRITE_MOTION
+  fMotion = 0.5 * (vMovedPosition.xy / vMovedPosition.w -
+                   vPreviousPosition.xy / vPreviousPosition.w);
+#endif
+#if defined(AOVS) && !defined(DEFERRED_LIGHTING)
+  fGeometry = vec4(normalize(vViewSpaceNormal), -vViewSpacePosition.z);
+#endif
+#endif
 }
\ No newline at end of file
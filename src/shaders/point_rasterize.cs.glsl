@@ -0,0 +1,136 @@
+#version 430
+#ifdef ATOMIC_INT64
+#extension GL_ARB_gpu_shader_int64 : require
+#extension GL_NV_shader_atomic_int64 : require
+#endif
+
+// Rasterization of the points of a batch of --compute-points (see
+// PointClouds), a workgroup per batch of uFirstBatch onwards. Batches outside
+// of the frustum are skipped, the others draw the prefix of their shuffled
+// points covering their projected area with POINT_DENSITY points per pixel.
+//
+// Each point keeps the nearest of the points of its pixel in Pixels: a key of
+// its window depth, ordered so that the nearest is the smallest, then its
+// index. With ATOMIC_INT64 both are packed in 64 bits for a single atomicMin.
+// Otherwise, uPass 0 keeps the smallest depth key of 32 bits of each pixel
+// and uPass 1 writes the index of the point at that depth.
+
+layout(local_size_x = 128) in;
+
+// Same layouts as PointClouds::Point and Batch
+struct Point
+{
+  vec3 position;
+  uint color;
+};
+
+struct Batch
+{
+  vec3 boundsMin;
+  uint firstPoint;
+  vec3 boundsMax;
+  uint pointCount;
+};
+
+layout(std430) readonly buffer Points
+{
+  Point points[];
+};
+
+layout(std430) readonly buffer Batches
+{
+  Batch batches[];
+};
+
+// 0xffffffff where no point was drawn
+#ifdef ATOMIC_INT64
+layout(std430) buffer Pixels
+{
+  uint64_t pixels[];
+};
+#else
+layout(std430) buffer Pixels
+{
+  uint depthKeys[]; // Then as many indices
+};
+#endif
+
+const float POINT_DENSITY = 2.0; // PointClouds::POINT_DENSITY
+
+uniform mat4 uModelMatrix;
+uniform mat4 uViewProjMatrix;
+uniform vec4 uFrustumPlanes[6]; // World space, unit normals
+uniform uint uFirstBatch;
+// Pixels by unit of clip space w, and whether w is a distance
+uniform float uPixelScale;
+uniform bool uPerspective;
+uniform ivec2 uViewportSize;
+uniform int uPass;
+
+void main()
+{
+  Batch batch = batches[uFirstBatch + gl_WorkGroupID.x];
+  vec3 center = vec3(uModelMatrix * vec4(0.5 * (batch.boundsMin +
+                                                   batch.boundsMax), 1));
+  float scale = max(max(length(uModelMatrix[0].xyz),
+                        length(uModelMatrix[1].xyz)),
+      length(uModelMatrix[2].xyz));
+  float radius = 0.5 * scale * length(batch.boundsMax - batch.boundsMin);
+  for (int i = 0; i < 6; ++i) {
+    if (dot(uFrustumPlanes[i].xyz, center) + uFrustumPlanes[i].w < -radius) {
+      return;
+    }
+  }
+
+  // Level of detail: the nearest point of the sphere of the batch bounds its
+  // size in pixels, a camera inside of it draws all points
+  uint pointCount = batch.pointCount;
+  float w = (uViewProjMatrix * vec4(center, 1)).w;
+  float distance = uPerspective ? w - radius : 1.0;
+  if (distance > 0.0) {
+    float diameter = 2.0 * radius * uPixelScale / distance;
+    pointCount = uint(min(float(pointCount),
+        ceil(POINT_DENSITY * diameter * diameter)));
+  }
+
+  mat4 matrix = uViewProjMatrix * uModelMatrix;
+  uint pixelCount = uint(uViewportSize.x * uViewportSize.y);
+  for (uint i = gl_LocalInvocationID.x; i < pointCount;
+       i += gl_WorkGroupSize.x) {
+    uint pointIdx = batch.firstPoint + i;
+    vec4 clip = matrix * vec4(points[pointIdx].position, 1);
+    if (clip.w <= 0.0) {
+      continue;
+    }
+    vec3 ndc = clip.xyz / clip.w;
+#ifdef REVERSED_Z
+    float depth = ndc.z; // Zero to one clip control
+#else
+    float depth = 0.5 * ndc.z + 0.5;
+#endif
+    if (any(greaterThan(abs(ndc.xy), vec2(1))) || depth < 0.0 ||
+        depth > 1.0) {
+      continue;
+    }
+    ivec2 pixel = min(ivec2((0.5 * ndc.xy + 0.5) * vec2(uViewportSize)),
+        uViewportSize - 1);
+    uint pixelIdx = uint(pixel.y * uViewportSize.x + pixel.x);
+    // Bits of positive floats are ordered like them, inverted when the
+    // nearest depth is the largest
+#ifdef REVERSED_Z
+    uint depthKey = ~floatBitsToUint(depth);
+#else
+    uint depthKey = floatBitsToUint(depth);
+#endif
+#ifdef ATOMIC_INT64
+    atomicMin(pixels[pixelIdx], (uint64_t(depthKey) << 32) | pointIdx);
+#else
+    if (uPass == 0) {
+      atomicMin(depthKeys[pixelIdx], depthKey);
+    } else if (depthKeys[pixelIdx] == depthKey) {
+      // Of points at the same depth, any one
+      depthKeys[pixelCount + pixelIdx] = pointIdx;
+    }
+#endif
+  }
+}
@@ -0,0 +1,115 @@
+#version 430
+#ifdef ATOMIC_INT64
+#extension GL_ARB_gpu_shader_int64 : require
+#endif
+
+// Pixels of the points of --compute-points (see point_rasterize.cs.glsl),
+// drawn over the viewport by fullscreen_triangle.vs.glsl: the color and
+// depth of the nearest point of each pixel, for the depth test with the
+// other draws. Pixels without a point are discarded.
+//
+// With uFillHoles, a pixel takes the nearest point of its 3x3 neighbours
+// when it has none or when it is farther than them by more than
+// HOLE_DEPTH_RATIO: where points of a surface are sparser than the pixels,
+// the holes between them show nothing or the points behind the surface.
+
+// Same layout as PointClouds::Point
+struct Point
+{
+  vec3 position;
+  uint color; // RGBA8, linear
+};
+
+layout(std430) readonly buffer Points
+{
+  Point points[];
+};
+
+#ifdef ATOMIC_INT64
+layout(std430) readonly buffer Pixels
+{
+  uint64_t pixels[];
+};
+#else
+layout(std430) readonly buffer Pixels
+{
+  uint depthKeys[]; // Then as many indices
+};
+#endif
+
+uniform ivec2 uViewportSize;
+uniform bool uEncodeOutput; // Else the framebuffer encodes to sRGB
+uniform bool uFillHoles;
+
+layout(location = 0) out vec3 fColor;
+#ifdef DRAW_IDS
+layout(location = 1) out uint fDrawId;
+#endif
+
+const float HOLE_DEPTH_RATIO = 0.02;
+const uint NO_POINT = 0xffffffffu;
+
+// Depth key and point of pixel, NO_POINT if it has none
+uvec2 getPixel(ivec2 pixel)
+{
+  uint pixelIdx = uint(pixel.y * uViewportSize.x + pixel.x);
+#ifdef ATOMIC_INT64
+  uint64_t key = pixels[pixelIdx];
+  return uvec2(uint(key >> 32), uint(key & 0xffffffffUL));
+#else
+  return uvec2(depthKeys[pixelIdx],
+      depthKeys[uint(uViewportSize.x * uViewportSize.y) + pixelIdx]);
+#endif
+}
+
+float getDepth(uint depthKey)
+{
+#ifdef REVERSED_Z
+  return uintBitsToFloat(~depthKey);
+#else
+  return uintBitsToFloat(depthKey);
+#endif
+}
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_FragCoord.xy);
+  uvec2 nearest = getPixel(pixel);
+  if (uFillHoles) {
+    uvec2 neighbour = uvec2(NO_POINT);
+    for (int y = -1; y <= 1; ++y) {
+      for (int x = -1; x <= 1; ++x) {
+        ivec2 p = pixel + ivec2(x, y);
+        if ((x != 0 || y != 0) && all(greaterThanEqual(p, ivec2(0))) &&
+            all(lessThan(p, uViewportSize))) {
+          uvec2 candidate = getPixel(p);
+          if (candidate.x < neighbour.x) {
+            neighbour = candidate;
+          }
+        }
+      }
+    }
+    // In perspective, window depths go as the inverse of distances, or as
+    // one minus it without REVERSED_Z
+#ifdef REVERSED_Z
+    float farthest = getDepth(nearest.x) * (1.0 + HOLE_DEPTH_RATIO);
+    bool isHole = nearest.x == NO_POINT || getDepth(neighbour.x) > farthest;
+#else
+    float farthest = 1.0 - (1.0 - getDepth(nearest.x)) *
+                               (1.0 + HOLE_DEPTH_RATIO);
+    bool isHole = nearest.x == NO_POINT || getDepth(neighbour.x) < farthest;
+#endif
+    if (neighbour.x != NO_POINT && isHole) {
+      nearest = neighbour;
+    }
+  }
+  if (nearest.x == NO_POINT) {
+    discard;
+  }
+  vec3 color = unpackUnorm4x8(points[nearest.y].color).rgb;
+  fColor = uEncodeOutput ? pow(color, vec3(1.0 / 2.2)) : color;
+  gl_FragDepth = getDepth(nearest.x);
+#ifdef DRAW_IDS
+  fDrawId = 0u; // Points are not picked
+#endif
+}
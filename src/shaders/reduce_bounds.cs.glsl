@@ -0,0 +1,67 @@
+#version 430
+
+// Bounding box of the positions of a range of a vertex buffer, for
+// --gpu-bounds (see GpuReduction). Threads of all workgroups read the
+// vertices in turn, then each workgroup reduces the boxes of its threads in
+// shared memory and merges the result into the box of uRange.
+
+layout(local_size_x = 256) in;
+
+// Three floats per vertex from uFirstWord, uWordStride words apart
+layout(std430) readonly buffer Vertices
+{
+  float words[];
+};
+
+// Min then max of each range, as ordered bits (see getOrderedBits)
+layout(std430) buffer Bounds
+{
+  uint bounds[];
+};
+
+uniform uint uFirstWord;
+uniform uint uWordStride;
+uniform uint uVertexCount;
+uniform uint uRange;
+
+shared vec3 sMin[gl_WorkGroupSize.x];
+shared vec3 sMax[gl_WorkGroupSize.x];
+
+// Bits of value whose unsigned order is the order of the floats: the sign
+// bit set for positive values, all bits inverted for negative ones
+uint getOrderedBits(float value)
+{
+  uint bits = floatBitsToUint(value);
+  return (bits & 0x80000000u) != 0u ? ~bits : bits | 0x80000000u;
+}
+
+void main()
+{
+  vec3 boxMin = vec3(uintBitsToFloat(0x7f7fffffu)); // Largest float
+  vec3 boxMax = -boxMin;
+  uint threadCount = gl_NumWorkGroups.x * gl_WorkGroupSize.x;
+  for (uint i = gl_GlobalInvocationID.x; i < uVertexCount; i += threadCount) {
+    uint word = uFirstWord + i * uWordStride;
+    vec3 position = vec3(words[word], words[word + 1], words[word + 2]);
+    boxMin = min(boxMin, position);
+    boxMax = max(boxMax, position);
+  }
+
+  uint thread = gl_LocalInvocationID.x;
+  sMin[thread] = boxMin;
+  sMax[thread] = boxMax;
+  for (uint offset = gl_WorkGroupSize.x / 2; offset > 0; offset /= 2) {
+    barrier();
+    if (thread < offset) {
+      sMin[thread] = min(sMin[thread], sMin[thread + offset]);
+      sMax[thread] = max(sMax[thread], sMax[thread + offset]);
+    }
+  }
+  // Workgroups without a vertex leave the box as it is
+  if (thread == 0 && gl_WorkGroupID.x * gl_WorkGroupSize.x < uVertexCount) {
+    for (uint c = 0; c < 3; ++c) {
+      atomicMin(bounds[6 * uRange + c], getOrderedBits(sMin[0][c]));
+      atomicMax(bounds[6 * uRange + 3 + c], getOrderedBits(sMax[0][c]));
+    }
+  }
+}
@@ -0,0 +1,25 @@
+#version 430
+
+// Seeds of the jump flood of SelectionOutline: the pixels of the selected
+// draws are their own nearest selected pixel, the others have none yet
+// (-1, -1).
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(r32ui, binding = 0) readonly uniform uimage2D uDrawIds;
+layout(rg16i, binding = 1) writeonly uniform iimage2D uSeeds;
+
+uniform ivec2 uSize; // Of the draw IDs read, from the bottom left
+uniform uvec2 uSelectedDrawIds; // First and past the last
+
+void main()
+{
+  ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(texel, uSize))) {
+    return;
+  }
+  uint drawId = imageLoad(uDrawIds, texel).r;
+  bool isSelected =
+      drawId >= uSelectedDrawIds.x && drawId < uSelectedDrawIds.y;
+  imageStore(uSeeds, texel, ivec4(isSelected ? texel : ivec2(-1), 0, 0));
+}
@@ -0,0 +1,28 @@
+#version 430
+
+// Outline of SelectionOutline, drawn over the viewport by
+// fullscreen_triangle.vs.glsl and blended: the pixels around the selected
+// draws, up to uWidth pixels from the nearest of their pixels found by the
+// jump flood, antialiased over a pixel.
+
+layout(rg16i, binding = 0) readonly uniform iimage2D uSeeds;
+
+uniform vec2 uScale; // Pixels of the seeds per pixel of the viewport
+uniform float uWidth; // In pixels of the viewport
+
+// In display values
+const vec3 OUTLINE_COLOR = vec3(1, 0.6, 0);
+
+layout(location = 0) out vec4 fColor;
+
+void main()
+{
+  ivec2 texel = ivec2(gl_FragCoord.xy * uScale);
+  ivec2 seed = imageLoad(uSeeds, texel).xy;
+  if (seed.x < 0 || seed == texel) {
+    discard; // Far from the selection, or in it
+  }
+  float distance = length((vec2(seed) + 0.5) / uScale - gl_FragCoord.xy);
+  fColor = vec4(OUTLINE_COLOR,
+      1 - smoothstep(uWidth - 0.5, uWidth + 0.5, distance));
+}
@@ -0,0 +1,85 @@
+#version 430
+
+// Rates of the tiles of the shading rate image of --variable-rate-shading
+// (see ShadingRateImage), from a frame of the scene: a workgroup per tile
+// sums the luminance of its pixels and their squares in shared memory for
+// their standard deviation. Flat tiles are shaded per 2x2 or 4x4 pixels, and
+// tiles far from the center of the view at least per 2x2 or 4x4 pixels.
+//
+// Luminances are compressed to [0, 1) first, as l / (1 + l), for thresholds
+// close to what the tone mapped image shows.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+// Indices in the palette of ShadingRateImage
+const uint RATE_1X1 = 0u;
+const uint RATE_2X2 = 1u;
+const uint RATE_4X4 = 2u;
+
+// Standard deviations above which tiles are shaded per pixel, or per 2x2
+const float DETAILED_DEVIATION = 0.04;
+const float TEXTURED_DEVIATION = 0.015;
+// Distances to the center of the view, over half its diagonal, beyond which
+// tiles are shaded at least per 2x2, or per 4x4
+const float PERIPHERAL_DISTANCE = 0.6;
+const float FAR_PERIPHERAL_DISTANCE = 0.85;
+
+const uint THREAD_COUNT = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+
+uniform sampler2D uColor;
+uniform ivec2 uViewportSize;
+uniform ivec2 uTileSize; // In pixels, one texel of uRates
+layout(r8ui) writeonly uniform uimage2D uRates;
+
+shared vec2 sSums[THREAD_COUNT]; // Of luminances, then of their squares
+shared uint sCounts[THREAD_COUNT];
+
+void main()
+{
+  ivec2 tile = ivec2(gl_WorkGroupID.xy);
+  ivec2 first = tile * uTileSize;
+  ivec2 last = min(first + uTileSize, uViewportSize);
+  vec2 sums = vec2(0);
+  uint count = 0u;
+  for (int y = first.y + int(gl_LocalInvocationID.y); y < last.y;
+       y += int(gl_WorkGroupSize.y)) {
+    for (int x = first.x + int(gl_LocalInvocationID.x); x < last.x;
+         x += int(gl_WorkGroupSize.x)) {
+      vec3 color = texelFetch(uColor, ivec2(x, y), 0).rgb;
+      float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+      luminance /= 1.0 + max(luminance, 0.0);
+      sums += vec2(luminance, luminance * luminance);
+      ++count;
+    }
+  }
+
+  uint thread = gl_LocalInvocationIndex;
+  sSums[thread] = sums;
+  sCounts[thread] = count;
+  for (uint offset = THREAD_COUNT / 2u; offset > 0u; offset /= 2u) {
+    barrier();
+    if (thread < offset) {
+      sSums[thread] += sSums[thread + offset];
+      sCounts[thread] += sCounts[thread + offset];
+    }
+  }
+  if (thread != 0u || sCounts[0] == 0u) {
+    return;
+  }
+
+  vec2 moments = sSums[0] / float(sCounts[0]);
+  float deviation = sqrt(max(moments.y - moments.x * moments.x, 0.0));
+  uint rate = deviation > DETAILED_DEVIATION
+                  ? RATE_1X1
+                  : (deviation > TEXTURED_DEVIATION ? RATE_2X2 : RATE_4X4);
+
+  vec2 center = 0.5 * vec2(first + last);
+  vec2 halfSize = 0.5 * vec2(uViewportSize);
+  float distance = length(center - halfSize) / length(halfSize);
+  if (distance > FAR_PERIPHERAL_DISTANCE) {
+    rate = RATE_4X4;
+  } else if (distance > PERIPHERAL_DISTANCE) {
+    rate = max(rate, RATE_2X2);
+  }
+  imageStore(uRates, tile, uvec4(rate));
+}
@@ -0,0 +1,143 @@
+#version 430
+
+// Skinning and morphing of the vertices of one draw of --compute-skinning
+// (see SkinningPrepass), written once so that every pass drawing them reads
+// them as they are.
+//
+// The weighted deltas of the morph targets of the draw are added to its bind
+// pose first, then, with uFirstJoint, the vertices are skinned to world space
+// like forward.vs.glsl does. Without joints they stay in object space.
+
+layout(local_size_x = 64) in;
+
+// Same layouts as SkinningPrepass::SourceVertex and TargetDelta, w of
+// normal and tangent deltas unused
+struct SourceVertex
+{
+  vec3 position;
+  float u;
+  vec3 normal;
+  float v;
+  vec4 joints; // Integers, in the skin of the draw
+  vec4 weights;
+  vec4 tangent; // Handedness in w
+};
+
+struct TargetDelta
+{
+  vec3 position;
+  uint vertex; // Of the deltas of sparse targets, sorted
+  vec4 normal;
+  vec4 tangent;
+};
+
+layout(std430) readonly buffer SourceVertices
+{
+  SourceVertex sources[];
+};
+
+layout(std430) readonly buffer TargetDeltas
+{
+  TargetDelta deltas[];
+};
+
+// Same layout as SkinningPrepass::OutputVertex, drawn as 12 floats per
+// vertex
+layout(std430) writeonly buffer SkinnedVertices
+{
+  float skinned[];
+};
+
+// Of all the skins of the model, see JointPalette
+layout(std430) readonly buffer Joints
+{
+  mat4 jointMatrices[];
+};
+
+const int MAX_MORPH_TARGETS = 8; // SkinningPrepass::MAX_MORPH_TARGETS
+
+uniform uint uFirstSource; // In sources
+uniform uint uVertexCount;
+uniform uint uFirstOutput; // In vertices of skinned
+uniform int uFirstJoint; // -1 without a skin
+uniform int uTargetCount;
+// First delta of the vertices of each morph target of the draw, in deltas,
+// its number of deltas if sparse (0 if it has one per vertex) and its weight
+uniform uint uFirstDeltas[MAX_MORPH_TARGETS];
+uniform uint uSparseCounts[MAX_MORPH_TARGETS];
+uniform float uTargetWeights[MAX_MORPH_TARGETS];
+
+// Index in deltas of the delta of vertex for target t, -1 if a sparse target
+// does not move it
+int findDelta(int t, uint vertex)
+{
+  if (uSparseCounts[t] == 0u) {
+    return int(uFirstDeltas[t] + vertex);
+  }
+  uint first = uFirstDeltas[t];
+  uint last = first + uSparseCounts[t];
+  while (first < last) {
+    uint middle = (first + last) / 2u;
+    if (deltas[middle].vertex < vertex) {
+      first = middle + 1u;
+    } else {
+      last = middle;
+    }
+  }
+  return first < uFirstDeltas[t] + uSparseCounts[t] &&
+                 deltas[first].vertex == vertex
+             ? int(first)
+             : -1;
+}
+
+void main()
+{
+  uint vertex = gl_GlobalInvocationID.x;
+  if (vertex >= uVertexCount) {
+    return;
+  }
+  SourceVertex source = sources[uFirstSource + vertex];
+  vec3 position = source.position;
+  vec3 normal = source.normal;
+  vec4 tangent = source.tangent;
+  for (int t = 0; t < uTargetCount; ++t) {
+    int deltaIndex = findDelta(t, vertex);
+    if (deltaIndex < 0) {
+      continue;
+    }
+    TargetDelta delta = deltas[deltaIndex];
+    position += uTargetWeights[t] * delta.position;
+    normal += uTargetWeights[t] * delta.normal.xyz;
+    tangent.xyz += uTargetWeights[t] * delta.tangent.xyz;
+  }
+
+  if (uFirstJoint >= 0) {
+    ivec4 joints = uFirstJoint + ivec4(source.joints);
+    mat4 skinMatrix = source.weights.x * jointMatrices[joints.x] +
+                      source.weights.y * jointMatrices[joints.y] +
+                      source.weights.z * jointMatrices[joints.z] +
+                      source.weights.w * jointMatrices[joints.w];
+    position = vec3(skinMatrix * vec4(position, 1));
+    // Cofactors, as in forward.vs.glsl
+    mat3 m = mat3(skinMatrix);
+    float orientation = sign(dot(m[0], cross(m[1], m[2])));
+    normal = orientation *
+             (mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1])) *
+                 normal);
+    tangent = vec4(m * tangent.xyz, orientation * tangent.w);
+  }
+
+  uint offset = 12 * (uFirstOutput + vertex);
+  skinned[offset] = position.x;
+  skinned[offset + 1] = position.y;
+  skinned[offset + 2] = position.z;
+  skinned[offset + 3] = normal.x;
+  skinned[offset + 4] = normal.y;
+  skinned[offset + 5] = normal.z;
+  skinned[offset + 6] = source.u;
+  skinned[offset + 7] = source.v;
+  skinned[offset + 8] = tangent.x;
+  skinned[offset + 9] = tangent.y;
+  skinned[offset + 10] = tangent.z;
+  skinned[offset + 11] = tangent.w;
+}
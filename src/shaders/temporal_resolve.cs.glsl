@@ -0,0 +1,107 @@
+#version 430
+
+// Temporal antialiasing of --taa (see TemporalAntiAliasing): blends the frame
+// of the scene, drawn with a subpixel jitter, into the history of the
+// previous frames reprojected to its pixels, and writes the result as the
+// next history.
+//
+// Each pixel is taken back to the previous view through its depth, which
+// follows the camera, minus the motion of its draw written by the forward
+// shaders. Edges follow the nearest depth of their 3x3 neighborhood, and the
+// history is clamped to the colors of that neighborhood: what it shows that
+// the current frame does not, disoccluded or changed, is rejected instead of
+// ghosting. Colors are weighted by the inverse of their luminance, bright
+// subpixel highlights do not flicker.
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// Weight of the current frame, the history averages about the last ten
+const float CURRENT_WEIGHT = 0.1;
+
+uniform sampler2D uColor; // Linear values
+uniform sampler2D uDepth;
+uniform sampler2D uMotion; // Texture coordinates, see forward.vs.glsl
+uniform sampler2D uHistory; // Filtered linearly
+layout(rgba16f) uniform writeonly image2D uDestination;
+
+uniform ivec2 uViewportSize;
+// Of uViewportSize in uHistory, which is larger, its texels in [0, 1]
+uniform vec2 uHistoryScale;
+uniform int uHasHistory;
+// Normalized device coordinates of the current frame, without its jitter, to
+// the clip space of the previous frame
+uniform mat4 uReprojectionMatrix;
+uniform vec2 uJitter; // Normalized device coordinates
+
+float getLuminance(vec3 color)
+{
+  return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Normalized device depth, the near plane at 1 with REVERSED_Z
+// (--reversed-z), at -1 otherwise
+float toNdcDepth(float depth)
+{
+#ifdef REVERSED_Z
+  return depth;
+#else
+  return 2 * depth - 1;
+#endif
+}
+
+bool isNearer(float depth, float other)
+{
+#ifdef REVERSED_Z
+  return depth > other;
+#else
+  return depth < other;
+#endif
+}
+
+void main()
+{
+  ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+  if (any(greaterThanEqual(pixel, uViewportSize))) {
+    return;
+  }
+
+  vec4 current = texelFetch(uColor, pixel, 0);
+  vec3 minColor = current.rgb;
+  vec3 maxColor = current.rgb;
+  ivec2 nearestPixel = pixel;
+  float nearestDepth = texelFetch(uDepth, pixel, 0).r;
+  for (int y = -1; y <= 1; ++y) {
+    for (int x = -1; x <= 1; ++x) {
+      ivec2 neighbor = clamp(pixel + ivec2(x, y), ivec2(0), uViewportSize - 1);
+      vec3 color = texelFetch(uColor, neighbor, 0).rgb;
+      minColor = min(minColor, color);
+      maxColor = max(maxColor, color);
+      float depth = texelFetch(uDepth, neighbor, 0).r;
+      if (isNearer(depth, nearestDepth)) {
+        nearestDepth = depth;
+        nearestPixel = neighbor;
+      }
+    }
+  }
+
+  vec4 result = current;
+  vec2 ndc = (vec2(pixel) + 0.5) / vec2(uViewportSize) * 2 - 1 - uJitter;
+  vec4 previous =
+      uReprojectionMatrix * vec4(ndc, toNdcDepth(nearestDepth), 1);
+  if (uHasHistory != 0 && previous.w > 0) {
+    vec2 previousTexCoords = previous.xy / previous.w * 0.5 + 0.5 -
+                             texelFetch(uMotion, nearestPixel, 0).rg;
+    if (all(greaterThanEqual(previousTexCoords, vec2(0))) &&
+        all(lessThanEqual(previousTexCoords, vec2(1)))) {
+      vec4 history =
+          textureLod(uHistory, previousTexCoords * uHistoryScale, 0);
+      history.rgb = clamp(history.rgb, minColor, maxColor);
+      float currentWeight = CURRENT_WEIGHT / (1 + getLuminance(current.rgb));
+      float historyWeight =
+          (1 - CURRENT_WEIGHT) / (1 + getLuminance(history.rgb));
+      result = (currentWeight * current + historyWeight * history) /
+               (currentWeight + historyWeight);
+    }
+  }
+  imageStore(uDestination, pixel, result);
+}
@@ -0,0 +1,52 @@
+#version 430
+
+// Pixels of the scene drawn for --hdr (see ToneMapping), drawn over the
+// viewport by fullscreen_triangle.vs.glsl: linear colors scaled by the
+// exposure of adapt_exposure.cs.glsl and mapped to [0, 1] by the filmic ACES
+// curve (as fitted by Krzysztof Narkowicz), with their depth.
+//
+// With BLOOM (--bloom), the blur of the scene by Bloom is first mixed in by
+// BLOOM_STRENGTH, from the average of its levels in the level 0 of uBloom,
+// at half the resolution and upsampled bilinearly.
+
+layout(std430) readonly buffer Exposure
+{
+  float exposure;
+  uint bins[];
+};
+
+uniform sampler2D uColor;
+uniform sampler2D uDepth;
+uniform bool uEncodeOutput; // Else the framebuffer encodes to sRGB
+#ifdef BLOOM
+uniform sampler2D uBloom;
+uniform ivec2 uBloomSize; // Of the region of level 0 of the scene
+uniform int uBloomLevelCount;
+
+const float BLOOM_STRENGTH = 0.04;
+#endif
+
+out vec4 fColor;
+
+vec3 toneMapACES(vec3 color)
+{
+  return clamp((color * (2.51 * color + 0.03)) /
+                   (color * (2.43 * color + 0.59) + 0.14),
+      0.0, 1.0);
+}
+
+void main()
+{
+  ivec2 texel = ivec2(gl_FragCoord.xy);
+  vec4 color = texelFetch(uColor, texel, 0);
+#ifdef BLOOM
+  vec2 position =
+      clamp(gl_FragCoord.xy * 0.5, vec2(0.5), vec2(uBloomSize) - 0.5);
+  vec3 bloom =
+      textureLod(uBloom, position / vec2(textureSize(uBloom, 0)), 0.0).rgb;
+  color.rgb = mix(color.rgb, bloom / float(uBloomLevelCount), BLOOM_STRENGTH);
+#endif
+  vec3 mapped = toneMapACES(color.rgb * exposure);
+  fColor = vec4(uEncodeOutput ? pow(mapped, vec3(1.0 / 2.2)) : mapped, color.a);
+  gl_FragDepth = texelFetch(uDepth, texel, 0).r;
+}
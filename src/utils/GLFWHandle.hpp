@@ -16,7 +16,12 @@
 class GLFWHandle
 {
 public:
-  GLFWHandle(int width, int height, const char *title, bool visible = true)
+  // With srgbCapable, the default framebuffer is requested in sRGB (see
+  // GL_FRAMEBUFFER_SRGB). Contexts shared with the window afterwards are
+  // created in the same contextMode.
+  GLFWHandle(int width, int height, const char *title, bool visible = true,
+      bool srgbCapable = false,
+      GLContextMode contextMode = GLContextMode::Debug)
   {
     if (!glfwInit()) {
       std::cerr << "Unable to init GLFW.\n";
@@ -30,9 +35,14 @@ public:
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT,
+        contextMode == GLContextMode::Debug ? GLFW_TRUE : GLFW_FALSE);
+    // Ignored by GLFW without GLX/WGL_ARB_create_context_no_error
+    glfwWindowHint(GLFW_CONTEXT_NO_ERROR,
+        contextMode == GLContextMode::NoError ? GLFW_TRUE : GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
     glfwWindowHint(GLFW_SAMPLES, 4);
+    glfwWindowHint(GLFW_SRGB_CAPABLE, srgbCapable ? GLFW_TRUE : GLFW_FALSE);
 
     m_pWindow =
         glfwCreateWindow(int(width), int(height), title, nullptr, nullptr);
@@ -51,7 +61,7 @@ public:
       throw std::runtime_error("Unable to init OpenGL.\n");
     }
 
-    initGLDebugOutput();
+    initGLDebugOutput(contextMode);
 
     // Setup ImGui
     ImGui::CreateContext();
@@ -83,6 +93,14 @@ public:
     return glm::ivec2(displayWidth, displayHeight);
   }
 
+  // In screen coordinates, like the size given to the constructor
+  glm::ivec2 windowSize() const
+  {
+    int width, height;
+    glfwGetWindowSize(m_pWindow, &width, &height);
+    return glm::ivec2(width, height);
+  }
+
   void swapBuffers() const { glfwSwapBuffers(m_pWindow); }
 
   GLFWwindow *window() { return m_pWindow; }
@@ -98,18 +116,11 @@ inline void imguiNewFrame()
   ImGui::NewFrame();
 }
 
-inline void imguiRenderFrame()
+// Build the draw data of the frame
+inline void imguiEndFrame() { ImGui::Render(); }
+
+// Draw the draw data last built, as many times as needed until the next frame
+inline void imguiDrawFrame()
 {
-  ImGui::Render();
   ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
-
-inline void printGLVersion()
-{
-  GLint glVersion[2];
-  glGetIntegerv(GL_MAJOR_VERSION, &glVersion[0]);
-  glGetIntegerv(GL_MINOR_VERSION, &glVersion[1]);
-
-  std::clog << "OpenGL Version " << glVersion[0] << "." << glVersion[1]
-            << std::endl;
-}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#include "accessor_view.hpp"
+
+const unsigned char *getDenseAccessorData(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, size_t &byteStride)
+{
+  if (accessor.sparse.isSparse || accessor.bufferView < 0 ||
+      size_t(accessor.bufferView) >= model.bufferViews.size()) {
+    return nullptr;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  if (bufferView.buffer < 0 || size_t(bufferView.buffer) >= bufferBytes.size()) {
+    return nullptr;
+  }
+  const auto &bytes = bufferBytes[bufferView.buffer];
+  const auto elementSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+             tinygltf::GetNumComponentsInType(accessor.type));
+  byteStride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+  const auto offset = bufferView.byteOffset + accessor.byteOffset;
+  if (!bytes.data || (accessor.count && offset + byteStride *
+                                                 (accessor.count - 1) +
+                                                 elementSize >
+                                             bytes.size)) {
+    return nullptr;
+  }
+  return bytes.data + offset;
+}
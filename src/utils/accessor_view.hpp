@@ -0,0 +1,204 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Typed views on the elements of glTF accessors. The component type of an
+// accessor is only known at runtime: dispatchComponents switches on it once
+// and calls a generic function with the matching AccessorView, so that the
+// loops of that function are instantiated per component type, without a
+// branch per element, instead of going through readComponent.
+//
+//   dispatchAccessor(model, bufferBytes, accessor, [&](const auto &view) {
+//     for (size_t i = 0; i < view.size(); ++i) {
+//       bounds.extend(view.template get<3>(i));
+//     }
+//   });
+
+// Value of a component of type T as a float, see readComponent
+template <typename T, bool Normalized>
+inline float decodeComponent(T value)
+{
+  if constexpr (!Normalized || std::is_floating_point<T>::value) {
+    return float(value);
+  } else if constexpr (std::is_signed<T>::value) {
+    return std::max(value / float(std::numeric_limits<T>::max()), -1.f);
+  } else {
+    return value / float(std::numeric_limits<T>::max());
+  }
+}
+
+// Elements of count components of type T, one every byteStride bytes from
+// data. Components are read with memcpy, data needs no alignment.
+template <typename T, bool Normalized = false>
+class AccessorView
+{
+public:
+  using Component = T;
+
+  static const bool NORMALIZED = Normalized;
+
+  AccessorView(const unsigned char *data, size_t byteStride, size_t count) :
+      m_data(data), m_byteStride(byteStride), m_count(count)
+  {
+  }
+
+  size_t size() const { return m_count; }
+
+  // Component c of element i as stored
+  T raw(size_t i, size_t c = 0) const
+  {
+    T value;
+    std::memcpy(&value, m_data + m_byteStride * i + sizeof(T) * c,
+        sizeof(value));
+    return value;
+  }
+
+  // Component c of element i as a float
+  float operator()(size_t i, size_t c = 0) const
+  {
+    return decodeComponent<T, Normalized>(raw(i, c));
+  }
+
+  // The first N components of element i as floats
+  template <int N>
+  glm::vec<N, float> get(size_t i) const
+  {
+    glm::vec<N, float> value;
+    for (int c = 0; c < N; ++c) {
+      value[c] = (*this)(i, size_t(c));
+    }
+    return value;
+  }
+
+private:
+  const unsigned char *m_data;
+  size_t m_byteStride;
+  size_t m_count;
+};
+
+// Call f with the view of type T, normalized if it is an 8 or 16 bits integer
+// and normalized is true, see dispatchComponents
+template <typename T, typename F>
+bool callWithView(bool normalized, const unsigned char *data,
+    size_t byteStride, size_t count, F &f)
+{
+  if constexpr (std::is_integral<T>::value && sizeof(T) < 4) {
+    if (normalized) {
+      f(AccessorView<T, true>(data, byteStride, count));
+      return true;
+    }
+  } else if (normalized) {
+    return false;
+  }
+  f(AccessorView<T>(data, byteStride, count));
+  return true;
+}
+
+// Call f(view) with the AccessorView of componentType (a glTF component type)
+// and normalized. Returns false, without calling f, for doubles and for
+// normalized 32 bits integers or floats, which glTF does not allow.
+template <typename F>
+bool dispatchComponents(int componentType, bool normalized,
+    const unsigned char *data, size_t byteStride, size_t count, F &&f)
+{
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    return callWithView<int8_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return callWithView<uint8_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    return callWithView<int16_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return callWithView<uint16_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_INT:
+    return callWithView<int32_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    return callWithView<uint32_t>(normalized, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    return callWithView<float>(normalized, data, byteStride, count, f);
+  default:
+    return false;
+  }
+}
+
+// Start of the elements of a dense accessor, with their stride in
+// byteStride. Returns nullptr for sparse accessors, accessors without
+// bufferView and those out of their buffer.
+const unsigned char *getDenseAccessorData(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, size_t &byteStride);
+
+// dispatchComponents on a dense accessor of model. Returns false, without
+// calling f, if getDenseAccessorData fails or for other component types.
+template <typename F>
+bool dispatchAccessor(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, F &&f)
+{
+  size_t byteStride = 0;
+  const auto data =
+      getDenseAccessorData(model, bufferBytes, accessor, byteStride);
+  return data && dispatchComponents(accessor.componentType,
+                     accessor.normalized, data, byteStride, accessor.count,
+                     std::forward<F>(f));
+}
+
+// dispatchComponents for indices, whose components must be 8, 16 or 32 bits
+// unsigned integers: view.raw(i) is then index i. f is only instantiated for
+// these three views.
+template <typename F>
+bool dispatchIndexComponents(int componentType, const unsigned char *data,
+    size_t byteStride, size_t count, F &&f)
+{
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return callWithView<uint8_t>(false, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return callWithView<uint16_t>(false, data, byteStride, count, f);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    return callWithView<uint32_t>(false, data, byteStride, count, f);
+  default:
+    return false;
+  }
+}
+
+// Same for a dense index accessor of model
+template <typename F>
+bool dispatchIndices(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, F &&f)
+{
+  size_t byteStride = 0;
+  const auto data =
+      getDenseAccessorData(model, bufferBytes, accessor, byteStride);
+  return data && !accessor.normalized &&
+         dispatchIndexComponents(accessor.componentType, data, byteStride,
+             accessor.count, std::forward<F>(f));
+}
+
+// Indices of an index accessor, see dispatchIndices. indices is a vector of
+// uint32_t, std::vector or ScratchVector.
+template <typename Indices>
+bool readIndexAccessor(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, Indices &indices)
+{
+  return dispatchIndices(model, bufferBytes, accessor, [&](const auto &view) {
+    indices.resize(view.size());
+    for (size_t i = 0; i < view.size(); ++i) {
+      indices[i] = view.raw(i);
+    }
+  });
+}
@@ -0,0 +1,139 @@
+#include "allocation_stats.hpp"
+
+#if defined(GLTF_VIEWER_ALLOCATION_STATS) && defined(__GLIBC__)
+
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> allocatedBytes{0};
+std::atomic<size_t> allocationCount{0};
+std::atomic<size_t> liveBytes{0};
+std::atomic<size_t> peakLiveBytes{0};
+
+// Trivial, no allocation nor destructor in the allocator itself
+thread_local size_t threadAllocatedBytes = 0;
+thread_local size_t threadAllocationCount = 0;
+
+void countAllocation(size_t bytes)
+{
+  allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  const auto live =
+      liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  auto peak = peakLiveBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakLiveBytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+  threadAllocatedBytes += bytes;
+  ++threadAllocationCount;
+}
+
+} // namespace
+
+void *operator new(size_t size)
+{
+  // Unique pointers for zero sizes
+  auto pointer = std::malloc(size ? size : 1);
+  while (!pointer) {
+    const auto handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+    pointer = std::malloc(size ? size : 1);
+  }
+  countAllocation(malloc_usable_size(pointer));
+  return pointer;
+}
+
+void operator delete(void *pointer) noexcept
+{
+  if (pointer) {
+    liveBytes.fetch_sub(
+        malloc_usable_size(pointer), std::memory_order_relaxed);
+    std::free(pointer);
+  }
+}
+
+// The other forms go through these two, but aligned ones which are not
+// counted
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return operator new(size, std::nothrow);
+}
+
+void operator delete[](void *pointer) noexcept { operator delete(pointer); }
+
+void operator delete(void *pointer, size_t) noexcept
+{
+  operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+  operator delete(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+  operator delete(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+  operator delete(pointer);
+}
+
+bool hasAllocationStats() { return true; }
+
+AllocationCounts getAllocationCounts()
+{
+  return AllocationCounts{allocatedBytes.load(std::memory_order_relaxed),
+      allocationCount.load(std::memory_order_relaxed),
+      liveBytes.load(std::memory_order_relaxed)};
+}
+
+AllocationCounts getThreadAllocationCounts()
+{
+  return AllocationCounts{threadAllocatedBytes, threadAllocationCount, 0};
+}
+
+size_t getPeakLiveBytes()
+{
+  return peakLiveBytes.load(std::memory_order_relaxed);
+}
+
+void resetPeakLiveBytes()
+{
+  peakLiveBytes.store(
+      liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#else
+
+bool hasAllocationStats() { return false; }
+
+AllocationCounts getAllocationCounts() { return {}; }
+
+AllocationCounts getThreadAllocationCounts() { return {}; }
+
+size_t getPeakLiveBytes() { return 0; }
+
+void resetPeakLiveBytes() {}
+
+#endif
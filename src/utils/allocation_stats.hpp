@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+// Heap allocations of the process through the global operator new and
+// delete, counted by replacements of them in builds configured with
+// GLTF_VIEWER_ALLOCATION_STATS (glibc only, the size of a freed block comes
+// from malloc_usable_size). Other builds count nothing.
+//
+// Totals and the live bytes of the process are relaxed atomics, each thread
+// also counts what it allocates in counters of its own: the share of a phase
+// of loading its thread allocated tells it from the work of the job system.
+// Allocations through malloc (stb_image, Draco) are not counted.
+struct AllocationCounts
+{
+  size_t allocatedBytes = 0; // Since the start of the process or thread
+  size_t allocationCount = 0;
+  size_t liveBytes = 0; // Of the process, 0 for a thread
+};
+
+// False if the build does not count allocations
+bool hasAllocationStats();
+
+AllocationCounts getAllocationCounts();
+
+// Allocated by the calling thread
+AllocationCounts getThreadAllocationCounts();
+
+// Highest live bytes of the process since the last reset
+size_t getPeakLiveBytes();
+
+// Reset the peak of live bytes to the current live bytes
+void resetPeakLiveBytes();
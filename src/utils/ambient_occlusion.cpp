@@ -0,0 +1,76 @@
+#include "ambient_occlusion.hpp"
+#include "gpu_memory.hpp"
+
+AmbientOcclusion::AmbientOcclusion(GLProgram occlusionProgram,
+    GLProgram blurProgram, GLuint depthUnit, GLuint normalUnit) :
+    m_occlusionProgram(std::move(occlusionProgram)),
+    m_blurProgram(std::move(blurProgram))
+{
+  m_occlusionProgram.setUniform(
+      m_occlusionProgram.getUniformLocation("uDepth"), GLint(depthUnit));
+  m_occlusionProgram.setUniform(
+      m_occlusionProgram.getUniformLocation("uNormal"), GLint(normalUnit));
+  m_occlusionProgram.setUniform(
+      m_occlusionProgram.getUniformLocation("uDestination"), 0);
+  m_uInverseProjMatrix =
+      m_occlusionProgram.getUniformLocation("uInverseProjMatrix");
+  m_uProjScale = m_occlusionProgram.getUniformLocation("uProjScale");
+  m_uRadius = m_occlusionProgram.getUniformLocation("uRadius");
+  m_blurProgram.setUniform(m_blurProgram.getUniformLocation("uSource"),
+      GLint(TEXTURE_UNIT));
+  m_blurProgram.setUniform(
+      m_blurProgram.getUniformLocation("uDestination"), 0);
+}
+
+void AmbientOcclusion::compute(GLsizei width, GLsizei height,
+    const glm::mat4 &projMatrix, float radius)
+{
+  const auto halfWidth = (width + 1) / 2;
+  const auto halfHeight = (height + 1) / 2;
+  if (halfWidth != m_width || halfHeight != m_height) {
+    m_textures = GLTextures::generate(2);
+    for (size_t i = 0; i < m_textures.size(); ++i) {
+      glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16F, halfWidth, halfHeight);
+      // Only read with texelFetch, but must be complete for it
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D,
+        GLsizei(m_textures.size()), m_textures.data());
+    m_width = halfWidth;
+    m_height = halfHeight;
+  }
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  const auto groupsX = GLuint((m_width + 7) / 8);
+  const auto groupsY = GLuint((m_height + 7) / 8);
+
+  m_occlusionProgram.use();
+  m_occlusionProgram.setUniform(
+      m_uInverseProjMatrix, glm::inverse(projMatrix));
+  // Tiles of output images scale projMatrix, and the G-buffer with it
+  m_occlusionProgram.setUniform(
+      m_uProjScale, 0.5f * projMatrix[1][1] * float(height));
+  m_occlusionProgram.setUniform(m_uRadius, radius);
+  glBindImageTexture(
+      0, m_textures[0], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+  glDispatchCompute(groupsX, groupsY, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  m_blurProgram.use();
+  glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_textures[0]);
+  glBindSampler(TEXTURE_UNIT, 0);
+  glBindImageTexture(
+      0, m_textures[1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+  glDispatchCompute(groupsX, groupsY, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  glBindTexture(GL_TEXTURE_2D, m_textures[1]);
+  glActiveTexture(GL_TEXTURE0);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16F);
+  glUseProgram(GLuint(previousProgram));
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Screen space ambient occlusion of --ssao, computed from the depth and
+// normals of a GBuffer at half its resolution by ambient_occlusion.cs.glsl,
+// then smoothed by the bilateral blur of ambient_occlusion_blur.cs.glsl. The
+// lighting pass upsamples it, weighting the texels around each pixel by the
+// similarity of their depths with the one of the pixel.
+class AmbientOcclusion
+{
+public:
+  // Texture unit of the occlusion read by the lighting pass, after those of
+  // GBuffer
+  static const GLuint TEXTURE_UNIT = 13;
+
+  // Of the two shaders, reading the G-buffer from the units depthUnit and
+  // normalUnit
+  AmbientOcclusion(GLProgram occlusionProgram, GLProgram blurProgram,
+      GLuint depthUnit, GLuint normalUnit);
+
+  AmbientOcclusion(const AmbientOcclusion &) = delete;
+
+  AmbientOcclusion &operator=(const AmbientOcclusion &) = delete;
+
+  // Compute the occlusion of the width x height G-buffer drawn with the
+  // perspective projMatrix, within radius (view space), and bind it to
+  // TEXTURE_UNIT. The current program is left in use.
+  void compute(GLsizei width, GLsizei height, const glm::mat4 &projMatrix,
+      float radius);
+
+private:
+  GLProgram m_occlusionProgram;
+  GLProgram m_blurProgram;
+  GLint m_uInverseProjMatrix = -1;
+  GLint m_uProjScale = -1;
+  GLint m_uRadius = -1;
+  GLsizei m_width = 0; // Of the half resolution textures
+  GLsizei m_height = 0;
+  GLTextures m_textures; // Occlusion, then blurred
+};
@@ -0,0 +1,315 @@
+#include "animation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ANIMATION_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ANIMATION_NEON
+#endif
+
+namespace {
+
+// Sum of values[i] * weights[i], the interpolations of all paths are weighted
+// sums of keys: 2 for linear ones, 4 for cubic splines
+glm::vec4 weightedSum(
+    const glm::vec4 *const *values, const float *weights, size_t count)
+{
+  glm::vec4 result;
+#if defined(ANIMATION_SSE)
+  auto sum = _mm_setzero_ps();
+  for (size_t i = 0; i < count; ++i) {
+    sum = _mm_add_ps(sum,
+        _mm_mul_ps(_mm_loadu_ps(&(*values[i])[0]), _mm_set1_ps(weights[i])));
+  }
+  _mm_storeu_ps(&result[0], sum);
+#elif defined(ANIMATION_NEON)
+  auto sum = vdupq_n_f32(0.f);
+  for (size_t i = 0; i < count; ++i) {
+    sum = vmlaq_n_f32(sum, vld1q_f32(&(*values[i])[0]), weights[i]);
+  }
+  vst1q_f32(&result[0], sum);
+#else
+  result = glm::vec4(0);
+  for (size_t i = 0; i < count; ++i) {
+    result += *values[i] * weights[i];
+  }
+#endif
+  return result;
+}
+
+glm::vec4 lerp(const glm::vec4 &a, const glm::vec4 &b, float t)
+{
+  const glm::vec4 *values[] = {&a, &b};
+  const float weights[] = {1.f - t, t};
+  return weightedSum(values, weights, 2);
+}
+
+// Spherical interpolation along the shortest arc, linear between close
+// rotations where the sine vanishes
+glm::vec4 slerp(const glm::vec4 &a, const glm::vec4 &b, float t)
+{
+  const auto cosAngle = glm::dot(a, b);
+  const auto sign = cosAngle < 0.f ? -1.f : 1.f;
+  const auto absCos = std::abs(cosAngle);
+  float weights[] = {1.f - t, sign * t};
+  if (absCos < 0.9995f) {
+    const auto angle = std::acos(absCos);
+    const auto invSin = 1.f / std::sin(angle);
+    weights[0] = std::sin((1.f - t) * angle) * invSin;
+    weights[1] = sign * std::sin(t * angle) * invSin;
+  }
+  const glm::vec4 *values[] = {&a, &b};
+  return glm::normalize(weightedSum(values, weights, 2));
+}
+
+} // namespace
+
+AnimationPlayer::AnimationPlayer(const tinygltf::Model &model,
+    const FlatScene &scene, const std::vector<BufferBytes> &bufferBytes)
+{
+  const auto flatNodes = getNodeEntries(scene, model.nodes.size());
+  // Index of each node in the TRS arrays, -1 until it is animated
+  std::vector<int> animatedNodes(model.nodes.size(), -1);
+  const auto getAnimatedNode = [&](int nodeIdx) {
+    auto &animatedNode = animatedNodes[nodeIdx];
+    if (animatedNode < 0) {
+      const auto &node = model.nodes[nodeIdx];
+      const auto readVec = [](const std::vector<double> &values,
+                               const glm::vec4 &defaultValue) {
+        auto result = defaultValue;
+        for (size_t c = 0; c < std::min(values.size(), size_t(4)); ++c) {
+          result[int(c)] = float(values[c]);
+        }
+        return result;
+      };
+      animatedNode = int(m_flatNodes.size());
+      m_flatNodes.push_back(size_t(flatNodes[nodeIdx]));
+      const auto i = m_restTrs.size();
+      m_restTrs.resize(i + 1);
+      m_restTrs.setTranslation(
+          i, glm::vec3(readVec(node.translation, glm::vec4(0))));
+      m_restTrs.setRotation(i, readVec(node.rotation, glm::vec4(0, 0, 0, 1)));
+      m_restTrs.setScale(
+          i, glm::vec3(readVec(node.scale, glm::vec4(1, 1, 1, 0))));
+    }
+    return size_t(animatedNode);
+  };
+
+  std::vector<float> times, values;
+  for (const auto &animation : model.animations) {
+    Animation clip;
+    clip.name = animation.name;
+    clip.firstChannel = m_channels.size();
+    for (const auto &gltfChannel : animation.channels) {
+      const auto nodeIdx = gltfChannel.target_node;
+      const auto &path = gltfChannel.target_path;
+      if (gltfChannel.sampler < 0 ||
+          size_t(gltfChannel.sampler) >= animation.samplers.size() ||
+          nodeIdx < 0 || size_t(nodeIdx) >= model.nodes.size() ||
+          flatNodes[nodeIdx] < 0 || !model.nodes[nodeIdx].matrix.empty() ||
+          (path != "translation" && path != "rotation" && path != "scale")) {
+        continue;
+      }
+      const auto &sampler = animation.samplers[gltfChannel.sampler];
+      Channel channel;
+      channel.path = path == "translation"
+                         ? Path::Translation
+                         : (path == "rotation" ? Path::Rotation : Path::Scale);
+      channel.interpolation =
+          sampler.interpolation == "STEP"
+              ? Interpolation::Step
+              : (sampler.interpolation == "CUBICSPLINE"
+                        ? Interpolation::CubicSpline
+                        : Interpolation::Linear);
+      const auto componentCount = channel.path == Path::Rotation ? 4 : 3;
+      const auto valuesPerKey =
+          channel.interpolation == Interpolation::CubicSpline ? 3 : 1;
+      if (!readFloatAccessor(model, bufferBytes, sampler.input, 1, times) ||
+          !readFloatAccessor(
+              model, bufferBytes, sampler.output, componentCount, values) ||
+          times.empty() ||
+          values.size() !=
+              times.size() * size_t(valuesPerKey * componentCount)) {
+        continue;
+      }
+
+      channel.node = getAnimatedNode(nodeIdx);
+      channel.firstKey = m_times.size();
+      channel.keyCount = times.size();
+      channel.firstValue = m_values.size();
+      m_times.insert(m_times.end(), times.begin(), times.end());
+      for (size_t i = 0; i < values.size(); i += size_t(componentCount)) {
+        glm::vec4 value(0);
+        for (int c = 0; c < componentCount; ++c) {
+          value[c] = values[i + size_t(c)];
+        }
+        m_values.push_back(value);
+      }
+      clip.duration = std::max(clip.duration, times.back());
+      clip.nodes.push_back(channel.node);
+      m_channels.push_back(channel);
+    }
+    clip.channelCount = m_channels.size() - clip.firstChannel;
+    std::sort(begin(clip.nodes), end(clip.nodes));
+    clip.nodes.erase(
+        std::unique(begin(clip.nodes), end(clip.nodes)), end(clip.nodes));
+    m_animations.push_back(std::move(clip));
+  }
+
+  m_trs = m_restTrs;
+  m_sampledAnimation = m_animations.size();
+}
+
+glm::vec4 AnimationPlayer::sampleChannel(Channel &channel, float time)
+{
+  const auto *times = m_times.data() + channel.firstKey;
+  const auto *values = m_values.data() + channel.firstValue;
+  const auto keyCount = channel.keyCount;
+  const auto isCubic = channel.interpolation == Interpolation::CubicSpline;
+  // Value of key k, the middle one of its 3 with cubic splines
+  const auto keyValue = [&](size_t k) {
+    return isCubic ? values[3 * k + 1] : values[k];
+  };
+  if (time <= times[0] || keyCount == 1) {
+    channel.cursor = 0;
+    return keyValue(0);
+  }
+  if (time >= times[keyCount - 1]) {
+    channel.cursor = keyCount - 1;
+    return keyValue(keyCount - 1);
+  }
+
+  // times[cursor] <= time < times[cursor + 1]
+  auto &cursor = channel.cursor;
+  if (cursor >= keyCount - 1 || times[cursor] > time) {
+    cursor = size_t(std::upper_bound(times, times + keyCount, time) - times) -
+             1;
+  } else {
+    while (times[cursor + 1] <= time) {
+      ++cursor;
+    }
+  }
+
+  if (channel.interpolation == Interpolation::Step) {
+    return keyValue(cursor);
+  }
+  const auto keyDuration = times[cursor + 1] - times[cursor];
+  const auto t = (time - times[cursor]) / keyDuration;
+  if (!isCubic) {
+    return channel.path == Path::Rotation
+               ? slerp(values[cursor], values[cursor + 1], t)
+               : lerp(values[cursor], values[cursor + 1], t);
+  }
+  // Hermite spline between the values of the keys, with the out tangent of
+  // the first one and the in tangent of the second one
+  const auto t2 = t * t;
+  const auto t3 = t2 * t;
+  const glm::vec4 *splineValues[] = {&values[3 * cursor + 1],
+      &values[3 * cursor + 2], &values[3 * (cursor + 1) + 1],
+      &values[3 * (cursor + 1)]};
+  const float weights[] = {2.f * t3 - 3.f * t2 + 1.f,
+      (t3 - 2.f * t2 + t) * keyDuration, -2.f * t3 + 3.f * t2,
+      (t3 - t2) * keyDuration};
+  const auto value = weightedSum(splineValues, weights, 4);
+  return channel.path == Path::Rotation ? glm::normalize(value) : value;
+}
+
+void AnimationPlayer::sample(size_t animationIdx, float time, FlatScene &scene)
+{
+  if (m_sampledAnimation != animationIdx &&
+      m_sampledAnimation < m_animations.size()) {
+    // Back to rest, nodes also animated by animationIdx are sampled below
+    const auto &restNodes = m_animations[m_sampledAnimation].nodes;
+    for (const auto node : restNodes) {
+      m_trs.setTranslation(node, m_restTrs.translation(node));
+      m_trs.setRotation(node, m_restTrs.rotation(node));
+      m_trs.setScale(node, m_restTrs.scale(node));
+    }
+    setLocalMatrices(restNodes, scene);
+  }
+  m_sampledAnimation = animationIdx;
+
+  const auto &animation = m_animations[animationIdx];
+  if (animation.duration > 0.f) {
+    time = std::fmod(time, animation.duration);
+    if (time < 0.f) {
+      time += animation.duration;
+    }
+  }
+  for (size_t i = 0; i < animation.channelCount; ++i) {
+    auto &channel = m_channels[animation.firstChannel + i];
+    const auto value = sampleChannel(channel, time);
+    switch (channel.path) {
+    case Path::Translation:
+      m_trs.setTranslation(channel.node, glm::vec3(value));
+      break;
+    case Path::Rotation:
+      m_trs.setRotation(channel.node, value);
+      break;
+    case Path::Scale:
+      m_trs.setScale(channel.node, glm::vec3(value));
+      break;
+    }
+  }
+  setLocalMatrices(animation.nodes, scene);
+}
+
+void AnimationPlayer::setLocalMatrices(
+    const std::vector<size_t> &nodes, FlatScene &scene)
+{
+  m_localMatrices.resize(nodes.size());
+  composeTrsMatrices(m_trs, nodes.data(), nodes.size(), m_localMatrices.data());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    setLocalMatrix(scene, m_flatNodes[nodes[i]], m_localMatrices[i]);
+  }
+}
+
+AnimationPlayback::AnimationPlayback(bool playing) :
+    m_isPlaying(playing), m_isPoseDirty(playing)
+{
+}
+
+void AnimationPlayback::selectAnimation(size_t animation)
+{
+  m_animation = animation;
+  seek(0.f);
+}
+
+void AnimationPlayback::seek(float time)
+{
+  m_time = time;
+  m_isPoseDirty = true;
+}
+
+bool AnimationPlayback::advance(
+    const AnimationPlayer &player, double elapsedSeconds)
+{
+  if (!m_isPlaying) {
+    return false;
+  }
+  const auto duration = player.duration(m_animation);
+  m_time += m_speed * float(elapsedSeconds);
+  if (duration > 0.f) {
+    m_time = std::fmod(m_time, duration);
+    m_time += m_time < 0.f ? duration : 0.f;
+  }
+  m_isPoseDirty = true;
+  return true;
+}
+
+void AnimationPlayback::samplePose(AnimationPlayer &player, FlatScene &scene)
+{
+  if (!m_isPoseDirty) {
+    return;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  player.sample(m_animation, m_time, scene);
+  const auto end = std::chrono::steady_clock::now();
+  m_sampleSeconds = std::chrono::duration<double>(end - start).count();
+  m_isPoseDirty = false;
+}
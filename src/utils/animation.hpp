@@ -0,0 +1,160 @@
+#pragma once
+
+#include "flat_scene.hpp"
+#include "gltf.hpp"
+#include "transforms.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Playback of the animations of a glTF model on its flattened scene.
+//
+// The keyframes of all channels are converted at load time into contiguous
+// arrays of times and of values (structure of arrays), values being 4 floats
+// wide so that they are interpolated with SSE or NEON. Each channel keeps the
+// key of its last sample as a cursor: playing forward only moves it to the
+// next keys, a binary search is only done when the time goes back (looping,
+// seeking). Sampled translations, rotations and scales are written in the TRS
+// arrays of the animated nodes, composed into local matrices 4 nodes at a
+// time (see composeTrsMatrices) and set in the flat scene (see
+// setLocalMatrix).
+//
+// Morph target weights are not animated, primitives are only morphed with the
+// weights of their node or mesh by --compute-skinning. Channels whose
+// accessors cannot be read, or targeting nodes not in the scene or with a
+// matrix (glTF forbids it), are skipped.
+class AnimationPlayer
+{
+public:
+  AnimationPlayer(const tinygltf::Model &model, const FlatScene &scene,
+      const std::vector<BufferBytes> &bufferBytes);
+
+  size_t animationCount() const { return m_animations.size(); }
+
+  const std::string &animationName(size_t animation) const
+  {
+    return m_animations[animation].name;
+  }
+
+  // Time of the last key of the animation, in seconds
+  float duration(size_t animation) const
+  {
+    return m_animations[animation].duration;
+  }
+
+  // Set the local matrices of the nodes animated by animation to their pose
+  // at time seconds, wrapped in its duration. Nodes the previously sampled
+  // animation alone animated go back to their rest pose.
+  void sample(size_t animation, float time, FlatScene &scene);
+
+private:
+  enum class Path
+  {
+    Translation,
+    Rotation,
+    Scale
+  };
+
+  enum class Interpolation
+  {
+    Step,
+    Linear,
+    CubicSpline
+  };
+
+  struct Channel
+  {
+    size_t node = 0; // Index in the TRS arrays
+    Path path = Path::Translation;
+    Interpolation interpolation = Interpolation::Linear;
+    size_t firstKey = 0; // In m_times
+    size_t keyCount = 0;
+    // In m_values, one per key, or 3 with cubic splines: in tangent, value
+    // and out tangent
+    size_t firstValue = 0;
+    size_t cursor = 0; // Key at or before the last sampled time
+  };
+
+  struct Animation
+  {
+    std::string name;
+    float duration = 0;
+    size_t firstChannel = 0; // In m_channels
+    size_t channelCount = 0;
+    std::vector<size_t> nodes; // Animated ones, indices in the TRS arrays
+  };
+
+  // Value of the channel at time, moving its cursor
+  glm::vec4 sampleChannel(Channel &channel, float time);
+
+  // Compose the TRS of nodes, indices in the TRS arrays, and set them as
+  // local matrices of their entries of scene
+  void setLocalMatrices(const std::vector<size_t> &nodes, FlatScene &scene);
+
+  std::vector<Animation> m_animations;
+  std::vector<Channel> m_channels;
+  std::vector<float> m_times;
+  std::vector<glm::vec4> m_values; // Rotations as x, y, z, w
+
+  // Of each animated node: its entry in the flat scene, current and rest
+  // TRS
+  std::vector<size_t> m_flatNodes;
+  TrsArrays m_trs;
+  TrsArrays m_restTrs;
+  // Local matrices of the nodes composed by setLocalMatrices
+  std::vector<glm::mat4> m_localMatrices;
+
+  size_t m_sampledAnimation; // animationCount() if none
+};
+
+// Animation of an AnimationPlayer played by the viewer: its time advances
+// with the frames while playing, and the pose of the scene is only sampled
+// again once it changed.
+class AnimationPlayback
+{
+public:
+  // Playing from time 0 of the first animation, whose pose is not sampled yet
+  // if playing
+  explicit AnimationPlayback(bool playing);
+
+  size_t animation() const { return m_animation; }
+
+  // From time 0
+  void selectAnimation(size_t animation);
+
+  bool isPlaying() const { return m_isPlaying; }
+  void setPlaying(bool playing) { m_isPlaying = playing; }
+
+  // In seconds
+  float time() const { return m_time; }
+  void seek(float time);
+
+  // Seconds of animation per second, negative to play backward
+  float speed() const { return m_speed; }
+  void setSpeed(float speed) { m_speed = speed; }
+
+  // Advance the time by elapsedSeconds if playing, wrapped in the duration of
+  // the animation. Returns true if it advanced.
+  bool advance(const AnimationPlayer &player, double elapsedSeconds);
+
+  // True when the pose in the scene is not the one at time()
+  bool isPoseDirty() const { return m_isPoseDirty; }
+
+  // Sample the pose at time() into scene if dirty
+  void samplePose(AnimationPlayer &player, FlatScene &scene);
+
+  // CPU seconds of the last samplePose which sampled
+  double sampleSeconds() const { return m_sampleSeconds; }
+
+private:
+  size_t m_animation = 0;
+  bool m_isPlaying;
+  float m_time = 0.f;
+  float m_speed = 1.f;
+  bool m_isPoseDirty;
+  double m_sampleSeconds = 0.;
+};
@@ -0,0 +1,108 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+
+namespace {
+
+void writeJsonString(std::ostream &output, const std::string &string)
+{
+  output << '"';
+  for (const auto c : string) {
+    if (c == '"' || c == '\\') {
+      output << '\\';
+    }
+    if (static_cast<unsigned char>(c) >= 0x20) {
+      output << c;
+    }
+  }
+  output << '"';
+}
+
+void writeTimeSummary(
+    std::ostream &output, const char *name, const std::vector<double> &times)
+{
+  const auto summary = summarizeTimes(times);
+  output << "  \"" << name << "\": {\"mean\": " << summary.mean
+         << ", \"p50\": " << summary.p50 << ", \"p99\": " << summary.p99
+         << ", \"min\": " << summary.min << ", \"max\": " << summary.max
+         << ", \"samples\": [";
+  for (size_t i = 0; i < times.size(); ++i) {
+    output << (i ? ", " : "") << times[i] * 1000.;
+  }
+  output << "]}";
+}
+
+void writeGLMessages(
+    std::ostream &output, const std::vector<GLMessageStats> &messages)
+{
+  output << "  \"glMessages\": [";
+  for (size_t i = 0; i < messages.size(); ++i) {
+    const auto &stats = messages[i];
+    output << (i ? ",\n" : "\n") << "    {\"source\": ";
+    writeJsonString(output, stats.source);
+    output << ", \"type\": ";
+    writeJsonString(output, stats.type);
+    output << ", \"severity\": ";
+    writeJsonString(output, stats.severity);
+    output << ", \"id\": " << stats.id << ", \"count\": " << stats.count
+           << ", \"message\": ";
+    writeJsonString(output, stats.message);
+    output << ", \"zones\": {";
+    for (size_t j = 0; j < stats.zoneCounts.size(); ++j) {
+      output << (j ? ", " : "");
+      writeJsonString(output, stats.zoneCounts[j].first);
+      output << ": " << stats.zoneCounts[j].second;
+    }
+    output << "}}";
+  }
+  output << "\n  ]";
+}
+
+} // namespace
+
+TimeSummary summarizeTimes(std::vector<double> times)
+{
+  TimeSummary summary;
+  if (times.empty()) {
+    return summary;
+  }
+  std::sort(begin(times), end(times));
+  const auto percentile = [&](double p) {
+    const auto rank = size_t(std::ceil(p * double(times.size())));
+    return times[std::max(rank, size_t(1)) - 1] * 1000.;
+  };
+  summary.mean = std::accumulate(begin(times), end(times), 0.) /
+                 double(times.size()) * 1000.;
+  summary.p50 = percentile(0.5);
+  summary.p99 = percentile(0.99);
+  summary.min = times.front() * 1000.;
+  summary.max = times.back() * 1000.;
+  return summary;
+}
+
+void writeBenchmarkJson(std::ostream &output, const BenchmarkInfo &info,
+    const BenchmarkTimes &times)
+{
+  output << std::fixed << std::setprecision(4) << "{\n  \"model\": ";
+  writeJsonString(output, info.model);
+  output << ",\n  \"renderer\": ";
+  writeJsonString(output, info.renderer);
+  output << ",\n  \"width\": " << info.width
+         << ",\n  \"height\": " << info.height
+         << ",\n  \"frames\": " << info.frameCount
+         << ",\n  \"warmupFrames\": " << info.warmupFrameCount << ",\n";
+  writeTimeSummary(output, "cpu", times.cpuTimes);
+  output << ",\n";
+  writeTimeSummary(output, "gpu", times.gpuTimes);
+  output << ",\n";
+  writeTimeSummary(output, "frame", times.frameTimes);
+  if (!info.glMessages.empty()) {
+    output << ",\n";
+    writeGLMessages(output, info.glMessages);
+  }
+  output << "\n}\n";
+}
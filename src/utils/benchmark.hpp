@@ -0,0 +1,47 @@
+#pragma once
+
+#include "gl_debug_output.hpp"
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Times of the measured frames of a benchmark, in seconds
+struct BenchmarkTimes
+{
+  std::vector<double> cpuTimes; // Drawing a frame, without swapping buffers
+  std::vector<double> gpuTimes; // Of the draws of a frame, timer queries
+  std::vector<double> frameTimes; // From the start of a frame to the next
+};
+
+// Of a series of times, in milliseconds
+struct TimeSummary
+{
+  double mean = 0;
+  double p50 = 0; // Nearest rank percentiles
+  double p99 = 0;
+  double min = 0;
+  double max = 0;
+};
+
+TimeSummary summarizeTimes(std::vector<double> times);
+
+// What was benchmarked, written with the summaries of the times
+struct BenchmarkInfo
+{
+  std::string model;
+  std::string renderer; // GL_RENDERER
+  size_t width = 0;
+  size_t height = 0;
+  size_t frameCount = 0;
+  size_t warmupFrameCount = 0;
+  // With --collect-gl-messages, see getCollectedGLMessages
+  std::vector<GLMessageStats> glMessages;
+};
+
+// One JSON object, with cpu, gpu and frame objects of mean, p50, p99, min
+// and max in milliseconds and the samples array of the time of each frame,
+// and a glMessages array if info has messages
+void writeBenchmarkJson(std::ostream &output, const BenchmarkInfo &info,
+    const BenchmarkTimes &times);
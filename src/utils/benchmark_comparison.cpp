@@ -0,0 +1,275 @@
+#include "benchmark_comparison.hpp"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+
+// Top level JSON objects following each other in text, as appended by
+// several runs of bench to the same file
+std::vector<std::string> splitJsonObjects(const std::string &text)
+{
+  std::vector<std::string> objects;
+  size_t begin = 0;
+  int depth = 0;
+  bool inString = false;
+  bool escaped = false;
+  for (size_t i = 0; i < text.size(); ++i) {
+    const auto c = text[i];
+    if (inString) {
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        inString = false;
+      }
+    } else if (c == '"') {
+      inString = true;
+    } else if (c == '{') {
+      if (depth++ == 0) {
+        begin = i;
+      }
+    } else if (c == '}' && depth > 0 && --depth == 0) {
+      objects.push_back(text.substr(begin, i + 1 - begin));
+    }
+  }
+  return objects;
+}
+
+std::vector<double> readSamples(const nlohmann::json &metric)
+{
+  std::vector<double> samples;
+  const auto it = metric.find("samples");
+  if (it != metric.end() && it->is_array()) {
+    for (const auto &sample : *it) {
+      if (sample.is_number()) {
+        samples.push_back(sample.get<double>());
+      }
+    }
+  }
+  return samples;
+}
+
+double getMedian(std::vector<double> values)
+{
+  if (values.empty()) {
+    return 0;
+  }
+  const auto middle = begin(values) + values.size() / 2;
+  std::nth_element(begin(values), middle, end(values));
+  if (values.size() % 2) {
+    return *middle;
+  }
+  return (*middle + *std::max_element(begin(values), middle)) / 2;
+}
+
+void readBenchmarkFile(
+    const fs::path &path, std::vector<BenchmarkResult> &results)
+{
+  std::ifstream file(path.string(), std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("unable to read " + path.string());
+  }
+  const std::string text{
+      std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+  const auto objects = splitJsonObjects(text);
+  if (objects.empty()) {
+    throw std::runtime_error("no benchmark in " + path.string());
+  }
+  for (const auto &object : objects) {
+    const auto json = nlohmann::json::parse(object, nullptr, false);
+    if (json.is_discarded() || !json.is_object() || !json.count("model") ||
+        !json["model"].is_string()) {
+      throw std::runtime_error(path.string() + " is not valid bench JSON");
+    }
+    const auto model = json["model"].get<std::string>();
+    const auto width = json.value("width", size_t(0));
+    const auto height = json.value("height", size_t(0));
+    auto result = std::find_if(begin(results), end(results),
+        [&](const BenchmarkResult &result) {
+          return result.model == model && result.width == width &&
+                 result.height == height;
+        });
+    const auto isNew = result == end(results);
+    if (isNew) {
+      results.emplace_back();
+      result = end(results) - 1;
+      result->model = model;
+      result->width = width;
+      result->height = height;
+    }
+    for (int metric = 0; metric < METRIC_COUNT; ++metric) {
+      const auto it =
+          json.find(getBenchmarkMetricName(BenchmarkMetric(metric)));
+      if (it == json.end() || !it->is_object()) {
+        continue;
+      }
+      const auto samples = readSamples(*it);
+      auto &pooled = result->samples[metric];
+      pooled.insert(end(pooled), begin(samples), end(samples));
+      if (!pooled.empty()) {
+        result->medians[metric] = getMedian(pooled);
+      } else if (isNew) {
+        result->medians[metric] = it->value("p50", 0.);
+      }
+    }
+  }
+}
+
+} // namespace
+
+const char *getBenchmarkMetricName(BenchmarkMetric metric)
+{
+  switch (metric) {
+  case CpuMetric:
+    return "cpu";
+  case GpuMetric:
+    return "gpu";
+  case FrameMetric:
+    return "frame";
+  default:
+    return "";
+  }
+}
+
+std::vector<BenchmarkResult> loadBenchmarkResults(const fs::path &path)
+{
+  std::vector<BenchmarkResult> results;
+  if (!fs::is_directory(path)) {
+    readBenchmarkFile(path, results);
+    return results;
+  }
+  std::vector<fs::path> files;
+  for (fs::directory_iterator it(path), end; it != end; ++it) {
+    if (it->path().extension() == ".json") {
+      files.push_back(it->path());
+    }
+  }
+  std::sort(begin(files), end(files));
+  for (const auto &file : files) {
+    readBenchmarkFile(file, results);
+  }
+  return results;
+}
+
+double getMannWhitneyPValue(
+    const std::vector<double> &a, const std::vector<double> &b)
+{
+  if (a.empty() || b.empty()) {
+    return 1;
+  }
+  // Ranks of the pooled values, the mean rank for ties
+  std::vector<std::pair<double, bool>> values; // Value, of a
+  values.reserve(a.size() + b.size());
+  for (const auto value : a) {
+    values.emplace_back(value, true);
+  }
+  for (const auto value : b) {
+    values.emplace_back(value, false);
+  }
+  std::sort(begin(values), end(values));
+  const auto n = double(values.size());
+  double rankSumA = 0;
+  double tieCorrection = 0; // Sum of t^3 - t over groups of t ties
+  for (size_t i = 0; i < values.size();) {
+    auto j = i;
+    while (j < values.size() && values[j].first == values[i].first) {
+      ++j;
+    }
+    const auto rank = double(i + j + 1) / 2; // Mean of ranks i + 1 to j
+    for (auto k = i; k < j; ++k) {
+      rankSumA += values[k].second ? rank : 0;
+    }
+    const auto t = double(j - i);
+    tieCorrection += t * t * t - t;
+    i = j;
+  }
+  const auto nA = double(a.size());
+  const auto nB = double(b.size());
+  const auto u = rankSumA - nA * (nA + 1) / 2;
+  const auto mean = nA * nB / 2;
+  const auto variance =
+      nA * nB / 12 * ((n + 1) - tieCorrection / (n * (n - 1)));
+  if (variance <= 0) {
+    return 1;
+  }
+  const auto z = std::max(std::abs(u - mean) - 0.5, 0.) / std::sqrt(variance);
+  return std::min(std::erfc(z / std::sqrt(2.)), 1.);
+}
+
+std::vector<BenchmarkComparison> compareBenchmarks(
+    const std::vector<BenchmarkResult> &baseline,
+    const std::vector<BenchmarkResult> &candidate,
+    const BenchmarkThresholds &thresholds)
+{
+  std::vector<BenchmarkComparison> comparisons;
+  for (const auto &before : baseline) {
+    const auto after = std::find_if(begin(candidate), end(candidate),
+        [&](const BenchmarkResult &result) {
+          return result.model == before.model &&
+                 result.width == before.width &&
+                 result.height == before.height;
+        });
+    if (after == end(candidate)) {
+      continue;
+    }
+    for (int metric = 0; metric < METRIC_COUNT; ++metric) {
+      if (before.medians[metric] <= 0 || after->medians[metric] <= 0) {
+        continue;
+      }
+      BenchmarkComparison comparison;
+      comparison.model = before.model;
+      comparison.width = before.width;
+      comparison.height = before.height;
+      comparison.metric = BenchmarkMetric(metric);
+      comparison.baselineMedian = before.medians[metric];
+      comparison.candidateMedian = after->medians[metric];
+      comparison.change =
+          comparison.candidateMedian / comparison.baselineMedian - 1;
+      const auto hasSamples =
+          !before.samples[metric].empty() && !after->samples[metric].empty();
+      comparison.pValue = getMannWhitneyPValue(
+          before.samples[metric], after->samples[metric]);
+      comparison.regression =
+          comparison.change > thresholds.maxIncreases[metric] &&
+          (!hasSamples || comparison.pValue < thresholds.significance);
+      comparisons.push_back(comparison);
+    }
+  }
+  return comparisons;
+}
+
+void writeBenchmarkComparisonCsvHeader(std::ostream &output)
+{
+  output << "model,width,height,metric,baseline_ms,candidate_ms,"
+            "change_percent,p_value,regression\n";
+}
+
+void writeBenchmarkComparisonCsvRow(
+    std::ostream &output, const BenchmarkComparison &comparison)
+{
+  // Quoted, model paths may contain commas
+  output << '"';
+  for (const auto c : comparison.model) {
+    output << (c == '"' ? "\"\"" : std::string(1, c));
+  }
+  const auto flags = output.flags();
+  const auto precision = output.precision();
+  output << '"' << ',' << comparison.width << ',' << comparison.height << ','
+         << getBenchmarkMetricName(comparison.metric) << ','
+         << std::fixed << std::setprecision(4) << comparison.baselineMedian
+         << ',' << comparison.candidateMedian << ','
+         << std::setprecision(2) << comparison.change * 100 << ','
+         << std::setprecision(6) << comparison.pValue << ','
+         << (comparison.regression ? 1 : 0) << '\n';
+  output.flags(flags);
+  output.precision(precision);
+}
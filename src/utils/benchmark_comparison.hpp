@@ -0,0 +1,87 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Comparison of the results of two sets of benchmarks, written by bench, to
+// gate upgrades of the viewer on a reference corpus: a metric regresses if
+// its median grows by more than a threshold and the frame times of the two
+// sets are unlikely to be samples of the same distribution (two-sided
+// Mann-Whitney U test).
+
+enum BenchmarkMetric
+{
+  CpuMetric,
+  GpuMetric,
+  FrameMetric,
+  METRIC_COUNT
+};
+
+// Name of the metric in the JSON of bench: cpu, gpu or frame
+const char *getBenchmarkMetricName(BenchmarkMetric metric);
+
+// Frame times of the runs of bench of a model at a resolution, pooled
+struct BenchmarkResult
+{
+  std::string model;
+  size_t width = 0;
+  size_t height = 0;
+  // Milliseconds, empty for results written before bench wrote samples
+  std::array<std::vector<double>, METRIC_COUNT> samples;
+  // Of the samples, or of the first run if it has none
+  std::array<double, METRIC_COUNT> medians = {};
+};
+
+// Results of a JSON file of bench, several objects may follow each other, or
+// of all .json files of a directory. Throws std::runtime_error if some file
+// cannot be read or parsed.
+std::vector<BenchmarkResult> loadBenchmarkResults(const fs::path &path);
+
+// Two-sided p-value of the Mann-Whitney U test of two samples, from the
+// normal approximation with tie and continuity corrections. 1 if a sample
+// is empty or all values are tied.
+double getMannWhitneyPValue(
+    const std::vector<double> &a, const std::vector<double> &b);
+
+struct BenchmarkThresholds
+{
+  // Relative growth of the median of each metric tolerated, 0.05 for 5%
+  std::array<double, METRIC_COUNT> maxIncreases = {0.05, 0.05, 0.05};
+  // p-value under which a difference is significant
+  double significance = 0.01;
+};
+
+struct BenchmarkComparison
+{
+  std::string model;
+  size_t width = 0;
+  size_t height = 0;
+  BenchmarkMetric metric = CpuMetric;
+  double baselineMedian = 0; // Milliseconds
+  double candidateMedian = 0;
+  double change = 0; // Relative, 0.1 for 10% slower
+  // 1 (never significant alone) if either result has no samples, only the
+  // threshold then decides
+  double pValue = 1;
+  bool regression = false;
+};
+
+// Compare the results of the same model and resolution, for each metric
+// measured by both (a median of 0 is not, as GPU times without timer
+// queries). Results of models of only one set are skipped.
+std::vector<BenchmarkComparison> compareBenchmarks(
+    const std::vector<BenchmarkResult> &baseline,
+    const std::vector<BenchmarkResult> &candidate,
+    const BenchmarkThresholds &thresholds);
+
+// One row per comparison: model,width,height,metric,baseline_ms,
+// candidate_ms,change_percent,p_value,regression
+void writeBenchmarkComparisonCsvHeader(std::ostream &output);
+
+void writeBenchmarkComparisonCsvRow(
+    std::ostream &output, const BenchmarkComparison &comparison);
@@ -0,0 +1,324 @@
+#include "block_compression.hpp"
+#include "ktx2.hpp"
+#include "parallel.hpp"
+#include "texture_uploader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// VK_FORMAT_* of the KTX2 files written
+const uint32_t VK_FORMAT_BC4_UNORM_BLOCK = 139;
+const uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+const uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+const uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+
+// Weights of the second endpoint for the 4 bits indices of BC7, out of 64.
+// weights[15 - i] is 64 - weights[i].
+const int bc7Weights[16] = {
+    0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// Writes bits in a zeroed block from its least significant bit on
+struct BitWriter
+{
+  uint8_t *data;
+  size_t bit = 0;
+
+  void write(uint32_t value, int bitCount)
+  {
+    for (auto i = 0; i < bitCount; ++i, ++bit) {
+      data[bit / 8] |= uint8_t(((value >> i) & 1) << (bit % 8));
+    }
+  }
+};
+
+int interpolateBc7(int endpoint0, int endpoint1, int weight)
+{
+  return ((64 - weight) * endpoint0 + weight * endpoint1 + 32) >> 6;
+}
+
+} // namespace
+
+void encodeBc4Block(const uint8_t pixels[64], int channel, uint8_t block[8])
+{
+  auto minValue = 255;
+  auto maxValue = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    minValue = std::min(minValue, int(pixels[4 * i + channel]));
+    maxValue = std::max(maxValue, int(pixels[4 * i + channel]));
+  }
+  block[0] = uint8_t(maxValue);
+  block[1] = uint8_t(minValue);
+  std::memset(block + 2, 0, 6);
+  if (maxValue == minValue) {
+    return; // All indices 0
+  }
+  // With the first value greater, indices 0 and 1 are the extremes and 2 to
+  // 7 interpolate them
+  int palette[8] = {maxValue, minValue};
+  for (auto i = 2; i < 8; ++i) {
+    palette[i] = ((8 - i) * maxValue + (i - 1) * minValue) / 7;
+  }
+  uint64_t indices = 0;
+  for (size_t i = 0; i < 16; ++i) {
+    const int value = pixels[4 * i + channel];
+    uint64_t best = 0;
+    for (uint64_t j = 1; j < 8; ++j) {
+      if (std::abs(palette[j] - value) < std::abs(palette[best] - value)) {
+        best = j;
+      }
+    }
+    indices |= best << (3 * i);
+  }
+  for (size_t i = 0; i < 6; ++i) {
+    block[2 + i] = uint8_t(indices >> (8 * i));
+  }
+}
+
+void encodeBc5Block(const uint8_t pixels[64], uint8_t block[16])
+{
+  encodeBc4Block(pixels, 0, block);
+  encodeBc4Block(pixels, 1, block + 8);
+}
+
+void encodeBc7Block(const uint8_t pixels[64], uint8_t block[16])
+{
+  float mean[4] = {};
+  for (size_t i = 0; i < 16; ++i) {
+    for (size_t c = 0; c < 4; ++c) {
+      mean[c] += pixels[4 * i + c] / 16.f;
+    }
+  }
+  float covariance[4][4] = {};
+  for (size_t i = 0; i < 16; ++i) {
+    float offset[4];
+    for (size_t c = 0; c < 4; ++c) {
+      offset[c] = pixels[4 * i + c] - mean[c];
+    }
+    for (size_t a = 0; a < 4; ++a) {
+      for (size_t b = 0; b < 4; ++b) {
+        covariance[a][b] += offset[a] * offset[b];
+      }
+    }
+  }
+
+  // Principal axis by power iterations, from the channel varying the most
+  float axis[4] = {};
+  size_t maxChannel = 0;
+  for (size_t c = 1; c < 4; ++c) {
+    if (covariance[c][c] > covariance[maxChannel][maxChannel]) {
+      maxChannel = c;
+    }
+  }
+  axis[maxChannel] = 1.f;
+  for (auto iteration = 0; iteration < 8; ++iteration) {
+    float next[4] = {};
+    auto largest = 0.f;
+    for (size_t a = 0; a < 4; ++a) {
+      for (size_t b = 0; b < 4; ++b) {
+        next[a] += covariance[a][b] * axis[b];
+      }
+      largest = std::max(largest, std::abs(next[a]));
+    }
+    if (largest == 0.f) {
+      break; // A uniform block, its endpoints are the mean
+    }
+    for (size_t c = 0; c < 4; ++c) {
+      axis[c] = next[c] / largest;
+    }
+  }
+  auto squaredLength = 0.f;
+  for (const auto value : axis) {
+    squaredLength += value * value;
+  }
+  const auto inverseLength =
+      squaredLength > 0.f ? 1.f / std::sqrt(squaredLength) : 0.f;
+  for (auto &value : axis) {
+    value *= inverseLength;
+  }
+
+  // Endpoints at the extremes of the projections of the pixels on the axis
+  auto minProjection = 0.f;
+  auto maxProjection = 0.f;
+  for (size_t i = 0; i < 16; ++i) {
+    auto projection = 0.f;
+    for (size_t c = 0; c < 4; ++c) {
+      projection += (pixels[4 * i + c] - mean[c]) * axis[c];
+    }
+    minProjection = std::min(minProjection, projection);
+    maxProjection = std::max(maxProjection, projection);
+  }
+  // 7 bits per channel and a bit shared by the channels of an endpoint,
+  // whichever is closest
+  int quantized[2][4];
+  int pBits[2];
+  for (size_t e = 0; e < 2; ++e) {
+    const auto projection = e == 0 ? minProjection : maxProjection;
+    auto bestError = -1.f;
+    for (auto pBit = 0; pBit < 2; ++pBit) {
+      int candidate[4];
+      auto error = 0.f;
+      for (size_t c = 0; c < 4; ++c) {
+        const auto value = std::min(
+            std::max(mean[c] + projection * axis[c], 0.f), 255.f);
+        candidate[c] =
+            std::min(std::max(int(std::lround((value - pBit) / 2)), 0), 127);
+        const auto difference = float(2 * candidate[c] + pBit) - value;
+        error += difference * difference;
+      }
+      if (bestError < 0.f || error < bestError) {
+        bestError = error;
+        std::copy(candidate, candidate + 4, quantized[e]);
+        pBits[e] = pBit;
+      }
+    }
+  }
+
+  int indices[16];
+  for (size_t i = 0; i < 16; ++i) {
+    auto bestError = -1;
+    for (auto j = 0; j < 16; ++j) {
+      auto error = 0;
+      for (size_t c = 0; c < 4; ++c) {
+        const auto difference =
+            interpolateBc7(2 * quantized[0][c] + pBits[0],
+                2 * quantized[1][c] + pBits[1], bc7Weights[j]) -
+            pixels[4 * i + c];
+        error += difference * difference;
+      }
+      if (bestError < 0 || error < bestError) {
+        bestError = error;
+        indices[i] = j;
+      }
+    }
+  }
+  // The most significant bit of the index of the first pixel is implicitly
+  // 0, swapping the endpoints inverts the indices
+  if (indices[0] >= 8) {
+    std::swap(quantized[0], quantized[1]);
+    std::swap(pBits[0], pBits[1]);
+    for (auto &index : indices) {
+      index = 15 - index;
+    }
+  }
+
+  std::memset(block, 0, 16);
+  BitWriter writer{block};
+  writer.write(1 << 6, 7); // Mode 6
+  for (size_t c = 0; c < 4; ++c) {
+    writer.write(uint32_t(quantized[0][c]), 7);
+    writer.write(uint32_t(quantized[1][c]), 7);
+  }
+  writer.write(uint32_t(pBits[0]), 1);
+  writer.write(uint32_t(pBits[1]), 1);
+  writer.write(uint32_t(indices[0]), 3);
+  for (size_t i = 1; i < 16; ++i) {
+    writer.write(uint32_t(indices[i]), 4);
+  }
+}
+
+BlockFormat getBlockFormat(const ImageUsage &usage)
+{
+  if (usage.color || usage.channels > 2) {
+    return BlockFormat::BC7;
+  }
+  return usage.channels == 2 ? BlockFormat::BC5 : BlockFormat::BC4;
+}
+
+bool compressImage(tinygltf::Image &image, BlockFormat format, bool srgb,
+    bool generateMipmaps)
+{
+  if (image.as_is || image.image.empty() || image.width <= 0 ||
+      image.height <= 0 || image.component < 1 || image.component > 4 ||
+      image.pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+    return false;
+  }
+  const auto levels = getTextureLevelSizes(image);
+  auto levelCount = size_t(1);
+  if (generateMipmaps) {
+    if (size_t(getImageLevelCount(image)) < levels.size()) {
+      generateMipChain(image, srgb);
+    }
+    levelCount = levels.size();
+  }
+
+  const auto blockSize = format == BlockFormat::BC4 ? size_t(8) : size_t(16);
+  const auto component = size_t(image.component);
+  std::vector<std::vector<unsigned char>> blocks(levelCount);
+  const auto *levelPixels = image.image.data();
+  for (size_t level = 0; level < levelCount; ++level) {
+    const auto width = size_t(levels[level].width);
+    const auto height = size_t(levels[level].height);
+    const auto blockColumns = (width + 3) / 4;
+    const auto blockRows = (height + 3) / 4;
+    auto &levelBlocks = blocks[level];
+    levelBlocks.resize(blockColumns * blockRows * blockSize);
+    parallelFor(blockRows, [&](size_t blockRow) {
+      uint8_t pixels[64];
+      for (size_t blockColumn = 0; blockColumn < blockColumns; ++blockColumn) {
+        // Blocks past the edges of the level repeat its last row or column
+        for (size_t y = 0; y < 4; ++y) {
+          const auto row = std::min(4 * blockRow + y, height - 1);
+          for (size_t x = 0; x < 4; ++x) {
+            const auto column = std::min(4 * blockColumn + x, width - 1);
+            const auto *source =
+                levelPixels + (row * width + column) * component;
+            auto *pixel = pixels + 4 * (4 * y + x);
+            // Missing channels read like GL samples them
+            pixel[0] = source[0];
+            pixel[1] = component > 1 ? source[1] : 0;
+            pixel[2] = component > 2 ? source[2] : 0;
+            pixel[3] = component > 3 ? source[3] : 255;
+          }
+        }
+        auto *block =
+            &levelBlocks[(blockRow * blockColumns + blockColumn) * blockSize];
+        switch (format) {
+        case BlockFormat::BC4:
+          encodeBc4Block(pixels, 0, block);
+          break;
+        case BlockFormat::BC5:
+          encodeBc5Block(pixels, block);
+          break;
+        case BlockFormat::BC7:
+          encodeBc7Block(pixels, block);
+          break;
+        }
+      }
+    });
+    levelPixels += levels[level].byteSize;
+  }
+
+  auto vkFormat = VK_FORMAT_BC7_UNORM_BLOCK;
+  if (format == BlockFormat::BC4) {
+    vkFormat = VK_FORMAT_BC4_UNORM_BLOCK;
+  } else if (format == BlockFormat::BC5) {
+    vkFormat = VK_FORMAT_BC5_UNORM_BLOCK;
+  } else if (srgb) {
+    vkFormat = VK_FORMAT_BC7_SRGB_BLOCK;
+  }
+  image.image = writeKtx2(
+      vkFormat, uint32_t(image.width), uint32_t(image.height), blocks);
+  image.as_is = true;
+  image.mimeType = "image/ktx2";
+  return true;
+}
+
+size_t compressTextures(tinygltf::Model &model)
+{
+  const auto usages = getImageUsages(model);
+  std::atomic<size_t> compressedCount{0};
+  parallelFor(model.images.size(), [&](size_t i) {
+    const auto &usage = usages[i];
+    if (usage.sampled && compressImage(model.images[i], getBlockFormat(usage),
+                             usage.color, usage.generateMipmaps)) {
+      ++compressedCount;
+    }
+  });
+  return compressedCount;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Block compression of decoded images at load time (--compress-textures),
+// stored in the scene cache so that later runs upload the blocks as they
+// are. Compressed images become KTX2 files (see writeKtx2) uploaded by
+// TextureUploader::createCompressedTexture, 4 (BC7, BC5) or 8 (BC4) times
+// smaller than their RGBA8 textures.
+//
+// The encoders are fast rather than optimal: BC7 blocks only use mode 6 (one
+// pair of RGBA endpoints along the principal axis of the block, 16 weights),
+// BC4 blocks the 8 values mode between the extremes of the block.
+enum class BlockFormat
+{
+  BC4, // Red channel, occlusion maps
+  BC5, // Red and green channels, normal maps
+  BC7 // All channels
+};
+
+// Encode a block of 4x4 RGBA8 pixels, rows first, in block
+void encodeBc4Block(const uint8_t pixels[64], int channel, uint8_t block[8]);
+
+void encodeBc5Block(const uint8_t pixels[64], uint8_t block[16]);
+
+void encodeBc7Block(const uint8_t pixels[64], uint8_t block[16]);
+
+// The format keeping the channels materials read from an image
+BlockFormat getBlockFormat(const ImageUsage &usage);
+
+// Replace a decoded 8 bits image by a KTX2 file of its blocks, with its full
+// mip chain if generateMipmaps is true (generated like generateMipChain if
+// the image does not hold it). Blocks are encoded on all hardware threads.
+// Returns false, leaving the image unchanged, for other images.
+bool compressImage(tinygltf::Image &image, BlockFormat format, bool srgb,
+    bool generateMipmaps);
+
+// compressImage of the sampled images of model, one image per job. Returns
+// the number of images compressed.
+size_t compressTextures(tinygltf::Model &model);
@@ -0,0 +1,116 @@
+#include "bloom.hpp"
+#include "gpu_memory.hpp"
+#include "texture_uploader.hpp"
+
+#include <algorithm>
+
+const GLsizei Bloom::MAX_LEVEL_COUNT;
+
+Bloom::Bloom(GLProgram downsampleProgram, GLProgram upsampleProgram) :
+    m_downsampleProgram(std::move(downsampleProgram)),
+    m_upsampleProgram(std::move(upsampleProgram))
+{
+  m_uDownsampleSourceLevel =
+      m_downsampleProgram.getUniformLocation("uSourceLevel");
+  m_uDownsampleSourceSize =
+      m_downsampleProgram.getUniformLocation("uSourceSize");
+  m_uDownsampleDestinationSize =
+      m_downsampleProgram.getUniformLocation("uDestinationSize");
+  m_uKarisAverage = m_downsampleProgram.getUniformLocation("uKarisAverage");
+  m_uUpsampleSourceLevel =
+      m_upsampleProgram.getUniformLocation("uSourceLevel");
+  m_uUpsampleSourceSize = m_upsampleProgram.getUniformLocation("uSourceSize");
+  m_uUpsampleDestinationSize =
+      m_upsampleProgram.getUniformLocation("uDestinationSize");
+  for (const auto &unit : {std::make_pair(&m_downsampleProgram, "uSource"),
+           std::make_pair(&m_upsampleProgram, "uBloom")}) {
+    glProgramUniform1i(unit.first->glId(),
+        unit.first->getUniformLocation(unit.second), 0);
+  }
+  for (const auto *program : {&m_downsampleProgram, &m_upsampleProgram}) {
+    glProgramUniform1i(program->glId(),
+        program->getUniformLocation("uDestination"), 0);
+  }
+}
+
+glm::ivec2 Bloom::getLevelSize(GLsizei width, GLsizei height, GLsizei level)
+{
+  return glm::max(glm::ivec2(width, height) >> (level + 1), glm::ivec2(1));
+}
+
+void Bloom::compute(GLuint colorTexture, GLsizei width, GLsizei height)
+{
+  const auto size = getLevelSize(width, height, 0);
+  if (size.x > m_width || size.y > m_height) {
+    m_width = std::max(size.x, m_width);
+    m_height = std::max(size.y, m_height);
+    m_levelCount =
+        std::min(MAX_LEVEL_COUNT, getMipLevelCount(m_width, m_height));
+    m_texture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+    glTexStorage2D(GL_TEXTURE_2D, m_levelCount, GL_R11F_G11F_B10F, m_width,
+        m_height);
+    // Sampled at explicit levels by the upsampling and tone mapping passes
+    glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    const auto texture = m_texture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+  }
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  glActiveTexture(GL_TEXTURE0);
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  // Complete with its own parameters, not those of a bound sampler object
+  GLint previousSampler = 0;
+  glGetIntegerv(GL_SAMPLER_BINDING, &previousSampler);
+  glBindSampler(0, 0);
+
+  m_downsampleProgram.use();
+  for (GLsizei level = 0; level < m_levelCount; ++level) {
+    const auto sourceSize = level > 0 ? getLevelSize(width, height, level - 1)
+                                      : glm::ivec2(width, height);
+    const auto destinationSize = getLevelSize(width, height, level);
+    glBindTexture(GL_TEXTURE_2D, level > 0 ? m_texture.glId() : colorTexture);
+    glUniform1i(m_uDownsampleSourceLevel, std::max(level - 1, 0));
+    glUniform2i(m_uDownsampleSourceSize, sourceSize.x, sourceSize.y);
+    glUniform2i(m_uDownsampleDestinationSize, destinationSize.x,
+        destinationSize.y);
+    glUniform1i(m_uKarisAverage, GLint(level == 0));
+    glBindImageTexture(0, m_texture.glId(), level, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+    glDispatchCompute(GLuint((destinationSize.x + 7) / 8),
+        GLuint((destinationSize.y + 7) / 8), 1);
+    // The next level reads this one
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+
+  m_upsampleProgram.use();
+  glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+  for (auto level = m_levelCount - 2; level >= 0; --level) {
+    const auto sourceSize = getLevelSize(width, height, level + 1);
+    const auto destinationSize = getLevelSize(width, height, level);
+    glUniform1i(m_uUpsampleSourceLevel, level + 1);
+    glUniform2i(m_uUpsampleSourceSize, sourceSize.x, sourceSize.y);
+    glUniform2i(
+        m_uUpsampleDestinationSize, destinationSize.x, destinationSize.y);
+    glBindImageTexture(0, m_texture.glId(), level, GL_FALSE, 0,
+        GL_READ_WRITE, GL_R11F_G11F_B10F);
+    glDispatchCompute(GLuint((destinationSize.x + 7) / 8),
+        GLuint((destinationSize.y + 7) / 8), 1);
+    // The next level, and the tone mapping pass, sample this one
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+  glBindImageTexture(
+      0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F);
+
+  glBindSampler(0, GLuint(previousSampler));
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+  glUseProgram(GLuint(previousProgram));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Bloom of the HDR scene of ToneMapping (--bloom), for bright and emissive
+// surfaces to glow.
+//
+// A GL_R11F_G11F_B10F pyramid starting at half the resolution of the scene
+// is built by compute passes: bloom_downsample.cs.glsl filters each level
+// into the next one through tiles of shared memory, then
+// bloom_upsample.cs.glsl adds each level, blurred, to the one above. Level 0
+// then holds the sum of the blurs of all levels, mixed with the scene by the
+// tone mapping pass. No pass reads or writes the full resolution but the
+// first one.
+class Bloom
+{
+public:
+  // Levels of the pyramid, fewer for small scenes
+  static const GLsizei MAX_LEVEL_COUNT = 6;
+
+  // Of the two shaders
+  Bloom(GLProgram downsampleProgram, GLProgram upsampleProgram);
+
+  Bloom(const Bloom &) = delete;
+
+  Bloom &operator=(const Bloom &) = delete;
+
+  // Blur the bottom left width x height pixels of colorTexture into the
+  // bottom left getLevelSize(width, height, 0) texels of level 0 of
+  // texture(), growing it to them if smaller
+  void compute(GLuint colorTexture, GLsizei width, GLsizei height);
+
+  // Pyramid of the last compute, its levels filtered linearly
+  GLuint texture() const { return m_texture.glId(); }
+
+  // Of the pyramid of the last compute, that level 0 sums
+  GLsizei levelCount() const { return m_levelCount; }
+
+  // Texels of level of the pyramid of a width x height scene
+  static glm::ivec2 getLevelSize(GLsizei width, GLsizei height, GLsizei level);
+
+private:
+  GLProgram m_downsampleProgram;
+  GLProgram m_upsampleProgram;
+  GLint m_uDownsampleSourceLevel = -1;
+  GLint m_uDownsampleSourceSize = -1;
+  GLint m_uDownsampleDestinationSize = -1;
+  GLint m_uKarisAverage = -1;
+  GLint m_uUpsampleSourceLevel = -1;
+  GLint m_uUpsampleSourceSize = -1;
+  GLint m_uUpsampleDestinationSize = -1;
+  GLsizei m_width = 0; // Of level 0 of m_texture
+  GLsizei m_height = 0;
+  GLsizei m_levelCount = 0;
+  GLTexture m_texture;
+};
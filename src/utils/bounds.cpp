@@ -0,0 +1,57 @@
+#include "bounds.hpp"
+
+BoundingBox transformBoundingBox(
+    const BoundingBox &box, const glm::mat4 &matrix)
+{
+  if (box.isEmpty()) {
+    return box;
+  }
+  // Each column scales the extent of the box along one axis (Arvo's method)
+  const auto center = 0.5f * (box.min + box.max);
+  const auto halfExtent = 0.5f * (box.max - box.min);
+  const auto newCenter = glm::vec3(matrix * glm::vec4(center, 1));
+  const auto newHalfExtent =
+      glm::abs(glm::vec3(matrix[0])) * halfExtent.x +
+      glm::abs(glm::vec3(matrix[1])) * halfExtent.y +
+      glm::abs(glm::vec3(matrix[2])) * halfExtent.z;
+
+  BoundingBox result;
+  result.min = newCenter - newHalfExtent;
+  result.max = newCenter + newHalfExtent;
+  return result;
+}
+
+Frustum getFrustum(const glm::mat4 &viewProjMatrix)
+{
+  // Gribb-Hartmann: planes are sums and differences of the rows of the matrix
+  const auto m = glm::transpose(viewProjMatrix);
+  Frustum frustum;
+  frustum.planes[0] = m[3] + m[0]; // Left
+  frustum.planes[1] = m[3] - m[0]; // Right
+  frustum.planes[2] = m[3] + m[1]; // Bottom
+  frustum.planes[3] = m[3] - m[1]; // Top
+  frustum.planes[4] = m[3] + m[2]; // Near
+  frustum.planes[5] = m[3] - m[2]; // Far
+  // Unit normals, so that distances to spheres compare with their radius
+  for (auto &plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+bool intersects(const Frustum &frustum, const BoundingBox &box)
+{
+  if (box.isEmpty()) {
+    return false;
+  }
+  for (const auto &plane : frustum.planes) {
+    // Corner of the box the furthest along the plane normal
+    const auto corner = glm::vec3(plane.x >= 0 ? box.max.x : box.min.x,
+        plane.y >= 0 ? box.max.y : box.min.y,
+        plane.z >= 0 ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <limits>
+
+// Axis aligned bounding box. The default one is empty (min > max), and grows
+// with extend().
+struct BoundingBox
+{
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  bool isEmpty() const
+  {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+  }
+
+  void extend(const glm::vec3 &point)
+  {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  void extend(const BoundingBox &box)
+  {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+  }
+};
+
+// Smallest box containing the transformed box (exact for affine matrices)
+BoundingBox transformBoundingBox(
+    const BoundingBox &box, const glm::mat4 &matrix);
+
+// Planes of a view frustum, as (normal, distance) with unit normals pointing
+// inside
+struct Frustum
+{
+  glm::vec4 planes[6];
+};
+
+// Frustum of projMatrix * viewMatrix, in world space
+Frustum getFrustum(const glm::mat4 &viewProjMatrix);
+
+// Conservative test: false only if box is entirely outside of one of the
+// planes. Empty boxes never intersect.
+bool intersects(const Frustum &frustum, const BoundingBox &box);
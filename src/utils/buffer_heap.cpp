@@ -0,0 +1,226 @@
+#include "buffer_heap.hpp"
+#include "gl_objects.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+GLBufferHeap::GLBufferHeap(GLsizeiptr minHeapSize) :
+    m_minHeapSize(minHeapSize)
+{
+}
+
+GLBufferHeap::~GLBufferHeap()
+{
+  for (const auto &heap : m_heaps) {
+    GLBufferTraits::destroy(1, &heap->buffer);
+  }
+}
+
+void GLBufferHeap::reserve(GLsizeiptr byteSize)
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto &heap : m_heaps) {
+    if (!heap->freeSizes.empty() &&
+        heap->freeSizes.rbegin()->first >= byteSize) {
+      return;
+    }
+  }
+  createHeap(byteSize);
+}
+
+GLBufferRange GLBufferHeap::allocate(
+    GLsizeiptr byteSize, GLsizeiptr alignment)
+{
+  assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+  byteSize = std::max(byteSize, GLsizeiptr(1));
+  const auto align = [&](GLintptr offset) {
+    return (offset + alignment - 1) & ~GLintptr(alignment - 1);
+  };
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  const auto tryAllocate = [&](Heap &heap, GLBufferRange &range) {
+    // The smallest free ranges that can fit, then larger ones if alignment
+    // padding makes them too small
+    for (auto it = heap.freeSizes.lower_bound(byteSize);
+         it != end(heap.freeSizes); ++it) {
+      const auto offset = it->second;
+      const auto size = it->first;
+      const auto alignedOffset = align(offset);
+      if (alignedOffset + byteSize > offset + size) {
+        continue;
+      }
+      eraseFreeRange(heap, offset, size);
+      // The padding before the range is allocated with it, the rest is
+      // free again
+      const auto allocatedSize = alignedOffset - offset + byteSize;
+      if (size > allocatedSize) {
+        insertFreeRange(heap, offset + allocatedSize, size - allocatedSize);
+      }
+      heap.allocated[alignedOffset] = {offset, allocatedSize};
+      m_allocatedBytes += size_t(allocatedSize);
+      range = GLBufferRange{heap.buffer, alignedOffset, byteSize};
+      return true;
+    }
+    return false;
+  };
+  GLBufferRange range;
+  for (const auto &heap : m_heaps) {
+    if (tryAllocate(*heap, range)) {
+      return range;
+    }
+  }
+  tryAllocate(createHeap(byteSize + alignment - 1), range);
+  return range;
+}
+
+void GLBufferHeap::free(const GLBufferRange &range)
+{
+  if (!range.buffer) {
+    return;
+  }
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  const auto heapIt = std::find_if(begin(m_heaps), end(m_heaps),
+      [&](const auto &heap) { return heap->buffer == range.buffer; });
+  if (heapIt == end(m_heaps)) {
+    return;
+  }
+  auto &heap = **heapIt;
+  const auto allocatedIt = heap.allocated.find(range.byteOffset);
+  if (allocatedIt == end(heap.allocated)) {
+    return;
+  }
+  auto offset = allocatedIt->second.first;
+  auto size = allocatedIt->second.second;
+  heap.allocated.erase(allocatedIt);
+  m_allocatedBytes -= size_t(size);
+
+  // Merge with the free ranges right before and after
+  const auto next = heap.freeRanges.lower_bound(offset);
+  if (next != end(heap.freeRanges) && next->first == offset + size) {
+    const auto nextSize = next->second;
+    eraseFreeRange(heap, offset + size, nextSize);
+    size += nextSize;
+  }
+  const auto following = heap.freeRanges.lower_bound(offset);
+  if (following != begin(heap.freeRanges)) {
+    const auto previous = std::prev(following);
+    if (previous->first + previous->second == offset) {
+      const auto previousOffset = previous->first;
+      const auto previousSize = previous->second;
+      eraseFreeRange(heap, previousOffset, previousSize);
+      offset = previousOffset;
+      size += previousSize;
+    }
+  }
+  insertFreeRange(heap, offset, size);
+}
+
+void GLBufferHeap::trim()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto it = begin(m_heaps); it != end(m_heaps);) {
+    if ((*it)->allocated.empty()) {
+      GLBufferTraits::destroy(1, &(*it)->buffer);
+      it = m_heaps.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t GLBufferHeap::heapCount() const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_heaps.size();
+}
+
+size_t GLBufferHeap::capacityBytes() const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  size_t bytes = 0;
+  for (const auto &heap : m_heaps) {
+    bytes += size_t(heap->byteSize);
+  }
+  return bytes;
+}
+
+size_t GLBufferHeap::allocatedBytes() const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_allocatedBytes;
+}
+
+GLBufferHeap::Heap &GLBufferHeap::createHeap(GLsizeiptr byteSize)
+{
+  // Sizes multiple of 64 KiB, like the pages drivers allocate
+  const GLsizeiptr granularity = 64 * 1024;
+  byteSize = (std::max(byteSize, m_minHeapSize) + granularity - 1) /
+             granularity * granularity;
+  auto heap = std::make_unique<Heap>();
+  heap->byteSize = byteSize;
+  glGenBuffers(1, &heap->buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, heap->buffer);
+  glBufferStorage(
+      GL_COPY_WRITE_BUFFER, byteSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  trackBuffers(GpuMemoryCategory::Geometry, 1, &heap->buffer);
+  insertFreeRange(*heap, 0, byteSize);
+  m_heaps.push_back(std::move(heap));
+  return *m_heaps.back();
+}
+
+void GLBufferHeap::eraseFreeRange(Heap &heap, GLintptr offset, GLsizeiptr size)
+{
+  heap.freeRanges.erase(offset);
+  const auto sizes = heap.freeSizes.equal_range(size);
+  for (auto it = sizes.first; it != sizes.second; ++it) {
+    if (it->second == offset) {
+      heap.freeSizes.erase(it);
+      return;
+    }
+  }
+}
+
+void GLBufferHeap::insertFreeRange(
+    Heap &heap, GLintptr offset, GLsizeiptr size)
+{
+  heap.freeRanges.emplace(offset, size);
+  heap.freeSizes.emplace(size, offset);
+}
+
+GLBufferRanges::GLBufferRanges(std::shared_ptr<GLBufferHeap> heap,
+    std::vector<GLBufferRange> ranges) :
+    m_heap(std::move(heap)),
+    m_ranges(std::move(ranges))
+{
+}
+
+GLBufferRanges::GLBufferRanges(GLBufferRanges &&other) noexcept :
+    m_heap(std::move(other.m_heap)),
+    m_ranges(std::move(other.m_ranges))
+{
+  other.m_ranges.clear();
+}
+
+GLBufferRanges &GLBufferRanges::operator=(GLBufferRanges &&other) noexcept
+{
+  if (this != &other) {
+    reset();
+    m_heap = std::move(other.m_heap);
+    m_ranges = std::move(other.m_ranges);
+    other.m_ranges.clear();
+  }
+  return *this;
+}
+
+void GLBufferRanges::reset()
+{
+  if (m_heap) {
+    for (const auto &range : m_ranges) {
+      m_heap->free(range);
+    }
+  }
+  m_heap = nullptr;
+  m_ranges.clear();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// A range of bytes of a buffer object
+struct GLBufferRange
+{
+  GLuint buffer = 0;
+  GLintptr byteOffset = 0;
+  GLsizeiptr byteSize = 0;
+};
+
+// Sub-allocator of ranges in a few large buffer objects (heaps), instead of
+// one buffer object per model or tile: fewer objects for the driver to track
+// and to bind, and the memory of unloaded models is reused by the next ones
+// without freeing and allocating GPU memory again. Heaps have immutable
+// storage with GL_DYNAMIC_STORAGE_BIT, written by glBufferSubData, and are
+// accounted as GpuMemoryCategory::Geometry by the current GpuMemoryTracker
+// once created.
+//
+// Free ranges of each heap are kept by size and by offset: allocations take
+// the smallest free range that fits, and freed ranges merge with their free
+// neighbours. Offsets are aligned as asked, for ranges bound to uniform or
+// shader storage blocks (see GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT).
+//
+// Thread safe, for contexts sharing objects: new heaps are created by the
+// context of the thread allocating. One of them must be current when the
+// heap is destroyed, which deletes its buffers.
+class GLBufferHeap
+{
+public:
+  // Heaps are created of minHeapSize bytes, or of the size of larger
+  // allocations and reservations
+  explicit GLBufferHeap(GLsizeiptr minHeapSize = 32 * 1024 * 1024);
+
+  ~GLBufferHeap();
+
+  GLBufferHeap(const GLBufferHeap &) = delete;
+
+  GLBufferHeap &operator=(const GLBufferHeap &) = delete;
+
+  // Make sure byteSize bytes can be allocated in one heap, creating one of
+  // at least this size if none has such a free range. For the allocations of
+  // a model to share a heap.
+  void reserve(GLsizeiptr byteSize);
+
+  // A range of byteSize bytes (at least 1) at an offset multiple of
+  // alignment, a power of two. Its content is undefined.
+  GLBufferRange allocate(GLsizeiptr byteSize, GLsizeiptr alignment = 16);
+
+  // Free a range returned by allocate
+  void free(const GLBufferRange &range);
+
+  // Delete the heaps with no allocated range
+  void trim();
+
+  size_t heapCount() const;
+
+  // Bytes of the heaps, and of their allocated ranges with their padding
+  size_t capacityBytes() const;
+  size_t allocatedBytes() const;
+
+private:
+  struct Heap
+  {
+    GLuint buffer = 0;
+    GLsizeiptr byteSize = 0;
+    std::map<GLintptr, GLsizeiptr> freeRanges; // Size by offset
+    std::multimap<GLsizeiptr, GLintptr> freeSizes; // Offset by size
+    // Offset and size of the allocated range, padding included, by the
+    // offset returned
+    std::unordered_map<GLintptr, std::pair<GLintptr, GLsizeiptr>> allocated;
+  };
+
+  Heap &createHeap(GLsizeiptr byteSize);
+
+  // Remove a free range from both maps
+  static void eraseFreeRange(Heap &heap, GLintptr offset, GLsizeiptr size);
+
+  static void insertFreeRange(Heap &heap, GLintptr offset, GLsizeiptr size);
+
+  GLsizeiptr m_minHeapSize;
+  std::vector<std::unique_ptr<Heap>> m_heaps;
+  size_t m_allocatedBytes = 0;
+  mutable std::mutex m_mutex;
+};
+
+// Ranges of a GLBufferHeap owned together, freed when destroyed, like the
+// GL objects of GLObjects
+class GLBufferRanges
+{
+public:
+  GLBufferRanges() = default;
+
+  GLBufferRanges(std::shared_ptr<GLBufferHeap> heap,
+      std::vector<GLBufferRange> ranges);
+
+  ~GLBufferRanges() { reset(); }
+
+  GLBufferRanges(GLBufferRanges &&other) noexcept;
+
+  GLBufferRanges &operator=(GLBufferRanges &&other) noexcept;
+
+  GLBufferRanges(const GLBufferRanges &) = delete;
+
+  GLBufferRanges &operator=(const GLBufferRanges &) = delete;
+
+  // Free the ranges
+  void reset();
+
+  const std::vector<GLBufferRange> &ranges() const { return m_ranges; }
+
+private:
+  std::shared_ptr<GLBufferHeap> m_heap;
+  std::vector<GLBufferRange> m_ranges;
+};
@@ -0,0 +1,307 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+const int BIN_COUNT = 16;
+const int MAX_LEAF_ITEMS = 4;
+
+float getSurfaceArea(const BoundingBox &box)
+{
+  if (box.isEmpty()) {
+    return 0.f;
+  }
+  const auto extent = box.max - box.min;
+  return 2.f * (extent.x * extent.y + extent.y * extent.z +
+                   extent.z * extent.x);
+}
+
+glm::vec3 getCenter(const BoundingBox &box)
+{
+  return 0.5f * (box.min + box.max);
+}
+
+// Slab test, true if the ray enters box before tMax, at distance tEnter
+bool intersectRay(const BoundingBox &box, const glm::vec3 &origin,
+    const glm::vec3 &invDirection, float tMax, float &tEnter)
+{
+  const auto t0 = (box.min - origin) * invDirection;
+  const auto t1 = (box.max - origin) * invDirection;
+  const auto tNear = glm::min(t0, t1);
+  const auto tFar = glm::max(t0, t1);
+  tEnter = std::max(std::max(std::max(tNear.x, tNear.y), tNear.z), 0.f);
+  const auto tExit = std::min(std::min(tFar.x, tFar.y), tFar.z);
+  return tEnter <= tExit && tEnter < tMax;
+}
+
+// Split items [begin, end) on the cheapest of BIN_COUNT planes along each
+// axis. Returns the index of the first item of the second half, or begin if
+// a leaf is cheaper than any split.
+int partitionItems(std::vector<int> &items, int begin, int end,
+    const std::vector<BoundingBox> &itemBounds, const BoundingBox &nodeBounds)
+{
+  BoundingBox centerBounds;
+  for (auto i = begin; i < end; ++i) {
+    centerBounds.extend(getCenter(itemBounds[items[i]]));
+  }
+
+  struct Bin
+  {
+    BoundingBox bounds;
+    int itemCount = 0;
+  };
+
+  auto bestCost = float(end - begin); // Cost of a leaf, relative to the area
+  auto bestAxis = -1;
+  auto bestSplit = 0;
+  for (auto axis = 0; axis < 3; ++axis) {
+    const auto lo = centerBounds.min[axis];
+    const auto extent = centerBounds.max[axis] - lo;
+    if (extent <= 0.f) {
+      continue;
+    }
+    Bin bins[BIN_COUNT];
+    for (auto i = begin; i < end; ++i) {
+      const auto &bounds = itemBounds[items[i]];
+      const auto binIdx = std::min(
+          int(BIN_COUNT * (getCenter(bounds)[axis] - lo) / extent),
+          BIN_COUNT - 1);
+      bins[binIdx].bounds.extend(bounds);
+      ++bins[binIdx].itemCount;
+    }
+
+    // Sweep from the right to get the cost of each right half, then from the
+    // left to evaluate the splits
+    float rightAreas[BIN_COUNT];
+    int rightCounts[BIN_COUNT];
+    BoundingBox right;
+    auto rightCount = 0;
+    for (auto b = BIN_COUNT - 1; b > 0; --b) {
+      right.extend(bins[b].bounds);
+      rightCount += bins[b].itemCount;
+      rightAreas[b] = getSurfaceArea(right);
+      rightCounts[b] = rightCount;
+    }
+    BoundingBox left;
+    auto leftCount = 0;
+    const auto nodeArea = std::max(getSurfaceArea(nodeBounds), 1e-30f);
+    for (auto b = 1; b < BIN_COUNT; ++b) {
+      left.extend(bins[b - 1].bounds);
+      leftCount += bins[b - 1].itemCount;
+      if (!leftCount || !rightCounts[b]) {
+        continue;
+      }
+      // Traversal cost of 1 for a node, relative to testing an item
+      const auto cost = 1.f + (getSurfaceArea(left) * leftCount +
+                                  rightAreas[b] * rightCounts[b]) /
+                                  nodeArea;
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = b;
+      }
+    }
+  }
+
+  if (bestAxis < 0) {
+    if (end - begin <= MAX_LEAF_ITEMS) {
+      return begin;
+    }
+    // Large set of items with the same center, or too scattered to benefit
+    // from SAH: split in the middle
+    const auto middle = begin + (end - begin) / 2;
+    std::nth_element(items.begin() + begin, items.begin() + middle,
+        items.begin() + end, [&](int a, int b) {
+          return getCenter(itemBounds[a]).x < getCenter(itemBounds[b]).x;
+        });
+    return middle;
+  }
+
+  const auto lo = centerBounds.min[bestAxis];
+  const auto extent = centerBounds.max[bestAxis] - lo;
+  return int(std::partition(items.begin() + begin, items.begin() + end,
+                 [&](int item) {
+                   const auto binIdx = std::min(
+                       int(BIN_COUNT *
+                           (getCenter(itemBounds[item])[bestAxis] - lo) /
+                           extent),
+                       BIN_COUNT - 1);
+                   return binIdx < bestSplit;
+                 }) -
+             items.begin());
+}
+
+} // namespace
+
+Bvh buildBvh(const std::vector<BoundingBox> &itemBounds)
+{
+  Bvh bvh;
+  for (size_t i = 0; i < itemBounds.size(); ++i) {
+    if (!itemBounds[i].isEmpty()) { // Never visible nor hit
+      bvh.items.push_back(int(i));
+    }
+  }
+  if (bvh.items.empty()) {
+    return bvh;
+  }
+
+  bvh.nodes.emplace_back();
+  bvh.nodes[0].first = 0;
+  bvh.nodes[0].itemCount = int(bvh.items.size());
+
+  // Nodes waiting to be split, created as leaves of all their items
+  std::vector<int> stack = {0};
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back();
+    stack.pop_back();
+
+    const auto begin = bvh.nodes[nodeIdx].first;
+    const auto end = begin + bvh.nodes[nodeIdx].itemCount;
+    BoundingBox bounds;
+    for (auto i = begin; i < end; ++i) {
+      bounds.extend(itemBounds[bvh.items[i]]);
+    }
+    bvh.nodes[nodeIdx].bounds = bounds;
+
+    if (end - begin <= 1) {
+      continue;
+    }
+    const auto middle =
+        partitionItems(bvh.items, begin, end, itemBounds, bounds);
+    if (middle == begin) {
+      continue;
+    }
+
+    const auto firstChild = int(bvh.nodes.size());
+    bvh.nodes.resize(bvh.nodes.size() + 2);
+    bvh.nodes[firstChild].first = begin;
+    bvh.nodes[firstChild].itemCount = middle - begin;
+    bvh.nodes[firstChild + 1].first = middle;
+    bvh.nodes[firstChild + 1].itemCount = end - middle;
+    bvh.nodes[nodeIdx].first = firstChild;
+    bvh.nodes[nodeIdx].itemCount = 0;
+    stack.push_back(firstChild + 1);
+    stack.push_back(firstChild);
+  }
+  return bvh;
+}
+
+void refitBvh(Bvh &bvh, const std::vector<BoundingBox> &itemBounds)
+{
+  // Children come after their parent
+  for (auto i = int(bvh.nodes.size()) - 1; i >= 0; --i) {
+    auto &node = bvh.nodes[i];
+    BoundingBox bounds;
+    if (node.itemCount) {
+      for (auto j = node.first; j < node.first + node.itemCount; ++j) {
+        bounds.extend(itemBounds[bvh.items[j]]);
+      }
+    } else {
+      bounds.extend(bvh.nodes[node.first].bounds);
+      bounds.extend(bvh.nodes[node.first + 1].bounds);
+    }
+    node.bounds = bounds;
+  }
+}
+
+void cullBvh(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+    const Frustum &frustum, std::vector<uint8_t> &visibleItems)
+{
+  visibleItems.assign(itemBounds.size(), 0);
+  if (bvh.nodes.empty()) {
+    return;
+  }
+
+  // Nodes to visit, with the planes their box may cross as a bit mask: the
+  // descendants of a box inside a plane are inside it too
+  const auto allPlanes = (1u << 6) - 1;
+  std::vector<std::pair<int, unsigned>> stack = {{0, allPlanes}};
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back().first;
+    auto planeMask = stack.back().second;
+    stack.pop_back();
+
+    const auto &node = bvh.nodes[nodeIdx];
+    auto outside = false;
+    for (auto p = 0; p < 6 && !outside; ++p) {
+      if (!(planeMask & (1u << p))) {
+        continue;
+      }
+      const auto &plane = frustum.planes[p];
+      const auto normal = glm::vec3(plane);
+      const auto center = getCenter(node.bounds);
+      const auto halfExtent = 0.5f * (node.bounds.max - node.bounds.min);
+      const auto distance = glm::dot(normal, center) + plane.w;
+      const auto radius = glm::dot(glm::abs(normal), halfExtent);
+      if (distance + radius < 0) {
+        outside = true;
+      } else if (distance - radius >= 0) {
+        planeMask &= ~(1u << p);
+      }
+    }
+    if (outside) {
+      continue;
+    }
+
+    if (!node.itemCount) {
+      stack.emplace_back(node.first + 1, planeMask);
+      stack.emplace_back(node.first, planeMask);
+      continue;
+    }
+    for (auto i = node.first; i < node.first + node.itemCount; ++i) {
+      const auto item = bvh.items[i];
+      if (!planeMask || node.itemCount == 1 ||
+          intersects(frustum, itemBounds[item])) {
+        visibleItems[item] = 1;
+      }
+    }
+  }
+}
+
+int intersectBvh(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+    const glm::vec3 &origin, const glm::vec3 &direction, float &t)
+{
+  t = std::numeric_limits<float>::infinity();
+  if (bvh.nodes.empty()) {
+    return -1;
+  }
+  const auto invDirection = 1.f / direction;
+  auto hitItem = -1;
+
+  std::vector<int> stack = {0};
+  while (!stack.empty()) {
+    const auto &node = bvh.nodes[stack.back()];
+    stack.pop_back();
+    auto tNode = 0.f;
+    if (!intersectRay(node.bounds, origin, invDirection, t, tNode)) {
+      continue;
+    }
+    if (node.itemCount) {
+      for (auto i = node.first; i < node.first + node.itemCount; ++i) {
+        const auto item = bvh.items[i];
+        auto tItem = 0.f;
+        if (intersectRay(itemBounds[item], origin, invDirection, t, tItem)) {
+          t = tItem;
+          hitItem = item;
+        }
+      }
+      continue;
+    }
+    // Nearest child visited first, so that t shrinks sooner
+    auto tFirst = std::numeric_limits<float>::infinity();
+    auto tSecond = std::numeric_limits<float>::infinity();
+    intersectRay(bvh.nodes[node.first].bounds, origin, invDirection, t, tFirst);
+    intersectRay(
+        bvh.nodes[node.first + 1].bounds, origin, invDirection, t, tSecond);
+    if (tFirst <= tSecond) {
+      stack.push_back(node.first + 1);
+      stack.push_back(node.first);
+    } else {
+      stack.push_back(node.first);
+      stack.push_back(node.first + 1);
+    }
+  }
+  return hitItem;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over a set of items given by their bounding
+// boxes, built with the surface area heuristic. Items are referred to by their
+// index in the vector of boxes given to buildBvh.
+//
+// nodes[0] is the root. An inner node has its two children at
+// nodes[first] and nodes[first + 1], always after itself; a leaf references
+// items[first, first + itemCount).
+struct Bvh
+{
+  struct Node
+  {
+    BoundingBox bounds;
+    int first = 0;
+    int itemCount = 0; // 0 for inner nodes
+  };
+
+  std::vector<Node> nodes;
+  std::vector<int> items;
+};
+
+Bvh buildBvh(const std::vector<BoundingBox> &itemBounds);
+
+// Update the bounds of nodes after items moved, keeping the tree structure.
+// Much cheaper than a rebuild, but culling gets less efficient as items move
+// far from where they were when the tree was built.
+void refitBvh(Bvh &bvh, const std::vector<BoundingBox> &itemBounds);
+
+// Sets visibleItems[i] to 1 if item i may be inside frustum, to 0 otherwise.
+// Subtrees entirely inside or outside of the frustum are not traversed.
+void cullBvh(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+    const Frustum &frustum, std::vector<uint8_t> &visibleItems);
+
+// Returns the item whose box is the first hit by the ray, with the distance
+// along direction in t, or -1 if no box is hit.
+int intersectBvh(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+    const glm::vec3 &origin, const glm::vec3 &direction, float &t);
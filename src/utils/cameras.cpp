@@ -1,7 +1,14 @@
 #include "cameras.hpp"
 #include "glfw.hpp"
+#include "remote_input.hpp"
 
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 // Good reference here to map camera movements to lookAt calls
 // http://learnwebgl.brown37.net/07_cameras/camera_movement.html
@@ -26,14 +33,50 @@ ViewFrame fromViewToWorldMatrix(const mat4 &viewToWorldMatrix)
       -vec3(viewToWorldMatrix[2]), vec3(viewToWorldMatrix[3])};
 }
 
+// Without GLFW (GLTF_VIEWER_HEADLESS), controllers have no window and only
+// read their remote input
+
+bool CameraController::isMouseButtonPressed(
+    GLFWwindow *window, int button) const
+{
+#ifndef GLTF_VIEWER_HEADLESS
+  if (window && glfwGetMouseButton(window, button)) {
+    return true;
+  }
+#endif
+  return m_remoteInput && m_remoteInput->isMouseButtonPressed(button);
+}
+
+bool CameraController::isKeyPressed(GLFWwindow *window, int key) const
+{
+#ifndef GLTF_VIEWER_HEADLESS
+  if (window && glfwGetKey(window, key)) {
+    return true;
+  }
+#endif
+  return m_remoteInput && m_remoteInput->isKeyPressed(key);
+}
+
+dvec2 CameraController::getCursorPos(GLFWwindow *window) const
+{
+  dvec2 position(0);
+  if (!m_remoteInput || !m_remoteInput->getCursorPos(position)) {
+#ifndef GLTF_VIEWER_HEADLESS
+    if (window) {
+      glfwGetCursorPos(window, &position.x, &position.y);
+    }
+#endif
+  }
+  return position;
+}
+
 bool FirstPersonCameraController::update(float elapsedTime)
 {
-  if (glfwGetMouseButton(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) &&
+  if (isMouseButtonPressed(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) &&
       !m_MiddleButtonPressed) {
     m_MiddleButtonPressed = true;
-    glfwGetCursorPos(
-        m_pWindow, &m_LastCursorPosition.x, &m_LastCursorPosition.y);
-  } else if (!glfwGetMouseButton(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) &&
+    m_LastCursorPosition = getCursorPos(m_pWindow);
+  } else if (!isMouseButtonPressed(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) &&
              m_MiddleButtonPressed) {
     m_MiddleButtonPressed = false;
   }
@@ -41,7 +84,7 @@ bool FirstPersonCameraController::update(float elapsedTime)
   const auto cursorDelta = ([&]() {
     if (m_MiddleButtonPressed) {
       dvec2 cursorPosition;
-      glfwGetCursorPos(m_pWindow, &cursorPosition.x, &cursorPosition.y);
+      cursorPosition = getCursorPos(m_pWindow);
       const auto delta = cursorPosition - m_LastCursorPosition;
       m_LastCursorPosition = cursorPosition;
       return delta;
@@ -54,39 +97,39 @@ bool FirstPersonCameraController::update(float elapsedTime)
   float dollyIn = 0.f;
   float rollRightAngle = 0.f;
 
-  if (glfwGetKey(m_pWindow, GLFW_KEY_W)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_W)) {
     dollyIn += m_fSpeed * elapsedTime;
   }
 
   // Truck left
-  if (glfwGetKey(m_pWindow, GLFW_KEY_A)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_A)) {
     truckLeft += m_fSpeed * elapsedTime;
   }
 
   // Pedestal up
-  if (glfwGetKey(m_pWindow, GLFW_KEY_UP)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_UP)) {
     pedestalUp += m_fSpeed * elapsedTime;
   }
 
   // Dolly out
-  if (glfwGetKey(m_pWindow, GLFW_KEY_S)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_S)) {
     dollyIn -= m_fSpeed * elapsedTime;
   }
 
   // Truck right
-  if (glfwGetKey(m_pWindow, GLFW_KEY_D)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_D)) {
     truckLeft -= m_fSpeed * elapsedTime;
   }
 
   // Pedestal down
-  if (glfwGetKey(m_pWindow, GLFW_KEY_DOWN)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_DOWN)) {
     pedestalUp -= m_fSpeed * elapsedTime;
   }
 
-  if (glfwGetKey(m_pWindow, GLFW_KEY_Q)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_Q)) {
     rollRightAngle -= 0.001f;
   }
-  if (glfwGetKey(m_pWindow, GLFW_KEY_E)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_E)) {
     rollRightAngle += 0.001f;
   }
 
@@ -110,11 +153,11 @@ bool FirstPersonCameraController::update(float elapsedTime)
 bool TrackballCameraController::update(float elapsedTime) 
 {
   //Check on mouse middle button
-  if(glfwGetMouseButton(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) && !m_MiddleButtonPressed){
+  if(isMouseButtonPressed(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) && !m_MiddleButtonPressed){
     m_MiddleButtonPressed = true;
-    glfwGetCursorPos(m_pWindow, &m_LastCursorPosition.x, &m_LastCursorPosition.y);
+    m_LastCursorPosition = getCursorPos(m_pWindow);
   } 
-  else if (!glfwGetMouseButton(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) && m_MiddleButtonPressed){
+  else if (!isMouseButtonPressed(m_pWindow, GLFW_MOUSE_BUTTON_MIDDLE) && m_MiddleButtonPressed){
     m_MiddleButtonPressed = false;
   }
 
@@ -126,7 +169,7 @@ bool TrackballCameraController::update(float elapsedTime)
   const auto cursorDelta = ([&]() {
     if (m_MiddleButtonPressed){
       dvec2 cursorPosition;
-      glfwGetCursorPos(m_pWindow, &cursorPosition.x, &cursorPosition.y);
+      cursorPosition = getCursorPos(m_pWindow);
       const auto delta = cursorPosition - m_LastCursorPosition;
       m_LastCursorPosition = cursorPosition;
       return delta;
@@ -140,12 +183,12 @@ bool TrackballCameraController::update(float elapsedTime)
   float offsetY = static_cast<float>(cursorDelta.y * m_fSpeed * elapsedTime);
 
   //Pedestal move
-  if(glfwGetKey(m_pWindow, GLFW_KEY_LEFT_SHIFT)){
+  if(isKeyPressed(m_pWindow, GLFW_KEY_LEFT_SHIFT)){
    m_camera.moveLocal(offsetX, offsetY, 0);
   }*/
 
   //PAN
-   if (glfwGetKey(m_pWindow, GLFW_KEY_LEFT_SHIFT)) {
+   if (isKeyPressed(m_pWindow, GLFW_KEY_LEFT_SHIFT)) {
     const auto truckLeft = 0.01f * float(cursorDelta.x);
     const auto pedestalUp = 0.01f * float(cursorDelta.y);
     const auto hasMoved = truckLeft || pedestalUp;
@@ -159,7 +202,7 @@ bool TrackballCameraController::update(float elapsedTime)
   }
 
   //ZOOM
-  if (glfwGetKey(m_pWindow, GLFW_KEY_LEFT_CONTROL)) {
+  if (isKeyPressed(m_pWindow, GLFW_KEY_LEFT_CONTROL)) {
     auto mouseOffset = 0.01f * float(cursorDelta.x);
     if (mouseOffset == 0.f) {
       return false;
@@ -205,3 +248,73 @@ bool TrackballCameraController::update(float elapsedTime)
   return true;
   
 }
+
+bool parseCamera(const std::string &text, Camera &camera)
+{
+  // Numbers separated by commas
+  std::istringstream values(text);
+  float lookat[9];
+  auto count = 0;
+  auto separator = ',';
+  while (count < 9 && separator == ',' && values >> lookat[count]) {
+    ++count;
+    separator = 0;
+    values >> separator;
+  }
+  if (count != 9 || separator) {
+    return false;
+  }
+  camera = Camera(vec3(lookat[0], lookat[1], lookat[2]),
+      vec3(lookat[3], lookat[4], lookat[5]),
+      vec3(lookat[6], lookat[7], lookat[8]));
+  return true;
+}
+
+std::string formatCamera(const Camera &camera)
+{
+  std::ostringstream text;
+  text << std::setprecision(std::numeric_limits<float>::max_digits10);
+  for (const auto &v : {camera.eye(), camera.center(), camera.up()}) {
+    text << (text.tellp() > 0 ? "," : "") << v.x << "," << v.y << "," << v.z;
+  }
+  return text.str();
+}
+
+std::vector<Camera> loadCameraList(const fs::path &path)
+{
+  std::ifstream input(path.string());
+  if (!input) {
+    throw std::runtime_error("Unable to read cameras from " + path.string());
+  }
+  std::vector<Camera> cameras;
+  std::string line;
+  for (size_t lineIdx = 1; std::getline(input, line); ++lineIdx) {
+    const auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    Camera camera;
+    if (!parseCamera(line, camera)) {
+      throw std::runtime_error("Unable to parse camera at " + path.string() +
+                               ":" + std::to_string(lineIdx) +
+                               " (expected 9 numbers separated by commas)");
+    }
+    cameras.push_back(camera);
+  }
+  return cameras;
+}
+
+std::vector<Camera> getTurntableCameras(
+    const Camera &camera, size_t count, const vec3 &axis)
+{
+  std::vector<Camera> cameras;
+  const auto depthAxis = camera.eye() - camera.center();
+  for (size_t i = 0; i < count; ++i) {
+    const auto angle = 2.f * glm::pi<float>() * float(i) / float(count);
+    const auto rotationMatrix = rotate(mat4(1), angle, axis);
+    cameras.emplace_back(
+        camera.center() + vec3(rotationMatrix * vec4(depthAxis, 0)),
+        camera.center(), vec3(rotationMatrix * vec4(camera.up(), 0)));
+  }
+  return cameras;
+}
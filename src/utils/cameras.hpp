@@ -1,9 +1,15 @@
 #pragma once
 
+#include "filesystem.hpp"
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <string>
+#include <vector>
+
 struct GLFWwindow;
+class RemoteInput;
 
 // Camera defined by an eye position, a center position and an up vector
 class Camera
@@ -149,6 +155,20 @@ class CameraController {
     virtual void setCamera(const Camera &camera) = 0;
     virtual const Camera &getCamera() const = 0;
     virtual bool update(float elapsedTime) = 0;
+
+    // Input of the client of --stream, read along with the input of the
+    // window. None if null.
+    void setRemoteInput(const RemoteInput *input) { m_remoteInput = input; }
+
+  protected:
+    // Pressed on the window or by the remote client
+    bool isMouseButtonPressed(GLFWwindow *window, int button) const;
+    bool isKeyPressed(GLFWwindow *window, int key) const;
+    // Of the remote client once it sent one, else of the window
+    glm::dvec2 getCursorPos(GLFWwindow *window) const;
+
+  private:
+    const RemoteInput *m_remoteInput = nullptr;
 };
 
 class FirstPersonCameraController : public CameraController
@@ -255,3 +275,22 @@ private:
   // Current camera
   Camera m_camera;
 };
+
+// Camera of text in the format of --lookat, see loadCameraList. Returns false
+// if it is not 9 numbers separated by commas.
+bool parseCamera(const std::string &text, Camera &camera);
+
+// Text of camera in the format of --lookat, parsed back by parseCamera to the
+// same camera
+std::string formatCamera(const Camera &camera);
+
+// Cameras of a file with one camera per line, in the format of --lookat:
+// eye_x,eye_y,eye_z,center_x,center_y,center_z,up_x,up_y,up_z. Empty lines and
+// lines starting with # are skipped. Throws std::runtime_error if the file can
+// not be read or a line is not 9 numbers.
+std::vector<Camera> loadCameraList(const fs::path &path);
+
+// count cameras evenly spaced on a turn of camera around the axis through its
+// center, starting with camera itself
+std::vector<Camera> getTurntableCameras(const Camera &camera, size_t count,
+    const glm::vec3 &axis = glm::vec3(0, 1, 0));
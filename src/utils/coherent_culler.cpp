@@ -0,0 +1,142 @@
+#include "coherent_culler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Relative error of the distances to the planes, of the matrices and plane
+// tests in floats
+const double ROUNDING_MARGIN = 1e-5;
+
+} // namespace
+
+void CoherentCuller::reset()
+{
+  m_hasView = false;
+  m_nodes.clear();
+}
+
+void CoherentCuller::updateItemRanges(const Bvh &bvh)
+{
+  m_firstItems.resize(bvh.nodes.size());
+  m_itemEnds.resize(bvh.nodes.size());
+  // Children come after their parent
+  for (auto i = int(bvh.nodes.size()) - 1; i >= 0; --i) {
+    const auto &node = bvh.nodes[i];
+    if (node.itemCount) {
+      m_firstItems[i] = node.first;
+      m_itemEnds[i] = node.first + node.itemCount;
+    } else {
+      m_firstItems[i] = m_firstItems[node.first];
+      m_itemEnds[i] = m_itemEnds[node.first + 1];
+    }
+  }
+}
+
+void CoherentCuller::cull(const Bvh &bvh,
+    const std::vector<BoundingBox> &itemBounds, const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, std::vector<uint8_t> &visibleItems)
+{
+  visibleItems.assign(itemBounds.size(), 0);
+  m_testedNodeCount = 0;
+  m_reusedNodeCount = 0;
+  if (m_hasView && projMatrix == m_projMatrix &&
+      m_nodes.size() == bvh.nodes.size()) {
+    // Largest distance a unit vector moves by the rotation between the two
+    // views, 2 sin(angle / 2): the norm of its difference to the identity,
+    // precise for small angles unlike an acos of its trace
+    const auto rotation =
+        glm::mat3(viewMatrix) * glm::transpose(glm::mat3(m_viewMatrix));
+    auto squaredNorm = 0.f;
+    for (glm::length_t i = 0; i < 3; ++i) {
+      const auto column = rotation[i] - glm::mat3(1)[i];
+      squaredNorm += glm::dot(column, column);
+    }
+    m_rotation += std::sqrt(squaredNorm / 2.f);
+    const auto eye = glm::vec3(glm::inverse(viewMatrix)[3]);
+    const auto previousEye = glm::vec3(glm::inverse(m_viewMatrix)[3]);
+    m_translation += glm::length(eye - previousEye);
+  } else {
+    m_nodes.assign(bvh.nodes.size(), NodeState());
+    updateItemRanges(bvh);
+    m_translation = 0.;
+    m_rotation = 0.;
+  }
+  m_hasView = true;
+  m_viewMatrix = viewMatrix;
+  m_projMatrix = projMatrix;
+  if (bvh.nodes.empty()) {
+    return;
+  }
+
+  const auto frustum = getFrustum(projMatrix * viewMatrix);
+  const auto eye = glm::vec3(glm::inverse(viewMatrix)[3]);
+  std::vector<int> stack = {0};
+  while (!stack.empty()) {
+    const auto nodeIdx = stack.back();
+    stack.pop_back();
+    const auto &node = bvh.nodes[nodeIdx];
+    auto &state = m_nodes[nodeIdx];
+
+    if (state.nodeClass != NodeClass::Unknown) {
+      // Distance a point of the box may have moved relative to the planes
+      const auto translation = m_translation - state.translation;
+      const auto motion = translation + (state.reach + translation) *
+                                            (m_rotation - state.rotation +
+                                                ROUNDING_MARGIN);
+      if (motion < double(state.margin)) {
+        ++m_reusedNodeCount;
+      } else {
+        state.nodeClass = NodeClass::Unknown;
+      }
+    }
+    if (state.nodeClass == NodeClass::Unknown) {
+      ++m_testedNodeCount;
+      const auto center = 0.5f * (node.bounds.min + node.bounds.max);
+      const auto halfExtent = 0.5f * (node.bounds.max - node.bounds.min);
+      // Farthest outside of a plane, and nearest to the planes inside
+      auto outsideMargin = 0.f;
+      auto insideMargin = std::numeric_limits<float>::max();
+      for (const auto &plane : frustum.planes) {
+        const auto normal = glm::vec3(plane);
+        const auto distance = glm::dot(normal, center) + plane.w;
+        const auto radius = glm::dot(glm::abs(normal), halfExtent);
+        outsideMargin = std::max(outsideMargin, -(distance + radius));
+        insideMargin = std::min(insideMargin, distance - radius);
+      }
+      if (outsideMargin > 0.f) {
+        state.nodeClass = NodeClass::Outside;
+        state.margin = outsideMargin;
+      } else if (insideMargin >= 0.f) {
+        state.nodeClass = NodeClass::Inside;
+        state.margin = insideMargin;
+      }
+      state.reach = glm::length(glm::abs(center - eye) + halfExtent);
+      state.translation = m_translation;
+      state.rotation = m_rotation;
+    }
+
+    if (state.nodeClass == NodeClass::Outside) {
+      continue;
+    }
+    if (state.nodeClass == NodeClass::Inside) {
+      for (auto i = m_firstItems[nodeIdx]; i < m_itemEnds[nodeIdx]; ++i) {
+        visibleItems[bvh.items[i]] = 1;
+      }
+      continue;
+    }
+    if (!node.itemCount) {
+      stack.push_back(node.first + 1);
+      stack.push_back(node.first);
+      continue;
+    }
+    for (auto i = node.first; i < node.first + node.itemCount; ++i) {
+      const auto item = bvh.items[i];
+      if (node.itemCount == 1 || intersects(frustum, itemBounds[item])) {
+        visibleItems[item] = 1;
+      }
+    }
+  }
+}
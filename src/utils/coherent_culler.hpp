@@ -0,0 +1,77 @@
+#pragma once
+
+#include "bvh.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Frustum culling of the items of a BVH, like cullBvh, reusing the results of
+// the previous views of a moving camera (temporal coherence).
+//
+// Each node tested is classified as outside, inside or crossing the frustum.
+// Outside and inside nodes are cut from the traversal, and remember their
+// margin: the distance between their box and the nearest plane on the other
+// side. Their planes follow the camera, so a point of the box moves by at
+// most the translation of the eye plus its rotation times the distance to the
+// eye: until the camera has moved enough to close the margin, a node keeps
+// its class without any plane test. Nodes that were visible are tested again
+// every view, hidden ones only once the camera moved towards them, less and
+// less often the farther they are out.
+//
+// The views must share their projection, a new one forgets the previous
+// views. Results are the ones of cullBvh, up to rounding.
+class CoherentCuller
+{
+public:
+  // Sets visibleItems[i] to 1 if item i may be inside the frustum of
+  // projMatrix * viewMatrix, to 0 otherwise. viewMatrix is rigid.
+  void cull(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+      const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+      std::vector<uint8_t> &visibleItems);
+
+  // Forget the previous views, after items moved or the BVH changed
+  void reset();
+
+  // Of the last cull(), nodes whose class was tested and reused
+  size_t testedNodeCount() const { return m_testedNodeCount; }
+
+  size_t reusedNodeCount() const { return m_reusedNodeCount; }
+
+private:
+  enum class NodeClass : uint8_t
+  {
+    Unknown, // Crossing the frustum, or never tested
+    Outside,
+    Inside
+  };
+
+  struct NodeState
+  {
+    NodeClass nodeClass = NodeClass::Unknown;
+    float margin = 0.f; // Distance the box must move to change class
+    float reach = 0.f; // Distance from the eye to the farthest corner
+    // Motion of the camera when tested, see m_translation and m_rotation
+    double translation = 0.;
+    double rotation = 0.;
+  };
+
+  // Item range of each node, its own for leaves and the union of those of
+  // its descendants for inner nodes
+  void updateItemRanges(const Bvh &bvh);
+
+  std::vector<NodeState> m_nodes;
+  std::vector<int> m_firstItems; // In Bvh::items
+  std::vector<int> m_itemEnds;
+  bool m_hasView = false;
+  glm::mat4 m_viewMatrix = glm::mat4(1);
+  glm::mat4 m_projMatrix = glm::mat4(1);
+  // Sums of the distances moved by the eye and by unit vectors rotating with
+  // the camera since the first view, bounding the motion between two views
+  double m_translation = 0.;
+  double m_rotation = 0.;
+  size_t m_testedNodeCount = 0;
+  size_t m_reusedNodeCount = 0;
+};
@@ -0,0 +1,123 @@
+#include "debug_views.hpp"
+#include "draw_stats.hpp"
+#include "gl_extensions.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+
+DebugViews::DebugViews(GLProgram resolveProgram) :
+    m_resolveProgram(std::move(resolveProgram)),
+    m_emptyVertexArray(GLVertexArray::generate())
+{
+}
+
+const char *DebugViews::getModeName(Mode mode)
+{
+  switch (mode) {
+  case Shaded:
+    return "Shaded";
+  case Normals:
+    return "Normals";
+  case DrawIds:
+    return "Draw IDs";
+  case TriangleDensity:
+    return "Triangle density";
+  case MipLevels:
+    return "Mip levels";
+  case Overdraw:
+    return "Overdraw";
+  case Wireframe:
+    return "Wireframe";
+  default:
+    return "";
+  }
+}
+
+std::string DebugViews::getWireframeDefines()
+{
+  if (hasGLExtension("GL_NV_fragment_shader_barycentric")) {
+    return "#define WIREFRAME_BARYCENTRICS_NV 1\n";
+  }
+  if (hasGLExtension("GL_AMD_shader_explicit_vertex_parameter")) {
+    return "#define WIREFRAME_BARYCENTRICS_AMD 1\n";
+  }
+  return {};
+}
+
+void DebugViews::setTriangleDensities(const std::vector<float> &densities)
+{
+  if (densities.size() > m_densityCapacity || !m_densityCapacity) {
+    m_densityCapacity = std::max(densities.size(), size_t(1));
+    m_densityBuffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_densityBuffer.glId());
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+        GLsizeiptr(m_densityCapacity * sizeof(float)), nullptr,
+        GL_DYNAMIC_STORAGE_BIT);
+    const auto buffer = m_densityBuffer.glId();
+    trackBuffers(GpuMemoryCategory::DrawData, 1, &buffer);
+  } else {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_densityBuffer.glId());
+  }
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+      GLsizeiptr(densities.size() * sizeof(float)), densities.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, DRAWS_BINDING, m_densityBuffer.glId());
+}
+
+void DebugViews::beginOverdraw(GLsizei width, GLsizei height)
+{
+  if (width > m_width || height > m_height) {
+    m_width = std::max(width, m_width);
+    m_height = std::max(height, m_height);
+    m_overdrawTexture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_overdrawTexture.glId());
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, m_width, m_height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    const auto texture = m_overdrawTexture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+  }
+  const GLuint zero = 0;
+  glClearTexImage(
+      m_overdrawTexture.glId(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  glBindImageTexture(OVERDRAW_IMAGE_UNIT, m_overdrawTexture.glId(), 0,
+      GL_FALSE, 0, GL_READ_WRITE, GL_R32UI);
+}
+
+void DebugViews::resolveOverdraw()
+{
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  GLint previousVertexArray = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+  const auto depthTest = glIsEnabled(GL_DEPTH_TEST);
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  // Image units are shared with compute passes, bound again
+  glBindImageTexture(OVERDRAW_IMAGE_UNIT, m_overdrawTexture.glId(), 0,
+      GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+  m_resolveProgram.use();
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_emptyVertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(GLuint(previousVertexArray));
+  if (depthTest) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  glBindImageTexture(
+      OVERDRAW_IMAGE_UNIT, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+  glUseProgram(GLuint(previousProgram));
+}
+
+float getTriangleDensity(
+    GLenum mode, size_t vertexCount, const BoundingBox &bounds)
+{
+  if (bounds.isEmpty()) {
+    return 0.f;
+  }
+  const auto size = bounds.max - bounds.min;
+  const auto area = size.x * size.y + size.y * size.z + size.z * size.x;
+  return area > 0.f
+             ? float(DrawStats::getTriangleCount(mode, vertexCount)) / area
+             : 0.f;
+}
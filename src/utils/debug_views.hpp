@@ -0,0 +1,100 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Debug views of the scene, switched from the GUI to tell what makes an asset
+// slow to draw without launching the viewer again with another --fs.
+//
+// pbr_directional_light.fs.glsl compiled with DEBUG_VIEWS replaces the shaded
+// color of forward draws by that of the mode set in its uDebugView uniform:
+// - Normals, the view space normals of normals.fs.glsl, with normal maps
+// - DrawIds, a color per draw, hashed from its index
+// - TriangleDensity, triangles per pixel from blue (1 / 64) to red (1 and
+//   more): the triangles of the draw per unit of area, from
+//   setTriangleDensities, times the area of the surface the pixel covers
+// - MipLevels, texels of the base color texture per pixel from blue (16
+//   pixels per texel) to green (1) to red (16 texels per pixel and more,
+//   resolution wasted at that distance)
+// - Overdraw, fragments shaded per pixel from blue (1) to red (16 and more)
+// - Wireframe, the shaded color with the edges of triangles drawn over it
+//
+// The wireframe is drawn by the same pass as the shaded color, from the
+// barycentrics of the fragment in its triangle and their derivatives, with
+// no second pass in GL_LINE mode nor geometry shader. The barycentrics come
+// from GL_NV_fragment_shader_barycentric or
+// GL_AMD_shader_explicit_vertex_parameter, without either the view is not
+// available (see getWireframeDefines).
+//
+// Overdraw is counted by image atomics of the shaders in an R32UI image
+// instead of blending into a float target, draws keeping their blending and
+// framebuffer, then drawn over the scene by resolveOverdraw. Shaders force
+// early depth tests so that only the fragments passing them are counted,
+// but those of MASK materials (--sorted-transparency), whose discards need
+// late tests.
+class DebugViews
+{
+public:
+  enum Mode : int
+  {
+    Shaded,
+    Normals,
+    DrawIds,
+    TriangleDensity,
+    MipLevels,
+    Overdraw,
+    Wireframe,
+    MODE_COUNT
+  };
+
+  // The literal binding of uOverdraw in the shaders
+  static const GLuint OVERDRAW_IMAGE_UNIT = 7;
+  static const GLuint DRAWS_BINDING = 21;
+
+  // resolveProgram is fullscreen_triangle.vs.glsl and debug_overdraw.fs.glsl
+  explicit DebugViews(GLProgram resolveProgram);
+
+  DebugViews(const DebugViews &) = delete;
+
+  DebugViews &operator=(const DebugViews &) = delete;
+
+  static const char *getModeName(Mode mode);
+
+  // Defines of the shaders for the barycentrics of the Wireframe view in the
+  // current context, empty if it has none
+  static std::string getWireframeDefines();
+
+  // World space triangles per unit of area of each draw, by index in
+  // drawCommands, bound to DRAWS_BINDING
+  void setTriangleDensities(const std::vector<float> &densities);
+
+  // Count the fragments shaded in the bottom left width x height pixels
+  // until resolveOverdraw
+  void beginOverdraw(GLsizei width, GLsizei height);
+
+  // Draw the counts over the viewport of the current draw framebuffer,
+  // without depth test
+  void resolveOverdraw();
+
+private:
+  GLProgram m_resolveProgram;
+  GLVertexArray m_emptyVertexArray;
+  GLTexture m_overdrawTexture;
+  GLsizei m_width = 0; // Of m_overdrawTexture
+  GLsizei m_height = 0;
+  GLBuffer m_densityBuffer;
+  size_t m_densityCapacity = 0; // Of m_densityBuffer, in floats
+};
+
+// Triangles of a draw of vertexCount vertices per unit of area, estimated
+// from its world space bounds: half the surface of the box, the area of a
+// flat draw in the plane of two axes. 0 for empty or degenerate bounds.
+float getTriangleDensity(
+    GLenum mode, size_t vertexCount, const BoundingBox &bounds);
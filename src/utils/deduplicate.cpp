@@ -0,0 +1,388 @@
+#include "deduplicate.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// FNV-1a, only used to find candidate duplicates, which are then compared
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+  const auto bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+template <typename T>
+uint64_t hashValue(const T &value, uint64_t hash)
+{
+  return hashBytes(&value, sizeof(value), hash);
+}
+
+const uint64_t HASH_SEED = 0xcbf29ce484222325ull;
+
+// Index of the first item equal to each item, itself if there is none.
+// Items are only compared to those of the same hash, items that are not
+// candidates are never duplicates.
+template <typename Equal>
+std::vector<int> findFirstOccurrences(const std::vector<uint64_t> &hashes,
+    const std::vector<bool> &candidates, Equal &&equal)
+{
+  std::vector<int> firsts(hashes.size());
+  std::unordered_map<uint64_t, std::vector<int>> buckets;
+  for (size_t i = 0; i < hashes.size(); ++i) {
+    firsts[i] = int(i);
+    if (!candidates[i]) {
+      continue;
+    }
+    auto &bucket = buckets[hashes[i]];
+    const auto first = std::find_if(begin(bucket), end(bucket),
+        [&](int j) { return equal(size_t(j), i); });
+    if (first != end(bucket)) {
+      firsts[i] = *first;
+    } else {
+      bucket.push_back(int(i));
+    }
+  }
+  return firsts;
+}
+
+size_t countDuplicates(const std::vector<int> &firsts)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < firsts.size(); ++i) {
+    count += firsts[i] != int(i);
+  }
+  return count;
+}
+
+template <typename T>
+bool isEqualButName(T a, T b)
+{
+  a.name.clear();
+  b.name.clear();
+  return a == b;
+}
+
+void remap(int &index, const std::vector<int> &firsts)
+{
+  if (index >= 0 && size_t(index) < firsts.size()) {
+    index = firsts[index];
+  }
+}
+
+// Replace the image of a texture with the KHR_texture_basisu extension
+void remapBasisuSource(
+    tinygltf::Texture &texture, const std::vector<int> &firsts)
+{
+  const auto source = getBasisuImageSource(texture);
+  if (source < 0 || size_t(source) >= firsts.size() ||
+      firsts[source] == source) {
+    return;
+  }
+  auto &extension = texture.extensions["KHR_texture_basisu"];
+  auto object = extension.Get<tinygltf::Value::Object>();
+  object["source"] = tinygltf::Value(firsts[source]);
+  extension = tinygltf::Value(std::move(object));
+}
+
+// Bytes of the elements of an accessor, nullptr if it is sparse, has no
+// bufferView or exceeds its buffer
+const unsigned char *getAccessorBytes(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, size_t &elementSize, size_t &stride)
+{
+  if (accessor.sparse.isSparse || accessor.bufferView < 0 ||
+      size_t(accessor.bufferView) >= model.bufferViews.size()) {
+    return nullptr;
+  }
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(accessor.componentType);
+  const auto componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+  if (componentSize <= 0 || componentCount <= 0 || !accessor.count) {
+    return nullptr;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  if (bufferView.buffer < 0 ||
+      size_t(bufferView.buffer) >= bufferBytes.size()) {
+    return nullptr;
+  }
+  const auto &buffer = bufferBytes[bufferView.buffer];
+  elementSize = size_t(componentSize) * size_t(componentCount);
+  stride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+  const auto offset = bufferView.byteOffset + accessor.byteOffset;
+  const auto size = (accessor.count - 1) * stride + elementSize;
+  if (!buffer.data || offset > buffer.size || size > buffer.size - offset) {
+    return nullptr;
+  }
+  return buffer.data + offset;
+}
+
+// Duplicated images are those with the same pixels (or encoded bytes) and
+// format, read both as colors or both as data
+std::vector<int> findImages(const tinygltf::Model &model)
+{
+  const auto &images = model.images;
+  const auto usages = getImageUsages(model);
+  std::vector<uint64_t> hashes(images.size());
+  std::vector<bool> candidates(images.size());
+  for (size_t i = 0; i < images.size(); ++i) {
+    candidates[i] = !images[i].image.empty();
+  }
+  parallelFor(images.size(), [&](size_t i) {
+    const auto &image = images[i];
+    hashes[i] = hashBytes(image.image.data(), image.image.size(), HASH_SEED);
+  });
+  return findFirstOccurrences(hashes, candidates, [&](size_t a, size_t b) {
+    const auto &imageA = images[a];
+    const auto &imageB = images[b];
+    return usages[a].color == usages[b].color &&
+           imageA.width == imageB.width && imageA.height == imageB.height &&
+           imageA.component == imageB.component &&
+           imageA.bits == imageB.bits &&
+           imageA.pixel_type == imageB.pixel_type &&
+           imageA.as_is == imageB.as_is &&
+           imageA.mimeType == imageB.mimeType &&
+           imageA.image == imageB.image;
+  });
+}
+
+std::vector<int> findSamplers(const tinygltf::Model &model)
+{
+  const auto &samplers = model.samplers;
+  std::vector<uint64_t> hashes(samplers.size());
+  for (size_t i = 0; i < samplers.size(); ++i) {
+    const auto &sampler = samplers[i];
+    auto hash = hashValue(sampler.minFilter, HASH_SEED);
+    hash = hashValue(sampler.magFilter, hash);
+    hash = hashValue(sampler.wrapS, hash);
+    hashes[i] = hashValue(sampler.wrapT, hash);
+  }
+  return findFirstOccurrences(hashes,
+      std::vector<bool>(samplers.size(), true), [&](size_t a, size_t b) {
+        return isEqualButName(samplers[a], samplers[b]);
+      });
+}
+
+std::vector<int> findTextures(const tinygltf::Model &model)
+{
+  const auto &textures = model.textures;
+  std::vector<uint64_t> hashes(textures.size());
+  for (size_t i = 0; i < textures.size(); ++i) {
+    const auto &texture = textures[i];
+    auto hash = hashValue(texture.source, HASH_SEED);
+    hash = hashValue(getBasisuImageSource(texture), hash);
+    hashes[i] = hashValue(texture.sampler, hash);
+  }
+  return findFirstOccurrences(hashes,
+      std::vector<bool>(textures.size(), true), [&](size_t a, size_t b) {
+        return isEqualButName(textures[a], textures[b]);
+      });
+}
+
+std::vector<int> findMaterials(const tinygltf::Model &model)
+{
+  const auto &materials = model.materials;
+  std::vector<uint64_t> hashes(materials.size());
+  for (size_t i = 0; i < materials.size(); ++i) {
+    const auto &material = materials[i];
+    const auto &pbr = material.pbrMetallicRoughness;
+    auto hash = hashBytes(
+        material.alphaMode.data(), material.alphaMode.size(), HASH_SEED);
+    hash = hashValue(material.doubleSided, hash);
+    hash = hashValue(pbr.baseColorTexture.index, hash);
+    hash = hashValue(pbr.metallicRoughnessTexture.index, hash);
+    hash = hashValue(material.normalTexture.index, hash);
+    hash = hashValue(material.occlusionTexture.index, hash);
+    hashes[i] = hashValue(material.emissiveTexture.index, hash);
+  }
+  // Factors are not hashed, tinygltf compares them with a tolerance
+  return findFirstOccurrences(hashes,
+      std::vector<bool>(materials.size(), true), [&](size_t a, size_t b) {
+        auto materialA = materials[a];
+        auto materialB = materials[b];
+        // Legacy copies of the properties, with the texture indices as parsed
+        for (auto material : {&materialA, &materialB}) {
+          material->values.clear();
+          material->additionalValues.clear();
+        }
+        return isEqualButName(std::move(materialA), std::move(materialB));
+      });
+}
+
+// Duplicated accessors are those read by primitives with the same elements,
+// whatever their bufferView and stride
+std::vector<int> findAccessors(
+    const tinygltf::Model &model, const std::vector<BufferBytes> &bufferBytes)
+{
+  const auto &accessors = model.accessors;
+  std::vector<bool> candidates(accessors.size(), false);
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      const auto reference = [&](int accessorIdx) {
+        if (accessorIdx >= 0 && size_t(accessorIdx) < accessors.size()) {
+          candidates[accessorIdx] = true;
+        }
+      };
+      for (const auto &attribute : primitive.attributes) {
+        reference(attribute.second);
+      }
+      for (const auto &target : primitive.targets) {
+        for (const auto &attribute : target) {
+          reference(attribute.second);
+        }
+      }
+      reference(primitive.indices);
+    }
+  }
+
+  std::vector<const unsigned char *> data(accessors.size(), nullptr);
+  std::vector<size_t> elementSizes(accessors.size(), 0);
+  std::vector<size_t> strides(accessors.size(), 0);
+  std::vector<uint64_t> hashes(accessors.size(), 0);
+  parallelFor(accessors.size(), [&](size_t i) {
+    if (!candidates[i]) {
+      return;
+    }
+    const auto &accessor = accessors[i];
+    data[i] = getAccessorBytes(
+        model, bufferBytes, accessor, elementSizes[i], strides[i]);
+    if (!data[i]) {
+      return;
+    }
+    auto hash = hashValue(accessor.componentType, HASH_SEED);
+    hash = hashValue(accessor.type, hash);
+    hash = hashValue(accessor.count, hash);
+    for (size_t element = 0; element < accessor.count; ++element) {
+      hash = hashBytes(data[i] + element * strides[i], elementSizes[i], hash);
+    }
+    hashes[i] = hash;
+  });
+  for (size_t i = 0; i < accessors.size(); ++i) {
+    candidates[i] = candidates[i] && data[i];
+  }
+
+  return findFirstOccurrences(hashes, candidates, [&](size_t a, size_t b) {
+    const auto &accessorA = accessors[a];
+    const auto &accessorB = accessors[b];
+    if (accessorA.componentType != accessorB.componentType ||
+        accessorA.type != accessorB.type ||
+        accessorA.normalized != accessorB.normalized ||
+        accessorA.count != accessorB.count) {
+      return false;
+    }
+    for (size_t element = 0; element < accessorA.count; ++element) {
+      if (std::memcmp(data[a] + element * strides[a],
+              data[b] + element * strides[b], elementSizes[a])) {
+        return false;
+      }
+    }
+    return true;
+  });
+}
+
+std::vector<int> findMeshes(const tinygltf::Model &model)
+{
+  const auto &meshes = model.meshes;
+  std::vector<uint64_t> hashes(meshes.size());
+  for (size_t i = 0; i < meshes.size(); ++i) {
+    auto hash = HASH_SEED;
+    for (const auto &primitive : meshes[i].primitives) {
+      hash = hashValue(primitive.mode, hash);
+      hash = hashValue(primitive.indices, hash);
+      hash = hashValue(primitive.material, hash);
+      for (const auto &attribute : primitive.attributes) {
+        hash = hashValue(attribute.second, hash);
+      }
+    }
+    hashes[i] = hash;
+  }
+  return findFirstOccurrences(hashes,
+      std::vector<bool>(meshes.size(), true), [&](size_t a, size_t b) {
+        const auto &primitivesA = meshes[a].primitives;
+        const auto &primitivesB = meshes[b].primitives;
+        // tinygltf does not compare the extensions of primitives
+        for (size_t i = 0; i < primitivesA.size() && i < primitivesB.size();
+             ++i) {
+          if (primitivesA[i].extensions != primitivesB[i].extensions) {
+            return false;
+          }
+        }
+        return isEqualButName(meshes[a], meshes[b]);
+      });
+}
+
+} // namespace
+
+DeduplicationStats deduplicateModel(
+    tinygltf::Model &model, const std::vector<BufferBytes> &bufferBytes)
+{
+  DeduplicationStats stats;
+
+  // From images to meshes, each finding duplicates among items whose
+  // references are already collapsed
+  const auto images = findImages(model);
+  stats.images = countDuplicates(images);
+  const auto samplers = findSamplers(model);
+  stats.samplers = countDuplicates(samplers);
+  for (auto &texture : model.textures) {
+    remap(texture.source, images);
+    remapBasisuSource(texture, images);
+    remap(texture.sampler, samplers);
+  }
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    if (images[i] != int(i)) {
+      // Never sampled anymore, nor decoded
+      releaseImageData(model.images[i]);
+      model.images[i].as_is = false;
+    }
+  }
+
+  const auto textures = findTextures(model);
+  stats.textures = countDuplicates(textures);
+  for (auto &material : model.materials) {
+    auto &pbr = material.pbrMetallicRoughness;
+    remap(pbr.baseColorTexture.index, textures);
+    remap(pbr.metallicRoughnessTexture.index, textures);
+    remap(material.normalTexture.index, textures);
+    remap(material.occlusionTexture.index, textures);
+    remap(material.emissiveTexture.index, textures);
+  }
+
+  const auto materials = findMaterials(model);
+  stats.materials = countDuplicates(materials);
+  const auto accessors = findAccessors(model, bufferBytes);
+  stats.accessors = countDuplicates(accessors);
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      remap(primitive.material, materials);
+      remap(primitive.indices, accessors);
+      for (auto &attribute : primitive.attributes) {
+        remap(attribute.second, accessors);
+      }
+      for (auto &target : primitive.targets) {
+        for (auto &attribute : target) {
+          remap(attribute.second, accessors);
+        }
+      }
+    }
+  }
+
+  const auto meshes = findMeshes(model);
+  stats.meshes = countDuplicates(meshes);
+  for (auto &node : model.nodes) {
+    remap(node.mesh, meshes);
+  }
+  for (size_t i = 0; i < model.meshes.size(); ++i) {
+    if (meshes[i] != int(i)) {
+      model.meshes[i].primitives.clear();
+    }
+  }
+
+  return stats;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <vector>
+
+// Duplicates replaced by their first occurrence. Duplicates are kept in the
+// model, unreferenced, so that indices stay valid
+struct DeduplicationStats
+{
+  size_t images = 0;
+  size_t samplers = 0;
+  size_t textures = 0;
+  size_t materials = 0;
+  size_t accessors = 0;
+  size_t meshes = 0;
+};
+
+// Collapse identical images, samplers, textures, materials, mesh accessors
+// and meshes, say those an exporter wrote once per node. Images and accessors
+// are compared by content, hashed on the global JobSystem, the others by
+// their properties once their references are collapsed (names are ignored).
+//
+// Textures then sample the first of identical images, whose duplicates have
+// their pixels released: each is uploaded once. Materials read the first of
+// identical textures, primitives the first of identical materials and
+// accessors, and nodes the first of identical meshes, which are then drawn
+// instanced; duplicated meshes have their primitives cleared. Images read
+// both as colors and as data, images without pixels (not fetched yet), sparse
+// accessors and accessors out of their buffer are left as they are.
+DeduplicationStats deduplicateModel(
+    tinygltf::Model &model, const std::vector<BufferBytes> &bufferBytes);
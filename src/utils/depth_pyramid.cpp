@@ -0,0 +1,123 @@
+#include "depth_pyramid.hpp"
+#include "texture_uploader.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+GLTexture createTexture(GLsizei levelCount, GLenum format, GLsizei width,
+    GLsizei height)
+{
+  auto textureObject = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D, textureObject.glId());
+  glTexStorage2D(GL_TEXTURE_2D, levelCount, format, width, height);
+  // Only read with texelFetch, but must be complete for it
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+      levelCount > 1 ? GL_NEAREST_MIPMAP_NEAREST : GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return textureObject;
+}
+
+} // namespace
+
+DepthPyramid::DepthPyramid(
+    GLsizei width, GLsizei height, GLProgram reduceProgram) :
+    m_width(width),
+    m_height(height),
+    m_levelCount(getMipLevelCount(width, height)),
+    m_reduceProgram(std::move(reduceProgram))
+{
+  createTargets();
+
+  m_uSourceLevel = m_reduceProgram.getUniformLocation("uSourceLevel");
+  for (const auto &unit : {std::make_pair("uDepthTexture", 0),
+           std::make_pair("uSource", 0), std::make_pair("uDestination", 1)}) {
+    glProgramUniform1i(m_reduceProgram.glId(),
+        m_reduceProgram.getUniformLocation(unit.first), unit.second);
+  }
+}
+
+void DepthPyramid::resize(GLsizei width, GLsizei height)
+{
+  if (width == m_width && height == m_height) {
+    return;
+  }
+  m_width = width;
+  m_height = height;
+  m_levelCount = getMipLevelCount(width, height);
+  m_hasDepth = false;
+  createTargets();
+}
+
+void DepthPyramid::createTargets()
+{
+  m_colorTexture = createTexture(1, GL_RGBA8, m_width, m_height);
+  m_depthTexture = createTexture(1, GL_DEPTH_COMPONENT32F, m_width, m_height);
+  m_pyramidTexture = createTexture(m_levelCount, GL_R32F, m_width, m_height);
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  m_framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture.glId(), 0);
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture.glId(), 0);
+  const auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("DepthPyramid: incomplete framebuffer");
+  }
+  const GLuint textures[] = {m_colorTexture.glId(), m_depthTexture.glId(),
+      m_pyramidTexture.glId()};
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 3, textures);
+}
+
+void DepthPyramid::bindFramebuffer() const
+{
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+}
+
+void DepthPyramid::resolve(GLuint targetFramebuffer)
+{
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer.glId());
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+  glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, targetFramebuffer);
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_reduceProgram.use();
+
+  glActiveTexture(GL_TEXTURE0);
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  // Complete with its own parameters, not those of a bound sampler object
+  GLint previousSampler = 0;
+  glGetIntegerv(GL_SAMPLER_BINDING, &previousSampler);
+  glBindSampler(0, 0);
+  glBindTexture(GL_TEXTURE_2D, m_depthTexture.glId());
+  for (GLint level = 0; level < m_levelCount; ++level) {
+    const auto width = std::max(m_width >> level, 1);
+    const auto height = std::max(m_height >> level, 1);
+    glUniform1i(m_uSourceLevel, level - 1);
+    if (level > 0) {
+      glBindImageTexture(0, m_pyramidTexture.glId(), level - 1, GL_FALSE, 0,
+          GL_READ_ONLY, GL_R32F);
+    }
+    glBindImageTexture(1, m_pyramidTexture.glId(), level, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute(GLuint((width + 7) / 8), GLuint((height + 7) / 8), 1);
+    // The next level reads this one
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  glBindSampler(0, GLuint(previousSampler));
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+  glUseProgram(GLuint(previousProgram));
+  m_hasDepth = true;
+}
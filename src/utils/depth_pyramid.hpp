@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+
+// Hierarchical depth buffer (Hi-Z) for occlusion culling.
+//
+// The scene is drawn into an offscreen framebuffer whose depth attachment is
+// a texture. resolve() copies the color to the target framebuffer and reduces
+// the depth into a mipmapped R32F texture where each texel holds the farthest
+// depth of the texels it covers in the level below. A box whose nearest depth
+// is farther than the texels covering its screen rectangle is hidden.
+class DepthPyramid
+{
+public:
+  // reduceProgram is depth_pyramid.cs.glsl
+  DepthPyramid(GLsizei width, GLsizei height, GLProgram reduceProgram);
+
+  DepthPyramid(const DepthPyramid &) = delete;
+
+  DepthPyramid &operator=(const DepthPyramid &) = delete;
+
+  // Reallocate the framebuffer and the pyramid for another size, which has
+  // no depth until the next resolve()
+  void resize(GLsizei width, GLsizei height);
+
+  // Bind the framebuffer the scene must be drawn in
+  void bindFramebuffer() const;
+
+  // Blit the color of the drawn scene to targetFramebuffer, left bound to
+  // GL_DRAW_FRAMEBUFFER, and rebuild the pyramid from its depth
+  void resolve(GLuint targetFramebuffer);
+
+  // R32F texture with the reduced depth in [0, 1], level 0 has the size of
+  // the framebuffer
+  GLuint texture() const { return m_pyramidTexture.glId(); }
+
+  // False until resolve() has been called once
+  bool hasDepth() const { return m_hasDepth; }
+
+private:
+  // Textures and framebuffer of the current size
+  void createTargets();
+
+  GLsizei m_width;
+  GLsizei m_height;
+  GLsizei m_levelCount;
+  GLProgram m_reduceProgram;
+  GLint m_uSourceLevel = -1;
+  GLTexture m_colorTexture;
+  GLTexture m_depthTexture;
+  GLTexture m_pyramidTexture;
+  GLFramebuffer m_framebuffer;
+  bool m_hasDepth = false;
+};
@@ -0,0 +1,300 @@
+#include "draco.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+
+#ifdef GLTF_VIEWER_USE_DRACO
+#include <draco/compression/decode.h>
+#include <draco/core/decoder_buffer.h>
+#endif
+
+namespace {
+
+const char *const DRACO_EXTENSION = "KHR_draco_mesh_compression";
+
+// An accessor written by the job of a compressed primitive
+struct DecodedAccessor
+{
+  int accessor;
+  int dracoId; // Of its attribute, -1 for the indices
+  size_t byteOffset; // In the new buffer
+  size_t byteLength;
+};
+
+struct CompressedPrimitive
+{
+  int bufferView = -1; // Of the compressed mesh
+  std::vector<DecodedAccessor> accessors;
+  std::string error;
+};
+
+#ifdef GLTF_VIEWER_USE_DRACO
+void removeExtension(std::vector<std::string> &extensions)
+{
+  extensions.erase(
+      std::remove(extensions.begin(), extensions.end(), DRACO_EXTENSION),
+      extensions.end());
+}
+
+template <typename T>
+bool writeValues(const draco::PointAttribute &attribute, size_t pointCount,
+    int componentCount, unsigned char *output)
+{
+  T values[16];
+  const auto valueSize = sizeof(T) * componentCount;
+  for (uint32_t i = 0; i < pointCount; ++i) {
+    const auto valueIdx = attribute.mapped_index(draco::PointIndex(i));
+    if (!attribute.ConvertValue<T>(
+            valueIdx, int8_t(componentCount), values)) {
+      return false;
+    }
+    std::memcpy(output + valueSize * i, values, valueSize);
+  }
+  return true;
+}
+
+// The values of attribute for each point, in the type of accessor
+bool writeAttribute(const draco::PointAttribute &attribute,
+    const tinygltf::Accessor &accessor, unsigned char *output)
+{
+  const auto componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+  if (componentCount < 1 || componentCount > 16) {
+    return false;
+  }
+  switch (accessor.componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    return writeValues<int8_t>(
+        attribute, accessor.count, componentCount, output);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return writeValues<uint8_t>(
+        attribute, accessor.count, componentCount, output);
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    return writeValues<int16_t>(
+        attribute, accessor.count, componentCount, output);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return writeValues<uint16_t>(
+        attribute, accessor.count, componentCount, output);
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+    return writeValues<uint32_t>(
+        attribute, accessor.count, componentCount, output);
+  case TINYGLTF_COMPONENT_TYPE_FLOAT:
+    return writeValues<float>(
+        attribute, accessor.count, componentCount, output);
+  default:
+    return false;
+  }
+}
+
+template <typename T>
+void writeIndices(const draco::Mesh &mesh, unsigned char *output)
+{
+  for (uint32_t f = 0; f < mesh.num_faces(); ++f) {
+    const auto &face = mesh.face(draco::FaceIndex(f));
+    const T triangle[] = {
+        T(face[0].value()), T(face[1].value()), T(face[2].value())};
+    std::memcpy(output + sizeof(triangle) * f, triangle, sizeof(triangle));
+  }
+}
+
+// Decode the mesh of compressed into its accessors, in the bytes of buffer.
+// Returns the reason of the failure, empty on success.
+std::string decodePrimitive(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const CompressedPrimitive &compressed, unsigned char *buffer)
+{
+  const auto &bufferView = model.bufferViews[compressed.bufferView];
+  draco::DecoderBuffer decoderBuffer;
+  decoderBuffer.Init(reinterpret_cast<const char *>(
+                         bufferBytes[bufferView.buffer].data +
+                         bufferView.byteOffset),
+      bufferView.byteLength);
+  draco::Decoder decoder;
+  auto decoded = decoder.DecodeMeshFromBuffer(&decoderBuffer);
+  if (!decoded.ok()) {
+    return decoded.status().error_msg_string();
+  }
+  const auto &mesh = *decoded.value();
+
+  for (const auto &decodedAccessor : compressed.accessors) {
+    const auto &accessor = model.accessors[decodedAccessor.accessor];
+    const auto dracoId = decodedAccessor.dracoId;
+    auto *output = buffer + decodedAccessor.byteOffset;
+    if (dracoId < 0) {
+      if (accessor.count != 3 * size_t(mesh.num_faces())) {
+        return "index count does not match the decoded mesh";
+      }
+      switch (accessor.componentType) {
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        writeIndices<uint8_t>(mesh, output);
+        break;
+      case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        writeIndices<uint16_t>(mesh, output);
+        break;
+      default:
+        writeIndices<uint32_t>(mesh, output);
+        break;
+      }
+      continue;
+    }
+    const auto *attribute = mesh.GetAttributeByUniqueId(dracoId);
+    if (!attribute) {
+      return "no attribute " + std::to_string(dracoId) +
+             " in the decoded mesh";
+    }
+    if (accessor.count != size_t(mesh.num_points()) ||
+        !writeAttribute(*attribute, accessor, output)) {
+      return "attribute " + std::to_string(dracoId) +
+             " does not match its accessor";
+    }
+  }
+  return {};
+}
+#endif
+
+} // namespace
+
+bool decodeDracoPrimitives(tinygltf::Model &model,
+    std::vector<BufferBytes> &bufferBytes, std::string &err)
+{
+  std::vector<tinygltf::Primitive *> primitives;
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      if (primitive.extensions.count(DRACO_EXTENSION)) {
+        primitives.push_back(&primitive);
+      }
+    }
+  }
+  if (primitives.empty()) {
+    return true;
+  }
+  const auto &required = model.extensionsRequired;
+  const auto isRequired = std::find(required.begin(), required.end(),
+                              DRACO_EXTENSION) != required.end();
+
+#ifndef GLTF_VIEWER_USE_DRACO
+  (void)bufferBytes; // Only read by the decoder
+  if (isRequired) {
+    err = std::string("the model requires ") + DRACO_EXTENSION +
+          ", the viewer is built without Draco (GLTF_VIEWER_USE_DRACO)";
+    return false;
+  }
+  std::cerr << "Warning : the viewer is built without Draco, "
+            << primitives.size()
+            << " primitives are drawn from their uncompressed fallback"
+            << std::endl;
+  return true;
+#else
+  // Lay out the decoded accessors in the new buffer, the first primitive
+  // referencing an accessor writes it. The model is only changed once all
+  // are decoded, failures leave the uncompressed fallback untouched
+  tinygltf::Buffer buffer;
+  size_t bufferSize = 0;
+  std::set<int> laidOutAccessors;
+  std::vector<CompressedPrimitive> compressedPrimitives(primitives.size());
+  const auto layOut = [&](CompressedPrimitive &compressed, int accessorIdx,
+                          int dracoId) {
+    if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size() ||
+        !laidOutAccessors.insert(accessorIdx).second) {
+      return;
+    }
+    const auto &accessor = model.accessors[accessorIdx];
+    DecodedAccessor decodedAccessor;
+    decodedAccessor.accessor = accessorIdx;
+    decodedAccessor.dracoId = dracoId;
+    decodedAccessor.byteOffset = (bufferSize + 3) / 4 * 4;
+    decodedAccessor.byteLength =
+        accessor.count *
+        size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType)) *
+        size_t(tinygltf::GetNumComponentsInType(accessor.type));
+    bufferSize = decodedAccessor.byteOffset + decodedAccessor.byteLength;
+    compressed.accessors.push_back(decodedAccessor);
+  };
+  for (size_t i = 0; i < primitives.size(); ++i) {
+    auto &compressed = compressedPrimitives[i];
+    const auto &primitive = *primitives[i];
+    const auto &extension = primitive.extensions.at(DRACO_EXTENSION);
+    const auto &bufferViewValue = extension.Get("bufferView");
+    const auto &attributesValue = extension.Get("attributes");
+    if (!bufferViewValue.IsInt() || !attributesValue.IsObject()) {
+      err += std::string("invalid ") + DRACO_EXTENSION + " extension\n";
+      return false;
+    }
+    compressed.bufferView = bufferViewValue.Get<int>();
+    if (compressed.bufferView < 0 ||
+        size_t(compressed.bufferView) >= model.bufferViews.size()) {
+      err += "invalid Draco buffer view\n";
+      return false;
+    }
+    const auto &bufferView = model.bufferViews[compressed.bufferView];
+    if (bufferView.buffer < 0 ||
+        size_t(bufferView.buffer) >= bufferBytes.size() ||
+        bufferView.byteOffset + bufferView.byteLength >
+            bufferBytes[bufferView.buffer].size) {
+      err += "Draco buffer view out of its buffer\n";
+      return false;
+    }
+    layOut(compressed, primitive.indices, -1);
+    for (const auto &attribute :
+        attributesValue.Get<tinygltf::Value::Object>()) {
+      const auto it = primitive.attributes.find(attribute.first);
+      if (it != end(primitive.attributes) && attribute.second.IsInt()) {
+        layOut(compressed, it->second, attribute.second.Get<int>());
+      }
+    }
+  }
+  buffer.data.resize(bufferSize);
+
+  parallelFor(compressedPrimitives.size(), [&](size_t i) {
+    compressedPrimitives[i].error = decodePrimitive(
+        model, bufferBytes, compressedPrimitives[i], buffer.data.data());
+  });
+
+  auto result = true;
+  for (const auto &compressed : compressedPrimitives) {
+    if (!compressed.error.empty()) {
+      err += "Draco decoding failed: " + compressed.error + "\n";
+      result = false;
+    }
+  }
+  if (!result && !isRequired) {
+    std::cerr << "Warning : " << err
+              << "drawing the uncompressed fallback instead" << std::endl;
+    err.clear();
+    return true;
+  }
+  if (!result) {
+    return false;
+  }
+
+  const auto bufferIdx = int(model.buffers.size());
+  for (const auto &compressed : compressedPrimitives) {
+    for (const auto &decodedAccessor : compressed.accessors) {
+      tinygltf::BufferView bufferView;
+      bufferView.buffer = bufferIdx;
+      bufferView.byteOffset = decodedAccessor.byteOffset;
+      bufferView.byteLength = decodedAccessor.byteLength;
+      bufferView.target = decodedAccessor.dracoId < 0
+                              ? TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER
+                              : TINYGLTF_TARGET_ARRAY_BUFFER;
+      model.bufferViews.push_back(bufferView);
+      auto &accessor = model.accessors[decodedAccessor.accessor];
+      accessor.bufferView = int(model.bufferViews.size() - 1);
+      accessor.byteOffset = 0;
+      accessor.sparse.isSparse = false;
+    }
+  }
+  for (auto *primitive : primitives) {
+    primitive->extensions.erase(DRACO_EXTENSION);
+  }
+  removeExtension(model.extensionsUsed);
+  removeExtension(model.extensionsRequired);
+  model.buffers.push_back(std::move(buffer));
+  bufferBytes.push_back(
+      {model.buffers.back().data.data(), model.buffers.back().data.size()});
+  return true;
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <string>
+#include <vector>
+
+// Decode the primitives compressed with KHR_draco_mesh_compression, one
+// primitive per job on all hardware threads. The sizes of the decoded indices
+// and attributes are given by their accessors, so they are laid out in a new
+// buffer appended to model.buffers (and its bytes to bufferBytes) before
+// decoding, and each job writes its primitive in place: createBufferObjects
+// uploads them like any other buffer and the scene cache stores them, so later
+// runs do not decode again. The extension is then removed from the model.
+//
+// Needs the viewer to be built with Draco (GLTF_VIEWER_USE_DRACO). Without it,
+// files that only use the extension are drawn from their uncompressed
+// fallback. Returns false if the model requires the extension and cannot be
+// decoded, with the reason in err.
+bool decodeDracoPrimitives(tinygltf::Model &model,
+    std::vector<BufferBytes> &bufferBytes, std::string &err);
@@ -0,0 +1,51 @@
+#include "draw_id_picker.hpp"
+
+DrawIdPicker::DrawIdPicker() : m_buffer(GLBuffer::generate())
+{
+  const GLbitfield flags =
+      GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer.glId());
+  glBufferStorage(GL_PIXEL_PACK_BUFFER, sizeof(uint32_t), nullptr, flags);
+  m_mappedId = static_cast<const uint32_t *>(
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(uint32_t), flags));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+DrawIdPicker::~DrawIdPicker()
+{
+  glDeleteSync(m_fence);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer.glId());
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void DrawIdPicker::request(
+    const OffscreenFramebuffer &framebuffer, size_t x, size_t y)
+{
+  if (!framebuffer.drawIdTexture() || x >= framebuffer.width() ||
+      y >= framebuffer.height()) {
+    return;
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, m_buffer.glId());
+  framebuffer.readDrawId(x, y, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glDeleteSync(m_fence);
+  m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool DrawIdPicker::poll(uint32_t &drawId)
+{
+  if (!m_fence) {
+    return false;
+  }
+  // Flushed so that the fence is signaled without waiting for another call
+  const auto status =
+      glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return false;
+  }
+  glDeleteSync(m_fence);
+  m_fence = nullptr;
+  drawId = *m_mappedId;
+  return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "images.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Read the draw ID of a pixel of the draw IDs of an OffscreenFramebuffer
+// (see drawIds) without waiting for the GPU. The pixel is copied into a 4
+// bytes pixel pack buffer, persistently mapped, and a fence is put after the
+// copy: a later frame reads it once the fence is signaled, while the GPU is
+// a frame or two behind.
+class DrawIdPicker
+{
+public:
+  DrawIdPicker();
+
+  ~DrawIdPicker();
+
+  DrawIdPicker(const DrawIdPicker &) = delete;
+
+  DrawIdPicker &operator=(const DrawIdPicker &) = delete;
+
+  // Queue the copy of pixel (x, y) of the draw IDs last rendered in
+  // framebuffer, from its bottom left. Replaces the pending request.
+  void request(const OffscreenFramebuffer &framebuffer, size_t x, size_t y);
+
+  // True once the copy of the last request is done, drawId is then its draw
+  // ID. False while the copy is pending or without a request, never waits.
+  bool poll(uint32_t &drawId);
+
+private:
+  GLBuffer m_buffer;
+  const uint32_t *m_mappedId = nullptr;
+  GLsync m_fence = nullptr; // Of the pending request, null if none
+};
@@ -0,0 +1,33 @@
+#include "draw_stats.hpp"
+
+#include <ostream>
+
+size_t DrawStats::getTriangleCount(GLenum mode, size_t vertexCount)
+{
+  switch (mode) {
+  case GL_TRIANGLES:
+    return vertexCount / 3;
+  case GL_TRIANGLE_STRIP:
+  case GL_TRIANGLE_FAN:
+    return vertexCount >= 3 ? vertexCount - 2 : 0;
+  default:
+    return 0;
+  }
+}
+
+void writeDrawStatsCsvHeader(std::ostream &output)
+{
+  output << "frame,draw_calls,triangles,vertex_array_binds,texture_binds,"
+            "uniform_uploads,culled_primitives,uploaded_buffer_bytes,"
+            "occlusion_queries,conditional_draws,impostors\n";
+}
+
+void writeDrawStatsCsvRow(
+    std::ostream &output, size_t frame, const DrawStats &stats)
+{
+  output << frame << ',' << stats.drawCalls << ',' << stats.triangles << ','
+         << stats.vertexArrayBinds << ',' << stats.textureBinds << ','
+         << stats.uniformUploads << ',' << stats.culledPrimitives << ','
+         << stats.uploadedBufferBytes << ',' << stats.occlusionQueries << ','
+         << stats.conditionalDraws << ',' << stats.impostors << '\n';
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <iosfwd>
+
+// Work submitted to OpenGL by the CPU for a frame, counted where the calls
+// are made. Only counts what the CPU knows: with GPU culling, draws culled
+// by the compute shader are still counted as submitted.
+struct DrawStats
+{
+  size_t drawCalls = 0; // A multi-draw counts once
+  size_t triangles = 0; // Of all instances and commands of the draws
+  size_t vertexArrayBinds = 0;
+  size_t textureBinds = 0;
+  size_t uniformUploads = 0; // glUniform calls and uniform blocks set
+  size_t culledPrimitives = 0;
+  size_t uploadedBufferBytes = 0; // By glBufferSubData and uniform blocks
+  size_t occlusionQueries = 0; // Boxes drawn, also counted as draw calls
+  // Draws the GPU skips if their query failed, their triangles are counted
+  size_t conditionalDraws = 0;
+  // Instances drawn as impostors, by one draw call, their quads counted
+  size_t impostors = 0;
+
+  // Add the triangles of instanceCount instances of vertexCount vertices
+  void addTriangles(GLenum mode, size_t vertexCount, size_t instanceCount)
+  {
+    triangles += getTriangleCount(mode, vertexCount) * instanceCount;
+  }
+
+  // Triangles of a draw of vertexCount vertices, 0 for points and lines
+  static size_t getTriangleCount(GLenum mode, size_t vertexCount);
+};
+
+// One row per frame, frame being its index
+void writeDrawStatsCsvHeader(std::ostream &output);
+
+void writeDrawStatsCsvRow(
+    std::ostream &output, size_t frame, const DrawStats &stats);
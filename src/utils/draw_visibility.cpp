@@ -0,0 +1,130 @@
+#include "draw_visibility.hpp"
+
+#include <algorithm>
+
+DrawVisibility::DrawVisibility(
+    FlatScene &scene, std::vector<size_t> firstDraws, size_t drawCount) :
+    m_scene(scene),
+    m_firstDraws(std::move(firstDraws)),
+    m_drawCount(drawCount),
+    m_drawBits((drawCount + 31) / 32, 0),
+    m_changedBegin(m_drawBits.size())
+{
+  std::fill(begin(m_scene.hidden), end(m_scene.hidden), uint8_t(0));
+  setDraws(0, m_drawCount, true);
+  takeChangedWords();
+}
+
+bool DrawVisibility::isAncestorHidden(int entry) const
+{
+  for (auto i = m_scene.parents[size_t(entry)]; i >= 0;
+       i = m_scene.parents[size_t(i)]) {
+    if (m_scene.hidden[size_t(i)]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DrawVisibility::setHidden(int entry, bool hidden)
+{
+  auto &bit = m_scene.hidden[size_t(entry)];
+  if (bool(bit) == hidden) {
+    return;
+  }
+  bit = hidden;
+  m_hiddenCount = hidden ? m_hiddenCount + 1 : m_hiddenCount - 1;
+  // Its draws stay hidden by the ancestor
+  if (isAncestorHidden(entry)) {
+    return;
+  }
+  if (hidden) {
+    const auto draws = getSubtreeDraws(entry);
+    setDraws(draws.first, draws.second, false);
+  } else {
+    showSubtree(entry);
+  }
+}
+
+void DrawVisibility::isolate(int entry)
+{
+  std::fill(begin(m_scene.hidden), end(m_scene.hidden), uint8_t(0));
+  m_hiddenCount = 0;
+  // The roots of the subtrees beside entry and its ancestors
+  for (size_t i = 0; i < m_scene.size();) {
+    if (int(i) == entry) {
+      i = size_t(m_scene.subtreeEnds[i]);
+    } else if (int(i) < entry && m_scene.subtreeEnds[i] > entry) {
+      ++i;
+    } else {
+      m_scene.hidden[i] = 1;
+      ++m_hiddenCount;
+      i = size_t(m_scene.subtreeEnds[i]);
+    }
+  }
+  setDraws(0, m_drawCount, false);
+  const auto draws = getSubtreeDraws(entry);
+  setDraws(draws.first, draws.second, true);
+}
+
+void DrawVisibility::showAll()
+{
+  std::fill(begin(m_scene.hidden), end(m_scene.hidden), uint8_t(0));
+  m_hiddenCount = 0;
+  setDraws(0, m_drawCount, true);
+}
+
+std::pair<size_t, size_t> DrawVisibility::takeChangedWords()
+{
+  const auto changed = std::make_pair(
+      std::min(m_changedBegin, m_changedEnd), m_changedEnd);
+  m_changedBegin = m_drawBits.size();
+  m_changedEnd = 0;
+  return changed;
+}
+
+std::pair<size_t, size_t> DrawVisibility::getSubtreeDraws(int entry) const
+{
+  const auto end = size_t(m_scene.subtreeEnds[size_t(entry)]);
+  return {m_firstDraws[size_t(entry)],
+      end < m_scene.size() ? m_firstDraws[end] : m_drawCount};
+}
+
+void DrawVisibility::setDraws(size_t begin, size_t end, bool visible)
+{
+  if (begin >= end) {
+    return;
+  }
+  const auto firstWord = begin >> 5;
+  const auto lastWord = (end - 1) >> 5;
+  const auto value = visible ? ~0u : 0u;
+  for (auto word = firstWord; word <= lastWord; ++word) {
+    // Bits of [begin, end) in the word
+    auto mask = ~0u;
+    if (word == firstWord) {
+      mask &= ~0u << (begin & 31);
+    }
+    if (word == lastWord && (end & 31)) {
+      mask &= ~0u >> (32 - (end & 31));
+    }
+    m_drawBits[word] = (m_drawBits[word] & ~mask) | (value & mask);
+  }
+  m_changedBegin = std::min(m_changedBegin, firstWord);
+  m_changedEnd = std::max(m_changedEnd, lastWord + 1);
+}
+
+void DrawVisibility::showSubtree(int entry)
+{
+  const auto draws = getSubtreeDraws(entry);
+  setDraws(draws.first, draws.second, true);
+  const auto end = size_t(m_scene.subtreeEnds[size_t(entry)]);
+  for (auto i = size_t(entry) + 1; i < end;) {
+    if (m_scene.hidden[i]) {
+      const auto hiddenDraws = getSubtreeDraws(int(i));
+      setDraws(hiddenDraws.first, hiddenDraws.second, false);
+      i = size_t(m_scene.subtreeEnds[i]);
+    } else {
+      ++i;
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "flat_scene.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Visibility of the entries of a FlatScene and of their draws, to hide, show
+// and isolate subtrees without rebuilding any draw data.
+//
+// Entries have a hidden bit in scene.hidden, a hidden entry hiding its
+// subtree. Draws have a visible bit, in 32 bits words as read by
+// cull_draws.cs.glsl. The draws of entry i start at firstDraws[i] and those of
+// a subtree are contiguous: hiding a subtree fills a range of words, a few
+// microseconds for 100k draws, and showing it again also skips the subtrees
+// of the entries hidden under it. Culling then tests the bit of each draw,
+// vertex arrays and commands stay the same.
+class DrawVisibility
+{
+public:
+  // All visible, the entries of scene must not change while the visibility
+  // is used
+  DrawVisibility(FlatScene &scene, std::vector<size_t> firstDraws,
+      size_t drawCount);
+
+  bool isHidden(int entry) const { return m_scene.hidden[size_t(entry)]; }
+
+  // Whether an ancestor of entry is hidden
+  bool isAncestorHidden(int entry) const;
+
+  void setHidden(int entry, bool hidden);
+
+  // Hide every entry but entry, its subtree and its ancestors
+  void isolate(int entry);
+
+  void showAll();
+
+  // Entries whose own bit is set
+  size_t hiddenCount() const { return m_hiddenCount; }
+
+  bool isDrawVisible(size_t draw) const
+  {
+    return (m_drawBits[draw >> 5] >> (draw & 31)) & 1u;
+  }
+
+  // Whether isDrawVisible is true for all draws, to skip testing them
+  bool allVisible() const { return m_hiddenCount == 0; }
+
+  const std::vector<uint32_t> &drawBits() const { return m_drawBits; }
+
+  // Range of the words of drawBits changed since the previous call, to upload
+  // them, empty if none
+  std::pair<size_t, size_t> takeChangedWords();
+
+private:
+  // Draws of the subtree of entry
+  std::pair<size_t, size_t> getSubtreeDraws(int entry) const;
+
+  void setDraws(size_t begin, size_t end, bool visible);
+
+  // Set the draws of the subtree of entry visible, but those of the subtrees
+  // hidden under it
+  void showSubtree(int entry);
+
+  FlatScene &m_scene;
+  std::vector<size_t> m_firstDraws;
+  size_t m_drawCount;
+  std::vector<uint32_t> m_drawBits;
+  size_t m_hiddenCount = 0;
+  size_t m_changedBegin;
+  size_t m_changedEnd = 0;
+};
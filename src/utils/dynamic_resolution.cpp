@@ -0,0 +1,56 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution(
+    double targetSeconds, float minScale, size_t frameLatency) :
+    m_targetSeconds(targetSeconds),
+    m_minScale(std::min(std::max(minScale, 0.01f), 1.f)),
+    m_frameLatency(std::max(frameLatency, size_t(1))),
+    m_queries(2 * m_frameLatency),
+    m_isQueryIssued(m_frameLatency, false),
+    m_queryScales(m_frameLatency, 1.f)
+{
+  glGenQueries(GLsizei(m_queries.size()), m_queries.data());
+}
+
+DynamicResolution::~DynamicResolution()
+{
+  glDeleteQueries(GLsizei(m_queries.size()), m_queries.data());
+}
+
+void DynamicResolution::begin()
+{
+  if (m_isQueryIssued[m_slot]) {
+    GLint isAvailable = 0;
+    glGetQueryObjectiv(
+        m_queries[2 * m_slot + 1], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (isAvailable) {
+      GLuint64 begin = 0, end = 0;
+      glGetQueryObjectui64v(m_queries[2 * m_slot], GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(m_queries[2 * m_slot + 1], GL_QUERY_RESULT, &end);
+      const auto seconds = double(end - begin) * 1e-9;
+      // Within 10% of the target, the scale is kept to avoid oscillations.
+      // Otherwise it moves halfway to the scale expected to reach the
+      // target.
+      if (seconds > 0 && std::abs(seconds - m_targetSeconds) >
+                             0.1 * m_targetSeconds) {
+        const auto targetScale = float(
+            m_queryScales[m_slot] * std::sqrt(m_targetSeconds / seconds));
+        m_scale = std::min(
+            std::max(0.5f * (m_scale + targetScale), m_minScale), 1.f);
+      }
+    }
+    m_isQueryIssued[m_slot] = false;
+  }
+  glQueryCounter(m_queries[2 * m_slot], GL_TIMESTAMP);
+}
+
+void DynamicResolution::end()
+{
+  glQueryCounter(m_queries[2 * m_slot + 1], GL_TIMESTAMP);
+  m_isQueryIssued[m_slot] = true;
+  m_queryScales[m_slot] = m_scale;
+  m_slot = (m_slot + 1) % m_frameLatency;
+}
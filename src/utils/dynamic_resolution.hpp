@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Scale of the resolution the scene is drawn at, adjusted so that the GPU
+// time of its frames stays close to a target. Pixel costs are assumed to
+// dominate: the time of a frame drawn at scale s is taken as proportional to
+// s * s.
+//
+// Frames are timed with pairs of GL_TIMESTAMP queries, which do not
+// conflict with the GL_TIME_ELAPSED queries of FrameProfiler, in a ring of
+// frameLatency frames. As in FrameProfiler, results are read when the ring
+// comes back to them and dropped if not available: adjusting never waits for
+// the GPU.
+class DynamicResolution
+{
+public:
+  DynamicResolution(
+      double targetSeconds, float minScale = 0.25f, size_t frameLatency = 4);
+
+  ~DynamicResolution();
+
+  DynamicResolution(const DynamicResolution &) = delete;
+
+  DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+  // Of both dimensions of the images, in [minScale, 1]
+  float scale() const { return m_scale; }
+
+  // Time the GPU commands issued in between, drawn at scale(). begin first
+  // adjusts scale() to the times of the previous frames available.
+  void begin();
+
+  void end();
+
+private:
+  double m_targetSeconds;
+  float m_minScale;
+  float m_scale = 1.f;
+  size_t m_frameLatency;
+  size_t m_slot = 0; // In the query ring, of the current frame
+  std::vector<GLuint> m_queries; // Begin and end timestamps of each slot
+  std::vector<bool> m_isQueryIssued;
+  std::vector<float> m_queryScales; // Scale of the frame timed by each slot
+};
@@ -0,0 +1,178 @@
+#include "egl_context.hpp"
+#include "gl_debug_output.hpp"
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#ifdef GLTF_VIEWER_USE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_CONTEXT_OPENGL_NO_ERROR_KHR
+#define EGL_CONTEXT_OPENGL_NO_ERROR_KHR 0x31B3
+#endif
+
+namespace {
+
+bool hasEGLExtension(EGLDisplay display, const char *name)
+{
+  const auto *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions) {
+    return false;
+  }
+  // Space separated names
+  const auto length = std::strlen(name);
+  for (const auto *found = std::strstr(extensions, name); found;
+       found = std::strstr(found + length, name)) {
+    if ((found == extensions || found[-1] == ' ') &&
+        (found[length] == ' ' || found[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Devices of EGL_EXT_platform_device, empty without it
+std::vector<EGLDeviceEXT> getDevices()
+{
+  const auto queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+      eglGetProcAddress("eglQueryDevicesEXT"));
+  EGLint deviceCount = 0;
+  if (!queryDevices || !eglGetProcAddress("eglGetPlatformDisplayEXT") ||
+      !hasEGLExtension(EGL_NO_DISPLAY, "EGL_EXT_platform_device") ||
+      !queryDevices(0, nullptr, &deviceCount) || deviceCount < 1) {
+    return {};
+  }
+  std::vector<EGLDeviceEXT> devices(static_cast<size_t>(deviceCount));
+  if (!queryDevices(deviceCount, devices.data(), &deviceCount)) {
+    return {};
+  }
+  devices.resize(size_t(deviceCount));
+  return devices;
+}
+
+EGLDisplay getHeadlessDisplay(int deviceIndex)
+{
+  const auto getPlatformDisplay =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  const auto devices = getDevices();
+  if (deviceIndex >= 0 && !devices.empty()) {
+    return getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT,
+        devices[size_t(deviceIndex) % devices.size()], nullptr);
+  }
+  if (getPlatformDisplay &&
+      hasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    const auto display = getPlatformDisplay(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY) {
+      return display;
+    }
+  }
+  if (!devices.empty()) {
+    return getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, devices[0], nullptr);
+  }
+  return EGL_NO_DISPLAY;
+}
+
+} // namespace
+
+size_t HeadlessGLContext::getDeviceCount()
+{
+  return getDevices().size();
+}
+
+HeadlessGLContext::HeadlessGLContext(
+    int deviceIndex, GLContextMode contextMode)
+{
+  const auto fail = [&](const char *message) {
+    std::cerr << message << std::endl;
+    if (m_display) {
+      eglTerminate(m_display);
+    }
+    throw std::runtime_error(message);
+  };
+
+  const auto display = getHeadlessDisplay(deviceIndex);
+  EGLint major = 0, minor = 0;
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+    fail("Unable to get a headless EGL display.");
+  }
+  m_display = display;
+  if (!eglBindAPI(EGL_OPENGL_API) ||
+      !hasEGLExtension(display, "EGL_KHR_surfaceless_context")) {
+    fail("Unable to render OpenGL without surface with EGL.");
+  }
+
+  // Nothing is drawn to a surface, any config of the API will do
+  EGLConfig config = nullptr;
+  if (!hasEGLExtension(display, "EGL_KHR_no_config_context")) {
+    const EGLint configAttributes[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLint configCount = 0;
+    if (!eglChooseConfig(
+            display, configAttributes, &config, 1, &configCount) ||
+        configCount < 1) {
+      fail("Unable to find an EGL config for OpenGL.");
+    }
+  }
+  // Same version and flags as the context of GLFWHandle
+  std::vector<EGLint> contextAttributes = {EGL_CONTEXT_MAJOR_VERSION, 4,
+      EGL_CONTEXT_MINOR_VERSION, 4, EGL_CONTEXT_OPENGL_PROFILE_MASK,
+      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT};
+  if (contextMode == GLContextMode::Debug) {
+    contextAttributes.insert(
+        end(contextAttributes), {EGL_CONTEXT_OPENGL_DEBUG, EGL_TRUE});
+  } else if (contextMode == GLContextMode::NoError &&
+             hasEGLExtension(display, "EGL_KHR_create_context_no_error")) {
+    contextAttributes.insert(
+        end(contextAttributes), {EGL_CONTEXT_OPENGL_NO_ERROR_KHR, EGL_TRUE});
+  }
+  contextAttributes.push_back(EGL_NONE);
+  const auto context = eglCreateContext(
+      display, config, EGL_NO_CONTEXT, contextAttributes.data());
+  if (context == EGL_NO_CONTEXT) {
+    fail("Unable to create an EGL context.");
+  }
+  m_context = context;
+  if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    eglDestroyContext(display, context);
+    fail("Unable to make the EGL context current.");
+  }
+
+  if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    fail("Unable to init OpenGL.");
+  }
+
+  initGLDebugOutput(contextMode);
+}
+
+HeadlessGLContext::~HeadlessGLContext()
+{
+  eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroyContext(m_display, m_context);
+  eglTerminate(m_display);
+}
+
+#else
+
+size_t HeadlessGLContext::getDeviceCount()
+{
+  return 0;
+}
+
+HeadlessGLContext::HeadlessGLContext(int, GLContextMode)
+{
+  std::cerr << "Headless contexts need a build with EGL." << std::endl;
+  throw std::runtime_error("Headless contexts need a build with EGL.");
+}
+
+HeadlessGLContext::~HeadlessGLContext() = default;
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gl_debug_output.hpp"
+
+#include <cstddef>
+
+// OpenGL 4.4 core context without window nor display server, for rendering
+// to --output on render nodes: EGL with the surfaceless platform of Mesa
+// (EGL_MESA_platform_surfaceless) or the first device of
+// EGL_EXT_platform_device, or a given device of it to render on several GPUs
+// at once. The context has no default framebuffer, images
+// are rendered offscreen, and ImGui is not initialized.
+//
+// Needs the viewer to be built with EGL (GLTF_VIEWER_USE_EGL).
+class HeadlessGLContext
+{
+public:
+  // Make the context current and load GL functions, throws
+  // std::runtime_error on failure. With a deviceIndex, the context is created
+  // on that EGL device (modulo getDeviceCount()) if there is one.
+  explicit HeadlessGLContext(int deviceIndex = -1,
+      GLContextMode contextMode = GLContextMode::Debug);
+
+  ~HeadlessGLContext();
+
+  HeadlessGLContext(const HeadlessGLContext &) = delete;
+
+  HeadlessGLContext &operator=(const HeadlessGLContext &) = delete;
+
+  // Number of EGL devices a context can be created on, usually one per GPU
+  static size_t getDeviceCount();
+
+private:
+  void *m_display = nullptr; // EGLDisplay
+  void *m_context = nullptr; // EGLContext
+};
@@ -0,0 +1,330 @@
+#include "environment_map.hpp"
+#include "gpu_memory.hpp"
+#include "texture_uploader.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+const uint32_t environmentCacheMagic = 0x4d455647; // "GVEM"
+const uint32_t environmentCacheVersion = 1;
+
+// Importance samples per texel of prefiltered levels and of the BRDF LUT
+const GLuint PREFILTER_SAMPLE_COUNT = 256;
+const GLuint BRDF_LUT_SAMPLE_COUNT = 512;
+
+// Largest width of the level of the environment projected on spherical
+// harmonics, the irradiance has no high frequencies
+const GLsizei SH_MAX_WIDTH = 128;
+
+const char *const computeShaders[] = {"environment_prefilter.cs.glsl",
+    "environment_sh.cs.glsl", "brdf_lut.cs.glsl"};
+
+// FNV-1a, only used to name cache files
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+GLTexture createTexture(
+    GLsizei levelCount, GLenum format, GLsizei width, GLsizei height)
+{
+  auto texture = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D, texture.glId());
+  glTexStorage2D(GL_TEXTURE_2D, levelCount, format, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+      levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  // Equirectangular maps wrap around in longitude only
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+      levelCount > 1 ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
+
+// Half floats of a level of the prefiltered texture, then of the LUT
+size_t getLevelSize(GLsizei level)
+{
+  return size_t(std::max(EnvironmentMap::PREFILTERED_WIDTH >> level, 1)) *
+         size_t(std::max(EnvironmentMap::PREFILTERED_HEIGHT >> level, 1)) * 4;
+}
+
+const size_t brdfLutSize =
+    size_t(EnvironmentMap::BRDF_LUT_SIZE) * EnvironmentMap::BRDF_LUT_SIZE * 2;
+
+} // namespace
+
+EnvironmentMap::EnvironmentMap(const fs::path &path,
+    const fs::path &cacheDirectory, const ProgramCache &programCache,
+    const fs::path &shadersRootPath)
+{
+  std::ifstream input(path.string(), std::ios::binary);
+  if (!input) {
+    throw std::runtime_error("Unable to open environment " + path.string());
+  }
+  const std::vector<unsigned char> bytes(
+      (std::istreambuf_iterator<char>(input)),
+      std::istreambuf_iterator<char>());
+
+  m_prefilteredTexture = createTexture(PREFILTERED_LEVELS, GL_RGBA16F,
+      PREFILTERED_WIDTH, PREFILTERED_HEIGHT);
+  m_brdfLutTexture =
+      createTexture(1, GL_RG16F, BRDF_LUT_SIZE, BRDF_LUT_SIZE);
+  const GLuint textures[] = {
+      m_prefilteredTexture.glId(), m_brdfLutTexture.glId()};
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 2, textures);
+
+  // Named after the environment, the shaders and the sizes of the maps
+  fs::path cachePath;
+  if (!cacheDirectory.empty()) {
+    auto hash = hashBytes(bytes.data(), bytes.size(), 0xcbf29ce484222325ull);
+    const GLsizei sizes[] = {PREFILTERED_WIDTH, PREFILTERED_HEIGHT,
+        PREFILTERED_LEVELS, BRDF_LUT_SIZE, GLsizei(PREFILTER_SAMPLE_COUNT),
+        GLsizei(BRDF_LUT_SAMPLE_COUNT)};
+    hash = hashBytes(sizes, sizeof(sizes), hash);
+    for (const auto *shader : computeShaders) {
+      const auto source = loadShaderSource(shadersRootPath / shader);
+      hash = hashBytes(source.data(), source.size(), hash);
+    }
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.env",
+        static_cast<unsigned long long>(hash));
+    cachePath = cacheDirectory / fileName;
+    if (loadCache(cachePath)) {
+      std::clog << "Loaded environment maps " << cachePath << "\n";
+      m_isCached = true;
+    }
+  }
+
+  if (!m_isCached) {
+    int width = 0, height = 0, channels = 0;
+    auto *pixels = stbi_loadf_from_memory(bytes.data(), int(bytes.size()),
+        &width, &height, &channels, 3);
+    if (!pixels) {
+      throw std::runtime_error(
+          "Unable to decode environment " + path.string() + ": " +
+          stbi_failure_reason());
+    }
+    const auto start = std::chrono::steady_clock::now();
+    prefilter(pixels, width, height, programCache, shadersRootPath);
+    stbi_image_free(pixels);
+    std::clog << "Prefiltered environment " << path << " in "
+              << std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count()
+              << " s\n";
+    if (!cachePath.empty()) {
+      writeCache(cachePath);
+    }
+  }
+
+  m_uniformBuffer = GLBuffer::generate();
+  glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.glId());
+  glBufferStorage(GL_UNIFORM_BUFFER, sizeof(EnvironmentUniforms), nullptr,
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void EnvironmentMap::prefilter(const float *pixels, int width, int height,
+    const ProgramCache &programCache, const fs::path &shadersRootPath)
+{
+  // Levels of the source are read by samples covering many texels
+  const auto levelCount = getMipLevelCount(width, height);
+  auto environment = GLTexture::generate();
+  glActiveTexture(GL_TEXTURE0);
+  glBindSampler(0, 0);
+  glBindTexture(GL_TEXTURE_2D, environment.glId());
+  glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_RGB32F, width, height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(
+      GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB, GL_FLOAT, pixels);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(
+      GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+  auto prefilterProgram = programCache.compileProgram(
+      {shadersRootPath / computeShaders[0]});
+  prefilterProgram.use();
+  prefilterProgram.setUniform(
+      prefilterProgram.getUniformLocation("uEnvironment"), 0);
+  prefilterProgram.setUniform(
+      prefilterProgram.getUniformLocation("uDestination"), 0);
+  prefilterProgram.setUniform(
+      prefilterProgram.getUniformLocation("uSampleCount"),
+      PREFILTER_SAMPLE_COUNT);
+  for (GLsizei level = 0; level < PREFILTERED_LEVELS; ++level) {
+    prefilterProgram.setUniform(
+        prefilterProgram.getUniformLocation("uRoughness"),
+        float(level) / float(PREFILTERED_LEVELS - 1));
+    glBindImageTexture(0, m_prefilteredTexture.glId(), level, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_RGBA16F);
+    const auto levelWidth = std::max(PREFILTERED_WIDTH >> level, 1);
+    const auto levelHeight = std::max(PREFILTERED_HEIGHT >> level, 1);
+    glDispatchCompute(
+        GLuint((levelWidth + 7) / 8), GLuint((levelHeight + 7) / 8), 1);
+  }
+
+  auto shProgram =
+      programCache.compileProgram({shadersRootPath / computeShaders[1]});
+  shProgram.use();
+  shProgram.setUniform(shProgram.getUniformLocation("uEnvironment"), 0);
+  GLint shLevel = 0;
+  while ((width >> shLevel) > SH_MAX_WIDTH && shLevel + 1 < levelCount) {
+    ++shLevel;
+  }
+  shProgram.setUniform(shProgram.getUniformLocation("uLevel"), shLevel);
+  const auto blockIndex = glGetProgramResourceIndex(
+      shProgram.glId(), GL_SHADER_STORAGE_BLOCK, "IrradianceSH");
+  if (blockIndex != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(shProgram.glId(), blockIndex, SH_BINDING);
+  }
+  auto shBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, shBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(m_irradianceSH), nullptr,
+      GL_CLIENT_STORAGE_BIT);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SH_BINDING, shBuffer.glId());
+  glDispatchCompute(1, 1, 1);
+
+  auto brdfLutProgram =
+      programCache.compileProgram({shadersRootPath / computeShaders[2]});
+  brdfLutProgram.use();
+  brdfLutProgram.setUniform(
+      brdfLutProgram.getUniformLocation("uDestination"), 0);
+  brdfLutProgram.setUniform(
+      brdfLutProgram.getUniformLocation("uSampleCount"),
+      BRDF_LUT_SAMPLE_COUNT);
+  glBindImageTexture(0, m_brdfLutTexture.glId(), 0, GL_FALSE, 0,
+      GL_WRITE_ONLY, GL_RG16F);
+  glDispatchCompute(
+      GLuint((BRDF_LUT_SIZE + 7) / 8), GLuint((BRDF_LUT_SIZE + 7) / 8), 1);
+
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                  GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+  glGetBufferSubData(
+      GL_SHADER_STORAGE_BUFFER, 0, sizeof(m_irradianceSH), m_irradianceSH);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glUseProgram(GLuint(previousProgram));
+}
+
+bool EnvironmentMap::loadCache(const fs::path &cachePath)
+{
+  // Magic and version, spherical harmonics, then half floats of the
+  // prefiltered levels and of the LUT
+  std::ifstream input(cachePath.string(), std::ios::binary);
+  uint32_t header[2] = {};
+  if (!input.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      header[0] != environmentCacheMagic ||
+      header[1] != environmentCacheVersion ||
+      !input.read(reinterpret_cast<char *>(m_irradianceSH),
+          sizeof(m_irradianceSH))) {
+    return false;
+  }
+  std::vector<std::vector<uint16_t>> levels(PREFILTERED_LEVELS + 1);
+  for (GLsizei level = 0; level <= PREFILTERED_LEVELS; ++level) {
+    auto &values = levels[size_t(level)];
+    values.resize(level < PREFILTERED_LEVELS ? getLevelSize(level)
+                                             : brdfLutSize);
+    if (!input.read(reinterpret_cast<char *>(values.data()),
+            std::streamsize(values.size() * sizeof(uint16_t)))) {
+      return false;
+    }
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, m_prefilteredTexture.glId());
+  for (GLsizei level = 0; level < PREFILTERED_LEVELS; ++level) {
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0,
+        std::max(PREFILTERED_WIDTH >> level, 1),
+        std::max(PREFILTERED_HEIGHT >> level, 1), GL_RGBA, GL_HALF_FLOAT,
+        levels[size_t(level)].data());
+  }
+  glBindTexture(GL_TEXTURE_2D, m_brdfLutTexture.glId());
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BRDF_LUT_SIZE, BRDF_LUT_SIZE,
+      GL_RG, GL_HALF_FLOAT, levels.back().data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return true;
+}
+
+void EnvironmentMap::writeCache(const fs::path &cachePath) const
+{
+  std::vector<uint16_t> values;
+  // Written to a temporary file first, so that concurrent viewers never load
+  // a partial cache
+  std::error_code ec;
+  fs::create_directories(cachePath.parent_path(), ec);
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream output(tmpPath.string(), std::ios::binary);
+    const uint32_t header[2] = {environmentCacheMagic, environmentCacheVersion};
+    output.write(reinterpret_cast<const char *>(header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(m_irradianceSH),
+        sizeof(m_irradianceSH));
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    for (GLsizei level = 0; level <= PREFILTERED_LEVELS; ++level) {
+      const auto isLut = level == PREFILTERED_LEVELS;
+      values.resize(isLut ? brdfLutSize : getLevelSize(level));
+      glBindTexture(GL_TEXTURE_2D,
+          isLut ? m_brdfLutTexture.glId() : m_prefilteredTexture.glId());
+      glGetTexImage(GL_TEXTURE_2D, isLut ? 0 : level, isLut ? GL_RG : GL_RGBA,
+          GL_HALF_FLOAT, values.data());
+      output.write(reinterpret_cast<const char *>(values.data()),
+          std::streamsize(values.size() * sizeof(uint16_t)));
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (!output) {
+      std::cerr << "Warning : unable to write " << tmpPath << std::endl;
+      return;
+    }
+  }
+  fs::rename(tmpPath, cachePath, ec);
+  if (ec) {
+    std::cerr << "Warning : unable to write " << cachePath << ": "
+              << ec.message() << std::endl;
+  }
+}
+
+void EnvironmentMap::bind(const glm::mat4 &viewMatrix, float intensity)
+{
+  EnvironmentUniforms uniforms;
+  uniforms.worldFromViewMatrix = glm::inverse(viewMatrix);
+  std::copy(std::begin(m_irradianceSH), std::end(m_irradianceSH),
+      uniforms.irradianceSH);
+  uniforms.intensity = intensity;
+  uniforms.maxLevel = float(PREFILTERED_LEVELS - 1);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.glId());
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(uniforms), &uniforms);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(
+      GL_UNIFORM_BUFFER, UNIFORMS_BINDING, m_uniformBuffer.glId());
+  glActiveTexture(GL_TEXTURE0 + PREFILTERED_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_prefilteredTexture.glId());
+  glBindSampler(PREFILTERED_UNIT, 0);
+  glActiveTexture(GL_TEXTURE0 + BRDF_LUT_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_brdfLutTexture.glId());
+  glBindSampler(BRDF_LUT_UNIT, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gl_objects.hpp"
+#include "program_cache.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+// Image based lighting from an equirectangular HDR environment
+// (--environment), with the split sum approximation: the irradiance of the
+// environment in 9 spherical harmonics coefficients for the diffuse light,
+// the environment prefiltered for the GGX lobes of increasing roughnesses in
+// the mip levels of a texture, and the BRDF LUT of the scale and bias of F_0
+// for the specular light.
+//
+// All three are computed by compute shaders, then stored in a cache directory
+// in a file named after the hash of the environment file and of the shaders,
+// so that later runs load them instead of prefiltering again.
+class EnvironmentMap
+{
+public:
+  // Prefiltered levels, of roughness level / (PREFILTERED_LEVELS - 1)
+  static const GLsizei PREFILTERED_WIDTH = 512;
+  static const GLsizei PREFILTERED_HEIGHT = 256;
+  static const GLsizei PREFILTERED_LEVELS = 6;
+  static const GLsizei BRDF_LUT_SIZE = 128;
+
+  // Uniform block and texture units read by pbr_directional_light.fs.glsl,
+  // after those of ShadowCascades
+  static const GLuint UNIFORMS_BINDING = 3;
+  static const GLuint PREFILTERED_UNIT = 6;
+  static const GLuint BRDF_LUT_UNIT = 7;
+
+  // Storage buffer of the coefficients written by environment_sh.cs.glsl,
+  // after those of LightClusters
+  static const GLuint SH_BINDING = 12;
+
+  // Load the maps of the environment image at path from cacheDirectory, or
+  // compute them with the compute shaders of shadersRootPath and store them
+  // there (nothing is cached if cacheDirectory is empty). Throws
+  // std::runtime_error if the image cannot be read.
+  EnvironmentMap(const fs::path &path, const fs::path &cacheDirectory,
+      const ProgramCache &programCache, const fs::path &shadersRootPath);
+
+  EnvironmentMap(const EnvironmentMap &) = delete;
+
+  EnvironmentMap &operator=(const EnvironmentMap &) = delete;
+
+  // True if the maps were loaded from the cache
+  bool isCached() const { return m_isCached; }
+
+  // Upload the rotation back to world space of viewMatrix and the scale of
+  // the environment radiance, and bind the maps for the next draws
+  void bind(const glm::mat4 &viewMatrix, float intensity);
+
+private:
+  // Same layout as the EnvironmentUniforms block of the shader (std140)
+  struct EnvironmentUniforms
+  {
+    glm::mat4 worldFromViewMatrix;
+    glm::vec4 irradianceSH[9];
+    float intensity;
+    float maxLevel;
+    float padding[2];
+  };
+
+  // Compute the maps from the decoded environment
+  void prefilter(const float *pixels, int width, int height,
+      const ProgramCache &programCache, const fs::path &shadersRootPath);
+
+  bool loadCache(const fs::path &cachePath);
+  void writeCache(const fs::path &cachePath) const;
+
+  GLTexture m_prefilteredTexture;
+  GLTexture m_brdfLutTexture;
+  glm::vec4 m_irradianceSH[9];
+  GLBuffer m_uniformBuffer;
+  bool m_isCached = false;
+};
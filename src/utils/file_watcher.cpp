@@ -0,0 +1,47 @@
+#include "file_watcher.hpp"
+
+#include <algorithm>
+#include <exception>
+
+FileWatcher::FileWatcher(double pollInterval) : m_pollInterval(pollInterval)
+{
+}
+
+int64_t FileWatcher::getFileWriteTime(const fs::path &path)
+{
+  try {
+    return fs::exists(path) ? getWriteTime(path) : 0;
+  } catch (const std::exception &) {
+    return 0; // Removed since exists() was called
+  }
+}
+
+void FileWatcher::add(const fs::path &path)
+{
+  if (std::any_of(begin(m_files), end(m_files),
+          [&](const WatchedFile &file) { return file.path == path; })) {
+    return;
+  }
+  const auto writeTime = getFileWriteTime(path);
+  m_files.push_back(WatchedFile{path, writeTime, writeTime});
+}
+
+std::vector<fs::path> FileWatcher::poll(double seconds)
+{
+  std::vector<fs::path> changedFiles;
+  if (seconds - m_lastPoll < m_pollInterval) {
+    return changedFiles;
+  }
+  m_lastPoll = seconds;
+  for (auto &file : m_files) {
+    const auto writeTime = getFileWriteTime(file.path);
+    // Missing files are reported once they exist again
+    if (writeTime && writeTime != file.writeTime &&
+        writeTime == file.pendingWriteTime) {
+      file.writeTime = writeTime;
+      changedFiles.push_back(file.path);
+    }
+    file.pendingWriteTime = writeTime;
+  }
+  return changedFiles;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Files polled for changes of their last write time, including the ones
+// removed or created again, as editors do when they save by replacing a file.
+// A change is only reported once the write time stayed the same for a whole
+// poll interval, so that files still being written are not read half way.
+class FileWatcher
+{
+public:
+  // Files are polled at most every pollInterval seconds
+  explicit FileWatcher(double pollInterval = 0.5);
+
+  // Watch path from its current state, nothing if it is already watched
+  void add(const fs::path &path);
+
+  // Files of add() whose changes settled since the last time they were
+  // reported, polled if pollInterval elapsed since the last poll. seconds is
+  // the current time, on the clock of glfwGetTime for instance.
+  std::vector<fs::path> poll(double seconds);
+
+  size_t size() const { return m_files.size(); }
+
+private:
+  struct WatchedFile
+  {
+    fs::path path;
+    int64_t writeTime = 0; // Of the last reported content, 0 if missing
+    int64_t pendingWriteTime = 0; // Seen at the last poll
+  };
+
+  // 0 if the file does not exist
+  static int64_t getFileWriteTime(const fs::path &path);
+
+  double m_pollInterval;
+  double m_lastPoll = 0;
+  std::vector<WatchedFile> m_files;
+};
@@ -27,3 +27,16 @@ namespace fs =
                                    // filesystem standard library
 #endif
 #endif
+
+#include <cstdint>
+
+// Last write time of a file, in the unit of the clock of the filesystem
+// library. Throws if the file does not exist.
+inline int64_t getWriteTime(const fs::path &path)
+{
+#ifdef GLMLV_USE_BOOST_FILESYSTEM
+  return int64_t(fs::last_write_time(path));
+#else
+  return int64_t(fs::last_write_time(path).time_since_epoch().count());
+#endif
+}
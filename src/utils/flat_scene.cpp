@@ -0,0 +1,443 @@
+#include "flat_scene.hpp"
+#include "gltf.hpp"
+#include "transforms.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+// Recompute the matrices of the nodes of ranges [begin, end), disjoint and
+// sorted, whose parents outside of the ranges are up to date. World matrices
+// of all ranges are multiplied level by level of the hierarchy, 4 at a time
+// by multiplyAffineMatrices: the parents of a level are in the previous ones.
+void updateRanges(
+    FlatScene &scene, const std::vector<std::pair<size_t, size_t>> &ranges)
+{
+  // Entries of the ranges sorted by depth below the roots of their range,
+  // levelStarts[d] being the first one of depth d in levelOrder
+  std::vector<size_t> entries;
+  std::vector<int> depths;
+  std::vector<size_t> levelStarts(1, 0);
+  for (const auto &range : ranges) {
+    const auto offset = entries.size();
+    for (auto i = range.first; i < range.second; ++i) {
+      const auto parent = scene.parents[i];
+      const auto depth =
+          parent < int(range.first)
+              ? 0
+              : depths[offset + size_t(parent) - range.first] + 1;
+      entries.push_back(i);
+      depths.push_back(depth);
+      if (size_t(depth) + 1 >= levelStarts.size()) {
+        levelStarts.push_back(0);
+      }
+      ++levelStarts[size_t(depth) + 1];
+    }
+  }
+  for (size_t level = 1; level < levelStarts.size(); ++level) {
+    levelStarts[level] += levelStarts[level - 1];
+  }
+  std::vector<size_t> levelOrder(entries.size());
+  auto levelEnds = levelStarts;
+  for (size_t k = 0; k < entries.size(); ++k) {
+    levelOrder[levelEnds[size_t(depths[k])]++] = entries[k];
+  }
+
+  std::vector<const glm::mat4 *> parentMatrices, localMatrices;
+  std::vector<glm::mat4 *> worldMatrices;
+  for (size_t level = 0; level + 1 < levelStarts.size(); ++level) {
+    parentMatrices.clear();
+    localMatrices.clear();
+    worldMatrices.clear();
+    for (auto k = levelStarts[level]; k < levelStarts[level + 1]; ++k) {
+      const auto i = levelOrder[k];
+      const auto parent = scene.parents[i];
+      if (parent < 0) {
+        scene.worldMatrices[i] = scene.localMatrices[i];
+        continue;
+      }
+      parentMatrices.push_back(&scene.worldMatrices[parent]);
+      localMatrices.push_back(&scene.localMatrices[i]);
+      worldMatrices.push_back(&scene.worldMatrices[i]);
+    }
+    multiplyAffineMatrices(parentMatrices.data(), localMatrices.data(),
+        worldMatrices.data(), worldMatrices.size());
+  }
+
+  for (const auto i : entries) {
+    const auto parent = scene.parents[i];
+    scene.worldTranslations[i] =
+        parent < 0 ? scene.localTranslations[i]
+                   : scene.worldTranslations[parent] +
+                         glm::dmat3(glm::mat3(scene.worldMatrices[parent])) *
+                             scene.localTranslations[i];
+    scene.normalMatrices[i] =
+        glm::transpose(glm::inverse(scene.worldMatrices[i]));
+  }
+}
+
+// Bounds of the draws of entry i and of the subtrees of its children, which
+// must be up to date
+BoundingBox getSubtreeBounds(const FlatScene &scene,
+    const std::vector<BoundingBox> &drawBounds,
+    const std::vector<size_t> &firstDraws, size_t i)
+{
+  BoundingBox bounds;
+  const auto drawEnd =
+      i + 1 < scene.size() ? firstDraws[i + 1] : drawBounds.size();
+  for (auto d = firstDraws[i]; d < drawEnd; ++d) {
+    bounds.extend(drawBounds[d]);
+  }
+  for (auto child = int(i) + 1; child < scene.subtreeEnds[i];
+       child = scene.subtreeEnds[child]) {
+    bounds.extend(scene.subtreeBounds[child]);
+  }
+  return bounds;
+}
+
+// Translation of the local matrix of node, which its float TRS or matrix
+// rounds
+glm::dvec3 getLocalTranslation(const tinygltf::Node &node)
+{
+  if (node.matrix.size() == 16) {
+    return glm::dvec3(node.matrix[12], node.matrix[13], node.matrix[14]);
+  }
+  if (node.translation.size() == 3) {
+    return glm::dvec3(
+        node.translation[0], node.translation[1], node.translation[2]);
+  }
+  return glm::dvec3(0);
+}
+
+// Append the TRS of the instances of a node with EXT_mesh_gpu_instancing to
+// trs. Returns false if the node does not use the extension.
+bool appendInstanceTrs(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, const tinygltf::Node &node,
+    TrsArrays &trs)
+{
+  const auto it = node.extensions.find("EXT_mesh_gpu_instancing");
+  if (it == end(node.extensions) || !it->second.Has("attributes")) {
+    return false;
+  }
+  const auto &attributes = it->second.Get("attributes");
+
+  std::vector<float> translations, rotations, scales;
+  size_t instanceCount = std::numeric_limits<size_t>::max();
+  for (const auto &attribute :
+      {std::make_tuple("TRANSLATION", 3, &translations),
+          std::make_tuple("ROTATION", 4, &rotations),
+          std::make_tuple("SCALE", 3, &scales)}) {
+    const auto &accessorIdx = attributes.Get(std::get<0>(attribute));
+    if (!accessorIdx.IsInt()) {
+      continue;
+    }
+    const auto componentCount = std::get<1>(attribute);
+    if (!readFloatAccessor(model, bufferBytes, accessorIdx.Get<int>(),
+            componentCount, *std::get<2>(attribute))) {
+      std::cerr << "Warning : unsupported " << std::get<0>(attribute)
+                << " accessor of EXT_mesh_gpu_instancing, instances ignored"
+                << std::endl;
+      return false;
+    }
+    instanceCount =
+        std::min(instanceCount, std::get<2>(attribute)->size() / componentCount);
+  }
+  if (instanceCount == std::numeric_limits<size_t>::max()) {
+    return false;
+  }
+
+  const auto first = trs.size();
+  trs.resize(first + instanceCount);
+  for (size_t i = 0; i < instanceCount; ++i) {
+    if (!translations.empty()) {
+      trs.setTranslation(first + i, glm::make_vec3(&translations[3 * i]));
+    }
+    if (!rotations.empty()) {
+      trs.setRotation(first + i, glm::make_vec4(&rotations[4 * i]));
+    }
+    if (!scales.empty()) {
+      trs.setScale(first + i, glm::make_vec3(&scales[3 * i]));
+    }
+  }
+  return true;
+}
+
+// Nodes of the lower levels of detail of a node with MSFT_lod, and the
+// screen coverages of all levels if the node has MSFT_screencoverage extras.
+// Returns false if the node does not use the extension.
+bool getLodGroup(const tinygltf::Model &model, const tinygltf::Node &node,
+    std::vector<int> &lodNodes, FlatScene::LodGroup &group)
+{
+  const auto it = node.extensions.find("MSFT_lod");
+  if (it == end(node.extensions) || !it->second.Has("ids")) {
+    return false;
+  }
+  const auto &ids = it->second.Get("ids");
+  lodNodes.clear();
+  for (size_t i = 0; i < ids.ArrayLen(); ++i) {
+    const auto &id = ids.Get(int(i));
+    if (!id.IsInt() || id.Get<int>() < 0 ||
+        size_t(id.Get<int>()) >= model.nodes.size()) {
+      std::cerr << "Warning : invalid MSFT_lod node id, levels ignored"
+                << std::endl;
+      return false;
+    }
+    lodNodes.push_back(id.Get<int>());
+  }
+  if (lodNodes.empty()) {
+    return false;
+  }
+
+  group.screenCoverages.clear();
+  if (node.extras.Has("MSFT_screencoverage")) {
+    const auto &coverages = node.extras.Get("MSFT_screencoverage");
+    for (size_t i = 0; i < coverages.ArrayLen(); ++i) {
+      const auto &coverage = coverages.Get(int(i));
+      if (coverage.IsNumber()) {
+        group.screenCoverages.push_back(float(coverage.GetNumberAsDouble()));
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+FlatScene flattenScene(const tinygltf::Model &model, int sceneIdx,
+    const std::vector<BufferBytes> &bufferBytes)
+{
+  FlatScene scene;
+  if (sceneIdx < 0) {
+    return scene;
+  }
+  const auto &roots = model.scenes[sceneIdx].nodes;
+
+  // Explicit stack of nodes to visit, children are pushed in reverse order
+  // to be visited in order
+  struct StackEntry
+  {
+    int node;
+    int parent; // Flat index
+    int lodGroup; // If the node is a level of an MSFT_lod group, or -1
+    int lodLevel;
+  };
+  std::vector<StackEntry> stack;
+  // TRS of the entries without a matrix, composed once all are read
+  TrsArrays trs;
+  std::vector<size_t> trsEntries;
+  std::vector<int> lodNodes;
+  FlatScene::LodGroup lodGroup;
+  for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+    stack.push_back(StackEntry{*it, -1, -1, 0});
+  }
+  while (!stack.empty()) {
+    const auto entry = stack.back();
+    const auto nodeIdx = entry.node;
+    const auto parent = entry.parent;
+    stack.pop_back();
+
+    const auto &node = model.nodes[nodeIdx];
+    const auto flatIdx = int(scene.nodes.size());
+    scene.parents.push_back(parent);
+    scene.nodes.push_back(nodeIdx);
+    scene.meshes.push_back(node.mesh);
+    scene.localTranslations.push_back(getLocalTranslation(node));
+    if (node.matrix.size() == 16) {
+      scene.localMatrices.push_back(
+          glm::mat4(glm::make_mat4(node.matrix.data())));
+    } else {
+      scene.localMatrices.emplace_back(1);
+      const auto readVec = [](const std::vector<double> &values,
+                               glm::vec4 result) {
+        for (size_t c = 0; c < std::min(values.size(), size_t(4)); ++c) {
+          result[int(c)] = float(values[c]);
+        }
+        return result;
+      };
+      const auto i = trs.size();
+      trs.resize(i + 1);
+      trs.setTranslation(
+          i, glm::vec3(readVec(node.translation, glm::vec4(0))));
+      trs.setRotation(i, readVec(node.rotation, glm::vec4(0, 0, 0, 1)));
+      trs.setScale(i, glm::vec3(readVec(node.scale, glm::vec4(1))));
+      trsEntries.push_back(size_t(flatIdx));
+    }
+
+    const auto firstInstance = trs.size();
+    if (node.mesh >= 0 &&
+        appendInstanceTrs(model, bufferBytes, node, trs)) {
+      scene.meshes.back() = -1;
+      for (auto i = firstInstance; i < trs.size(); ++i) {
+        trsEntries.push_back(scene.size());
+        scene.parents.push_back(flatIdx);
+        scene.nodes.push_back(nodeIdx);
+        scene.meshes.push_back(node.mesh);
+        scene.localMatrices.emplace_back(1);
+        scene.localTranslations.push_back(glm::dvec3(trs.translation(i)));
+      }
+    }
+
+    // Other levels are visited after the subtree of the node, as its siblings
+    if (entry.lodGroup >= 0) {
+      scene.lodGroups[entry.lodGroup].levels[entry.lodLevel] = flatIdx;
+    } else if (getLodGroup(model, node, lodNodes, lodGroup)) {
+      lodGroup.levels.assign(lodNodes.size() + 1, -1);
+      lodGroup.levels[0] = flatIdx;
+      const auto groupIdx = int(scene.lodGroups.size());
+      scene.lodGroups.push_back(lodGroup);
+      for (auto level = int(lodNodes.size()); level > 0; --level) {
+        stack.push_back(
+            StackEntry{lodNodes[level - 1], parent, groupIdx, level});
+      }
+    }
+
+    for (auto it = node.children.rbegin(); it != node.children.rend(); ++it) {
+      stack.push_back(StackEntry{*it, flatIdx, -1, 0});
+    }
+  }
+
+  // In depth first order, the subtree of a node ends where the next node that
+  // is not one of its descendants starts
+  scene.subtreeEnds.resize(scene.size());
+  for (auto i = int(scene.size()) - 1; i >= 0; --i) {
+    scene.subtreeEnds[i] = std::max(scene.subtreeEnds[i], i + 1);
+    const auto parent = scene.parents[i];
+    if (parent >= 0) {
+      scene.subtreeEnds[parent] =
+          std::max(scene.subtreeEnds[parent], scene.subtreeEnds[i]);
+    }
+  }
+
+  std::vector<glm::mat4> trsMatrices(trs.size());
+  composeTrsMatrices(trs, nullptr, trs.size(), trsMatrices.data());
+  for (size_t i = 0; i < trsEntries.size(); ++i) {
+    scene.localMatrices[trsEntries[i]] = trsMatrices[i];
+  }
+
+  scene.worldMatrices.resize(scene.size());
+  scene.normalMatrices.resize(scene.size());
+  scene.worldTranslations.resize(scene.size());
+  updateRanges(scene, {{0, scene.size()}});
+  scene.hidden.assign(scene.size(), 0);
+  return scene;
+}
+
+std::vector<int> getNodeEntries(const FlatScene &scene, size_t nodeCount)
+{
+  std::vector<int> entries(nodeCount, -1);
+  for (size_t i = 0; i < scene.size(); ++i) {
+    // Instances are entries of the same node under it
+    const auto parent = scene.parents[i];
+    if (parent < 0 || scene.nodes[parent] != scene.nodes[i]) {
+      entries[scene.nodes[i]] = int(i);
+    }
+  }
+  return entries;
+}
+
+void setLocalMatrix(FlatScene &scene, size_t nodeIdx, const glm::mat4 &matrix)
+{
+  scene.localMatrices[nodeIdx] = matrix;
+  auto &translation = scene.localTranslations[nodeIdx];
+  if (glm::vec3(translation) != glm::vec3(matrix[3])) {
+    translation = glm::dvec3(matrix[3]);
+  }
+  scene.dirtyNodes.push_back(int(nodeIdx));
+}
+
+void updateWorldMatrices(FlatScene &scene)
+{
+  if (scene.dirtyNodes.empty()) {
+    return;
+  }
+  // Sorted, a dirty node inside the subtree of a previous one is already
+  // updated with it
+  std::sort(begin(scene.dirtyNodes), end(scene.dirtyNodes));
+  std::vector<std::pair<size_t, size_t>> ranges;
+  auto updatedEnd = 0;
+  for (const auto nodeIdx : scene.dirtyNodes) {
+    if (nodeIdx >= updatedEnd) {
+      updatedEnd = scene.subtreeEnds[nodeIdx];
+      ranges.emplace_back(size_t(nodeIdx), size_t(updatedEnd));
+      scene.movedNodes.push_back(nodeIdx);
+    }
+  }
+  updateRanges(scene, ranges);
+  scene.dirtyNodes.clear();
+}
+
+void updateSubtreeBounds(FlatScene &scene,
+    const std::vector<BoundingBox> &drawBounds,
+    const std::vector<size_t> &firstDraws,
+    const std::vector<int> &changedEntries)
+{
+  // Children come after their parent: updating a range from its last entry
+  // finds the subtrees of children already updated
+  const auto updateBoundsRange = [&](int begin, int end) {
+    for (auto i = end; i-- > begin;) {
+      scene.subtreeBounds[i] =
+          getSubtreeBounds(scene, drawBounds, firstDraws, size_t(i));
+    }
+  };
+  if (scene.subtreeBounds.size() != scene.size()) {
+    scene.subtreeBounds.resize(scene.size());
+    updateBoundsRange(0, int(scene.size()));
+  } else {
+    auto roots = scene.movedNodes;
+    roots.insert(end(roots), begin(changedEntries), end(changedEntries));
+    if (roots.empty()) {
+      return;
+    }
+    // Sorted, a root inside the subtree of a previous one is already updated
+    std::sort(begin(roots), end(roots));
+    std::vector<int> ancestors;
+    auto updatedEnd = 0;
+    for (const auto root : roots) {
+      if (root < updatedEnd) {
+        continue;
+      }
+      updatedEnd = scene.subtreeEnds[root];
+      updateBoundsRange(root, updatedEnd);
+      for (auto parent = scene.parents[root]; parent >= 0;
+           parent = scene.parents[parent]) {
+        ancestors.push_back(parent);
+      }
+    }
+    // Last first, children before their parent
+    std::sort(begin(ancestors), end(ancestors));
+    ancestors.erase(
+        std::unique(begin(ancestors), end(ancestors)), end(ancestors));
+    for (auto it = ancestors.rbegin(); it != ancestors.rend(); ++it) {
+      scene.subtreeBounds[*it] =
+          getSubtreeBounds(scene, drawBounds, firstDraws, size_t(*it));
+    }
+  }
+  scene.movedNodes.clear();
+  scene.bounds = BoundingBox();
+  for (size_t i = 0; i < scene.size(); i = size_t(scene.subtreeEnds[i])) {
+    scene.bounds.extend(scene.subtreeBounds[i]);
+  }
+}
+
+int selectLodLevel(const FlatScene::LodGroup &group, float screenCoverage)
+{
+  const auto levelCount = int(group.levels.size());
+  auto minCoverage = 1.f;
+  for (auto level = 0; level < levelCount; ++level) {
+    if (level < int(group.screenCoverages.size())) {
+      minCoverage = group.screenCoverages[level];
+    } else {
+      minCoverage = level + 1 < levelCount ? 0.25f * minCoverage : 0.f;
+    }
+    if (screenCoverage >= minCoverage) {
+      return level;
+    }
+  }
+  return -1;
+}
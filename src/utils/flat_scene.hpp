@@ -0,0 +1,123 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// Nodes of a glTF scene in contiguous arrays (structure of arrays), in depth
+// first order: a parent always comes before its children, and the order is
+// the one of a recursive traversal of the scene. Traversals are linear loops
+// over these arrays instead of recursions through model.nodes.
+//
+// The subtree of node i is the range [i, subtreeEnds[i]). World and normal
+// matrices are cached: setLocalMatrix() marks a node dirty and
+// updateWorldMatrices() only recomputes the subtrees of dirty nodes. World
+// space bounds of subtrees are cached the same way by updateSubtreeBounds(),
+// framing a node or the whole scene reads them instead of scanning vertices.
+//
+// Translations of local and world matrices are also kept in double precision:
+// far from the origin, as in georeferenced models, float world matrices can
+// not place vertices to less than their ulp, a few centimeters at a thousand
+// kilometers. getRelativeMatrix subtracts an origin near the camera from them
+// before rounding to float.
+//
+// The mesh of a node with the EXT_mesh_gpu_instancing extension is drawn by
+// one child entry per instance, with the same node and the TRS of the
+// instance as local matrix, the entry of the node itself has no mesh.
+struct FlatScene
+{
+  std::vector<int> parents; // Index in these arrays, -1 for root nodes
+  std::vector<int> subtreeEnds; // One past the last descendant
+  std::vector<int> nodes; // Index in model.nodes
+  std::vector<int> meshes; // Index in model.meshes, -1 if no mesh
+  std::vector<glm::mat4> localMatrices; // TRS or matrix of the node
+  std::vector<glm::mat4> worldMatrices;
+  // transpose(inverse(worldMatrices[i])), transforms normals to world space
+  std::vector<glm::mat4> normalMatrices;
+  // Translations of localMatrices and worldMatrices, in double precision
+  std::vector<glm::dvec3> localTranslations;
+  std::vector<glm::dvec3> worldTranslations;
+  // World matrices of the previous frame, for motion vectors. Empty unless
+  // the viewer keeps them, it copies worldMatrices once drawn.
+  std::vector<glm::mat4> previousWorldMatrices;
+  std::vector<glm::dvec3> previousWorldTranslations;
+
+  // Entries hidden with their subtree, see DrawVisibility
+  std::vector<uint8_t> hidden;
+
+  std::vector<int> dirtyNodes; // Whose local matrix changed since the update
+  // Roots of the subtrees updateWorldMatrices recomputed since the last
+  // updateSubtreeBounds, whose bounds are outdated
+  std::vector<int> movedNodes;
+
+  // Bounds of the draws of the subtree of each entry, and of all entries.
+  // Empty until the first updateSubtreeBounds.
+  std::vector<BoundingBox> subtreeBounds;
+  BoundingBox bounds;
+
+  // A node with the MSFT_lod extension and its lower levels of detail, which
+  // are flattened as siblings of the node, after its subtree. Only one level
+  // of a group is drawn, see selectLodLevel.
+  struct LodGroup
+  {
+    std::vector<int> levels; // Flat index of the root of each level
+    // Minimum screen coverage of each level (MSFT_screencoverage), below
+    // the last one nothing is drawn. Empty if the file has none.
+    std::vector<float> screenCoverages;
+  };
+  std::vector<LodGroup> lodGroups;
+
+  size_t size() const { return nodes.size(); }
+};
+
+// Flatten model.scenes[sceneIdx], with up to date world matrices. Returns an
+// empty scene if sceneIdx < 0. Instance transforms are read from bufferBytes.
+FlatScene flattenScene(const tinygltf::Model &model, int sceneIdx,
+    const std::vector<BufferBytes> &bufferBytes);
+
+// Entry of each of the nodeCount nodes of the model in scene, -1 for those
+// not in it. Entries of EXT_mesh_gpu_instancing instances are not returned,
+// only the one of their node.
+std::vector<int> getNodeEntries(const FlatScene &scene, size_t nodeCount);
+
+// The double precision translation of the node is kept if matrix has the
+// same one once rounded to float, an animation rotating a node far from the
+// origin keeps it in place
+void setLocalMatrix(FlatScene &scene, size_t nodeIdx, const glm::mat4 &matrix);
+
+// matrix with translation - origin as translation, subtracted in double
+// precision, for the world matrices of entries relative to a point near the
+// camera
+inline glm::mat4 getRelativeMatrix(const glm::mat4 &matrix,
+    const glm::dvec3 &translation, const glm::dvec3 &origin)
+{
+  auto result = matrix;
+  result[3] = glm::vec4(glm::vec3(translation - origin), matrix[3][3]);
+  return result;
+}
+
+// Recompute world and normal matrices of dirty nodes and their descendants,
+// in one pass over all dirty subtrees by level of the hierarchy. Does nothing
+// for a static scene.
+void updateWorldMatrices(FlatScene &scene);
+
+// Recompute subtreeBounds and bounds from the world space bounds of the draws
+// of each entry i, drawBounds[firstDraws[i], firstDraws[i + 1]) (to the end
+// for the last one). Only the subtrees of movedNodes and changedEntries
+// (whose draws changed without moving, say skinned ones) and their ancestors
+// are updated, all entries on the first call.
+void updateSubtreeBounds(FlatScene &scene,
+    const std::vector<BoundingBox> &drawBounds,
+    const std::vector<size_t> &firstDraws,
+    const std::vector<int> &changedEntries = {});
+
+// Level of group to draw for a screen coverage, the fraction of the screen
+// covered by the bounds of its first level. Returns -1 if none must be drawn.
+// Without MSFT_screencoverage, each level takes over below a quarter of the
+// coverage of the previous one and the last level is always drawn.
+int selectLodLevel(const FlatScene::LodGroup &group, float screenCoverage);
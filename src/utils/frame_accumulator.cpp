@@ -0,0 +1,88 @@
+#include "frame_accumulator.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+float getHaltonNumber(size_t index, size_t base)
+{
+  auto value = 0.f;
+  auto factor = 1.f;
+  while (index > 0) {
+    factor /= float(base);
+    value += factor * float(index % base);
+    index /= base;
+  }
+  return value;
+}
+
+FrameAccumulator::FrameAccumulator(
+    GLsizei width, GLsizei height, GLProgram accumulateProgram) :
+    m_width(width),
+    m_height(height),
+    m_average(std::make_unique<OffscreenFramebuffer>(
+        size_t(width), size_t(height), GL_RGBA32F)),
+    m_accumulateProgram(std::move(accumulateProgram))
+{
+  m_uWeight = m_accumulateProgram.getUniformLocation("uWeight");
+  for (const auto &unit :
+      {std::make_pair("uFrame", 0), std::make_pair("uAverage", 0)}) {
+    glProgramUniform1i(m_accumulateProgram.glId(),
+        m_accumulateProgram.getUniformLocation(unit.first), unit.second);
+  }
+}
+
+void FrameAccumulator::resize(GLsizei width, GLsizei height)
+{
+  reset();
+  if (width == m_width && height == m_height) {
+    return;
+  }
+  m_width = width;
+  m_height = height;
+  m_average.reset();
+  m_average = std::make_unique<OffscreenFramebuffer>(
+      size_t(width), size_t(height), GL_RGBA32F);
+}
+
+glm::mat4 FrameAccumulator::getJitterMatrix() const
+{
+  if (m_frameCount == 0) {
+    return glm::mat4(1);
+  }
+  // In pixels, in [-0.5, 0.5), then in normalized device coordinates
+  const auto jitter =
+      glm::vec2(getHaltonNumber(m_frameCount, 2),
+          getHaltonNumber(m_frameCount, 3)) -
+      0.5f;
+  return glm::translate(glm::mat4(1),
+      glm::vec3(2.f * jitter / glm::vec2(m_width, m_height), 0));
+}
+
+void FrameAccumulator::add(GLuint colorTexture)
+{
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_accumulateProgram.use();
+  glUniform1f(m_uWeight, 1.f / float(m_frameCount + 1));
+
+  glActiveTexture(GL_TEXTURE0);
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  // Complete with its own parameters, not those of a bound sampler object
+  GLint previousSampler = 0;
+  glGetIntegerv(GL_SAMPLER_BINDING, &previousSampler);
+  glBindSampler(0, 0);
+  glBindTexture(GL_TEXTURE_2D, colorTexture);
+  glBindImageTexture(0, m_average->colorTexture(), 0, GL_FALSE, 0,
+      GL_READ_WRITE, GL_RGBA32F);
+  glDispatchCompute(GLuint((m_width + 7) / 8), GLuint((m_height + 7) / 8), 1);
+  // The next frame reads the average, and blitAverage copies it
+  glMemoryBarrier(
+      GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+  glBindSampler(0, GLuint(previousSampler));
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+  glUseProgram(GLuint(previousProgram));
+  ++m_frameCount;
+}
+
+void FrameAccumulator::blitAverage() const { m_average->blitColor(); }
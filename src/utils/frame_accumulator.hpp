@@ -0,0 +1,56 @@
+#pragma once
+
+#include "images.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+
+// Element index of the Halton sequence of base, in [0, 1)
+float getHaltonNumber(size_t index, size_t base);
+
+// Average of frames of a still view, each drawn with its projection offset by
+// a subpixel jitter, for antialiased images refined over several frames.
+//
+// Jitters follow the Halton sequence of bases 2 and 3. The average of the
+// frames is kept in a GL_RGBA32F texture updated by a compute shader.
+class FrameAccumulator
+{
+public:
+  // accumulateProgram is accumulate_frame.cs.glsl
+  FrameAccumulator(
+      GLsizei width, GLsizei height, GLProgram accumulateProgram);
+
+  FrameAccumulator(const FrameAccumulator &) = delete;
+
+  FrameAccumulator &operator=(const FrameAccumulator &) = delete;
+
+  // Number of frames averaged since the last reset
+  size_t frameCount() const { return m_frameCount; }
+
+  void reset() { m_frameCount = 0; }
+
+  // Reallocate the average for frames of another size, and reset it
+  void resize(GLsizei width, GLsizei height);
+
+  // Matrix applied after the projection of the next frame, translating it by
+  // less than half a pixel. Identity for the first frame.
+  glm::mat4 getJitterMatrix() const;
+
+  // Add the texture of the next frame, of the size of the accumulator
+  void add(GLuint colorTexture);
+
+  // Blit the average to the framebuffer bound to GL_DRAW_FRAMEBUFFER, at the
+  // same size
+  void blitAverage() const;
+
+private:
+  GLsizei m_width;
+  GLsizei m_height;
+  std::unique_ptr<OffscreenFramebuffer> m_average;
+  GLProgram m_accumulateProgram;
+  GLint m_uWeight = -1;
+  size_t m_frameCount = 0;
+};
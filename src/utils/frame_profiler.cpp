@@ -0,0 +1,148 @@
+#include "frame_profiler.hpp"
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Query targets of FrameProfiler::Statistic
+const GLenum STATISTIC_TARGETS[] = {GL_VERTICES_SUBMITTED_ARB,
+    GL_PRIMITIVES_SUBMITTED_ARB, GL_VERTEX_SHADER_INVOCATIONS_ARB,
+    GL_CLIPPING_INPUT_PRIMITIVES_ARB, GL_CLIPPING_OUTPUT_PRIMITIVES_ARB,
+    GL_FRAGMENT_SHADER_INVOCATIONS_ARB};
+
+} // namespace
+
+FrameProfiler::FrameProfiler(
+    size_t historySize, size_t frameLatency, bool pipelineStatistics) :
+    m_historySize(std::max(historySize, size_t(1))),
+    m_frameLatency(std::max(frameLatency, size_t(1))),
+    m_pipelineStatistics(pipelineStatistics)
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+  for (const auto *passQueries : {&m_queries, &m_statisticQueries}) {
+    for (const auto &queries : *passQueries) {
+      if (!queries.empty()) {
+        glDeleteQueries(GLsizei(queries.size()), queries.data());
+      }
+    }
+  }
+}
+
+size_t FrameProfiler::addGpuPass(const std::string &name)
+{
+  m_passes.push_back(Pass{name, true, std::vector<float>(m_historySize, 0.f)});
+  std::vector<GLuint> queries(m_frameLatency);
+  glGenQueries(GLsizei(queries.size()), queries.data());
+  m_queries.push_back(std::move(queries));
+  m_isQueryIssued.emplace_back(m_frameLatency, false);
+  std::vector<GLuint> statisticQueries;
+  if (m_pipelineStatistics) {
+    statisticQueries.resize(m_frameLatency * STATISTIC_COUNT);
+    glGenQueries(GLsizei(statisticQueries.size()), statisticQueries.data());
+  }
+  m_statisticQueries.push_back(std::move(statisticQueries));
+  return m_passes.size() - 1;
+}
+
+size_t FrameProfiler::addCpuScope(const std::string &name)
+{
+  m_passes.push_back(
+      Pass{name, false, std::vector<float>(m_historySize, 0.f)});
+  m_queries.emplace_back();
+  m_isQueryIssued.emplace_back();
+  m_statisticQueries.emplace_back();
+  return m_passes.size() - 1;
+}
+
+void FrameProfiler::beginFrame()
+{
+  // The queries of the slot were issued frameLatency frames ago, this frame
+  // reuses them
+  m_slot = m_frame % m_frameLatency;
+  if (m_frame > 0) {
+    const auto previousOffset =
+        (m_historyOffset + m_historySize - 1) % m_historySize;
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+      auto &pass = m_passes[i];
+      auto &time = pass.history[m_historyOffset];
+      if (!pass.isGpu) {
+        time = float(pass.currentTime * 1000.);
+        pass.currentTime = 0;
+        continue;
+      }
+      // Until a result comes, the graph stays flat
+      time = pass.history[previousOffset];
+      if (!m_isQueryIssued[i][m_slot]) {
+        continue;
+      }
+      const auto query = m_queries[i][m_slot];
+      GLint isAvailable = 0;
+      glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+      if (isAvailable) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        time = float(double(nanoseconds) * 1e-6);
+      }
+      // Counts stay those of an earlier frame until theirs come
+      for (size_t j = 0; m_pipelineStatistics && j < STATISTIC_COUNT; ++j) {
+        const auto statisticQuery =
+            m_statisticQueries[i][m_slot * STATISTIC_COUNT + j];
+        glGetQueryObjectiv(
+            statisticQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (isAvailable) {
+          glGetQueryObjectui64v(
+              statisticQuery, GL_QUERY_RESULT, &pass.statistics[j]);
+        }
+      }
+      m_isQueryIssued[i][m_slot] = false;
+    }
+    m_historyOffset = (m_historyOffset + 1) % m_historySize;
+    m_recordedFrameCount = std::min(m_recordedFrameCount + 1, m_historySize);
+  }
+  ++m_frame;
+}
+
+void FrameProfiler::beginGpuPass(size_t pass)
+{
+  glBeginQuery(GL_TIME_ELAPSED, m_queries[pass][m_slot]);
+  if (m_pipelineStatistics) {
+    for (size_t i = 0; i < STATISTIC_COUNT; ++i) {
+      glBeginQuery(STATISTIC_TARGETS[i],
+          m_statisticQueries[pass][m_slot * STATISTIC_COUNT + i]);
+    }
+  }
+}
+
+void FrameProfiler::endGpuPass(size_t pass)
+{
+  glEndQuery(GL_TIME_ELAPSED);
+  if (m_pipelineStatistics) {
+    for (const auto target : STATISTIC_TARGETS) {
+      glEndQuery(target);
+    }
+  }
+  m_isQueryIssued[pass][m_slot] = true;
+}
+
+void FrameProfiler::addCpuTime(size_t scope, double seconds)
+{
+  m_passes[scope].currentTime += seconds;
+}
+
+float FrameProfiler::getAverageTime(size_t pass) const
+{
+  if (!m_recordedFrameCount) {
+    return 0.f;
+  }
+  // The recorded values are the last m_recordedFrameCount before the offset
+  const auto &history = m_passes[pass].history;
+  auto sum = 0.f;
+  for (size_t i = 0; i < m_recordedFrameCount; ++i) {
+    sum += history[(m_historyOffset + m_historySize - 1 - i) % m_historySize];
+  }
+  return sum / float(m_recordedFrameCount);
+}
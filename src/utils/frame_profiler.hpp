@@ -0,0 +1,136 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Durations of the passes of the frames of the viewer, over the last
+// historySize frames: GPU time of passes measured with GL_TIME_ELAPSED
+// queries, and CPU time of scopes.
+//
+// Queries of a frame are in a ring of frameLatency frames. Their results are
+// read when the ring comes back to them, frameLatency frames later, and only
+// if available: measuring never waits for the GPU. A result not available by
+// then is dropped.
+//
+// With pipelineStatistics (GL_ARB_pipeline_statistics_query), GPU passes
+// also count the vertices and primitives they submit, the primitives
+// clipping keeps and the fragments they shade, in queries of the same ring:
+// whether culling, LODs or a depth pre-pass cut the work of a pass shows in
+// its counts, not always in its time.
+//
+// GL_TIME_ELAPSED queries can not be nested, GPU passes must not overlap.
+class FrameProfiler
+{
+public:
+  enum Statistic
+  {
+    VerticesSubmitted,
+    PrimitivesSubmitted,
+    VertexShaderInvocations,
+    ClippingInputPrimitives,
+    ClippingOutputPrimitives,
+    FragmentShaderInvocations,
+    STATISTIC_COUNT
+  };
+
+  struct Pass
+  {
+    std::string name;
+    bool isGpu;
+    // Durations in milliseconds, the oldest at historyOffset
+    std::vector<float> history;
+    double currentTime = 0; // CPU time of the frame so far, in seconds
+    // Of the last frame whose results came, with pipeline statistics
+    std::array<GLuint64, STATISTIC_COUNT> statistics = {};
+  };
+
+  explicit FrameProfiler(size_t historySize = 128, size_t frameLatency = 4,
+      bool pipelineStatistics = false);
+
+  ~FrameProfiler();
+
+  FrameProfiler(const FrameProfiler &) = delete;
+
+  FrameProfiler &operator=(const FrameProfiler &) = delete;
+
+  // Register a pass, its index is given to the functions below
+  size_t addGpuPass(const std::string &name);
+
+  size_t addCpuScope(const std::string &name);
+
+  // Record the CPU times of the previous frame and the GPU times available
+  void beginFrame();
+
+  void beginGpuPass(size_t pass);
+
+  void endGpuPass(size_t pass);
+
+  // Add to the CPU time of the frame, a scope can be timed several times
+  void addCpuTime(size_t scope, double seconds);
+
+  const std::vector<Pass> &passes() const { return m_passes; }
+
+  // Index of the oldest value of histories
+  size_t historyOffset() const { return m_historyOffset; }
+
+  // Mean of the recorded history of a pass, in milliseconds
+  float getAverageTime(size_t pass) const;
+
+  bool hasPipelineStatistics() const { return m_pipelineStatistics; }
+
+private:
+  std::vector<Pass> m_passes;
+  size_t m_historySize;
+  size_t m_historyOffset = 0;
+  size_t m_recordedFrameCount = 0; // In histories, at most m_historySize
+  size_t m_frameLatency;
+  size_t m_frame = 0; // Number of beginFrame calls
+  size_t m_slot = 0; // In the query ring, of the current frame
+  // Per pass, the queries of the frameLatency frames and whether they were
+  // issued. Empty for CPU scopes.
+  std::vector<std::vector<GLuint>> m_queries;
+  std::vector<std::vector<bool>> m_isQueryIssued;
+  bool m_pipelineStatistics;
+  // Per pass, STATISTIC_COUNT queries of each of the frameLatency frames
+  std::vector<std::vector<GLuint>> m_statisticQueries;
+};
+
+// Time its lifetime in a CPU scope of profiler, does nothing without one
+class CpuScopeTimer
+{
+public:
+  CpuScopeTimer(FrameProfiler *profiler, size_t scope) :
+      m_profiler(profiler), m_scope(scope)
+  {
+    if (m_profiler) {
+      m_start = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~CpuScopeTimer() { stop(); }
+
+  // Stop timing before the end of the scope
+  void stop()
+  {
+    if (m_profiler) {
+      const std::chrono::duration<double> duration =
+          std::chrono::steady_clock::now() - m_start;
+      m_profiler->addCpuTime(m_scope, duration.count());
+      m_profiler = nullptr;
+    }
+  }
+
+  CpuScopeTimer(const CpuScopeTimer &) = delete;
+
+  CpuScopeTimer &operator=(const CpuScopeTimer &) = delete;
+
+private:
+  FrameProfiler *m_profiler;
+  size_t m_scope;
+  std::chrono::steady_clock::time_point m_start;
+};
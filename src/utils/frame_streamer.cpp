@@ -0,0 +1,146 @@
+#include "frame_streamer.hpp"
+#include "gpu_memory.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+FrameStreamer::FrameStreamer(std::unique_ptr<VideoWriter> writer,
+    GLsizei width, GLsizei height, size_t bufferCount) :
+    m_width(width),
+    m_height(height),
+    m_pixelBuffers(std::max(bufferCount, size_t(1))),
+    m_writer(std::move(writer))
+{
+  GLint previousTexture = 0;
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  m_texture = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+  const auto texture = m_texture.glId();
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+  m_framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+      GL_TEXTURE_2D, m_texture.glId(), 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+
+  const auto byteSize = GLsizeiptr(width) * height * 4;
+  for (auto &buffer : m_pixelBuffers) {
+    buffer.bufferObject = GLBuffer::generate();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject.glId());
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_MAP_READ_BIT);
+    const auto bufferObject = buffer.bufferObject.glId();
+    trackBuffers(GpuMemoryCategory::Transfers, 1, &bufferObject);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_pendingPixels.resize(size_t(byteSize));
+  m_writtenPixels.resize(size_t(byteSize));
+
+  m_thread = std::thread([this]() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [&]() { return m_stop || m_hasPendingFrame; });
+      if (!m_hasPendingFrame) {
+        return;
+      }
+      m_pendingPixels.swap(m_writtenPixels);
+      m_hasPendingFrame = false;
+      lock.unlock();
+      const TraceZone zone("streamFrame");
+      const auto written = m_writer->writeFrame(m_writtenPixels.data());
+      lock.lock();
+      m_hasFailed = m_hasFailed || !written;
+      m_sentFrameCount += written;
+    }
+  });
+}
+
+FrameStreamer::~FrameStreamer()
+{
+  {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+    m_hasPendingFrame = false;
+  }
+  m_condition.notify_one();
+  m_thread.join();
+  m_writer->finish();
+  for (auto &buffer : m_pixelBuffers) {
+    if (buffer.fence) {
+      glDeleteSync(buffer.fence);
+    }
+  }
+}
+
+bool FrameStreamer::capture(GLsizei sourceWidth, GLsizei sourceHeight)
+{
+  // Readbacks done, oldest first, the last one replacing the others
+  while (m_pixelBuffers[m_oldestPixelBuffer].fence) {
+    auto &buffer = m_pixelBuffers[m_oldestPixelBuffer];
+    if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+      break;
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+    m_oldestPixelBuffer = (m_oldestPixelBuffer + 1) % m_pixelBuffers.size();
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject.glId());
+    const auto *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+        GLsizeiptr(m_pendingPixels.size()), GL_MAP_READ_BIT);
+    if (pixels) {
+      {
+        const std::lock_guard<std::mutex> lock(m_mutex);
+        m_droppedFrameCount += m_hasPendingFrame;
+        std::memcpy(m_pendingPixels.data(), pixels, m_pendingPixels.size());
+        m_hasPendingFrame = true;
+      }
+      m_condition.notify_one();
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+
+  auto &buffer = m_pixelBuffers[m_nextPixelBuffer];
+  if (buffer.fence) {
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_droppedFrameCount;
+    return !m_hasFailed;
+  }
+  GLint previousDrawFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, m_width, m_height,
+      GL_COLOR_BUFFER_BIT,
+      sourceWidth == m_width && sourceHeight == m_height ? GL_NEAREST
+                                                         : GL_LINEAR);
+  GLint previousReadFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer.glId());
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject.glId());
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousReadFramebuffer));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousDrawFramebuffer));
+  m_nextPixelBuffer = (m_nextPixelBuffer + 1) % m_pixelBuffers.size();
+
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return !m_hasFailed;
+}
+
+size_t FrameStreamer::droppedFrameCount() const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_droppedFrameCount;
+}
+
+size_t FrameStreamer::sentFrameCount() const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_sentFrameCount;
+}
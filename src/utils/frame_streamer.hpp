@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "video_writer.hpp"
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Frames of the window streamed to a thin client with --stream (see
+// createStreamWriter), without stalling the viewer on their readback nor on
+// their encoding.
+//
+// Each frame the color of the window is scaled to the size of the stream in
+// a texture, so that the stream keeps its size when the window is resized,
+// then read into one of a ring of pixel pack buffers: glReadPixels returns
+// immediately and a fence is put after the copy. A buffer is mapped once its
+// fence is signaled, usually at the next frame, and its pixels handed to a
+// worker thread writing them to the encoder. A frame read back while the
+// worker is still busy replaces the one waiting for it: a slow encoder or
+// client drops frames instead of slowing the viewer down.
+class FrameStreamer
+{
+public:
+  FrameStreamer(std::unique_ptr<VideoWriter> writer, GLsizei width,
+      GLsizei height, size_t bufferCount = 3);
+
+  // Wait for the worker then release GL objects
+  ~FrameStreamer();
+
+  FrameStreamer(const FrameStreamer &) = delete;
+
+  FrameStreamer &operator=(const FrameStreamer &) = delete;
+
+  // Hand the frames whose readback is done to the worker, then queue the
+  // readback of the sourceWidth x sourceHeight color of the framebuffer
+  // bound to GL_READ_FRAMEBUFFER. Returns false once the encoder failed.
+  bool capture(GLsizei sourceWidth, GLsizei sourceHeight);
+
+  // Frames read back but replaced before the worker took them, or not read
+  // back because every pixel buffer was still in flight
+  size_t droppedFrameCount() const;
+
+  // Frames written to the encoder
+  size_t sentFrameCount() const;
+
+private:
+  struct PixelBuffer
+  {
+    GLBuffer bufferObject;
+    GLsync fence = nullptr; // Signaled when the copy is done, null when free
+  };
+
+  GLsizei m_width;
+  GLsizei m_height;
+  GLTexture m_texture; // Of the stream size, the window is scaled into it
+  GLFramebuffer m_framebuffer; // Of m_texture
+  std::vector<PixelBuffer> m_pixelBuffers;
+  size_t m_nextPixelBuffer = 0;
+  size_t m_oldestPixelBuffer = 0; // Of those in flight
+
+  std::unique_ptr<VideoWriter> m_writer;
+  std::thread m_thread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::vector<unsigned char> m_pendingPixels; // Waiting for the worker
+  std::vector<unsigned char> m_writtenPixels; // Of the worker
+  bool m_hasPendingFrame = false;
+  bool m_stop = false;
+  bool m_hasFailed = false;
+  size_t m_droppedFrameCount = 0;
+  size_t m_sentFrameCount = 0;
+};
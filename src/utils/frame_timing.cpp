@@ -0,0 +1,226 @@
+#include "frame_timing.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+namespace {
+
+const char *const WORK_NAMES[] = {
+    "texture upload", "shader compile", "readback", "file reload"};
+const size_t WORK_COUNT = sizeof(WORK_NAMES) / sizeof(WORK_NAMES[0]);
+
+// Below, the median is not meaningful yet and no frame is a hitch
+const size_t MIN_RECENT_COUNT = 8;
+
+// Between measures of the offset of GPU timestamps, GPU and CPU clocks drift
+const double CALIBRATION_PERIOD = 5.;
+
+} // namespace
+
+const size_t FrameTiming::BUCKET_COUNT;
+constexpr double FrameTiming::BUCKET_MILLISECONDS;
+
+FrameTiming::FrameTiming(
+    double hitchFactor, size_t frameLatency, size_t recentCount) :
+    m_hitchFactor(hitchFactor),
+    m_recentIntervals(std::max(recentCount, MIN_RECENT_COUNT), 0.),
+    m_pending(std::max(frameLatency, size_t(1))),
+    m_histogram(BUCKET_COUNT, 0),
+    m_hitchWorkCounts(WORK_COUNT + 1, 0)
+{
+  for (auto &pending : m_pending) {
+    glGenQueries(1, &pending.query);
+  }
+}
+
+FrameTiming::~FrameTiming()
+{
+  for (const auto &pending : m_pending) {
+    glDeleteQueries(1, &pending.query);
+  }
+}
+
+void FrameTiming::setCsvOutput(std::ostream *output)
+{
+  m_csv = output;
+  if (m_csv) {
+    *m_csv << "frame,input,submit,gpu,swap,interval_ms,hitch,work\n";
+  }
+}
+
+void FrameTiming::beginFrame(bool idle)
+{
+  m_current = Frame();
+  m_current.index = m_nextIndex++;
+  m_isIdle = idle;
+}
+
+void FrameTiming::markInput(double seconds) { m_inputTime = seconds; }
+
+void FrameTiming::endSubmit(double seconds)
+{
+  m_current.inputTime = m_inputTime;
+  m_current.submitTime = seconds;
+  if (m_calibrationTime < 0 ||
+      seconds - m_calibrationTime > CALIBRATION_PERIOD) {
+    calibrate(seconds);
+  }
+  // The slot of the frame frameLatency frames ago
+  auto &pending = m_pending[m_current.index % m_pending.size()];
+  if (pending.hasFrame) {
+    resolve(pending, false);
+  }
+  glQueryCounter(pending.query, GL_TIMESTAMP);
+  pending.isQueryIssued = true;
+}
+
+void FrameTiming::endFrame(double seconds)
+{
+  auto &frame = m_current;
+  frame.swapTime = seconds;
+  const auto work = frame.work;
+  frame.work |= m_previousWork;
+  m_previousWork = work;
+  if (m_previousSwapTime >= 0 && !m_isIdle) {
+    frame.interval = seconds - m_previousSwapTime;
+    if (m_recentFilled >= MIN_RECENT_COUNT) {
+      frame.isHitch =
+          frame.interval > m_hitchFactor * 1e-3 * getRecentPercentile(0.5);
+    }
+    m_recentIntervals[m_recentOffset] = frame.interval;
+    m_recentOffset = (m_recentOffset + 1) % m_recentIntervals.size();
+    m_recentFilled = std::min(m_recentFilled + 1, m_recentIntervals.size());
+    const auto bucket = size_t(frame.interval * 1e3 / BUCKET_MILLISECONDS);
+    ++m_histogram[std::min(bucket, BUCKET_COUNT - 1)];
+    ++m_frameCount;
+    m_maxInterval = std::max(m_maxInterval, frame.interval);
+  }
+  m_previousSwapTime = seconds;
+  if (frame.isHitch) {
+    ++m_hitchCount;
+    m_lastHitch = frame;
+    for (size_t i = 0; i < WORK_COUNT; ++i) {
+      if (frame.work & (1u << i)) {
+        ++m_hitchWorkCounts[i];
+      }
+    }
+    if (!frame.work) {
+      ++m_hitchWorkCounts[WORK_COUNT];
+    }
+  }
+  auto &pending = m_pending[frame.index % m_pending.size()];
+  pending.frame = frame;
+  pending.hasFrame = true;
+}
+
+void FrameTiming::flush()
+{
+  // From the oldest frame
+  for (size_t i = 0; i < m_pending.size(); ++i) {
+    auto &pending = m_pending[(m_nextIndex + i) % m_pending.size()];
+    if (pending.hasFrame) {
+      resolve(pending, true);
+    }
+  }
+}
+
+void FrameTiming::resolve(PendingFrame &pending, bool wait)
+{
+  auto &frame = pending.frame;
+  frame.gpuTime = -1;
+  if (pending.isQueryIssued) {
+    GLint isAvailable = wait;
+    if (!wait) {
+      glGetQueryObjectiv(
+          pending.query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    }
+    if (isAvailable) {
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &nanoseconds);
+      frame.gpuTime = double(nanoseconds) * 1e-9 + m_gpuOffset;
+    }
+    pending.isQueryIssued = false;
+  }
+  if (m_csv) {
+    char row[256];
+    std::snprintf(row, sizeof(row), "%zu,%.6f,%.6f,%.6f,%.6f,%.3f,%d,",
+        frame.index, frame.inputTime, frame.submitTime, frame.gpuTime,
+        frame.swapTime, frame.interval * 1e3, int(frame.isHitch));
+    *m_csv << row << getWorkNames(frame.work, "|") << "\n";
+  }
+  pending.hasFrame = false;
+}
+
+void FrameTiming::calibrate(double seconds)
+{
+  // The GPU time once the commands so far reached the GPU, without waiting
+  // for them to run, slightly after seconds
+  GLint64 nanoseconds = 0;
+  glGetInteger64v(GL_TIMESTAMP, &nanoseconds);
+  m_gpuOffset = seconds - double(nanoseconds) * 1e-9;
+  m_calibrationTime = seconds;
+}
+
+double FrameTiming::getRecentPercentile(double percentile) const
+{
+  if (!m_recentFilled) {
+    return 0.;
+  }
+  // Filled from the start of the ring until it wraps
+  std::vector<double> intervals(begin(m_recentIntervals),
+      begin(m_recentIntervals) + ptrdiff_t(m_recentFilled));
+  const auto nth = begin(intervals) +
+                   ptrdiff_t(percentile * double(intervals.size() - 1));
+  std::nth_element(begin(intervals), nth, end(intervals));
+  return *nth * 1e3;
+}
+
+double FrameTiming::getPercentile(double percentile) const
+{
+  if (!m_frameCount) {
+    return 0.;
+  }
+  const auto rank =
+      std::min(size_t(percentile * double(m_frameCount)), m_frameCount - 1);
+  size_t count = 0;
+  for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+    count += m_histogram[i];
+    if (count > rank) {
+      // Upper bound of the bucket
+      return double(i + 1) * BUCKET_MILLISECONDS;
+    }
+  }
+  return 0.;
+}
+
+std::string FrameTiming::getWorkNames(unsigned work, const char *separator)
+{
+  std::string names;
+  for (size_t i = 0; i < WORK_COUNT; ++i) {
+    if (work & (1u << i)) {
+      names += (names.empty() ? "" : separator);
+      names += WORK_NAMES[i];
+    }
+  }
+  return names.empty() ? "none" : names;
+}
+
+void writeFrameTimingSummary(std::ostream &output, const FrameTiming &timing)
+{
+  char line[256];
+  std::snprintf(line, sizeof(line),
+      "Frame intervals: %zu frames, median %.1f ms, 99th percentile %.1f ms, "
+      "maximum %.1f ms",
+      timing.frameCount(), timing.getPercentile(0.5),
+      timing.getPercentile(0.99), timing.maxInterval());
+  output << line << "\n";
+  output << "Hitches: " << timing.hitchCount() << "\n";
+  const auto &workCounts = timing.hitchWorkCounts();
+  for (size_t i = 0; i < workCounts.size(); ++i) {
+    if (workCounts[i]) {
+      output << "  " << FrameTiming::getWorkNames(1u << i) << ": "
+             << workCounts[i] << "\n";
+    }
+  }
+}
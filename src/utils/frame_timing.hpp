@@ -0,0 +1,153 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Presentation timing of the frames of the viewer, to tell smooth frames from
+// stuttering ones beyond their average rate.
+//
+// Each frame records when the input it draws was sampled, when the CPU was
+// done submitting it, when the GPU was done with it and when swapping its
+// buffers returned, in seconds on the clock of glfwGetTime. The end on the GPU
+// comes from a GL_TIMESTAMP query after the last command of the frame, read
+// frameLatency frames later if available, like the queries of FrameProfiler:
+// timing never waits for the GPU. GPU timestamps are converted to the CPU
+// clock by an offset measured every few seconds.
+//
+// The intervals between the swaps of consecutive frames are counted in a
+// histogram. A frame whose interval exceeds hitchFactor times the median of
+// the recent ones is a hitch, attributed to the work marked during it or the
+// frame before, whose GPU commands may have delayed its swap.
+class FrameTiming
+{
+public:
+  // Work of a frame that may make it late, a frame can mark several
+  enum Work : unsigned
+  {
+    TextureUpload = 1,
+    ShaderCompile = 2,
+    Readback = 4,
+    FileReload = 8,
+  };
+
+  struct Frame
+  {
+    size_t index = 0;
+    double inputTime = 0;
+    double submitTime = 0;
+    double gpuTime = 0; // Negative if the query result never came
+    double swapTime = 0;
+    double interval = 0; // Since the previous swap, 0 after an idle wait
+    unsigned work = 0; // Marked during the frame or the one before
+    bool isHitch = false;
+  };
+
+  static const size_t BUCKET_COUNT = 100;
+  // Of the histogram, the last bucket also counts longer intervals
+  static constexpr double BUCKET_MILLISECONDS = 0.5;
+
+  explicit FrameTiming(
+      double hitchFactor = 2., size_t frameLatency = 4, size_t recentCount = 64);
+
+  ~FrameTiming();
+
+  FrameTiming(const FrameTiming &) = delete;
+
+  FrameTiming &operator=(const FrameTiming &) = delete;
+
+  // Frames are written to output as their GPU time is read, one CSV row each
+  // after a header. output must outlive the timing.
+  void setCsvOutput(std::ostream *output);
+
+  // Start a frame, after waiting for events if idle, its interval then not
+  // being counted: the loop was not late, it had nothing to draw
+  void beginFrame(bool idle = false);
+
+  // Input sampled, the last one before endSubmit is that of the frame
+  void markInput(double seconds);
+
+  void markWork(unsigned work) { m_current.work |= work; }
+
+  // After the last command of the frame, before swapping
+  void endSubmit(double seconds);
+
+  // Once swapping returned
+  void endFrame(double seconds);
+
+  // Read the GPU times still pending, waiting for them
+  void flush();
+
+  const std::vector<size_t> &histogram() const { return m_histogram; }
+
+  size_t frameCount() const { return m_frameCount; }
+
+  size_t hitchCount() const { return m_hitchCount; }
+
+  // Hitches per kind of work, by bit of Work, the last for none
+  const std::vector<size_t> &hitchWorkCounts() const
+  {
+    return m_hitchWorkCounts;
+  }
+
+  // Null if no frame was a hitch
+  const Frame *lastHitch() const
+  {
+    return m_hitchCount ? &m_lastHitch : nullptr;
+  }
+
+  // In milliseconds, of the recent intervals, 0 without any
+  double getRecentPercentile(double percentile) const;
+
+  // In milliseconds, of the counted intervals, from the histogram: the
+  // upper bound of the bucket, that of the last one if in it
+  double getPercentile(double percentile) const;
+
+  // In milliseconds, of the counted intervals
+  double maxInterval() const { return m_maxInterval * 1e3; }
+
+  // Names of the bits of work joined by separator, "none" without
+  static std::string getWorkNames(
+      unsigned work, const char *separator = ", ");
+
+private:
+  struct PendingFrame
+  {
+    Frame frame;
+    GLuint query = 0;
+    bool isQueryIssued = false;
+    bool hasFrame = false; // Swapped, not resolved yet
+  };
+
+  // Read the GPU time of pending, waiting for it with wait, and write it
+  void resolve(PendingFrame &pending, bool wait);
+
+  void calibrate(double seconds);
+
+  double m_hitchFactor;
+  std::vector<double> m_recentIntervals; // In a ring, in seconds
+  size_t m_recentOffset = 0;
+  size_t m_recentFilled = 0;
+  std::vector<PendingFrame> m_pending; // Ring of frameLatency frames
+  Frame m_current;
+  size_t m_nextIndex = 0;
+  double m_inputTime = 0;
+  double m_previousSwapTime = -1; // Negative before the first swap
+  bool m_isIdle = false;
+  unsigned m_previousWork = 0;
+  double m_gpuOffset = 0; // CPU seconds minus GPU seconds
+  double m_calibrationTime = -1;
+  std::vector<size_t> m_histogram;
+  size_t m_frameCount = 0; // Of the histogram
+  double m_maxInterval = 0;
+  size_t m_hitchCount = 0;
+  std::vector<size_t> m_hitchWorkCounts;
+  Frame m_lastHitch;
+  std::ostream *m_csv = nullptr;
+};
+
+// Frames and percentiles of intervals, and hitches by work, one per line
+void writeFrameTimingSummary(std::ostream &output, const FrameTiming &timing);
@@ -0,0 +1,90 @@
+#include "gbuffer.hpp"
+#include "gpu_memory.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+// Of the attachments, in the order of GBuffer::SAMPLER_NAMES
+const GLenum ATTACHMENT_FORMATS[GBuffer::TEXTURE_COUNT] = {GL_RGBA8, GL_RG16,
+    GL_RGBA8, GL_R11F_G11F_B10F, GL_DEPTH_COMPONENT32F};
+
+} // namespace
+
+const char *const GBuffer::SAMPLER_NAMES[GBuffer::TEXTURE_COUNT] = {
+    "uGBufferAlbedo", "uGBufferNormal", "uGBufferMaterial",
+    "uGBufferEmissive", "uGBufferDepth"};
+
+GBuffer::GBuffer()
+{
+  m_framebuffer = GLFramebuffer::generate();
+  m_emptyVertexArray = GLVertexArray::generate();
+}
+
+void GBuffer::createAttachments(GLsizei width, GLsizei height)
+{
+  m_textures = GLTextures::generate(TEXTURE_COUNT);
+  for (GLuint i = 0; i < TEXTURE_COUNT; ++i) {
+    glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+    glTexStorage2D(GL_TEXTURE_2D, 1, ATTACHMENT_FORMATS[i], width, height);
+    // Only read with texelFetch, but must be complete for it
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  GLenum drawBuffers[TEXTURE_COUNT - 1];
+  for (GLuint i = 0; i + 1 < TEXTURE_COUNT; ++i) {
+    drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, drawBuffers[i], m_textures[i], 0);
+  }
+  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+      m_textures[TEXTURE_COUNT - 1], 0);
+  glDrawBuffers(GLsizei(TEXTURE_COUNT - 1), drawBuffers);
+  if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) !=
+      GL_FRAMEBUFFER_COMPLETE) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(m_previousFramebuffer));
+    throw std::runtime_error("GBuffer: incomplete framebuffer");
+  }
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D,
+      GLsizei(TEXTURE_COUNT), m_textures.data());
+  m_width = width;
+  m_height = height;
+}
+
+void GBuffer::begin(GLsizei width, GLsizei height)
+{
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+  if (width != m_width || height != m_height) {
+    createAttachments(width, height);
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  // Pixels of depth 1 are not shaded, their colors are not read
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void GBuffer::end()
+{
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(m_previousFramebuffer));
+  for (GLuint i = 0; i < TEXTURE_COUNT; ++i) {
+    glActiveTexture(GL_TEXTURE0 + FIRST_TEXTURE_UNIT + i);
+    glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+    glBindSampler(FIRST_TEXTURE_UNIT + i, 0);
+  }
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::drawLightingPass()
+{
+  GLint previousDepthFunc = GL_LESS;
+  glGetIntegerv(GL_DEPTH_FUNC, &previousDepthFunc);
+  GLint previousVertexArray = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+  glDepthFunc(GL_ALWAYS);
+  glBindVertexArray(m_emptyVertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(GLuint(previousVertexArray));
+  glDepthFunc(GLenum(previousDepthFunc));
+}
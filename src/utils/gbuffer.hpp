@@ -0,0 +1,55 @@
+#pragma once
+
+#include "gl_objects.hpp"
+
+#include <glad/glad.h>
+
+// G-buffer of --deferred-shading: the material parameters of the nearest
+// surface of each pixel, drawn by the variants of the PBR shader with
+// GBUFFER, then shaded once per pixel by the lighting pass (the PBR shader
+// with DEFERRED_LIGHTING), whatever the overdraw of the scene.
+//
+// Attachments are compact: the sRGB encoded base color in RGBA8, the
+// octahedral view space normal in RG16, metallic, roughness and occlusion in
+// RGBA8, the emissive color in R11F_G11F_B10F and the depth in 32 bits
+// floats. They are created again when the size of the viewport changes.
+class GBuffer
+{
+public:
+  // Units of the attachments read by the lighting pass, after those of
+  // EnvironmentMap, in the order of SAMPLER_NAMES
+  static const GLuint FIRST_TEXTURE_UNIT = 8;
+  static const GLuint TEXTURE_COUNT = 5;
+  static const char *const SAMPLER_NAMES[TEXTURE_COUNT];
+  // Indices in SAMPLER_NAMES of the attachments read by AmbientOcclusion
+  static const GLuint NORMAL_TEXTURE = 1;
+  static const GLuint DEPTH_TEXTURE = 4;
+
+  GBuffer();
+
+  GBuffer(const GBuffer &) = delete;
+
+  GBuffer &operator=(const GBuffer &) = delete;
+
+  // Bind the framebuffer of width x height attachments as draw framebuffer
+  // and clear it
+  void begin(GLsizei width, GLsizei height);
+
+  // Bind the draw framebuffer bound before begin() again, and the
+  // attachments to their texture units
+  void end();
+
+  // Draw the triangle covering the viewport with the current program, which
+  // writes the depth of the G-buffer with the shaded color
+  void drawLightingPass();
+
+private:
+  void createAttachments(GLsizei width, GLsizei height);
+
+  GLsizei m_width = 0;
+  GLsizei m_height = 0;
+  GLTextures m_textures;
+  GLFramebuffer m_framebuffer;
+  GLVertexArray m_emptyVertexArray;
+  GLint m_previousFramebuffer = 0;
+};
@@ -1,9 +1,12 @@
 #include "gl_debug_output.hpp"
+#include "trace.hpp"
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <glad/glad.h>
-#include <imgui.h>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <tuple>
 #include <unordered_map>
 #include <vector>
@@ -60,34 +63,157 @@ static std::array<std::tuple<const char *, bool, GLenum>, 4> severitySelector =
         std::make_tuple("LOW", true, GL_DEBUG_SEVERITY_LOW),
         std::make_tuple("NOTIFICATION", false, GL_DEBUG_SEVERITY_NOTIFICATION)};
 
+#ifndef GL_CONTEXT_FLAG_NO_ERROR_BIT
+#define GL_CONTEXT_FLAG_NO_ERROR_BIT 0x00000008
+#endif
+
+// Messages may be reported by driver threads without synchronous output
+static std::atomic<size_t> performanceMessageCount{0};
+
+static std::atomic<bool> collectingMessages{false};
+static std::mutex collectedMessagesMutex;
+// By source, type and id, then zone
+static std::map<std::tuple<GLenum, GLenum, GLuint>, GLMessageStats>
+    collectedMessages;
+static std::map<std::tuple<GLenum, GLenum, GLuint>,
+    std::map<std::string, size_t>>
+    collectedZoneCounts;
+
+template <typename Map> const char *findEnumString(GLenum value, const Map &map)
+{
+  const auto it = map.find(value);
+  if (it == end(map)) {
+    return "UNDEFINED";
+  }
+  return (*it).second;
+}
+
+// Returns true for the first message of its source, type and id
+bool collectGLMessage(
+    GLenum source, GLenum type, GLuint id, GLenum severity, const char *message)
+{
+  const auto key = std::make_tuple(source, type, id);
+  const auto *zone = getCurrentTraceZone();
+  std::lock_guard<std::mutex> lock(collectedMessagesMutex);
+  ++collectedZoneCounts[key][zone ? zone : ""];
+  auto &stats = collectedMessages[key];
+  if (stats.count++ > 0) {
+    return false;
+  }
+  stats.source = findEnumString(source, sourceEnumToString);
+  stats.type = findEnumString(type, typeEnumToString);
+  stats.severity = findEnumString(severity, severityEnumToString);
+  stats.id = id;
+  stats.message = message;
+  return true;
+}
+
 void logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
     GLsizei length, const GLchar *message, GLvoid *userParam);
 
-void initGLDebugOutput()
+void countGLPerformanceMessage(GLenum source, GLenum type, GLuint id,
+    GLenum severity, GLsizei, const GLchar *message, GLvoid *)
+{
+  if (type == GL_DEBUG_TYPE_PERFORMANCE) {
+    performanceMessageCount.fetch_add(1, std::memory_order_relaxed);
+    if (collectingMessages.load(std::memory_order_relaxed)) {
+      collectGLMessage(source, type, id, severity, message);
+    }
+  }
+}
+
+void initGLDebugOutput(GLContextMode mode)
 {
-  glDebugMessageCallback((GLDEBUGPROCARB)logGLDebugInfo, nullptr);
-  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  switch (mode) {
+  case GLContextMode::Debug:
+    glDebugMessageCallback((GLDEBUGPROCARB)logGLDebugInfo, nullptr);
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 
-  for (const auto &tuple : ignoreList) {
-    glDebugMessageControl(std::get<0>(tuple), std::get<1>(tuple),
-        std::get<2>(tuple), 0, nullptr, GL_FALSE);
+    for (const auto &tuple : ignoreList) {
+      glDebugMessageControl(std::get<0>(tuple), std::get<1>(tuple),
+          std::get<2>(tuple), 0, nullptr, GL_FALSE);
+    }
+    break;
+  case GLContextMode::Release:
+    // Off by default without a debug context
+    glEnable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback((GLDEBUGPROCARB)countGLPerformanceMessage, nullptr);
+    glDebugMessageControl(
+        GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+    glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE,
+        GL_DONT_CARE, 0, nullptr, GL_TRUE);
+    break;
+  case GLContextMode::NoError: {
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if (!(flags & GL_CONTEXT_FLAG_NO_ERROR_BIT)) {
+      std::clog << "No KHR_no_error context, GL errors are still checked"
+                << std::endl;
+    }
+    break;
+  }
   }
 }
 
-void logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
-    GLsizei length, const GLchar *message, GLvoid *userParam)
+void printGLVersion()
 {
-  const auto findStr = [](GLenum value, const auto &map) {
-    const auto it = map.find(value);
-    if (it == end(map)) {
-      return "UNDEFINED";
+  GLint glVersion[2];
+  glGetIntegerv(GL_MAJOR_VERSION, &glVersion[0]);
+  glGetIntegerv(GL_MINOR_VERSION, &glVersion[1]);
+
+  std::clog << "OpenGL Version " << glVersion[0] << "." << glVersion[1]
+            << std::endl;
+}
+
+size_t getGLPerformanceMessageCount()
+{
+  return performanceMessageCount.load(std::memory_order_relaxed);
+}
+
+void startCollectingGLMessages() { collectingMessages = true; }
+
+bool isCollectingGLMessages()
+{
+  return collectingMessages.load(std::memory_order_relaxed);
+}
+
+std::vector<GLMessageStats> getCollectedGLMessages()
+{
+  std::vector<GLMessageStats> messages;
+  {
+    std::lock_guard<std::mutex> lock(collectedMessagesMutex);
+    for (const auto &entry : collectedMessages) {
+      messages.push_back(entry.second);
+      const auto &zoneCounts = collectedZoneCounts[entry.first];
+      messages.back().zoneCounts.assign(begin(zoneCounts), end(zoneCounts));
     }
-    return (*it).second;
-  };
+  }
+  std::stable_sort(begin(messages), end(messages),
+      [](const GLMessageStats &a, const GLMessageStats &b) {
+        return a.count > b.count;
+      });
+  for (auto &stats : messages) {
+    std::stable_sort(begin(stats.zoneCounts), end(stats.zoneCounts),
+        [](const auto &a, const auto &b) { return a.second > b.second; });
+  }
+  return messages;
+}
+
+void logGLDebugInfo(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei, const GLchar *message, GLvoid *)
+{
+  if (type == GL_DEBUG_TYPE_PERFORMANCE) {
+    performanceMessageCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Repeated messages are only counted
+  if (collectingMessages.load(std::memory_order_relaxed) &&
+      !collectGLMessage(source, type, id, severity, message)) {
+    return;
+  }
 
-  const auto sourceStr = findStr(source, sourceEnumToString);
-  const auto typeStr = findStr(type, typeEnumToString);
-  const auto severityStr = findStr(severity, severityEnumToString);
+  const auto sourceStr = findEnumString(source, sourceEnumToString);
+  const auto typeStr = findEnumString(type, typeEnumToString);
+  const auto severityStr = findEnumString(severity, severityEnumToString);
 
   std::clog << "OpenGL: " << message << " [source=" << sourceStr
             << " type=" << typeStr << " severity=" << severityStr
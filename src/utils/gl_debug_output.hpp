@@ -1,3 +1,54 @@
 #pragma once
 
-void initGLDebugOutput();
\ No newline at end of file
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// How a GL context reports errors, fixed when the context is created
+enum class GLContextMode
+{
+  // Debug context, all messages but notifications logged synchronously by the
+  // thread calling GL, so that they come with its call stack
+  Debug,
+  // Non-debug context, the driver only reports performance messages, counted
+  // asynchronously (see getGLPerformanceMessageCount)
+  Release,
+  // KHR_no_error context where supported: errors are not checked, invalid
+  // calls are undefined behavior. Nothing is reported.
+  NoError
+};
+
+// Sets up the debug output of the current context, created in mode
+void initGLDebugOutput(GLContextMode mode = GLContextMode::Debug);
+
+// Log the version of the current context, of GLFWHandle or HeadlessGLContext
+void printGLVersion();
+
+// GL_DEBUG_TYPE_PERFORMANCE messages reported by the contexts set up by
+// initGLDebugOutput, from any thread
+size_t getGLPerformanceMessageCount();
+
+// Messages of a source, type and id reported while collecting
+struct GLMessageStats
+{
+  const char *source = ""; // "API", "SHADER_COMPILER"...
+  const char *type = ""; // "PERFORMANCE", "ERROR"...
+  const char *severity = ""; // Of the first one
+  unsigned id = 0;
+  std::string message; // First one reported
+  size_t count = 0;
+  // Of the trace zone current when they were reported, "" outside of zones
+  // or from driver threads (see getCurrentTraceZone)
+  std::vector<std::pair<std::string, size_t>> zoneCounts;
+};
+
+// From now on, only log the first message of each source, type and id, and
+// count them in the current trace zone. Performance messages of
+// GLContextMode::Release contexts are collected too.
+void startCollectingGLMessages();
+
+bool isCollectingGLMessages();
+
+// Those reported since startCollectingGLMessages, most frequent first
+std::vector<GLMessageStats> getCollectedGLMessages();
@@ -0,0 +1,118 @@
+#include "gl_extensions.hpp"
+
+#include "glfw.hpp"
+
+#include <cstring>
+
+#ifdef GLTF_VIEWER_USE_EGL
+#include <EGL/egl.h>
+#endif
+
+namespace {
+
+// From the headless EGL context if one is current, else from GLFW
+void *getGLProcAddress(const char *name)
+{
+#ifdef GLTF_VIEWER_USE_EGL
+  if (eglGetCurrentContext() != EGL_NO_CONTEXT) {
+    return reinterpret_cast<void *>(eglGetProcAddress(name));
+  }
+#endif
+#ifdef GLTF_VIEWER_HEADLESS
+  return nullptr;
+#else
+  return reinterpret_cast<void *>(glfwGetProcAddress(name));
+#endif
+}
+
+} // namespace
+
+bool hasGLExtension(const char *name)
+{
+  GLint extensionCount = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+  for (GLint i = 0; i < extensionCount; ++i) {
+    const auto extension =
+        reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+    if (extension && std::strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool loadBindlessTextureFunctions(BindlessTextureFunctions &functions)
+{
+  if (!hasGLExtension("GL_ARB_bindless_texture")) {
+    return false;
+  }
+  functions.getTextureHandle = reinterpret_cast<decltype(
+      functions.getTextureHandle)>(getGLProcAddress("glGetTextureHandleARB"));
+  functions.getTextureSamplerHandle =
+      reinterpret_cast<decltype(functions.getTextureSamplerHandle)>(
+          getGLProcAddress("glGetTextureSamplerHandleARB"));
+  functions.makeTextureHandleResident =
+      reinterpret_cast<decltype(functions.makeTextureHandleResident)>(
+          getGLProcAddress("glMakeTextureHandleResidentARB"));
+  functions.makeTextureHandleNonResident =
+      reinterpret_cast<decltype(functions.makeTextureHandleNonResident)>(
+          getGLProcAddress("glMakeTextureHandleNonResidentARB"));
+  return functions.getTextureHandle && functions.getTextureSamplerHandle &&
+         functions.makeTextureHandleResident &&
+         functions.makeTextureHandleNonResident;
+}
+
+bool loadShadingRateImageFunctions(ShadingRateImageFunctions &functions)
+{
+  if (!hasGLExtension("GL_NV_shading_rate_image")) {
+    return false;
+  }
+  functions.bindShadingRateImage =
+      reinterpret_cast<decltype(functions.bindShadingRateImage)>(
+          getGLProcAddress("glBindShadingRateImageNV"));
+  functions.shadingRateImagePalette =
+      reinterpret_cast<decltype(functions.shadingRateImagePalette)>(
+          getGLProcAddress("glShadingRateImagePaletteNV"));
+  return functions.bindShadingRateImage && functions.shadingRateImagePalette;
+}
+
+bool enableParallelShaderCompile()
+{
+  using MaxThreadsFunction = void(APIENTRY *)(GLuint count);
+  MaxThreadsFunction maxShaderCompilerThreads = nullptr;
+  if (hasGLExtension("GL_KHR_parallel_shader_compile")) {
+    maxShaderCompilerThreads = reinterpret_cast<MaxThreadsFunction>(
+        getGLProcAddress("glMaxShaderCompilerThreadsKHR"));
+  } else if (hasGLExtension("GL_ARB_parallel_shader_compile")) {
+    maxShaderCompilerThreads = reinterpret_cast<MaxThreadsFunction>(
+        getGLProcAddress("glMaxShaderCompilerThreadsARB"));
+  }
+  if (!maxShaderCompilerThreads) {
+    return false;
+  }
+  // The number of threads is left to the driver
+  maxShaderCompilerThreads(0xFFFFFFFF);
+  return true;
+}
+
+ClipControlFunction loadClipControlFunction()
+{
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major * 10 + minor < 45 && !hasGLExtension("GL_ARB_clip_control")) {
+    return nullptr;
+  }
+  return reinterpret_cast<ClipControlFunction>(
+      getGLProcAddress("glClipControl"));
+}
+
+FramebufferTextureMultiviewFunction loadFramebufferTextureMultiviewFunction()
+{
+  if (!hasGLExtension("GL_OVR_multiview2")) {
+    return nullptr;
+  }
+  return reinterpret_cast<FramebufferTextureMultiviewFunction>(
+      getGLProcAddress("glFramebufferTextureMultiviewOVR"));
+}
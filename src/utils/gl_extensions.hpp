@@ -0,0 +1,78 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// True if the current GL context exposes the extension (eg.
+// "GL_EXT_texture_compression_s3tc"). The generated glad loader only covers
+// core GL, so extensions are queried at runtime.
+bool hasGLExtension(const char *name);
+
+// Entry points of GL_ARB_bindless_texture used by the viewer
+struct BindlessTextureFunctions
+{
+  GLuint64(APIENTRY *getTextureHandle)(GLuint texture) = nullptr;
+  GLuint64(APIENTRY *getTextureSamplerHandle)(
+      GLuint texture, GLuint sampler) = nullptr;
+  void(APIENTRY *makeTextureHandleResident)(GLuint64 handle) = nullptr;
+  void(APIENTRY *makeTextureHandleNonResident)(GLuint64 handle) = nullptr;
+};
+
+// Load them from the current context, returns false if it does not expose
+// GL_ARB_bindless_texture
+bool loadBindlessTextureFunctions(BindlessTextureFunctions &functions);
+
+// Let the driver compile shaders on threads of its own, as many as it wants,
+// with GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile:
+// glCompileShader and glLinkProgram return at once, only querying their
+// status waits. Returns false if the context has neither.
+bool enableParallelShaderCompile();
+
+#ifndef GL_ZERO_TO_ONE
+#define GL_NEGATIVE_ONE_TO_ONE 0x935E
+#define GL_ZERO_TO_ONE 0x935F
+#endif
+
+// glClipControl, core in GL 4.5 which glad does not cover, or from
+// GL_ARB_clip_control. Returns null if the context has neither.
+using ClipControlFunction = void(APIENTRY *)(GLenum origin, GLenum depth);
+ClipControlFunction loadClipControlFunction();
+
+#ifndef GL_SHADING_RATE_IMAGE_NV
+#define GL_SHADING_RATE_IMAGE_NV 0x9563
+#define GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV 0x9565
+#define GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV 0x9568
+#define GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV 0x956B
+#define GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV 0x955C
+#define GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV 0x955D
+#endif
+
+// Entry points of GL_NV_shading_rate_image used by the viewer
+struct ShadingRateImageFunctions
+{
+  void(APIENTRY *bindShadingRateImage)(GLuint texture) = nullptr;
+  void(APIENTRY *shadingRateImagePalette)(
+      GLuint viewport, GLuint first, GLsizei count, const GLenum *rates) =
+      nullptr;
+};
+
+// Load them from the current context, returns false if it does not expose
+// GL_NV_shading_rate_image
+bool loadShadingRateImageFunctions(ShadingRateImageFunctions &functions);
+
+// glFramebufferTextureMultiviewOVR of GL_OVR_multiview, rendering the draws
+// of a pass in numViews consecutive layers of an array texture. Returns null
+// if the context does not expose GL_OVR_multiview2, which shaders writing
+// more than gl_Position per view need.
+using FramebufferTextureMultiviewFunction = void(APIENTRY *)(GLenum target,
+    GLenum attachment, GLuint texture, GLint level, GLint baseViewIndex,
+    GLsizei numViews);
+FramebufferTextureMultiviewFunction loadFramebufferTextureMultiviewFunction();
+
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB 0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB 0x82F7
+#endif
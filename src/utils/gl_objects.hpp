@@ -0,0 +1,254 @@
+#pragma once
+
+#include "gpu_memory.hpp"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Move-only owners of GL objects, deleted by their destructor like GLShader
+// and GLProgram, and no longer accounted for by the current
+// GpuMemoryTracker. The context they were created in must still be current.
+//
+// Traits generate and delete names of one type of object, see the aliases
+// at the end.
+template <typename Traits> class GLObject
+{
+  GLuint m_GLId = 0;
+
+public:
+  // No object
+  GLObject() = default;
+
+  // Own an object created elsewhere
+  explicit GLObject(GLuint glId) : m_GLId(glId) {}
+
+  ~GLObject() { reset(); }
+
+  GLObject(const GLObject &) = delete;
+
+  GLObject &operator=(const GLObject &) = delete;
+
+  GLObject(GLObject &&rvalue) : m_GLId(rvalue.m_GLId) { rvalue.m_GLId = 0; }
+
+  GLObject &operator=(GLObject &&rvalue)
+  {
+    reset(rvalue.m_GLId);
+    rvalue.m_GLId = 0;
+    return *this;
+  }
+
+  // A new name, bound to a target before it becomes an object
+  static GLObject generate()
+  {
+    GLObject object;
+    Traits::generate(1, &object.m_GLId);
+    return object;
+  }
+
+  GLuint glId() const { return m_GLId; }
+
+  // Delete the object and own glId instead
+  void reset(GLuint glId = 0)
+  {
+    if (m_GLId && m_GLId != glId) {
+      Traits::destroy(1, &m_GLId);
+    }
+    m_GLId = glId;
+  }
+
+  // Stop owning the object, returns it
+  GLuint release()
+  {
+    const auto glId = m_GLId;
+    m_GLId = 0;
+    return glId;
+  }
+};
+
+// Objects deleted together, such as the textures of the images of a model.
+// Names can be 0, or repeated when objects are shared by several entries or
+// owners: names already deleted are ignored by glDelete*.
+template <typename Traits> class GLObjects
+{
+  std::vector<GLuint> m_GLIds;
+
+public:
+  GLObjects() = default;
+
+  // Own objects created elsewhere
+  explicit GLObjects(std::vector<GLuint> glIds) : m_GLIds(std::move(glIds))
+  {
+  }
+
+  ~GLObjects() { clear(); }
+
+  GLObjects(const GLObjects &) = delete;
+
+  GLObjects &operator=(const GLObjects &) = delete;
+
+  GLObjects(GLObjects &&rvalue) : m_GLIds(std::move(rvalue.m_GLIds))
+  {
+    rvalue.m_GLIds.clear();
+  }
+
+  GLObjects &operator=(GLObjects &&rvalue)
+  {
+    clear();
+    m_GLIds = std::move(rvalue.m_GLIds);
+    rvalue.m_GLIds.clear();
+    return *this;
+  }
+
+  // count new names
+  static GLObjects generate(size_t count)
+  {
+    GLObjects objects;
+    objects.m_GLIds.resize(count, 0);
+    Traits::generate(GLsizei(count), objects.m_GLIds.data());
+    return objects;
+  }
+
+  size_t size() const { return m_GLIds.size(); }
+
+  bool empty() const { return m_GLIds.empty(); }
+
+  GLuint operator[](size_t i) const { return m_GLIds[i]; }
+
+  GLuint back() const { return m_GLIds.back(); }
+
+  std::vector<GLuint>::const_iterator begin() const { return m_GLIds.begin(); }
+
+  std::vector<GLuint>::const_iterator end() const { return m_GLIds.end(); }
+
+  const GLuint *data() const { return m_GLIds.data(); }
+
+  const std::vector<GLuint> &glIds() const { return m_GLIds; }
+
+  // Own one more object
+  void push_back(GLuint glId) { m_GLIds.push_back(glId); }
+
+  // Delete the object of entry i, unless other entries share it, and own
+  // glId there instead
+  void reset(size_t i, GLuint glId)
+  {
+    const auto previous = m_GLIds[i];
+    m_GLIds[i] = glId;
+    if (previous && previous != glId &&
+        std::find(m_GLIds.begin(), m_GLIds.end(), previous) ==
+            m_GLIds.end()) {
+      Traits::destroy(1, &previous);
+    }
+  }
+
+  // Stop owning the objects, returns them
+  std::vector<GLuint> release()
+  {
+    auto glIds = std::move(m_GLIds);
+    m_GLIds.clear();
+    return glIds;
+  }
+
+  // Delete all objects
+  void clear()
+  {
+    // Repeated names are ignored once deleted
+    if (!m_GLIds.empty()) {
+      Traits::destroy(GLsizei(m_GLIds.size()), m_GLIds.data());
+    }
+    m_GLIds.clear();
+  }
+};
+
+struct GLBufferTraits
+{
+  static void generate(GLsizei count, GLuint *buffers)
+  {
+    glGenBuffers(count, buffers);
+  }
+
+  static void destroy(GLsizei count, const GLuint *buffers)
+  {
+    untrackBuffers(count, buffers);
+    glDeleteBuffers(count, buffers);
+  }
+};
+
+struct GLTextureTraits
+{
+  static void generate(GLsizei count, GLuint *textures)
+  {
+    glGenTextures(count, textures);
+  }
+
+  static void destroy(GLsizei count, const GLuint *textures)
+  {
+    untrackTextures(count, textures);
+    glDeleteTextures(count, textures);
+  }
+};
+
+struct GLVertexArrayTraits
+{
+  static void generate(GLsizei count, GLuint *vertexArrays)
+  {
+    glGenVertexArrays(count, vertexArrays);
+  }
+
+  static void destroy(GLsizei count, const GLuint *vertexArrays)
+  {
+    glDeleteVertexArrays(count, vertexArrays);
+  }
+};
+
+struct GLSamplerTraits
+{
+  static void generate(GLsizei count, GLuint *samplers)
+  {
+    glGenSamplers(count, samplers);
+  }
+
+  static void destroy(GLsizei count, const GLuint *samplers)
+  {
+    glDeleteSamplers(count, samplers);
+  }
+};
+
+struct GLFramebufferTraits
+{
+  static void generate(GLsizei count, GLuint *framebuffers)
+  {
+    glGenFramebuffers(count, framebuffers);
+  }
+
+  static void destroy(GLsizei count, const GLuint *framebuffers)
+  {
+    glDeleteFramebuffers(count, framebuffers);
+  }
+};
+
+struct GLQueryTraits
+{
+  static void generate(GLsizei count, GLuint *queries)
+  {
+    glGenQueries(count, queries);
+  }
+
+  static void destroy(GLsizei count, const GLuint *queries)
+  {
+    glDeleteQueries(count, queries);
+  }
+};
+
+using GLBuffer = GLObject<GLBufferTraits>;
+using GLBuffers = GLObjects<GLBufferTraits>;
+using GLTexture = GLObject<GLTextureTraits>;
+using GLTextures = GLObjects<GLTextureTraits>;
+using GLVertexArray = GLObject<GLVertexArrayTraits>;
+using GLVertexArrays = GLObjects<GLVertexArrayTraits>;
+using GLSampler = GLObject<GLSamplerTraits>;
+using GLSamplers = GLObjects<GLSamplerTraits>;
+using GLFramebuffer = GLObject<GLFramebufferTraits>;
+using GLQueries = GLObjects<GLQueryTraits>;
@@ -9,6 +9,23 @@
 // clang-format off
 
 #include <glad/glad.h>
+#ifdef GLTF_VIEWER_HEADLESS
+// Without GLFW, windows are only passed around as null pointers, and the
+// camera controllers read the codes of glfw3.h sent by remote input
+typedef struct GLFWwindow GLFWwindow;
+#define GLFW_MOUSE_BUTTON_MIDDLE 2
+#define GLFW_KEY_A 65
+#define GLFW_KEY_D 68
+#define GLFW_KEY_E 69
+#define GLFW_KEY_Q 81
+#define GLFW_KEY_S 83
+#define GLFW_KEY_W 87
+#define GLFW_KEY_DOWN 264
+#define GLFW_KEY_UP 265
+#define GLFW_KEY_LEFT_SHIFT 340
+#define GLFW_KEY_LEFT_CONTROL 341
+#else
 #include <GLFW/glfw3.h>
+#endif
 
 // clang-format on
\ No newline at end of file
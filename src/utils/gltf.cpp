@@ -1,9 +1,548 @@
 #include "gltf.hpp"
+#include "accessor_view.hpp"
+#include "flat_scene.hpp"
+#include "ktx2.hpp"
+#include "parallel.hpp"
+#include "vertex_kernels.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+
+bool isBinaryGltfFile(const fs::path &path)
+{
+  std::ifstream input(path.string(), std::ios::binary);
+  char magic[4] = {};
+  if (!input.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return magic[0] == 'g' && magic[1] == 'l' && magic[2] == 'T' &&
+         magic[3] == 'F';
+}
+
+std::vector<fs::path> loadModelList(const fs::path &path)
+{
+  std::ifstream input(path.string());
+  if (!input) {
+    throw std::runtime_error("Unable to read models from " + path.string());
+  }
+  std::vector<fs::path> models;
+  std::string line;
+  while (std::getline(input, line)) {
+    const auto first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    const auto last = line.find_last_not_of(" \t\r");
+    const fs::path model = line.substr(first, last - first + 1);
+    models.push_back(
+        model.is_absolute() ? model : path.parent_path() / model);
+  }
+  return models;
+}
+
+float readComponent(
+    const unsigned char *data, int componentType, bool normalized)
+{
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE: {
+    int8_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? std::max(value / 127.f, -1.f) : float(value);
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+    uint8_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? value / 255.f : float(value);
+  }
+  case TINYGLTF_COMPONENT_TYPE_SHORT: {
+    int16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? std::max(value / 32767.f, -1.f) : float(value);
+  }
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+    uint16_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return normalized ? value / 65535.f : float(value);
+  }
+  default: {
+    float value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+  }
+}
+
+bool isAccessorInBuffer(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor)
+{
+  if (accessor.sparse.isSparse || accessor.bufferView < 0) {
+    return false;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  if (size_t(bufferView.buffer) >= bufferBytes.size()) {
+    return false;
+  }
+  const auto elementSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+             tinygltf::GetNumComponentsInType(accessor.type));
+  const auto byteStride =
+      bufferView.byteStride ? bufferView.byteStride : elementSize;
+  const auto offset = bufferView.byteOffset + accessor.byteOffset;
+  return !accessor.count ||
+         offset + byteStride * (accessor.count - 1) + elementSize <=
+             bufferBytes[bufferView.buffer].size;
+}
+
+bool readFloatAccessor(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, int accessorIdx,
+    int componentCount, std::vector<float> &values)
+{
+  const auto &accessor = model.accessors[accessorIdx];
+  if ((accessor.bufferView < 0 && !accessor.sparse.isSparse) ||
+      tinygltf::GetNumComponentsInType(accessor.type) != componentCount ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE) {
+    return false;
+  }
+  const auto elementSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType)) *
+      size_t(componentCount);
+  // Elements [0, count) of data to values, at getIndex(i)
+  const auto readElements = [&](const unsigned char *data, size_t byteStride,
+                                size_t count, const auto &getIndex) {
+    return dispatchComponents(accessor.componentType, accessor.normalized, data,
+        byteStride, count, [&](const auto &view) {
+          for (size_t i = 0; i < view.size(); ++i) {
+            auto *element = &values[getIndex(i) * componentCount];
+            for (auto c = 0; c < componentCount; ++c) {
+              element[c] = view(i, size_t(c));
+            }
+          }
+        });
+  };
+  // Sparse accessors without bufferView are zeros before substitution, other
+  // values are all overwritten
+  if (accessor.bufferView < 0) {
+    values.assign(accessor.count * componentCount, 0.f);
+  } else {
+    values.resize(accessor.count * componentCount);
+    const auto &bufferView = model.bufferViews[accessor.bufferView];
+    const auto byteStride =
+        bufferView.byteStride ? bufferView.byteStride : elementSize;
+    const auto data = bufferBytes[bufferView.buffer].data +
+                      bufferView.byteOffset + accessor.byteOffset;
+    if (!readElements(data, byteStride, accessor.count,
+            [](size_t i) { return i; })) {
+      return false;
+    }
+  }
+
+  if (accessor.sparse.isSparse) {
+    const auto &sparse = accessor.sparse;
+    const auto &indexView = model.bufferViews[sparse.indices.bufferView];
+    const auto &valueView = model.bufferViews[sparse.values.bufferView];
+    const auto indexSize = size_t(
+        tinygltf::GetComponentSizeInBytes(sparse.indices.componentType));
+    const auto indices = bufferBytes[indexView.buffer].data +
+                         indexView.byteOffset + sparse.indices.byteOffset;
+    const auto elements = bufferBytes[valueView.buffer].data +
+                          valueView.byteOffset + sparse.values.byteOffset;
+    // Indices are unsigned bytes, shorts or ints, copied as is
+    const auto getIndex = [&](size_t i) {
+      uint32_t index = 0;
+      std::memcpy(&index, indices + indexSize * i, indexSize);
+      return size_t(index);
+    };
+    for (size_t i = 0; i < size_t(sparse.count); ++i) {
+      if (getIndex(i) >= accessor.count) {
+        return false;
+      }
+    }
+    return readElements(
+        elements, elementSize, size_t(sparse.count), getIndex);
+  }
+  return true;
+}
+
+std::vector<BufferBytes> getBufferBytes(const tinygltf::Model &model)
+{
+  std::vector<BufferBytes> bufferBytes(model.buffers.size());
+  for (size_t i = 0; i < model.buffers.size(); ++i) {
+    bufferBytes[i].data = model.buffers[i].data.data();
+    bufferBytes[i].size = model.buffers[i].data.size();
+  }
+  return bufferBytes;
+}
+
+size_t densifySparseAttributes(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  std::vector<int> accessors;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      for (const auto &attribute : primitive.attributes) {
+        accessors.push_back(attribute.second);
+      }
+      accessors.push_back(primitive.indices);
+    }
+  }
+  std::sort(begin(accessors), end(accessors));
+  accessors.erase(
+      std::unique(begin(accessors), end(accessors)), end(accessors));
+
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  size_t accessorCount = 0;
+  for (const auto accessorIdx : accessors) {
+    if (accessorIdx < 0 || !model.accessors[accessorIdx].sparse.isSparse) {
+      continue;
+    }
+    auto &accessor = model.accessors[accessorIdx];
+    const auto &sparse = accessor.sparse;
+    const auto elementSize =
+        size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType)) *
+        size_t(tinygltf::GetNumComponentsInType(accessor.type));
+    const auto indexSize = size_t(
+        tinygltf::GetComponentSizeInBytes(sparse.indices.componentType));
+    // Sparse index and value views, then the base elements if any
+    tinygltf::Accessor indexAccessor;
+    indexAccessor.bufferView = sparse.indices.bufferView;
+    indexAccessor.byteOffset = sparse.indices.byteOffset;
+    indexAccessor.componentType = sparse.indices.componentType;
+    indexAccessor.type = TINYGLTF_TYPE_SCALAR;
+    indexAccessor.count = size_t(sparse.count);
+    tinygltf::Accessor valueAccessor = accessor;
+    valueAccessor.sparse = {};
+    valueAccessor.bufferView = sparse.values.bufferView;
+    valueAccessor.byteOffset = sparse.values.byteOffset;
+    valueAccessor.count = size_t(sparse.count);
+    tinygltf::Accessor baseAccessor = accessor;
+    baseAccessor.sparse = {};
+    size_t indexStride = 0;
+    size_t valueStride = 0;
+    size_t baseStride = 0;
+    const auto indices =
+        getDenseAccessorData(model, bufferBytes, indexAccessor, indexStride);
+    const auto values =
+        getDenseAccessorData(model, bufferBytes, valueAccessor, valueStride);
+    const auto base =
+        accessor.bufferView >= 0
+            ? getDenseAccessorData(model, bufferBytes, baseAccessor, baseStride)
+            : nullptr;
+    if (!elementSize || !indexSize || indexSize > sizeof(uint32_t) ||
+        (sparse.count && (!indices || !values)) ||
+        (accessor.bufferView >= 0 && !base)) {
+      continue;
+    }
+
+    // Vertex attributes are aligned on 4 bytes
+    const auto byteStride = (elementSize + 3) / 4 * 4;
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = (buffer.data.size() + 3) / 4 * 4;
+    bufferView.byteLength = byteStride * accessor.count;
+    bufferView.byteStride = byteStride != elementSize ? byteStride : 0;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength, 0);
+    auto *elements = buffer.data.data() + bufferView.byteOffset;
+    // Substituted elements first, marked so that base ones skip them
+    std::vector<uint8_t> substituted(accessor.count, 0);
+    auto valid = true;
+    for (size_t i = 0; i < size_t(sparse.count) && valid; ++i) {
+      uint32_t index = 0;
+      std::memcpy(&index, indices + indexStride * i, indexSize);
+      valid = index < accessor.count;
+      if (valid) {
+        std::memcpy(elements + byteStride * index, values + valueStride * i,
+            elementSize);
+        substituted[index] = 1;
+      }
+    }
+    if (!valid) {
+      buffer.data.resize(bufferView.byteOffset);
+      continue;
+    }
+    if (base) {
+      for (size_t i = 0; i < accessor.count; ++i) {
+        if (!substituted[i]) {
+          std::memcpy(elements + byteStride * i, base + baseStride * i,
+              elementSize);
+        }
+      }
+    }
+    model.bufferViews.push_back(bufferView);
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.byteOffset = 0;
+    accessor.sparse = {};
+    ++accessorCount;
+  }
+  if (!buffer.data.empty()) {
+    model.buffers.push_back(std::move(buffer));
+    bufferBytes.push_back(
+        {model.buffers.back().data.data(), model.buffers.back().data.size()});
+  }
+  return accessorCount;
+}
+
+size_t computeIndexRanges(tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes)
+{
+  // Each index accessor is scanned once, whatever the primitives sharing it
+  std::vector<uint8_t> scanned(model.accessors.size(), 0);
+  std::vector<uint8_t> invalid(model.accessors.size(), 0);
+  size_t invalidPrimitiveCount = 0;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.indices < 0) {
+        continue;
+      }
+      auto &accessor = model.accessors[primitive.indices];
+      if (!scanned[primitive.indices]) {
+        scanned[primitive.indices] = 1;
+        accessor.minValues.clear();
+        accessor.maxValues.clear();
+        auto minIndex = std::numeric_limits<uint32_t>::max();
+        uint32_t maxIndex = 0;
+        const auto read = dispatchIndices(
+            model, bufferBytes, accessor, [&](const auto &view) {
+              for (size_t i = 0; i < view.size(); ++i) {
+                const auto index = uint32_t(view.raw(i));
+                minIndex = std::min(minIndex, index);
+                maxIndex = std::max(maxIndex, index);
+              }
+            });
+        if (read && accessor.count) {
+          accessor.minValues = {double(minIndex)};
+          accessor.maxValues = {double(maxIndex)};
+        }
+      }
+      const auto position = primitive.attributes.find("POSITION");
+      const auto vertexCount = position == end(primitive.attributes)
+                                   ? size_t(0)
+                                   : model.accessors[position->second].count;
+      if (accessor.maxValues.size() == 1 &&
+          accessor.maxValues[0] >= double(vertexCount)) {
+        ++invalidPrimitiveCount;
+        invalid[primitive.indices] = 1;
+      }
+    }
+  }
+  for (size_t i = 0; i < model.accessors.size(); ++i) {
+    if (invalid[i]) {
+      model.accessors[i].minValues.clear();
+      model.accessors[i].maxValues.clear();
+    }
+  }
+  return invalidPrimitiveCount;
+}
+
+void releaseBufferData(tinygltf::Model &model)
+{
+  // swap() with an empty vector, clear() would keep the capacity
+  for (auto &buffer : model.buffers) {
+    std::vector<unsigned char>().swap(buffer.data);
+  }
+}
+
+void releaseImageData(tinygltf::Image &image)
+{
+  std::vector<unsigned char>().swap(image.image);
+}
+
+void releaseMaterialData(tinygltf::Model &model)
+{
+  std::vector<tinygltf::Material>().swap(model.materials);
+}
+
+bool storeEncodedImage(tinygltf::Image *image, const int /*imageIdx*/,
+    std::string * /*err*/, std::string * /*warn*/, int /*reqWidth*/,
+    int /*reqHeight*/, const unsigned char *bytes, int size,
+    void * /*userData*/)
+{
+  image->image.assign(bytes, bytes + size);
+  image->as_is = true;
+  return true;
+}
+
+bool loadImageData(tinygltf::Image *image, const int imageIdx,
+    std::string *err, std::string *warn, int reqWidth, int reqHeight,
+    const unsigned char *bytes, int size, void *userData)
+{
+  if (isKtx2Data(bytes, size_t(size))) {
+    return storeEncodedImage(image, imageIdx, err, warn, reqWidth, reqHeight,
+        bytes, size, userData);
+  }
+  return tinygltf::LoadImageData(image, imageIdx, err, warn, reqWidth,
+      reqHeight, bytes, size, userData);
+}
+
+bool isKtx2Image(const tinygltf::Image &image)
+{
+  return image.as_is && isKtx2Data(image.image.data(), image.image.size());
+}
+
+bool isJpegImage(const tinygltf::Image &image)
+{
+  // Start of image marker, then the marker of the first segment
+  const auto &bytes = image.image;
+  return image.as_is && bytes.size() >= 3 && bytes[0] == 0xFF &&
+         bytes[1] == 0xD8 && bytes[2] == 0xFF;
+}
+
+int getBasisuImageSource(const tinygltf::Texture &texture)
+{
+  const auto it = texture.extensions.find("KHR_texture_basisu");
+  if (it == end(texture.extensions) || !it->second.Has("source")) {
+    return -1;
+  }
+  return it->second.Get("source").Get<int>();
+}
+
+std::vector<ImageUsage> getImageUsages(const tinygltf::Model &model)
+{
+  std::vector<bool> colorTextures(model.textures.size(), false);
+  std::vector<int> textureChannels(model.textures.size(), 0);
+  const auto readChannels = [&](int textureIdx, int channels) {
+    if (textureIdx >= 0 && size_t(textureIdx) < textureChannels.size()) {
+      textureChannels[textureIdx] =
+          std::max(textureChannels[textureIdx], channels);
+    }
+  };
+  for (const auto &material : model.materials) {
+    for (const auto textureIdx :
+        {material.pbrMetallicRoughness.baseColorTexture.index,
+            material.emissiveTexture.index}) {
+      if (textureIdx >= 0 && size_t(textureIdx) < colorTextures.size()) {
+        colorTextures[textureIdx] = true;
+      }
+      readChannels(textureIdx, 4);
+    }
+    readChannels(material.pbrMetallicRoughness.metallicRoughnessTexture.index,
+        4);
+    readChannels(material.occlusionTexture.index, 1);
+    readChannels(material.normalTexture.index, 2);
+  }
+  std::vector<ImageUsage> usages(model.images.size());
+  for (size_t i = 0; i < model.textures.size(); ++i) {
+    const auto &texture = model.textures[i];
+    const auto minFilter =
+        texture.sampler >= 0 ? model.samplers[texture.sampler].minFilter : -1;
+    for (const auto source : {getBasisuImageSource(texture), texture.source}) {
+      if (source >= 0 && size_t(source) < usages.size()) {
+        auto &usage = usages[source];
+        usage.sampled = true;
+        usage.generateMipmaps =
+            usage.generateMipmaps ||
+            minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST ||
+            minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR ||
+            minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST ||
+            minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+        usage.color = usage.color || colorTextures[i];
+        usage.channels = std::max(
+            usage.channels, textureChannels[i] ? textureChannels[i] : 4);
+      }
+    }
+  }
+  return usages;
+}
+
+
+bool decodeImage(tinygltf::Image &image, int imageIdx, std::string &err)
+{
+  if (!image.as_is || isKtx2Image(image)) {
+    return true;
+  }
+  std::vector<unsigned char> encoded;
+  encoded.swap(image.image);
+  image.as_is = false;
+  // tinygltf default decoder, stb_image is thread safe
+  return tinygltf::LoadImageData(&image, imageIdx, &err, nullptr, image.width,
+      image.height, encoded.data(), int(encoded.size()), nullptr);
+}
+
+bool decodeImages(
+    tinygltf::Model &model, std::string &err, bool keepJpegImages)
+{
+  std::vector<std::string> errors(model.images.size());
+  parallelFor(model.images.size(), [&](size_t i) {
+    if (!keepJpegImages || !isJpegImage(model.images[i])) {
+      decodeImage(model.images[i], int(i), errors[i]);
+    }
+  });
+
+  auto result = true;
+  for (const auto &imageError : errors) {
+    if (!imageError.empty()) {
+      err += imageError;
+      result = false;
+    }
+  }
+  return result;
+}
+
+bool getGlbBinChunk(
+    const unsigned char *glbData, size_t glbSize, BufferBytes &binChunk)
+{
+  // https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#glb-file-format-specification
+  // 12 bytes header, then chunks made of a length, a type and the data
+  const auto readUint32 = [&](size_t offset) {
+    uint32_t value;
+    std::memcpy(&value, glbData + offset, sizeof(value));
+    return value;
+  };
+  if (glbSize < 20) {
+    return false;
+  }
+  const size_t jsonChunkLength = readUint32(12);
+  const size_t binChunkOffset = 20 + jsonChunkLength;
+  if (binChunkOffset + 8 > glbSize ||
+      readUint32(binChunkOffset + 4) != 0x004E4942) { // "BIN\0"
+    return false;
+  }
+  binChunk.data = glbData + binChunkOffset + 8;
+  binChunk.size = std::min(
+      size_t(readUint32(binChunkOffset)), glbSize - binChunkOffset - 8);
+  return true;
+}
+
+bool differOnlyInNodeTransforms(
+    const tinygltf::Model &a, const tinygltf::Model &b)
+{
+  if (a.nodes.size() != b.nodes.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.nodes.size(); ++i) {
+    auto nodeA = a.nodes[i];
+    auto nodeB = b.nodes[i];
+    for (auto *node : {&nodeA, &nodeB}) {
+      node->translation.clear();
+      node->rotation.clear();
+      node->scale.clear();
+      node->matrix.clear();
+    }
+    if (!(nodeA == nodeB)) {
+      return false;
+    }
+  }
+  return a.accessors == b.accessors && a.animations == b.animations &&
+         a.buffers == b.buffers && a.bufferViews == b.bufferViews &&
+         a.materials == b.materials && a.meshes == b.meshes &&
+         a.textures == b.textures && a.images == b.images &&
+         a.skins == b.skins && a.samplers == b.samplers &&
+         a.cameras == b.cameras && a.scenes == b.scenes &&
+         a.lights == b.lights && a.defaultScene == b.defaultScene &&
+         a.extensionsUsed == b.extensionsUsed &&
+         a.extensionsRequired == b.extensionsRequired &&
+         a.extensions == b.extensions;
+}
 
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix)
@@ -37,117 +576,242 @@ glm::mat4 getLocalToWorldMatrix(
 
 void computeSceneBounds(
     const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax)
+{
+  computeSceneBounds(model, getBufferBytes(model), bboxMin, bboxMax);
+}
+
+namespace {
+
+// Part of the vertices of a primitive whose bounds must be computed, see
+// computeSceneBounds
+struct VertexScanRange
+{
+  const glm::mat4 *matrix;
+  const unsigned char *positions;
+  size_t positionByteStride;
+  size_t vertexCount;
+  int positionComponentType; // Read by the kernels if float, else quantized
+  bool normalized;
+  const unsigned char *indices; // nullptr for non indexed primitives
+  int indexComponentType;
+  size_t indexSize;
+  size_t indexByteStride;
+  size_t begin;
+  size_t end;
+};
+
+// Vertices (or indices) per range, so that large primitives are spread over
+// threads too
+const size_t VERTEX_SCAN_RANGE_SIZE = 1 << 16;
+
+// Integer values of a normalized accessor mapped as readComponent does
+glm::vec3 normalizeComponents(const glm::vec3 &values, int componentType)
+{
+  switch (componentType) {
+  case TINYGLTF_COMPONENT_TYPE_BYTE:
+    return glm::max(values / 127.f, glm::vec3(-1));
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+    return values / 255.f;
+  case TINYGLTF_COMPONENT_TYPE_SHORT:
+    return glm::max(values / 32767.f, glm::vec3(-1));
+  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+    return values / 65535.f;
+  default:
+    return values;
+  }
+}
+
+// Bounds of matrix * positions[getIndex(i)] for i in [0, count). For quantized
+// positions, float ones go through the kernels of vertex_kernels.hpp.
+template <typename Positions, typename GetIndex>
+BoundingBox transformViewBounds(const Positions &positions, size_t count,
+    const glm::mat4 &matrix, const GetIndex &getIndex)
+{
+  BoundingBox bounds;
+  for (size_t i = 0; i < count; ++i) {
+    bounds.extend(glm::vec3(
+        matrix * glm::vec4(positions.template get<3>(getIndex(i)), 1.f)));
+  }
+  return bounds;
+}
+
+// Bounds of the vertices of a range of quantized positions
+BoundingBox computeQuantizedRangeBounds(const VertexScanRange &range)
+{
+  BoundingBox bounds;
+  dispatchComponents(range.positionComponentType, range.normalized,
+      range.positions, range.positionByteStride, range.vertexCount,
+      [&](const auto &positions) {
+        const auto count = range.end - range.begin;
+        if (!range.indices) {
+          bounds = transformViewBounds(positions, count, *range.matrix,
+              [&](size_t i) { return range.begin + i; });
+          return;
+        }
+        dispatchIndexComponents(range.indexComponentType,
+            range.indices + range.indexByteStride * range.begin,
+            range.indexByteStride, count, [&](const auto &indices) {
+              bounds = transformViewBounds(positions, count, *range.matrix,
+                  [&](size_t i) { return size_t(indices.raw(i)); });
+            });
+      });
+  return bounds;
+}
+
+} // namespace
+
+void computeSceneBounds(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, glm::vec3 &bboxMin,
+    glm::vec3 &bboxMax)
 {
   // Compute scene bounding box
-  // todo refactor with scene drawing
-  // todo need a visitScene generic function that takes a accept() functor
-  bboxMin = glm::vec3(std::numeric_limits<float>::max());
-  bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
-  if (model.defaultScene >= 0) {
-    const std::function<void(int, const glm::mat4 &)> updateBounds =
-        [&](int nodeIdx, const glm::mat4 &parentMatrix) {
-          const auto &node = model.nodes[nodeIdx];
-          const glm::mat4 modelMatrix =
-              getLocalToWorldMatrix(node, parentMatrix);
-          if (node.mesh >= 0) {
-            const auto &mesh = model.meshes[node.mesh];
-            for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
-              const auto &primitive = mesh.primitives[pIdx];
-              const auto positionAttrIdxIt =
-                  primitive.attributes.find("POSITION");
-              if (positionAttrIdxIt == end(primitive.attributes)) {
-                continue;
-              }
-              const auto &positionAccessor =
-                  model.accessors[(*positionAttrIdxIt).second];
-              if (positionAccessor.type != 3) {
-                std::cerr << "Position accessor with type != VEC3, skipping"
-                          << std::endl;
-                continue;
-              }
-              const auto &positionBufferView =
-                  model.bufferViews[positionAccessor.bufferView];
-              const auto byteOffset =
-                  positionAccessor.byteOffset + positionBufferView.byteOffset;
-              const auto &positionBuffer =
-                  model.buffers[positionBufferView.buffer];
-              const auto positionByteStride =
-                  positionBufferView.byteStride ? positionBufferView.byteStride
-                                                : 3 * sizeof(float);
-
-              if (primitive.indices >= 0) {
-                const auto &indexAccessor = model.accessors[primitive.indices];
-                const auto &indexBufferView =
-                    model.bufferViews[indexAccessor.bufferView];
-                const auto indexByteOffset =
-                    indexAccessor.byteOffset + indexBufferView.byteOffset;
-                const auto &indexBuffer = model.buffers[indexBufferView.buffer];
-                auto indexByteStride = indexBufferView.byteStride;
-
-                switch (indexAccessor.componentType) {
-                default:
-                  std::cerr
-                      << "Primitive index accessor with bad componentType "
-                      << indexAccessor.componentType << ", skipping it."
-                      << std::endl;
-                  continue;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint8_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint16_t);
-                  break;
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                  indexByteStride =
-                      indexByteStride ? indexByteStride : sizeof(uint32_t);
-                  break;
-                }
-
-                for (size_t i = 0; i < indexAccessor.count; ++i) {
-                  uint32_t index = 0;
-                  switch (indexAccessor.componentType) {
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                    index = *((const uint8_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    index = *((const uint16_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    index = *((const uint32_t *)&indexBuffer
-                                  .data[indexByteOffset + indexByteStride * i]);
-                    break;
-                  }
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * index]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              } else {
-                for (size_t i = 0; i < positionAccessor.count; ++i) {
-                  const auto &localPosition =
-                      *((const glm::vec3 *)&positionBuffer
-                              .data[byteOffset + positionByteStride * i]);
-                  const auto worldPosition =
-                      glm::vec3(modelMatrix * glm::vec4(localPosition, 1.f));
-                  bboxMin = glm::min(bboxMin, worldPosition);
-                  bboxMax = glm::max(bboxMax, worldPosition);
-                }
-              }
-            }
-          }
-          for (const auto childNodeIdx : node.children) {
-            updateBounds(childNodeIdx, modelMatrix);
-          }
-        };
-    for (const auto nodeIdx : model.scenes[model.defaultScene].nodes) {
-      updateBounds(nodeIdx, glm::mat4(1));
+  BoundingBox sceneBounds;
+  std::vector<VertexScanRange> scanRanges;
+  const auto scene = flattenScene(model, model.defaultScene, bufferBytes);
+  for (size_t n = 0; n < scene.size(); ++n) {
+    if (scene.meshes[n] < 0) {
+      continue;
+    }
+    const auto &modelMatrix = scene.worldMatrices[n];
+    const auto &mesh = model.meshes[scene.meshes[n]];
+    for (size_t pIdx = 0; pIdx < mesh.primitives.size(); ++pIdx) {
+      const auto &primitive = mesh.primitives[pIdx];
+      const auto positionAttrIdxIt = primitive.attributes.find("POSITION");
+      if (positionAttrIdxIt == end(primitive.attributes)) {
+        continue;
+      }
+      const auto &positionAccessor =
+          model.accessors[(*positionAttrIdxIt).second];
+      if (positionAccessor.type != 3) {
+        std::cerr << "Position accessor with type != VEC3, skipping"
+                  << std::endl;
+        continue;
+      }
+
+      // glTF requires min and max on POSITION accessors: transforming their
+      // box is enough, vertices are only read for files lacking them
+      if (positionAccessor.minValues.size() == 3 &&
+          positionAccessor.maxValues.size() == 3) {
+        sceneBounds.extend(transformBoundingBox(
+            getPrimitiveBounds(model, primitive, bufferBytes), modelMatrix));
+        continue;
+      }
+
+      const auto &positionBufferView =
+          model.bufferViews[positionAccessor.bufferView];
+      VertexScanRange range = {};
+      range.matrix = &modelMatrix;
+      range.positions = bufferBytes[positionBufferView.buffer].data +
+                        positionAccessor.byteOffset +
+                        positionBufferView.byteOffset;
+      range.positionByteStride =
+          positionBufferView.byteStride
+              ? positionBufferView.byteStride
+              : 3 * size_t(tinygltf::GetComponentSizeInBytes(
+                        positionAccessor.componentType));
+      range.vertexCount = positionAccessor.count;
+      range.positionComponentType = positionAccessor.componentType;
+      range.normalized = positionAccessor.normalized;
+      auto count = positionAccessor.count;
+
+      if (primitive.indices >= 0) {
+        const auto &indexAccessor = model.accessors[primitive.indices];
+        const auto &indexBufferView =
+            model.bufferViews[indexAccessor.bufferView];
+        switch (indexAccessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+          range.indexSize = sizeof(uint8_t);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+          range.indexSize = sizeof(uint16_t);
+          break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+          range.indexSize = sizeof(uint32_t);
+          break;
+        default:
+          std::cerr << "Primitive index accessor with bad componentType "
+                    << indexAccessor.componentType << ", skipping it."
+                    << std::endl;
+          continue;
+        }
+        range.indexComponentType = indexAccessor.componentType;
+        range.indices = bufferBytes[indexBufferView.buffer].data +
+                        indexAccessor.byteOffset + indexBufferView.byteOffset;
+        range.indexByteStride = indexBufferView.byteStride
+                                    ? indexBufferView.byteStride
+                                    : range.indexSize;
+        count = indexAccessor.count;
+      }
+
+      for (size_t begin = 0; begin < count; begin += VERTEX_SCAN_RANGE_SIZE) {
+        range.begin = begin;
+        range.end = std::min(begin + VERTEX_SCAN_RANGE_SIZE, count);
+        scanRanges.push_back(range);
+      }
+    }
+  }
+
+  // Vertices of primitives lacking min/max, scanned on all hardware threads
+  std::vector<BoundingBox> rangeBounds(scanRanges.size());
+  parallelFor(scanRanges.size(), [&](size_t i) {
+    const auto &range = scanRanges[i];
+    if (range.positionComponentType != TINYGLTF_COMPONENT_TYPE_FLOAT) {
+      rangeBounds[i] = computeQuantizedRangeBounds(range);
+    } else if (range.indices) {
+      rangeBounds[i] = computeIndexedTransformedBounds(range.positions,
+          range.positionByteStride,
+          range.indices + range.indexByteStride * range.begin,
+          range.indexSize, range.indexByteStride, range.end - range.begin,
+          *range.matrix);
+    } else {
+      rangeBounds[i] = computeTransformedBounds(
+          range.positions + range.positionByteStride * range.begin,
+          range.positionByteStride, range.end - range.begin, *range.matrix);
     }
+  });
+  for (const auto &bounds : rangeBounds) {
+    sceneBounds.extend(bounds);
   }
-}
\ No newline at end of file
+  bboxMin = sceneBounds.min;
+  bboxMax = sceneBounds.max;
+}
+
+BoundingBox getPrimitiveBounds(const tinygltf::Model &model,
+    const tinygltf::Primitive &primitive,
+    const std::vector<BufferBytes> &bufferBytes)
+{
+  BoundingBox bounds;
+  const auto positionAttrIdxIt = primitive.attributes.find("POSITION");
+  if (positionAttrIdxIt == end(primitive.attributes)) {
+    return bounds;
+  }
+  const auto &accessor = model.accessors[(*positionAttrIdxIt).second];
+  if (accessor.type != TINYGLTF_TYPE_VEC3) {
+    return bounds;
+  }
+  if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3) {
+    bounds.min = glm::vec3(accessor.minValues[0], accessor.minValues[1],
+        accessor.minValues[2]);
+    bounds.max = glm::vec3(accessor.maxValues[0], accessor.maxValues[1],
+        accessor.maxValues[2]);
+    // min and max are the values stored in the buffer, even when normalized
+    if (accessor.normalized) {
+      bounds.min = normalizeComponents(bounds.min, accessor.componentType);
+      bounds.max = normalizeComponents(bounds.max, accessor.componentType);
+    }
+    return bounds;
+  }
+  size_t byteStride = 0;
+  const auto data =
+      getDenseAccessorData(model, bufferBytes, accessor, byteStride);
+  if (data && accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+    return computeTransformedBounds(
+        data, byteStride, accessor.count, glm::mat4(1));
+  }
+  dispatchAccessor(model, bufferBytes, accessor, [&](const auto &positions) {
+    for (size_t i = 0; i < positions.size(); ++i) {
+      bounds.extend(positions.template get<3>(i));
+    }
+  });
+  return bounds;
+}
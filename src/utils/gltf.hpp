@@ -1,10 +1,157 @@
 #pragma once
 
+#include "bounds.hpp"
+#include "filesystem.hpp"
+
 #include <glm/glm.hpp>
 #include <tiny_gltf.h>
 
+// Returns true if the file starts with the binary glTF magic ("glTF"), ie. it
+// is a .glb container whatever its extension
+bool isBinaryGltfFile(const fs::path &path);
+
+// Files of a list of models, one path per line, relative to the directory of
+// the list unless absolute. Empty lines and lines starting with # are
+// skipped. Throws if the list cannot be read.
+std::vector<fs::path> loadModelList(const fs::path &path);
+
+// View on the bytes of a glTF buffer. By default it points to
+// tinygltf::Buffer::data, but it can also point into a memory mapping of the
+// file containing the buffer.
+struct BufferBytes
+{
+  const unsigned char *data = nullptr;
+  size_t size = 0;
+};
+
+std::vector<BufferBytes> getBufferBytes(const tinygltf::Model &model);
+
+// Value of a component of an accessor as a float. Integers of normalized
+// accessors are mapped to [0, 1] or [-1, 1] as glTF specifies, others are
+// converted as they are (KHR_mesh_quantization).
+float readComponent(
+    const unsigned char *data, int componentType, bool normalized);
+
+// Read the elements of an accessor with componentCount float or 8/16 bits
+// integer components, one after the other in values. Sparse accessors have
+// their substituted elements applied. Returns false for other accessors.
+bool readFloatAccessor(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, int accessorIdx,
+    int componentCount, std::vector<float> &values);
+
+// True if the elements of a dense accessor are all in its buffer in
+// bufferBytes, which may have been released (--release-cpu-data)
+bool isAccessorInBuffer(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor);
+
+// Rewrite the sparse accessors of the attributes and indices of primitives as
+// dense ones, in their own component type, so that vertex arrays and the
+// passes reading dense accessors see the substituted values. Each element is
+// copied once, from the substitutions or from the base bufferView (zeros
+// without one). Elements are written in a new buffer appended to
+// model.buffers, whose bytes are appended to bufferBytes. Sparse accessors
+// of morph targets are left as they are, see SkinningPrepass. Returns the
+// number of accessors rewritten, those out of their buffers are left sparse.
+size_t densifySparseAttributes(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
+
+// Set the min and max of the index accessors of primitives to the range of
+// the vertices their indices reference, for glDrawRangeElements. Stored by
+// the scene cache, later runs do not scan indices again. Values of the file
+// are replaced: they are optional, and transforms of the meshes may have
+// made them stale. Accessors whose indices reference vertices past those of
+// a primitive are left without min and max, returns the number of such
+// primitives.
+size_t computeIndexRanges(tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes);
+
+// Free the content of buffers or of a decoded image, keeping only their
+// metadata. To be called once they are resident on the GPU
+void releaseBufferData(tinygltf::Model &model);
+
+void releaseImageData(tinygltf::Image &image);
+
+// Free the materials of the model, once read by buildRuntimeScene. Primitives
+// keep their material indices.
+void releaseMaterialData(tinygltf::Model &model);
+
+// Image loader for tinygltf::TinyGLTF::SetImageLoader that keeps the encoded
+// bytes in image.image (with image.as_is = true) instead of decoding them
+// during parsing. Use decodeImages() afterwards.
+bool storeEncodedImage(tinygltf::Image *image, const int imageIdx,
+    std::string *err, std::string *warn, int reqWidth, int reqHeight,
+    const unsigned char *bytes, int size, void *userData);
+
+// Default image loader: decode with tinygltf, except KTX2 files which are kept
+// as they are by storeEncodedImage for TextureUploader::createCompressedTexture
+bool loadImageData(tinygltf::Image *image, const int imageIdx,
+    std::string *err, std::string *warn, int reqWidth, int reqHeight,
+    const unsigned char *bytes, int size, void *userData);
+
+// True if the image holds a KTX2 file, these are never decoded on the CPU
+bool isKtx2Image(const tinygltf::Image &image);
+
+// True if the image still holds a JPEG file (see storeEncodedImage)
+bool isJpegImage(const tinygltf::Image &image);
+
+// Image of a texture with the KHR_texture_basisu extension, -1 if the texture
+// does not use it. texture.source is then an optional fallback image.
+int getBasisuImageSource(const tinygltf::Texture &texture);
+
+// How the textures of a model sample one of its images
+struct ImageUsage
+{
+  bool sampled = false; // By a texture, as its source or KHR_texture_basisu
+  bool generateMipmaps = false; // A sampler of its textures reads mipmaps
+  // A material reads it as a color (base color or emissive), stored in sRGB,
+  // rather than as data. An image read as both is a color.
+  bool color = false;
+  // First channels its textures read: 1 if only read as occlusion (red), 2
+  // if also as normal map (red and green, blue is derived from them), 4
+  // otherwise, also for textures no core material slot reads
+  int channels = 0;
+};
+
+std::vector<ImageUsage> getImageUsages(const tinygltf::Model &model);
+
+// Decode an image kept encoded by storeEncodedImage, does nothing if the image
+// is already decoded or is a KTX2 file. Returns false on failure, with the reason in err.
+bool decodeImage(tinygltf::Image &image, int imageIdx, std::string &err);
+
+// Decode, on all hardware threads, the images kept encoded by
+// storeEncodedImage. Decoded images match what tinygltf would have produced.
+// With keepJpegImages, JPEG files stay encoded for the GPU to decode them
+// (see GpuJpegDecoder). Returns false if some image could not be decoded,
+// with reasons in err.
+bool decodeImages(
+    tinygltf::Model &model, std::string &err, bool keepJpegImages = false);
+
+// Locate the BIN chunk of a .glb file loaded in memory. Returns false if the
+// file has no BIN chunk
+bool getGlbBinChunk(
+    const unsigned char *glbData, size_t glbSize, BufferBytes &binChunk);
+
+// True if the models are equal but for the translation, rotation, scale and
+// matrix of their nodes, say a file saved again after moving nodes
+bool differOnlyInNodeTransforms(
+    const tinygltf::Model &a, const tinygltf::Model &b);
+
 glm::mat4 getLocalToWorldMatrix(
     const tinygltf::Node &node, const glm::mat4 &parentMatrix);
 
 void computeSceneBounds(
-    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
\ No newline at end of file
+    const tinygltf::Model &model, glm::vec3 &bboxMin, glm::vec3 &bboxMax);
+
+// Same, reading buffer content from bufferBytes instead of model.buffers
+void computeSceneBounds(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, glm::vec3 &bboxMin,
+    glm::vec3 &bboxMax);
+
+// Bounds of the POSITION attribute of a primitive, in the space of its mesh.
+// Read from the min/max of the accessor, which glTF requires, or computed
+// from the vertices read in bufferBytes if the file does not have them.
+// Returns an empty box for primitives without positions.
+BoundingBox getPrimitiveBounds(const tinygltf::Model &model,
+    const tinygltf::Primitive &primitive,
+    const std::vector<BufferBytes> &bufferBytes);
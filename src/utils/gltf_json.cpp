@@ -0,0 +1,1093 @@
+#include "gltf_json.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Deeper values are left to tinygltf rather than risking the stack
+const int MAX_DEPTH = 256;
+
+const char *const MESHOPT_EXTENSION = "EXT_meshopt_compression";
+
+// Uri given to the fallback buffers of EXT_meshopt_compression in the
+// documents parsed by tinygltf, read as 1 byte by the callbacks of
+// loadGltfDocument
+const char *const MESHOPT_FALLBACK_URI = "gltf-viewer-meshopt-fallback.bin";
+
+// What parseGltfJsonArrays leaves to tinygltf
+class JsonError : public std::runtime_error
+{
+public:
+  using std::runtime_error::runtime_error;
+};
+
+struct JsonNumber
+{
+  // Of an integer literal that fits an int64_t, or a uint64_t if positive,
+  // which nlohmann::json then stores as an integer
+  bool isInteger = false;
+  bool isNegative = false;
+  uint64_t magnitude = 0;
+  double value = 0;
+
+  // As tinygltf's GetInt casts it
+  int toInt() const
+  {
+    return int(int64_t(isNegative ? uint64_t(0) - magnitude : magnitude));
+  }
+};
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+void appendUtf8(std::string &s, uint32_t code)
+{
+  if (code < 0x80) {
+    s += char(code);
+  } else if (code < 0x800) {
+    s += char(0xC0 | (code >> 6));
+    s += char(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    s += char(0xE0 | (code >> 12));
+    s += char(0x80 | ((code >> 6) & 0x3F));
+    s += char(0x80 | (code & 0x3F));
+  } else {
+    s += char(0xF0 | (code >> 18));
+    s += char(0x80 | ((code >> 12) & 0x3F));
+    s += char(0x80 | ((code >> 6) & 0x3F));
+    s += char(0x80 | (code & 0x3F));
+  }
+}
+
+// Reads JSON values in place, throwing a JsonError on anything else
+class JsonReader
+{
+public:
+  JsonReader(const char *begin, const char *end) :
+      m_begin(begin), m_p(begin), m_end(end)
+  {
+    // nlohmann::json skips a UTF-8 byte order mark as well
+    if (m_end - m_p >= 3 && std::memcmp(m_p, "\xEF\xBB\xBF", 3) == 0) {
+      m_p += 3;
+    }
+  }
+
+  size_t offset() const { return size_t(m_p - m_begin); }
+
+  [[noreturn]] void fail(const std::string &what) const
+  {
+    throw JsonError(what + " at offset " + std::to_string(offset()));
+  }
+
+  // Next character after whitespace, 0 at the end of the text
+  char peek()
+  {
+    while (m_p != m_end &&
+           (*m_p == ' ' || *m_p == '\n' || *m_p == '\r' || *m_p == '\t')) {
+      ++m_p;
+    }
+    return m_p != m_end ? *m_p : '\0';
+  }
+
+  bool atEnd()
+  {
+    peek();
+    return m_p == m_end;
+  }
+
+  void expect(char c)
+  {
+    if (atEnd() || *m_p != c) {
+      fail(std::string("expected '") + c + "'");
+    }
+    ++m_p;
+  }
+
+  // Call member(key) for each member of an object, which reads its value
+  template <typename F>
+  void readObject(F &&member)
+  {
+    expect('{');
+    if (peek() == '}') {
+      ++m_p;
+      return;
+    }
+    std::string key;
+    for (;;) {
+      readString(key);
+      expect(':');
+      member(key);
+      if (peek() != ',') {
+        break;
+      }
+      ++m_p;
+    }
+    expect('}');
+  }
+
+  // Call element() for each element of an array, which reads it
+  template <typename F>
+  void readArray(F &&element)
+  {
+    expect('[');
+    if (peek() == ']') {
+      ++m_p;
+      return;
+    }
+    for (;;) {
+      element();
+      if (peek() != ',') {
+        break;
+      }
+      ++m_p;
+    }
+    expect(']');
+  }
+
+  void readString(std::string &s)
+  {
+    expect('"');
+    s.clear();
+    for (;;) {
+      const auto start = m_p;
+      while (m_p != m_end && *m_p != '"' && *m_p != '\\' &&
+             (unsigned char)(*m_p) >= 0x20) {
+        ++m_p;
+      }
+      s.append(start, m_p);
+      if (m_p == m_end || (unsigned char)(*m_p) < 0x20) {
+        fail("unterminated string");
+      }
+      if (*m_p++ == '"') {
+        return;
+      }
+      readEscape(s);
+    }
+  }
+
+  std::string readString()
+  {
+    std::string s;
+    readString(s);
+    return s;
+  }
+
+  bool readBool()
+  {
+    peek();
+    if (readLiteral("true")) {
+      return true;
+    }
+    if (!readLiteral("false")) {
+      fail("expected a boolean");
+    }
+    return false;
+  }
+
+  JsonNumber readNumber()
+  {
+    peek();
+    const auto start = m_p;
+    JsonNumber number;
+    if (m_p != m_end && *m_p == '-') {
+      number.isNegative = true;
+      ++m_p;
+    }
+    const auto digits = m_p;
+    auto overflow = false;
+    for (; m_p != m_end && isDigit(*m_p); ++m_p) {
+      const auto digit = uint64_t(*m_p - '0');
+      if (number.magnitude >
+          (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+        overflow = true;
+      }
+      number.magnitude = number.magnitude * 10 + digit;
+    }
+    if (m_p == digits || (*digits == '0' && m_p - digits > 1)) {
+      fail("invalid number");
+    }
+    auto isInteger = true;
+    if (m_p != m_end && *m_p == '.') {
+      isInteger = false;
+      readDigits();
+    }
+    if (m_p != m_end && (*m_p == 'e' || *m_p == 'E')) {
+      isInteger = false;
+      if (m_p + 1 != m_end && (m_p[1] == '+' || m_p[1] == '-')) {
+        ++m_p;
+      }
+      readDigits();
+    }
+    number.isInteger =
+        isInteger && !overflow &&
+        (!number.isNegative || number.magnitude <= uint64_t(1) << 63);
+    if (number.isInteger) {
+      number.value = number.isNegative ? -double(number.magnitude)
+                                       : double(number.magnitude);
+    } else {
+      // Correctly rounded, as the strtod of nlohmann::json
+      const auto result = std::from_chars(start, m_p, number.value);
+      if (result.ec != std::errc() || result.ptr != m_p) {
+        fail("number out of range");
+      }
+    }
+    return number;
+  }
+
+  int readInt()
+  {
+    const auto number = readNumber();
+    if (!number.isInteger) {
+      fail("expected an integer");
+    }
+    return number.toInt();
+  }
+
+  size_t readUnsigned()
+  {
+    const auto number = readNumber();
+    if (!number.isInteger || number.isNegative) {
+      fail("expected a positive integer");
+    }
+    return size_t(number.magnitude);
+  }
+
+  void readNumbers(std::vector<double> &values)
+  {
+    values.clear();
+    readArray([&]() { values.push_back(readNumber().value); });
+  }
+
+  void readInts(std::vector<int> &values)
+  {
+    values.clear();
+    readArray([&]() { values.push_back(readInt()); });
+  }
+
+  // A value as tinygltf's ParseJsonAsValue converts it: nulls are dropped
+  // from objects and arrays, and empty ones are null
+  tinygltf::Value readValue(int depth = 0)
+  {
+    if (depth > MAX_DEPTH) {
+      fail("too deep value");
+    }
+    switch (peek()) {
+    case '{': {
+      tinygltf::Value::Object object;
+      readObject([&](const std::string &key) {
+        auto entry = readValue(depth + 1);
+        // Like nlohmann::json, the last of duplicated keys wins
+        if (entry.Type() != tinygltf::NULL_TYPE) {
+          object[key] = std::move(entry);
+        } else {
+          object.erase(key);
+        }
+      });
+      return object.empty() ? tinygltf::Value()
+                            : tinygltf::Value(std::move(object));
+    }
+    case '[': {
+      tinygltf::Value::Array array;
+      readArray([&]() {
+        auto entry = readValue(depth + 1);
+        if (entry.Type() != tinygltf::NULL_TYPE) {
+          array.push_back(std::move(entry));
+        }
+      });
+      return array.empty() ? tinygltf::Value()
+                           : tinygltf::Value(std::move(array));
+    }
+    case '"':
+      return tinygltf::Value(readString());
+    case 't':
+    case 'f':
+      return tinygltf::Value(readBool());
+    case 'n':
+      if (!readLiteral("null")) {
+        fail("invalid literal");
+      }
+      return tinygltf::Value();
+    default: {
+      const auto number = readNumber();
+      return number.isInteger ? tinygltf::Value(number.toInt())
+                              : tinygltf::Value(number.value);
+    }
+    }
+  }
+
+  // Skip a value without storing it, strings are not decoded
+  void skipValue(int depth = 0)
+  {
+    if (depth > MAX_DEPTH) {
+      fail("too deep value");
+    }
+    switch (peek()) {
+    case '{':
+      ++m_p;
+      if (peek() == '}') {
+        ++m_p;
+        return;
+      }
+      for (;;) {
+        skipString();
+        expect(':');
+        skipValue(depth + 1);
+        if (peek() != ',') {
+          break;
+        }
+        ++m_p;
+      }
+      expect('}');
+      return;
+    case '[':
+      ++m_p;
+      if (peek() == ']') {
+        ++m_p;
+        return;
+      }
+      for (;;) {
+        skipValue(depth + 1);
+        if (peek() != ',') {
+          break;
+        }
+        ++m_p;
+      }
+      expect(']');
+      return;
+    case '"':
+      skipString();
+      return;
+    case 't':
+    case 'f':
+      readBool();
+      return;
+    case 'n':
+      if (!readLiteral("null")) {
+        fail("invalid literal");
+      }
+      return;
+    default:
+      readNumber();
+      return;
+    }
+  }
+
+private:
+  bool readLiteral(const char *literal)
+  {
+    const auto length = std::strlen(literal);
+    if (size_t(m_end - m_p) < length ||
+        std::memcmp(m_p, literal, length) != 0) {
+      return false;
+    }
+    m_p += length;
+    return true;
+  }
+
+  // One digit or more after the current character
+  void readDigits()
+  {
+    ++m_p;
+    const auto start = m_p;
+    while (m_p != m_end && isDigit(*m_p)) {
+      ++m_p;
+    }
+    if (m_p == start) {
+      fail("invalid number");
+    }
+  }
+
+  uint32_t readHex4()
+  {
+    if (m_end - m_p < 4) {
+      fail("invalid escape");
+    }
+    uint32_t code = 0;
+    for (int i = 0; i < 4; ++i) {
+      const auto c = *m_p++;
+      code <<= 4;
+      if (isDigit(c)) {
+        code |= uint32_t(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        code |= uint32_t(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        code |= uint32_t(c - 'A' + 10);
+      } else {
+        fail("invalid escape");
+      }
+    }
+    return code;
+  }
+
+  // After a backslash
+  void readEscape(std::string &s)
+  {
+    if (m_p == m_end) {
+      fail("unterminated string");
+    }
+    switch (*m_p++) {
+    case '"':
+      s += '"';
+      break;
+    case '\\':
+      s += '\\';
+      break;
+    case '/':
+      s += '/';
+      break;
+    case 'b':
+      s += '\b';
+      break;
+    case 'f':
+      s += '\f';
+      break;
+    case 'n':
+      s += '\n';
+      break;
+    case 'r':
+      s += '\r';
+      break;
+    case 't':
+      s += '\t';
+      break;
+    case 'u': {
+      auto code = readHex4();
+      if (code >= 0xD800 && code <= 0xDBFF) {
+        // High surrogate, the low one must follow
+        if (m_end - m_p < 2 || m_p[0] != '\\' || m_p[1] != 'u') {
+          fail("invalid surrogate pair");
+        }
+        m_p += 2;
+        const auto low = readHex4();
+        if (low < 0xDC00 || low > 0xDFFF) {
+          fail("invalid surrogate pair");
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+      } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        fail("invalid surrogate pair");
+      }
+      appendUtf8(s, code);
+      break;
+    }
+    default:
+      fail("invalid escape");
+    }
+  }
+
+  void skipString()
+  {
+    expect('"');
+    while (m_p != m_end && *m_p != '"') {
+      if ((unsigned char)(*m_p) < 0x20) {
+        fail("unterminated string");
+      }
+      if (*m_p++ == '\\' && m_p != m_end) {
+        ++m_p;
+      }
+    }
+    if (m_p == m_end) {
+      fail("unterminated string");
+    }
+    ++m_p;
+  }
+
+  const char *m_begin;
+  const char *m_p;
+  const char *m_end;
+};
+
+// As tinygltf's ParseExtensionsProperty: entries which are not objects are
+// skipped, empty ones are kept as empty objects
+tinygltf::ExtensionMap readExtensions(JsonReader &reader)
+{
+  tinygltf::ExtensionMap extensions;
+  reader.readObject([&](const std::string &key) {
+    if (reader.peek() != '{') {
+      reader.skipValue();
+      extensions.erase(key);
+      return;
+    }
+    auto &extension = extensions[key];
+    extension = reader.readValue();
+    if (extension.Type() == tinygltf::NULL_TYPE && !key.empty()) {
+      extension = tinygltf::Value(tinygltf::Value::Object{});
+    }
+  });
+  return extensions;
+}
+
+// Object of integers, like the attributes of primitives
+std::map<std::string, int> readIntMap(JsonReader &reader)
+{
+  std::map<std::string, int> values;
+  reader.readObject(
+      [&](const std::string &key) { values[key] = reader.readInt(); });
+  return values;
+}
+
+tinygltf::Node readNode(JsonReader &reader)
+{
+  tinygltf::Node node;
+  std::vector<double> matrix, rotation, scale, translation;
+  auto hasMatrix = false;
+  auto hasRotation = false;
+  auto hasScale = false;
+  auto hasTranslation = false;
+  reader.readObject([&](const std::string &key) {
+    if (key == "name") {
+      reader.readString(node.name);
+    } else if (key == "skin") {
+      node.skin = reader.readInt();
+    } else if (key == "camera") {
+      node.camera = reader.readInt();
+    } else if (key == "mesh") {
+      node.mesh = reader.readInt();
+    } else if (key == "children") {
+      reader.readInts(node.children);
+    } else if (key == "matrix") {
+      reader.readNumbers(matrix);
+      hasMatrix = true;
+    } else if (key == "rotation") {
+      reader.readNumbers(rotation);
+      hasRotation = true;
+    } else if (key == "scale") {
+      reader.readNumbers(scale);
+      hasScale = true;
+    } else if (key == "translation") {
+      reader.readNumbers(translation);
+      hasTranslation = true;
+    } else if (key == "weights") {
+      reader.readNumbers(node.weights);
+    } else if (key == "extensions") {
+      node.extensions = readExtensions(reader);
+    } else if (key == "extras") {
+      node.extras = reader.readValue();
+    } else {
+      reader.skipValue();
+    }
+  });
+  // tinygltf ignores T/R/S if there is a matrix
+  if (hasMatrix) {
+    node.matrix = std::move(matrix);
+  } else {
+    if (hasRotation) {
+      node.rotation = std::move(rotation);
+    }
+    if (hasScale) {
+      node.scale = std::move(scale);
+    }
+    if (hasTranslation) {
+      node.translation = std::move(translation);
+    }
+  }
+  return node;
+}
+
+int getAccessorType(const std::string &type)
+{
+  if (type == "SCALAR") {
+    return TINYGLTF_TYPE_SCALAR;
+  } else if (type == "VEC2") {
+    return TINYGLTF_TYPE_VEC2;
+  } else if (type == "VEC3") {
+    return TINYGLTF_TYPE_VEC3;
+  } else if (type == "VEC4") {
+    return TINYGLTF_TYPE_VEC4;
+  } else if (type == "MAT2") {
+    return TINYGLTF_TYPE_MAT2;
+  } else if (type == "MAT3") {
+    return TINYGLTF_TYPE_MAT3;
+  } else if (type == "MAT4") {
+    return TINYGLTF_TYPE_MAT4;
+  }
+  return -1;
+}
+
+void readSparse(JsonReader &reader, tinygltf::Accessor &accessor)
+{
+  auto &sparse = accessor.sparse;
+  // Bits of the required properties read
+  unsigned int found = 0;
+  reader.readObject([&](const std::string &key) {
+    if (key == "count") {
+      sparse.count = reader.readInt();
+      found |= 1;
+    } else if (key == "indices") {
+      reader.readObject([&](const std::string &indicesKey) {
+        if (indicesKey == "bufferView") {
+          sparse.indices.bufferView = reader.readInt();
+          found |= 2;
+        } else if (indicesKey == "byteOffset") {
+          sparse.indices.byteOffset = reader.readInt();
+          found |= 4;
+        } else if (indicesKey == "componentType") {
+          sparse.indices.componentType = reader.readInt();
+          found |= 8;
+        } else {
+          reader.skipValue();
+        }
+      });
+    } else if (key == "values") {
+      reader.readObject([&](const std::string &valuesKey) {
+        if (valuesKey == "bufferView") {
+          sparse.values.bufferView = reader.readInt();
+          found |= 16;
+        } else if (valuesKey == "byteOffset") {
+          sparse.values.byteOffset = reader.readInt();
+          found |= 32;
+        } else {
+          reader.skipValue();
+        }
+      });
+    } else {
+      reader.skipValue();
+    }
+  });
+  if (found != 63) {
+    reader.fail("incomplete sparse accessor");
+  }
+  sparse.isSparse = true;
+}
+
+tinygltf::Accessor readAccessor(JsonReader &reader)
+{
+  tinygltf::Accessor accessor;
+  auto hasComponentType = false;
+  auto hasCount = false;
+  std::string type;
+  reader.readObject([&](const std::string &key) {
+    if (key == "bufferView") {
+      accessor.bufferView = reader.readInt();
+    } else if (key == "byteOffset") {
+      accessor.byteOffset = reader.readUnsigned();
+    } else if (key == "normalized") {
+      accessor.normalized = reader.readBool();
+    } else if (key == "componentType") {
+      const auto componentType = reader.readUnsigned();
+      if (componentType < TINYGLTF_COMPONENT_TYPE_BYTE ||
+          componentType > TINYGLTF_COMPONENT_TYPE_DOUBLE) {
+        reader.fail("invalid componentType");
+      }
+      accessor.componentType = int(componentType);
+      hasComponentType = true;
+    } else if (key == "count") {
+      accessor.count = reader.readUnsigned();
+      hasCount = true;
+    } else if (key == "type") {
+      reader.readString(type);
+    } else if (key == "name") {
+      reader.readString(accessor.name);
+    } else if (key == "min") {
+      reader.readNumbers(accessor.minValues);
+    } else if (key == "max") {
+      reader.readNumbers(accessor.maxValues);
+    } else if (key == "sparse") {
+      readSparse(reader, accessor);
+    } else if (key == "extensions") {
+      accessor.extensions = readExtensions(reader);
+    } else if (key == "extras") {
+      accessor.extras = reader.readValue();
+    } else {
+      reader.skipValue();
+    }
+  });
+  accessor.type = getAccessorType(type);
+  if (!hasComponentType || !hasCount || accessor.type < 0) {
+    reader.fail("incomplete accessor");
+  }
+  return accessor;
+}
+
+tinygltf::Primitive readPrimitive(JsonReader &reader)
+{
+  tinygltf::Primitive primitive;
+  primitive.material = -1;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  primitive.indices = -1;
+  auto hasAttributes = false;
+  reader.readObject([&](const std::string &key) {
+    if (key == "material") {
+      primitive.material = reader.readInt();
+    } else if (key == "mode") {
+      primitive.mode = reader.readInt();
+    } else if (key == "indices") {
+      primitive.indices = reader.readInt();
+    } else if (key == "attributes") {
+      primitive.attributes = readIntMap(reader);
+      hasAttributes = true;
+    } else if (key == "targets") {
+      primitive.targets.clear();
+      reader.readArray(
+          [&]() { primitive.targets.push_back(readIntMap(reader)); });
+    } else if (key == "extensions") {
+      primitive.extensions = readExtensions(reader);
+    } else if (key == "extras") {
+      primitive.extras = reader.readValue();
+    } else {
+      reader.skipValue();
+    }
+  });
+  if (!hasAttributes) {
+    // tinygltf drops such primitives, with an error
+    reader.fail("primitive without attributes");
+  }
+  return primitive;
+}
+
+tinygltf::Mesh readMesh(JsonReader &reader)
+{
+  tinygltf::Mesh mesh;
+  reader.readObject([&](const std::string &key) {
+    if (key == "name") {
+      reader.readString(mesh.name);
+    } else if (key == "primitives") {
+      mesh.primitives.clear();
+      reader.readArray(
+          [&]() { mesh.primitives.push_back(readPrimitive(reader)); });
+    } else if (key == "weights") {
+      reader.readNumbers(mesh.weights);
+    } else if (key == "extensions") {
+      mesh.extensions = readExtensions(reader);
+    } else if (key == "extras") {
+      mesh.extras = reader.readValue();
+    } else {
+      reader.skipValue();
+    }
+  });
+  return mesh;
+}
+
+// What tinygltf does once it has parsed accessors and meshes: mark the
+// buffer views of indices and attributes with their target
+bool assignBufferViewTargets(tinygltf::Model &model, std::string &err)
+{
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.indices > -1) {
+        if (size_t(primitive.indices) >= model.accessors.size()) {
+          err += "primitive indices accessor out of bounds";
+          return false;
+        }
+        const auto bufferView = model.accessors[primitive.indices].bufferView;
+        if (bufferView < 0 || size_t(bufferView) >= model.bufferViews.size()) {
+          err += "accessor[" + std::to_string(primitive.indices) +
+                 "] invalid bufferView";
+          return false;
+        }
+        model.bufferViews[bufferView].target =
+            TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+      }
+      for (const auto &attribute : primitive.attributes) {
+        // tinygltf indexes these without checking them
+        if (attribute.second < 0 ||
+            size_t(attribute.second) >= model.accessors.size()) {
+          continue;
+        }
+        const auto bufferView = model.accessors[attribute.second].bufferView;
+        if (bufferView >= 0 && size_t(bufferView) < model.bufferViews.size()) {
+          model.bufferViews[bufferView].target = TINYGLTF_TARGET_ARRAY_BUFFER;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// A fallback buffer of EXT_meshopt_compression without uri
+struct MeshoptFallbackBuffer
+{
+  size_t index; // In the buffers of the document
+  size_t begin; // Offsets of its object in the text, [begin, end)
+  size_t end;
+  std::string name;
+};
+
+// Fallback buffers of EXT_meshopt_compression without uri of the glTF JSON
+// document json of size bytes. None for invalid documents, left to tinygltf.
+std::vector<MeshoptFallbackBuffer> findMeshoptFallbackBuffers(
+    const char *json, size_t size)
+{
+  std::vector<MeshoptFallbackBuffer> fallbackBuffers;
+  try {
+    JsonReader reader(json, json + size);
+    reader.readObject([&](const std::string &key) {
+      if (key != "buffers" || reader.peek() != '[') {
+        reader.skipValue();
+        return;
+      }
+      size_t index = 0;
+      reader.readArray([&]() {
+        MeshoptFallbackBuffer buffer{index++, 0, 0, {}};
+        if (reader.peek() != '{') {
+          reader.skipValue();
+          return;
+        }
+        buffer.begin = reader.offset();
+        auto hasUri = false;
+        auto isFallback = false;
+        reader.readObject([&](const std::string &member) {
+          if (member == "uri") {
+            hasUri = true;
+            reader.skipValue();
+          } else if (member == "name" && reader.peek() == '"') {
+            buffer.name = reader.readString();
+          } else if (member == "extensions" && reader.peek() == '{') {
+            const auto extensions = readExtensions(reader);
+            const auto it = extensions.find(MESHOPT_EXTENSION);
+            isFallback = it != end(extensions) &&
+                         it->second.Get("fallback").IsBool() &&
+                         it->second.Get("fallback").Get<bool>();
+          } else {
+            reader.skipValue();
+          }
+        });
+        buffer.end = reader.offset();
+        if (!hasUri && isFallback) {
+          fallbackBuffers.push_back(std::move(buffer));
+        }
+      });
+    });
+  } catch (const JsonError &) {
+    fallbackBuffers.clear();
+  }
+  return fallbackBuffers;
+}
+
+bool isMeshoptFallbackPath(const std::string &path)
+{
+  const auto length = std::strlen(MESHOPT_FALLBACK_URI);
+  return path.size() >= length &&
+         path.compare(path.size() - length, length, MESHOPT_FALLBACK_URI) ==
+             0;
+}
+
+// Callbacks reading MESHOPT_FALLBACK_URI as 1 byte, and the other files with
+// the callbacks in userData
+tinygltf::FsCallbacks getMeshoptFallbackFsCallbacks(
+    const tinygltf::FsCallbacks &fs)
+{
+  tinygltf::FsCallbacks callbacks;
+  callbacks.FileExists = [](const std::string &path, void *userData) {
+    const auto &fs = *static_cast<const tinygltf::FsCallbacks *>(userData);
+    return isMeshoptFallbackPath(path) || fs.FileExists(path, fs.user_data);
+  };
+  callbacks.ExpandFilePath = [](const std::string &path, void *userData) {
+    const auto &fs = *static_cast<const tinygltf::FsCallbacks *>(userData);
+    return fs.ExpandFilePath(path, fs.user_data);
+  };
+  callbacks.ReadWholeFile = [](std::vector<unsigned char> *out,
+                                std::string *err, const std::string &path,
+                                void *userData) {
+    if (isMeshoptFallbackPath(path)) {
+      out->assign(1, 0);
+      return true;
+    }
+    const auto &fs = *static_cast<const tinygltf::FsCallbacks *>(userData);
+    return fs.ReadWholeFile(out, err, path, fs.user_data);
+  };
+  callbacks.WriteWholeFile = fs.WriteWholeFile;
+  callbacks.user_data =
+      const_cast<void *>(static_cast<const void *>(&fs));
+  return callbacks;
+}
+
+} // namespace
+
+bool parseGltfJsonArrays(
+    const char *json, size_t size, GltfJsonArrays &arrays, std::string &err)
+{
+  arrays = GltfJsonArrays();
+  try {
+    JsonReader reader(json, json + size);
+    bool found[3] = {false, false, false};
+    reader.readObject([&](const std::string &key) {
+      const auto array = key == "nodes"       ? 0
+                         : key == "accessors" ? 1
+                         : key == "meshes"    ? 2
+                                              : -1;
+      if (array < 0) {
+        reader.skipValue();
+        return;
+      }
+      if (found[array]) {
+        reader.fail("duplicated \"" + key + "\"");
+      }
+      found[array] = true;
+      reader.peek();
+      const auto begin = reader.offset();
+      if (array == 0) {
+        reader.readArray([&]() { arrays.nodes.push_back(readNode(reader)); });
+      } else if (array == 1) {
+        reader.readArray(
+            [&]() { arrays.accessors.push_back(readAccessor(reader)); });
+      } else {
+        reader.readArray(
+            [&]() { arrays.meshes.push_back(readMesh(reader)); });
+      }
+      arrays.ranges.emplace_back(begin, reader.offset());
+    });
+    if (!reader.atEnd()) {
+      reader.fail("unexpected character after the root object");
+    }
+  } catch (const JsonError &e) {
+    err = e.what();
+    arrays = GltfJsonArrays();
+    return false;
+  }
+  return true;
+}
+
+bool loadGltfWithFastJson(tinygltf::TinyGLTF &loader, tinygltf::Model &model,
+    std::string &err, std::string &warn, const unsigned char *bytes,
+    size_t size, bool isBinary, const std::string &baseDir)
+{
+  if (size > std::numeric_limits<unsigned int>::max()) {
+    return false;
+  }
+  const auto load = [&](const unsigned char *data) {
+    return isBinary ? loader.LoadBinaryFromMemory(&model, &err, &warn, data,
+                          (unsigned int)size, baseDir)
+                    : loader.LoadASCIIFromString(&model, &err, &warn,
+                          reinterpret_cast<const char *>(data),
+                          (unsigned int)size, baseDir);
+  };
+
+  // The JSON chunk of .glb files follows their 12 bytes header and its own
+  // length and type
+  size_t jsonOffset = 0;
+  auto jsonSize = size;
+  if (isBinary) {
+    uint32_t chunkLength = 0;
+    if (size >= 20) {
+      std::memcpy(&chunkLength, bytes + 12, sizeof(chunkLength));
+    }
+    if (size < 20 || 20 + size_t(chunkLength) > size) {
+      return load(bytes); // For tinygltf to report it
+    }
+    jsonOffset = 20;
+    jsonSize = chunkLength;
+  }
+
+  GltfJsonArrays arrays;
+  std::string parseErr;
+  if (!parseGltfJsonArrays(reinterpret_cast<const char *>(bytes + jsonOffset),
+          jsonSize, arrays, parseErr)) {
+    warn += "parsed by tinygltf alone, without --fast-json: " + parseErr +
+            "\n";
+    return load(bytes);
+  }
+
+  {
+    // Empty arrays padded with spaces keep the length of the document, and
+    // of the JSON chunk of .glb files. tinygltf copies the BIN chunk anyway.
+    std::vector<unsigned char> reduced(bytes, bytes + size);
+    for (const auto &range : arrays.ranges) {
+      const auto value = reduced.data() + jsonOffset + range.first;
+      std::memset(value, ' ', range.second - range.first);
+      value[0] = '[';
+      value[1] = ']';
+    }
+    if (!load(reduced.data())) {
+      return false;
+    }
+  }
+
+  model.nodes = std::move(arrays.nodes);
+  model.accessors = std::move(arrays.accessors);
+  model.meshes = std::move(arrays.meshes);
+  return assignBufferViewTargets(model, err);
+}
+
+tinygltf::FsCallbacks getDefaultFsCallbacks()
+{
+  return tinygltf::FsCallbacks{&tinygltf::FileExists,
+      &tinygltf::ExpandFilePath, &tinygltf::ReadWholeFile,
+      &tinygltf::WriteWholeFile, nullptr};
+}
+
+bool loadGltfDocument(tinygltf::TinyGLTF &loader, tinygltf::Model &model,
+    std::string &err, std::string &warn, const unsigned char *bytes,
+    size_t size, bool isBinary, const std::string &baseDir, bool fastJson,
+    const tinygltf::FsCallbacks &fs)
+{
+  if (size > std::numeric_limits<unsigned int>::max()) {
+    return false;
+  }
+  const auto load = [&](const unsigned char *data) {
+    if (fastJson) {
+      return loadGltfWithFastJson(
+          loader, model, err, warn, data, size, isBinary, baseDir);
+    }
+    return isBinary ? loader.LoadBinaryFromMemory(&model, &err, &warn, data,
+                          (unsigned int)size, baseDir)
+                    : loader.LoadASCIIFromString(&model, &err, &warn,
+                          reinterpret_cast<const char *>(data),
+                          (unsigned int)size, baseDir);
+  };
+
+  // The JSON chunk of .glb files follows their 12 bytes header and its own
+  // length and type, only documents naming the extension are scanned
+  size_t jsonOffset = 0;
+  auto jsonSize = size;
+  if (isBinary) {
+    uint32_t chunkLength = 0;
+    if (size >= 20) {
+      std::memcpy(&chunkLength, bytes + 12, sizeof(chunkLength));
+    }
+    if (size < 20 || 20 + size_t(chunkLength) > size) {
+      return load(bytes); // For tinygltf to report it
+    }
+    jsonOffset = 20;
+    jsonSize = chunkLength;
+  }
+  const auto json = reinterpret_cast<const char *>(bytes + jsonOffset);
+  const std::string extension = MESHOPT_EXTENSION;
+  if (std::search(json, json + jsonSize, begin(extension), end(extension)) ==
+      json + jsonSize) {
+    return load(bytes);
+  }
+  const auto fallbackBuffers = findMeshoptFallbackBuffers(json, jsonSize);
+  if (fallbackBuffers.empty()) {
+    return load(bytes);
+  }
+
+  // Replaced by buffers of 1 byte with MESHOPT_FALLBACK_URI, padded with
+  // spaces to keep the length of the document, and of the JSON chunk of .glb
+  // files. Their object, with the extension, is always longer.
+  std::vector<unsigned char> document(bytes, bytes + size);
+  const auto replacement = std::string("{\"byteLength\":1,\"uri\":\"") +
+                           MESHOPT_FALLBACK_URI + "\"}";
+  for (const auto &buffer : fallbackBuffers) {
+    const auto object = document.data() + jsonOffset + buffer.begin;
+    std::memset(object, ' ', buffer.end - buffer.begin);
+    std::memcpy(object, replacement.data(), replacement.size());
+  }
+  const auto fallbackFs = getMeshoptFallbackFsCallbacks(fs);
+  loader.SetFsCallbacks(fallbackFs);
+  const auto result = load(document.data());
+  loader.SetFsCallbacks(fs);
+  if (!result) {
+    return false;
+  }
+
+  // Empty again, for decodeMeshoptBuffers to fill them
+  for (const auto &buffer : fallbackBuffers) {
+    if (buffer.index < model.buffers.size()) {
+      auto &modelBuffer = model.buffers[buffer.index];
+      std::vector<unsigned char>().swap(modelBuffer.data);
+      modelBuffer.uri.clear();
+      modelBuffer.name = buffer.name;
+      modelBuffer.extensions[MESHOPT_EXTENSION] =
+          tinygltf::Value(tinygltf::Value::Object{
+              {"fallback", tinygltf::Value(true)}});
+    }
+  }
+  return true;
+}
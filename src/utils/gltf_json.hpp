@@ -0,0 +1,61 @@
+#pragma once
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Faster parsing of glTF files with many nodes, accessors and meshes, say CAD
+// exports with hundreds of thousands of them. tinygltf first builds the DOM of
+// the whole JSON document with nlohmann::json, then converts it, which for
+// such files takes most of the loading time and several times the memory of
+// the text. These three arrays are instead read straight from the text into
+// their tinygltf structures, without DOM; tinygltf parses the rest of the
+// document, where those arrays are replaced by empty ones.
+
+// Nodes, accessors and meshes of a glTF document, as tinygltf parses them
+struct GltfJsonArrays
+{
+  std::vector<tinygltf::Node> nodes;
+  std::vector<tinygltf::Accessor> accessors;
+  std::vector<tinygltf::Mesh> meshes;
+  // Offsets in the text of the values of the "nodes", "accessors" and
+  // "meshes" members of the root, [begin, end)
+  std::vector<std::pair<size_t, size_t>> ranges;
+};
+
+// Read the nodes, accessors and meshes of the glTF JSON document json of size
+// bytes. Returns false, with the reason in err, for invalid documents and
+// for values tinygltf would warn about or convert loosely (numbers where
+// integers are expected, missing required properties...) which are then left
+// to tinygltf.
+bool parseGltfJsonArrays(
+    const char *json, size_t size, GltfJsonArrays &arrays, std::string &err);
+
+// Same as loader.LoadBinaryFromMemory (if isBinary) or
+// loader.LoadASCIIFromString on the bytes of a .glb or .gltf file, with its
+// nodes, accessors and meshes read by parseGltfJsonArrays. Documents it
+// rejects are loaded by tinygltf alone, with a warning.
+bool loadGltfWithFastJson(tinygltf::TinyGLTF &loader, tinygltf::Model &model,
+    std::string &err, std::string &warn, const unsigned char *bytes,
+    size_t size, bool isBinary, const std::string &baseDir);
+
+// tinygltf::FsCallbacks reading files with the default callbacks of tinygltf
+tinygltf::FsCallbacks getDefaultFsCallbacks();
+
+// Same as loadGltfWithFastJson if fastJson, else as
+// loader.LoadBinaryFromMemory or loader.LoadASCIIFromString, loader reading
+// external files with fs (set with loader.SetFsCallbacks).
+//
+// tinygltf rejects the fallback buffers of EXT_meshopt_compression, which
+// have no data: .gltf files need a uri, and .glb files read them from their
+// BIN chunk. Documents with such buffers are parsed from a copy where these
+// are replaced, keeping the length of the document, by 1 byte buffers read
+// from a placeholder uri, and left empty once parsed for
+// decodeMeshoptBuffers to fill them.
+bool loadGltfDocument(tinygltf::TinyGLTF &loader, tinygltf::Model &model,
+    std::string &err, std::string &warn, const unsigned char *bytes,
+    size_t size, bool isBinary, const std::string &baseDir, bool fastJson,
+    const tinygltf::FsCallbacks &fs);
@@ -0,0 +1,171 @@
+#include "gpu_jpeg.hpp"
+
+#ifdef GLTF_VIEWER_USE_NVJPEG
+#include "gl_objects.hpp"
+#include "gpu_memory.hpp"
+
+// After glad, which defines the GL header it would include
+#include <cuda_gl_interop.h>
+#include <cuda_runtime.h>
+#include <nvjpeg.h>
+
+struct GpuJpegDecoder::Resources
+{
+  nvjpegHandle_t handle = nullptr;
+  nvjpegJpegState_t state = nullptr;
+  cudaStream_t stream = nullptr;
+  GLBuffer pixelBuffer;
+  cudaGraphicsResource_t pixelResource = nullptr; // Of pixelBuffer
+  size_t pixelBufferSize = 0;
+
+  ~Resources()
+  {
+    if (pixelResource) {
+      cudaGraphicsUnregisterResource(pixelResource);
+    }
+    if (stream) {
+      cudaStreamDestroy(stream);
+    }
+    if (state) {
+      nvjpegJpegStateDestroy(state);
+    }
+    if (handle) {
+      nvjpegDestroy(handle);
+    }
+  }
+
+  // Replace pixelBuffer by one of at least byteSize bytes, registered for
+  // CUDA to write it
+  bool reservePixelBuffer(size_t byteSize, std::string &err)
+  {
+    if (byteSize <= pixelBufferSize) {
+      return true;
+    }
+    if (pixelResource) {
+      cudaGraphicsUnregisterResource(pixelResource);
+      pixelResource = nullptr;
+    }
+    pixelBufferSize = 0;
+    pixelBuffer = GLBuffer::generate();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.glId());
+    glBufferStorage(
+        GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(byteSize), nullptr, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    const auto buffer = pixelBuffer.glId();
+    trackBuffers(GpuMemoryCategory::Transfers, 1, &buffer);
+    const auto status = cudaGraphicsGLRegisterBuffer(&pixelResource, buffer,
+        cudaGraphicsRegisterFlagsWriteDiscard);
+    if (status != cudaSuccess) {
+      pixelResource = nullptr;
+      err = std::string("Unable to register a GL buffer with CUDA: ") +
+            cudaGetErrorString(status);
+      return false;
+    }
+    pixelBufferSize = byteSize;
+    return true;
+  }
+};
+
+bool GpuJpegDecoder::isAvailable()
+{
+  int deviceCount = 0;
+  return cudaGetDeviceCount(&deviceCount) == cudaSuccess && deviceCount > 0;
+}
+
+#else
+
+struct GpuJpegDecoder::Resources
+{
+};
+
+bool GpuJpegDecoder::isAvailable() { return false; }
+
+#endif
+
+GpuJpegDecoder::GpuJpegDecoder() = default;
+
+GpuJpegDecoder::~GpuJpegDecoder() = default;
+
+bool GpuJpegDecoder::decode(const unsigned char *data, size_t size,
+    int &width, int &height, std::string &err)
+{
+  m_mutex.lock();
+  const auto fail = [&](std::string reason) {
+    err = std::move(reason);
+    m_mutex.unlock();
+    return false;
+  };
+  if (m_failed) {
+    return fail("GPU JPEG decoding is not available");
+  }
+#ifdef GLTF_VIEWER_USE_NVJPEG
+  if (!m_resources) {
+    m_resources = std::make_unique<Resources>();
+    if (nvjpegCreateSimple(&m_resources->handle) != NVJPEG_STATUS_SUCCESS ||
+        nvjpegJpegStateCreate(m_resources->handle, &m_resources->state) !=
+            NVJPEG_STATUS_SUCCESS ||
+        cudaStreamCreate(&m_resources->stream) != cudaSuccess) {
+      m_failed = true;
+      m_resources = nullptr;
+      return fail("Unable to create the nvJPEG decoder");
+    }
+  }
+  auto &resources = *m_resources;
+
+  int componentCount = 0;
+  nvjpegChromaSubsampling_t subsampling;
+  int widths[NVJPEG_MAX_COMPONENT];
+  int heights[NVJPEG_MAX_COMPONENT];
+  if (nvjpegGetImageInfo(resources.handle, data, size, &componentCount,
+          &subsampling, widths, heights) != NVJPEG_STATUS_SUCCESS) {
+    return fail("Unable to read the JPEG header");
+  }
+  // Interleaved RGB rows, whatever the channels of the file
+  const auto rowSize = size_t(widths[0]) * 3;
+  std::string reserveErr;
+  if (!resources.reservePixelBuffer(rowSize * size_t(heights[0]),
+          reserveErr)) {
+    // The GL context is not on a CUDA device, no later image will do better
+    m_failed = true;
+    return fail(reserveErr);
+  }
+
+  void *pixels = nullptr;
+  size_t mappedSize = 0;
+  if (cudaGraphicsMapResources(1, &resources.pixelResource,
+          resources.stream) != cudaSuccess) {
+    return fail("Unable to map the pixel buffer in CUDA");
+  }
+  cudaGraphicsResourceGetMappedPointer(
+      &pixels, &mappedSize, resources.pixelResource);
+  nvjpegImage_t destination{};
+  destination.channel[0] = static_cast<unsigned char *>(pixels);
+  destination.pitch[0] = rowSize;
+  const auto status = nvjpegDecode(resources.handle, resources.state, data,
+      size, NVJPEG_OUTPUT_RGBI, &destination, resources.stream);
+  // Unmapping orders the writes of the stream before later GL commands
+  cudaGraphicsUnmapResources(1, &resources.pixelResource, resources.stream);
+  if (status != NVJPEG_STATUS_SUCCESS) {
+    return fail("nvJPEG failed to decode the image, status " +
+                std::to_string(int(status)));
+  }
+  width = widths[0];
+  height = heights[0];
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, resources.pixelBuffer.glId());
+  return true;
+#else
+  // Only read by nvJPEG
+  (void)data;
+  (void)size;
+  (void)width;
+  (void)height;
+  m_failed = true;
+  return fail("This build has no GPU JPEG decoder");
+#endif
+}
+
+void GpuJpegDecoder::endTransfer()
+{
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  m_mutex.unlock();
+}
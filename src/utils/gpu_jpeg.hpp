@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// JPEG decoding on NVIDIA GPUs with nvJPEG (--gpu-jpeg): the pixels are
+// written by CUDA in a GL pixel buffer registered for interop, then copied
+// into textures by glTexSubImage2D without leaving GPU memory, so JPEG images
+// of the model are never decoded in its CPU buffers. See
+// TextureUploader::createJpegTexture.
+//
+// Needs the viewer to be built with nvJPEG and the CUDA runtime
+// (GLTF_VIEWER_USE_NVJPEG) and a CUDA device, which must also be the one of
+// the GL context for the pixel buffer to be registered. If it cannot be,
+// decode fails once and for all and callers decode on the CPU instead.
+//
+// The pixel buffer grows to the largest image decoded, it is shared by the
+// contexts sharing objects with the one the decoder is first used in, which
+// must be current when it is destroyed. Decodes are serialized.
+class GpuJpegDecoder
+{
+public:
+  // False without nvJPEG or without CUDA device
+  static bool isAvailable();
+
+  // Nothing is created before the first decode
+  GpuJpegDecoder();
+
+  ~GpuJpegDecoder();
+
+  GpuJpegDecoder(const GpuJpegDecoder &) = delete;
+
+  GpuJpegDecoder &operator=(const GpuJpegDecoder &) = delete;
+
+  // Decode a JPEG file to tightly packed RGB8 rows, top row first like
+  // images of tinygltf, at the start of the pixel buffer, left bound to
+  // GL_PIXEL_UNPACK_BUFFER. Returns false, with the reason in err and
+  // nothing bound, if the file cannot be decoded.
+  bool decode(const unsigned char *data, size_t size, int &width, int &height,
+      std::string &err);
+
+  // Unbind the pixel buffer once read, and let the next decode write it
+  void endTransfer();
+
+private:
+  struct Resources;
+
+  std::unique_ptr<Resources> m_resources;
+  std::mutex m_mutex; // Locked from decode to endTransfer
+  bool m_failed = false; // Creating resources failed
+};
@@ -0,0 +1,331 @@
+#include "gpu_memory.hpp"
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+thread_local GpuMemoryTracker *currentTracker = nullptr;
+
+// Undefined in the core profile header of glad
+const GLenum GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX = 0x9047;
+const GLenum GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX = 0x9048;
+const GLenum GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX = 0x9049;
+const GLenum VBO_FREE_MEMORY_ATI = 0x87FB;
+const GLenum TEXTURE_FREE_MEMORY_ATI = 0x87FC;
+const GLenum RENDERBUFFER_FREE_MEMORY_ATI = 0x87FD;
+
+GLenum getTextureBinding(GLenum target)
+{
+  switch (target) {
+  case GL_TEXTURE_2D_ARRAY:
+    return GL_TEXTURE_BINDING_2D_ARRAY;
+  case GL_TEXTURE_2D_MULTISAMPLE:
+    return GL_TEXTURE_BINDING_2D_MULTISAMPLE;
+  case GL_TEXTURE_3D:
+    return GL_TEXTURE_BINDING_3D;
+  default:
+    return GL_TEXTURE_BINDING_2D;
+  }
+}
+
+// Bits per texel of the level of the texture bound to target, or of the
+// renderbuffer bound to GL_RENDERBUFFER if level is negative
+size_t getTexelBits(GLenum target, GLint level)
+{
+  static const GLenum textureSizes[] = {GL_TEXTURE_RED_SIZE,
+      GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE,
+      GL_TEXTURE_DEPTH_SIZE, GL_TEXTURE_STENCIL_SIZE};
+  static const GLenum renderbufferSizes[] = {GL_RENDERBUFFER_RED_SIZE,
+      GL_RENDERBUFFER_GREEN_SIZE, GL_RENDERBUFFER_BLUE_SIZE,
+      GL_RENDERBUFFER_ALPHA_SIZE, GL_RENDERBUFFER_DEPTH_SIZE,
+      GL_RENDERBUFFER_STENCIL_SIZE};
+  size_t bits = 0;
+  for (size_t i = 0; i < 6; ++i) {
+    GLint size = 0;
+    if (level >= 0) {
+      glGetTexLevelParameteriv(target, level, textureSizes[i], &size);
+    } else {
+      glGetRenderbufferParameteriv(
+          GL_RENDERBUFFER, renderbufferSizes[i], &size);
+    }
+    bits += size_t(std::max(size, 0));
+  }
+  return bits;
+}
+
+} // namespace
+
+const char *getGpuMemoryCategoryName(GpuMemoryCategory category)
+{
+  switch (category) {
+  case GpuMemoryCategory::Geometry:
+    return "geometry";
+  case GpuMemoryCategory::Textures:
+    return "textures";
+  case GpuMemoryCategory::DrawData:
+    return "draw data";
+  case GpuMemoryCategory::RenderTargets:
+    return "render targets";
+  case GpuMemoryCategory::Transfers:
+    return "transfers";
+  case GpuMemoryCategory::Pooled:
+    return "pooled";
+  default:
+    return "";
+  }
+}
+
+size_t getBufferByteSize(GLuint buffer)
+{
+  GLint previousBuffer = 0;
+  glGetIntegerv(GL_COPY_READ_BUFFER_BINDING, &previousBuffer);
+  glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+  GLint64 byteSize = 0;
+  glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &byteSize);
+  glBindBuffer(GL_COPY_READ_BUFFER, GLuint(previousBuffer));
+  return size_t(std::max(byteSize, GLint64(0)));
+}
+
+size_t getTextureByteSize(GLenum target, GLuint texture)
+{
+  GLint previousTexture = 0;
+  glGetIntegerv(getTextureBinding(target), &previousTexture);
+  glBindTexture(target, texture);
+
+  // Mutable textures have the levels they were given an image of
+  GLint levelCount = 0;
+  if (target != GL_TEXTURE_2D_MULTISAMPLE) {
+    glGetTexParameteriv(target, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+  }
+  const auto maxLevelCount = levelCount > 0 ? levelCount : 32;
+  size_t byteSize = 0;
+  for (GLint level = 0; level < maxLevelCount; ++level) {
+    GLint width = 0, height = 0, depth = 0, isCompressed = 0;
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_DEPTH, &depth);
+    if (width <= 0) {
+      break;
+    }
+    glGetTexLevelParameteriv(
+        target, level, GL_TEXTURE_COMPRESSED, &isCompressed);
+    if (isCompressed) {
+      // Of all the layers of the level
+      GLint compressedSize = 0;
+      glGetTexLevelParameteriv(target, level,
+          GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &compressedSize);
+      byteSize += size_t(std::max(compressedSize, 0));
+      continue;
+    }
+    GLint sampleCount = 0;
+    glGetTexLevelParameteriv(target, level, GL_TEXTURE_SAMPLES, &sampleCount);
+    const auto texelCount = size_t(width) * size_t(std::max(height, 1)) *
+                            size_t(std::max(depth, 1)) *
+                            size_t(std::max(sampleCount, 1));
+    byteSize += texelCount * getTexelBits(target, level) / 8;
+  }
+
+  glBindTexture(target, GLuint(previousTexture));
+  return byteSize;
+}
+
+size_t getRenderbufferByteSize(GLuint renderbuffer)
+{
+  GLint previousRenderbuffer = 0;
+  glGetIntegerv(GL_RENDERBUFFER_BINDING, &previousRenderbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+  GLint width = 0, height = 0, sampleCount = 0;
+  glGetRenderbufferParameteriv(
+      GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &width);
+  glGetRenderbufferParameteriv(
+      GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &height);
+  glGetRenderbufferParameteriv(
+      GL_RENDERBUFFER, GL_RENDERBUFFER_SAMPLES, &sampleCount);
+  const auto texelCount = size_t(std::max(width, 0)) *
+                          size_t(std::max(height, 0)) *
+                          size_t(std::max(sampleCount, 1));
+  const auto byteSize = texelCount * getTexelBits(GL_RENDERBUFFER, -1) / 8;
+  glBindRenderbuffer(GL_RENDERBUFFER, GLuint(previousRenderbuffer));
+  return byteSize;
+}
+
+GpuMemoryTracker::Scope::Scope(GpuMemoryTracker *tracker) :
+    m_previous(currentTracker)
+{
+  currentTracker = tracker;
+}
+
+GpuMemoryTracker::Scope::~Scope() { currentTracker = m_previous; }
+
+GpuMemoryTracker::GpuMemoryTracker(size_t budgetBytes) :
+    m_budgetBytes(budgetBytes)
+{
+}
+
+GpuMemoryTracker *GpuMemoryTracker::current() { return currentTracker; }
+
+void GpuMemoryTracker::add(GpuMemoryCategory category, GLenum type,
+    GLuint name, size_t byteSize)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto &object = m_objects[std::make_pair(type, name)];
+  m_categoryBytes[size_t(object.category)] -= object.byteSize;
+  m_totalBytes -= object.byteSize;
+  object = TrackedObject{category, byteSize};
+  m_categoryBytes[size_t(category)] += byteSize;
+  m_totalBytes += byteSize;
+
+  if (m_budgetBytes && m_totalBytes > m_budgetBytes && !m_isOverBudget) {
+    m_isOverBudget = true;
+    std::cerr << "Warning : " << m_totalBytes / (1024 * 1024)
+              << " MiB of GPU memory allocated, over the budget of "
+              << m_budgetBytes / (1024 * 1024) << " MiB (";
+    for (size_t i = 0; i < m_categoryBytes.size(); ++i) {
+      std::cerr << (i ? ", " : "")
+                << getGpuMemoryCategoryName(GpuMemoryCategory(i)) << " "
+                << m_categoryBytes[i] / (1024 * 1024) << " MiB";
+    }
+    std::cerr << ")" << std::endl;
+  }
+}
+
+void GpuMemoryTracker::remove(GLenum type, GLuint name)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const auto it = m_objects.find(std::make_pair(type, name));
+  if (it == end(m_objects)) {
+    return;
+  }
+  m_categoryBytes[size_t(it->second.category)] -= it->second.byteSize;
+  m_totalBytes -= it->second.byteSize;
+  m_objects.erase(it);
+  m_isOverBudget = m_isOverBudget && m_totalBytes > m_budgetBytes;
+}
+
+GpuMemoryTracker::CategoryBytes GpuMemoryTracker::categoryBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_categoryBytes;
+}
+
+size_t GpuMemoryTracker::totalBytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_totalBytes;
+}
+
+void trackBuffers(
+    GpuMemoryCategory category, GLsizei count, const GLuint *buffers)
+{
+  if (!currentTracker) {
+    return;
+  }
+  for (GLsizei i = 0; i < count; ++i) {
+    if (buffers[i]) {
+      currentTracker->add(
+          category, GL_BUFFER, buffers[i], getBufferByteSize(buffers[i]));
+    }
+  }
+}
+
+void trackTextures(GpuMemoryCategory category, GLenum target, GLsizei count,
+    const GLuint *textures)
+{
+  if (!currentTracker) {
+    return;
+  }
+  for (GLsizei i = 0; i < count; ++i) {
+    if (textures[i]) {
+      currentTracker->add(category, GL_TEXTURE, textures[i],
+          getTextureByteSize(target, textures[i]));
+    }
+  }
+}
+
+void trackRenderbuffers(
+    GpuMemoryCategory category, GLsizei count, const GLuint *renderbuffers)
+{
+  if (!currentTracker) {
+    return;
+  }
+  for (GLsizei i = 0; i < count; ++i) {
+    if (renderbuffers[i]) {
+      currentTracker->add(category, GL_RENDERBUFFER, renderbuffers[i],
+          getRenderbufferByteSize(renderbuffers[i]));
+    }
+  }
+}
+
+void untrackBuffers(GLsizei count, const GLuint *buffers)
+{
+  for (GLsizei i = 0; currentTracker && i < count; ++i) {
+    currentTracker->remove(GL_BUFFER, buffers[i]);
+  }
+}
+
+void untrackTextures(GLsizei count, const GLuint *textures)
+{
+  for (GLsizei i = 0; currentTracker && i < count; ++i) {
+    currentTracker->remove(GL_TEXTURE, textures[i]);
+  }
+}
+
+void untrackRenderbuffers(GLsizei count, const GLuint *renderbuffers)
+{
+  for (GLsizei i = 0; currentTracker && i < count; ++i) {
+    currentTracker->remove(GL_RENDERBUFFER, renderbuffers[i]);
+  }
+}
+
+bool queryDriverMemory(DriverMemoryInfo &info)
+{
+  info = DriverMemoryInfo{};
+  // Both report kilobytes
+  const auto hasNvx = hasGLExtension("GL_NVX_gpu_memory_info");
+  if (hasNvx) {
+    GLint kilobytes = 0;
+    glGetIntegerv(GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &kilobytes);
+    info.dedicatedBytes = size_t(kilobytes) * 1024;
+    glGetIntegerv(GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &kilobytes);
+    info.totalAvailableBytes = size_t(kilobytes) * 1024;
+    glGetIntegerv(GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &kilobytes);
+    info.currentAvailableBytes = size_t(kilobytes) * 1024;
+  }
+  const auto hasAti = hasGLExtension("GL_ATI_meminfo");
+  if (hasAti) {
+    // Total free, largest free block, total and largest free auxiliary
+    // memory
+    GLint kilobytes[4] = {};
+    glGetIntegerv(VBO_FREE_MEMORY_ATI, kilobytes);
+    info.freeBufferBytes = size_t(kilobytes[0]) * 1024;
+    glGetIntegerv(TEXTURE_FREE_MEMORY_ATI, kilobytes);
+    info.freeTextureBytes = size_t(kilobytes[0]) * 1024;
+    glGetIntegerv(RENDERBUFFER_FREE_MEMORY_ATI, kilobytes);
+    info.freeRenderbufferBytes = size_t(kilobytes[0]) * 1024;
+  }
+  return hasNvx || hasAti;
+}
+
+void printDriverMemory()
+{
+  DriverMemoryInfo info;
+  if (!queryDriverMemory(info)) {
+    std::clog << "GPU memory not reported by the driver" << std::endl;
+    return;
+  }
+  if (info.dedicatedBytes) {
+    std::clog << "GPU memory " << (info.dedicatedBytes >> 20)
+              << " MiB dedicated, " << (info.totalAvailableBytes >> 20)
+              << " MiB available in total, "
+              << (info.currentAvailableBytes >> 20) << " MiB free"
+              << std::endl;
+  }
+  if (info.freeTextureBytes || info.freeBufferBytes) {
+    std::clog << "GPU memory free " << (info.freeBufferBytes >> 20)
+              << " MiB for buffers, " << (info.freeTextureBytes >> 20)
+              << " MiB for textures, " << (info.freeRenderbufferBytes >> 20)
+              << " MiB for renderbuffers" << std::endl;
+  }
+}
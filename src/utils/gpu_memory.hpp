@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <utility>
+
+// What the GPU memory of a tracked object is used for
+enum class GpuMemoryCategory
+{
+  Geometry, // Vertex and index buffers
+  Textures, // Textures of images, sampled by materials
+  DrawData, // Materials, draws, indirect commands and uniforms
+  RenderTargets, // Attachments of framebuffers
+  Transfers, // Pixel buffers of uploads and readbacks
+  Pooled, // Released by a scene, kept for the next one (see GLResourcePool)
+  Count
+};
+
+const char *getGpuMemoryCategoryName(GpuMemoryCategory category);
+
+// Bytes of the storage of a buffer, texture or renderbuffer, queried from the
+// current context. Bindings are left as they were.
+size_t getBufferByteSize(GLuint buffer);
+size_t getTextureByteSize(GLenum target, GLuint texture);
+size_t getRenderbufferByteSize(GLuint renderbuffer);
+
+// GPU memory of the GL objects of a share group, by category, as the sizes
+// of their storage (drivers may pad or compress them). Objects are tracked
+// with the trackBuffers, trackTextures and trackRenderbuffers functions of
+// the threads the tracker is current on (see Scope), which can differ: it is
+// thread safe. Framebuffers and vertex arrays own no storage, their
+// attachments are tracked instead.
+//
+// Once the total exceeds a budget, a warning is written to std::cerr, again
+// once it went below it.
+class GpuMemoryTracker
+{
+public:
+  using CategoryBytes =
+      std::array<size_t, size_t(GpuMemoryCategory::Count)>;
+
+  // Make a tracker current on this thread while in scope, or none if null
+  class Scope
+  {
+  public:
+    explicit Scope(GpuMemoryTracker *tracker);
+
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    GpuMemoryTracker *m_previous;
+  };
+
+  // budgetBytes of 0 for no budget
+  explicit GpuMemoryTracker(size_t budgetBytes = 0);
+
+  // Tracker current on this thread, null if none
+  static GpuMemoryTracker *current();
+
+  // Account for the GL object of type (GL_BUFFER, GL_TEXTURE or
+  // GL_RENDERBUFFER) name, replacing its previous size if it is tracked
+  void add(GpuMemoryCategory category, GLenum type, GLuint name,
+      size_t byteSize);
+
+  // Stop accounting for it, nothing if it is not tracked
+  void remove(GLenum type, GLuint name);
+
+  CategoryBytes categoryBytes() const;
+
+  size_t totalBytes() const;
+
+  size_t budgetBytes() const { return m_budgetBytes; }
+
+private:
+  struct TrackedObject
+  {
+    GpuMemoryCategory category = GpuMemoryCategory::Geometry;
+    size_t byteSize = 0;
+  };
+
+  const size_t m_budgetBytes;
+  mutable std::mutex m_mutex;
+  std::map<std::pair<GLenum, GLuint>, TrackedObject> m_objects;
+  CategoryBytes m_categoryBytes{};
+  size_t m_totalBytes = 0;
+  bool m_isOverBudget = false;
+};
+
+// Account for objects just allocated in the current context (0 names are
+// skipped) in the tracker current on this thread, nothing without one. Call
+// them again after reallocating their storage.
+void trackBuffers(
+    GpuMemoryCategory category, GLsizei count, const GLuint *buffers);
+void trackTextures(GpuMemoryCategory category, GLenum target, GLsizei count,
+    const GLuint *textures);
+void trackRenderbuffers(
+    GpuMemoryCategory category, GLsizei count, const GLuint *renderbuffers);
+
+// Stop accounting for objects about to be deleted
+void untrackBuffers(GLsizei count, const GLuint *buffers);
+void untrackTextures(GLsizei count, const GLuint *textures);
+void untrackRenderbuffers(GLsizei count, const GLuint *renderbuffers);
+
+// Memory of the GPU reported by the driver with GL_NVX_gpu_memory_info or
+// GL_ATI_meminfo, whose values include the allocations of other processes
+struct DriverMemoryInfo
+{
+  // GL_NVX_gpu_memory_info, 0 without it
+  size_t dedicatedBytes = 0; // Video memory of the GPU
+  size_t totalAvailableBytes = 0; // Video and system memory for the GPU
+  size_t currentAvailableBytes = 0; // Video memory still free
+  // GL_ATI_meminfo, free memory of the pool of each use, 0 without it
+  size_t freeBufferBytes = 0;
+  size_t freeTextureBytes = 0;
+  size_t freeRenderbufferBytes = 0;
+};
+
+// False if the current context exposes neither extension
+bool queryDriverMemory(DriverMemoryInfo &info);
+
+// Write the memory queryDriverMemory reports to std::clog, or that the
+// context does not report it
+void printDriverMemory();
@@ -0,0 +1,104 @@
+#include "gpu_reduction.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// Threads of a workgroup of reduce_bounds.cs.glsl, and positions read by
+// each of them, more in ranges of more than MAX_WORKGROUP_COUNT workgroups
+const size_t WORKGROUP_SIZE = 256;
+const size_t VERTICES_PER_THREAD = 16;
+const size_t MAX_WORKGROUP_COUNT = 1024;
+
+// Inverse of the ordered bits of reduce_bounds.cs.glsl
+float getOrderedFloat(uint32_t bits)
+{
+  bits = bits & 0x80000000u ? bits & 0x7fffffffu : ~bits;
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+GpuReduction::GpuReduction(GLProgram boundsProgram) :
+    m_boundsProgram(std::move(boundsProgram)),
+    m_boundsBuffer(GLBuffer::generate())
+{
+  for (const auto &block : {std::make_pair("Vertices", VERTICES_BINDING),
+           std::make_pair("Bounds", BOUNDS_BINDING)}) {
+    const auto blockIndex = glGetProgramResourceIndex(
+        m_boundsProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glShaderStorageBlockBinding(
+          m_boundsProgram.glId(), blockIndex, block.second);
+    }
+  }
+  m_uFirstWord = m_boundsProgram.getUniformLocation("uFirstWord");
+  m_uWordStride = m_boundsProgram.getUniformLocation("uWordStride");
+  m_uVertexCount = m_boundsProgram.getUniformLocation("uVertexCount");
+  m_uRange = m_boundsProgram.getUniformLocation("uRange");
+}
+
+std::vector<BoundingBox> GpuReduction::reduceBounds(
+    const std::vector<PositionRange> &ranges)
+{
+  std::vector<BoundingBox> bounds(ranges.size());
+  if (ranges.empty()) {
+    return bounds;
+  }
+  // Ordered bits of the min then max of each range, cleared to an empty box
+  const auto byteSize = ranges.size() * 6 * sizeof(uint32_t);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer.glId());
+  if (ranges.size() > m_boundsCapacity) {
+    m_boundsCapacity = std::max(ranges.size(), 2 * m_boundsCapacity);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+        m_boundsCapacity * 6 * sizeof(uint32_t), nullptr, GL_DYNAMIC_READ);
+  }
+  std::vector<uint32_t> values(6 * ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    std::fill_n(&values[6 * i], 3, 0xffffffffu);
+    std::fill_n(&values[6 * i + 3], 3, 0u);
+  }
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, byteSize, values.data());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, m_boundsBuffer.glId());
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_boundsProgram.use();
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    const auto &range = ranges[i];
+    if (!range.vertexCount || !range.buffer) {
+      continue;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTICES_BINDING, range.buffer);
+    glUniform1ui(m_uFirstWord, GLuint(range.byteOffset / 4));
+    glUniform1ui(m_uWordStride, GLuint(range.byteStride / 4));
+    glUniform1ui(m_uVertexCount, GLuint(range.vertexCount));
+    glUniform1ui(m_uRange, GLuint(i));
+    const auto workgroupCount = std::min(MAX_WORKGROUP_COUNT,
+        (range.vertexCount + WORKGROUP_SIZE * VERTICES_PER_THREAD - 1) /
+            (WORKGROUP_SIZE * VERTICES_PER_THREAD));
+    glDispatchCompute(GLuint(workgroupCount), 1, 1);
+  }
+  glUseProgram(GLuint(previousProgram));
+
+  // glBindBufferBase bound the vertex buffers to the generic binding too
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_boundsBuffer.glId());
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, byteSize, values.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (values[6 * i] == 0xffffffffu) {
+      continue; // No vertex
+    }
+    for (glm::length_t c = 0; c < 3; ++c) {
+      bounds[i].min[c] = getOrderedFloat(values[6 * i + c]);
+      bounds[i].max[c] = getOrderedFloat(values[6 * i + 3 + c]);
+    }
+  }
+  return bounds;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Parallel reductions by compute shaders of data already on the GPU, instead
+// of scans of their copy on the CPU (--gpu-bounds).
+//
+// reduceBounds computes the boxes of the float positions of vertex buffers
+// with reduce_bounds.cs.glsl: each workgroup reduces the positions read by
+// its threads in shared memory, then merges its box into the one of its range
+// with atomics, on floats mapped to unsigned integers of the same order. The
+// boxes are read back once all ranges are dispatched, which waits for the
+// GPU: they are small, but the draws before must be done.
+class GpuReduction
+{
+public:
+  // Storage buffers of reduce_bounds.cs.glsl, after those of PointClouds
+  static const GLuint VERTICES_BINDING = 17;
+  static const GLuint BOUNDS_BINDING = 18;
+
+  // vertexCount positions of three floats in buffer, at byteOffset plus
+  // byteStride for each vertex, both multiples of 4
+  struct PositionRange
+  {
+    GLuint buffer;
+    GLintptr byteOffset;
+    GLsizei byteStride;
+    size_t vertexCount;
+  };
+
+  // program is reduce_bounds.cs.glsl
+  explicit GpuReduction(GLProgram boundsProgram);
+
+  GpuReduction(const GpuReduction &) = delete;
+
+  GpuReduction &operator=(const GpuReduction &) = delete;
+
+  // True if positions at byteOffset with byteStride can be read by a
+  // PositionRange
+  static bool isAligned(size_t byteOffset, size_t byteStride)
+  {
+    return byteOffset % 4 == 0 && byteStride % 4 == 0;
+  }
+
+  // Box of the positions of each range, empty for ranges without vertices
+  std::vector<BoundingBox> reduceBounds(
+      const std::vector<PositionRange> &ranges);
+
+private:
+  GLProgram m_boundsProgram;
+  GLint m_uFirstWord = -1;
+  GLint m_uWordStride = -1;
+  GLint m_uVertexCount = -1;
+  GLint m_uRange = -1;
+  GLBuffer m_boundsBuffer;
+  size_t m_boundsCapacity = 0; // Of ranges
+};
@@ -0,0 +1,53 @@
+#include "image_decoder.hpp"
+#include "gltf.hpp"
+
+#include <iostream>
+
+BackgroundImageDecoder::BackgroundImageDecoder(
+    tinygltf::Model &model, std::vector<RemoteRange> remoteImages) :
+    m_model(model), m_remoteImages(std::move(remoteImages))
+{
+  for (size_t i = 0; i < m_model.images.size(); ++i) {
+    m_jobs.emplace_back(JobSystem::global().add([this, i]() {
+      if (m_cancel) {
+        return;
+      }
+      std::string err;
+      auto &image = m_model.images[i];
+      if (i < m_remoteImages.size() && !m_remoteImages[i].url.empty()) {
+        // In place of the placeholder parsed from the remote file
+        std::vector<std::vector<unsigned char>> contents;
+        fetchRemoteRanges({m_remoteImages[i]}, contents, err);
+        image.image.swap(contents.front());
+      }
+      if (!err.empty() || !decodeImage(image, int(i), err)) {
+        std::cerr << "Error : " << err << std::endl;
+      }
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_decodedImages.emplace_back(int(i));
+    }));
+  }
+}
+
+BackgroundImageDecoder::~BackgroundImageDecoder()
+{
+  m_cancel = true;
+  for (const auto &job : m_jobs) {
+    JobSystem::global().wait(job);
+  }
+}
+
+std::vector<int> BackgroundImageDecoder::popDecodedImages()
+{
+  std::vector<int> images;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  images.swap(m_decodedImages);
+  m_poppedImageCount += images.size();
+  return images;
+}
+
+bool BackgroundImageDecoder::done() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_poppedImageCount == m_model.images.size();
+}
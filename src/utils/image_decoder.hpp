@@ -0,0 +1,53 @@
+#pragma once
+
+#include "job_system.hpp"
+#include "remote_gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// Decode in background the images of a model kept encoded by
+// storeEncodedImage (see gltf.hpp), one job of the global JobSystem per
+// image. The GL thread polls the images decoded so
+// far with popDecodedImages() and uploads them, so the scene can be drawn
+// before all textures are available.
+//
+// model.images must not be accessed from other threads, except for the images
+// returned by popDecodedImages().
+//
+// The images with a url in remoteImages (see RemoteGltf::deferredImages) are
+// first fetched by their job.
+class BackgroundImageDecoder
+{
+public:
+  explicit BackgroundImageDecoder(tinygltf::Model &model,
+      std::vector<RemoteRange> remoteImages = {});
+
+  // Stop decoding images that are not started yet and wait for the others
+  ~BackgroundImageDecoder();
+
+  BackgroundImageDecoder(const BackgroundImageDecoder &) = delete;
+
+  BackgroundImageDecoder &operator=(const BackgroundImageDecoder &) = delete;
+
+  // Indices of the images decoded since the previous call. Images that failed
+  // to decode are reported too (with an empty image.image), so that every
+  // image is returned exactly once.
+  std::vector<int> popDecodedImages();
+
+  // True when every image has been returned by popDecodedImages()
+  bool done() const;
+
+private:
+  tinygltf::Model &m_model;
+  const std::vector<RemoteRange> m_remoteImages;
+  std::atomic<bool> m_cancel{false};
+  std::vector<JobSystem::Handle> m_jobs;
+
+  mutable std::mutex m_mutex;
+  std::vector<int> m_decodedImages;
+  size_t m_poppedImageCount = 0;
+};
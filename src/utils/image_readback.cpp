@@ -0,0 +1,200 @@
+#include "image_readback.hpp"
+#include "gpu_memory.hpp"
+#include "image_writer.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <tuple>
+
+namespace {
+
+// Split the draw IDs and geometry read back after the color of an image into
+// the arrays of its AOVs, named after it
+bool writeAovs(const fs::path &imagePath, size_t width, size_t height,
+    const unsigned char *pixels)
+{
+  const auto pixelCount = width * height;
+  const auto *geometry = reinterpret_cast<const float *>(
+      pixels + pixelCount * sizeof(uint32_t));
+  std::vector<float> normals(3 * pixelCount);
+  std::vector<float> depths(pixelCount);
+  for (size_t i = 0; i < pixelCount; ++i) {
+    std::memcpy(normals.data() + 3 * i, geometry + 4 * i, 3 * sizeof(float));
+    depths[i] = geometry[4 * i + 3];
+  }
+  const auto stem = imagePath.parent_path() / imagePath.stem();
+  auto written = true;
+  for (const auto &array :
+      {std::make_tuple(".ids.npy", "<u4", size_t(1), (const void *)pixels),
+          std::make_tuple(
+              ".normals.npy", "<f4", size_t(3), (const void *)normals.data()),
+          std::make_tuple(
+              ".depth.npy", "<f4", size_t(1), (const void *)depths.data())}) {
+    const auto path = stem.string() + std::get<0>(array);
+    std::vector<size_t> shape = {height, width};
+    if (std::get<2>(array) > 1) {
+      shape.push_back(std::get<2>(array));
+    }
+    // Rows read back from OpenGL are bottom-up
+    if (!writeNpy(path, std::get<1>(array), shape, std::get<3>(array), true)) {
+      std::cerr << "Error : unable to write " << path << std::endl;
+      written = false;
+    }
+  }
+  return written;
+}
+
+} // namespace
+
+AsyncImageRenderer::AsyncImageRenderer(size_t width, size_t height,
+    bool floatPixels, size_t bufferCount, size_t sampleCount, bool aovs) :
+    m_framebuffer(width, height, getOffscreenColorFormat(floatPixels),
+        sampleCount, aovs, aovs),
+    // Tightly packed rows, see OffscreenFramebuffer::readColor, then an
+    // uint32_t ID and 4 floats of geometry per pixel
+    m_pixelsSize(width * height *
+                 (m_framebuffer.colorPixelSize() +
+                     (aovs ? sizeof(uint32_t) + 4 * sizeof(float) : 0))),
+    m_colorSize(width * height * m_framebuffer.colorPixelSize()),
+    m_aovs(aovs),
+    m_pixelBuffers(std::max(bufferCount, size_t(1)))
+{
+  const auto byteSize = GLsizeiptr(m_pixelsSize);
+  for (auto &buffer : m_pixelBuffers) {
+    glGenBuffers(1, &buffer.bufferObject);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject);
+    glBufferStorage(GL_PIXEL_PACK_BUFFER, byteSize, nullptr, GL_MAP_READ_BIT);
+    trackBuffers(GpuMemoryCategory::Transfers, 1, &buffer.bufferObject);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  m_thread = std::thread([this, width, height]() {
+    for (;;) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [&]() { return m_stop || !m_images.empty(); });
+      if (m_images.empty()) {
+        return;
+      }
+      auto image = std::move(m_images.front());
+      m_images.pop_front();
+      lock.unlock();
+
+      // Rows read back from OpenGL are bottom-up
+      const TraceZone zone("writeImage");
+      const auto written =
+          image.video ? image.video->writeFrame(image.pixels.data())
+                      : writeImage(image.outputPath, width, height,
+                            image.pixels.data(), true);
+      if (!written) {
+        std::cerr << "Error : unable to write " << image.outputPath.string()
+                  << std::endl;
+      }
+      const auto aovsWritten =
+          !m_aovs || writeAovs(image.outputPath, width, height,
+                         image.pixels.data() + m_colorSize);
+
+      lock.lock();
+      m_hasFailed = m_hasFailed || !written || !aovsWritten;
+      --m_pendingImageCount;
+      m_condition.notify_all();
+    }
+  });
+}
+
+AsyncImageRenderer::~AsyncImageRenderer()
+{
+  finish();
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_all();
+  m_thread.join();
+
+  for (const auto &buffer : m_pixelBuffers) {
+    untrackBuffers(1, &buffer.bufferObject);
+    glDeleteBuffers(1, &buffer.bufferObject);
+  }
+}
+
+void AsyncImageRenderer::render(
+    const fs::path &outputPath, const std::function<void()> &drawScene)
+{
+  // The oldest frame, its copy has had the most time to complete
+  auto &buffer = m_pixelBuffers[m_nextPixelBuffer];
+  m_nextPixelBuffer = (m_nextPixelBuffer + 1) % m_pixelBuffers.size();
+  if (buffer.fence) {
+    readBack(buffer);
+  }
+
+  m_framebuffer.render(drawScene);
+
+  // With a pack buffer bound, glGetTexImage writes at an offset in it and
+  // returns without waiting for the GPU
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject);
+  m_framebuffer.readColor(nullptr);
+  if (m_aovs) {
+    const auto pixelCount = m_framebuffer.width() * m_framebuffer.height();
+    m_framebuffer.readDrawIds(reinterpret_cast<void *>(m_colorSize));
+    m_framebuffer.readGeometry(reinterpret_cast<void *>(
+        m_colorSize + pixelCount * sizeof(uint32_t)));
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  buffer.outputPath = outputPath;
+  buffer.video = m_video;
+}
+
+bool AsyncImageRenderer::finish()
+{
+  // In the order frames were rendered
+  for (size_t i = 0; i < m_pixelBuffers.size(); ++i) {
+    auto &buffer =
+        m_pixelBuffers[(m_nextPixelBuffer + i) % m_pixelBuffers.size()];
+    if (buffer.fence) {
+      readBack(buffer);
+    }
+  }
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_condition.wait(lock, [&]() { return m_pendingImageCount == 0; });
+  const auto hasFailed = m_hasFailed;
+  m_hasFailed = false;
+  return !hasFailed;
+}
+
+void AsyncImageRenderer::readBack(PixelBuffer &buffer)
+{
+  const TraceZone zone("readBack");
+  glClientWaitSync(
+      buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  glDeleteSync(buffer.fence);
+  buffer.fence = nullptr;
+
+  FramePixels image{std::move(buffer.outputPath),
+      std::vector<unsigned char>(m_pixelsSize), buffer.video};
+  const auto byteSize = GLsizeiptr(image.pixels.size());
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.bufferObject);
+  const auto *data =
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, byteSize, GL_MAP_READ_BIT);
+  if (data) {
+    std::memcpy(image.pixels.data(), data, image.pixels.size());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!data) {
+    std::cerr << "Error : unable to map the pixels of "
+              << image.outputPath.string() << std::endl;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_hasFailed = true;
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_images.push_back(std::move(image));
+    ++m_pendingImageCount;
+  }
+  m_condition.notify_all();
+}
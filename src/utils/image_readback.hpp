@@ -0,0 +1,101 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "images.hpp"
+#include "video_writer.hpp"
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Render frames in an OffscreenFramebuffer like renderToImage (see
+// images.hpp) and write them with writeImage (see image_writer.hpp), without
+// waiting for the GPU after each frame.
+//
+// A frame is copied into one of bufferCount pixel pack buffers: glGetTexImage
+// then returns immediately and a fence is put after the copy. The buffer is
+// only mapped when it is needed again, bufferCount frames later, while the
+// next frames render. The pixels are then encoded on a worker thread.
+//
+// Frames are rendered and read back in the format of getOffscreenColorFormat,
+// with floatPixels for float image formats (see isFloatImageFormat). They are
+// antialiased with a sampleCount above 1 (see OffscreenFramebuffer).
+//
+// With aovs (--output-aovs), single sampled frames also have draw IDs and
+// geometry attachments, read back in the same buffers. Next to each image
+// are written the NumPy arrays <name>.ids.npy of the draws of the pixels (1 +
+// their index, 0 for none, uint32), <name>.normals.npy of their view space
+// normals (3 float32) and <name>.depth.npy of their distance along the view
+// axis (float32, 0 for none), top row first.
+//
+// Frames can also be written as the frames of a video (see VideoWriter), in
+// the order they are rendered.
+class AsyncImageRenderer
+{
+public:
+  AsyncImageRenderer(size_t width, size_t height, bool floatPixels = false,
+      size_t bufferCount = 3, size_t sampleCount = 1, bool aovs = false);
+
+  // Write the pending frames then release GL objects
+  ~AsyncImageRenderer();
+
+  AsyncImageRenderer(const AsyncImageRenderer &) = delete;
+
+  AsyncImageRenderer &operator=(const AsyncImageRenderer &) = delete;
+
+  // Call drawScene(), with the same requirements as renderToImage, then queue
+  // the readback of the frame to outputPath. May wait for the readback of an
+  // earlier frame.
+  void render(
+      const fs::path &outputPath, const std::function<void()> &drawScene);
+
+  // Return once every rendered frame is written, false if one of those
+  // rendered since the previous call could not be
+  bool finish();
+
+  // Write the frames rendered next to video instead of their output path,
+  // byte pixels without aovs only, or to their path again with null. video
+  // must outlive their writing.
+  void setVideoWriter(VideoWriter *video) { m_video = video; }
+
+private:
+  struct PixelBuffer
+  {
+    GLuint bufferObject = 0;
+    GLsync fence = nullptr; // Signaled when the copy is done, null when free
+    fs::path outputPath;
+    VideoWriter *video = nullptr;
+  };
+
+  struct FramePixels
+  {
+    fs::path outputPath;
+    std::vector<unsigned char> pixels;
+    VideoWriter *video;
+  };
+
+  // Wait for the copy into buffer, hand the pixels to the worker thread and
+  // free buffer
+  void readBack(PixelBuffer &buffer);
+
+  OffscreenFramebuffer m_framebuffer;
+  size_t m_pixelsSize; // In bytes, of the color then of the AOVs if any
+  size_t m_colorSize;
+  bool m_aovs;
+  VideoWriter *m_video = nullptr;
+  std::vector<PixelBuffer> m_pixelBuffers;
+  size_t m_nextPixelBuffer = 0;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<FramePixels> m_images; // Read back, not written yet
+  size_t m_pendingImageCount = 0; // In m_images or being written
+  bool m_stop = false;
+  bool m_hasFailed = false; // Since the last finish()
+};
@@ -0,0 +1,885 @@
+#include "image_writer.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string getExtension(const fs::path &path)
+{
+  auto extension = path.extension().string();
+  std::transform(begin(extension), end(extension), begin(extension),
+      [](unsigned char c) { return char(std::tolower(c)); });
+  return extension;
+}
+
+void appendBigEndian32(std::vector<uint8_t> &bytes, uint32_t value)
+{
+  for (auto shift = 24; shift >= 0; shift -= 8) {
+    bytes.push_back(uint8_t(value >> shift));
+  }
+}
+
+template <typename T>
+void appendLittleEndian(std::vector<uint8_t> &bytes, T value)
+{
+  const auto offset = bytes.size();
+  bytes.resize(offset + sizeof(value));
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+void appendString(std::vector<uint8_t> &bytes, const char *string)
+{
+  bytes.insert(end(bytes), string, string + std::strlen(string) + 1);
+}
+
+// Rows of an image in file order, the top one first, whatever their order
+// in memory
+struct ImageRows
+{
+  const uint8_t *pixels;
+  size_t rowSize; // In bytes
+  size_t height;
+  bool isBottomUp;
+
+  const uint8_t *operator[](size_t y) const
+  {
+    return pixels + rowSize * (isBottomUp ? height - 1 - y : y);
+  }
+};
+
+// Deflate (RFC 1951) streams with the fixed Huffman codes and greedy LZ77
+// matching, written LSB first
+class BitWriter
+{
+public:
+  explicit BitWriter(std::vector<uint8_t> &bytes) : m_bytes(bytes) {}
+
+  void write(uint32_t bits, int count)
+  {
+    m_buffer |= uint64_t(bits) << m_count;
+    m_count += count;
+    for (; m_count >= 8; m_count -= 8) {
+      m_bytes.push_back(uint8_t(m_buffer));
+      m_buffer >>= 8;
+    }
+  }
+
+  void alignToByte()
+  {
+    if (m_count) {
+      write(0, 8 - m_count);
+    }
+  }
+
+private:
+  std::vector<uint8_t> &m_bytes;
+  uint64_t m_buffer = 0;
+  int m_count = 0;
+};
+
+const std::array<uint16_t, 29> lengthBases = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13,
+    15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195,
+    227, 258};
+const std::array<uint8_t, 29> lengthExtraBits = {0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const std::array<uint16_t, 30> distanceBases = {1, 2, 3, 4, 5, 7, 9, 13, 17,
+    25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+    4097, 6145, 8193, 12289, 16385, 24577};
+const std::array<uint8_t, 30> distanceExtraBits = {0, 0, 0, 0, 1, 1, 2, 2, 3,
+    3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// Fixed Huffman codes with their bits reversed, as they are packed starting
+// from their most significant bit, and the codes of match lengths and
+// distances
+struct FixedCodes
+{
+  std::array<uint16_t, 288> literalCodes;
+  std::array<uint8_t, 288> literalCodeLengths;
+  std::array<uint16_t, 30> distanceCodes;
+  std::array<uint8_t, 259> lengthSymbols; // Index in lengthBases
+  // Index in distanceBases of distance d: [d - 1] below 257, else
+  // [256 + ((d - 1) >> 7)], as zlib's d_code
+  std::array<uint8_t, 512> distanceSymbols;
+};
+
+uint16_t reverseBits(uint32_t code, int length)
+{
+  uint32_t reversed = 0;
+  for (auto i = 0; i < length; ++i) {
+    reversed |= ((code >> i) & 1) << (length - 1 - i);
+  }
+  return uint16_t(reversed);
+}
+
+const FixedCodes &getFixedCodes()
+{
+  static const auto codes = []() {
+    FixedCodes codes;
+    for (uint32_t symbol = 0; symbol < 288; ++symbol) {
+      const auto code = symbol < 144   ? std::make_pair(0x30 + symbol, 8)
+                        : symbol < 256 ? std::make_pair(0x190 + symbol - 144, 9)
+                        : symbol < 280 ? std::make_pair(symbol - 256, 7)
+                                       : std::make_pair(0xc0 + symbol - 280, 8);
+      codes.literalCodes[symbol] = reverseBits(code.first, code.second);
+      codes.literalCodeLengths[symbol] = uint8_t(code.second);
+    }
+    for (uint32_t symbol = 0; symbol < 30; ++symbol) {
+      codes.distanceCodes[symbol] = reverseBits(symbol, 5);
+    }
+    for (size_t length = 3, symbol = 0; length <= 258; ++length) {
+      while (symbol + 1 < lengthBases.size() &&
+             lengthBases[symbol + 1] <= length) {
+        ++symbol;
+      }
+      codes.lengthSymbols[length] = uint8_t(symbol);
+    }
+    for (size_t symbol = 0; symbol < distanceBases.size(); ++symbol) {
+      const auto endDistance = symbol + 1 < distanceBases.size()
+                                   ? size_t(distanceBases[symbol + 1])
+                                   : size_t(32769);
+      for (size_t distance = distanceBases[symbol]; distance < endDistance;
+           ++distance) {
+        const auto index =
+            distance <= 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+        codes.distanceSymbols[index] = uint8_t(symbol);
+      }
+    }
+    return codes;
+  }();
+  return codes;
+}
+
+// One non final block with the fixed codes, followed by an empty stored block
+// so that the next part of the stream starts on a byte: parts compressed
+// independently can be concatenated (as zlib's Z_SYNC_FLUSH)
+void deflateFixedBlock(
+    const uint8_t *data, size_t size, std::vector<uint8_t> &bytes)
+{
+  const size_t windowSize = 32768;
+  const size_t maxMatchLength = 258;
+  const size_t maxChainLength = 8; // Candidates tried for each match
+  const auto hashBits = 15;
+
+  const auto &codes = getFixedCodes();
+  BitWriter writer(bytes);
+  const auto writeLiteral = [&](uint32_t symbol) {
+    writer.write(codes.literalCodes[symbol], codes.literalCodeLengths[symbol]);
+  };
+  writer.write(0, 1); // BFINAL
+  writer.write(1, 2); // BTYPE, fixed Huffman codes
+
+  std::vector<int32_t> heads(size_t(1) << hashBits, -1);
+  std::vector<int32_t> previous(size);
+  const auto insert = [&](size_t position) {
+    if (position + 3 > size) {
+      return;
+    }
+    const auto key = uint32_t(data[position]) << 16 |
+                     uint32_t(data[position + 1]) << 8 | data[position + 2];
+    auto &head = heads[(key * 2654435761u) >> (32 - hashBits)];
+    previous[position] = head;
+    head = int32_t(position);
+  };
+
+  for (size_t i = 0; i < size;) {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    if (i + 3 <= size) {
+      const auto key = uint32_t(data[i]) << 16 | uint32_t(data[i + 1]) << 8 |
+                       data[i + 2];
+      const auto maxLength = std::min(maxMatchLength, size - i);
+      auto candidate = heads[(key * 2654435761u) >> (32 - hashBits)];
+      for (size_t chain = 0; candidate >= 0 && chain < maxChainLength &&
+                             i - size_t(candidate) <= windowSize;
+           ++chain, candidate = previous[candidate]) {
+        const auto *match = data + candidate;
+        // Can only be longer if it has the byte after the best match
+        if (match[bestLength] != data[i + bestLength]) {
+          continue;
+        }
+        size_t length = 0;
+        while (length < maxLength && match[length] == data[i + length]) {
+          ++length;
+        }
+        if (length > bestLength) {
+          bestLength = length;
+          bestDistance = i - size_t(candidate);
+          if (length == maxLength) {
+            break;
+          }
+        }
+      }
+    }
+
+    if (bestLength >= 3) {
+      const auto lengthSymbol = codes.lengthSymbols[bestLength];
+      writeLiteral(257 + lengthSymbol);
+      writer.write(uint32_t(bestLength - lengthBases[lengthSymbol]),
+          lengthExtraBits[lengthSymbol]);
+      const auto distanceSymbol =
+          codes.distanceSymbols[bestDistance <= 256
+                                    ? bestDistance - 1
+                                    : 256 + ((bestDistance - 1) >> 7)];
+      writer.write(codes.distanceCodes[distanceSymbol], 5);
+      writer.write(uint32_t(bestDistance - distanceBases[distanceSymbol]),
+          distanceExtraBits[distanceSymbol]);
+      for (const auto end = i + bestLength; i < end; ++i) {
+        insert(i);
+      }
+    } else {
+      writeLiteral(data[i]);
+      insert(i);
+      ++i;
+    }
+  }
+  writeLiteral(256); // End of block
+
+  writer.write(0, 3); // Empty stored block
+  writer.alignToByte();
+  writer.write(0x0000, 16);
+  writer.write(0xffff, 16);
+}
+
+uint32_t adler32(const uint8_t *data, size_t size)
+{
+  const uint32_t base = 65521;
+  uint32_t a = 1, b = 0;
+  while (size) {
+    // The sums can not overflow before 5552 bytes
+    const auto count = std::min(size, size_t(5552));
+    for (size_t i = 0; i < count; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= base;
+    b %= base;
+    data += count;
+    size -= count;
+  }
+  return b << 16 | a;
+}
+
+// Adler-32 of the concatenation of two parts, the second of size secondSize
+uint32_t combineAdler32(uint32_t first, uint32_t second, size_t secondSize)
+{
+  const uint64_t base = 65521;
+  const auto remainder = secondSize % base;
+  const auto a = ((first & 0xffff) + (second & 0xffff) + base - 1) % base;
+  const auto b = ((first >> 16) + (second >> 16) +
+                     remainder * (first & 0xffff) + base - remainder) %
+                 base;
+  return uint32_t(b << 16 | a);
+}
+
+uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+  static const auto table = []() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t i = 0; i < 256; ++i) {
+      auto value = i;
+      for (auto k = 0; k < 8; ++k) {
+        value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+      }
+      table[i] = value;
+    }
+    return table;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+void writeBytes(std::ostream &output, const std::vector<uint8_t> &bytes)
+{
+  output.write(reinterpret_cast<const char *>(bytes.data()),
+      std::streamsize(bytes.size()));
+}
+
+void writePngChunk(std::ostream &output, const char *type,
+    const std::vector<uint8_t> &data)
+{
+  std::vector<uint8_t> header;
+  appendBigEndian32(header, uint32_t(data.size()));
+  header.insert(end(header), type, type + 4);
+  writeBytes(output, header);
+  writeBytes(output, data);
+  std::vector<uint8_t> crc;
+  appendBigEndian32(crc,
+      crc32(data.data(), data.size(),
+          crc32(reinterpret_cast<const uint8_t *>(type), 4)));
+  writeBytes(output, crc);
+}
+
+int paethPredictor(int a, int b, int c)
+{
+  const auto p = a + b - c;
+  const auto pa = std::abs(p - a);
+  const auto pb = std::abs(p - b);
+  const auto pc = std::abs(p - c);
+  return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+// Rows [firstRow, endRow) each prefixed with the filter type minimizing the
+// sum of their filtered bytes as signed values. previousRow is the row above
+// rows[0], null for the top of the image.
+void filterPngRows(const ImageRows &rows, size_t firstRow, size_t endRow,
+    const uint8_t *previousRow, std::vector<uint8_t> &filtered)
+{
+  const auto rowSize = rows.rowSize;
+  const std::vector<uint8_t> zeros(rowSize + 3, 0);
+  if (!previousRow) {
+    previousRow = zeros.data();
+  }
+  std::array<std::vector<uint8_t>, 5> candidates;
+  for (auto &candidate : candidates) {
+    candidate.resize(rowSize);
+  }
+  std::array<uint8_t *, 5> filteredRows;
+  for (size_t filter = 0; filter < candidates.size(); ++filter) {
+    filteredRows[filter] = candidates[filter].data();
+  }
+  // Bytes of the pixel on the left are 0 for the first pixel of a row
+  std::vector<uint8_t> line(rowSize + 3, 0), above(rowSize + 3, 0);
+  for (auto row = firstRow; row < endRow; ++row) {
+    std::memcpy(line.data() + 3, rows[row], rowSize);
+    std::memcpy(above.data() + 3, row ? rows[row - 1] : previousRow, rowSize);
+    std::array<size_t, 5> scores = {};
+    for (size_t i = 0; i < rowSize; ++i) {
+      const int x = line[i + 3];
+      const int a = line[i];
+      const int b = above[i + 3];
+      const int c = above[i];
+      const std::array<uint8_t, 5> values = {uint8_t(x), uint8_t(x - a),
+          uint8_t(x - b), uint8_t(x - (a + b) / 2),
+          uint8_t(x - paethPredictor(a, b, c))};
+      for (size_t filter = 0; filter < values.size(); ++filter) {
+        filteredRows[filter][i] = values[filter];
+        scores[filter] += size_t(std::abs(int(int8_t(values[filter]))));
+      }
+    }
+    const auto bestFilter = size_t(
+        std::min_element(begin(scores), end(scores)) - begin(scores));
+    filtered.push_back(uint8_t(bestFilter));
+    filtered.insert(end(filtered), begin(candidates[bestFilter]),
+        end(candidates[bestFilter]));
+  }
+}
+
+} // namespace
+
+// Writes one format, rows are given in file order
+class ImageEncoder
+{
+public:
+  ImageEncoder(size_t width, size_t height) : m_width(width), m_height(height)
+  {
+  }
+
+  virtual ~ImageEncoder() = default;
+
+  // Header of the file
+  virtual void writeHeader(std::ostream &output) = 0;
+
+  // Rows below those of the previous calls
+  virtual void encodeRows(std::ostream &output, const ImageRows &rows) = 0;
+
+  // After the last row
+  virtual void writeEnd(std::ostream &) {}
+
+protected:
+  size_t m_width;
+  size_t m_height;
+};
+
+namespace {
+
+// Bands of rows are filtered and deflated on all cores, each in its own IDAT
+// chunk, parts of a single zlib stream
+class PngEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    std::vector<uint8_t> header;
+    appendBigEndian32(header, uint32_t(m_width));
+    appendBigEndian32(header, uint32_t(m_height));
+    header.insert(end(header), {8, 2, 0, 0, 0}); // 8 bits RGB, not interlaced
+
+    writeBytes(output, {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'});
+    writePngChunk(output, "IHDR", header);
+    writePngChunk(output, "IDAT", {0x78, 0x01}); // Deflate, 32 KB window
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    const auto rowSize = rows.rowSize;
+    const auto height = rows.height;
+    // Bands of at least 256 KB, so that splitting them costs little
+    // compression
+    const auto rowsPerBand =
+        std::max(size_t(1), (size_t(1) << 18) / std::max(rowSize, size_t(1)));
+    const auto bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+    std::vector<std::vector<uint8_t>> deflatedBands(bandCount);
+    std::vector<uint32_t> bandAdlers(bandCount);
+    std::vector<size_t> bandSizes(bandCount);
+    const auto *previousRow =
+        m_previousRow.empty() ? nullptr : m_previousRow.data();
+    parallelFor(bandCount, [&](size_t band) {
+      std::vector<uint8_t> filtered;
+      const auto firstRow = band * rowsPerBand;
+      const auto endRow = std::min(height, firstRow + rowsPerBand);
+      filtered.reserve((endRow - firstRow) * (rowSize + 1));
+      filterPngRows(rows, firstRow, endRow, previousRow, filtered);
+      deflateFixedBlock(filtered.data(), filtered.size(), deflatedBands[band]);
+      bandAdlers[band] = adler32(filtered.data(), filtered.size());
+      bandSizes[band] = filtered.size();
+    });
+
+    for (size_t band = 0; band < bandCount; ++band) {
+      writePngChunk(output, "IDAT", deflatedBands[band]);
+      m_adler = combineAdler32(m_adler, bandAdlers[band], bandSizes[band]);
+    }
+    if (height) {
+      m_previousRow.assign(rows[height - 1], rows[height - 1] + rowSize);
+    }
+  }
+
+  void writeEnd(std::ostream &output) override
+  {
+    std::vector<uint8_t> streamEnd = {0x03, 0x00}; // Final empty fixed block
+    appendBigEndian32(streamEnd, m_adler);
+    writePngChunk(output, "IDAT", streamEnd);
+    writePngChunk(output, "IEND", {});
+  }
+
+private:
+  uint32_t m_adler = adler32(nullptr, 0);
+  std::vector<uint8_t> m_previousRow; // Last row written, for the filters
+};
+
+class PpmEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    output << "P6\n" << m_width << " " << m_height << "\n255\n";
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    for (size_t y = 0; y < rows.height; ++y) {
+      output.write(reinterpret_cast<const char *>(rows[y]),
+          std::streamsize(rows.rowSize));
+    }
+  }
+};
+
+// See https://qoiformat.org/qoi-specification.pdf
+class QoiEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    std::vector<uint8_t> header = {'q', 'o', 'i', 'f'};
+    appendBigEndian32(header, uint32_t(m_width));
+    appendBigEndian32(header, uint32_t(m_height));
+    header.insert(end(header), {3, 0}); // RGB, sRGB
+    writeBytes(output, header);
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    std::vector<uint8_t> bytes;
+    const auto pixelCount = m_width * m_height;
+    const auto endPixel = m_nextPixel + m_width * rows.height;
+    for (auto i = m_nextPixel; i < endPixel; ++i) {
+      const auto *color = rows[(i - m_nextPixel) / m_width] + 3 * (i % m_width);
+      const Pixel pixel = {color[0], color[1], color[2], 255};
+      if (pixel == m_previous) {
+        if (++m_run == 62 || i + 1 == pixelCount) {
+          bytes.push_back(uint8_t(0xc0 | (m_run - 1))); // QOI_OP_RUN
+          m_run = 0;
+        }
+        continue;
+      }
+      if (m_run) {
+        bytes.push_back(uint8_t(0xc0 | (m_run - 1)));
+        m_run = 0;
+      }
+      const auto hash =
+          (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + 255 * 11) % 64;
+      if (m_seenPixels[hash] == pixel) {
+        bytes.push_back(uint8_t(hash)); // QOI_OP_INDEX
+      } else {
+        m_seenPixels[hash] = pixel;
+        const auto dr = int8_t(pixel[0] - m_previous[0]);
+        const auto dg = int8_t(pixel[1] - m_previous[1]);
+        const auto db = int8_t(pixel[2] - m_previous[2]);
+        const auto drg = dr - dg;
+        const auto dbg = db - dg;
+        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 &&
+            db <= 1) {
+          bytes.push_back(uint8_t(
+              0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))); // DIFF
+        } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 &&
+                   dbg >= -8 && dbg <= 7) {
+          bytes.push_back(uint8_t(0x80 | (dg + 32))); // QOI_OP_LUMA
+          bytes.push_back(uint8_t((drg + 8) << 4 | (dbg + 8)));
+        } else {
+          bytes.insert(
+              end(bytes), {0xfe, pixel[0], pixel[1], pixel[2]}); // QOI_OP_RGB
+        }
+      }
+      m_previous = pixel;
+    }
+    m_nextPixel = endPixel;
+    writeBytes(output, bytes);
+  }
+
+  void writeEnd(std::ostream &output) override
+  {
+    writeBytes(output, {0, 0, 0, 0, 0, 0, 0, 1});
+  }
+
+private:
+  using Pixel = std::array<uint8_t, 4>;
+
+  std::array<Pixel, 64> m_seenPixels{};
+  Pixel m_previous = {0, 0, 0, 255};
+  size_t m_run = 0;
+  size_t m_nextPixel = 0;
+};
+
+// Uncompressed true color, top-left origin
+class TgaEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    std::vector<uint8_t> header = {0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    appendLittleEndian(header, uint16_t(m_width));
+    appendLittleEndian(header, uint16_t(m_height));
+    header.insert(end(header), {24, 0x20});
+    writeBytes(output, header);
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    std::vector<uint8_t> line(rows.rowSize);
+    for (size_t y = 0; y < rows.height; ++y) {
+      const auto *colors = rows[y];
+      for (size_t i = 0; i < rows.rowSize; i += 3) {
+        line[i] = colors[i + 2];
+        line[i + 1] = colors[i + 1];
+        line[i + 2] = colors[i];
+      }
+      writeBytes(output, line);
+    }
+  }
+};
+
+// 24 bits BITMAPINFOHEADER, rows are stored bottom-up and padded to 4 bytes:
+// each row is written at its place in the file
+class BmpEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    const auto imageSize = paddedRowSize() * m_height;
+    std::vector<uint8_t> header = {'B', 'M'};
+    appendLittleEndian(header, uint32_t(headerSize + imageSize));
+    appendLittleEndian(header, uint32_t(0));
+    appendLittleEndian(header, uint32_t(headerSize)); // Offset of the pixels
+    appendLittleEndian(header, uint32_t(40)); // Size of the info header
+    appendLittleEndian(header, int32_t(m_width));
+    appendLittleEndian(header, int32_t(m_height));
+    appendLittleEndian(header, uint16_t(1)); // Planes
+    appendLittleEndian(header, uint16_t(24)); // Bits per pixel
+    appendLittleEndian(header, uint32_t(0)); // BI_RGB
+    appendLittleEndian(header, uint32_t(imageSize));
+    for (auto i = 0; i < 4; ++i) { // Resolution and palette
+      appendLittleEndian(header, uint32_t(0));
+    }
+    writeBytes(output, header);
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    // From the bottom row, the one closest to the start of the file
+    std::vector<uint8_t> line(paddedRowSize(), 0);
+    for (size_t y = rows.height; y-- > 0;) {
+      const auto *colors = rows[y];
+      for (size_t i = 0; i < rows.rowSize; i += 3) {
+        line[i] = colors[i + 2];
+        line[i + 1] = colors[i + 1];
+        line[i + 2] = colors[i];
+      }
+      const auto fileRow = m_height - 1 - (m_nextRow + y);
+      output.seekp(std::streamoff(headerSize + fileRow * line.size()));
+      writeBytes(output, line);
+    }
+    m_nextRow += rows.height;
+  }
+
+private:
+  static const size_t headerSize = 54;
+
+  size_t paddedRowSize() const { return (m_width * 3 + 3) / 4 * 4; }
+
+  size_t m_nextRow = 0;
+};
+
+void appendExrAttribute(std::vector<uint8_t> &file, const char *name,
+    const char *type, const std::vector<uint8_t> &value)
+{
+  appendString(file, name);
+  appendString(file, type);
+  appendLittleEndian(file, int32_t(value.size()));
+  file.insert(end(file), begin(value), end(value));
+}
+
+// Single part scanline file, one uncompressed scanline per block. See
+// https://openexr.com/en/latest/OpenEXRFileLayout.html
+class ExrEncoder : public ImageEncoder
+{
+public:
+  using ImageEncoder::ImageEncoder;
+
+  void writeHeader(std::ostream &output) override
+  {
+    std::vector<uint8_t> header;
+    appendLittleEndian(header, uint32_t(20000630)); // Magic number
+    appendLittleEndian(header, uint32_t(2)); // Version, no flags
+
+    std::vector<uint8_t> value;
+    for (const auto &channel : channels) {
+      appendString(value, channel.first);
+      appendLittleEndian(value, int32_t(1)); // HALF
+      appendLittleEndian(value, uint32_t(0)); // pLinear and reserved
+      appendLittleEndian(value, int32_t(1)); // xSampling
+      appendLittleEndian(value, int32_t(1)); // ySampling
+    }
+    value.push_back(0);
+    appendExrAttribute(header, "channels", "chlist", value);
+    appendExrAttribute(header, "compression", "compression", {0});
+    value.clear();
+    for (const auto coordinate :
+        {0, 0, int32_t(m_width) - 1, int32_t(m_height) - 1}) {
+      appendLittleEndian(value, int32_t(coordinate));
+    }
+    appendExrAttribute(header, "dataWindow", "box2i", value);
+    appendExrAttribute(header, "displayWindow", "box2i", value);
+    appendExrAttribute(header, "lineOrder", "lineOrder", {0}); // INCREASING_Y
+    value.clear();
+    appendLittleEndian(value, 1.f);
+    appendExrAttribute(header, "pixelAspectRatio", "float", value);
+    appendExrAttribute(header, "screenWindowWidth", "float", value);
+    value.clear();
+    appendLittleEndian(value, 0.f);
+    appendLittleEndian(value, 0.f);
+    appendExrAttribute(header, "screenWindowCenter", "v2f", value);
+    header.push_back(0); // End of the header
+
+    // Blocks have the same size, their offsets are known before their content
+    const auto blockSize = 2 * sizeof(int32_t) + lineSize();
+    const auto firstBlockOffset = header.size() + m_height * sizeof(uint64_t);
+    for (size_t y = 0; y < m_height; ++y) {
+      appendLittleEndian(header, uint64_t(firstBlockOffset + y * blockSize));
+    }
+    writeBytes(output, header);
+  }
+
+  void encodeRows(std::ostream &output, const ImageRows &rows) override
+  {
+    std::vector<uint8_t> block;
+    for (size_t y = 0; y < rows.height; ++y) {
+      block.clear();
+      appendLittleEndian(block, int32_t(m_nextRow + y));
+      appendLittleEndian(block, int32_t(lineSize()));
+      const auto *pixels = reinterpret_cast<const uint16_t *>(rows[y]);
+      for (const auto &channel : channels) {
+        for (size_t x = 0; x < m_width; ++x) {
+          appendLittleEndian(block, pixels[4 * x + channel.second]);
+        }
+      }
+      writeBytes(output, block);
+    }
+    m_nextRow += rows.height;
+  }
+
+private:
+  // Channels are sorted by name, their values are stored in this order
+  static constexpr std::array<std::pair<const char *, size_t>, 3> channels = {
+      std::make_pair("B", size_t(2)), std::make_pair("G", size_t(1)),
+      std::make_pair("R", size_t(0))};
+
+  size_t lineSize() const
+  {
+    return m_width * channels.size() * sizeof(uint16_t);
+  }
+
+  size_t m_nextRow = 0;
+};
+
+constexpr std::array<std::pair<const char *, size_t>, 3> ExrEncoder::channels;
+
+std::unique_ptr<ImageEncoder> createImageEncoder(
+    const std::string &extension, size_t width, size_t height)
+{
+  if (extension == ".png") {
+    return std::make_unique<PngEncoder>(width, height);
+  }
+  if (extension == ".ppm") {
+    return std::make_unique<PpmEncoder>(width, height);
+  }
+  if (extension == ".tga") {
+    return std::make_unique<TgaEncoder>(width, height);
+  }
+  if (extension == ".bmp") {
+    return std::make_unique<BmpEncoder>(width, height);
+  }
+  if (extension == ".qoi") {
+    return std::make_unique<QoiEncoder>(width, height);
+  }
+  if (extension == ".exr") {
+    return std::make_unique<ExrEncoder>(width, height);
+  }
+  return nullptr;
+}
+
+} // namespace
+
+bool isImageFormatSupported(const fs::path &path)
+{
+  const auto extension = getExtension(path);
+  for (const auto *supported :
+      {".png", ".ppm", ".tga", ".bmp", ".qoi", ".exr"}) {
+    if (extension == supported) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool isFloatImageFormat(const fs::path &path)
+{
+  return getExtension(path) == ".exr";
+}
+
+bool writeImage(const fs::path &path, size_t width, size_t height,
+    const void *pixels, bool isBottomUp)
+{
+  ImageFileWriter writer(path, width, height);
+  return writer.isOpen() && writer.writeRows(pixels, height, isBottomUp) &&
+         writer.finish();
+}
+
+bool writeNpy(const fs::path &path, const char *descr,
+    const std::vector<size_t> &shape, const void *data, bool isBottomUp)
+{
+  if (shape.empty()) {
+    return false;
+  }
+  std::string header = std::string("{'descr': '") + descr +
+                       "', 'fortran_order': False, 'shape': (";
+  for (const auto size : shape) {
+    header += std::to_string(size) + ", ";
+  }
+  header += "), }";
+  // Version 1.0: magic, version, header length, then the header padded with
+  // spaces and ended by a newline for the data to be aligned on 64 bytes
+  const size_t prefixSize = 10;
+  header.append(63 - (prefixSize + header.size()) % 64, ' ');
+  header += '\n';
+  std::vector<uint8_t> bytes = {0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0};
+  appendLittleEndian(bytes, uint16_t(header.size()));
+  bytes.insert(end(bytes), begin(header), end(header));
+
+  std::ofstream output(path.string(), std::ios::binary);
+  writeBytes(output, bytes);
+  auto rowSize = size_t(std::atoi(descr + 2));
+  for (size_t i = 1; i < shape.size(); ++i) {
+    rowSize *= shape[i];
+  }
+  const ImageRows rows{
+      static_cast<const uint8_t *>(data), rowSize, shape[0], isBottomUp};
+  for (size_t row = 0; row < shape[0]; ++row) {
+    output.write(reinterpret_cast<const char *>(rows[row]),
+        std::streamsize(rowSize));
+  }
+  return bool(output);
+}
+
+ImageFileWriter::ImageFileWriter(
+    const fs::path &path, size_t width, size_t height) :
+    m_encoder(createImageEncoder(getExtension(path), width, height)),
+    m_width(width),
+    m_height(height),
+    m_pixelSize(isFloatImageFormat(path) ? 4 * sizeof(uint16_t) : 4)
+{
+  if (!m_encoder) {
+    return;
+  }
+  m_output.open(path.string(), std::ios::binary);
+  if (m_output) {
+    m_encoder->writeHeader(m_output);
+  }
+}
+
+ImageFileWriter::~ImageFileWriter() = default;
+
+bool ImageFileWriter::isOpen() const { return m_encoder && m_output; }
+
+bool ImageFileWriter::writeRows(
+    const void *pixels, size_t rowCount, bool isBottomUp)
+{
+  if (!isOpen() || m_writtenRowCount + rowCount > m_height) {
+    return false;
+  }
+  ImageRows rows{static_cast<const uint8_t *>(pixels), m_width * m_pixelSize,
+      rowCount, isBottomUp};
+  if (m_pixelSize == 4) {
+    // Byte encoders take RGB pixels, in the same row order
+    m_rgbRows.resize(m_width * 3 * rowCount);
+    const auto pixelCount = m_width * rowCount;
+    for (size_t i = 0; i < pixelCount; ++i) {
+      std::memcpy(m_rgbRows.data() + 3 * i, rows.pixels + 4 * i, 3);
+    }
+    rows = {m_rgbRows.data(), m_width * 3, rowCount, isBottomUp};
+  }
+  m_encoder->encodeRows(m_output, rows);
+  m_writtenRowCount += rowCount;
+  return bool(m_output);
+}
+
+bool ImageFileWriter::finish()
+{
+  if (!isOpen() || m_writtenRowCount != m_height) {
+    return false;
+  }
+  m_encoder->writeEnd(m_output);
+  m_output.close();
+  return bool(m_output);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+// Image files written from the pixels of an OffscreenFramebuffer (see
+// images.hpp), in the format given by the extension of their path:
+// - .png, deflated on all cores in bands of rows (fast, fixed Huffman codes)
+// - .ppm (binary P6), .tga and .bmp (24 bits), uncompressed
+// - .qoi, the "Quite OK Image" format, lossless and a lot faster than png
+// - .exr, OpenEXR scanlines of uncompressed half float R, G and B, which
+//   keep the values of the GL_RGBA16F color texture as they are
+//
+// Files are written as rows come, by ImageFileWriter, so that an image does
+// not have to be in memory as a whole.
+//
+// Pixels are 4 unsigned bytes (RGBA), or 4 half floats for float formats, as
+// read back from GL_RGBA8 and GL_RGBA16F textures: alpha is ignored. Rows
+// are top row first, or bottom row first as read back from OpenGL with
+// isBottomUp: writers then take them in reverse order, the image is never
+// flipped in memory.
+
+bool isImageFormatSupported(const fs::path &path);
+
+// True if images written to path are read as half float RGBA pixels
+bool isFloatImageFormat(const fs::path &path);
+
+// Returns false if the format is not supported or the file can not be
+// written
+bool writeImage(const fs::path &path, size_t width, size_t height,
+    const void *pixels, bool isBottomUp = false);
+
+// Write a NumPy .npy array of the given shape, the first dimension being the
+// rows of data, with elements of type descr (such as "<f4" for little endian
+// floats). For values images would not keep as they are, such as the depths
+// and draw IDs of --output-aovs. Rows are bottom row first with isBottomUp.
+bool writeNpy(const fs::path &path, const char *descr,
+    const std::vector<size_t> &shape, const void *data,
+    bool isBottomUp = false);
+
+class ImageEncoder; // See image_writer.cpp
+
+// Write an image file band by band: bands of rows, from the top of the image,
+// are encoded as they are given. BMP rows are written at their place in the
+// file, it is not read back.
+class ImageFileWriter
+{
+public:
+  // Create the file and write its header, see isOpen
+  ImageFileWriter(const fs::path &path, size_t width, size_t height);
+
+  ~ImageFileWriter();
+
+  ImageFileWriter(const ImageFileWriter &) = delete;
+
+  ImageFileWriter &operator=(const ImageFileWriter &) = delete;
+
+  // False if the format is not supported or the file can not be written
+  bool isOpen() const;
+
+  // Write the rowCount rows below those already written, the top one first or
+  // bottom row first with isBottomUp, as for writeImage. Returns false on
+  // error or if it is more rows than the image has.
+  bool writeRows(const void *pixels, size_t rowCount, bool isBottomUp = false);
+
+  // Write the end of the file once all rows are written
+  bool finish();
+
+private:
+  std::unique_ptr<ImageEncoder> m_encoder;
+  std::ofstream m_output;
+  size_t m_width;
+  size_t m_height;
+  size_t m_pixelSize; // In bytes
+  size_t m_writtenRowCount = 0;
+  std::vector<uint8_t> m_rgbRows; // Pixels of byte formats without alpha
+};
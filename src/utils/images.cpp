@@ -1,12 +1,41 @@
 #include "images.hpp"
+#include "gpu_memory.hpp"
 
-#include <cassert>
-#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 
-void renderToImage(size_t width, size_t height, size_t numComponents,
-    unsigned char *outPixels, std::function<void()> drawScene)
+namespace {
+
+// glGetTexImage of level 0 of texture, tightly packed
+void getTexImage(GLuint texture, GLenum format, GLenum type, void *outPixels)
 {
+  GLint previousTextureObject = 0;
+  GLint previousPackAlignment = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
+  glGetIntegerv(GL_PACK_ALIGNMENT, &previousPackAlignment);
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexImage(GL_TEXTURE_2D, 0, format, type, outPixels);
+
+  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
+  glPixelStorei(GL_PACK_ALIGNMENT, previousPackAlignment);
+}
+
+} // namespace
+
+OffscreenFramebuffer::OffscreenFramebuffer(size_t width, size_t height,
+    GLenum colorFormat, size_t sampleCount, bool drawIds, bool geometry) :
+    m_width(width), m_height(height), m_colorFormat(colorFormat)
+{
+  if (drawIds && sampleCount > 1) {
+    throw std::invalid_argument("Multisampled framebuffer with draw IDs");
+  }
+  if (geometry && sampleCount > 1) {
+    throw std::invalid_argument("Multisampled framebuffer with geometry");
+  }
   GLint previousTextureObject = 0;
   GLint previousFramebufferObject = 0;
 
@@ -14,52 +43,133 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
   glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextureObject);
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
 
-  GLuint textureObject = 0;
-
-  glGenTextures(1, &textureObject);
-
-  glBindTexture(GL_TEXTURE_2D, textureObject);
-
   // Lets avoid warnings
   const auto w = GLsizei(width);
   const auto h = GLsizei(height);
 
-  // if we want better quality, we can use multisampling, but for testing
-  // purpose it is useless todo replace with glTexStorage2DMultisample (in that
-  // case need to todo glBlitFramebuffer in another one in order to be able to
-  // glGetTexImage)
-  // https://stackoverflow.com/questions/14019910/how-does-glteximage2dmultisample-work
-  glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, w, h);
-
-  GLuint depthTexture;
-  glGenTextures(1, &depthTexture);
+  GLint maxSampleCount = 1;
+  glGetIntegerv(GL_MAX_SAMPLES, &maxSampleCount);
+  m_sampleCount = std::max(
+      std::min(sampleCount, size_t(std::max(maxSampleCount, 1))), size_t(1));
 
-  glBindTexture(GL_TEXTURE_2D, depthTexture);
+  // glGetTexImage reads single sample textures only, multisampled frames are
+  // resolved into m_colorTexture
+  glGenTextures(1, &m_colorTexture);
+  glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+  glTexStorage2D(GL_TEXTURE_2D, 1, colorFormat, w, h);
 
+  glGenTextures(1, &m_depthTexture);
+  glBindTexture(GL_TEXTURE_2D, m_depthTexture);
   glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, w, h);
 
+  if (drawIds) {
+    glGenTextures(1, &m_drawIdTexture);
+    glBindTexture(GL_TEXTURE_2D, m_drawIdTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32UI, w, h);
+  }
+
+  if (geometry) {
+    glGenTextures(1, &m_geometryTexture);
+    glBindTexture(GL_TEXTURE_2D, m_geometryTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, w, h);
+  }
+
   glBindTexture(GL_TEXTURE_2D, previousTextureObject);
 
-  GLuint framebufferObject = 0;
-  glGenFramebuffers(1, &framebufferObject);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferObject);
+  glGenFramebuffers(1, &m_framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
 
   glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureObject, 0);
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture, 0);
   glFramebufferTexture(
-      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0);
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture, 0);
 
-  GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-  glDrawBuffers(1, drawBuffers);
+  GLenum drawBuffers[3] = {GL_COLOR_ATTACHMENT0,
+      GLenum(m_drawIdTexture ? GL_COLOR_ATTACHMENT1 : GL_NONE),
+      GL_COLOR_ATTACHMENT2};
+  if (m_drawIdTexture) {
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, m_drawIdTexture, 0);
+  }
+  if (m_geometryTexture) {
+    glFramebufferTexture(
+        GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, m_geometryTexture, 0);
+    glDrawBuffers(3, drawBuffers);
+  } else {
+    glDrawBuffers(m_drawIdTexture ? 2 : 1, drawBuffers);
+  }
+
+  auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
 
-  const auto framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
-  assert(framebufferStatus == GL_FRAMEBUFFER_COMPLETE);
+  if (m_sampleCount > 1 && framebufferStatus == GL_FRAMEBUFFER_COMPLETE) {
+    // Same color format as the texture they are resolved into
+    const auto samples = GLsizei(m_sampleCount);
+    glGenRenderbuffers(2, m_multisampleRenderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_multisampleRenderbuffers[0]);
+    glRenderbufferStorageMultisample(
+        GL_RENDERBUFFER, samples, colorFormat, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_multisampleRenderbuffers[1]);
+    glRenderbufferStorageMultisample(
+        GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT32F, w, h);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &m_multisampleFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_multisampleFramebuffer);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_RENDERBUFFER, m_multisampleRenderbuffers[0]);
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+        GL_RENDERBUFFER, m_multisampleRenderbuffers[1]);
+    glDrawBuffers(1, drawBuffers);
+    framebufferStatus = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  }
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
+  if (framebufferStatus != GL_FRAMEBUFFER_COMPLETE) {
+    glDeleteFramebuffers(1, &m_multisampleFramebuffer);
+    glDeleteRenderbuffers(2, m_multisampleRenderbuffers);
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(1, &m_colorTexture);
+    glDeleteTextures(1, &m_depthTexture);
+    glDeleteTextures(1, &m_drawIdTexture);
+    glDeleteTextures(1, &m_geometryTexture);
+    throw std::runtime_error("Incomplete offscreen framebuffer");
+  }
+  const GLuint textures[] = {
+      m_colorTexture, m_depthTexture, m_drawIdTexture, m_geometryTexture};
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 4, textures);
+  trackRenderbuffers(
+      GpuMemoryCategory::RenderTargets, 2, m_multisampleRenderbuffers);
+}
+
+OffscreenFramebuffer::~OffscreenFramebuffer()
+{
+  const GLuint textures[] = {
+      m_colorTexture, m_depthTexture, m_drawIdTexture, m_geometryTexture};
+  untrackTextures(4, textures);
+  untrackRenderbuffers(2, m_multisampleRenderbuffers);
+  glDeleteFramebuffers(1, &m_multisampleFramebuffer);
+  glDeleteRenderbuffers(2, m_multisampleRenderbuffers);
+  glDeleteFramebuffers(1, &m_framebuffer);
+  glDeleteTextures(1, &m_colorTexture);
+  glDeleteTextures(1, &m_depthTexture);
+  glDeleteTextures(1, &m_drawIdTexture);
+  glDeleteTextures(1, &m_geometryTexture);
+}
+
+void OffscreenFramebuffer::render(
+    const std::function<void()> &drawScene) const
+{
+  const auto drawFramebuffer =
+      m_multisampleFramebuffer ? m_multisampleFramebuffer : m_framebuffer;
+  GLint previousFramebufferObject = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebufferObject);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
 
   drawScene();
 
   GLint currentlyBoundFBO = 0;
   glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &currentlyBoundFBO);
-  if (currentlyBoundFBO != framebufferObject) {
+  if (GLuint(currentlyBoundFBO) != drawFramebuffer) {
     // Display a warning on clog
     // It may not be an error because the drawScene() function might have render
     // to the framebuffer but unbound it after.
@@ -69,10 +179,127 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
         << std::endl;
   }
 
-  glBindTexture(GL_TEXTURE_2D, textureObject);
-  glGetTexImage(GL_TEXTURE_2D, 0, numComponents == 3 ? GL_RGB : GL_RGBA,
-      GL_UNSIGNED_BYTE, outPixels);
+  if (m_multisampleFramebuffer) {
+    // Average the samples of each pixel into the color texture
+    GLint previousReadFramebufferObject = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebufferObject);
+    const auto w = GLint(m_width);
+    const auto h = GLint(m_height);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_multisampleFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glBlitFramebuffer(
+        0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebufferObject);
+  }
 
-  glBindTexture(GL_TEXTURE_2D, previousTextureObject);
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebufferObject);
-}
\ No newline at end of file
+}
+
+void OffscreenFramebuffer::blitColor() const
+{
+  blitColor(m_width, m_height, m_width, m_height);
+}
+
+void OffscreenFramebuffer::blitColor(size_t sourceWidth, size_t sourceHeight,
+    size_t targetWidth, size_t targetHeight) const
+{
+  GLint previousReadFramebufferObject = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebufferObject);
+  const auto isScaled =
+      sourceWidth != targetWidth || sourceHeight != targetHeight;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+  glBlitFramebuffer(0, 0, GLint(sourceWidth), GLint(sourceHeight), 0, 0,
+      GLint(targetWidth), GLint(targetHeight), GL_COLOR_BUFFER_BIT,
+      isScaled ? GL_LINEAR : GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebufferObject);
+}
+
+void OffscreenFramebuffer::blitColorAt(size_t x, size_t y) const
+{
+  GLint previousReadFramebufferObject = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebufferObject);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+  glBlitFramebuffer(0, 0, GLint(m_width), GLint(m_height), GLint(x), GLint(y),
+      GLint(x + m_width), GLint(y + m_height), GL_COLOR_BUFFER_BIT,
+      GL_NEAREST);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebufferObject);
+}
+
+void OffscreenFramebuffer::readPixels(
+    size_t numComponents, void *outPixels, GLenum type) const
+{
+  getTexImage(m_colorTexture, numComponents == 3 ? GL_RGB : GL_RGBA, type,
+      outPixels);
+}
+
+void OffscreenFramebuffer::readDrawId(size_t x, size_t y, void *outId) const
+{
+  GLint previousReadFramebufferObject = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebufferObject);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+  glReadBuffer(GL_COLOR_ATTACHMENT1);
+  glReadPixels(
+      GLint(x), GLint(y), 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, outId);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebufferObject);
+}
+
+void OffscreenFramebuffer::readDrawIds(void *outIds) const
+{
+  getTexImage(m_drawIdTexture, GL_RED_INTEGER, GL_UNSIGNED_INT, outIds);
+}
+
+void OffscreenFramebuffer::readGeometry(void *outPixels) const
+{
+  getTexImage(m_geometryTexture, GL_RGBA, GL_FLOAT, outPixels);
+}
+
+size_t OffscreenFramebuffer::colorPixelSize() const
+{
+  switch (colorType()) {
+  case GL_UNSIGNED_BYTE:
+    return 4;
+  case GL_HALF_FLOAT:
+    return 4 * sizeof(uint16_t);
+  default:
+    return 4 * sizeof(float);
+  }
+}
+
+void OffscreenFramebuffer::readColor(void *outPixels) const
+{
+  readPixels(4, outPixels, colorType());
+}
+
+GLenum OffscreenFramebuffer::colorType() const
+{
+  switch (m_colorFormat) {
+  case GL_RGBA8:
+  case GL_SRGB8_ALPHA8:
+    return GL_UNSIGNED_BYTE;
+  case GL_RGBA16F:
+    return GL_HALF_FLOAT;
+  default:
+    return GL_FLOAT;
+  }
+}
+
+GLenum getOffscreenColorFormat(bool floatPixels)
+{
+  return floatPixels ? GL_RGBA16F : GL_RGBA8;
+}
+
+void renderToImage(size_t width, size_t height, size_t numComponents,
+    unsigned char *outPixels, std::function<void()> drawScene)
+{
+  const OffscreenFramebuffer framebuffer(width, height);
+  renderToImage(framebuffer, numComponents, outPixels, drawScene);
+}
+
+void renderToImage(const OffscreenFramebuffer &framebuffer,
+    size_t numComponents, unsigned char *outPixels,
+    const std::function<void()> &drawScene)
+{
+  framebuffer.render(drawScene);
+  framebuffer.readPixels(numComponents, outPixels);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glad/glad.h>
+
 #include <functional>
 
 template <typename ComponentType>
@@ -17,6 +19,117 @@ void flipImageYAxis(
   }
 }
 
+// Color (GL_RGBA32F by default) and depth textures attached to a
+// framebuffer, to render images offscreen. Created once for a size and reused
+// by every frame, GL objects are released by the destructor.
+//
+// With a sampleCount above 1, frames are drawn in multisampled renderbuffers
+// instead, and resolved into the color texture with glBlitFramebuffer.
+//
+// With drawIds, a GL_R32UI texture is attached to GL_COLOR_ATTACHMENT1 for
+// the fragment shaders to write the draw of each pixel (see DrawIdPicker).
+// Integer samples cannot be averaged, it is single sampled only.
+//
+// With geometry, a GL_RGBA32F texture is attached to GL_COLOR_ATTACHMENT2 for
+// the fragment shaders to write the view space normal and depth of each pixel
+// (--output-aovs), also single sampled only.
+class OffscreenFramebuffer
+{
+public:
+  // Throws std::runtime_error if the framebuffer is not complete. sampleCount
+  // is clamped to GL_MAX_SAMPLES.
+  OffscreenFramebuffer(size_t width, size_t height,
+      GLenum colorFormat = GL_RGBA32F, size_t sampleCount = 1,
+      bool drawIds = false, bool geometry = false);
+
+  ~OffscreenFramebuffer();
+
+  OffscreenFramebuffer(const OffscreenFramebuffer &) = delete;
+
+  OffscreenFramebuffer &operator=(const OffscreenFramebuffer &) = delete;
+
+  size_t width() const { return m_width; }
+
+  size_t height() const { return m_height; }
+
+  size_t sampleCount() const { return m_sampleCount; }
+
+  // Resolved color of the last frame rendered
+  GLuint colorTexture() const { return m_colorTexture; }
+
+  // Draw IDs of the last frame rendered, 0 without drawIds
+  GLuint drawIdTexture() const { return m_drawIdTexture; }
+
+  // Bind the framebuffer to GL_DRAW_FRAMEBUFFER, call drawScene(), resolve
+  // its samples, then restore the previous binding. Same requirements on
+  // drawScene as renderToImage.
+  void render(const std::function<void()> &drawScene) const;
+
+  // Copy the color of the last frame rendered to the framebuffer bound to
+  // GL_DRAW_FRAMEBUFFER, at the same size
+  void blitColor() const;
+
+  // Copy the bottom left sourceWidth x sourceHeight pixels of the color, as
+  // drawn with a smaller viewport, to the bottom left targetWidth x
+  // targetHeight pixels of the framebuffer bound to GL_DRAW_FRAMEBUFFER,
+  // filtered linearly
+  void blitColor(size_t sourceWidth, size_t sourceHeight, size_t targetWidth,
+      size_t targetHeight) const;
+
+  // Copy the color of the last frame rendered to the framebuffer bound to
+  // GL_DRAW_FRAMEBUFFER, at the same size, with its bottom left corner at
+  // (x, y)
+  void blitColorAt(size_t x, size_t y) const;
+
+  // glGetTexImage of the color texture, as tightly packed rows of
+  // numComponents (3 or 4) values of type per pixel. outPixels is an offset
+  // in the buffer bound to GL_PIXEL_PACK_BUFFER if there is one.
+  void readPixels(size_t numComponents, void *outPixels,
+      GLenum type = GL_UNSIGNED_BYTE) const;
+
+  // glReadPixels of the draw ID of pixel (x, y) with drawIds, an uint32_t.
+  // outId is an offset in the buffer bound to GL_PIXEL_PACK_BUFFER if there
+  // is one.
+  void readDrawId(size_t x, size_t y, void *outId) const;
+
+  // glGetTexImage of the draw IDs with drawIds, an uint32_t per pixel, and of
+  // the geometry with geometry, 4 floats per pixel, rows bottom-up. Offsets
+  // in the buffer bound to GL_PIXEL_PACK_BUFFER if there is one.
+  void readDrawIds(void *outIds) const;
+  void readGeometry(void *outPixels) const;
+
+  // Size in bytes of the pixels of readColor
+  size_t colorPixelSize() const;
+
+  // readPixels of RGBA values of the type of the color format: bytes for
+  // GL_RGBA8, half floats for GL_RGBA16F and floats for GL_RGBA32F, copied
+  // without conversion
+  void readColor(void *outPixels) const;
+
+private:
+  GLenum colorType() const;
+
+  size_t m_width;
+  size_t m_height;
+  GLenum m_colorFormat;
+  size_t m_sampleCount = 1;
+  GLuint m_framebuffer = 0;
+  GLuint m_colorTexture = 0;
+  GLuint m_depthTexture = 0;
+  GLuint m_drawIdTexture = 0;
+  GLuint m_geometryTexture = 0;
+  // Drawn instead of m_framebuffer when multisampled, 0 otherwise
+  GLuint m_multisampleFramebuffer = 0;
+  GLuint m_multisampleRenderbuffers[2] = {}; // Color and depth
+};
+
+// Color format of the OffscreenFramebuffer of output images, read back with
+// readColor as bytes, or as half floats with floatPixels (see
+// image_writer.hpp): GL_RGBA8 or GL_RGBA16F, 4 and 2 times less memory and
+// bandwidth than GL_RGBA32F. Shaders write sRGB encoded colors, so 8 bits
+// images are not GL_SRGB8_ALPHA8.
+GLenum getOffscreenColorFormat(bool floatPixels);
+
 void renderToImage(size_t width, size_t height, size_t numComponents,
     unsigned char *outPixels, std::function<void()> drawScene);
 // Setup GL state in order to render in texture, call drawScene() then get the
@@ -27,4 +140,9 @@ void renderToImage(size_t width, size_t height, size_t numComponents,
 // GL_DRAW_FRAMEBUFFER.
 // It means that if drawScene change GL_DRAW_FRAMEBUFFER, in must restore it
 // before doing final rendering (for example for deferred rendering,
-// GL_DRAW_FRAMEBUFFER must be restored before the shading pass).
\ No newline at end of file
+// GL_DRAW_FRAMEBUFFER must be restored before the shading pass).
+
+// Same in framebuffer, reused instead of created for the call
+void renderToImage(const OffscreenFramebuffer &framebuffer,
+    size_t numComponents, unsigned char *outPixels,
+    const std::function<void()> &drawScene);
@@ -0,0 +1,228 @@
+#include "impostors.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace {
+
+const uint32_t impostorCacheMagic = 0x4d495647; // "GVIM"
+const uint32_t impostorCacheVersion = 1;
+
+// RGBA8 pixels of a layer, rows from the bottom
+const size_t layerSize =
+    size_t(Impostors::ATLAS_SIZE) * Impostors::ATLAS_SIZE * 4;
+
+// FNV-1a, only used to name cache files
+uint64_t hashBytes(const void *data, size_t size, uint64_t hash)
+{
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+float signNotZero(float value) { return value >= 0.f ? 1.f : -1.f; }
+
+} // namespace
+
+glm::vec3 Impostors::getFrameDirection(GLsizei x, GLsizei y)
+{
+  // Inverse of the octahedral map of impostor.vs.glsl, at the frame center
+  auto p = 2.f * (glm::vec2(x, y) + 0.5f) / float(FRAME_GRID) - 1.f;
+  const auto height = 1.f - std::abs(p.x) - std::abs(p.y);
+  if (height < 0.f) {
+    p = glm::vec2((1.f - std::abs(p.y)) * signNotZero(p.x),
+        (1.f - std::abs(p.x)) * signNotZero(p.y));
+  }
+  return glm::normalize(glm::vec3(p.x, height, p.y));
+}
+
+glm::mat4 Impostors::getFrameViewMatrix(
+    const glm::vec4 &sphere, GLsizei x, GLsizei y)
+{
+  const auto direction = getFrameDirection(x, y);
+  const auto center = glm::vec3(sphere);
+  // Same up vector as impostor.vs.glsl, any one not along the direction
+  const auto up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1)
+                                                : glm::vec3(0, 1, 0);
+  return glm::lookAt(center + 2.f * sphere.w * direction, center, up);
+}
+
+glm::mat4 Impostors::getFrameProjMatrix(const glm::vec4 &sphere)
+{
+  const auto radius = sphere.w;
+  return glm::ortho(-radius, radius, -radius, radius, radius, 3.f * radius);
+}
+
+fs::path Impostors::getCachePath(
+    const fs::path &cacheDirectory, const std::string &key)
+{
+  auto hash = hashBytes(key.data(), key.size(), 0xcbf29ce484222325ull);
+  const GLsizei sizes[] = {FRAME_SIZE, FRAME_GRID};
+  hash = hashBytes(sizes, sizeof(sizes), hash);
+  char fileName[32];
+  std::snprintf(fileName, sizeof(fileName), "%016llx.imp",
+      static_cast<unsigned long long>(hash));
+  return cacheDirectory / fileName;
+}
+
+Impostors::Impostors(
+    GLsizei layerCount, size_t maxInstanceCount, GLProgram program) :
+    m_program(std::move(program)),
+    m_atlasTexture(GLTexture::generate()),
+    m_instanceBuffer(GLBuffer::generate()),
+    m_vertexArray(GLVertexArray::generate()),
+    m_maxInstanceCount(maxInstanceCount)
+{
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture.glId());
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, ATLAS_LEVELS, GL_RGBA8, ATLAS_SIZE,
+      ATLAS_SIZE, layerCount);
+  glTexParameteri(
+      GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  const auto atlasTexture = m_atlasTexture.glId();
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D_ARRAY, 1,
+      &atlasTexture);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      std::max(maxInstanceCount, size_t(1)) * sizeof(Instance), nullptr,
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const auto instanceBuffer = m_instanceBuffer.glId();
+  trackBuffers(GpuMemoryCategory::DrawData, 1, &instanceBuffer);
+
+  const auto blockIndex = glGetProgramResourceIndex(
+      m_program.glId(), GL_SHADER_STORAGE_BLOCK, "Instances");
+  if (blockIndex != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(
+        m_program.glId(), blockIndex, INSTANCES_BINDING);
+  }
+  m_program.setUniform(
+      m_program.getUniformLocation("uAtlas"), GLint(ATLAS_UNIT));
+}
+
+bool Impostors::loadLayer(GLsizei layer, const fs::path &cachePath)
+{
+  std::ifstream input(cachePath.string(), std::ios::binary);
+  uint32_t header[2] = {};
+  std::vector<unsigned char> pixels(layerSize);
+  if (!input.read(reinterpret_cast<char *>(header), sizeof(header)) ||
+      header[0] != impostorCacheMagic || header[1] != impostorCacheVersion ||
+      !input.read(reinterpret_cast<char *>(pixels.data()),
+          std::streamsize(pixels.size()))) {
+    return false;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture.glId());
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, ATLAS_SIZE,
+      ATLAS_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  return true;
+}
+
+void Impostors::renderLayer(GLsizei layer, const glm::vec4 &sphere,
+    const fs::path &cachePath,
+    const std::function<void(const glm::mat4 &, const glm::mat4 &)>
+        &drawFrame)
+{
+  if (!m_framebuffer) {
+    m_framebuffer = std::make_unique<OffscreenFramebuffer>(
+        size_t(ATLAS_SIZE), size_t(ATLAS_SIZE), GL_RGBA8, 4);
+  }
+  GLint viewport[4] = {};
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  std::vector<unsigned char> pixels(layerSize);
+  renderToImage(*m_framebuffer, 4, pixels.data(), [&]() {
+    const GLfloat transparent[] = {0, 0, 0, 0};
+    glClearBufferfv(GL_COLOR, 0, transparent);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    const auto projMatrix = getFrameProjMatrix(sphere);
+    for (GLsizei y = 0; y < FRAME_GRID; ++y) {
+      for (GLsizei x = 0; x < FRAME_GRID; ++x) {
+        glViewport(x * FRAME_SIZE, y * FRAME_SIZE, FRAME_SIZE, FRAME_SIZE);
+        drawFrame(getFrameViewMatrix(sphere, x, y), projMatrix);
+      }
+    }
+  });
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture.glId());
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, ATLAS_SIZE,
+      ATLAS_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  if (!cachePath.empty()) {
+    writeCache(cachePath, pixels);
+  }
+}
+
+void Impostors::writeCache(
+    const fs::path &cachePath, const std::vector<unsigned char> &pixels) const
+{
+  // Written to a temporary file first, so that concurrent viewers never load
+  // a partial cache
+  std::error_code ec;
+  fs::create_directories(cachePath.parent_path(), ec);
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream output(tmpPath.string(), std::ios::binary);
+    const uint32_t header[2] = {impostorCacheMagic, impostorCacheVersion};
+    output.write(reinterpret_cast<const char *>(header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(pixels.data()),
+        std::streamsize(pixels.size()));
+    if (!output) {
+      std::cerr << "Warning : unable to write " << tmpPath << std::endl;
+      return;
+    }
+  }
+  fs::rename(tmpPath, cachePath, ec);
+  if (ec) {
+    std::cerr << "Warning : unable to write " << cachePath << ": "
+              << ec.message() << std::endl;
+  }
+}
+
+void Impostors::generateMipmaps()
+{
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture.glId());
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void Impostors::draw(const std::vector<Instance> &instances)
+{
+  const auto count = std::min(instances.size(), m_maxInstanceCount);
+  if (!count) {
+    return;
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer.glId());
+  glBufferSubData(
+      GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(Instance), instances.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, INSTANCES_BINDING, m_instanceBuffer.glId());
+  glActiveTexture(GL_TEXTURE0 + ATLAS_UNIT);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_atlasTexture.glId());
+  glActiveTexture(GL_TEXTURE0);
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_program.use();
+  glBindVertexArray(m_vertexArray.glId());
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(count));
+  glBindVertexArray(0);
+  glUseProgram(GLuint(previousProgram));
+}
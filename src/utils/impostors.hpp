@@ -0,0 +1,104 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gl_objects.hpp"
+#include "images.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Billboards drawn instead of the instances of meshes far from the camera
+// (--impostors). Each mesh is rendered from FRAME_GRID x FRAME_GRID
+// directions of an octahedral map, orthographically around its bounding
+// sphere, into the frames of a layer of an atlas texture array. Its
+// instances are then quads of the frame nearest to the direction the camera
+// sees them from, alpha tested, all drawn by one instanced draw.
+//
+// Layers are stored in a cache directory in files named after a key of the
+// caller, so that later runs load them instead of rendering them again.
+class Impostors
+{
+public:
+  // Frames of FRAME_SIZE x FRAME_SIZE pixels, the atlas keeps the mip levels
+  // of at least a pixel per frame
+  static const GLsizei FRAME_SIZE = 64;
+  static const GLsizei FRAME_GRID = 8;
+  static const GLsizei ATLAS_SIZE = FRAME_SIZE * FRAME_GRID;
+  static const GLsizei ATLAS_LEVELS = 4;
+
+  // Storage buffer and texture unit of impostor.vs.glsl, after those of
+  // EnvironmentMap and of the depth pyramid
+  static const GLuint INSTANCES_BINDING = 13;
+  static const GLuint ATLAS_UNIT = 15;
+
+  // Same layout as the Instances table of impostor.vs.glsl (std430)
+  struct Instance
+  {
+    glm::mat4 modelMatrix;
+    glm::vec4 sphere; // Local center and radius of the mesh
+    GLint layer;
+    GLuint drawId; // Written with --gpu-picking, see DrawIdPicker
+    GLint padding[2];
+  };
+
+  // Direction from the center of a mesh towards the camera of frame (x, y),
+  // +y at the center of the map
+  static glm::vec3 getFrameDirection(GLsizei x, GLsizei y);
+
+  // View and projection of frame (x, y) of a mesh of local bounding sphere
+  // (center, radius): the ones impostor.vs.glsl puts its quads in
+  static glm::mat4 getFrameViewMatrix(
+      const glm::vec4 &sphere, GLsizei x, GLsizei y);
+
+  static glm::mat4 getFrameProjMatrix(const glm::vec4 &sphere);
+
+  // File of cacheDirectory holding a layer rendered for key
+  static fs::path getCachePath(
+      const fs::path &cacheDirectory, const std::string &key);
+
+  // An atlas of layerCount layers, whose instances are drawn by program
+  // (impostor.vs.glsl and impostor.fs.glsl), at most maxInstanceCount at a
+  // time
+  Impostors(GLsizei layerCount, size_t maxInstanceCount, GLProgram program);
+
+  Impostors(const Impostors &) = delete;
+
+  Impostors &operator=(const Impostors &) = delete;
+
+  // Load layer from cachePath, returns false if it is not a valid cache
+  bool loadLayer(GLsizei layer, const fs::path &cachePath);
+
+  // Render the frames of layer for a mesh of local bounding sphere, calling
+  // drawFrame(viewMatrix, projMatrix) in the viewport of each, then store
+  // it in cachePath if not empty. drawFrame writes the color of the mesh,
+  // sRGB encoded, and its coverage in alpha, over a color and alpha of 0.
+  void renderLayer(GLsizei layer, const glm::vec4 &sphere,
+      const fs::path &cachePath,
+      const std::function<void(const glm::mat4 &, const glm::mat4 &)>
+          &drawFrame);
+
+  // Once all layers are loaded or rendered, before draw()
+  void generateMipmaps();
+
+  // Draw instances, with the FrameUniforms block of the view bound
+  void draw(const std::vector<Instance> &instances);
+
+private:
+  void writeCache(const fs::path &cachePath,
+      const std::vector<unsigned char> &pixels) const;
+
+  GLProgram m_program;
+  GLTexture m_atlasTexture;
+  GLBuffer m_instanceBuffer;
+  GLVertexArray m_vertexArray; // Without attributes
+  size_t m_maxInstanceCount;
+  // Multisampled, to antialias the edges of the frames
+  std::unique_ptr<OffscreenFramebuffer> m_framebuffer;
+};
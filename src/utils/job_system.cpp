@@ -0,0 +1,174 @@
+#include "job_system.hpp"
+
+struct JobSystem::Job
+{
+  std::function<void()> function;
+  // Dependencies not done yet, plus one until add() returns
+  std::atomic<size_t> pendingDependencyCount{1};
+  std::atomic<bool> done{false};
+  std::mutex mutex; // Of dependents, and done is only set under it
+  std::vector<std::shared_ptr<Job>> dependents;
+};
+
+namespace {
+
+// Set on the threads of workers
+thread_local const JobSystem *currentSystem = nullptr;
+thread_local size_t currentWorkerIdx = 0;
+
+} // namespace
+
+bool JobSystem::Handle::done() const { return !m_job || m_job->done; }
+
+JobSystem::JobSystem(size_t workerCount)
+{
+  for (size_t i = 0; i <= workerCount; ++i) {
+    m_queues.emplace_back(std::make_unique<Queue>());
+  }
+  for (size_t i = 0; i < workerCount; ++i) {
+    m_workers.emplace_back([this, i]() { runWorker(i); });
+  }
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_stop = true;
+  }
+  m_wakeCondition.notify_all();
+  for (auto &worker : m_workers) {
+    worker.join();
+  }
+}
+
+JobSystem &JobSystem::global()
+{
+  static JobSystem jobSystem{std::max(getHardwareThreadCount() - 1, size_t(1))};
+  return jobSystem;
+}
+
+JobSystem::Handle JobSystem::add(
+    std::function<void()> function, const std::vector<Handle> &dependencies)
+{
+  auto job = std::make_shared<Job>();
+  job->function = std::move(function);
+  job->pendingDependencyCount += dependencies.size();
+  for (const auto &dependency : dependencies) {
+    if (dependency.m_job) {
+      std::lock_guard<std::mutex> lock(dependency.m_job->mutex);
+      if (!dependency.m_job->done) {
+        dependency.m_job->dependents.push_back(job);
+        continue;
+      }
+    }
+    --job->pendingDependencyCount;
+  }
+
+  Handle handle;
+  handle.m_job = job;
+  if (--job->pendingDependencyCount == 0) {
+    schedule(std::move(job));
+  }
+  return handle;
+}
+
+void JobSystem::wait(const Handle &job)
+{
+  const auto queueIdx = getQueueIndex();
+  while (!job.done()) {
+    if (const auto queuedJob = popJob(queueIdx)) {
+      run(queuedJob);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    ++m_waitingThreadCount;
+    m_wakeCondition.wait(
+        lock, [&]() { return job.done() || m_queuedJobCount > 0; });
+    --m_waitingThreadCount;
+  }
+}
+
+void JobSystem::runWorker(size_t workerIdx)
+{
+  currentSystem = this;
+  currentWorkerIdx = workerIdx;
+  for (;;) {
+    if (const auto job = popJob(workerIdx)) {
+      run(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(m_sleepMutex);
+    m_wakeCondition.wait(
+        lock, [&]() { return m_stop || m_queuedJobCount > 0; });
+    if (m_stop && m_queuedJobCount == 0) {
+      return;
+    }
+  }
+}
+
+size_t JobSystem::getQueueIndex() const
+{
+  return currentSystem == this ? currentWorkerIdx : m_workers.size();
+}
+
+void JobSystem::schedule(std::shared_ptr<Job> job)
+{
+  auto &queue = *m_queues[getQueueIndex()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  ++m_queuedJobCount;
+  // Taking the mutex orders the count with the checks of sleeping threads
+  { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+  m_wakeCondition.notify_one();
+}
+
+std::shared_ptr<JobSystem::Job> JobSystem::popJob(size_t queueIdx)
+{
+  std::shared_ptr<Job> job;
+  // Last added first from its own deque, oldest first from the others
+  {
+    auto &queue = *m_queues[queueIdx];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    }
+  }
+  for (size_t i = 1; !job && i < m_queues.size(); ++i) {
+    auto &queue = *m_queues[(queueIdx + i) % m_queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.jobs.empty()) {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    }
+  }
+  if (job) {
+    --m_queuedJobCount;
+  }
+  return job;
+}
+
+void JobSystem::run(const std::shared_ptr<Job> &job)
+{
+  job->function();
+  job->function = nullptr;
+
+  std::vector<std::shared_ptr<Job>> dependents;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->done = true;
+    dependents.swap(job->dependents);
+  }
+  for (auto &dependent : dependents) {
+    if (--dependent->pendingDependencyCount == 0) {
+      schedule(std::move(dependent));
+    }
+  }
+  if (m_waitingThreadCount > 0) {
+    { std::lock_guard<std::mutex> lock(m_sleepMutex); }
+    m_wakeCondition.notify_all();
+  }
+}
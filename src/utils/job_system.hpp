@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline size_t getHardwareThreadCount()
+{
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Worker threads running jobs, shared by the subsystems of the viewer instead
+// of each starting threads of its own (see JobSystem::global).
+//
+// Each worker runs the jobs it adds from the back of its own deque, and once
+// it is empty steals the oldest jobs of the others, from the front of their
+// deque. Jobs added by other threads go to a shared deque. A job can depend
+// on other jobs, it is queued once they are all done. Threads waiting for a
+// job run queued jobs meanwhile: jobs can wait for the jobs they add.
+class JobSystem
+{
+  struct Job;
+
+public:
+  // Completion of a job added by add(), a default constructed one is done
+  class Handle
+  {
+  public:
+    bool done() const;
+
+  private:
+    friend class JobSystem;
+    std::shared_ptr<Job> m_job;
+  };
+
+  // Start workerCount threads, none can only run jobs in wait()
+  explicit JobSystem(size_t workerCount);
+
+  // Run the jobs still queued, then stop the workers
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // Workers on all hardware threads but one, at least one, started on first
+  // use
+  static JobSystem &global();
+
+  size_t workerCount() const { return m_workers.size(); }
+
+  // Run function once every job of dependencies is done. function must not
+  // throw.
+  Handle add(std::function<void()> function,
+      const std::vector<Handle> &dependencies = {});
+
+  // Run queued jobs until job is done
+  void wait(const Handle &job);
+
+  // Call f(i) for each i in [0, count), by ranges of grainSize indices spread
+  // over at most maxThreadCount threads (all workers by default). The calling
+  // thread takes part in the work. Returns when every call is done. f must
+  // not throw.
+  template <typename Function>
+  void parallelFor(size_t count, Function &&f, size_t grainSize = 1,
+      size_t maxThreadCount = 0);
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<std::shared_ptr<Job>> jobs;
+  };
+
+  void runWorker(size_t workerIdx);
+
+  // Index of the deque of the calling thread, the shared deque if it is not
+  // a worker of this system
+  size_t getQueueIndex() const;
+
+  void schedule(std::shared_ptr<Job> job);
+
+  // Pop a job from the deque queueIdx first, then steal one
+  std::shared_ptr<Job> popJob(size_t queueIdx);
+
+  void run(const std::shared_ptr<Job> &job);
+
+  std::vector<std::unique_ptr<Queue>> m_queues; // Of workers, then shared
+  std::atomic<size_t> m_queuedJobCount{0};
+
+  // Idle workers and waiting threads sleep until a job is queued, waiting
+  // threads also until a job is done
+  std::mutex m_sleepMutex;
+  std::condition_variable m_wakeCondition;
+  std::atomic<size_t> m_waitingThreadCount{0};
+  bool m_stop = false;
+
+  std::vector<std::thread> m_workers;
+};
+
+template <typename Function>
+void JobSystem::parallelFor(
+    size_t count, Function &&f, size_t grainSize, size_t maxThreadCount)
+{
+  grainSize = std::max(grainSize, size_t(1));
+  const auto rangeCount = (count + grainSize - 1) / grainSize;
+  const auto threadCount = std::min(
+      maxThreadCount ? maxThreadCount : workerCount() + 1, rangeCount);
+
+  // Ranges are taken in order by the jobs that are running
+  std::atomic<size_t> nextRange{0};
+  const auto runRanges = [&]() {
+    for (auto r = nextRange++; r < rangeCount; r = nextRange++) {
+      const auto end = std::min(count, (r + 1) * grainSize);
+      for (auto i = r * grainSize; i < end; ++i) {
+        f(i);
+      }
+    }
+  };
+
+  std::vector<Handle> jobs;
+  for (size_t i = 1; i < threadCount; ++i) {
+    jobs.emplace_back(add(runRanges));
+  }
+  runRanges();
+  for (const auto &job : jobs) {
+    wait(job);
+  }
+}
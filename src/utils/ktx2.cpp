@@ -0,0 +1,99 @@
+#include "ktx2.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+const unsigned char ktx2Identifier[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+    0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+// Header of 12 + 9 * 4 bytes, then the index of DFD, KVD and SGD blocks
+const size_t levelIndexOffset = 80;
+const size_t levelIndexEntrySize = 24;
+
+template <typename T> T read(const unsigned char *data, size_t offset)
+{
+  T value;
+  std::memcpy(&value, data + offset, sizeof(T));
+  return value; // KTX2 is little endian, like the platforms we target
+}
+
+template <typename T>
+void write(std::vector<unsigned char> &data, size_t offset, T value)
+{
+  std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+} // namespace
+
+bool isKtx2Data(const unsigned char *data, size_t size)
+{
+  return size >= sizeof(ktx2Identifier) &&
+         std::memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)) == 0;
+}
+
+bool parseKtx2(const unsigned char *data, size_t size, Ktx2Texture &texture,
+    std::string &err)
+{
+  if (!isKtx2Data(data, size) || size < levelIndexOffset) {
+    err = "Not a KTX2 file";
+    return false;
+  }
+  texture.vkFormat = read<uint32_t>(data, 12);
+  texture.width = read<uint32_t>(data, 20);
+  texture.height = read<uint32_t>(data, 24);
+  const auto depth = read<uint32_t>(data, 28);
+  const auto layerCount = read<uint32_t>(data, 32);
+  const auto faceCount = read<uint32_t>(data, 36);
+  const auto levelCount = std::max(read<uint32_t>(data, 40), 1u);
+  texture.supercompressionScheme = read<uint32_t>(data, 44);
+
+  if (texture.width == 0 || texture.height == 0 || depth != 0 ||
+      layerCount != 0 || faceCount != 1) {
+    err = "Only 2D KTX2 textures are supported";
+    return false;
+  }
+  if (levelIndexOffset + levelCount * levelIndexEntrySize > size) {
+    err = "Truncated KTX2 level index";
+    return false;
+  }
+
+  texture.levels.resize(levelCount);
+  for (size_t i = 0; i < levelCount; ++i) {
+    const auto entryOffset = levelIndexOffset + i * levelIndexEntrySize;
+    const auto byteOffset = read<uint64_t>(data, entryOffset);
+    const auto byteLength = read<uint64_t>(data, entryOffset + 8);
+    if (byteOffset > size || byteLength > size - byteOffset) {
+      err = "KTX2 level " + std::to_string(i) + " is out of the file";
+      return false;
+    }
+    texture.levels[i].byteOffset = size_t(byteOffset);
+    texture.levels[i].byteLength = size_t(byteLength);
+  }
+  return true;
+}
+
+std::vector<unsigned char> writeKtx2(uint32_t vkFormat, uint32_t width,
+    uint32_t height, const std::vector<std::vector<unsigned char>> &levels)
+{
+  const auto levelCount = levels.size();
+  std::vector<unsigned char> data(
+      levelIndexOffset + levelCount * levelIndexEntrySize, 0);
+  std::memcpy(data.data(), ktx2Identifier, sizeof(ktx2Identifier));
+  write<uint32_t>(data, 12, vkFormat);
+  write<uint32_t>(data, 16, 1); // typeSize of block compressed formats
+  write<uint32_t>(data, 20, width);
+  write<uint32_t>(data, 24, height);
+  write<uint32_t>(data, 36, 1); // faceCount, depth and layerCount stay 0
+  write<uint32_t>(data, 40, uint32_t(levelCount));
+  for (size_t i = levelCount; i-- > 0;) {
+    data.resize((data.size() + 15) / 16 * 16, 0);
+    const auto entryOffset = levelIndexOffset + i * levelIndexEntrySize;
+    write<uint64_t>(data, entryOffset, data.size());
+    write<uint64_t>(data, entryOffset + 8, levels[i].size());
+    write<uint64_t>(data, entryOffset + 16, levels[i].size());
+    data.insert(data.end(), levels[i].begin(), levels[i].end());
+  }
+  return data;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal reader and writer of KTX2 containers, as used by
+// KHR_texture_basisu
+// https://github.khronos.org/KTX-Specification/
+
+// True if data starts with the KTX2 file identifier
+bool isKtx2Data(const unsigned char *data, size_t size);
+
+struct Ktx2Texture
+{
+  struct Level
+  {
+    size_t byteOffset = 0; // From the start of the file
+    size_t byteLength = 0;
+  };
+
+  uint32_t vkFormat = 0; // VK_FORMAT_UNDEFINED for Basis Universal payloads
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t supercompressionScheme = 0; // 0 none, 1 BasisLZ, 2 Zstd, 3 zlib
+  std::vector<Level> levels; // levels[0] is the full resolution image
+};
+
+enum Ktx2SupercompressionScheme : uint32_t
+{
+  KTX2_SUPERCOMPRESSION_NONE = 0,
+  KTX2_SUPERCOMPRESSION_BASIS_LZ = 1,
+  KTX2_SUPERCOMPRESSION_ZSTD = 2,
+  KTX2_SUPERCOMPRESSION_ZLIB = 3
+};
+
+// Parse the header and level index of a 2D KTX2 texture (no array, cubemap or
+// 3D texture). Returns false with the reason in err if the file is invalid.
+bool parseKtx2(const unsigned char *data, size_t size, Ktx2Texture &texture,
+    std::string &err);
+
+// A 2D KTX2 file of the block compressed format vkFormat, without
+// supercompression, from the blocks of each mip level (levels[0] is the full
+// resolution image). Level data is stored from the smallest level on, 16
+// bytes aligned. The file has no data format descriptor nor key/value data:
+// it is meant to be read back by parseKtx2 (see compressTextures), not by
+// other tools.
+std::vector<unsigned char> writeKtx2(uint32_t vkFormat, uint32_t width,
+    uint32_t height, const std::vector<std::vector<unsigned char>> &levels);
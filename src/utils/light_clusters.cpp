@@ -0,0 +1,154 @@
+#include "light_clusters.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LightClusters::LightClusters(const tinygltf::Model &model,
+    const FlatScene &scene, GLProgram binProgram) :
+    m_binProgram(std::move(binProgram))
+{
+  const auto entries = getNodeEntries(scene, model.nodes.size());
+  for (size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx) {
+    const auto &extensions = model.nodes[nodeIdx].extensions;
+    const auto it = extensions.find("KHR_lights_punctual");
+    if (entries[nodeIdx] < 0 || it == end(extensions) ||
+        !it->second.Has("light")) {
+      continue;
+    }
+    const auto lightIdx = it->second.Get("light").GetNumberAsInt();
+    if (lightIdx < 0 || size_t(lightIdx) >= model.lights.size()) {
+      std::cerr << "Warning : invalid KHR_lights_punctual light of node "
+                << nodeIdx << ", ignored" << std::endl;
+      continue;
+    }
+    const auto &gltfLight = model.lights[lightIdx];
+    const auto type =
+        gltfLight.type == "directional"
+            ? Directional
+            : (gltfLight.type == "spot" ? Spot : Point);
+    glm::vec3 color(1);
+    for (size_t c = 0; c < std::min(gltfLight.color.size(), size_t(3)); ++c) {
+      color[int(c)] = float(gltfLight.color[c]);
+    }
+    color *= float(gltfLight.intensity);
+
+    Light light;
+    // Inverse square falloff below the threshold without a range
+    const auto maxIntensity = std::max(color.r, std::max(color.g, color.b));
+    const auto range = gltfLight.range > 0.
+                           ? float(gltfLight.range)
+                           : std::sqrt(maxIntensity / LIGHT_THRESHOLD);
+    light.positionRange = glm::vec4(0, 0, 0, range);
+    light.directionType = glm::vec4(0, 0, -1, float(type));
+    light.color = glm::vec4(color, 0);
+    light.spot = glm::vec4(0);
+    if (type == Spot) {
+      const auto cosOuter = std::cos(float(gltfLight.spot.outerConeAngle));
+      const auto cosInner = std::cos(float(gltfLight.spot.innerConeAngle));
+      const auto scale = 1.f / std::max(0.001f, cosInner - cosOuter);
+      light.spot = glm::vec4(scale, -cosOuter * scale, 0, 0);
+    }
+    m_nodeLights.push_back(NodeLight{size_t(entries[nodeIdx]), light});
+  }
+  std::stable_partition(begin(m_nodeLights), end(m_nodeLights),
+      [](const NodeLight &nodeLight) {
+        return nodeLight.light.directionType.w == float(Directional);
+      });
+  m_directionalLightCount = size_t(std::count_if(begin(m_nodeLights),
+      end(m_nodeLights), [](const NodeLight &nodeLight) {
+        return nodeLight.light.directionType.w == float(Directional);
+      }));
+  m_viewLights.resize(m_nodeLights.size());
+
+  const auto blockIndex = glGetProgramResourceIndex(
+      m_binProgram.glId(), GL_SHADER_STORAGE_BLOCK, "Lights");
+  if (blockIndex != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(
+        m_binProgram.glId(), blockIndex, LIGHTS_BINDING);
+  }
+  const auto clustersIndex = glGetProgramResourceIndex(
+      m_binProgram.glId(), GL_SHADER_STORAGE_BLOCK, "LightClusters");
+  if (clustersIndex != GL_INVALID_INDEX) {
+    glShaderStorageBlockBinding(
+        m_binProgram.glId(), clustersIndex, CLUSTERS_BINDING);
+  }
+  m_uInverseProjMatrix =
+      m_binProgram.getUniformLocation("uInverseProjMatrix");
+  m_uNear = m_binProgram.getUniformLocation("uNear");
+  m_uFar = m_binProgram.getUniformLocation("uFar");
+
+  m_lightBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      sizeof(glm::uvec4) + std::max(m_viewLights.size(), size_t(1)) *
+                               sizeof(Light),
+      nullptr, GL_DYNAMIC_STORAGE_BIT);
+  m_clusterBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      sizeof(GridHeader) + sizeof(GLuint) * GRID_X * GRID_Y * GRID_Z *
+                               (MAX_CLUSTER_LIGHTS + 1),
+      nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const GLuint buffers[] = {m_lightBuffer.glId(), m_clusterBuffer.glId()};
+  trackBuffers(GpuMemoryCategory::DrawData, 2, buffers);
+}
+
+void LightClusters::update(const FlatScene &scene, const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, GLsizei width, GLsizei height, bool enabled)
+{
+  for (size_t i = 0; i < m_nodeLights.size(); ++i) {
+    const auto &nodeLight = m_nodeLights[i];
+    const auto matrix = viewMatrix * scene.worldMatrices[nodeLight.entry];
+    auto &light = m_viewLights[i];
+    light = nodeLight.light;
+    light.positionRange = glm::vec4(
+        glm::vec3(matrix[3]), nodeLight.light.positionRange.w);
+    light.directionType =
+        glm::vec4(glm::normalize(-glm::vec3(matrix[2])),
+            nodeLight.light.directionType.w);
+  }
+  const auto lightCount = enabled ? m_viewLights.size() : size_t(0);
+  const glm::uvec4 lightCounts(GLuint(lightCount),
+      GLuint(enabled ? m_directionalLightCount : 0), 0, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_lightBuffer.glId());
+  glBufferSubData(
+      GL_SHADER_STORAGE_BUFFER, 0, sizeof(lightCounts), &lightCounts);
+  if (lightCount) {
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(lightCounts),
+        lightCount * sizeof(Light), m_viewLights.data());
+  }
+
+  // Depths of the near and far planes of a glm::perspective matrix, the
+  // tiles of output images only scale and offset it in x and y
+  const auto zNear = projMatrix[3][2] / (projMatrix[2][2] - 1.f);
+  const auto zFar = projMatrix[3][2] / (projMatrix[2][2] + 1.f);
+  const auto logRatio = std::log(zFar / zNear);
+  GridHeader header;
+  header.gridSize = glm::uvec4(GRID_X, GRID_Y, GRID_Z, MAX_CLUSTER_LIGHTS);
+  header.gridScales = glm::vec4(float(GRID_X) / float(width),
+      float(GRID_Y) / float(height), float(GRID_Z) / logRatio,
+      -float(GRID_Z) * std::log(zNear) / logRatio);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterBuffer.glId());
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, LIGHTS_BINDING, m_lightBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, CLUSTERS_BINDING, m_clusterBuffer.glId());
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_binProgram.use();
+  const auto inverseProjMatrix = glm::inverse(projMatrix);
+  glUniformMatrix4fv(
+      m_uInverseProjMatrix, 1, GL_FALSE, glm::value_ptr(inverseProjMatrix));
+  glUniform1f(m_uNear, zNear);
+  glUniform1f(m_uFar, zFar);
+  glDispatchCompute((GRID_X * GRID_Y * GRID_Z + 63) / 64, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  glUseProgram(GLuint(previousProgram));
+}
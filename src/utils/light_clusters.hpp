@@ -0,0 +1,103 @@
+#pragma once
+
+#include "flat_scene.hpp"
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <vector>
+
+// Clustered forward shading of the KHR_lights_punctual lights of a model
+// (--punctual-lights).
+//
+// The view frustum is split in a grid of clusters: GRID_X x GRID_Y tiles of
+// the screen, each cut along the view depth in GRID_Z slices whose thickness
+// grows with the depth. Each time the scene is drawn, the lights are
+// uploaded in view space and light_clusters.cs.glsl lists the point and spot
+// lights whose range reaches each cluster. The fragment shader then only
+// loops over the lights of its cluster, so that its cost depends on the
+// lights around a point rather than on all the lights of the scene.
+// Directional lights reach every cluster and are not binned.
+//
+// Lights without a range fade out where their intensity falls below
+// LIGHT_THRESHOLD. A cluster lists at most MAX_CLUSTER_LIGHTS lights, those
+// of lower indices.
+class LightClusters
+{
+public:
+  static const GLuint GRID_X = 16;
+  static const GLuint GRID_Y = 9;
+  static const GLuint GRID_Z = 24;
+  static const GLuint MAX_CLUSTER_LIGHTS = 127;
+
+  // Of lights without a range, on the final color (8 bits per channel)
+  static constexpr float LIGHT_THRESHOLD = 1.f / 256.f;
+
+  // Storage buffers read by pbr_directional_light.fs.glsl and
+  // light_clusters.cs.glsl, after those of the skinning pre-pass
+  static const GLuint LIGHTS_BINDING = 10;
+  static const GLuint CLUSTERS_BINDING = 11;
+
+  // Lights of the nodes of scene, binProgram is light_clusters.cs.glsl
+  LightClusters(const tinygltf::Model &model, const FlatScene &scene,
+      GLProgram binProgram);
+
+  LightClusters(const LightClusters &) = delete;
+
+  LightClusters &operator=(const LightClusters &) = delete;
+
+  // Of the scene, all shaded by update(), whatever their position
+  size_t lightCount() const { return m_nodeLights.size(); }
+
+  // Upload the lights at the world matrices of scene, in the view space of
+  // viewMatrix, and bin them in the clusters of the perspective projMatrix
+  // for a viewport of width x height pixels. Binds the buffers for the next
+  // draws. Without enabled, the scene is drawn without them.
+  void update(const FlatScene &scene, const glm::mat4 &viewMatrix,
+      const glm::mat4 &projMatrix, GLsizei width, GLsizei height,
+      bool enabled = true);
+
+private:
+  // Same layout as in light_clusters.cs.glsl (std430)
+  struct Light
+  {
+    glm::vec4 positionRange;
+    glm::vec4 directionType; // Type is one of the values of LightType
+    glm::vec4 color;
+    glm::vec4 spot;
+  };
+
+  enum LightType
+  {
+    Directional = 0,
+    Point = 1,
+    Spot = 2
+  };
+
+  struct GridHeader
+  {
+    glm::uvec4 gridSize;
+    glm::vec4 gridScales;
+  };
+
+  // Light of the node of a flat scene entry, directional ones first
+  struct NodeLight
+  {
+    size_t entry;
+    Light light; // In the local space of the node
+  };
+
+  std::vector<NodeLight> m_nodeLights;
+  size_t m_directionalLightCount = 0;
+  std::vector<Light> m_viewLights; // Uploaded after their counts
+  GLProgram m_binProgram;
+  GLint m_uInverseProjMatrix = -1;
+  GLint m_uNear = -1;
+  GLint m_uFar = -1;
+  GLBuffer m_lightBuffer;
+  GLBuffer m_clusterBuffer;
+};
@@ -0,0 +1,94 @@
+#include "load_profile.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+size_t getPeakResidentBytes()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      std::istringstream fields(line.substr(6));
+      size_t kilobytes = 0;
+      fields >> kilobytes;
+      return kilobytes * 1024;
+    }
+  }
+  return 0;
+}
+
+bool resetPeakResidentBytes()
+{
+  // Since Linux 4.0
+  std::ofstream clearRefs("/proc/self/clear_refs");
+  clearRefs << "5";
+  clearRefs.close();
+  return bool(clearRefs);
+}
+
+LoadPhaseTimer::LoadPhaseTimer(std::vector<LoadPhase> *phases, const char *name)
+    : m_phases(phases), m_name(name)
+{
+  if (m_phases) {
+    resetPeakResidentBytes();
+    resetPeakLiveBytes();
+    m_beginAllocations = getAllocationCounts();
+    m_beginThreadAllocations = getThreadAllocationCounts();
+    m_begin = std::chrono::steady_clock::now();
+  }
+}
+
+void LoadPhaseTimer::end()
+{
+  if (!m_phases) {
+    return;
+  }
+  const std::chrono::duration<double> duration =
+      std::chrono::steady_clock::now() - m_begin;
+  const auto allocations = getAllocationCounts();
+  const auto threadAllocations = getThreadAllocationCounts();
+  m_phases->push_back(LoadPhase{m_name, duration.count(),
+      getPeakResidentBytes(),
+      allocations.allocatedBytes - m_beginAllocations.allocatedBytes,
+      allocations.allocationCount - m_beginAllocations.allocationCount,
+      threadAllocations.allocatedBytes -
+          m_beginThreadAllocations.allocatedBytes,
+      getPeakLiveBytes()});
+  m_phases = nullptr;
+}
+
+void writeLoadPhasesCsvHeader(std::ostream &output)
+{
+  output << "file,run,phase,seconds,peak_rss_bytes,allocated_bytes,"
+            "allocations,thread_allocated_bytes,peak_heap_bytes\n";
+}
+
+void writeLoadPhasesCsvRows(std::ostream &output, const std::string &file,
+    size_t run, const std::vector<LoadPhase> &phases)
+{
+  // Quoted, file names may contain commas
+  std::string quotedFile = "\"";
+  for (const auto c : file) {
+    quotedFile += c == '"' ? std::string("\"\"") : std::string(1, c);
+  }
+  quotedFile += '"';
+  const auto flags = output.flags();
+  const auto precision = output.precision();
+  output << std::fixed << std::setprecision(6);
+  for (const auto &phase : phases) {
+    output << quotedFile << ',' << run << ',' << phase.name << ','
+           << phase.seconds << ',' << phase.peakResidentBytes;
+    if (hasAllocationStats()) {
+      output << ',' << phase.allocatedBytes << ',' << phase.allocationCount
+             << ',' << phase.threadAllocatedBytes << ','
+             << phase.peakLiveBytes << '\n';
+    } else {
+      output << ",,,,\n";
+    }
+  }
+  output.flags(flags);
+  output.precision(precision);
+}
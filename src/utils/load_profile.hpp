@@ -0,0 +1,64 @@
+#pragma once
+
+#include "allocation_stats.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Wall time of a phase of loading a scene, and the peak resident memory of
+// the process during the phase. In builds counting allocations (see
+// allocation_stats.hpp), also the heap allocations of the phase, by all
+// threads and by the thread of the phase, and the peak of the live heap.
+struct LoadPhase
+{
+  const char *name;
+  double seconds = 0;
+  size_t peakResidentBytes = 0; // 0 if unknown
+  size_t allocatedBytes = 0;
+  size_t allocationCount = 0;
+  size_t threadAllocatedBytes = 0;
+  size_t peakLiveBytes = 0;
+};
+
+// Peak resident set size of the process (VmHWM on Linux), 0 if unknown
+size_t getPeakResidentBytes();
+
+// Reset the peak resident set size to the current one, so that the next
+// getPeakResidentBytes is the peak since then. Returns false if not
+// supported, the peak is then the one since the start of the process.
+bool resetPeakResidentBytes();
+
+// Record its lifetime as a phase appended to phases, nothing if phases is
+// null. name must be a string literal.
+class LoadPhaseTimer
+{
+public:
+  LoadPhaseTimer(std::vector<LoadPhase> *phases, const char *name);
+
+  ~LoadPhaseTimer() { end(); }
+
+  LoadPhaseTimer(const LoadPhaseTimer &) = delete;
+
+  LoadPhaseTimer &operator=(const LoadPhaseTimer &) = delete;
+
+  // End the phase before the end of the scope
+  void end();
+
+private:
+  std::vector<LoadPhase> *m_phases;
+  const char *m_name;
+  std::chrono::steady_clock::time_point m_begin;
+  AllocationCounts m_beginAllocations;
+  AllocationCounts m_beginThreadAllocations;
+};
+
+// One row per phase of each load: file,run,phase,seconds,peak_rss_bytes,
+// then allocated_bytes,allocations,thread_allocated_bytes,peak_heap_bytes,
+// empty in builds not counting allocations
+void writeLoadPhasesCsvHeader(std::ostream &output);
+
+void writeLoadPhasesCsvRows(std::ostream &output, const std::string &file,
+    size_t run, const std::vector<LoadPhase> &phases);
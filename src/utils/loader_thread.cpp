@@ -0,0 +1,108 @@
+#include "loader_thread.hpp"
+
+#include <stdexcept>
+
+#ifdef GLTF_VIEWER_HEADLESS
+
+GLLoaderThread::GLLoaderThread(GLFWwindow *) : m_window(nullptr)
+{
+  throw std::runtime_error("No loader thread in a build without GLFW");
+}
+
+GLLoaderThread::~GLLoaderThread() = default;
+
+#else
+
+GLLoaderThread::GLLoaderThread(GLFWwindow *window)
+{
+  // The hints of the window of GLFWHandle are still set
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  m_window = glfwCreateWindow(1, 1, "glTF Viewer loader", nullptr, window);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (!m_window) {
+    throw std::runtime_error("Unable to create the loader GL context");
+  }
+
+  m_thread = std::thread([this]() {
+    glfwMakeContextCurrent(m_window);
+    for (;;) {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condition.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+      if (m_stop) {
+        break;
+      }
+      const auto job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      lock.unlock();
+
+      auto publish = job();
+      const auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush(); // Else the fence may never be signaled for other contexts
+
+      lock.lock();
+      m_completedJobs.push_back(CompletedJob{fence, std::move(publish)});
+    }
+    glfwMakeContextCurrent(nullptr);
+  });
+}
+
+GLLoaderThread::~GLLoaderThread()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_condition.notify_one();
+  m_thread.join();
+  for (const auto &job : m_completedJobs) {
+    glDeleteSync(job.fence);
+  }
+  glfwDestroyWindow(m_window);
+}
+
+#endif
+
+void GLLoaderThread::add(Job job)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+    ++m_pendingJobCount;
+  }
+  m_condition.notify_one();
+}
+
+size_t GLLoaderThread::publishCompletedJobs()
+{
+  size_t publishedJobCount = 0;
+  for (;;) {
+    CompletedJob job{};
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_completedJobs.empty()) {
+        break;
+      }
+      const auto status =
+          glClientWaitSync(m_completedJobs.front().fence, 0, 0);
+      if (status == GL_TIMEOUT_EXPIRED) { // A failed wait publishes too
+        break;
+      }
+      job = std::move(m_completedJobs.front());
+      m_completedJobs.pop_front();
+    }
+    glDeleteSync(job.fence);
+    if (job.publish) {
+      job.publish();
+    }
+    ++publishedJobCount;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_pendingJobCount;
+  }
+  return publishedJobCount;
+}
+
+bool GLLoaderThread::idle() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_pendingJobCount == 0;
+}
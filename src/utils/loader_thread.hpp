@@ -0,0 +1,64 @@
+#pragma once
+
+#include "glfw.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Thread making GL calls in a context of its own, created on a hidden window
+// and sharing its objects with the context of a GLFW window. Buffers and
+// textures can be created there while the window thread draws. Vertex
+// arrays, framebuffers and queries are not shared: they must still be
+// created by the window thread.
+//
+// A job runs on the loader thread and returns the function publishing its
+// objects. That function is called on the window thread by
+// publishCompletedJobs(), once a fence put after the GL calls of the job is
+// signaled: objects are complete when the window thread first binds them.
+class GLLoaderThread
+{
+public:
+  using Publish = std::function<void()>;
+  using Job = std::function<Publish()>;
+
+  // From the thread of window, the only one that can create windows
+  explicit GLLoaderThread(GLFWwindow *window);
+
+  // Wait for the running job, drop the others without publishing them. From
+  // the thread of window.
+  ~GLLoaderThread();
+
+  GLLoaderThread(const GLLoaderThread &) = delete;
+
+  GLLoaderThread &operator=(const GLLoaderThread &) = delete;
+
+  // Run job after the jobs added before. job must not throw.
+  void add(Job job);
+
+  // Publish the jobs whose GL calls are done, in the order they were added,
+  // without waiting. From the thread of window. Returns the number of jobs
+  // published.
+  size_t publishCompletedJobs();
+
+  // True when every job added has been published
+  bool idle() const;
+
+private:
+  struct CompletedJob
+  {
+    GLsync fence;
+    Publish publish;
+  };
+
+  GLFWwindow *m_window; // Hidden, current on m_thread
+  std::thread m_thread;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_condition;
+  std::deque<Job> m_jobs; // Not started yet
+  std::deque<CompletedJob> m_completedJobs; // Not published yet
+  size_t m_pendingJobCount = 0; // Added and not published
+  bool m_stop = false;
+};
@@ -0,0 +1,112 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const fs::path &path)
+{
+  const auto error = [&](const char *what) {
+    return std::runtime_error(
+        std::string("Unable to map file ") + path.string() + ": " + what);
+  };
+#ifdef _WIN32
+  m_hFile = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (m_hFile == INVALID_HANDLE_VALUE) {
+    m_hFile = nullptr;
+    throw error("cannot open");
+  }
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(m_hFile, &fileSize);
+  m_nSize = size_t(fileSize.QuadPart);
+  if (m_nSize == 0) {
+    return;
+  }
+  m_hMapping = CreateFileMappingW(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_hMapping) {
+    release();
+    throw error("CreateFileMapping failed");
+  }
+  m_pData = static_cast<const unsigned char *>(
+      MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+  if (!m_pData) {
+    release();
+    throw error("MapViewOfFile failed");
+  }
+#else
+  const auto fd = open(path.string().c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw error("cannot open");
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    throw error("cannot stat");
+  }
+  m_nSize = size_t(fileStat.st_size);
+  if (m_nSize == 0) {
+    close(fd);
+    return;
+  }
+  void *ptr = mmap(nullptr, m_nSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); // The mapping keeps its own reference to the file
+  if (ptr == MAP_FAILED) {
+    m_nSize = 0;
+    throw error("mmap failed");
+  }
+  // Buffers are mostly read front to back for the GPU upload
+  madvise(ptr, m_nSize, MADV_SEQUENTIAL);
+  m_pData = static_cast<const unsigned char *>(ptr);
+#endif
+}
+
+MappedFile::~MappedFile() { release(); }
+
+MappedFile::MappedFile(MappedFile &&rvalue) { *this = std::move(rvalue); }
+
+MappedFile &MappedFile::operator=(MappedFile &&rvalue)
+{
+  if (this != &rvalue) {
+    release();
+    std::swap(m_pData, rvalue.m_pData);
+    std::swap(m_nSize, rvalue.m_nSize);
+#ifdef _WIN32
+    std::swap(m_hFile, rvalue.m_hFile);
+    std::swap(m_hMapping, rvalue.m_hMapping);
+#endif
+  }
+  return *this;
+}
+
+void MappedFile::release()
+{
+#ifdef _WIN32
+  if (m_pData) {
+    UnmapViewOfFile(m_pData);
+  }
+  if (m_hMapping) {
+    CloseHandle(m_hMapping);
+  }
+  if (m_hFile) {
+    CloseHandle(m_hFile);
+  }
+  m_hFile = nullptr;
+  m_hMapping = nullptr;
+#else
+  if (m_pData) {
+    munmap(const_cast<unsigned char *>(m_pData), m_nSize);
+  }
+#endif
+  m_pData = nullptr;
+  m_nSize = 0;
+}
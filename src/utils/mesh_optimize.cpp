@@ -0,0 +1,748 @@
+#include "mesh_optimize.hpp"
+#include "accessor_view.hpp"
+#include "parallel.hpp"
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <string>
+
+namespace {
+
+// Size of the simulated post-transform vertex cache
+const size_t cacheSize = 16;
+// Vertices used by more live triangles all get the same valence score
+const uint32_t maxValence = 32;
+
+struct ScoreTables
+{
+  ScoreTables()
+  {
+    for (size_t i = 0; i < cacheSize; ++i) {
+      // The vertices of the last triangle get a fixed score, so that the next
+      // triangle does not favor one of its edges
+      cache[i] = i < 3 ? 0.75f
+                       : std::pow(1.f - float(i - 3) / float(cacheSize - 3),
+                             1.5f);
+    }
+    valence[0] = 0.f;
+    for (uint32_t i = 1; i <= maxValence; ++i) {
+      valence[i] = 2.f / std::sqrt(float(i));
+    }
+  }
+
+  float cache[cacheSize];
+  float valence[maxValence + 1];
+};
+
+// Score of a vertex at cachePosition (-1 if not in the cache) used by
+// liveTriangles triangles not emitted yet. Favors vertices in the cache, and
+// vertices with few triangles left so that they are not left behind.
+float getVertexScore(int cachePosition, uint32_t liveTriangles)
+{
+  static const ScoreTables tables;
+  if (!liveTriangles) {
+    return 0.f;
+  }
+  const auto cacheScore = cachePosition >= 0 ? tables.cache[cachePosition] : 0.f;
+  return cacheScore + tables.valence[std::min(liveTriangles, maxValence)];
+}
+
+// Data of an accessor, checked to be in its buffer. Returns nullptr for
+// sparse accessors and accessors out of their buffer.
+const unsigned char *getAccessorData(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, size_t elementSize, size_t &byteStride)
+{
+  if (accessor.sparse.isSparse || accessor.bufferView < 0 || !accessor.count) {
+    return nullptr;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto &bytes = bufferBytes[bufferView.buffer];
+  byteStride = bufferView.byteStride ? bufferView.byteStride : elementSize;
+  const auto offset = bufferView.byteOffset + accessor.byteOffset;
+  if (offset + byteStride * (accessor.count - 1) + elementSize > bytes.size) {
+    return nullptr;
+  }
+  return bytes.data + offset;
+}
+
+template <typename Indices>
+bool readIndices(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Accessor &accessor, Indices &indices)
+{
+  if (!accessor.count) {
+    return false;
+  }
+  return readIndexAccessor(model, bufferBytes, accessor, indices);
+}
+
+void writeIndices(const std::vector<uint32_t> &indices, int componentType,
+    unsigned char *data)
+{
+  for (size_t i = 0; i < indices.size(); ++i) {
+    switch (componentType) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+      data[i] = uint8_t(indices[i]);
+      break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+      const auto value = uint16_t(indices[i]);
+      std::memcpy(data + sizeof(value) * i, &value, sizeof(value));
+      break;
+    }
+    default:
+      std::memcpy(data + sizeof(uint32_t) * i, &indices[i], sizeof(uint32_t));
+      break;
+    }
+  }
+}
+
+} // namespace
+
+std::vector<uint32_t> optimizeVertexCache(
+    const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+  const auto triangleCount = indexCount / 3;
+
+  // Triangles of each vertex, those not emitted yet are the first
+  // liveTriangles[vertex] ones. Tables only live during the call, in the
+  // arena of the thread.
+  const ScratchArena::Scope scratch;
+  ScratchVector<uint32_t> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    ++liveTriangles[indices[i]];
+  }
+  ScratchVector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    adjacencyOffsets[vertex + 1] =
+        adjacencyOffsets[vertex] + liveTriangles[vertex];
+  }
+  ScratchVector<uint32_t> adjacency(triangleCount * 3);
+  {
+    ScratchVector<uint32_t> ends(
+        begin(adjacencyOffsets), end(adjacencyOffsets) - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+      adjacency[ends[indices[i]]++] = uint32_t(i / 3);
+    }
+  }
+
+  ScratchVector<int> cachePositions(vertexCount, -1);
+  ScratchVector<float> vertexScores(vertexCount);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    vertexScores[vertex] = getVertexScore(-1, liveTriangles[vertex]);
+  }
+  ScratchVector<float> triangleScores(triangleCount);
+  for (size_t t = 0; t < triangleCount; ++t) {
+    triangleScores[t] = vertexScores[indices[3 * t]] +
+                        vertexScores[indices[3 * t + 1]] +
+                        vertexScores[indices[3 * t + 2]];
+  }
+
+  std::vector<uint32_t> optimized;
+  optimized.reserve(triangleCount * 3);
+  ScratchVector<bool> isEmitted(triangleCount, false);
+  ScratchVector<uint32_t> cache, newCache;
+  cache.reserve(cacheSize + 3);
+  newCache.reserve(cacheSize + 3);
+  size_t inputCursor = 0; // Triangles before it are all emitted
+  auto triangle = triangleCount ? size_t(std::max_element(begin(triangleScores),
+                                             end(triangleScores)) -
+                                         begin(triangleScores))
+                                : triangleCount;
+  while (triangle < triangleCount) {
+    const auto *corners = indices + 3 * triangle;
+    optimized.insert(end(optimized), corners, corners + 3);
+    isEmitted[triangle] = true;
+    for (auto c = 0; c < 3; ++c) {
+      const auto vertex = corners[c];
+      auto *first = adjacency.data() + adjacencyOffsets[vertex];
+      auto *last = first + liveTriangles[vertex];
+      *std::find(first, last, uint32_t(triangle)) = *(last - 1);
+      --liveTriangles[vertex];
+    }
+
+    // The vertices of the triangle enter the cache, pushing the others
+    newCache.clear();
+    for (auto c = 0; c < 3; ++c) {
+      if (std::find(begin(newCache), end(newCache), corners[c]) ==
+          end(newCache)) {
+        newCache.push_back(corners[c]);
+      }
+    }
+    for (const auto vertex : cache) {
+      if (std::find(corners, corners + 3, vertex) == corners + 3) {
+        newCache.push_back(vertex);
+      }
+    }
+    for (size_t i = 0; i < newCache.size(); ++i) {
+      const auto vertex = newCache[i];
+      cachePositions[vertex] = i < cacheSize ? int(i) : -1;
+      const auto score =
+          getVertexScore(cachePositions[vertex], liveTriangles[vertex]);
+      const auto delta = score - vertexScores[vertex];
+      vertexScores[vertex] = score;
+      const auto *first = adjacency.data() + adjacencyOffsets[vertex];
+      for (const auto *t = first; t != first + liveTriangles[vertex]; ++t) {
+        triangleScores[*t] += delta;
+      }
+    }
+    newCache.resize(std::min(newCache.size(), cacheSize));
+    std::swap(cache, newCache);
+
+    // Next is the best triangle using a cached vertex, or the first one left
+    // in input order when the cache is a dead end
+    triangle = triangleCount;
+    auto bestScore = -1.f;
+    for (const auto vertex : cache) {
+      const auto *first = adjacency.data() + adjacencyOffsets[vertex];
+      for (const auto *t = first; t != first + liveTriangles[vertex]; ++t) {
+        if (triangleScores[*t] > bestScore) {
+          bestScore = triangleScores[*t];
+          triangle = *t;
+        }
+      }
+    }
+    if (triangle == triangleCount) {
+      while (inputCursor < triangleCount && isEmitted[inputCursor]) {
+        ++inputCursor;
+      }
+      triangle = inputCursor;
+    }
+  }
+  return optimized;
+}
+
+std::vector<uint32_t> optimizeOverdraw(const uint32_t *indices,
+    size_t indexCount, const glm::vec3 *positions, size_t vertexCount,
+    float threshold)
+{
+  const auto triangleCount = indexCount / 3;
+  if (!triangleCount) {
+    return {};
+  }
+  const ScratchArena::Scope scratch;
+
+  // FIFO cache simulation: a vertex is cached while less than cacheSize
+  // vertices missed since it did
+  ScratchVector<uint32_t> missTimes(vertexCount, 0);
+  auto time = uint32_t(cacheSize + 1);
+  const auto countMisses = [&](size_t t) {
+    auto misses = 0u;
+    for (auto c = 0; c < 3; ++c) {
+      const auto vertex = indices[3 * t + c];
+      if (time - missTimes[vertex] > cacheSize) {
+        missTimes[vertex] = time++;
+        ++misses;
+      }
+    }
+    return misses;
+  };
+  const auto resetCache = [&]() { time += uint32_t(cacheSize + 1); };
+
+  // Clusters start where the cache optimization already had to restart from
+  // scratch, and are split further as long as each part stays about as cache
+  // efficient as the whole cluster
+  ScratchVector<size_t> hardClusters;
+  for (size_t t = 0; t < triangleCount; ++t) {
+    if (countMisses(t) == 3 || t == 0) {
+      hardClusters.push_back(t);
+    }
+  }
+  hardClusters.push_back(triangleCount);
+  ScratchVector<size_t> clusters;
+  for (size_t k = 0; k + 1 < hardClusters.size(); ++k) {
+    const auto first = hardClusters[k];
+    const auto last = hardClusters[k + 1];
+    resetCache();
+    auto misses = 0u;
+    for (auto t = first; t < last; ++t) {
+      misses += countMisses(t);
+    }
+    const auto clusterThreshold = threshold * float(misses) / float(last - first);
+
+    resetCache();
+    clusters.push_back(first);
+    auto start = first;
+    misses = 0;
+    for (auto t = first; t < last; ++t) {
+      misses += countMisses(t);
+      if (t + 1 < last &&
+          float(misses) <= clusterThreshold * float(t + 1 - start)) {
+        clusters.push_back(t + 1);
+        start = t + 1;
+        misses = 0;
+        resetCache();
+      }
+    }
+  }
+  clusters.push_back(triangleCount);
+
+  // Clusters facing away from the center of the mesh are drawn first
+  const auto clusterCount = clusters.size() - 1;
+  ScratchVector<glm::vec3> centroids(clusterCount, glm::vec3(0));
+  ScratchVector<glm::vec3> normals(clusterCount, glm::vec3(0));
+  ScratchVector<float> areas(clusterCount, 0.f);
+  auto meshCentroid = glm::vec3(0);
+  auto meshArea = 0.f;
+  for (size_t k = 0; k < clusterCount; ++k) {
+    for (auto t = clusters[k]; t < clusters[k + 1]; ++t) {
+      const auto &p0 = positions[indices[3 * t]];
+      const auto &p1 = positions[indices[3 * t + 1]];
+      const auto &p2 = positions[indices[3 * t + 2]];
+      const auto normal = glm::cross(p1 - p0, p2 - p0);
+      const auto area = glm::length(normal);
+      centroids[k] += (p0 + p1 + p2) * (area / 3.f);
+      normals[k] += normal;
+      areas[k] += area;
+    }
+    meshCentroid += centroids[k];
+    meshArea += areas[k];
+  }
+  if (meshArea > 0) {
+    meshCentroid /= meshArea;
+  }
+  ScratchVector<float> keys(clusterCount, 0.f);
+  for (size_t k = 0; k < clusterCount; ++k) {
+    const auto normalLength = glm::length(normals[k]);
+    if (areas[k] > 0 && normalLength > 0) {
+      keys[k] = glm::dot(
+          centroids[k] / areas[k] - meshCentroid, normals[k] / normalLength);
+    }
+  }
+  ScratchVector<size_t> order(clusterCount);
+  for (size_t k = 0; k < clusterCount; ++k) {
+    order[k] = k;
+  }
+  std::stable_sort(begin(order), end(order),
+      [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+  std::vector<uint32_t> optimized;
+  optimized.reserve(triangleCount * 3);
+  for (const auto k : order) {
+    optimized.insert(end(optimized), indices + 3 * clusters[k],
+        indices + 3 * clusters[k + 1]);
+  }
+  return optimized;
+}
+
+std::vector<uint32_t> computeVertexFetchRemap(
+    const uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+  const auto unused = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> remap(vertexCount, unused);
+  uint32_t nextVertex = 0;
+  for (size_t i = 0; i < indexCount; ++i) {
+    if (remap[indices[i]] == unused) {
+      remap[indices[i]] = nextVertex++;
+    }
+  }
+  for (auto &vertex : remap) {
+    if (vertex == unused) {
+      vertex = nextVertex++;
+    }
+  }
+  return remap;
+}
+
+void optimizeMeshes(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  // Primitives are grouped by attributes. The vertices of a group can be
+  // reordered if no other group nor anything else reads its accessors, and
+  // all its primitives get optimized indices.
+  struct Group
+  {
+    std::map<std::string, int> attributes;
+    std::vector<int> indexAccessors;
+    size_t vertexCount = 0;
+    bool remapVertices = true;
+  };
+  std::vector<Group> groups;
+  std::map<std::map<std::string, int>, size_t> groupIndices;
+  const auto noGroup = -1;
+  const auto sharedGroup = -2;
+  std::vector<int> accessorGroups(model.accessors.size(), noGroup);
+  const auto addUse = [&](int accessorIdx, int group) {
+    if (accessorIdx < 0 || size_t(accessorIdx) >= model.accessors.size()) {
+      return;
+    }
+    auto &owner = accessorGroups[accessorIdx];
+    owner = owner == noGroup || owner == group ? group : sharedGroup;
+  };
+  // Triangles of index accessors used by blended primitives keep their order
+  std::vector<bool> keepTriangleOrder(model.accessors.size(), false);
+
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      const auto it =
+          groupIndices.emplace(primitive.attributes, groups.size()).first;
+      if (it->second == groups.size()) {
+        groups.emplace_back();
+        groups.back().attributes = primitive.attributes;
+      }
+      const auto group = int(it->second);
+      for (const auto &attribute : primitive.attributes) {
+        addUse(attribute.second, group);
+      }
+      addUse(primitive.indices, group);
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES || primitive.indices < 0 ||
+          !primitive.targets.empty()) {
+        groups[group].remapVertices = false;
+        continue;
+      }
+      groups[group].indexAccessors.push_back(primitive.indices);
+      if (primitive.material >= 0 &&
+          model.materials[primitive.material].alphaMode == "BLEND") {
+        keepTriangleOrder[primitive.indices] = true;
+      }
+    }
+  }
+  for (const auto &skin : model.skins) {
+    addUse(skin.inverseBindMatrices, sharedGroup);
+  }
+  for (const auto &animation : model.animations) {
+    for (const auto &sampler : animation.samplers) {
+      addUse(sampler.input, sharedGroup);
+      addUse(sampler.output, sharedGroup);
+    }
+  }
+  for (const auto &node : model.nodes) {
+    const auto it = node.extensions.find("EXT_mesh_gpu_instancing");
+    if (it != end(node.extensions) && it->second.Has("attributes")) {
+      const auto &attributes = it->second.Get("attributes");
+      for (const auto &key : attributes.Keys()) {
+        if (attributes.Get(key).IsInt()) {
+          addUse(attributes.Get(key).GetNumberAsInt(), sharedGroup);
+        }
+      }
+    }
+  }
+
+  struct Job
+  {
+    size_t group;
+    int accessor;
+    std::vector<uint32_t> indices;
+    bool isValid = false;
+  };
+  std::vector<Job> jobs;
+  for (size_t g = 0; g < groups.size(); ++g) {
+    auto &group = groups[g];
+    const auto positionIt = group.attributes.find("POSITION");
+    if (positionIt == end(group.attributes)) {
+      continue;
+    }
+    group.vertexCount = model.accessors[positionIt->second].count;
+    for (const auto &attribute : group.attributes) {
+      const auto &accessor = model.accessors[attribute.second];
+      size_t byteStride = 0;
+      const auto elementSize =
+          size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+                 tinygltf::GetNumComponentsInType(accessor.type));
+      if (accessorGroups[attribute.second] != int(g) ||
+          accessor.count != group.vertexCount ||
+          tinygltf::GetNumComponentsInType(accessor.type) > 4 ||
+          !getAccessorData(
+              model, bufferBytes, accessor, elementSize, byteStride)) {
+        group.remapVertices = false;
+      }
+    }
+    std::sort(begin(group.indexAccessors), end(group.indexAccessors));
+    group.indexAccessors.erase(
+        std::unique(begin(group.indexAccessors), end(group.indexAccessors)),
+        end(group.indexAccessors));
+    for (const auto accessorIdx : group.indexAccessors) {
+      if (accessorGroups[accessorIdx] != int(g) ||
+          model.accessors[accessorIdx].count % 3) {
+        group.remapVertices = false;
+        continue;
+      }
+      jobs.push_back({g, accessorIdx, {}});
+    }
+  }
+  if (jobs.empty()) {
+    return;
+  }
+
+  parallelFor(jobs.size(), [&](size_t i) {
+    const ScratchArena::Scope scratch;
+    auto &job = jobs[i];
+    const auto &group = groups[job.group];
+    ScratchVector<uint32_t> indices;
+    if (!readIndices(
+            model, bufferBytes, model.accessors[job.accessor], indices) ||
+        std::any_of(begin(indices), end(indices),
+            [&](uint32_t index) { return index >= group.vertexCount; })) {
+      return;
+    }
+    job.isValid = true;
+    if (keepTriangleOrder[job.accessor]) {
+      job.indices.assign(begin(indices), end(indices));
+      return;
+    }
+    job.indices =
+        optimizeVertexCache(indices.data(), indices.size(), group.vertexCount);
+    std::vector<float> values;
+    if (readFloatAccessor(model, bufferBytes,
+            group.attributes.at("POSITION"), 3, values)) {
+      ScratchVector<glm::vec3> positions(group.vertexCount);
+      std::memcpy(positions.data(), values.data(),
+          sizeof(glm::vec3) * group.vertexCount);
+      job.indices = optimizeOverdraw(job.indices.data(), job.indices.size(),
+          positions.data(), positions.size(), 1.05f);
+    }
+  });
+
+  // Vertices are remapped in their order of first use by all the indices of
+  // their group
+  std::vector<std::vector<Job *>> groupJobs(groups.size());
+  for (auto &job : jobs) {
+    groupJobs[job.group].push_back(&job);
+    groups[job.group].remapVertices &= job.isValid;
+  }
+  std::vector<std::vector<uint32_t>> remaps(groups.size());
+  parallelFor(groups.size(), [&](size_t g) {
+    if (!groups[g].remapVertices || groupJobs[g].empty()) {
+      return;
+    }
+    const ScratchArena::Scope scratch;
+    ScratchVector<uint32_t> indices;
+    for (const auto *job : groupJobs[g]) {
+      indices.insert(end(indices), begin(job->indices), end(job->indices));
+    }
+    remaps[g] = computeVertexFetchRemap(
+        indices.data(), indices.size(), groups[g].vertexCount);
+    for (auto *job : groupJobs[g]) {
+      for (auto &index : job->indices) {
+        index = remaps[g][index];
+      }
+    }
+  });
+
+  // Written in a new buffer, the original bytes may be a read only mapping
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  const auto addBufferView = [&](size_t byteLength, size_t byteStride,
+                                 int target) {
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = (buffer.data.size() + 3) / 4 * 4;
+    bufferView.byteLength = byteLength;
+    bufferView.byteStride = byteStride;
+    bufferView.target = target;
+    buffer.data.resize(bufferView.byteOffset + byteLength);
+    model.bufferViews.push_back(bufferView);
+    return int(model.bufferViews.size() - 1);
+  };
+  for (const auto &job : jobs) {
+    if (!job.isValid) {
+      continue;
+    }
+    auto &accessor = model.accessors[job.accessor];
+    const auto indexSize =
+        size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+    accessor.bufferView = addBufferView(indexSize * job.indices.size(), 0,
+        TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+    accessor.byteOffset = 0;
+    writeIndices(job.indices, accessor.componentType,
+        buffer.data.data() + model.bufferViews[accessor.bufferView].byteOffset);
+  }
+  for (size_t g = 0; g < groups.size(); ++g) {
+    if (remaps[g].empty()) {
+      continue;
+    }
+    for (const auto &attribute : groups[g].attributes) {
+      auto &accessor = model.accessors[attribute.second];
+      const auto elementSize =
+          size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+                 tinygltf::GetNumComponentsInType(accessor.type));
+      size_t sourceStride = 0;
+      const auto *source = getAccessorData(
+          model, bufferBytes, accessor, elementSize, sourceStride);
+      // Vertex attributes must be aligned on 4 bytes
+      const auto byteStride = (elementSize + 3) / 4 * 4;
+      accessor.bufferView = addBufferView(byteStride * accessor.count,
+          byteStride == elementSize ? 0 : byteStride,
+          TINYGLTF_TARGET_ARRAY_BUFFER);
+      accessor.byteOffset = 0;
+      auto *destination =
+          buffer.data.data() + model.bufferViews[accessor.bufferView].byteOffset;
+      for (size_t vertex = 0; vertex < accessor.count; ++vertex) {
+        std::memcpy(destination + byteStride * remaps[g][vertex],
+            source + sourceStride * vertex, elementSize);
+      }
+    }
+  }
+
+  model.buffers.push_back(std::move(buffer));
+  bufferBytes.push_back(
+      {model.buffers.back().data.data(), model.buffers.back().data.size()});
+}
+
+size_t normalizeTopologies(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  // Converted accessor of each source accessor (or vertex count of non
+  // indexed primitives, as -1 - count) and mode
+  std::map<std::pair<int64_t, int>, int> convertedAccessors;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> converted;
+  size_t primitiveCount = 0;
+  for (auto &mesh : model.meshes) {
+    for (auto &primitive : mesh.primitives) {
+      const auto mode = primitive.mode;
+      if (mode != TINYGLTF_MODE_TRIANGLE_STRIP &&
+          mode != TINYGLTF_MODE_TRIANGLE_FAN &&
+          mode != TINYGLTF_MODE_LINE_STRIP &&
+          mode != TINYGLTF_MODE_LINE_LOOP) {
+        continue;
+      }
+      const auto position = primitive.attributes.find("POSITION");
+      if (position == end(primitive.attributes)) {
+        continue;
+      }
+      const auto vertexCount = model.accessors[position->second].count;
+      const auto listMode =
+          mode == TINYGLTF_MODE_LINE_STRIP || mode == TINYGLTF_MODE_LINE_LOOP
+              ? TINYGLTF_MODE_LINE
+              : TINYGLTF_MODE_TRIANGLES;
+      const auto key = std::make_pair(primitive.indices >= 0
+                                          ? int64_t(primitive.indices)
+                                          : -1 - int64_t(vertexCount),
+          mode);
+      const auto it = convertedAccessors.find(key);
+      if (it != end(convertedAccessors)) {
+        primitive.indices = it->second;
+        primitive.mode = listMode;
+        ++primitiveCount;
+        continue;
+      }
+
+      if (primitive.indices >= 0) {
+        if (!readIndices(model, bufferBytes,
+                model.accessors[primitive.indices], indices)) {
+          continue; // Sparse or out of bounds, left to the driver
+        }
+      } else {
+        indices.resize(vertexCount);
+        std::iota(begin(indices), end(indices), uint32_t(0));
+      }
+      converted.clear();
+      const auto count = indices.size();
+      if (listMode == TINYGLTF_MODE_TRIANGLES) {
+        for (size_t i = 2; i < count; ++i) {
+          // Odd triangles of strips are reversed to keep the winding
+          const auto a = mode == TINYGLTF_MODE_TRIANGLE_FAN
+                             ? indices[0]
+                             : indices[i % 2 ? i - 1 : i - 2];
+          const auto b = mode == TINYGLTF_MODE_TRIANGLE_FAN
+                             ? indices[i - 1]
+                             : indices[i % 2 ? i - 2 : i - 1];
+          const auto c = indices[i];
+          if (a != b && b != c && c != a) {
+            converted.insert(end(converted), {a, b, c});
+          }
+        }
+      } else {
+        for (size_t i = 1; i < count; ++i) {
+          converted.insert(end(converted), {indices[i - 1], indices[i]});
+        }
+        if (mode == TINYGLTF_MODE_LINE_LOOP && count > 2) {
+          converted.insert(end(converted), {indices[count - 1], indices[0]});
+        }
+      }
+
+      if (converted.empty()) {
+        continue; // Draws nothing either way
+      }
+      const auto maxIndex =
+          *std::max_element(begin(converted), end(converted));
+      const auto componentType =
+          maxIndex < std::numeric_limits<uint16_t>::max()
+              ? TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT
+              : TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT;
+      tinygltf::BufferView bufferView;
+      bufferView.buffer = bufferIdx;
+      bufferView.byteOffset = (buffer.data.size() + 3) / 4 * 4;
+      bufferView.byteLength =
+          size_t(tinygltf::GetComponentSizeInBytes(componentType)) *
+          converted.size();
+      bufferView.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+      buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+      writeIndices(
+          converted, componentType, buffer.data.data() + bufferView.byteOffset);
+      model.bufferViews.push_back(bufferView);
+
+      tinygltf::Accessor accessor;
+      accessor.bufferView = int(model.bufferViews.size() - 1);
+      accessor.byteOffset = 0;
+      accessor.componentType = componentType;
+      accessor.type = TINYGLTF_TYPE_SCALAR;
+      accessor.count = converted.size();
+      model.accessors.push_back(accessor);
+      primitive.indices = int(model.accessors.size() - 1);
+      primitive.mode = listMode;
+      convertedAccessors[key] = primitive.indices;
+      ++primitiveCount;
+    }
+  }
+  if (!buffer.data.empty()) {
+    model.buffers.push_back(std::move(buffer));
+    bufferBytes.push_back(
+        {model.buffers.back().data.data(), model.buffers.back().data.size()});
+  }
+  return primitiveCount;
+}
+
+void promoteByteIndices(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  std::vector<int> accessors;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (primitive.indices >= 0 &&
+          model.accessors[primitive.indices].componentType ==
+              TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
+        accessors.push_back(primitive.indices);
+      }
+    }
+  }
+  std::sort(begin(accessors), end(accessors));
+  accessors.erase(
+      std::unique(begin(accessors), end(accessors)), end(accessors));
+
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  std::vector<uint32_t> indices;
+  for (const auto accessorIdx : accessors) {
+    auto &accessor = model.accessors[accessorIdx];
+    if (!readIndices(model, bufferBytes, accessor, indices)) {
+      continue; // Sparse or out of bounds, left to the driver
+    }
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = (buffer.data.size() + 3) / 4 * 4;
+    bufferView.byteLength = sizeof(uint16_t) * indices.size();
+    bufferView.target = TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    writeIndices(indices, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+        buffer.data.data() + bufferView.byteOffset);
+    model.bufferViews.push_back(bufferView);
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.byteOffset = 0;
+    accessor.componentType = TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT;
+  }
+  if (buffer.data.empty()) {
+    return;
+  }
+  model.buffers.push_back(std::move(buffer));
+  bufferBytes.push_back(
+      {model.buffers.back().data.data(), model.buffers.back().data.size()});
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// Reorder the triangles of a triangle list so that consecutive triangles
+// share vertices, for the post-transform vertex cache (Forsyth's algorithm,
+// with a simulated cache of 16 vertices). Indices must be below vertexCount.
+std::vector<uint32_t> optimizeVertexCache(
+    const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Reorder the triangles of a list already optimized for the vertex cache so
+// that outer surfaces tend to be drawn first, reducing overdraw. The list is
+// split in clusters that keep the cache efficiency within threshold (1.05
+// allows 5% more cache misses), sorted by how much they face away from the
+// center of the mesh. Indices must be below vertexCount, the size of
+// positions.
+std::vector<uint32_t> optimizeOverdraw(const uint32_t *indices,
+    size_t indexCount, const glm::vec3 *positions, size_t vertexCount,
+    float threshold);
+
+// New position of each of the vertexCount vertices so that they are fetched
+// in order of first use by indices. Unused vertices are moved at the end.
+std::vector<uint32_t> computeVertexFetchRemap(
+    const uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+// Apply the three optimizations above to the indexed triangle primitives of
+// the model, without any visual change. Optimized indices, and vertices of
+// primitives that do not share their attributes with others, are written in a
+// new buffer appended to model.buffers, whose bytes are appended to
+// bufferBytes. Accessors are redirected to it. Morph targets and sparse
+// accessors are left untouched.
+void optimizeMeshes(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
+
+// Convert the triangle strips and fans of the model to indexed triangle
+// lists, and its line strips and loops to indexed line lists, so that all
+// primitives of a kind share one topology and can be batched, optimized and
+// merged like lists. Degenerate triangles of strips are dropped, the winding
+// of odd triangles of strips is kept. Indices are written in a new buffer
+// appended to model.buffers like with optimizeMeshes, 16 bits when they fit.
+// Primitives sharing indices and mode share the converted indices. Returns
+// the number of primitives converted.
+size_t normalizeTopologies(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
+
+// Convert the 8 bits index accessors of primitives to 16 bits, which drivers
+// do not have to emulate. Indices are written in a new buffer appended to
+// model.buffers like with optimizeMeshes.
+void promoteByteIndices(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
@@ -0,0 +1,114 @@
+#include "mesh_simplify.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+glm::vec3 readPosition(const unsigned char *positions, size_t byteStride,
+    uint32_t vertex)
+{
+  glm::vec3 position;
+  std::memcpy(&position, positions + byteStride * vertex, sizeof(position));
+  return position;
+}
+
+struct TriangleHash
+{
+  size_t operator()(const std::array<uint32_t, 3> &triangle) const
+  {
+    return (size_t(triangle[0]) * 73856093u) ^
+           (size_t(triangle[1]) * 19349663u) ^
+           (size_t(triangle[2]) * 83492791u);
+  }
+};
+
+} // namespace
+
+std::vector<uint32_t> simplifyTriangles(const unsigned char *positions,
+    size_t byteStride, const uint32_t *indices, size_t indexCount,
+    float cellSize)
+{
+  const auto triangleCount = indexCount / 3;
+  if (!triangleCount || !(cellSize > 0)) {
+    return std::vector<uint32_t>(indices, indices + triangleCount * 3);
+  }
+
+  auto maxVertex = uint32_t(0);
+  auto bboxMin = glm::vec3(std::numeric_limits<float>::max());
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    maxVertex = std::max(maxVertex, indices[i]);
+    bboxMin = glm::min(bboxMin, readPosition(positions, byteStride, indices[i]));
+  }
+
+  // Cluster of each vertex, and mean position of each cluster
+  const auto noCluster = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> vertexClusters(size_t(maxVertex) + 1, noCluster);
+  std::unordered_map<uint64_t, uint32_t> cellClusters;
+  std::vector<glm::vec3> clusterSums;
+  std::vector<uint32_t> clusterSizes;
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    const auto vertex = indices[i];
+    if (vertexClusters[vertex] != noCluster) {
+      continue;
+    }
+    const auto position = readPosition(positions, byteStride, vertex);
+    const auto cell = glm::min(glm::floor((position - bboxMin) / cellSize),
+        glm::vec3(float(1 << 21) - 1));
+    const auto key = uint64_t(cell.x) | (uint64_t(cell.y) << 21) |
+                     (uint64_t(cell.z) << 42);
+    const auto it =
+        cellClusters.emplace(key, uint32_t(clusterSums.size())).first;
+    if (it->second == clusterSums.size()) {
+      clusterSums.emplace_back(0);
+      clusterSizes.push_back(0);
+    }
+    vertexClusters[vertex] = it->second;
+    clusterSums[it->second] += position;
+    ++clusterSizes[it->second];
+  }
+
+  // Each cluster is represented by its vertex closest to the mean, so that
+  // attributes of the simplified mesh are those of an existing vertex
+  std::vector<uint32_t> representatives(clusterSums.size(), noCluster);
+  std::vector<float> representativeDistances(
+      clusterSums.size(), std::numeric_limits<float>::max());
+  for (uint32_t vertex = 0; vertex <= maxVertex; ++vertex) {
+    const auto cluster = vertexClusters[vertex];
+    if (cluster == noCluster) {
+      continue;
+    }
+    const auto mean = clusterSums[cluster] / float(clusterSizes[cluster]);
+    const auto offset = readPosition(positions, byteStride, vertex) - mean;
+    const auto distance = glm::dot(offset, offset);
+    if (distance < representativeDistances[cluster]) {
+      representativeDistances[cluster] = distance;
+      representatives[cluster] = vertex;
+    }
+  }
+
+  std::vector<uint32_t> simplified;
+  std::unordered_set<std::array<uint32_t, 3>, TriangleHash> triangles;
+  for (size_t t = 0; t < triangleCount; ++t) {
+    std::array<uint32_t, 3> triangle;
+    for (auto c = 0; c < 3; ++c) {
+      triangle[c] = representatives[vertexClusters[indices[3 * t + c]]];
+    }
+    if (triangle[0] == triangle[1] || triangle[1] == triangle[2] ||
+        triangle[2] == triangle[0]) {
+      continue;
+    }
+    // Same rotation for the duplicates of a triangle, keeping its winding
+    std::rotate(begin(triangle),
+        std::min_element(begin(triangle), end(triangle)), end(triangle));
+    if (triangles.insert(triangle).second) {
+      simplified.insert(end(simplified), begin(triangle), end(triangle));
+    }
+  }
+  return simplified;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Simplify the triangle list indices (into positions, read with byteStride)
+// by vertex clustering: vertices in the same cell of a grid of cellSize are
+// merged into the vertex of the cell closest to their mean, triangles that
+// become degenerate are removed, and so are duplicates. Returns the indices of
+// the remaining triangles, into the same positions. The distance between the
+// simplified and the original surfaces is at most the diagonal of a cell.
+std::vector<uint32_t> simplifyTriangles(const unsigned char *positions,
+    size_t byteStride, const uint32_t *indices, size_t indexCount,
+    float cellSize);
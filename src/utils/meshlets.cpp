@@ -0,0 +1,183 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+glm::vec3 readPosition(const unsigned char *positions, size_t byteStride,
+    uint32_t vertex)
+{
+  glm::vec3 position;
+  std::memcpy(&position, positions + byteStride * vertex, sizeof(position));
+  return position;
+}
+
+void computeMeshletBounds(const unsigned char *positions, size_t byteStride,
+    const uint32_t *indices, Meshlet &meshlet)
+{
+  const auto *first = indices + meshlet.firstIndex;
+  auto bboxMin = glm::vec3(std::numeric_limits<float>::max());
+  auto bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+    const auto position = readPosition(positions, byteStride, first[i]);
+    bboxMin = glm::min(bboxMin, position);
+    bboxMax = glm::max(bboxMax, position);
+  }
+  meshlet.center = 0.5f * (bboxMin + bboxMax);
+  meshlet.radius = 0.f;
+  for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+    meshlet.radius = std::max(meshlet.radius,
+        glm::length(readPosition(positions, byteStride, first[i]) -
+                    meshlet.center));
+  }
+
+  // The axis is the mean of the normals, the cone is then widened to contain
+  // all of them
+  std::vector<glm::vec3> normals;
+  auto normalSum = glm::vec3(0);
+  for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3) {
+    const auto p0 = readPosition(positions, byteStride, first[i]);
+    const auto p1 = readPosition(positions, byteStride, first[i + 1]);
+    const auto p2 = readPosition(positions, byteStride, first[i + 2]);
+    const auto normal = glm::cross(p1 - p0, p2 - p0);
+    const auto length = glm::length(normal);
+    if (length > 0) {
+      normals.push_back(normal / length);
+      normalSum += normals.back();
+    }
+  }
+  meshlet.coneAxis = glm::vec3(0, 0, 1);
+  meshlet.coneCutoff = 1.f;
+  const auto sumLength = glm::length(normalSum);
+  if (normals.empty() || !(sumLength > 0)) {
+    return;
+  }
+  meshlet.coneAxis = normalSum / sumLength;
+  auto minDot = 1.f;
+  for (const auto &normal : normals) {
+    minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+  }
+  if (minDot > 0) {
+    meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+  }
+}
+
+} // namespace
+
+std::vector<Meshlet> buildMeshlets(const unsigned char *positions,
+    size_t byteStride, uint32_t *indices, size_t indexCount,
+    size_t maxVertices, size_t maxTriangles)
+{
+  const auto triangleCount = indexCount / 3;
+  std::vector<Meshlet> meshlets;
+  if (!triangleCount) {
+    return meshlets;
+  }
+  const auto vertexCount =
+      size_t(*std::max_element(indices, indices + triangleCount * 3)) + 1;
+
+  // Triangles of each vertex, those not added to a meshlet yet are the first
+  // liveTriangles[vertex] ones
+  std::vector<uint32_t> liveTriangles(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; ++i) {
+    ++liveTriangles[indices[i]];
+  }
+  std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+  for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+    adjacencyOffsets[vertex + 1] =
+        adjacencyOffsets[vertex] + liveTriangles[vertex];
+  }
+  std::vector<uint32_t> adjacency(triangleCount * 3);
+  {
+    std::vector<uint32_t> ends(
+        begin(adjacencyOffsets), end(adjacencyOffsets) - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+      adjacency[ends[indices[i]]++] = uint32_t(i / 3);
+    }
+  }
+
+  const auto noMeshlet = std::numeric_limits<uint32_t>::max();
+  std::vector<uint32_t> vertexMeshlets(vertexCount, noMeshlet);
+  std::vector<bool> isAdded(triangleCount, false);
+  std::vector<uint32_t> reordered;
+  reordered.reserve(triangleCount * 3);
+  std::vector<uint32_t> meshletVertices;
+  size_t meshletTriangleCount = 0;
+  const auto countNewVertices = [&](size_t t) {
+    const auto *corners = indices + 3 * t;
+    auto count = 0u;
+    for (auto c = 0; c < 3; ++c) {
+      if (vertexMeshlets[corners[c]] != meshlets.size() &&
+          std::find(corners, corners + c, corners[c]) == corners + c) {
+        ++count;
+      }
+    }
+    return count;
+  };
+  const auto closeMeshlet = [&]() {
+    if (!meshletTriangleCount) {
+      return;
+    }
+    Meshlet meshlet{};
+    meshlet.indexCount = uint32_t(meshletTriangleCount * 3);
+    meshlet.firstIndex = uint32_t(reordered.size()) - meshlet.indexCount;
+    meshlets.push_back(meshlet);
+    meshletVertices.clear();
+    meshletTriangleCount = 0;
+  };
+
+  size_t inputCursor = 0; // Triangles before it are all added
+  for (size_t addedCount = 0; addedCount < triangleCount; ++addedCount) {
+    // Neighbour of the meshlet adding the fewest vertices
+    auto triangle = triangleCount;
+    auto newVertexCount = 4u;
+    for (const auto vertex : meshletVertices) {
+      const auto *first = adjacency.data() + adjacencyOffsets[vertex];
+      for (const auto *t = first;
+           t != first + liveTriangles[vertex] && newVertexCount; ++t) {
+        const auto count = countNewVertices(*t);
+        if (count < newVertexCount) {
+          newVertexCount = count;
+          triangle = *t;
+        }
+      }
+    }
+    if (triangle == triangleCount) {
+      // No neighbour left, start from the next triangle in input order
+      closeMeshlet();
+      while (isAdded[inputCursor]) {
+        ++inputCursor;
+      }
+      triangle = inputCursor;
+    } else if (meshletVertices.size() + newVertexCount > maxVertices ||
+               meshletTriangleCount + 1 > maxTriangles) {
+      closeMeshlet();
+    }
+
+    const auto *corners = indices + 3 * triangle;
+    for (auto c = 0; c < 3; ++c) {
+      const auto vertex = corners[c];
+      if (vertexMeshlets[vertex] != meshlets.size()) {
+        vertexMeshlets[vertex] = uint32_t(meshlets.size());
+        meshletVertices.push_back(vertex);
+      }
+      auto *first = adjacency.data() + adjacencyOffsets[vertex];
+      auto *last = first + liveTriangles[vertex];
+      *std::find(first, last, uint32_t(triangle)) = *(last - 1);
+      --liveTriangles[vertex];
+    }
+    reordered.insert(end(reordered), corners, corners + 3);
+    isAdded[triangle] = true;
+    ++meshletTriangleCount;
+  }
+  closeMeshlet();
+
+  std::copy(begin(reordered), end(reordered), indices);
+  for (auto &meshlet : meshlets) {
+    computeMeshletBounds(positions, byteStride, indices, meshlet);
+  }
+  return meshlets;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Cluster of neighbouring triangles of a triangle list, small enough to be
+// culled on its own: its triangles are indices [firstIndex, firstIndex +
+// indexCount) of the list.
+struct Meshlet
+{
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Bounding sphere, in the space of the positions
+  glm::vec3 center;
+  float radius;
+  // The normals of all triangles are within the cone of this axis whose
+  // half-angle has coneCutoff as sine. 1 if they do not fit in a half-space,
+  // the meshlet can then not be back facing as a whole.
+  glm::vec3 coneAxis;
+  float coneCutoff;
+};
+
+// Reorder the triangles of the triangle list indices (into positions, read
+// with byteStride) into meshlets of at most maxVertices distinct vertices and
+// maxTriangles triangles, grown from a triangle by adding the neighbours that
+// bring the fewest new vertices. Returns the meshlets, in order.
+//
+// A meshlet is entirely back facing, and can be culled, when seen from a
+// point p such that dot(center - p, coneAxis) >= coneCutoff * length(center -
+// p) + radius.
+std::vector<Meshlet> buildMeshlets(const unsigned char *positions,
+    size_t byteStride, uint32_t *indices, size_t indexCount,
+    size_t maxVertices, size_t maxTriangles);
@@ -0,0 +1,647 @@
+#include "meshopt.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHOPT_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MESHOPT_NEON
+#endif
+
+namespace {
+
+const char *const MESHOPT_EXTENSION = "EXT_meshopt_compression";
+
+// The vertex codec stores blocks of vertices, each byte of the vertices of a
+// block as groups of 16 zigzag encoded deltas with the previous vertex,
+// followed by a tail holding the vertex before the first one
+const unsigned char VERTEX_HEADER = 0xa0;
+const size_t BYTE_GROUP_SIZE = 16;
+const size_t MAX_BYTE_GROUP_BYTES = 24; // 16 values of 4 bits and 16 escapes
+const size_t VERTEX_BLOCK_BYTES = 8192;
+const size_t MAX_VERTEX_BLOCK_SIZE = 256;
+const size_t MIN_VERTEX_TAIL_SIZE = 32;
+
+const unsigned char TRIANGLE_HEADER = 0xe0;
+const unsigned char INDEX_SEQUENCE_HEADER = 0xd0;
+
+// A group of 16 bytes packed on Bits (2 or 4) bits, the values of all ones
+// escaping to bytes that follow the packed ones. Unrolled and branchless, the
+// escapes are not predictable. Returns the end of the group.
+template <unsigned Bits>
+const unsigned char *decodePackedGroup(
+    const unsigned char *data, unsigned char *output)
+{
+  const auto escape = (1u << Bits) - 1;
+  const auto *escaped = data + BYTE_GROUP_SIZE * Bits / 8;
+  for (size_t b = 0; b < BYTE_GROUP_SIZE * Bits / 8; ++b) {
+    auto byte = unsigned(data[b]);
+    for (size_t j = 0; j < 8 / Bits; ++j) {
+      const auto value = (byte >> (8 - Bits)) & escape;
+      byte <<= Bits;
+      const auto isEscape = value == escape;
+      *output++ = isEscape ? *escaped : (unsigned char)value;
+      escaped += isEscape;
+    }
+  }
+  return escaped;
+}
+
+// A group of 16 bytes, of 0, 2, 4 or 8 bits for bitsLog2 0 to 3. Returns the
+// end of the group.
+const unsigned char *decodeByteGroup(
+    const unsigned char *data, unsigned char *output, int bitsLog2)
+{
+  switch (bitsLog2) {
+  case 0:
+    std::memset(output, 0, BYTE_GROUP_SIZE);
+    return data;
+  case 1:
+    return decodePackedGroup<2>(data, output);
+  case 2:
+    return decodePackedGroup<4>(data, output);
+  default:
+    std::memcpy(output, data, BYTE_GROUP_SIZE);
+    return data + BYTE_GROUP_SIZE;
+  }
+}
+
+// One byte of alignedCount vertices (a multiple of 16): 2 bits of header per
+// group, then the groups. Returns the end of the groups, null if the data
+// ends before them.
+const unsigned char *decodeBytes(const unsigned char *data,
+    const unsigned char *end, unsigned char *output, size_t alignedCount)
+{
+  const auto groupCount = alignedCount / BYTE_GROUP_SIZE;
+  const auto headerSize = (groupCount + 3) / 4;
+  if (size_t(end - data) < headerSize) {
+    return nullptr;
+  }
+  const auto *header = data;
+  data += headerSize;
+  for (size_t g = 0; g < groupCount; ++g) {
+    // The tail of a valid stream is larger than any group
+    if (size_t(end - data) < MAX_BYTE_GROUP_BYTES) {
+      return nullptr;
+    }
+    const auto bitsLog2 = (header[g / 4] >> (g % 4 * 2)) & 3;
+    data = decodeByteGroup(data, output + g * BYTE_GROUP_SIZE, bitsLog2);
+  }
+  return data;
+}
+
+// Bytes k to k + 3 of count vertices from their 4 columns of deltas (padded to
+// a multiple of 16), summed from those of last, which get those of the last
+// vertex
+void sumDeltas(const unsigned char (*deltas)[MAX_VERTEX_BLOCK_SIZE],
+    size_t count, size_t byteStride, unsigned char *last,
+    unsigned char *output)
+{
+#if defined(MESHOPT_SSE)
+  // Transposed to 4 vertices per register, then prefix summed in 32 bits
+  // lanes with byte adds, as the scalar loop wraps each byte
+  int32_t lastWord;
+  std::memcpy(&lastWord, last, sizeof(lastWord));
+  auto previous = _mm_set1_epi32(lastWord);
+  const auto ones = _mm_set1_epi8(1);
+  const auto lowBits = _mm_set1_epi8(0x7f);
+  for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE) {
+    __m128i columns[4];
+    for (size_t j = 0; j < 4; ++j) {
+      const auto v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(deltas[j] + i));
+      columns[j] =
+          _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), lowBits),
+              _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, ones)));
+    }
+    const auto low01 = _mm_unpacklo_epi8(columns[0], columns[1]);
+    const auto high01 = _mm_unpackhi_epi8(columns[0], columns[1]);
+    const auto low23 = _mm_unpacklo_epi8(columns[2], columns[3]);
+    const auto high23 = _mm_unpackhi_epi8(columns[2], columns[3]);
+    const __m128i vertices[] = {_mm_unpacklo_epi16(low01, low23),
+        _mm_unpackhi_epi16(low01, low23), _mm_unpacklo_epi16(high01, high23),
+        _mm_unpackhi_epi16(high01, high23)};
+    uint32_t words[BYTE_GROUP_SIZE];
+    for (size_t r = 0; r < 4; ++r) {
+      auto v = vertices[r];
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+      v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+      v = _mm_add_epi8(v, previous);
+      previous = _mm_shuffle_epi32(v, 0xff);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(words + 4 * r), v);
+    }
+    const auto groupCount = std::min(count - i, BYTE_GROUP_SIZE);
+    for (size_t v = 0; v < groupCount; ++v) {
+      std::memcpy(output + (i + v) * byteStride, &words[v], 4);
+    }
+  }
+#elif defined(MESHOPT_NEON)
+  uint32_t lastWord;
+  std::memcpy(&lastWord, last, sizeof(lastWord));
+  auto previous = vreinterpretq_u8_u32(vdupq_n_u32(lastWord));
+  const auto ones = vdupq_n_u8(1);
+  const auto zero = vdupq_n_u8(0);
+  for (size_t i = 0; i < count; i += BYTE_GROUP_SIZE) {
+    uint8x16_t columns[4];
+    for (size_t j = 0; j < 4; ++j) {
+      const auto v = vld1q_u8(deltas[j] + i);
+      columns[j] =
+          veorq_u8(vshrq_n_u8(v, 1), vsubq_u8(zero, vandq_u8(v, ones)));
+    }
+    const auto zip01 = vzipq_u8(columns[0], columns[1]);
+    const auto zip23 = vzipq_u8(columns[2], columns[3]);
+    const auto low = vzipq_u16(vreinterpretq_u16_u8(zip01.val[0]),
+        vreinterpretq_u16_u8(zip23.val[0]));
+    const auto high = vzipq_u16(vreinterpretq_u16_u8(zip01.val[1]),
+        vreinterpretq_u16_u8(zip23.val[1]));
+    const uint8x16_t vertices[] = {vreinterpretq_u8_u16(low.val[0]),
+        vreinterpretq_u8_u16(low.val[1]), vreinterpretq_u8_u16(high.val[0]),
+        vreinterpretq_u8_u16(high.val[1])};
+    uint32_t words[BYTE_GROUP_SIZE];
+    for (size_t r = 0; r < 4; ++r) {
+      auto v = vertices[r];
+      v = vaddq_u8(v, vextq_u8(zero, v, 12));
+      v = vaddq_u8(v, vextq_u8(zero, v, 8));
+      v = vaddq_u8(v, previous);
+      previous = vreinterpretq_u8_u32(
+          vdupq_n_u32(vgetq_lane_u32(vreinterpretq_u32_u8(v), 3)));
+      vst1q_u8(reinterpret_cast<uint8_t *>(words + 4 * r), v);
+    }
+    const auto groupCount = std::min(count - i, BYTE_GROUP_SIZE);
+    for (size_t v = 0; v < groupCount; ++v) {
+      std::memcpy(output + (i + v) * byteStride, &words[v], 4);
+    }
+  }
+#else
+  for (size_t j = 0; j < 4; ++j) {
+    auto value = last[j];
+    for (size_t i = 0; i < count; ++i) {
+      const auto delta = deltas[j][i];
+      value = (unsigned char)(value + (-(delta & 1) ^ (delta >> 1)));
+      output[i * byteStride + j] = value;
+    }
+  }
+#endif
+  std::memcpy(last, output + (count - 1) * byteStride, 4);
+}
+
+const unsigned char *decodeVertexBlock(const unsigned char *data,
+    const unsigned char *end, unsigned char *output, size_t count,
+    size_t byteStride, unsigned char *lastVertex)
+{
+  const auto alignedCount =
+      (count + BYTE_GROUP_SIZE - 1) / BYTE_GROUP_SIZE * BYTE_GROUP_SIZE;
+  unsigned char deltas[4][MAX_VERTEX_BLOCK_SIZE];
+  for (size_t k = 0; k < byteStride; k += 4) {
+    for (size_t j = 0; j < 4; ++j) {
+      data = decodeBytes(data, end, deltas[j], alignedCount);
+      if (!data) {
+        return nullptr;
+      }
+    }
+    sumDeltas(deltas, count, byteStride, lastVertex + k, output + k);
+  }
+  return data;
+}
+
+void writeIndex(
+    unsigned char *output, size_t i, size_t byteStride, uint32_t index)
+{
+  if (byteStride == 2) {
+    const auto shortIndex = uint16_t(index);
+    std::memcpy(output + 2 * i, &shortIndex, 2);
+  } else {
+    std::memcpy(output + 4 * i, &index, 4);
+  }
+}
+
+uint32_t decodeVByte(const unsigned char *&data)
+{
+  const auto lead = *data++;
+  if (lead < 128) {
+    return lead;
+  }
+  // Up to 4 more bytes of 7 bits, little endian
+  uint32_t result = lead & 127;
+  for (uint32_t shift = 7; shift < 35; shift += 7) {
+    const auto group = *data++;
+    result |= uint32_t(group & 127) << shift;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
+
+uint32_t decodeIndex(const unsigned char *&data, uint32_t last)
+{
+  const auto v = decodeVByte(data);
+  return last + ((v >> 1) ^ (0u - (v & 1)));
+}
+
+// Octahedral encoded unit vectors of T, the fourth component kept as is
+template <typename T> void decodeOctahedral(unsigned char *data, size_t count)
+{
+  const auto maxValue = float((1 << (sizeof(T) * 8 - 1)) - 1);
+  for (size_t i = 0; i < count; ++i) {
+    T v[4];
+    std::memcpy(v, data + sizeof(v) * i, sizeof(v));
+    auto x = float(v[0]);
+    auto y = float(v[1]);
+    // z holds 1 at the same scale as x and y
+    const auto z = float(v[2]) - std::abs(x) - std::abs(y);
+    const auto t = std::min(z, 0.f);
+    x += x >= 0.f ? t : -t;
+    y += y >= 0.f ? t : -t;
+    const auto scale = maxValue / std::sqrt(x * x + y * y + z * z);
+    v[0] = T(int(x * scale + (x >= 0.f ? 0.5f : -0.5f)));
+    v[1] = T(int(y * scale + (y >= 0.f ? 0.5f : -0.5f)));
+    v[2] = T(int(z * scale + (z >= 0.f ? 0.5f : -0.5f)));
+    std::memcpy(data + sizeof(v) * i, v, sizeof(v));
+  }
+}
+
+// Unit quaternions of 16 bits from 3 components of the largest 4 and the
+// index of the fourth, with the scale of the 3 in the rest of the bits
+void decodeQuaternion(unsigned char *data, size_t count)
+{
+  const auto scale = 1.f / std::sqrt(2.f);
+  for (size_t i = 0; i < count; ++i) {
+    int16_t v[4];
+    std::memcpy(v, data + sizeof(v) * i, sizeof(v));
+    const auto componentScale = scale / float(v[3] | 3);
+    const auto x = float(v[0]) * componentScale;
+    const auto y = float(v[1]) * componentScale;
+    const auto z = float(v[2]) * componentScale;
+    const auto w = std::sqrt(std::max(1.f - x * x - y * y - z * z, 0.f));
+    const auto largest = v[3] & 3;
+    const auto round = [](float value) {
+      return int16_t(value * 32767.f + (value >= 0.f ? 0.5f : -0.5f));
+    };
+    v[(largest + 1) & 3] = round(x);
+    v[(largest + 2) & 3] = round(y);
+    v[(largest + 3) & 3] = round(z);
+    v[largest] = round(w);
+    std::memcpy(data + sizeof(v) * i, v, sizeof(v));
+  }
+}
+
+// Floats from a 24 bits signed mantissa and an 8 bits signed exponent
+void decodeExponential(unsigned char *data, size_t count)
+{
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t v;
+    std::memcpy(&v, data + 4 * i, 4);
+    const auto mantissa = int32_t(v << 8) >> 8;
+    const auto exponent = int32_t(v) >> 24;
+    // ldexp(mantissa, exponent), exact for the exponents of the encoder
+    float value;
+    const auto bits = uint32_t(exponent + 127) << 23;
+    std::memcpy(&value, &bits, 4);
+    value *= float(mantissa);
+    std::memcpy(data + 4 * i, &value, 4);
+  }
+}
+
+// A buffer view of the extension, decoded in its bytes in the buffer
+struct CompressedView
+{
+  int source = -1; // Buffer of the compressed data
+  size_t sourceOffset = 0;
+  size_t sourceLength = 0;
+  size_t byteStride = 0;
+  size_t count = 0;
+  std::string mode;
+  std::string filter;
+  int buffer = -1;
+  size_t byteOffset = 0;
+  std::string error;
+};
+
+std::string decodeView(const std::vector<BufferBytes> &bufferBytes,
+    const CompressedView &view, unsigned char *output)
+{
+  const auto *data = bufferBytes[view.source].data + view.sourceOffset;
+  auto decoded = false;
+  if (view.mode == "ATTRIBUTES") {
+    decoded = decodeMeshoptVertices(
+        output, view.count, view.byteStride, data, view.sourceLength);
+  } else if (view.mode == "TRIANGLES") {
+    decoded = decodeMeshoptTriangles(
+        output, view.count, view.byteStride, data, view.sourceLength);
+  } else if (view.mode == "INDICES") {
+    decoded = decodeMeshoptIndices(
+        output, view.count, view.byteStride, data, view.sourceLength);
+  } else {
+    return "unknown mode " + view.mode;
+  }
+  if (!decoded) {
+    return "invalid " + view.mode + " data";
+  }
+
+  if (view.filter == "OCTAHEDRAL" && view.byteStride == 4) {
+    decodeOctahedral<int8_t>(output, view.count);
+  } else if (view.filter == "OCTAHEDRAL" && view.byteStride == 8) {
+    decodeOctahedral<int16_t>(output, view.count);
+  } else if (view.filter == "QUATERNION" && view.byteStride == 8) {
+    decodeQuaternion(output, view.count);
+  } else if (view.filter == "EXPONENTIAL") {
+    decodeExponential(output, view.count * view.byteStride / 4);
+  } else if (!view.filter.empty() && view.filter != "NONE") {
+    return "filter " + view.filter + " cannot apply to a stride of " +
+           std::to_string(view.byteStride);
+  }
+  return {};
+}
+
+void removeExtension(std::vector<std::string> &extensions)
+{
+  extensions.erase(
+      std::remove(extensions.begin(), extensions.end(), MESHOPT_EXTENSION),
+      extensions.end());
+}
+
+} // namespace
+
+bool decodeMeshoptVertices(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size)
+{
+  if (!byteStride || byteStride > 256 || byteStride % 4) {
+    return false;
+  }
+  const auto tailSize = std::max(byteStride, MIN_VERTEX_TAIL_SIZE);
+  if (size < 1 + tailSize || data[0] != VERTEX_HEADER) {
+    return false;
+  }
+  const auto *end = data + size;
+  unsigned char lastVertex[256];
+  std::memcpy(lastVertex, end - byteStride, byteStride);
+  const auto blockSize = std::min(
+      VERTEX_BLOCK_BYTES / byteStride / BYTE_GROUP_SIZE * BYTE_GROUP_SIZE,
+      MAX_VERTEX_BLOCK_SIZE);
+  ++data;
+  for (size_t offset = 0; offset < count; offset += blockSize) {
+    data = decodeVertexBlock(data, end, output + offset * byteStride,
+        std::min(blockSize, count - offset), byteStride, lastVertex);
+    if (!data) {
+      return false;
+    }
+  }
+  return size_t(end - data) == tailSize;
+}
+
+bool decodeMeshoptTriangles(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size)
+{
+  // A code byte per triangle, then the data of the triangles, then a table
+  // of 16 codes of the vertices that start at new indices
+  if ((byteStride != 2 && byteStride != 4) || count % 3 ||
+      size < 1 + count / 3 + 16 || (data[0] & 0xf0) != TRIANGLE_HEADER ||
+      (data[0] & 0x0f) > 1) {
+    return false;
+  }
+  // Version 1 codes the free indices next to the last one in the edge codes
+  const auto maxVertexCode = (data[0] & 0x0f) ? 13u : 15u;
+  const auto *codes = data + 1;
+  const auto *triangleData = codes + count / 3;
+  const auto *dataEnd = data + size - 16;
+  const auto *auxCodes = dataEnd;
+
+  // FIFOs of the last edges and vertices, indexed by offsets before their
+  // current position
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  std::memset(edges, -1, sizeof(edges));
+  std::memset(vertices, -1, sizeof(vertices));
+  size_t edgeOffset = 0;
+  size_t vertexOffset = 0;
+  const auto pushEdge = [&](uint32_t a, uint32_t b) {
+    edges[edgeOffset][0] = a;
+    edges[edgeOffset][1] = b;
+    edgeOffset = (edgeOffset + 1) & 15;
+  };
+  const auto pushVertex = [&](uint32_t v, bool condition = true) {
+    vertices[vertexOffset] = v;
+    vertexOffset = (vertexOffset + condition) & 15;
+  };
+  uint32_t next = 0;
+  uint32_t last = 0;
+  for (size_t i = 0; i < count; i += 3) {
+    // Each triangle reads at most 16 bytes, the size of the table
+    if (triangleData > dataEnd) {
+      return false;
+    }
+    const auto code = *codes++;
+    if (code < 0xf0) {
+      // An edge of the FIFO and a third vertex
+      const auto &edge = edges[(edgeOffset - 1 - (code >> 4)) & 15];
+      const auto a = edge[0];
+      const auto b = edge[1];
+      const auto vertexCode = code & 15u;
+      uint32_t c;
+      if (vertexCode < maxVertexCode) {
+        const auto isNew = vertexCode == 0;
+        c = isNew ? next++ : vertices[(vertexOffset - 1 - vertexCode) & 15];
+        pushVertex(c, isNew);
+      } else {
+        // 13 and 14 are the indices before and after the last one
+        last = c = vertexCode != 15 ? last + vertexCode - (vertexCode ^ 3)
+                                    : decodeIndex(triangleData, last);
+        pushVertex(c);
+      }
+      writeIndex(output, i, byteStride, a);
+      writeIndex(output, i + 1, byteStride, b);
+      writeIndex(output, i + 2, byteStride, c);
+      pushEdge(c, b);
+      pushEdge(a, c);
+    } else if (code < 0xfe) {
+      // A new vertex and two more from the table
+      const auto auxCode = auxCodes[code & 15];
+      const auto codeB = uint32_t(auxCode >> 4);
+      const auto codeC = uint32_t(auxCode & 15);
+      const auto a = next++;
+      const auto b =
+          codeB == 0 ? next++ : vertices[(vertexOffset - codeB) & 15];
+      const auto c =
+          codeC == 0 ? next++ : vertices[(vertexOffset - codeC) & 15];
+      writeIndex(output, i, byteStride, a);
+      writeIndex(output, i + 1, byteStride, b);
+      writeIndex(output, i + 2, byteStride, c);
+      pushVertex(a);
+      pushVertex(b, codeB == 0);
+      pushVertex(c, codeC == 0);
+      pushEdge(b, a);
+      pushEdge(c, b);
+      pushEdge(a, c);
+    } else {
+      // The codes of the 3 vertices in a byte of their own, 15 for free
+      // indices. 0 restarts the new indices at 0.
+      const auto auxCode = *triangleData++;
+      const auto codeA = code == 0xfe ? 0u : 15u;
+      const auto codeB = uint32_t(auxCode >> 4);
+      const auto codeC = uint32_t(auxCode & 15);
+      if (auxCode == 0) {
+        next = 0;
+      }
+      auto a = codeA == 0 ? next++ : 0;
+      auto b = codeB == 0 ? next++ : vertices[(vertexOffset - codeB) & 15];
+      auto c = codeC == 0 ? next++ : vertices[(vertexOffset - codeC) & 15];
+      if (codeA == 15) {
+        last = a = decodeIndex(triangleData, last);
+      }
+      if (codeB == 15) {
+        last = b = decodeIndex(triangleData, last);
+      }
+      if (codeC == 15) {
+        last = c = decodeIndex(triangleData, last);
+      }
+      writeIndex(output, i, byteStride, a);
+      writeIndex(output, i + 1, byteStride, b);
+      writeIndex(output, i + 2, byteStride, c);
+      pushVertex(a);
+      pushVertex(b, codeB == 0 || codeB == 15);
+      pushVertex(c, codeC == 0 || codeC == 15);
+      pushEdge(b, a);
+      pushEdge(c, b);
+      pushEdge(a, c);
+    }
+  }
+  return triangleData == dataEnd;
+}
+
+bool decodeMeshoptIndices(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size)
+{
+  // Zigzag deltas with one of the last two indices, chosen by the low bit,
+  // then a tail of 4 bytes
+  if ((byteStride != 2 && byteStride != 4) || size < 1 + count + 4 ||
+      (data[0] & 0xf0) != INDEX_SEQUENCE_HEADER || (data[0] & 0x0f) > 1) {
+    return false;
+  }
+  const auto *end = data + size - 4;
+  ++data;
+  uint32_t last[2] = {};
+  for (size_t i = 0; i < count; ++i) {
+    // Each index reads at most 5 bytes, more than the tail
+    if (data >= end) {
+      return false;
+    }
+    auto v = decodeVByte(data);
+    const auto baseline = v & 1;
+    v >>= 1;
+    last[baseline] += (v >> 1) ^ (0u - (v & 1));
+    writeIndex(output, i, byteStride, last[baseline]);
+  }
+  return data == end;
+}
+
+bool decodeMeshoptBuffers(tinygltf::Model &model,
+    std::vector<BufferBytes> &bufferBytes, std::string &err)
+{
+  std::vector<CompressedView> views;
+  std::vector<int> viewIndices;
+  for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+    const auto &bufferView = model.bufferViews[i];
+    const auto it = bufferView.extensions.find(MESHOPT_EXTENSION);
+    if (it == end(bufferView.extensions)) {
+      continue;
+    }
+    // Views whose bytes are already there are drawn from them
+    if (bufferView.buffer < 0 ||
+        size_t(bufferView.buffer) >= bufferBytes.size() ||
+        bufferView.byteOffset + bufferView.byteLength <=
+            bufferBytes[bufferView.buffer].size) {
+      continue;
+    }
+    const auto &extension = it->second;
+    const auto getSize = [&](const char *name) {
+      const auto &value = extension.Get(name);
+      return value.IsNumber() ? size_t(value.GetNumberAsDouble()) : 0;
+    };
+    CompressedView view;
+    view.source = extension.Get("buffer").IsInt()
+                      ? extension.Get("buffer").Get<int>()
+                      : -1;
+    view.sourceOffset = getSize("byteOffset");
+    view.sourceLength = getSize("byteLength");
+    view.byteStride = getSize("byteStride");
+    view.count = getSize("count");
+    if (extension.Get("mode").IsString()) {
+      view.mode = extension.Get("mode").Get<std::string>();
+    }
+    if (extension.Get("filter").IsString()) {
+      view.filter = extension.Get("filter").Get<std::string>();
+    }
+    view.buffer = bufferView.buffer;
+    view.byteOffset = bufferView.byteOffset;
+    if (view.source < 0 || size_t(view.source) >= bufferBytes.size() ||
+        view.sourceOffset + view.sourceLength >
+            bufferBytes[view.source].size ||
+        view.count * view.byteStride > bufferView.byteLength) {
+      err += "invalid " + std::string(MESHOPT_EXTENSION) + " buffer view " +
+             std::to_string(i) + "\n";
+      return false;
+    }
+    views.push_back(view);
+    viewIndices.push_back(int(i));
+  }
+  if (views.empty()) {
+    return true;
+  }
+
+  // Allocate the decoded buffers once, keeping the bytes of the views that
+  // are not compressed
+  std::vector<size_t> bufferSizes(model.buffers.size(), 0);
+  for (const auto &bufferView : model.bufferViews) {
+    if (bufferView.buffer >= 0 &&
+        size_t(bufferView.buffer) < bufferSizes.size()) {
+      auto &size = bufferSizes[bufferView.buffer];
+      size = std::max(size, bufferView.byteOffset + bufferView.byteLength);
+    }
+  }
+  for (const auto &view : views) {
+    auto &buffer = model.buffers[view.buffer];
+    auto &bytes = bufferBytes[view.buffer];
+    if (buffer.data.size() >= bufferSizes[view.buffer]) {
+      continue;
+    }
+    std::vector<unsigned char> data(bufferSizes[view.buffer]);
+    std::memcpy(data.data(), bytes.data, std::min(bytes.size, data.size()));
+    buffer.data = std::move(data);
+    bytes = {buffer.data.data(), buffer.data.size()};
+  }
+
+  parallelFor(views.size(), [&](size_t i) {
+    auto &view = views[i];
+    view.error = decodeView(bufferBytes, view,
+        model.buffers[view.buffer].data.data() + view.byteOffset);
+  });
+
+  auto result = true;
+  for (size_t i = 0; i < views.size(); ++i) {
+    if (!views[i].error.empty()) {
+      err += "buffer view " + std::to_string(viewIndices[i]) + ": " +
+             views[i].error + "\n";
+      result = false;
+    }
+  }
+  if (!result) {
+    return false;
+  }
+
+  for (auto &bufferView : model.bufferViews) {
+    bufferView.extensions.erase(MESHOPT_EXTENSION);
+  }
+  for (auto &buffer : model.buffers) {
+    buffer.extensions.erase(MESHOPT_EXTENSION);
+  }
+  removeExtension(model.extensionsUsed);
+  removeExtension(model.extensionsRequired);
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Decoders of the bitstreams of EXT_meshopt_compression:
+// https://github.com/KhronosGroup/glTF/tree/main/extensions/2.0/Vendor/EXT_meshopt_compression
+// Each writes count elements of byteStride bytes in output and returns false
+// if data is not a valid stream for them.
+
+// Attributes (mode ATTRIBUTES), byteStride a multiple of 4 up to 256. The
+// deltas between vertices are transposed and summed with SSE on x86 and NEON
+// on ARM (scalar elsewhere), 16 vertices and 4 bytes at a time.
+bool decodeMeshoptVertices(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size);
+
+// Triangle list indices (mode TRIANGLES) of 2 or 4 bytes
+bool decodeMeshoptTriangles(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size);
+
+// Any other indices (mode INDICES) of 2 or 4 bytes
+bool decodeMeshoptIndices(unsigned char *output, size_t count,
+    size_t byteStride, const unsigned char *data, size_t size);
+
+// Decode, one buffer view per job on all hardware threads, the buffer views
+// compressed with EXT_meshopt_compression whose buffer has no uncompressed
+// data (the fallback buffers, left empty by the parser). Each view is decoded
+// and filtered in place in the bytes of its buffer, allocated once for all
+// its views: createBufferObjects uploads them like any other buffer and the
+// scene cache stores them, so later runs do not decode again. The extension
+// is then removed from the model.
+//
+// Returns false if one of those views cannot be decoded, with the reasons in
+// err.
+bool decodeMeshoptBuffers(tinygltf::Model &model,
+    std::vector<BufferBytes> &bufferBytes, std::string &err);
@@ -0,0 +1,233 @@
+#include "model_stats.hpp"
+#include "draw_stats.hpp"
+#include "flat_scene.hpp"
+#include "gltf.hpp"
+#include "gltf_json.hpp"
+#include "ktx2.hpp"
+#include "mapped_file.hpp"
+#include "texture_uploader.hpp"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// Vertices of a primitive, or indices if it has some. 0 if unknown.
+size_t getDrawnVertexCount(
+    const tinygltf::Model &model, const tinygltf::Primitive &primitive)
+{
+  if (primitive.indices >= 0) {
+    return model.accessors[primitive.indices].count;
+  }
+  const auto it = primitive.attributes.find("POSITION");
+  return it == end(primitive.attributes) ? 0
+                                         : model.accessors[it->second].count;
+}
+
+size_t getAccessorBytes(const tinygltf::Accessor &accessor)
+{
+  const auto componentSize =
+      tinygltf::GetComponentSizeInBytes(uint32_t(accessor.componentType));
+  const auto componentCount =
+      tinygltf::GetNumComponentsInType(uint32_t(accessor.type));
+  return componentSize > 0 && componentCount > 0
+             ? accessor.count * size_t(componentSize) * size_t(componentCount)
+             : 0;
+}
+
+// Width and height from the header of an image, decoded or not. False if
+// not readable.
+bool getImageSize(const tinygltf::Image &image, int &width, int &height)
+{
+  if (!image.as_is && image.width > 0 && image.height > 0) {
+    width = image.width;
+    height = image.height;
+    return true;
+  }
+  if (image.image.empty() ||
+      image.image.size() > size_t(std::numeric_limits<int>::max())) {
+    return false;
+  }
+  if (isKtx2Image(image)) {
+    Ktx2Texture texture;
+    std::string err;
+    if (!parseKtx2(image.image.data(), image.image.size(), texture, err)) {
+      return false;
+    }
+    width = int(texture.width);
+    height = int(texture.height);
+    return width > 0 && height > 0;
+  }
+  int components = 0;
+  return stbi_info_from_memory(image.image.data(), int(image.image.size()),
+             &width, &height, &components) != 0;
+}
+
+// Texels of an image and its full mip chain
+size_t getMipChainTexels(int width, int height)
+{
+  size_t texels = 0;
+  for (GLsizei level = 0; level < getMipLevelCount(width, height); ++level) {
+    texels += size_t(std::max(width >> level, 1)) *
+              size_t(std::max(height >> level, 1));
+  }
+  return texels;
+}
+
+} // namespace
+
+ModelStats computeModelStats(const tinygltf::Model &model)
+{
+  ModelStats stats;
+  stats.nodeCount = model.nodes.size();
+  stats.meshCount = model.meshes.size();
+  stats.materialCount = model.materials.size();
+  stats.textureCount = model.textures.size();
+  stats.imageCount = model.images.size();
+
+  std::vector<size_t> meshTriangles(model.meshes.size(), 0);
+  std::set<int> geometryAccessors; // Shared by primitives, counted once
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    for (const auto &primitive : model.meshes[meshIdx].primitives) {
+      ++stats.primitiveCount;
+      meshTriangles[meshIdx] += DrawStats::getTriangleCount(
+          GLenum(primitive.mode), getDrawnVertexCount(model, primitive));
+      const auto position = primitive.attributes.find("POSITION");
+      if (position != end(primitive.attributes)) {
+        stats.vertexCount += model.accessors[position->second].count;
+      }
+      for (const auto &attribute : primitive.attributes) {
+        geometryAccessors.insert(attribute.second);
+      }
+      for (const auto &target : primitive.targets) {
+        for (const auto &attribute : target) {
+          geometryAccessors.insert(attribute.second);
+        }
+      }
+      if (primitive.indices >= 0) {
+        geometryAccessors.insert(primitive.indices);
+      }
+    }
+    stats.triangleCount += meshTriangles[meshIdx];
+  }
+  for (const auto accessorIdx : geometryAccessors) {
+    stats.geometryBytes += getAccessorBytes(model.accessors[accessorIdx]);
+  }
+
+  const auto sceneIdx =
+      model.defaultScene >= 0 ? model.defaultScene
+                              : (model.scenes.empty() ? -1 : 0);
+  const auto scene = flattenScene(model, sceneIdx, getBufferBytes(model));
+  // Lower levels of detail are never drawn along with the first one
+  std::vector<uint8_t> skipped(scene.size(), 0);
+  for (const auto &group : scene.lodGroups) {
+    for (size_t level = 1; level < group.levels.size(); ++level) {
+      std::fill(begin(skipped) + group.levels[level],
+          begin(skipped) + scene.subtreeEnds[group.levels[level]], 1);
+    }
+  }
+  std::vector<size_t> depths(scene.size(), 0);
+  std::vector<size_t> meshDraws(model.meshes.size(), 0);
+  for (size_t i = 0; i < scene.size(); ++i) {
+    // Parents come first in the flattened order
+    depths[i] = scene.parents[i] < 0 ? 1 : depths[scene.parents[i]] + 1;
+    stats.hierarchyDepth = std::max(stats.hierarchyDepth, depths[i]);
+    const auto meshIdx = scene.meshes[i];
+    if (meshIdx >= 0 && !skipped[i]) {
+      ++meshDraws[meshIdx];
+      stats.drawCount += model.meshes[meshIdx].primitives.size();
+      stats.drawnTriangleCount += meshTriangles[meshIdx];
+    }
+  }
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    if (meshDraws[meshIdx] > 1) {
+      ++stats.instancedMeshCount;
+      stats.instanceableDrawCount += (meshDraws[meshIdx] - 1) *
+                                     model.meshes[meshIdx].primitives.size();
+    }
+  }
+
+  std::set<int> sampledImages;
+  for (const auto &texture : model.textures) {
+    const auto basisuSource = getBasisuImageSource(texture);
+    const auto imageIdx = basisuSource >= 0 ? basisuSource : texture.source;
+    if (imageIdx >= 0 && size_t(imageIdx) < model.images.size()) {
+      sampledImages.insert(imageIdx);
+    }
+  }
+  for (const auto imageIdx : sampledImages) {
+    int width = 0;
+    int height = 0;
+    if (!getImageSize(model.images[imageIdx], width, height)) {
+      ++stats.unknownImageCount;
+      continue;
+    }
+    const auto texels = getMipChainTexels(width, height);
+    stats.textureBytes += 4 * texels;
+    stats.compressedTextureBytes += texels;
+  }
+  return stats;
+}
+
+bool loadModelStats(const fs::path &path, ModelStats &stats, std::string &err)
+{
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(storeEncodedImage, nullptr);
+  tinygltf::Model model;
+  std::string warn;
+  auto result = false;
+  try {
+    const MappedFile file(path);
+    result = loadGltfDocument(loader, model, err, warn, file.data(),
+        file.size(), isBinaryGltfFile(path), path.parent_path().string(),
+        false, getDefaultFsCallbacks());
+  } catch (const std::runtime_error &e) {
+    err = e.what();
+  }
+  if (!result) {
+    if (err.empty()) {
+      err = "could not complete glTF file parsing";
+    }
+    return false;
+  }
+  err.clear(); // Errors tinygltf recovered from
+  stats = computeModelStats(model);
+  return true;
+}
+
+void writeModelStatsCsvHeader(std::ostream &output)
+{
+  output << "file,nodes,meshes,primitives,materials,textures,images,"
+            "triangles,vertices,draws,drawn_triangles,instanced_meshes,"
+            "instanceable_draws,hierarchy_depth,geometry_bytes,texture_bytes,"
+            "compressed_texture_bytes,unknown_images,vram_bytes,"
+            "compressed_vram_bytes\n";
+}
+
+void writeModelStatsCsvRow(
+    std::ostream &output, const std::string &file, const ModelStats &stats)
+{
+  // Quoted, file names may contain commas
+  output << '"';
+  for (const auto c : file) {
+    output << (c == '"' ? "\"\"" : std::string(1, c));
+  }
+  output << '"' << ',' << stats.nodeCount << ',' << stats.meshCount << ','
+         << stats.primitiveCount << ',' << stats.materialCount << ','
+         << stats.textureCount << ',' << stats.imageCount << ','
+         << stats.triangleCount << ',' << stats.vertexCount << ','
+         << stats.drawCount << ',' << stats.drawnTriangleCount << ','
+         << stats.instancedMeshCount << ',' << stats.instanceableDrawCount
+         << ',' << stats.hierarchyDepth << ',' << stats.geometryBytes << ','
+         << stats.textureBytes << ',' << stats.compressedTextureBytes << ','
+         << stats.unknownImageCount << ','
+         << stats.geometryBytes + stats.textureBytes << ','
+         << stats.geometryBytes + stats.compressedTextureBytes << '\n';
+}
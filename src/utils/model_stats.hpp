@@ -0,0 +1,57 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+// Figures of a glTF asset computed from its JSON and headers only, without
+// GL context nor decoding of images, to sort out large collections of
+// assets before opening them in the viewer.
+struct ModelStats
+{
+  size_t nodeCount = 0;
+  size_t meshCount = 0;
+  size_t primitiveCount = 0; // Of all meshes, each counted once
+  size_t materialCount = 0;
+  size_t textureCount = 0;
+  size_t imageCount = 0;
+  size_t triangleCount = 0; // Of all meshes, each counted once
+  size_t vertexCount = 0; // Same
+  // Draws of the default scene (the first one if it has none), one per
+  // primitive of each node and EXT_mesh_gpu_instancing instance, only the
+  // first level of MSFT_lod groups
+  size_t drawCount = 0;
+  size_t drawnTriangleCount = 0;
+  // Meshes drawn by several nodes, and the draws instancing them would save:
+  // those of every node but one drawing each of them
+  size_t instancedMeshCount = 0;
+  size_t instanceableDrawCount = 0;
+  size_t hierarchyDepth = 0; // Nodes of the longest path from a root
+  size_t geometryBytes = 0; // Of the accessors of primitives, unpacked
+  // Images sampled by textures (KHR_texture_basisu source if any) with their
+  // full mip chain, as RGBA8 or as 1 byte per texel (BC7 or ASTC 4x4, what
+  // KTX2 images are transcoded to). Images whose size could not be read
+  // from their header are counted apart and left out.
+  size_t textureBytes = 0;
+  size_t compressedTextureBytes = 0;
+  size_t unknownImageCount = 0;
+};
+
+ModelStats computeModelStats(const tinygltf::Model &model);
+
+// Parse a .gltf or .glb file, keeping its images encoded, and compute its
+// stats. Returns false with the reason in err if it could not be parsed,
+// err is empty otherwise.
+bool loadModelStats(const fs::path &path, ModelStats &stats, std::string &err);
+
+// One row per file, figures in the order of ModelStats, then the estimated
+// video memory of geometry and textures without and with texture
+// compression
+void writeModelStatsCsvHeader(std::ostream &output);
+
+void writeModelStatsCsvRow(
+    std::ostream &output, const std::string &file, const ModelStats &stats);
@@ -0,0 +1,249 @@
+#include "packed_geometry.hpp"
+#include "mesh_simplify.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Write the first componentCount components of each element of an attribute
+// at the given offset of each vertex, starting at vertices[firstVertex]
+template <typename Vertex>
+bool readAttribute(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, const char *attribute,
+    int componentCount, size_t memberOffset, std::vector<Vertex> &vertices,
+    size_t firstVertex, std::string &err)
+{
+  const auto it = primitive.attributes.find(attribute);
+  if (it == end(primitive.attributes)) {
+    return true;
+  }
+  const auto &accessor = model.accessors[it->second];
+  if (accessor.sparse.isSparse || accessor.bufferView < 0) {
+    err = std::string("Sparse ") + attribute + " accessor";
+    return false;
+  }
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE) {
+    err = std::string("Unsupported component type of ") + attribute;
+    return false;
+  }
+  const auto &bufferView = model.bufferViews[accessor.bufferView];
+  const auto componentSize =
+      size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+  const auto byteStride = bufferView.byteStride
+                              ? bufferView.byteStride
+                              : componentSize * componentCount;
+  const auto data = bufferBytes[bufferView.buffer].data +
+                    bufferView.byteOffset + accessor.byteOffset;
+  for (size_t i = 0; i < accessor.count; ++i) {
+    auto *member = reinterpret_cast<float *>(
+        reinterpret_cast<unsigned char *>(&vertices[firstVertex + i]) +
+        memberOffset);
+    for (auto c = 0; c < componentCount; ++c) {
+      member[c] = readComponent(data + byteStride * i + componentSize * c,
+          accessor.componentType, accessor.normalized);
+    }
+  }
+  return true;
+}
+
+// Of each range of a PackedGeometry
+std::vector<int> getPrimitiveModes(const tinygltf::Model &model)
+{
+  std::vector<int> modes;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      modes.push_back(primitive.mode);
+    }
+  }
+  return modes;
+}
+
+} // namespace
+
+bool packGeometry(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, PackedGeometry &geometry,
+    std::string &err)
+{
+  geometry = PackedGeometry();
+  const auto hasTangents = std::any_of(begin(model.meshes), end(model.meshes),
+      [](const tinygltf::Mesh &mesh) {
+        return std::any_of(begin(mesh.primitives), end(mesh.primitives),
+            [](const tinygltf::Primitive &primitive) {
+              return primitive.attributes.count("TANGENT") != 0;
+            });
+      });
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      PackedGeometry::Range range = {};
+      range.firstIndex = GLuint(geometry.indices.size());
+      range.baseVertex = GLint(geometry.vertices.size());
+
+      const auto positionIt = primitive.attributes.find("POSITION");
+      const auto vertexCount =
+          positionIt == end(primitive.attributes)
+              ? size_t(0)
+              : model.accessors[positionIt->second].count;
+      geometry.vertices.resize(geometry.vertices.size() + vertexCount,
+          PackedVertex{glm::vec3(0), glm::vec3(0), glm::vec2(0)});
+      const auto firstVertex = size_t(range.baseVertex);
+      auto &vertices = geometry.vertices;
+      if (!readAttribute(model, bufferBytes, primitive, "POSITION", 3,
+              offsetof(PackedVertex, position), vertices, firstVertex, err) ||
+          !readAttribute(model, bufferBytes, primitive, "NORMAL", 3,
+              offsetof(PackedVertex, normal), vertices, firstVertex, err) ||
+          !readAttribute(model, bufferBytes, primitive, "TEXCOORD_0", 2,
+              offsetof(PackedVertex, texCoords), vertices, firstVertex,
+              err)) {
+        return false;
+      }
+      if (!model.skins.empty()) {
+        auto &skinVertices = geometry.skinVertices;
+        skinVertices.resize(geometry.vertices.size(),
+            PackedSkinVertex{glm::vec4(0), glm::vec4(0)});
+        if (!readAttribute(model, bufferBytes, primitive, "JOINTS_0", 4,
+                offsetof(PackedSkinVertex, joints), skinVertices, firstVertex,
+                err) ||
+            !readAttribute(model, bufferBytes, primitive, "WEIGHTS_0", 4,
+                offsetof(PackedSkinVertex, weights), skinVertices,
+                firstVertex, err)) {
+          return false;
+        }
+      }
+      if (hasTangents) {
+        geometry.tangents.resize(geometry.vertices.size(), glm::vec4(0));
+        if (!readAttribute(model, bufferBytes, primitive, "TANGENT", 4, 0,
+                geometry.tangents, firstVertex, err)) {
+          return false;
+        }
+      }
+
+      if (primitive.indices >= 0) {
+        const auto &accessor = model.accessors[primitive.indices];
+        const auto &bufferView = model.bufferViews[accessor.bufferView];
+        const auto indexSize =
+            size_t(tinygltf::GetComponentSizeInBytes(accessor.componentType));
+        const auto byteStride =
+            bufferView.byteStride ? bufferView.byteStride : indexSize;
+        const auto data = bufferBytes[bufferView.buffer].data +
+                          bufferView.byteOffset + accessor.byteOffset;
+        for (size_t i = 0; i < accessor.count; ++i) {
+          uint32_t index = 0;
+          switch (accessor.componentType) {
+          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            index = data[byteStride * i];
+            break;
+          case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+            uint16_t value;
+            std::memcpy(&value, data + byteStride * i, sizeof(value));
+            index = value;
+            break;
+          }
+          default:
+            std::memcpy(&index, data + byteStride * i, sizeof(index));
+            break;
+          }
+          // Would read the vertices of another primitive
+          if (index >= vertexCount) {
+            err = "indices out of the vertices of a primitive";
+            return false;
+          }
+          geometry.indices.push_back(index);
+        }
+      } else {
+        geometry.indices.resize(geometry.indices.size() + vertexCount);
+        std::iota(begin(geometry.indices) + range.firstIndex,
+            end(geometry.indices), uint32_t(0));
+      }
+      range.indexCount = GLuint(geometry.indices.size() - range.firstIndex);
+      geometry.ranges.push_back(range);
+    }
+  }
+  return true;
+}
+
+void buildLods(const tinygltf::Model &model, PackedGeometry &geometry,
+    size_t maxLodCount)
+{
+  const auto modes = getPrimitiveModes(model);
+
+  // Levels of each range, built on all threads then appended to indices
+  std::vector<std::vector<std::vector<uint32_t>>> lodIndices(
+      geometry.ranges.size());
+  std::vector<std::vector<float>> lodErrors(geometry.ranges.size());
+  parallelFor(geometry.ranges.size(), [&](size_t i) {
+    const auto &range = geometry.ranges[i];
+    if (modes[i] != TINYGLTF_MODE_TRIANGLES || range.indexCount < 3) {
+      return;
+    }
+    const auto *indices = geometry.indices.data() + range.firstIndex;
+    const auto *vertices = geometry.vertices.data() + range.baseVertex;
+    auto bboxMin = glm::vec3(std::numeric_limits<float>::max());
+    auto bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (GLuint j = 0; j < range.indexCount; ++j) {
+      bboxMin = glm::min(bboxMin, vertices[indices[j]].position);
+      bboxMax = glm::max(bboxMax, vertices[indices[j]].position);
+    }
+    const auto extent = bboxMax - bboxMin;
+    const auto size = std::max(extent.x, std::max(extent.y, extent.z));
+
+    // Grids of 128, 32, 8 then 2 cells along the largest side of the range
+    auto previousIndexCount = size_t(range.indexCount);
+    for (auto gridSize = 128.f;
+         gridSize >= 2.f && lodIndices[i].size() < maxLodCount;
+         gridSize /= 4.f) {
+      const auto cellSize = size / gridSize;
+      auto simplified = simplifyTriangles(
+          reinterpret_cast<const unsigned char *>(vertices) +
+              offsetof(PackedVertex, position),
+          sizeof(PackedVertex), indices, range.indexCount, cellSize);
+      if (simplified.empty()) {
+        break;
+      }
+      if (4 * simplified.size() > 3 * previousIndexCount) {
+        continue;
+      }
+      previousIndexCount = simplified.size();
+      lodIndices[i].push_back(std::move(simplified));
+      lodErrors[i].push_back(cellSize * std::sqrt(3.f));
+    }
+  });
+
+  geometry.lods.assign(geometry.ranges.size(), {});
+  for (size_t i = 0; i < geometry.ranges.size(); ++i) {
+    for (size_t level = 0; level < lodIndices[i].size(); ++level) {
+      const auto &indices = lodIndices[i][level];
+      geometry.lods[i].push_back(PackedGeometry::Lod{
+          GLuint(geometry.indices.size()), GLuint(indices.size()),
+          lodErrors[i][level]});
+      geometry.indices.insert(
+          end(geometry.indices), begin(indices), end(indices));
+    }
+  }
+}
+
+void splitIntoMeshlets(const tinygltf::Model &model, PackedGeometry &geometry)
+{
+  const auto modes = getPrimitiveModes(model);
+  geometry.meshlets.assign(geometry.ranges.size(), {});
+  parallelFor(geometry.ranges.size(), [&](size_t i) {
+    const auto &range = geometry.ranges[i];
+    if (modes[i] != TINYGLTF_MODE_TRIANGLES || range.indexCount < 3) {
+      return;
+    }
+    geometry.meshlets[i] = buildMeshlets(
+        reinterpret_cast<const unsigned char *>(
+            geometry.vertices.data() + range.baseVertex) +
+            offsetof(PackedVertex, position),
+        sizeof(PackedVertex), geometry.indices.data() + range.firstIndex,
+        range.indexCount, 64, 124);
+  });
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "gltf.hpp"
+#include "meshlets.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Vertex layout shared by all primitives of a PackedGeometry
+struct PackedVertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texCoords;
+};
+
+// Of the vertices of skinned meshes, in a vertex array of its own so that
+// models without skins do not pay for it. Joint indices are stored as floats
+// (exact for the 8 and 16 bits integers of glTF).
+struct PackedSkinVertex
+{
+  glm::vec4 joints;
+  glm::vec4 weights;
+};
+
+// All primitives of a model in one vertex array and one array of 32 bits
+// indices, so that the whole scene can be drawn from a single vertex array
+// object with glMultiDrawElementsIndirect. Attributes missing from a
+// primitive are zero, and non indexed primitives get sequential indices.
+struct PackedGeometry
+{
+  struct Range
+  {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+  };
+
+  std::vector<PackedVertex> vertices;
+  // JOINTS_0 and WEIGHTS_0 of vertices, zero if a primitive has none. Empty
+  // if the model has no skin.
+  std::vector<PackedSkinVertex> skinVertices;
+  // TANGENT of vertices (handedness in w), zero if a primitive has none.
+  // Empty if no primitive has tangents.
+  std::vector<glm::vec4> tangents;
+  std::vector<uint32_t> indices;
+  // Of each primitive of each mesh, in the order of vertexArrayObjects
+  std::vector<Range> ranges;
+
+  // Simplified levels of detail of a range, made by buildLods
+  struct Lod
+  {
+    GLuint firstIndex;
+    GLuint indexCount; // Of the vertices of the range, from its baseVertex
+    float error; // Distance to the full range, in the space of the mesh
+  };
+  // Of each range, by increasing error. Empty without buildLods.
+  std::vector<std::vector<Lod>> lods;
+
+  // Of each range, their indices relative to the firstIndex of the range.
+  // Empty without splitIntoMeshlets.
+  std::vector<std::vector<Meshlet>> meshlets;
+};
+
+// Read vertex data from bufferBytes. Returns false with the reason in err
+// for accessors the packed layout cannot represent (sparse, or not a float
+// or 8/16 bits integer vector) and indices past the vertices of their
+// primitive.
+bool packGeometry(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, PackedGeometry &geometry,
+    std::string &err);
+
+// Append up to maxLodCount simplified versions (see simplifyTriangles) of each
+// triangle primitive to the indices of geometry. A level is only kept if it
+// has at most 3/4 of the triangles of the previous one.
+void buildLods(const tinygltf::Model &model, PackedGeometry &geometry,
+    size_t maxLodCount);
+
+// Reorder the triangles of each triangle primitive into meshlets (see
+// buildMeshlets) of at most 64 vertices and 124 triangles. To be called
+// before buildLods, which appends indices.
+void splitIntoMeshlets(const tinygltf::Model &model, PackedGeometry &geometry);
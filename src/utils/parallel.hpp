@@ -0,0 +1,14 @@
+#pragma once
+
+#include "job_system.hpp"
+
+// Call f(i) for each i in [0, count), spreading the calls over at most
+// threadCount threads (all threads of the global JobSystem by default). The
+// calling thread takes part in the work. Returns when every call is done. f
+// must not throw.
+template <typename Function>
+void parallelFor(size_t count, Function &&f, size_t threadCount = 0)
+{
+  JobSystem::global().parallelFor(count, std::forward<Function>(f), 1,
+      threadCount);
+}
@@ -0,0 +1,276 @@
+#include "path_tracer.hpp"
+#include "accessor_view.hpp"
+#include "bvh.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+// Vertices of a primitive in the space of its mesh, read once for all the
+// items drawing it
+struct PrimitiveVertices
+{
+  bool isRead = false;
+  std::vector<float> positions;
+  std::vector<float> normals; // Empty without NORMAL
+  std::vector<float> texCoords; // Empty without TEXCOORD_0
+  std::vector<uint32_t> indices; // 3 per triangle
+};
+
+// Float elements of an attribute of primitive, empty if it has none or if
+// they are no longer in bufferBytes
+std::vector<float> readAttribute(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, const char *name,
+    int componentCount)
+{
+  std::vector<float> values;
+  const auto attribute = primitive.attributes.find(name);
+  if (attribute == end(primitive.attributes) ||
+      !isAccessorInBuffer(
+          model, bufferBytes, model.accessors[attribute->second]) ||
+      !readFloatAccessor(model, bufferBytes, attribute->second,
+          componentCount, values)) {
+    values.clear();
+  }
+  return values;
+}
+
+void readVertices(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, PrimitiveVertices &vertices)
+{
+  vertices.isRead = true;
+  if ((primitive.mode != TINYGLTF_MODE_TRIANGLES && primitive.mode != -1) ||
+      !primitive.targets.empty()) {
+    return;
+  }
+  vertices.positions =
+      readAttribute(model, bufferBytes, primitive, "POSITION", 3);
+  const auto vertexCount = vertices.positions.size() / 3;
+  if (!vertexCount) {
+    return;
+  }
+  vertices.normals = readAttribute(model, bufferBytes, primitive, "NORMAL", 3);
+  vertices.texCoords =
+      readAttribute(model, bufferBytes, primitive, "TEXCOORD_0", 2);
+  if (vertices.normals.size() != 3 * vertexCount) {
+    vertices.normals.clear();
+  }
+  if (vertices.texCoords.size() != 2 * vertexCount) {
+    vertices.texCoords.clear();
+  }
+  if (primitive.indices >= 0) {
+    const auto &accessor = model.accessors[primitive.indices];
+    if (!isAccessorInBuffer(model, bufferBytes, accessor) ||
+        !readIndexAccessor(model, bufferBytes, accessor, vertices.indices)) {
+      vertices.indices.clear();
+    }
+  } else {
+    vertices.indices.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+      vertices.indices[i] = uint32_t(i);
+    }
+  }
+  vertices.indices.resize(vertices.indices.size() / 3 * 3);
+  if (std::any_of(begin(vertices.indices), end(vertices.indices),
+          [&](uint32_t index) { return index >= vertexCount; })) {
+    vertices.indices.clear();
+  }
+}
+
+} // namespace
+
+bool PathTracer::View::operator==(const View &other) const
+{
+  return viewMatrix == other.viewMatrix && projMatrix == other.projMatrix &&
+         lightDirection == other.lightDirection &&
+         lightIntensity == other.lightIntensity &&
+         environmentIntensity == other.environmentIntensity &&
+         width == other.width && height == other.height;
+}
+
+PathTracer::PathTracer(GLProgram traceProgram, GLProgram resolveProgram) :
+    m_traceProgram(std::move(traceProgram)),
+    m_resolveProgram(std::move(resolveProgram)),
+    m_emptyVertexArray(GLVertexArray::generate())
+{
+  m_uProjMatrix = m_traceProgram.getUniformLocation("uProjMatrix");
+  m_uCameraMatrix = m_traceProgram.getUniformLocation("uCameraMatrix");
+  m_uLightDirection = m_traceProgram.getUniformLocation("uLightDirection");
+  m_uLightIntensity = m_traceProgram.getUniformLocation("uLightIntensity");
+  m_uSampleIndex = m_traceProgram.getUniformLocation("uSampleIndex");
+  m_uWeight = m_traceProgram.getUniformLocation("uWeight");
+  m_uEncodeOutput = m_resolveProgram.getUniformLocation("uEncodeOutput");
+  glProgramUniform1i(m_traceProgram.glId(),
+      m_traceProgram.getUniformLocation("uMaxBounces"), MAX_BOUNCES);
+  for (const auto &block :
+      {std::make_pair("PathTraceNodes", NODES_BINDING),
+          std::make_pair("PathTraceTriangles", TRIANGLES_BINDING)}) {
+    const auto blockIndex = glGetProgramResourceIndex(
+        m_traceProgram.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glShaderStorageBlockBinding(
+          m_traceProgram.glId(), blockIndex, block.second);
+    }
+  }
+}
+
+size_t PathTracer::build(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const std::vector<PathTracerItem> &items)
+{
+  std::vector<const tinygltf::Primitive *> gltfPrimitives;
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      gltfPrimitives.push_back(&primitive);
+    }
+  }
+  std::vector<PrimitiveVertices> primitiveVertices(gltfPrimitives.size());
+
+  std::vector<Triangle> triangles;
+  std::vector<BoundingBox> triangleBounds;
+  for (const auto &item : items) {
+    if (item.primitive < 0 || size_t(item.primitive) >= gltfPrimitives.size()) {
+      continue;
+    }
+    auto &vertices = primitiveVertices[item.primitive];
+    if (!vertices.isRead) {
+      readVertices(
+          model, bufferBytes, *gltfPrimitives[item.primitive], vertices);
+    }
+    const auto normalMatrix =
+        glm::transpose(glm::inverse(glm::mat3(item.matrix)));
+    for (size_t i = 0; i < vertices.indices.size(); i += 3) {
+      Triangle triangle{};
+      BoundingBox bounds;
+      for (size_t corner = 0; corner < 3; ++corner) {
+        const auto vertex = size_t(vertices.indices[i + corner]);
+        triangle.positions[corner] = item.matrix *
+            glm::vec4(glm::make_vec3(&vertices.positions[3 * vertex]), 1);
+        bounds.extend(glm::vec3(triangle.positions[corner]));
+        if (!vertices.normals.empty()) {
+          triangle.normals[corner] = glm::vec4(glm::normalize(normalMatrix *
+              glm::make_vec3(&vertices.normals[3 * vertex])), 0);
+        }
+        if (!vertices.texCoords.empty()) {
+          triangle.texCoords[corner] =
+              glm::make_vec2(&vertices.texCoords[2 * vertex]);
+        }
+      }
+      triangle.material = item.material;
+      triangles.push_back(triangle);
+      triangleBounds.push_back(bounds);
+    }
+  }
+
+  // Triangles in the order of the leaves referencing them. Buffers can not
+  // be empty, empty scenes get a leaf without triangles.
+  const auto bvh = buildBvh(triangleBounds);
+  std::vector<Node> nodes;
+  for (const auto &bvhNode : bvh.nodes) {
+    nodes.push_back(Node{bvhNode.bounds.min, bvhNode.first,
+        bvhNode.bounds.max, bvhNode.itemCount});
+  }
+  if (nodes.empty()) {
+    nodes.push_back(Node{glm::vec3(0), 0, glm::vec3(0), 0});
+  }
+  std::vector<Triangle> leafTriangles(std::max(bvh.items.size(), size_t(1)));
+  for (size_t i = 0; i < bvh.items.size(); ++i) {
+    leafTriangles[i] = triangles[size_t(bvh.items[i])];
+  }
+
+  m_nodeBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_nodeBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, nodes.size() * sizeof(Node),
+      nodes.data(), 0);
+  m_triangleBuffer = GLBuffer::generate();
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_triangleBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      leafTriangles.size() * sizeof(Triangle), leafTriangles.data(), 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  m_sampleCount = 0;
+  return bvh.items.size();
+}
+
+void PathTracer::trace(const View &view, size_t sampleCount)
+{
+  if (!m_nodeBuffer.glId() || view.width <= 0 || view.height <= 0) {
+    return;
+  }
+  if (view.width != m_view.width || view.height != m_view.height ||
+      !m_averageTexture.glId()) {
+    GLint previousTexture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+    m_averageTexture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_averageTexture.glId());
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA32F, view.width, view.height);
+    glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+    const auto texture = m_averageTexture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+    m_sampleCount = 0;
+  }
+  if (!(view == m_view)) {
+    m_view = view;
+    m_sampleCount = 0;
+  }
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_traceProgram.use();
+  glUniformMatrix4fv(m_uProjMatrix, 1, GL_FALSE,
+      glm::value_ptr(view.projMatrix));
+  glUniformMatrix4fv(m_uCameraMatrix, 1, GL_FALSE,
+      glm::value_ptr(glm::inverse(view.viewMatrix)));
+  glUniform3fv(m_uLightDirection, 1,
+      glm::value_ptr(glm::normalize(view.lightDirection)));
+  glUniform3fv(m_uLightIntensity, 1, glm::value_ptr(view.lightIntensity));
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, NODES_BINDING, m_nodeBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, TRIANGLES_BINDING, m_triangleBuffer.glId());
+  glBindImageTexture(0, m_averageTexture.glId(), 0, GL_FALSE, 0,
+      GL_READ_WRITE, GL_RGBA32F);
+  // A dispatch per sample, each short enough for the watchdogs of drivers
+  for (size_t i = 0; i < sampleCount; ++i) {
+    glUniform1ui(m_uSampleIndex, GLuint(m_sampleCount));
+    glUniform1f(m_uWeight, 1.f / float(m_sampleCount + 1));
+    glDispatchCompute(GLuint((view.width + 7) / 8),
+        GLuint((view.height + 7) / 8), 1);
+    // The next sample reads the average, and resolve draws it
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    ++m_sampleCount;
+  }
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+  glUseProgram(GLuint(previousProgram));
+}
+
+void PathTracer::resolve(bool encodeOutput) const
+{
+  if (!m_averageTexture.glId()) {
+    return;
+  }
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  GLint previousVertexArray = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+  const auto depthTest = glIsEnabled(GL_DEPTH_TEST);
+  glBindImageTexture(0, m_averageTexture.glId(), 0, GL_FALSE, 0,
+      GL_READ_ONLY, GL_RGBA32F);
+  m_resolveProgram.use();
+  glUniform1i(m_uEncodeOutput, GLint(encodeOutput));
+  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(m_emptyVertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(GLuint(previousVertexArray));
+  if (depthTest) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+  glUseProgram(GLuint(previousProgram));
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <vector>
+
+// What an item of the scene traced by PathTracer draws: a primitive,
+// numbered in the order of model.meshes and their primitives (like
+// RayQueryItem), its index in the Materials table and the matrix from the
+// space of its mesh to world space
+struct PathTracerItem
+{
+  int primitive = -1;
+  int material = 0;
+  glm::mat4 matrix = glm::mat4(1);
+};
+
+// Progressive path traced reference of the scene (--path-trace), for stills
+// converging to what an offline renderer would draw.
+//
+// The triangles of the items are transformed to world space once, on the
+// CPU, and stored in a storage buffer in the order of the leaves of their BVH
+// (see buildBvh), whose nodes are stored in another. A compute shader then
+// traces a path per pixel and per sample through them, shading its hits with
+// the material model of the forward shaders, and averages the samples in a
+// GL_RGBA32F texture. The average restarts when the view changes.
+class PathTracer
+{
+public:
+  // Storage buffers read by path_trace.cs.glsl, after those of DebugViews
+  static const GLuint NODES_BINDING = 22;
+  static const GLuint TRIANGLES_BINDING = 23;
+
+  // Hits shaded along a path after the first one. Paths carrying little
+  // light end before, by russian roulette.
+  static const int MAX_BOUNCES = 8;
+
+  // Same layouts as the PathTraceNodes and PathTraceTriangles buffers of the
+  // shader (std430)
+  struct Node
+  {
+    glm::vec3 boundsMin;
+    GLint first; // Of the children of inner nodes, of the triangles of leaves
+    glm::vec3 boundsMax;
+    GLint triangleCount; // 0 for inner nodes
+  };
+  static_assert(sizeof(Node) == 32, "Must match std430 layout");
+
+  struct Triangle
+  {
+    glm::vec4 positions[3]; // World space, w unused
+    glm::vec4 normals[3]; // World space, zero without NORMAL
+    glm::vec2 texCoords[3]; // TEXCOORD_0, zero without it
+    GLint material;
+    float padding;
+  };
+  static_assert(sizeof(Triangle) == 128, "Must match std430 layout");
+
+  // What the average depends on, it restarts when any of it changes.
+  // Environment maps are bound by the caller, with the intensity given here.
+  struct View
+  {
+    glm::mat4 viewMatrix = glm::mat4(1);
+    glm::mat4 projMatrix = glm::mat4(1); // With the tile or jitter matrix
+    glm::vec3 lightDirection = glm::vec3(0, 0, 1); // World space, to it
+    glm::vec3 lightIntensity = glm::vec3(1);
+    float environmentIntensity = 0.f;
+    GLsizei width = 0;
+    GLsizei height = 0;
+
+    bool operator==(const View &other) const;
+  };
+
+  // traceProgram is path_trace.cs.glsl, with its Materials and
+  // EnvironmentUniforms blocks and its uPrefilteredEnvironment sampler
+  // bound by the caller, resolveProgram is fullscreen_triangle.vs.glsl with
+  // path_trace_resolve.fs.glsl
+  PathTracer(GLProgram traceProgram, GLProgram resolveProgram);
+
+  PathTracer(const PathTracer &) = delete;
+
+  PathTracer &operator=(const PathTracer &) = delete;
+
+  // Upload the world space triangles of items, read from model and
+  // bufferBytes, and the BVH built over them, and restart the average.
+  // Primitives of other modes than triangles, with morph targets or whose
+  // vertices are no longer in bufferBytes (--release-cpu-data) are skipped.
+  // Returns the number of triangles uploaded.
+  size_t build(const tinygltf::Model &model,
+      const std::vector<BufferBytes> &bufferBytes,
+      const std::vector<PathTracerItem> &items);
+
+  // Add sampleCount samples per pixel of view to the average, restarted
+  // first if view differs from that of the last call
+  void trace(const View &view, size_t sampleCount);
+
+  // Of the last call to trace
+  const View &view() const { return m_view; }
+
+  // Samples averaged since the last restart
+  size_t sampleCount() const { return m_sampleCount; }
+
+  // Draw the average over the viewport, encoded to sRGB if encodeOutput
+  void resolve(bool encodeOutput) const;
+
+private:
+  GLProgram m_traceProgram;
+  GLProgram m_resolveProgram;
+  GLint m_uProjMatrix = -1;
+  GLint m_uCameraMatrix = -1;
+  GLint m_uLightDirection = -1;
+  GLint m_uLightIntensity = -1;
+  GLint m_uSampleIndex = -1;
+  GLint m_uWeight = -1;
+  GLint m_uEncodeOutput = -1;
+  GLBuffer m_nodeBuffer;
+  GLBuffer m_triangleBuffer;
+  GLVertexArray m_emptyVertexArray;
+  GLTexture m_averageTexture; // GL_RGBA32F, of the size of m_view
+  View m_view;
+  size_t m_sampleCount = 0;
+};
@@ -0,0 +1,267 @@
+#include "point_clouds.hpp"
+#include "accessor_view.hpp"
+#include "gl_extensions.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace {
+
+// Bits of x in every third bit, for 10 bits Morton codes by axis
+uint32_t spreadBits(uint32_t x)
+{
+  x = (x | (x << 16)) & 0x030000ff;
+  x = (x | (x << 8)) & 0x0300f00f;
+  x = (x | (x << 4)) & 0x030c30c3;
+  x = (x | (x << 2)) & 0x09249249;
+  return x;
+}
+
+uint32_t packColor(const glm::vec4 &color)
+{
+  const auto bytes = glm::uvec4(glm::round(
+      255.f * glm::clamp(color, glm::vec4(0.f), glm::vec4(1.f))));
+  return bytes.r | (bytes.g << 8) | (bytes.b << 16) | (bytes.a << 24);
+}
+
+// Largest number of workgroups of a dispatch along x guaranteed by GL
+const uint32_t MAX_DISPATCH_BATCH_COUNT = 65535;
+
+} // namespace
+
+bool PointClouds::hasInt64Atomics()
+{
+  return hasGLExtension("GL_ARB_gpu_shader_int64") &&
+         hasGLExtension("GL_NV_shader_atomic_int64");
+}
+
+PointClouds::PointClouds(GLProgram rasterizeProgram, GLProgram resolveProgram) :
+    m_rasterizeProgram(std::move(rasterizeProgram)),
+    m_resolveProgram(std::move(resolveProgram)),
+    m_int64Atomics(hasInt64Atomics()),
+    m_pointBuffer(GLBuffer::generate()),
+    m_batchBuffer(GLBuffer::generate()),
+    m_pixelBuffer(GLBuffer::generate()),
+    m_vertexArray(GLVertexArray::generate())
+{
+  for (const auto *program : {&m_rasterizeProgram, &m_resolveProgram}) {
+    for (const auto &block : {std::make_pair("Points", POINTS_BINDING),
+             std::make_pair("Batches", BATCHES_BINDING),
+             std::make_pair("Pixels", PIXELS_BINDING)}) {
+      const auto blockIndex = glGetProgramResourceIndex(
+          program->glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+      if (blockIndex != GL_INVALID_INDEX) {
+        glShaderStorageBlockBinding(program->glId(), blockIndex, block.second);
+      }
+    }
+  }
+  m_uModelMatrix = m_rasterizeProgram.getUniformLocation("uModelMatrix");
+  m_uViewProjMatrix = m_rasterizeProgram.getUniformLocation("uViewProjMatrix");
+  m_uFrustumPlanes = m_rasterizeProgram.getUniformLocation("uFrustumPlanes");
+  m_uFirstBatch = m_rasterizeProgram.getUniformLocation("uFirstBatch");
+  m_uPixelScale = m_rasterizeProgram.getUniformLocation("uPixelScale");
+  m_uPerspective = m_rasterizeProgram.getUniformLocation("uPerspective");
+  m_uViewportSize = m_rasterizeProgram.getUniformLocation("uViewportSize");
+  m_uPass = m_rasterizeProgram.getUniformLocation("uPass");
+  m_uResolveViewportSize =
+      m_resolveProgram.getUniformLocation("uViewportSize");
+  m_uEncodeOutput = m_resolveProgram.getUniformLocation("uEncodeOutput");
+  m_uFillHoles = m_resolveProgram.getUniformLocation("uFillHoles");
+}
+
+int PointClouds::addPrimitive(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, const glm::vec4 &baseColor)
+{
+  const auto &attributes = primitive.attributes;
+  const auto position = attributes.find("POSITION");
+  std::vector<float> positions;
+  if (position == end(attributes) || position->second < 0 ||
+      !readFloatAccessor(model, bufferBytes, position->second, 3, positions)) {
+    return -1;
+  }
+  const auto vertexCount = positions.size() / 3;
+  // COLOR_0 of 3 or 4 components, white without it
+  std::vector<float> colors;
+  auto colorComponentCount = 0;
+  const auto color = attributes.find("COLOR_0");
+  if (color != end(attributes) && color->second >= 0) {
+    colorComponentCount =
+        tinygltf::GetNumComponentsInType(model.accessors[color->second].type);
+    if ((colorComponentCount != 3 && colorComponentCount != 4) ||
+        !readFloatAccessor(model, bufferBytes, color->second,
+            colorComponentCount, colors) ||
+        colors.size() != vertexCount * size_t(colorComponentCount)) {
+      return -1;
+    }
+  }
+  std::vector<uint32_t> indices;
+  if (primitive.indices >= 0) {
+    if (!readIndexAccessor(model, bufferBytes,
+            model.accessors[primitive.indices], indices) ||
+        std::any_of(begin(indices), end(indices),
+            [&](uint32_t index) { return index >= vertexCount; })) {
+      return -1;
+    }
+  } else {
+    indices.resize(vertexCount);
+    std::iota(begin(indices), end(indices), 0u);
+  }
+  if (indices.empty() ||
+      m_points.size() + indices.size() > std::numeric_limits<uint32_t>::max()) {
+    return -1;
+  }
+
+  const auto getPosition = [&](uint32_t index) {
+    return glm::make_vec3(&positions[3 * size_t(index)]);
+  };
+  BoundingBox bounds;
+  for (const auto index : indices) {
+    bounds.extend(getPosition(index));
+  }
+  // Sorted along the Morton curve of the cells of a 1024^3 grid of bounds
+  const auto cellScale =
+      1023.f / glm::max(bounds.max - bounds.min, glm::vec3(1e-20f));
+  std::vector<std::pair<uint32_t, uint32_t>> codes(indices.size());
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const auto cell =
+        glm::uvec3((getPosition(indices[i]) - bounds.min) * cellScale);
+    codes[i] = {spreadBits(cell.x) | (spreadBits(cell.y) << 1) |
+                    (spreadBits(cell.z) << 2),
+        indices[i]};
+  }
+  std::sort(begin(codes), end(codes));
+
+  // Seeded, so that the same points are drawn at the same level of detail
+  std::mt19937 random(0);
+  const auto firstBatch = m_batches.size();
+  for (size_t first = 0; first < codes.size(); first += BATCH_SIZE) {
+    const auto last = std::min(codes.size(), first + BATCH_SIZE);
+    std::shuffle(begin(codes) + first, begin(codes) + last, random);
+    Batch batch;
+    batch.firstPoint = uint32_t(m_points.size());
+    batch.pointCount = uint32_t(last - first);
+    BoundingBox batchBounds;
+    for (auto i = first; i < last; ++i) {
+      const auto index = size_t(codes[i].second);
+      auto pointColor = baseColor;
+      if (colorComponentCount) {
+        const auto *rgba = &colors[colorComponentCount * index];
+        pointColor *= glm::vec4(
+            rgba[0], rgba[1], rgba[2], colorComponentCount == 4 ? rgba[3] : 1);
+      }
+      const auto point = getPosition(uint32_t(index));
+      batchBounds.extend(point);
+      m_points.push_back(Point{point, packColor(pointColor)});
+    }
+    batch.boundsMin = batchBounds.min;
+    batch.boundsMax = batchBounds.max;
+    m_batches.push_back(batch);
+  }
+  m_clouds.push_back(
+      Cloud{uint32_t(firstBatch), uint32_t(m_batches.size() - firstBatch)});
+  return int(m_clouds.size()) - 1;
+}
+
+void PointClouds::createBuffers()
+{
+  const auto upload = [](const GLBuffer &buffer, const void *data,
+                          size_t byteSize) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.glId());
+    glBufferStorage(
+        GL_SHADER_STORAGE_BUFFER, std::max(byteSize, size_t(1)), data, 0);
+  };
+  upload(m_pointBuffer, m_points.data(), m_points.size() * sizeof(Point));
+  upload(m_batchBuffer, m_batches.data(), m_batches.size() * sizeof(Batch));
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const GLuint buffers[] = {m_pointBuffer.glId(), m_batchBuffer.glId()};
+  trackBuffers(GpuMemoryCategory::Geometry, 2, buffers);
+  m_points = std::vector<Point>();
+  m_batches = std::vector<Batch>();
+}
+
+void PointClouds::resizePixels(GLsizei width, GLsizei height)
+{
+  // A key of 64 bits by pixel, or its two halves of 32 bits in two arrays
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pixelBuffer.glId());
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+      std::max(size_t(width) * size_t(height), size_t(1)) * 8, nullptr,
+      GL_DYNAMIC_COPY);
+  const GLuint noPoint = 0xffffffff;
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+      GL_UNSIGNED_INT, &noPoint);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const auto pixelBuffer = m_pixelBuffer.glId();
+  trackBuffers(GpuMemoryCategory::RenderTargets, 1, &pixelBuffer);
+  m_pixelWidth = width;
+  m_pixelHeight = height;
+}
+
+void PointClouds::draw(const std::vector<Draw> &draws,
+    const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+    const Frustum &frustum, GLsizei width, GLsizei height, bool encodeOutput,
+    bool fillHoles)
+{
+  if (draws.empty() || width <= 0 || height <= 0) {
+    return;
+  }
+  if (width != m_pixelWidth || height != m_pixelHeight) {
+    resizePixels(width, height);
+  }
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, POINTS_BINDING, m_pointBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, BATCHES_BINDING, m_batchBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, PIXELS_BINDING, m_pixelBuffer.glId());
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_rasterizeProgram.use();
+  glUniformMatrix4fv(
+      m_uViewProjMatrix, 1, GL_FALSE, glm::value_ptr(projMatrix * viewMatrix));
+  glUniform4fv(m_uFrustumPlanes, 6, glm::value_ptr(frustum.planes[0]));
+  glUniform1f(m_uPixelScale, 0.5f * float(height) * projMatrix[1][1]);
+  glUniform1i(m_uPerspective, GLint(projMatrix[3][3] == 0.f));
+  glUniform2i(m_uViewportSize, width, height);
+  // Depths of the points first, then the indices of those at these depths
+  for (GLint pass = 0; pass < (m_int64Atomics ? 1 : 2); ++pass) {
+    glUniform1i(m_uPass, pass);
+    for (const auto &draw : draws) {
+      const auto &cloud = m_clouds[size_t(draw.cloud)];
+      glUniformMatrix4fv(
+          m_uModelMatrix, 1, GL_FALSE, glm::value_ptr(draw.modelMatrix));
+      for (uint32_t first = 0; first < cloud.batchCount;
+           first += MAX_DISPATCH_BATCH_COUNT) {
+        glUniform1ui(m_uFirstBatch, cloud.firstBatch + first);
+        glDispatchCompute(
+            std::min(cloud.batchCount - first, MAX_DISPATCH_BATCH_COUNT), 1,
+            1);
+      }
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+
+  m_resolveProgram.use();
+  glUniform2i(m_uResolveViewportSize, width, height);
+  glUniform1i(m_uEncodeOutput, GLint(encodeOutput));
+  glUniform1i(m_uFillHoles, GLint(fillHoles));
+  glBindVertexArray(m_vertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+  glUseProgram(GLuint(previousProgram));
+
+  // Cleared for the next draw() once read
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_pixelBuffer.glId());
+  const GLuint noPoint = 0xffffffff;
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+      GL_UNSIGNED_INT, &noPoint);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compute rasterizer of the POINTS primitives of --compute-points, for scans
+// of millions of points that the fixed-function path draws as one pixel
+// each, all of them every frame.
+//
+// Points of each primitive are sorted along a Morton curve of its bounds and
+// split in batches of BATCH_SIZE neighbours, shuffled within each batch so
+// that any prefix of a batch samples all of it. point_rasterize.cs.glsl runs
+// a workgroup per batch: batches outside the frustum are skipped, the others
+// only rasterize the prefix that covers their projected area with
+// POINT_DENSITY points per pixel (level of detail). Each point keeps the
+// nearest depth of its pixel with atomics, packed with the index of the
+// point into 64 bits when GL_NV_shader_atomic_int64 is supported, otherwise
+// by two passes of 32 bits atomics (depths, then the indices of the points
+// at those depths). point_resolve.fs.glsl then writes the colors and depths
+// of the pixels into the framebuffer, optionally filling the holes between
+// points with their nearest neighbour.
+//
+// Points are unlit: colors are COLOR_0 times the base color factor of the
+// material.
+class PointClouds
+{
+public:
+  static const uint32_t BATCH_SIZE = 1024;
+  static const GLsizei POINT_DENSITY = 2;
+
+  // Storage buffers of point_rasterize.cs.glsl and point_resolve.fs.glsl,
+  // after the instances of Impostors
+  static const GLuint POINTS_BINDING = 14;
+  static const GLuint BATCHES_BINDING = 15;
+  static const GLuint PIXELS_BINDING = 16;
+
+  // Instance of a point cloud (from addPrimitive), with the matrix of its
+  // node
+  struct Draw
+  {
+    int cloud;
+    glm::mat4 modelMatrix;
+  };
+
+  // True if the GL context has the 64 bits atomics of the single pass, whose
+  // programs must then be compiled with ATOMIC_INT64 defined
+  static bool hasInt64Atomics();
+
+  // rasterizeProgram is point_rasterize.cs.glsl, resolveProgram
+  // fullscreen_triangle.vs.glsl and point_resolve.fs.glsl, both with the
+  // REVERSED_Z define of the depth convention
+  PointClouds(GLProgram rasterizeProgram, GLProgram resolveProgram);
+
+  PointClouds(const PointClouds &) = delete;
+
+  PointClouds &operator=(const PointClouds &) = delete;
+
+  // Read the points of primitive from bufferBytes, colored by baseColor,
+  // returns their index for Draw, or -1 if they cannot be read
+  int addPrimitive(const tinygltf::Model &model,
+      const std::vector<BufferBytes> &bufferBytes,
+      const tinygltf::Primitive &primitive, const glm::vec4 &baseColor);
+
+  // Upload the points once all primitives are added. Points and batches are
+  // released from the CPU.
+  void createBuffers();
+
+  // Rasterize draws in a viewport of width x height pixels of the current
+  // framebuffer, with the depth test and depth function of the other draws.
+  // frustum is the one of projMatrix * viewMatrix, projMatrix has the depth
+  // convention of the programs. Colors are sRGB encoded with encodeOutput.
+  void draw(const std::vector<Draw> &draws, const glm::mat4 &viewMatrix,
+      const glm::mat4 &projMatrix, const Frustum &frustum, GLsizei width,
+      GLsizei height, bool encodeOutput, bool fillHoles);
+
+private:
+  // Same layouts as in point_rasterize.cs.glsl (std430)
+  struct Point
+  {
+    glm::vec3 position;
+    uint32_t color; // RGBA8, linear
+  };
+
+  struct Batch
+  {
+    glm::vec3 boundsMin;
+    uint32_t firstPoint; // In m_points
+    glm::vec3 boundsMax;
+    uint32_t pointCount;
+  };
+  static_assert(sizeof(Batch) == 32, "Must match std430 layout");
+
+  struct Cloud
+  {
+    uint32_t firstBatch; // In m_batches
+    uint32_t batchCount;
+  };
+
+  // Allocate the pixels of a viewport, cleared to no point
+  void resizePixels(GLsizei width, GLsizei height);
+
+  GLProgram m_rasterizeProgram;
+  GLProgram m_resolveProgram;
+  GLint m_uModelMatrix = -1;
+  GLint m_uViewProjMatrix = -1;
+  GLint m_uFrustumPlanes = -1;
+  GLint m_uFirstBatch = -1;
+  GLint m_uPixelScale = -1;
+  GLint m_uPerspective = -1;
+  GLint m_uViewportSize = -1;
+  GLint m_uPass = -1;
+  GLint m_uResolveViewportSize = -1;
+  GLint m_uEncodeOutput = -1;
+  GLint m_uFillHoles = -1;
+  bool m_int64Atomics;
+
+  std::vector<Cloud> m_clouds;
+  std::vector<Batch> m_batches;
+  std::vector<Point> m_points;
+  GLBuffer m_pointBuffer;
+  GLBuffer m_batchBuffer;
+  GLBuffer m_pixelBuffer;
+  GLVertexArray m_vertexArray; // Without attributes
+  GLsizei m_pixelWidth = 0;
+  GLsizei m_pixelHeight = 0;
+};
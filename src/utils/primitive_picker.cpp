@@ -0,0 +1,69 @@
+#include "primitive_picker.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+Ray getCursorRay(const glm::vec2 &cursor, const glm::vec2 &viewportSize,
+    const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix)
+{
+  const auto viewport = glm::vec4(0, 0, viewportSize.x, viewportSize.y);
+  const auto nearPoint = glm::unProject(
+      glm::vec3(cursor, 0), viewMatrix, projMatrix, viewport);
+  const auto farPoint = glm::unProject(
+      glm::vec3(cursor, 1), viewMatrix, projMatrix, viewport);
+  return getSegmentRay(nearPoint, farPoint);
+}
+
+PrimitivePicker::PrimitivePicker(const std::vector<size_t> &firstPrimitives,
+    const std::vector<BoundingBox> &primitiveBounds) :
+    m_firstPrimitives(firstPrimitives),
+    m_primitiveBounds(primitiveBounds)
+{
+}
+
+void PrimitivePicker::pick(const RayHit &hit)
+{
+  if (m_nodeIdx >= 0) {
+    m_hasPreviousPosition = true;
+    m_previousPosition = m_position;
+  }
+  select(hit.item);
+  if (hit.item >= 0) {
+    m_triangle = hit.triangle;
+    m_position = hit.position;
+  }
+}
+
+void PrimitivePicker::pickDraw(uint32_t drawId)
+{
+  select(drawId > 0 && drawId <= m_primitiveBounds.size() ? int(drawId - 1)
+                                                          : -1);
+}
+
+uint32_t PrimitivePicker::firstDrawId() const
+{
+  return uint32_t(m_firstPrimitives[size_t(m_nodeIdx)] + 1);
+}
+
+uint32_t PrimitivePicker::endDrawId() const
+{
+  const auto nodeIdx = size_t(m_nodeIdx);
+  const auto endPrimitive = nodeIdx + 1 < m_firstPrimitives.size()
+                                ? m_firstPrimitives[nodeIdx + 1]
+                                : m_primitiveBounds.size();
+  return uint32_t(endPrimitive + 1);
+}
+
+void PrimitivePicker::select(int item)
+{
+  m_nodeIdx = -1;
+  m_primitiveIdx = -1;
+  if (item >= 0) {
+    // Last node whose primitives start at or before item
+    const auto it = std::upper_bound(
+        begin(m_firstPrimitives), end(m_firstPrimitives), size_t(item));
+    m_nodeIdx = int(it - begin(m_firstPrimitives)) - 1;
+    m_primitiveIdx = item - int(m_firstPrimitives[size_t(m_nodeIdx)]);
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ray_queries.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ray from the near to the far plane through cursor, in window pixels from
+// the bottom left of a viewport of its size
+Ray getCursorRay(const glm::vec2 &cursor, const glm::vec2 &viewportSize,
+    const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix);
+
+// Primitive under the cursor, and the point of its triangles hit. Its box
+// once vertices are released from the CPU (see RayQueries). Primitives are
+// numbered like the items of the scene BVH and the draws: those of node i of
+// the flat scene from firstPrimitives[i].
+class PrimitivePicker
+{
+public:
+  // Both are read by each pick, and can change between picks
+  PrimitivePicker(const std::vector<size_t> &firstPrimitives,
+      const std::vector<BoundingBox> &primitiveBounds);
+
+  // The primitive of the hit of a ray with the scene, none if it hit nothing
+  void pick(const RayHit &hit);
+
+  // The primitive of a draw ID read back by DrawIdPicker, its draw index + 1,
+  // none for 0. Its point is not known.
+  void pickDraw(uint32_t drawId);
+
+  // In the flat scene, -1 if none is picked
+  int nodeIdx() const { return m_nodeIdx; }
+
+  // In the mesh of the node
+  int primitiveIdx() const { return m_primitiveIdx; }
+
+  // -1 if its box was hit
+  int triangle() const { return m_triangle; }
+
+  const glm::vec3 &position() const { return m_position; }
+
+  // Of the previous pick, to measure the distance between both
+  bool hasPreviousPosition() const { return m_hasPreviousPosition; }
+  const glm::vec3 &previousPosition() const { return m_previousPosition; }
+
+  // Draw IDs [first, end) of the picked node, contiguous (see pickDraw)
+  uint32_t firstDrawId() const;
+  uint32_t endDrawId() const;
+
+private:
+  // Of the primitive numbered item, or none for -1
+  void select(int item);
+
+  const std::vector<size_t> &m_firstPrimitives;
+  const std::vector<BoundingBox> &m_primitiveBounds;
+
+  int m_nodeIdx = -1;
+  int m_primitiveIdx = -1;
+  int m_triangle = -1;
+  glm::vec3 m_position = glm::vec3(0);
+  bool m_hasPreviousPosition = false;
+  glm::vec3 m_previousPosition = glm::vec3(0);
+};
@@ -0,0 +1,136 @@
+#include "program_cache.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <system_error>
+
+namespace {
+
+const uint32_t programCacheMagic = 0x43505647; // "GVPC"
+const uint32_t programCacheVersion = 1;
+
+// FNV-1a, only used to name cache files
+uint64_t hashString(const std::string &string, uint64_t hash)
+{
+  for (const auto c : string) {
+    hash = (hash ^ uint8_t(c)) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+std::string getGLString(GLenum name)
+{
+  const auto *string = reinterpret_cast<const char *>(glGetString(name));
+  return string ? string : "";
+}
+
+} // namespace
+
+ProgramCache::ProgramCache(fs::path directory)
+{
+  GLint formatCount = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  if (formatCount > 0) {
+    m_directory = std::move(directory);
+  }
+  m_driver = getGLString(GL_VENDOR) + '\n' + getGLString(GL_RENDERER) + '\n' +
+             getGLString(GL_VERSION);
+}
+
+GLProgram ProgramCache::compileProgram(
+    const std::vector<fs::path> &shaderPaths, const std::string &defines) const
+{
+  return finishCompilingProgram(startCompilingProgram(shaderPaths, defines));
+}
+
+PendingProgram ProgramCache::startCompilingProgram(
+    const std::vector<fs::path> &shaderPaths, const std::string &defines) const
+{
+  if (m_directory.empty()) {
+    return ::startCompilingProgram(shaderPaths, defines);
+  }
+
+  auto hash = hashString(m_driver, 0xcbf29ce484222325ull);
+  hash = hashString(defines, hash);
+  for (const auto &path : shaderPaths) {
+    hash = hashString(path.filename().string(), hash);
+    hash = hashString(loadShaderSource(path), hash);
+  }
+  char fileName[32];
+  std::snprintf(fileName, sizeof(fileName), "%016llx.bin",
+      static_cast<unsigned long long>(hash));
+  const auto cachePath = m_directory / fileName;
+
+  // Magic, version, binary format, driver string length, then driver string
+  // and binary
+  {
+    std::ifstream input(cachePath.string(), std::ios::binary);
+    uint32_t header[4] = {};
+    if (input.read(reinterpret_cast<char *>(header), sizeof(header)) &&
+        header[0] == programCacheMagic && header[1] == programCacheVersion &&
+        header[3] == m_driver.size()) {
+      std::string driver(header[3], '\0');
+      input.read(&driver[0], std::streamsize(driver.size()));
+      const std::vector<char> binary(
+          (std::istreambuf_iterator<char>(input)),
+          std::istreambuf_iterator<char>());
+      if (input && driver == m_driver && !binary.empty()) {
+        PendingProgram pending;
+        if (pending.program.loadBinary(GLenum(header[2]), binary.data(),
+                GLsizei(binary.size()))) {
+          std::clog << "Loaded program binary " << cachePath << "\n";
+          return pending;
+        }
+      }
+    }
+  }
+
+  auto pending = ::startCompilingProgram(shaderPaths, defines, true);
+  pending.cachePath = cachePath;
+  return pending;
+}
+
+GLProgram ProgramCache::finishCompilingProgram(PendingProgram pending) const
+{
+  const auto cachePath = std::move(pending.cachePath);
+  auto program = ::finishCompilingProgram(std::move(pending));
+  if (cachePath.empty()) {
+    return program;
+  }
+  GLint length = 0;
+  glGetProgramiv(program.glId(), GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return program;
+  }
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program.glId(), length, &length, &format, binary.data());
+
+  // Written to a temporary file first, so that concurrent viewers never load
+  // a partial binary
+  std::error_code ec;
+  fs::create_directories(m_directory, ec);
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream output(tmpPath.string(), std::ios::binary);
+    const uint32_t header[4] = {programCacheMagic, programCacheVersion,
+        uint32_t(format), uint32_t(m_driver.size())};
+    output.write(reinterpret_cast<const char *>(header), sizeof(header));
+    output.write(m_driver.data(), std::streamsize(m_driver.size()));
+    output.write(binary.data(), length);
+    if (!output) {
+      std::cerr << "Warning : unable to write " << tmpPath << std::endl;
+      return program;
+    }
+  }
+  fs::rename(tmpPath, cachePath, ec);
+  if (ec) {
+    std::cerr << "Warning : unable to write " << cachePath << ": "
+              << ec.message() << std::endl;
+  }
+  return program;
+}
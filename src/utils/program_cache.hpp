@@ -0,0 +1,36 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "shaders.hpp"
+
+#include <string>
+#include <vector>
+
+// Binaries of linked programs (glGetProgramBinary) stored in a directory, one
+// file per program named after the hash of its shader sources and defines
+// and of the vendor, renderer and version of the OpenGL driver. A binary the driver
+// rejects, after an update for instance, is replaced by a fresh compilation.
+class ProgramCache
+{
+public:
+  // Programs are always compiled if directory is empty, or if the driver has
+  // no binary format. Must be created with a current OpenGL context.
+  explicit ProgramCache(fs::path directory);
+
+  // Same as ::compileProgram, loaded from the cache when possible
+  GLProgram compileProgram(const std::vector<fs::path> &shaderPaths,
+      const std::string &defines = {}) const;
+
+  // Same as ::startCompilingProgram, the pending program is linked already
+  // when loaded from the cache
+  PendingProgram startCompilingProgram(
+      const std::vector<fs::path> &shaderPaths,
+      const std::string &defines = {}) const;
+
+  // Same as ::finishCompilingProgram, then stores the binary of the program
+  GLProgram finishCompilingProgram(PendingProgram pending) const;
+
+private:
+  fs::path m_directory;
+  std::string m_driver;
+};
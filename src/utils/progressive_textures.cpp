@@ -0,0 +1,176 @@
+#include "progressive_textures.hpp"
+#include "gpu_memory.hpp"
+#include "loader_thread.hpp"
+#include "texture_streamer.hpp"
+#include "texture_uploader.hpp"
+
+#include <utility>
+
+namespace {
+
+// True if a texture would sample the image once created: the image is its
+// KHR_texture_basisu image, or its source without a created basisu image
+bool isImageSampled(const tinygltf::Model &model, int imageIdx,
+    const std::vector<GLuint> &imageTextures)
+{
+  for (const auto &texture : model.textures) {
+    const auto basisuSource = getBasisuImageSource(texture);
+    if (basisuSource == imageIdx ||
+        (texture.source == imageIdx &&
+            (basisuSource < 0 || !imageTextures[basisuSource]))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+ProgressiveTextures::ProgressiveTextures(tinygltf::Model &model,
+    GLTextures &imageTextures, std::vector<ImageUsage> imageUsages,
+    CreateTexture createTexture, bool releaseCpuData, bool srgb,
+    int maxTextureSize) :
+    m_model(model),
+    m_imageTextures(imageTextures),
+    m_imageUsages(std::move(imageUsages)),
+    m_createTexture(std::move(createTexture)),
+    m_releaseCpuData(releaseCpuData),
+    m_srgb(srgb),
+    m_maxTextureSize(maxTextureSize)
+{
+}
+
+void ProgressiveTextures::decodeImages(std::vector<RemoteRange> remoteImages)
+{
+  m_imageDecoder = std::make_unique<BackgroundImageDecoder>(
+      m_model, std::move(remoteImages));
+}
+
+void ProgressiveTextures::setLoaderThread(GLLoaderThread *loaderThread,
+    size_t pixelBufferCount, GpuMemoryTracker *gpuMemory)
+{
+  m_loaderThread = loaderThread;
+  m_pixelBufferCount = pixelBufferCount;
+  m_gpuMemory = gpuMemory;
+}
+
+void ProgressiveTextures::setUploadBudget(
+    size_t frameBytes, double frameSeconds)
+{
+  m_uploadScheduler =
+      std::make_unique<UploadScheduler>(frameBytes, frameSeconds);
+}
+
+bool ProgressiveTextures::createTexture(
+    int imageIdx, TextureUploader &uploader)
+{
+  if (scheduleTexture(imageIdx)) {
+    return false; // Released once transferred
+  }
+  m_imageTextures.reset(imageIdx,
+      m_createTexture(imageIdx, m_imageUsages[imageIdx], uploader));
+  releaseImage(imageIdx);
+  return m_imageTextures[imageIdx] != 0;
+}
+
+bool ProgressiveTextures::createDecodedTextures(TextureUploader &uploader)
+{
+  if (!m_imageDecoder) {
+    return false;
+  }
+  auto createdTextures = false;
+  const auto decodedImages = m_imageDecoder->popDecodedImages();
+  if (m_loaderThread) {
+    if (!decodedImages.empty()) {
+      addTextureJob(decodedImages);
+    }
+  } else {
+    for (const auto imageIdx : decodedImages) {
+      if (m_imageUsages[imageIdx].sampled &&
+          !m_model.images[imageIdx].image.empty() &&
+          !m_imageTextures[imageIdx] &&
+          isImageSampled(m_model, imageIdx, m_imageTextures.glIds())) {
+        createdTextures = createTexture(imageIdx, uploader) || createdTextures;
+      } else {
+        releaseImage(imageIdx);
+      }
+    }
+  }
+  if (m_imageDecoder->done()) {
+    m_imageDecoder = nullptr;
+  }
+  return createdTextures;
+}
+
+bool ProgressiveTextures::takePublishedTextures()
+{
+  return std::exchange(m_publishedTextures, false);
+}
+
+void ProgressiveTextures::setUploadPriority(int imageIdx, float priority)
+{
+  m_uploadScheduler->setPriority(imageIdx, priority);
+}
+
+size_t ProgressiveTextures::updateUploads(TextureUploader &uploader)
+{
+  const auto completedTextures = m_uploadScheduler->update(uploader);
+  for (const auto &completed : completedTextures) {
+    m_imageTextures.reset(completed.key, completed.texture);
+    releaseImage(completed.key);
+  }
+  return completedTextures.size();
+}
+
+bool ProgressiveTextures::scheduleTexture(int imageIdx)
+{
+  const auto &image = m_model.images[imageIdx];
+  if (!m_uploadScheduler || !UploadScheduler::canSplit(image) ||
+      (m_maxTextureSize > 0 &&
+          TextureStreamer::getStartLevel(
+              getTextureLevelSizes(image), m_maxTextureSize) > 0)) {
+    return false;
+  }
+  const auto &usage = m_imageUsages[imageIdx];
+  m_uploadScheduler->add(
+      imageIdx, image, usage.generateMipmaps, m_srgb && usage.color);
+  return true;
+}
+
+void ProgressiveTextures::addTextureJob(const std::vector<int> &decodedImages)
+{
+  m_loaderThread->add([this, decodedImages]() -> GLLoaderThread::Publish {
+    const GpuMemoryTracker::Scope memoryScope(m_gpuMemory);
+    TextureUploader uploader{m_pixelBufferCount};
+    std::vector<std::pair<int, GLuint>> createdTextureObjects;
+    for (const auto imageIdx : decodedImages) {
+      const auto &usage = m_imageUsages[imageIdx];
+      if (usage.sampled && !m_model.images[imageIdx].image.empty()) {
+        createdTextureObjects.emplace_back(
+            imageIdx, m_createTexture(imageIdx, usage, uploader));
+      }
+    }
+    return [this, decodedImages, createdTextureObjects]() {
+      for (const auto &created : createdTextureObjects) {
+        // Not if its textures sample their KHR_texture_basisu image
+        if (m_imageTextures[created.first] ||
+            !isImageSampled(m_model, created.first, m_imageTextures.glIds())) {
+          GLTextureTraits::destroy(1, &created.second);
+          continue;
+        }
+        m_imageTextures.reset(created.first, created.second);
+        m_publishedTextures = m_publishedTextures || created.second;
+      }
+      for (const auto imageIdx : decodedImages) {
+        releaseImage(imageIdx);
+      }
+    };
+  });
+}
+
+void ProgressiveTextures::releaseImage(int imageIdx)
+{
+  if (m_releaseCpuData) {
+    releaseImageData(m_model.images[imageIdx]);
+  }
+}
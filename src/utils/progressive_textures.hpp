@@ -0,0 +1,115 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "image_decoder.hpp"
+#include "upload_scheduler.hpp"
+
+#include <tiny_gltf.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class GLLoaderThread;
+class GpuMemoryTracker;
+class TextureUploader;
+
+// Textures of the images of a model created while it is drawn: images
+// decoded in background with --progressive, and images first sampled by the
+// materials of --lazy-resources. Their texture in imageTextures is created
+// whole on the GL thread, transferred over frames with --upload-budget, or
+// created on the loader thread of --loader-thread and published between
+// frames. Until then it is 0 and bindMaterial uses its fallback.
+class ProgressiveTextures
+{
+public:
+  // Texture of an image decoded to pixels, called on the loader thread with
+  // --loader-thread
+  using CreateTexture = std::function<GLuint(
+      int imageIdx, const ImageUsage &usage, TextureUploader &uploader)>;
+
+  // Textures of model replace the 0 entries of imageTextures. With
+  // releaseCpuData, the pixels of images are released once their texture is
+  // created. srgb and maxTextureSize are those of the textures created by
+  // createTexture, for the transfers over frames.
+  ProgressiveTextures(tinygltf::Model &model, GLTextures &imageTextures,
+      std::vector<ImageUsage> imageUsages, CreateTexture createTexture,
+      bool releaseCpuData, bool srgb, int maxTextureSize);
+
+  // Decode in background the images kept encoded by storeEncodedImage (see
+  // BackgroundImageDecoder)
+  void decodeImages(std::vector<RemoteRange> remoteImages);
+
+  // Create the textures of decoded images on loaderThread, which must be
+  // destroyed first, with pixelBufferCount pixel buffers, accounted for by
+  // gpuMemory
+  void setLoaderThread(GLLoaderThread *loaderThread, size_t pixelBufferCount,
+      GpuMemoryTracker *gpuMemory);
+
+  // Transfer textures within frameBytes and frameSeconds per updateUploads,
+  // not with a loader thread
+  void setUploadBudget(size_t frameBytes, double frameSeconds);
+
+  // Until every decoded image has its texture or is queued
+  bool isDecoding() const { return bool(m_imageDecoder); }
+
+  // nullptr without upload budget
+  const UploadScheduler *uploadScheduler() const
+  {
+    return m_uploadScheduler.get();
+  }
+
+  // Textures waiting for updateUploads
+  size_t queuedUploads() const
+  {
+    return m_uploadScheduler ? m_uploadScheduler->queueDepth() : 0;
+  }
+
+  // Queue the texture of an image decoded to pixels for updateUploads, or
+  // create it with uploader. Returns true if a texture was created.
+  bool createTexture(int imageIdx, TextureUploader &uploader);
+
+  // Create the textures of the images decoded since the previous call, or add
+  // a job creating them to the loader thread. Returns true if textures were
+  // created, never with the loader thread: they are created once its jobs are
+  // published (see takePublishedTextures).
+  bool createDecodedTextures(TextureUploader &uploader);
+
+  // True if jobs published by the loader thread since the previous call
+  // created textures
+  bool takePublishedTextures();
+
+  // Of the queued texture of an image for the next updateUploads, the screen
+  // size of the largest draw sampling it
+  void setUploadPriority(int imageIdx, float priority);
+
+  // Transfer the queued textures within the budget of a frame. Returns the
+  // number of textures completed.
+  size_t updateUploads(TextureUploader &uploader);
+
+private:
+  // Returns false if the texture of an image must be created whole: its file
+  // is left encoded, or it is downsampled
+  bool scheduleTexture(int imageIdx);
+
+  // On the loader thread
+  void addTextureJob(const std::vector<int> &decodedImages);
+
+  void releaseImage(int imageIdx);
+
+  tinygltf::Model &m_model;
+  GLTextures &m_imageTextures;
+  const std::vector<ImageUsage> m_imageUsages;
+  const CreateTexture m_createTexture;
+  const bool m_releaseCpuData;
+  const bool m_srgb;
+  const int m_maxTextureSize;
+
+  std::unique_ptr<BackgroundImageDecoder> m_imageDecoder;
+  std::unique_ptr<UploadScheduler> m_uploadScheduler;
+  GLLoaderThread *m_loaderThread = nullptr;
+  size_t m_pixelBufferCount = 0;
+  GpuMemoryTracker *m_gpuMemory = nullptr;
+  bool m_publishedTextures = false;
+};
@@ -0,0 +1,425 @@
+#include "ray_queries.hpp"
+#include "accessor_view.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RAY_QUERIES_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RAY_QUERIES_NEON
+#endif
+
+namespace {
+
+const size_t LANES = RayQueries::PACKET_SIZE;
+// Rays of a job of intersectParallel
+const size_t RAYS_PER_JOB = 64;
+
+// Rays of a packet in SIMD layout, one lane per ray. tMax shrinks to the
+// nearest hit found so far, unused lanes have a negative one.
+struct PacketRays
+{
+  alignas(16) float origin[3][LANES];
+  alignas(16) float invDirection[3][LANES];
+  alignas(16) float tMax[LANES];
+};
+
+// Slab test of the rays of the packet, returns the mask of those entering
+// box before their tMax, at distance tEnter
+unsigned intersectBox(
+    const BoundingBox &box, const PacketRays &rays, float *tEnter)
+{
+#if defined(RAY_QUERIES_SSE)
+  auto tNear = _mm_setzero_ps();
+  auto tFar = _mm_load_ps(rays.tMax);
+  for (auto axis = 0; axis < 3; ++axis) {
+    const auto origin = _mm_load_ps(rays.origin[axis]);
+    const auto invDirection = _mm_load_ps(rays.invDirection[axis]);
+    const auto t0 = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(box.min[axis]), origin), invDirection);
+    const auto t1 = _mm_mul_ps(
+        _mm_sub_ps(_mm_set1_ps(box.max[axis]), origin), invDirection);
+    tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+    tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+  }
+  _mm_store_ps(tEnter, tNear);
+  return unsigned(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)));
+#elif defined(RAY_QUERIES_NEON)
+  auto tNear = vdupq_n_f32(0.f);
+  auto tFar = vld1q_f32(rays.tMax);
+  for (auto axis = 0; axis < 3; ++axis) {
+    const auto origin = vld1q_f32(rays.origin[axis]);
+    const auto invDirection = vld1q_f32(rays.invDirection[axis]);
+    const auto t0 =
+        vmulq_f32(vsubq_f32(vdupq_n_f32(box.min[axis]), origin), invDirection);
+    const auto t1 =
+        vmulq_f32(vsubq_f32(vdupq_n_f32(box.max[axis]), origin), invDirection);
+    tNear = vmaxq_f32(tNear, vminq_f32(t0, t1));
+    tFar = vminq_f32(tFar, vmaxq_f32(t0, t1));
+  }
+  vst1q_f32(tEnter, tNear);
+  const auto hits = vcleq_f32(tNear, tFar);
+  return (vgetq_lane_u32(hits, 0) & 1u) | (vgetq_lane_u32(hits, 1) & 2u) |
+         (vgetq_lane_u32(hits, 2) & 4u) | (vgetq_lane_u32(hits, 3) & 8u);
+#else
+  unsigned mask = 0;
+  for (size_t lane = 0; lane < LANES; ++lane) {
+    auto tNear = 0.f;
+    auto tFar = rays.tMax[lane];
+    for (auto axis = 0; axis < 3; ++axis) {
+      const auto t0 = (box.min[axis] - rays.origin[axis][lane]) *
+                      rays.invDirection[axis][lane];
+      const auto t1 = (box.max[axis] - rays.origin[axis][lane]) *
+                      rays.invDirection[axis][lane];
+      tNear = std::max(tNear, std::min(t0, t1));
+      tFar = std::min(tFar, std::max(t0, t1));
+    }
+    tEnter[lane] = tNear;
+    mask |= tNear <= tFar ? 1u << lane : 0u;
+  }
+  return mask;
+#endif
+}
+
+void setLane(PacketRays &rays, size_t lane, const glm::vec3 &origin,
+    const glm::vec3 &direction, float tMax)
+{
+  for (auto axis = 0; axis < 3; ++axis) {
+    rays.origin[axis][lane] = origin[axis];
+    rays.invDirection[axis][lane] = 1.f / direction[axis];
+  }
+  rays.tMax[lane] = tMax;
+}
+
+// Nearest of the hit boxes of rays in mask, at tEnter, first
+float getNearestEntry(unsigned mask, const float *tEnter)
+{
+  auto t = std::numeric_limits<float>::infinity();
+  for (size_t lane = 0; lane < LANES; ++lane) {
+    if (mask & (1u << lane)) {
+      t = std::min(t, tEnter[lane]);
+    }
+  }
+  return t;
+}
+
+// Depth first traversal of the nodes of bvh the rays of mask enter, nearest
+// child first. leaf(node, mask) is called for the leaves, with the rays
+// entering them.
+template <typename Leaf>
+void traverse(const Bvh &bvh, const PacketRays &rays, unsigned mask, Leaf leaf)
+{
+  if (bvh.nodes.empty()) {
+    return;
+  }
+  float tEnter[LANES];
+  std::vector<int> stack = {0};
+  while (!stack.empty()) {
+    const auto &node = bvh.nodes[stack.back()];
+    stack.pop_back();
+    const auto nodeMask = intersectBox(node.bounds, rays, tEnter) & mask;
+    if (!nodeMask) {
+      continue;
+    }
+    if (node.itemCount) {
+      leaf(node, nodeMask);
+      continue;
+    }
+    const auto firstMask =
+        intersectBox(bvh.nodes[node.first].bounds, rays, tEnter) & mask;
+    const auto tFirst = getNearestEntry(firstMask, tEnter);
+    const auto secondMask =
+        intersectBox(bvh.nodes[node.first + 1].bounds, rays, tEnter) & mask;
+    const auto tSecond = getNearestEntry(secondMask, tEnter);
+    if (tFirst <= tSecond) {
+      stack.push_back(node.first + 1);
+      stack.push_back(node.first);
+    } else {
+      stack.push_back(node.first);
+      stack.push_back(node.first + 1);
+    }
+  }
+}
+
+// Moller-Trumbore test of both faces of triangle abc, true if the ray hits
+// it before tMax, at distance t
+bool intersectTriangle(const glm::vec3 &origin, const glm::vec3 &direction,
+    const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, float tMax,
+    float &t)
+{
+  const auto e1 = b - a;
+  const auto e2 = c - a;
+  const auto p = glm::cross(direction, e2);
+  const auto determinant = glm::dot(e1, p);
+  if (determinant == 0.f) {
+    return false;
+  }
+  const auto invDeterminant = 1.f / determinant;
+  const auto s = origin - a;
+  const auto u = glm::dot(s, p) * invDeterminant;
+  if (u < 0.f || u > 1.f) {
+    return false;
+  }
+  const auto q = glm::cross(s, e1);
+  const auto v = glm::dot(direction, q) * invDeterminant;
+  if (v < 0.f || u + v > 1.f) {
+    return false;
+  }
+  t = glm::dot(e2, q) * invDeterminant;
+  return t >= 0.f && t < tMax;
+}
+
+// Normal of the face of box nearest to point
+glm::vec3 getBoxNormal(const BoundingBox &box, const glm::vec3 &point)
+{
+  auto nearest = std::numeric_limits<float>::infinity();
+  glm::vec3 normal(0);
+  for (auto axis = 0; axis < 3; ++axis) {
+    for (const auto side : {-1.f, 1.f}) {
+      const auto plane = side < 0 ? box.min[axis] : box.max[axis];
+      const auto distance = std::abs(point[axis] - plane);
+      if (distance < nearest) {
+        nearest = distance;
+        normal = glm::vec3(0);
+        normal[axis] = side;
+      }
+    }
+  }
+  return normal;
+}
+
+} // namespace
+
+struct RayQueries::Primitive
+{
+  std::once_flag isBuilt;
+  std::atomic<bool> isReadable{false}; // Set once built
+  Bvh bvh; // Over the triangles
+  std::vector<glm::vec3> corners; // 3 per triangle, in mesh space
+};
+
+RayQueries::RayQueries(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes) :
+    m_model(model), m_bufferBytes(bufferBytes)
+{
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      m_gltfPrimitives.push_back(&primitive);
+    }
+  }
+  m_primitives = std::make_unique<Primitive[]>(m_gltfPrimitives.size());
+}
+
+RayQueries::~RayQueries() = default;
+
+const RayQueries::Primitive *RayQueries::getPrimitive(int primitiveIdx) const
+{
+  if (primitiveIdx < 0 || size_t(primitiveIdx) >= m_gltfPrimitives.size()) {
+    return nullptr;
+  }
+  auto &primitive = m_primitives[primitiveIdx];
+  std::call_once(primitive.isBuilt, [&]() {
+    const auto &gltfPrimitive = *m_gltfPrimitives[primitiveIdx];
+    const auto position = gltfPrimitive.attributes.find("POSITION");
+    if ((gltfPrimitive.mode != TINYGLTF_MODE_TRIANGLES &&
+            gltfPrimitive.mode != -1) ||
+        !gltfPrimitive.targets.empty() ||
+        position == end(gltfPrimitive.attributes) ||
+        !isAccessorInBuffer(
+            m_model, m_bufferBytes, m_model.accessors[position->second])) {
+      return;
+    }
+    std::vector<float> positions;
+    if (!readFloatAccessor(
+            m_model, m_bufferBytes, position->second, 3, positions)) {
+      return;
+    }
+    const auto vertexCount = positions.size() / 3;
+    std::vector<uint32_t> indices;
+    if (gltfPrimitive.indices >= 0) {
+      if (!readIndexAccessor(m_model, m_bufferBytes,
+              m_model.accessors[gltfPrimitive.indices], indices)) {
+        return;
+      }
+    } else {
+      indices.resize(vertexCount);
+      for (size_t i = 0; i < vertexCount; ++i) {
+        indices[i] = uint32_t(i);
+      }
+    }
+    const auto triangleCount = indices.size() / 3;
+    primitive.corners.resize(3 * triangleCount);
+    std::vector<BoundingBox> triangleBounds(triangleCount);
+    for (size_t i = 0; i < 3 * triangleCount; ++i) {
+      if (indices[i] >= vertexCount) {
+        primitive.corners.clear();
+        return;
+      }
+      const auto *p = &positions[3 * size_t(indices[i])];
+      primitive.corners[i] = glm::vec3(p[0], p[1], p[2]);
+      triangleBounds[i / 3].extend(primitive.corners[i]);
+    }
+    primitive.bvh = buildBvh(triangleBounds);
+    primitive.isReadable = true;
+  });
+  return primitive.isReadable ? &primitive : nullptr;
+}
+
+size_t RayQueries::builtPrimitiveCount() const
+{
+  size_t count = 0;
+  for (size_t i = 0; i < m_gltfPrimitives.size(); ++i) {
+    count += m_primitives[i].isReadable ? 1 : 0;
+  }
+  return count;
+}
+
+RayHit RayQueries::intersect(const Bvh &bvh,
+    const std::vector<BoundingBox> &itemBounds,
+    const std::vector<RayQueryItem> &items, const Ray &ray) const
+{
+  RayHit hit;
+  intersectPacket(bvh, itemBounds, items, &ray, &hit, 1);
+  return hit;
+}
+
+void RayQueries::intersect(const Bvh &bvh,
+    const std::vector<BoundingBox> &itemBounds,
+    const std::vector<RayQueryItem> &items, const Ray *rays, RayHit *hits,
+    size_t count) const
+{
+  for (size_t i = 0; i < count; i += LANES) {
+    intersectPacket(bvh, itemBounds, items, rays + i, hits + i,
+        std::min(LANES, count - i));
+  }
+}
+
+void RayQueries::intersectParallel(const Bvh &bvh,
+    const std::vector<BoundingBox> &itemBounds,
+    const std::vector<RayQueryItem> &items, const std::vector<Ray> &rays,
+    std::vector<RayHit> &hits) const
+{
+  hits.assign(rays.size(), RayHit());
+  const auto jobCount = (rays.size() + RAYS_PER_JOB - 1) / RAYS_PER_JOB;
+  parallelFor(jobCount, [&](size_t job) {
+    const auto first = job * RAYS_PER_JOB;
+    intersect(bvh, itemBounds, items, rays.data() + first, hits.data() + first,
+        std::min(RAYS_PER_JOB, rays.size() - first));
+  });
+}
+
+void RayQueries::intersectPacket(const Bvh &bvh,
+    const std::vector<BoundingBox> &itemBounds,
+    const std::vector<RayQueryItem> &items, const Ray *rays, RayHit *hits,
+    size_t count) const
+{
+  PacketRays packet;
+  for (size_t lane = 0; lane < LANES; ++lane) {
+    if (lane < count) {
+      setLane(packet, lane, rays[lane].origin, rays[lane].direction,
+          rays[lane].tMax);
+      hits[lane] = RayHit();
+    } else {
+      setLane(packet, lane, glm::vec3(0), glm::vec3(1), -1.f);
+    }
+  }
+  const auto activeLanes = (1u << count) - 1;
+
+  float tItem[LANES];
+  traverse(bvh, packet, activeLanes, [&](const Bvh::Node &node,
+                                          unsigned nodeMask) {
+    for (auto i = node.first; i < node.first + node.itemCount; ++i) {
+      const auto itemIdx = bvh.items[i];
+      const auto &bounds = itemBounds[itemIdx];
+      const auto itemMask = intersectBox(bounds, packet, tItem) & nodeMask;
+      if (!itemMask) {
+        continue;
+      }
+      const auto &item = items[itemIdx];
+      const auto *primitive = getPrimitive(item.primitive);
+      if (!primitive) {
+        for (size_t lane = 0; lane < count; ++lane) {
+          if (itemMask & (1u << lane)) {
+            const auto &ray = rays[lane];
+            auto &hit = hits[lane];
+            hit.item = itemIdx;
+            hit.triangle = -1;
+            hit.t = tItem[lane];
+            hit.position = ray.origin + hit.t * ray.direction;
+            hit.normal = getBoxNormal(bounds, hit.position);
+            if (glm::dot(hit.normal, ray.direction) > 0.f) {
+              hit.normal = -hit.normal;
+            }
+            packet.tMax[lane] = hit.t;
+          }
+        }
+        continue;
+      }
+
+      // Same rays in the space of the mesh, where t is the same
+      const auto meshFromWorld = glm::inverse(item.matrix);
+      PacketRays meshPacket;
+      glm::vec3 meshOrigins[LANES], meshDirections[LANES];
+      int hitTriangles[LANES];
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        hitTriangles[lane] = -1;
+        if (itemMask & (1u << lane)) {
+          meshOrigins[lane] =
+              glm::vec3(meshFromWorld * glm::vec4(rays[lane].origin, 1.f));
+          meshDirections[lane] =
+              glm::vec3(meshFromWorld * glm::vec4(rays[lane].direction, 0.f));
+          setLane(meshPacket, lane, meshOrigins[lane], meshDirections[lane],
+              packet.tMax[lane]);
+        } else {
+          setLane(meshPacket, lane, glm::vec3(0), glm::vec3(1), -1.f);
+        }
+      }
+      traverse(primitive->bvh, meshPacket, itemMask,
+          [&](const Bvh::Node &leaf, unsigned leafMask) {
+            for (auto j = leaf.first; j < leaf.first + leaf.itemCount; ++j) {
+              const auto triangle = primitive->bvh.items[j];
+              const auto *corners = &primitive->corners[3 * triangle];
+              for (size_t lane = 0; lane < count; ++lane) {
+                auto t = 0.f;
+                if ((leafMask & (1u << lane)) &&
+                    intersectTriangle(meshOrigins[lane], meshDirections[lane],
+                        corners[0], corners[1], corners[2],
+                        meshPacket.tMax[lane], t)) {
+                  meshPacket.tMax[lane] = t;
+                  hitTriangles[lane] = triangle;
+                }
+              }
+            }
+          });
+
+      // Normals go to world space with the inverse transpose
+      const auto normalMatrix = glm::transpose(glm::mat3(meshFromWorld));
+      for (size_t lane = 0; lane < count; ++lane) {
+        if (hitTriangles[lane] < 0) {
+          continue;
+        }
+        const auto &ray = rays[lane];
+        const auto *corners = &primitive->corners[3 * hitTriangles[lane]];
+        auto &hit = hits[lane];
+        hit.item = itemIdx;
+        hit.triangle = hitTriangles[lane];
+        hit.t = meshPacket.tMax[lane];
+        hit.position = ray.origin + hit.t * ray.direction;
+        hit.normal = glm::normalize(normalMatrix *
+                                    glm::cross(corners[1] - corners[0],
+                                        corners[2] - corners[0]));
+        if (glm::dot(hit.normal, ray.direction) > 0.f) {
+          hit.normal = -hit.normal;
+        }
+        packet.tMax[lane] = hit.t;
+      }
+    }
+  });
+}
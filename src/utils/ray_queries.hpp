@@ -0,0 +1,111 @@
+#pragma once
+
+#include "bvh.hpp"
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Points origin + t * direction for t in [0, tMax). Segments are rays whose
+// direction is their length, up to a tMax of 1 (see getSegmentRay).
+struct Ray
+{
+  glm::vec3 origin = glm::vec3(0);
+  glm::vec3 direction = glm::vec3(0, 0, -1);
+  float tMax = std::numeric_limits<float>::infinity();
+};
+
+inline Ray getSegmentRay(const glm::vec3 &from, const glm::vec3 &to)
+{
+  return Ray{from, to - from, 1.f};
+}
+
+struct RayHit
+{
+  int item = -1; // In the items of the scene, -1 if nothing is hit
+  int triangle = -1; // In the primitive of item, -1 if its box was hit
+  float t = std::numeric_limits<float>::infinity();
+  glm::vec3 position = glm::vec3(0); // World space
+  // World space normal of the triangle, facing the origin of the ray. Of the
+  // face of the box for box hits.
+  glm::vec3 normal = glm::vec3(0);
+};
+
+// What an item of the scene BVH draws: a primitive, numbered in the order of
+// model.meshes and their primitives (like DrawCommand::primitive), and the
+// matrix from the space of its mesh to world space
+struct RayQueryItem
+{
+  int primitive = -1; // Hit on its box only if -1
+  glm::mat4 matrix = glm::mat4(1);
+};
+
+// Ray and segment queries against the triangles of a scene, to measure
+// distances, snap to surfaces or keep cameras out of walls. The scene BVH is
+// traversed over the boxes of its items, then the triangles of the primitive
+// of each item reached, in a BVH of its own in the space of its mesh. A
+// triangle BVH is built by the first query reaching its primitive and kept
+// for the next ones, whatever the matrices of the items drawing it.
+//
+// Queries may run on any number of threads at once: building the BVH of a
+// primitive is done once, by the first thread needing it. Items set to a
+// primitive of -1 (say skinned ones), primitives with morph targets or other
+// modes than triangles, and those whose vertices are no longer in
+// bufferBytes (--release-cpu-data) are hit on their box.
+class RayQueries
+{
+public:
+  // Rays of a packet traverse the BVHs together, boxes are tested against
+  // all of them at once in SIMD registers (SSE on x86, NEON on ARM)
+  static const size_t PACKET_SIZE = 4;
+
+  // model and bufferBytes must outlive the queries
+  RayQueries(const tinygltf::Model &model,
+      const std::vector<BufferBytes> &bufferBytes);
+
+  ~RayQueries();
+
+  RayQueries(const RayQueries &) = delete;
+
+  RayQueries &operator=(const RayQueries &) = delete;
+
+  // Nearest hit of ray in the items of bvh, whose boxes are itemBounds
+  RayHit intersect(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+      const std::vector<RayQueryItem> &items, const Ray &ray) const;
+
+  // Same for rays [0, count) into hits, traversed by packets of PACKET_SIZE
+  // rays. Coherent rays, say of neighbouring pixels, visit the same nodes.
+  void intersect(const Bvh &bvh, const std::vector<BoundingBox> &itemBounds,
+      const std::vector<RayQueryItem> &items, const Ray *rays, RayHit *hits,
+      size_t count) const;
+
+  // Same, packets spread over the threads of the global JobSystem
+  void intersectParallel(const Bvh &bvh,
+      const std::vector<BoundingBox> &itemBounds,
+      const std::vector<RayQueryItem> &items, const std::vector<Ray> &rays,
+      std::vector<RayHit> &hits) const;
+
+  // Number of primitives whose triangle BVH is built
+  size_t builtPrimitiveCount() const;
+
+private:
+  struct Primitive;
+
+  // Triangles of a primitive, built on first call, null if not readable
+  const Primitive *getPrimitive(int primitiveIdx) const;
+
+  void intersectPacket(const Bvh &bvh,
+      const std::vector<BoundingBox> &itemBounds,
+      const std::vector<RayQueryItem> &items, const Ray *rays, RayHit *hits,
+      size_t count) const;
+
+  const tinygltf::Model &m_model;
+  const std::vector<BufferBytes> &m_bufferBytes;
+  std::vector<const tinygltf::Primitive *> m_gltfPrimitives;
+  std::unique_ptr<Primitive[]> m_primitives;
+};
@@ -0,0 +1,485 @@
+#include "remote_gltf.hpp"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef GLTF_VIEWER_USE_CURL
+#include <curl/curl.h>
+#endif
+
+namespace {
+
+// Requests fetching at the same time
+const size_t MAX_CONNECTIONS = 8;
+// Of the first request, holding the JSON of most files
+const size_t HEADER_FETCH_SIZE = 64 * 1024;
+// Views of a buffer closer than the gap are fetched by the same request, up
+// to the size. Longer views are split in several requests.
+const size_t RANGE_MERGE_GAP = 64 * 1024;
+const size_t MAX_RANGE_SIZE = 4 * 1024 * 1024;
+
+// Where the bytes of a buffer are fetched from and written to
+struct BufferSource
+{
+  std::string url;
+  size_t fileOffset = 0; // Of the buffer in the file at url
+  unsigned char *bytes = nullptr; // Null if it is not fetched
+  size_t size = 0;
+  size_t fetchedSize = 0; // Bytes already fetched with the JSON
+};
+
+// Bytes [offset, offset + size) of a buffer
+struct BufferRange
+{
+  size_t buffer;
+  size_t offset;
+  size_t size;
+};
+
+uint32_t readUint32(const std::vector<unsigned char> &bytes, size_t offset)
+{
+  uint32_t value;
+  std::memcpy(&value, bytes.data() + offset, sizeof(value));
+  return value;
+}
+
+void writeUint32(std::vector<unsigned char> &bytes, size_t offset,
+    uint32_t value)
+{
+  std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+const nlohmann::json &getArray(const nlohmann::json &object, const char *name)
+{
+  static const auto empty = nlohmann::json::array();
+  const auto it = object.find(name);
+  return it != object.end() && it->is_array() ? *it : empty;
+}
+
+size_t getSize(const nlohmann::json &object, const char *name)
+{
+  const auto it = object.find(name);
+  return it != object.end() && it->is_number_unsigned() ? it->get<size_t>()
+                                                        : 0;
+}
+
+int getIndex(const nlohmann::json &object, const char *name)
+{
+  const auto it = object.find(name);
+  return it != object.end() && it->is_number_unsigned() ? it->get<int>() : -1;
+}
+
+std::string getString(const nlohmann::json &object, const char *name)
+{
+  const auto it = object.find(name);
+  return it != object.end() && it->is_string() ? it->get<std::string>()
+                                               : std::string();
+}
+
+bool isFileUri(const std::string &uri)
+{
+  return !uri.empty() && uri.compare(0, 5, "data:") != 0;
+}
+
+// URL of uri, relative to the one of the glTF file
+std::string resolveUri(const std::string &gltfUrl, const std::string &uri)
+{
+  if (uri.find("://") != std::string::npos) {
+    return uri;
+  }
+  const auto path = gltfUrl.substr(0, gltfUrl.find_first_of("?#"));
+  if (uri[0] == '/') {
+    return path.substr(0, path.find('/', path.find("://") + 3)) + uri;
+  }
+  return path.substr(0, path.rfind('/') + 1) + uri;
+}
+
+// Append ranges to requests, the ones of a buffer merged when they are close
+void addRequests(
+    std::vector<BufferRange> ranges, std::vector<BufferRange> &requests)
+{
+  std::sort(begin(ranges), end(ranges),
+      [](const BufferRange &lhs, const BufferRange &rhs) {
+        return lhs.buffer != rhs.buffer ? lhs.buffer < rhs.buffer
+                                        : lhs.offset < rhs.offset;
+      });
+  std::vector<BufferRange> merged;
+  for (const auto &range : ranges) {
+    if (!merged.empty()) {
+      auto &last = merged.back();
+      const auto end = std::max(last.offset + last.size,
+          range.offset + range.size);
+      if (last.buffer == range.buffer &&
+          range.offset <= last.offset + last.size + RANGE_MERGE_GAP &&
+          end - last.offset <= MAX_RANGE_SIZE) {
+        last.size = end - last.offset;
+        continue;
+      }
+    }
+    merged.push_back(range);
+  }
+  for (const auto &range : merged) {
+    for (size_t offset = 0; offset < range.size; offset += MAX_RANGE_SIZE) {
+      requests.push_back({range.buffer, range.offset + offset,
+          std::min(MAX_RANGE_SIZE, range.size - offset)});
+    }
+  }
+}
+
+const std::vector<unsigned char> *findFile(
+    const std::string &path, void *userData)
+{
+  // tinygltf looks for uris as they are, then in "."
+  const auto uri = path.compare(0, 2, "./") == 0 ? path.substr(2) : path;
+  const auto &files = static_cast<const RemoteGltf *>(userData)->files;
+  const auto it = files.find(uri);
+  return it != end(files) ? &it->second : nullptr;
+}
+
+#ifdef GLTF_VIEWER_USE_CURL
+struct Transfer
+{
+  CURL *handle = nullptr;
+  std::string range; // Value of the Range header
+  std::vector<unsigned char> body;
+  char error[CURL_ERROR_SIZE] = {};
+};
+
+size_t writeBody(char *data, size_t size, size_t count, void *userData)
+{
+  auto &body = static_cast<Transfer *>(userData)->body;
+  body.insert(end(body), data, data + size * count);
+  return size * count;
+}
+
+// The bytes of range in the body of its transfer, or the reason of the
+// failure
+std::string getRangeBytes(const RemoteRange &range, Transfer &transfer,
+    CURLcode result, std::vector<unsigned char> &bytes)
+{
+  if (result != CURLE_OK) {
+    return transfer.error[0] ? transfer.error : curl_easy_strerror(result);
+  }
+  long status = 0;
+  curl_easy_getinfo(transfer.handle, CURLINFO_RESPONSE_CODE, &status);
+  if (status == 206 || (status == 200 && transfer.range.empty())) {
+    bytes.swap(transfer.body);
+  } else if (status == 200) {
+    // The whole file, the server ignored the Range header
+    const auto begin = std::min(range.offset, transfer.body.size());
+    const auto end = range.size ? std::min(begin + range.size,
+                                      transfer.body.size())
+                                : transfer.body.size();
+    bytes.assign(transfer.body.begin() + begin, transfer.body.begin() + end);
+  } else if (status != 416) {
+    // 416 for ranges after the end of the file, they have no bytes
+    return "HTTP status " + std::to_string(status);
+  }
+  return {};
+}
+#endif
+
+} // namespace
+
+bool isRemoteUrl(const std::string &path)
+{
+  return path.compare(0, 7, "http://") == 0 ||
+         path.compare(0, 8, "https://") == 0;
+}
+
+bool fetchRemoteRanges(const std::vector<RemoteRange> &ranges,
+    std::vector<std::vector<unsigned char>> &contents, std::string &err)
+{
+  contents.assign(ranges.size(), {});
+#ifndef GLTF_VIEWER_USE_CURL
+  if (!ranges.empty()) {
+    err = "the viewer is built without libcurl (GLTF_VIEWER_USE_CURL), " +
+          ranges.front().url + " cannot be fetched";
+    return false;
+  }
+  return true;
+#else
+  static const auto initResult = curl_global_init(CURL_GLOBAL_DEFAULT);
+  if (initResult != CURLE_OK) {
+    err = std::string("libcurl initialization failed: ") +
+          curl_easy_strerror(initResult);
+    return false;
+  }
+
+  auto *multi = curl_multi_init();
+  std::vector<Transfer> transfers(ranges.size());
+  size_t startedCount = 0;
+  size_t activeCount = 0;
+  const auto startTransfer = [&]() {
+    const auto &range = ranges[startedCount];
+    auto &transfer = transfers[startedCount++];
+    transfer.handle = curl_easy_init();
+    curl_easy_setopt(transfer.handle, CURLOPT_URL, range.url.c_str());
+    curl_easy_setopt(transfer.handle, CURLOPT_FOLLOWLOCATION, 1L);
+    // Transfers also run in the jobs of BackgroundImageDecoder
+    curl_easy_setopt(transfer.handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(transfer.handle, CURLOPT_WRITEFUNCTION, writeBody);
+    curl_easy_setopt(transfer.handle, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(transfer.handle, CURLOPT_PRIVATE, &transfer);
+    curl_easy_setopt(transfer.handle, CURLOPT_ERRORBUFFER, transfer.error);
+    if (range.offset || range.size) {
+      transfer.range = std::to_string(range.offset) + "-";
+      if (range.size) {
+        transfer.range += std::to_string(range.offset + range.size - 1);
+      }
+      curl_easy_setopt(transfer.handle, CURLOPT_RANGE, transfer.range.c_str());
+    }
+    curl_multi_add_handle(multi, transfer.handle);
+    ++activeCount;
+  };
+
+  while (startedCount < std::min(ranges.size(), MAX_CONNECTIONS)) {
+    startTransfer();
+  }
+  auto result = true;
+  while (activeCount) {
+    int runningCount = 0;
+    curl_multi_perform(multi, &runningCount);
+    int queuedCount = 0;
+    while (const auto *message = curl_multi_info_read(multi, &queuedCount)) {
+      if (message->msg != CURLMSG_DONE) {
+        continue;
+      }
+      char *privateData = nullptr;
+      curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &privateData);
+      auto &transfer = *reinterpret_cast<Transfer *>(privateData);
+      const auto i = size_t(&transfer - transfers.data());
+      const auto error = getRangeBytes(
+          ranges[i], transfer, message->data.result, contents[i]);
+      if (!error.empty()) {
+        err += "unable to fetch " + ranges[i].url + ": " + error + "\n";
+        result = false;
+      }
+      curl_multi_remove_handle(multi, transfer.handle);
+      curl_easy_cleanup(transfer.handle);
+      std::vector<unsigned char>().swap(transfer.body);
+      --activeCount;
+      // The next range in priority order, none once one failed
+      if (result && startedCount < ranges.size()) {
+        startTransfer();
+      }
+    }
+    if (activeCount) {
+      curl_multi_wait(multi, nullptr, 0, 100, nullptr);
+    }
+  }
+  curl_multi_cleanup(multi);
+  return result;
+#endif
+}
+
+tinygltf::FsCallbacks RemoteGltf::getFsCallbacks() const
+{
+  tinygltf::FsCallbacks callbacks;
+  callbacks.FileExists = [](const std::string &path, void *userData) {
+    return findFile(path, userData) != nullptr;
+  };
+  callbacks.ExpandFilePath = [](const std::string &path, void *) {
+    return path;
+  };
+  callbacks.ReadWholeFile = [](std::vector<unsigned char> *out,
+                                std::string *err, const std::string &path,
+                                void *userData) {
+    const auto *file = findFile(path, userData);
+    if (!file) {
+      if (err) {
+        *err = "not fetched";
+      }
+      return false;
+    }
+    *out = *file;
+    return true;
+  };
+  callbacks.WriteWholeFile = nullptr;
+  callbacks.user_data =
+      const_cast<void *>(static_cast<const void *>(this));
+  return callbacks;
+}
+
+bool fetchRemoteGltf(const std::string &url, bool deferImages,
+    RemoteGltf &gltf, std::string &err)
+{
+  // The JSON, and for a GLB with the headers of the file and its chunks
+  std::vector<std::vector<unsigned char>> contents;
+  if (!fetchRemoteRanges({{url, 0, HEADER_FETCH_SIZE}}, contents, err)) {
+    return false;
+  }
+  auto head = std::move(contents.front());
+  gltf.isBinary =
+      head.size() >= 20 && std::memcmp(head.data(), "glTF", 4) == 0;
+  size_t jsonOffset = 0;
+  size_t jsonSize = 0;
+  size_t binSize = 0;
+  auto headerSize = head.size(); // With the BIN chunk header for a GLB
+  if (gltf.isBinary) {
+    const size_t glbLength = readUint32(head, 8);
+    jsonOffset = 20;
+    jsonSize = readUint32(head, 12);
+    headerSize = std::min(size_t(glbLength), jsonOffset + jsonSize + 8);
+    if (headerSize < jsonOffset + jsonSize + 8) {
+      headerSize = jsonOffset + jsonSize; // No BIN chunk
+    }
+  }
+  if (head.size() == HEADER_FETCH_SIZE &&
+      (!gltf.isBinary || headerSize > head.size())) {
+    if (!fetchRemoteRanges({{url, head.size(),
+                               gltf.isBinary ? headerSize - head.size() : 0}},
+            contents, err)) {
+      return false;
+    }
+    head.insert(end(head), begin(contents.front()), end(contents.front()));
+  }
+  if (!gltf.isBinary) {
+    headerSize = jsonSize = head.size();
+  }
+  if (head.size() < headerSize) {
+    err = url + " is truncated";
+    return false;
+  }
+  if (gltf.isBinary && headerSize > jsonOffset + jsonSize) {
+    binSize = readUint32(head, jsonOffset + jsonSize);
+  }
+  const auto json =
+      nlohmann::json::parse(head.begin() + jsonOffset,
+          head.begin() + jsonOffset + jsonSize, nullptr, false);
+  if (json.is_discarded() || !json.is_object()) {
+    err = url + " is not a glTF file";
+    return false;
+  }
+
+  // The GLB rebuilt with the ranges of its BIN chunk, the JSON otherwise
+  gltf.document.assign(head.begin(), head.begin() + headerSize);
+  if (gltf.isBinary) {
+    gltf.document.resize(headerSize + binSize);
+    writeUint32(gltf.document, 8, uint32_t(gltf.document.size()));
+  }
+
+  const auto &buffers = getArray(json, "buffers");
+  std::vector<BufferSource> sources(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    const auto uri = getString(buffers[i], "uri");
+    auto &source = sources[i];
+    if (i == 0 && uri.empty() && gltf.isBinary) {
+      // Bytes of the BIN chunk in head are not fetched again
+      source.url = url;
+      source.fileOffset = headerSize;
+      source.bytes = gltf.document.data() + headerSize;
+      source.size = binSize;
+      source.fetchedSize = std::min(head.size() - headerSize, binSize);
+      std::copy_n(head.begin() + headerSize, source.fetchedSize, source.bytes);
+    } else if (isFileUri(uri)) {
+      // Its size is checked by tinygltf
+      auto &file = gltf.files[uri];
+      file.resize(getSize(buffers[i], "byteLength"));
+      source.url = resolveUri(url, uri);
+      source.bytes = file.data();
+      source.size = file.size();
+    }
+  }
+
+  const auto &bufferViews = getArray(json, "bufferViews");
+  const auto &images = getArray(json, "images");
+  std::vector<bool> isImageView(bufferViews.size(), false);
+  for (const auto &image : images) {
+    const auto bufferView = getIndex(image, "bufferView");
+    if (bufferView >= 0 && size_t(bufferView) < bufferViews.size()) {
+      isImageView[bufferView] = true;
+    }
+  }
+  // Bytes of buffer, byteOffset and byteLength of object, false if they are
+  // not in a fetched buffer
+  const auto getRange = [&](const nlohmann::json &object, BufferRange &range) {
+    const auto buffer = getIndex(object, "buffer");
+    range = {size_t(buffer), getSize(object, "byteOffset"),
+        getSize(object, "byteLength")};
+    return buffer >= 0 && range.buffer < sources.size() &&
+           sources[range.buffer].bytes && range.size &&
+           range.offset + range.size <= sources[range.buffer].size;
+  };
+  // Bytes of a view, or with EXT_meshopt_compression of its compressed data
+  // when it has no uncompressed bytes. False if they are not fetched, or
+  // already with the JSON.
+  const auto getViewRange = [&](int viewIdx, BufferRange &range) {
+    if (viewIdx < 0 || size_t(viewIdx) >= bufferViews.size()) {
+      return false;
+    }
+    const auto &bufferView = bufferViews[viewIdx];
+    const auto extensions = bufferView.find("extensions");
+    if (!getRange(bufferView, range) &&
+        (extensions == bufferView.end() || !extensions->is_object() ||
+            !extensions->count("EXT_meshopt_compression") ||
+            !getRange(extensions->at("EXT_meshopt_compression"), range))) {
+      return false;
+    }
+    return range.offset + range.size > sources[range.buffer].fetchedSize;
+  };
+
+  // Geometry, skins and animations first
+  std::vector<BufferRange> geometryRanges;
+  for (size_t i = 0; i < bufferViews.size(); ++i) {
+    BufferRange range;
+    if (!isImageView[i] && getViewRange(int(i), range)) {
+      geometryRanges.push_back(range);
+    }
+  }
+  if (deferImages) {
+    gltf.deferredImages.resize(images.size());
+  }
+  std::vector<BufferRange> imageRanges;
+  std::vector<std::string> imageFiles;
+  for (size_t i = 0; i < images.size(); ++i) {
+    const auto uri = getString(images[i], "uri");
+    BufferRange range;
+    if (isFileUri(uri) && deferImages) {
+      gltf.deferredImages[i] = {resolveUri(url, uri), 0, 0};
+      // A placeholder, tinygltf rejects empty files
+      gltf.files[uri].assign(1, 0);
+    } else if (isFileUri(uri)) {
+      imageFiles.push_back(uri);
+    } else if (getViewRange(getIndex(images[i], "bufferView"), range)) {
+      const auto &source = sources[range.buffer];
+      if (deferImages) {
+        gltf.deferredImages[i] = {
+            source.url, source.fileOffset + range.offset, range.size};
+      } else {
+        imageRanges.push_back(range);
+      }
+    }
+  }
+  std::vector<BufferRange> requests;
+  addRequests(geometryRanges, requests);
+  addRequests(imageRanges, requests);
+
+  std::vector<RemoteRange> ranges;
+  for (const auto &request : requests) {
+    const auto &source = sources[request.buffer];
+    ranges.push_back(
+        {source.url, source.fileOffset + request.offset, request.size});
+  }
+  for (const auto &uri : imageFiles) {
+    ranges.push_back({resolveUri(url, uri), 0, 0});
+  }
+  if (!fetchRemoteRanges(ranges, contents, err)) {
+    return false;
+  }
+  for (size_t i = 0; i < requests.size(); ++i) {
+    if (contents[i].size() != requests[i].size) {
+      err = ranges[i].url + " is truncated";
+      return false;
+    }
+    std::copy(begin(contents[i]), end(contents[i]),
+        sources[requests[i].buffer].bytes + requests[i].offset);
+  }
+  for (size_t i = 0; i < imageFiles.size(); ++i) {
+    gltf.files[imageFiles[i]] = std::move(contents[requests.size() + i]);
+  }
+  return true;
+}
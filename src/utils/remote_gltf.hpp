@@ -0,0 +1,60 @@
+#pragma once
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// True for the http:// and https:// URLs, loaded with fetchRemoteGltf
+bool isRemoteUrl(const std::string &path);
+
+// Bytes [offset, offset + size) of the file at url, size 0 for all the bytes
+// from offset
+struct RemoteRange
+{
+  std::string url;
+  size_t offset = 0;
+  size_t size = 0;
+};
+
+// Fetch the ranges with HTTP range requests, up to 8 at a time and started in
+// their order, so the first ones arrive first. contents[i] receives the bytes
+// of ranges[i], fewer at the end of the file. Servers ignoring the Range
+// header send whole files, the ranges are cut from them.
+//
+// Needs the viewer to be built with libcurl (GLTF_VIEWER_USE_CURL). Returns
+// false if one of the ranges cannot be fetched, with the reasons in err.
+bool fetchRemoteRanges(const std::vector<RemoteRange> &ranges,
+    std::vector<std::vector<unsigned char>> &contents, std::string &err);
+
+// A remote glTF file, with the parts of its buffers and images it uses
+struct RemoteGltf
+{
+  bool isBinary = false;
+  // The JSON, or the GLB container whose BIN chunk holds the fetched ranges
+  std::vector<unsigned char> document;
+  // Bytes of the external buffers and images, by uri
+  std::map<std::string, std::vector<unsigned char>> files;
+  // Where to fetch the encoded bytes of each model.images[i] from, when they
+  // are deferred (see fetchRemoteGltf). An empty url for the others.
+  std::vector<RemoteRange> deferredImages;
+
+  // Callbacks serving files to tinygltf::TinyGLTF, this must outlive its
+  // parsing of document
+  tinygltf::FsCallbacks getFsCallbacks() const;
+};
+
+// Fetch the glTF or GLB file at url: its first 64 KiB, holding the JSON of
+// most files, and the rest of the JSON if needed. Then the byte ranges of
+// the buffer views, close ones merged into a request, in parallel and in
+// priority order: views of the geometry and animations first, then the
+// images. Bytes of the buffers no view references are never fetched.
+//
+// With deferImages, images are not fetched: deferredImages holds their
+// ranges, and the encoded images parsed from the file are placeholders until
+// BackgroundImageDecoder fetches them. Returns false if the file cannot be
+// fetched, with the reason in err.
+bool fetchRemoteGltf(const std::string &url, bool deferImages,
+    RemoteGltf &gltf, std::string &err);
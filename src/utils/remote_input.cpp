@@ -0,0 +1,176 @@
+#include "remote_input.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Period at which the thread of RemoteInput checks whether to stop
+const int POLL_TIMEOUT_MS = 100;
+
+// Longest line read, longer ones are dropped
+const size_t MAX_LINE_LENGTH = 256;
+
+} // namespace
+
+#ifdef _WIN32
+
+RemoteInput::RemoteInput(uint16_t)
+{
+  throw std::runtime_error("Remote input is only available on POSIX systems");
+}
+
+RemoteInput::~RemoteInput() = default;
+
+void RemoteInput::serve() {}
+
+#else
+
+RemoteInput::RemoteInput(uint16_t port)
+{
+  m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  if (m_listenSocket < 0) {
+    throw std::runtime_error("Unable to create a socket for remote input");
+  }
+  const int reuse = 1;
+  setsockopt(
+      m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (bind(m_listenSocket, reinterpret_cast<const sockaddr *>(&address),
+          sizeof(address)) < 0 ||
+      listen(m_listenSocket, 1) < 0) {
+    close(m_listenSocket);
+    throw std::runtime_error(
+        "Unable to listen for remote input on port " + std::to_string(port));
+  }
+  m_thread = std::thread([this]() { serve(); });
+}
+
+RemoteInput::~RemoteInput()
+{
+  m_stop = true;
+  m_thread.join();
+  close(m_listenSocket);
+}
+
+void RemoteInput::serve()
+{
+  while (!m_stop) {
+    pollfd listening{m_listenSocket, POLLIN, 0};
+    if (poll(&listening, 1, POLL_TIMEOUT_MS) <= 0) {
+      continue;
+    }
+    const auto client = accept(m_listenSocket, nullptr, nullptr);
+    if (client < 0) {
+      continue;
+    }
+    std::string line;
+    char bytes[512];
+    while (!m_stop) {
+      pollfd reading{client, POLLIN, 0};
+      const auto ready = poll(&reading, 1, POLL_TIMEOUT_MS);
+      if (ready == 0) {
+        continue;
+      }
+      const auto count =
+          ready > 0 ? recv(client, bytes, sizeof(bytes), 0) : ssize_t(-1);
+      if (count <= 0) {
+        break; // Disconnected
+      }
+      for (ssize_t i = 0; i < count; ++i) {
+        if (bytes[i] != '\n') {
+          if (line.size() <= MAX_LINE_LENGTH) {
+            line.push_back(bytes[i]);
+          }
+          continue;
+        }
+        if (line.size() <= MAX_LINE_LENGTH) {
+          apply(line.c_str());
+        }
+        line.clear();
+      }
+    }
+    close(client);
+    // Nothing stays pressed once the client is gone
+    const std::lock_guard<std::mutex> lock(m_mutex);
+    m_buttons.clear();
+    m_keys.clear();
+    m_hasCursor = false;
+    m_hasChanges = true;
+  }
+}
+
+#endif
+
+bool RemoteInput::apply(const char *line)
+{
+  char command[16] = {};
+  double x = 0., y = 0.;
+  int code = 0, pressed = 0;
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  if (std::sscanf(line, "%15s", command) != 1) {
+    return false;
+  }
+  if (!std::strcmp(command, "cursor")) {
+    if (std::sscanf(line, "%*s %lf %lf", &x, &y) != 2) {
+      return false;
+    }
+    m_cursor = glm::dvec2(x, y);
+    m_hasCursor = true;
+  } else if (!std::strcmp(command, "button") ||
+             !std::strcmp(command, "key")) {
+    if (std::sscanf(line, "%*s %d %d", &code, &pressed) != 2) {
+      return false;
+    }
+    auto &pressedCodes = command[0] == 'b' ? m_buttons : m_keys;
+    if (pressed) {
+      pressedCodes.insert(code);
+    } else {
+      pressedCodes.erase(code);
+    }
+  } else {
+    return false;
+  }
+  m_hasChanges = true;
+  return true;
+}
+
+bool RemoteInput::isMouseButtonPressed(int button) const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_buttons.count(button) != 0;
+}
+
+bool RemoteInput::isKeyPressed(int key) const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  return m_keys.count(key) != 0;
+}
+
+bool RemoteInput::getCursorPos(glm::dvec2 &position) const
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  position = m_cursor;
+  return m_hasCursor;
+}
+
+bool RemoteInput::takeChanges()
+{
+  const std::lock_guard<std::mutex> lock(m_mutex);
+  const auto hasChanges = m_hasChanges;
+  m_hasChanges = false;
+  return hasChanges;
+}
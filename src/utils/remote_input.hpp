@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+
+// Input of the thin client of --stream, sent over TCP to a port of the
+// viewer as lines of text:
+//   cursor <x> <y>           position in window pixels, top left origin
+//   button <button> <0|1>    GLFW_MOUSE_BUTTON_* released or pressed
+//   key <key> <0|1>          GLFW_KEY_* released or pressed
+// One client is served at a time, its lines are read on a thread of their
+// own. The camera controllers read the state they describe like the one of
+// the window (see CameraController::setRemoteInput), so that a remote drag
+// moves the camera like a local one. Malformed lines are ignored, the state
+// is reset when the client disconnects.
+class RemoteInput
+{
+public:
+  // Listen on port of all interfaces. Throws std::runtime_error if the port
+  // can not be listened on.
+  explicit RemoteInput(uint16_t port);
+
+  ~RemoteInput();
+
+  RemoteInput(const RemoteInput &) = delete;
+
+  RemoteInput &operator=(const RemoteInput &) = delete;
+
+  bool isMouseButtonPressed(int button) const;
+
+  bool isKeyPressed(int key) const;
+
+  // False if the client sent no cursor since it connected
+  bool getCursorPos(glm::dvec2 &position) const;
+
+  // True if lines changed the state since the last call, to draw a frame
+  bool takeChanges();
+
+private:
+  // Accept clients and read their lines until m_stop
+  void serve();
+
+  // Apply a line, returns false if it is malformed
+  bool apply(const char *line);
+
+  int m_listenSocket = -1;
+  std::atomic<bool> m_stop{false};
+  std::thread m_thread;
+
+  mutable std::mutex m_mutex;
+  std::set<int> m_buttons; // Pressed
+  std::set<int> m_keys;
+  glm::dvec2 m_cursor = glm::dvec2(0);
+  bool m_hasCursor = false;
+  bool m_hasChanges = false;
+};
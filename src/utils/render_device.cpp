@@ -0,0 +1,103 @@
+#include "render_device.hpp"
+#include "gpu_memory.hpp"
+
+namespace {
+
+// GL_POINTS to GL_TRIANGLE_FAN are 0 to 6, as the topologies
+GLenum getMode(PrimitiveTopology topology) { return GLenum(topology); }
+
+GLenum getIndexGLType(IndexType type)
+{
+  switch (type) {
+  case IndexType::UInt8:
+    return GL_UNSIGNED_BYTE;
+  case IndexType::UInt16:
+    return GL_UNSIGNED_SHORT;
+  case IndexType::UInt32:
+    return GL_UNSIGNED_INT;
+  case IndexType::None:
+    break;
+  }
+  return 0;
+}
+
+} // namespace
+
+BufferHandle GLRenderDevice::createBuffer(const BufferDesc &desc)
+{
+  // GL buffers have no usage: bound to the copy target, not to change the
+  // index buffer of the vertex array bound
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, GLsizeiptr(desc.size), desc.data,
+      desc.dynamic ? GL_DYNAMIC_STORAGE_BIT : 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return BufferHandle{buffer};
+}
+
+void GLRenderDevice::updateBuffer(
+    BufferHandle buffer, size_t offset, size_t size, const void *data)
+{
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.id);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(offset), GLsizeiptr(size),
+      data);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void GLRenderDevice::destroyBuffer(BufferHandle buffer)
+{
+  untrackBuffers(1, &buffer.id);
+  glDeleteBuffers(1, &buffer.id);
+}
+
+void GLRenderDevice::setVertexInput(VertexInputHandle vertexInput)
+{
+  glBindVertexArray(vertexInput.id);
+}
+
+void GLRenderDevice::draw(const DrawItem &item)
+{
+  const auto mode = getMode(item.topology);
+  const auto count = GLsizei(item.count);
+  const auto instanceCount = GLsizei(item.instanceCount);
+  if (item.indexType == IndexType::None) {
+    glDrawArraysInstancedBaseInstance(
+        mode, 0, count, instanceCount, item.baseInstance);
+  } else if (item.baseVertex) {
+    glDrawElementsInstancedBaseVertexBaseInstance(mode, count,
+        getIndexGLType(item.indexType), (const GLvoid *)item.indexByteOffset,
+        instanceCount, item.baseVertex, item.baseInstance);
+  } else {
+    glDrawElementsInstancedBaseInstance(mode, count,
+        getIndexGLType(item.indexType), (const GLvoid *)item.indexByteOffset,
+        instanceCount, item.baseInstance);
+  }
+}
+
+void GLRenderDevice::drawIndirect(const IndirectDrawItem &item)
+{
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, item.commands.id);
+  glMultiDrawElementsIndirect(getMode(item.topology),
+      getIndexGLType(item.indexType), (const GLvoid *)item.byteOffset,
+      GLsizei(item.drawCount), 0);
+}
+
+PrimitiveTopology GLRenderDevice::getTopology(GLenum mode)
+{
+  return mode <= GL_TRIANGLE_FAN ? PrimitiveTopology(mode)
+                                 : PrimitiveTopology::Triangles;
+}
+
+IndexType GLRenderDevice::getIndexType(GLenum type)
+{
+  switch (type) {
+  case GL_UNSIGNED_BYTE:
+    return IndexType::UInt8;
+  case GL_UNSIGNED_SHORT:
+    return IndexType::UInt16;
+  case GL_UNSIGNED_INT:
+    return IndexType::UInt32;
+  }
+  return IndexType::None;
+}
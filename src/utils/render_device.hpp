@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+
+// Buffers and draws of the scene behind an interface without GL names nor
+// enums, so that passes record what they draw and a backend (only OpenGL for
+// now, GLRenderDevice) issues the calls. Vertex layouts, textures, programs
+// and render states are still set with GL calls by the viewer.
+
+// Same order as the modes of glTF primitives
+enum class PrimitiveTopology : uint8_t
+{
+  Points,
+  Lines,
+  LineLoop,
+  LineStrip,
+  Triangles,
+  TriangleStrip,
+  TriangleFan
+};
+
+enum class IndexType : uint8_t
+{
+  None, // Vertices drawn in order
+  UInt8,
+  UInt16,
+  UInt32
+};
+
+enum class BufferUsage : uint8_t
+{
+  Vertex,
+  Index,
+  Indirect, // Commands of drawIndirect
+  Uniform,
+  Storage
+};
+
+// 0 is no object
+struct BufferHandle
+{
+  uint32_t id = 0;
+};
+
+// Vertex buffers and their layout, with the index buffer
+struct VertexInputHandle
+{
+  uint32_t id = 0;
+};
+
+struct BufferDesc
+{
+  BufferUsage usage = BufferUsage::Vertex;
+  size_t size = 0;
+  const void *data = nullptr; // Initial contents, or nullptr
+  bool dynamic = false; // Else never written after creation
+};
+
+// instanceCount instances of count vertices, or indices at indexByteOffset
+// in the index buffer of the vertex input, the first instance being
+// baseInstance
+struct DrawItem
+{
+  PrimitiveTopology topology = PrimitiveTopology::Triangles;
+  IndexType indexType = IndexType::None;
+  uint32_t count = 0;
+  size_t indexByteOffset = 0;
+  int32_t baseVertex = 0; // Added to indices
+  uint32_t instanceCount = 1;
+  uint32_t baseInstance = 0;
+};
+
+// drawCount indexed draws whose parameters are DrawElementsIndirectCommand
+// entries of commands, from byteOffset
+struct IndirectDrawItem
+{
+  PrimitiveTopology topology = PrimitiveTopology::Triangles;
+  IndexType indexType = IndexType::UInt32;
+  BufferHandle commands;
+  size_t byteOffset = 0;
+  uint32_t drawCount = 0;
+};
+
+class RenderDevice
+{
+public:
+  virtual ~RenderDevice() = default;
+
+  virtual BufferHandle createBuffer(const BufferDesc &desc) = 0;
+
+  // Only for dynamic buffers
+  virtual void updateBuffer(
+      BufferHandle buffer, size_t offset, size_t size, const void *data) = 0;
+
+  virtual void destroyBuffer(BufferHandle buffer) = 0;
+
+  // Of the next draws
+  virtual void setVertexInput(VertexInputHandle vertexInput) = 0;
+
+  virtual void draw(const DrawItem &item) = 0;
+
+  virtual void drawIndirect(const IndirectDrawItem &item) = 0;
+};
+
+// Handles are the names of GL objects: buffers and vertex arrays created with
+// GL calls can be drawn with, and buffers of the device owned by GLBuffer.
+// Buffers are created with glBufferStorage and accounted for by their
+// creator with trackBuffers, like the others.
+class GLRenderDevice : public RenderDevice
+{
+public:
+  BufferHandle createBuffer(const BufferDesc &desc) override;
+
+  void updateBuffer(BufferHandle buffer, size_t offset, size_t size,
+      const void *data) override;
+
+  void destroyBuffer(BufferHandle buffer) override;
+
+  void setVertexInput(VertexInputHandle vertexInput) override;
+
+  void draw(const DrawItem &item) override;
+
+  void drawIndirect(const IndirectDrawItem &item) override;
+
+  static BufferHandle buffer(GLuint glId) { return BufferHandle{glId}; }
+
+  static VertexInputHandle vertexInput(GLuint vertexArray)
+  {
+    return VertexInputHandle{vertexArray};
+  }
+
+  // mode of glDraw* and type of glDrawElements*, 0 for no indices
+  static PrimitiveTopology getTopology(GLenum mode);
+  static IndexType getIndexType(GLenum type);
+};
@@ -0,0 +1,42 @@
+#include "render_queue.hpp"
+
+#include <glm/gtc/matrix_access.hpp>
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+
+std::vector<size_t> getDrawOrder(const std::vector<DrawCommand> &commands)
+{
+  std::vector<size_t> order(commands.size());
+  std::iota(begin(order), end(order), size_t(0));
+  std::stable_sort(begin(order), end(order), [&](size_t a, size_t b) {
+    const auto &lhs = commands[a];
+    const auto &rhs = commands[b];
+    return std::tie(lhs.material, lhs.vertexArray, lhs.node) <
+           std::tie(rhs.material, rhs.vertexArray, rhs.node);
+  });
+  return order;
+}
+
+void sortBackToFront(std::vector<GLuint> &draws,
+    const std::vector<BoundingBox> &bounds, const glm::mat4 &viewMatrix)
+{
+  // View space z of the centers, more negative farther
+  std::vector<std::pair<float, GLuint>> depths;
+  depths.reserve(draws.size());
+  const auto viewZ = glm::vec3(glm::row(viewMatrix, 2));
+  for (const auto drawIdx : draws) {
+    const auto &box = bounds[drawIdx];
+    depths.emplace_back(
+        glm::dot(viewZ, 0.5f * (box.min + box.max)) + viewMatrix[3][2],
+        drawIdx);
+  }
+  std::stable_sort(begin(depths), end(depths),
+      [](const std::pair<float, GLuint> &a, const std::pair<float, GLuint> &b) {
+        return a.first < b.first;
+      });
+  for (size_t i = 0; i < draws.size(); ++i) {
+    draws[i] = depths[i].second;
+  }
+}
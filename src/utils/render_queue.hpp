@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bounds.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Everything needed to draw one primitive of a node of a FlatScene, resolved
+// once at load time instead of looking up accessors for every draw
+struct DrawCommand
+{
+  int node; // In the FlatScene
+  int material; // In model.materials, -1 for the default material
+  int primitive; // Index of the primitive in vertexArrayObjects
+  GLuint vertexArray;
+  GLenum mode;
+  GLsizei count; // Of indices, or of vertices for non indexed primitives
+  GLenum indexType; // 0 for non indexed primitives (glDrawArrays)
+  size_t indexByteOffset;
+  // Vertices referenced by the command, for glDrawRangeElements, empty
+  // (minIndex > maxIndex) if unknown. See RuntimePrimitive.
+  GLuint minIndex;
+  GLuint maxIndex;
+};
+
+// Layout of the commands of glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Order in which to submit commands so that consecutive draws share as much
+// state as possible: sorted by material, then vertex array, then node. All
+// draws use the same program, so it is not part of the key.
+std::vector<size_t> getDrawOrder(const std::vector<DrawCommand> &commands);
+
+// glTF alphaMode of the material of a draw. With --sorted-transparency,
+// opaque draws are submitted first, then cutouts, then blended draws.
+enum class AlphaMode
+{
+  Opaque,
+  Mask,
+  Blend
+};
+
+// Sort draws, indices in bounds (world space boxes), from the farthest to the
+// nearest center of their box along the view of viewMatrix, so that blended
+// draws cover those behind them. Draws at the same depth keep their order.
+void sortBackToFront(std::vector<GLuint> &draws,
+    const std::vector<BoundingBox> &bounds, const glm::mat4 &viewMatrix);
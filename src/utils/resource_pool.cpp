@@ -0,0 +1,68 @@
+#include "resource_pool.hpp"
+
+#include <set>
+#include <vector>
+
+GLuint GLResourcePool::acquireTexture(GLsizei levelCount,
+    GLenum internalFormat, GLsizei width, GLsizei height)
+{
+  const auto it = m_textures.find(
+      TextureFormat{levelCount, internalFormat, width, height});
+  if (it != m_textures.end()) {
+    const auto texture = it->second;
+    m_pooledBytes -= texture.byteSize;
+    m_textures.erase(it);
+    return texture.glId;
+  }
+
+  GLuint texture = 0;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, width, height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return texture;
+}
+
+void GLResourcePool::releaseTextures(GLTextures textures)
+{
+  const auto glIds = textures.release();
+  std::vector<GLuint> mutableTextures;
+  for (const auto texture : std::set<GLuint>(glIds.begin(), glIds.end())) {
+    if (!texture) {
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLint immutable = GL_FALSE;
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_FORMAT, &immutable);
+    if (!immutable) {
+      mutableTextures.push_back(texture);
+      continue;
+    }
+    GLint levelCount = 0, internalFormat = 0, width = 0, height = 0;
+    glGetTexParameteriv(
+        GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+    glGetTexLevelParameteriv(
+        GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    const auto byteSize = getTextureByteSize(GL_TEXTURE_2D, texture);
+    trackTextures(GpuMemoryCategory::Pooled, GL_TEXTURE_2D, 1, &texture);
+    m_textures.emplace(TextureFormat{GLsizei(levelCount),
+                           GLenum(internalFormat), GLsizei(width),
+                           GLsizei(height)},
+        PooledObject{texture, byteSize});
+    m_pooledBytes += byteSize;
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  GLTextureTraits::destroy(
+      GLsizei(mutableTextures.size()), mutableTextures.data());
+}
+
+void GLResourcePool::clear()
+{
+  for (const auto &texture : m_textures) {
+    GLTextureTraits::destroy(1, &texture.second.glId);
+  }
+  m_textures.clear();
+  m_pooledBytes = 0;
+}
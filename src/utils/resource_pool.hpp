@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gl_objects.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <tuple>
+
+// Textures a scene no longer draws, kept to be reused by the next one instead
+// of freeing and allocating GPU memory again when switching models (buffers
+// are reused through GLBufferHeap). Immutable 2D textures are pooled by their
+// exact format, levels and size. Textures handed out keep the content of
+// their previous use. Pooled textures are accounted as GpuMemoryCategory::
+// Pooled by the current GpuMemoryTracker.
+//
+// Not thread safe: textures are reused by the context they were released
+// from. It must still be current when the pool is destroyed.
+class GLResourcePool
+{
+public:
+  GLResourcePool() = default;
+
+  ~GLResourcePool() { clear(); }
+
+  GLResourcePool(const GLResourcePool &) = delete;
+
+  GLResourcePool &operator=(const GLResourcePool &) = delete;
+
+  // A pooled texture of these levels, format and size, or a new immutable
+  // one. Leaves GL_TEXTURE_2D bound to 0.
+  GLuint acquireTexture(GLsizei levelCount, GLenum internalFormat,
+      GLsizei width, GLsizei height);
+
+  // Keep the GL_TEXTURE_2D textures for acquireTexture, mutable ones are
+  // deleted. Names of other targets must not be given.
+  void releaseTextures(GLTextures textures);
+
+  // Delete the pooled objects
+  void clear();
+
+  size_t pooledBytes() const { return m_pooledBytes; }
+
+private:
+  // Levels, internal format, width and height
+  using TextureFormat = std::tuple<GLsizei, GLenum, GLsizei, GLsizei>;
+
+  struct PooledObject
+  {
+    GLuint glId = 0;
+    size_t byteSize = 0;
+  };
+
+  std::multimap<TextureFormat, PooledObject> m_textures;
+  size_t m_pooledBytes = 0;
+};
@@ -0,0 +1,191 @@
+#include "runtime_scene.hpp"
+
+#include <cmath>
+
+namespace {
+
+// Offset, rotation and scale of KHR_texture_transform, applied in this order
+// to texture coordinates, or identity
+glm::mat3x2 getUvTransform(const tinygltf::ExtensionMap &extensions)
+{
+  const auto it = extensions.find("KHR_texture_transform");
+  if (it == end(extensions) || !it->second.IsObject()) {
+    return glm::mat3x2(1);
+  }
+  const auto getVec2 = [&](const char *key, glm::vec2 value) {
+    const auto &array = it->second.Get(key);
+    if (array.IsArray() && array.ArrayLen() == 2 && array.Get(0).IsNumber() &&
+        array.Get(1).IsNumber()) {
+      value = glm::vec2(float(array.Get(0).GetNumberAsDouble()),
+          float(array.Get(1).GetNumberAsDouble()));
+    }
+    return value;
+  };
+  const auto offset = getVec2("offset", glm::vec2(0));
+  const auto scale = getVec2("scale", glm::vec2(1));
+  const auto &rotationValue = it->second.Get("rotation");
+  const auto rotation = rotationValue.IsNumber()
+                            ? float(rotationValue.GetNumberAsDouble())
+                            : 0.f;
+  const auto c = std::cos(rotation);
+  const auto s = std::sin(rotation);
+  return glm::mat3x2(glm::vec2(c * scale.x, -s * scale.x),
+      glm::vec2(s * scale.y, c * scale.y), offset);
+}
+
+RuntimeMaterial getRuntimeMaterial(const tinygltf::Material &material)
+{
+  const auto &pbrMetallicRoughness = material.pbrMetallicRoughness;
+  RuntimeMaterial result;
+  result.baseColorFactor =
+      glm::vec4(float(pbrMetallicRoughness.baseColorFactor[0]),
+          float(pbrMetallicRoughness.baseColorFactor[1]),
+          float(pbrMetallicRoughness.baseColorFactor[2]),
+          float(pbrMetallicRoughness.baseColorFactor[3]));
+  result.emissiveFactor = glm::vec3(float(material.emissiveFactor[0]),
+      float(material.emissiveFactor[1]), float(material.emissiveFactor[2]));
+  result.metallicFactor = float(pbrMetallicRoughness.metallicFactor);
+  result.roughnessFactor = float(pbrMetallicRoughness.roughnessFactor);
+  result.occlusionStrength = float(material.occlusionTexture.strength);
+  result.normalScale = float(material.normalTexture.scale);
+  result.alphaCutoff = float(material.alphaCutoff);
+  result.textures = {pbrMetallicRoughness.baseColorTexture.index,
+      pbrMetallicRoughness.metallicRoughnessTexture.index,
+      material.emissiveTexture.index, material.occlusionTexture.index,
+      material.normalTexture.index};
+  result.uvTransforms = {
+      getUvTransform(pbrMetallicRoughness.baseColorTexture.extensions),
+      getUvTransform(pbrMetallicRoughness.metallicRoughnessTexture.extensions),
+      getUvTransform(material.emissiveTexture.extensions),
+      getUvTransform(material.occlusionTexture.extensions),
+      getUvTransform(material.normalTexture.extensions)};
+  result.alphaMode =
+      material.alphaMode == "MASK"
+          ? AlphaMode::Mask
+          : (material.alphaMode == "BLEND" ? AlphaMode::Blend
+                                           : AlphaMode::Opaque);
+  result.doubleSided = material.doubleSided;
+  const auto transmissionIt =
+      material.extensions.find("KHR_materials_transmission");
+  if (transmissionIt != end(material.extensions) &&
+      transmissionIt->second.IsObject()) {
+    const auto &factor = transmissionIt->second.Get("transmissionFactor");
+    if (factor.IsNumber()) {
+      result.transmissionFactor =
+          glm::clamp(float(factor.GetNumberAsDouble()), 0.f, 1.f);
+    }
+  }
+  return result;
+}
+
+RuntimePrimitive getRuntimePrimitive(const tinygltf::Model &model,
+    const tinygltf::Primitive &primitive,
+    const std::vector<BufferBytes> &bufferBytes, bool scanVertices)
+{
+  RuntimePrimitive result;
+  result.material = primitive.material;
+  result.mode = GLenum(primitive.mode);
+  result.hasTargets = !primitive.targets.empty();
+  const auto variantsIt = primitive.extensions.find("KHR_materials_variants");
+  if (variantsIt != end(primitive.extensions) &&
+      variantsIt->second.IsObject()) {
+    const auto &mappings = variantsIt->second.Get("mappings");
+    for (size_t i = 0; i < mappings.ArrayLen(); ++i) {
+      const auto &mapping = mappings.Get(int(i));
+      if (!mapping.IsObject() || !mapping.Get("material").IsInt() ||
+          mapping.Get("material").Get<int>() < 0 ||
+          size_t(mapping.Get("material").Get<int>()) >=
+              model.materials.size()) {
+        continue;
+      }
+      const auto &variants = mapping.Get("variants");
+      for (size_t j = 0; j < variants.ArrayLen(); ++j) {
+        const auto &variant = variants.Get(int(j));
+        if (!variant.IsInt() || variant.Get<int>() < 0) {
+          continue;
+        }
+        const auto variantIdx = size_t(variant.Get<int>());
+        if (result.variantMaterials.size() <= variantIdx) {
+          result.variantMaterials.resize(variantIdx + 1, primitive.material);
+        }
+        result.variantMaterials[variantIdx] =
+            mapping.Get("material").Get<int>();
+      }
+    }
+  }
+  // Only accessors lacking min/max need their vertices
+  const auto position = primitive.attributes.find("POSITION");
+  if (scanVertices || position == end(primitive.attributes) ||
+      (model.accessors[position->second].minValues.size() == 3 &&
+          model.accessors[position->second].maxValues.size() == 3)) {
+    result.bounds = getPrimitiveBounds(model, primitive, bufferBytes);
+  }
+  if (primitive.indices >= 0) {
+    const auto &accessor = model.accessors[primitive.indices];
+    result.count = uint32_t(accessor.count);
+    result.indexType = GLenum(accessor.componentType);
+    result.indexBufferView = accessor.bufferView;
+    result.indexByteOffset = accessor.byteOffset;
+    // Checked again, min and max may come from the file
+    const auto vertexCount = position == end(primitive.attributes)
+                                 ? size_t(0)
+                                 : model.accessors[position->second].count;
+    if (accessor.minValues.size() == 1 && accessor.maxValues.size() == 1 &&
+        accessor.minValues[0] >= 0 &&
+        accessor.minValues[0] <= accessor.maxValues[0] &&
+        accessor.maxValues[0] < double(vertexCount)) {
+      result.minIndex = uint32_t(accessor.minValues[0]);
+      result.maxIndex = uint32_t(accessor.maxValues[0]);
+    }
+  } else if (!primitive.attributes.empty()) {
+    const auto accessorIdx = (*begin(primitive.attributes)).second;
+    result.count = uint32_t(model.accessors[accessorIdx].count);
+    if (result.count) {
+      result.minIndex = 0;
+      result.maxIndex = result.count - 1;
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+RuntimeScene buildRuntimeScene(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, bool scanVertices)
+{
+  RuntimeScene scene;
+  scene.materials.reserve(model.materials.size() + 1);
+  for (const auto &material : model.materials) {
+    scene.materials.push_back(getRuntimeMaterial(material));
+  }
+  scene.materials.emplace_back();
+
+  scene.firstPrimitives.reserve(model.meshes.size() + 1);
+  for (const auto &mesh : model.meshes) {
+    scene.firstPrimitives.push_back(uint32_t(scene.primitives.size()));
+    for (const auto &primitive : mesh.primitives) {
+      scene.primitives.push_back(
+          getRuntimePrimitive(model, primitive, bufferBytes, scanVertices));
+    }
+  }
+  scene.firstPrimitives.push_back(uint32_t(scene.primitives.size()));
+
+  const auto variantsIt = model.extensions.find("KHR_materials_variants");
+  if (variantsIt != end(model.extensions) && variantsIt->second.IsObject()) {
+    const auto &variants = variantsIt->second.Get("variants");
+    for (size_t i = 0; i < variants.ArrayLen(); ++i) {
+      const auto &variant = variants.Get(int(i));
+      const auto &name =
+          variant.IsObject() ? variant.Get("name") : tinygltf::Value();
+      scene.variants.push_back(name.IsString()
+                                   ? name.Get<std::string>()
+                                   : "variant " + std::to_string(i));
+    }
+  }
+
+  scene.nodeSkins.reserve(model.nodes.size());
+  for (const auto &node : model.nodes) {
+    scene.nodeSkins.push_back(node.skin);
+  }
+  return scene;
+}
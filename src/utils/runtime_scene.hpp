@@ -0,0 +1,102 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gltf.hpp"
+#include "render_queue.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// What the draw loop reads of a glTF model, converted once after parsing into
+// plain arrays indexed like the model: float factors instead of doubles, enums
+// instead of strings, and draw records instead of attribute maps, so that
+// per-frame and per-draw lookups are array reads. With --release-cpu-data the
+// materials of the tinygltf::Model are freed (see releaseMaterialData).
+
+// A material, textures in the order of MATERIAL_TEXTURE_COUNT: base color,
+// metallic roughness, emissive, occlusion, normal (-1 when it has none)
+struct RuntimeMaterial
+{
+  glm::vec4 baseColorFactor = glm::vec4(1);
+  glm::vec3 emissiveFactor = glm::vec3(0);
+  float metallicFactor = 1.f;
+  float roughnessFactor = 1.f;
+  float occlusionStrength = 0.f;
+  float normalScale = 1.f;
+  float alphaCutoff = 0.5f;
+  std::array<int, 5> textures = {-1, -1, -1, -1, -1};
+  // Of the texture coordinates of each texture, from KHR_texture_transform
+  std::array<glm::mat3x2, 5> uvTransforms = {glm::mat3x2(1), glm::mat3x2(1),
+      glm::mat3x2(1), glm::mat3x2(1), glm::mat3x2(1)};
+  AlphaMode alphaMode = AlphaMode::Opaque;
+  bool doubleSided = false;
+  // Share of the light transmitted through the surface, from
+  // KHR_materials_transmission (thin walled, without its texture)
+  float transmissionFactor = 0.f;
+};
+
+// A primitive of a mesh, what a DrawCommand needs before its vertex array
+struct RuntimePrimitive
+{
+  int material = -1; // -1 for the default material
+  GLenum mode = GL_TRIANGLES;
+  uint32_t count = 0; // Of indices, or of vertices for non indexed ones
+  GLenum indexType = 0; // 0 for non indexed primitives
+  int indexBufferView = -1;
+  size_t indexByteOffset = 0; // In indexBufferView
+  // Range of the vertices referenced by the indices, from the min and max of
+  // their accessor (see computeIndexRanges), or all vertices of non indexed
+  // primitives. Empty (minIndex > maxIndex) if unknown.
+  uint32_t minIndex = 1;
+  uint32_t maxIndex = 0;
+  bool hasTargets = false; // Morph targets
+  // Material of each variant of KHR_materials_variants, material where the
+  // primitive has no mapping for it. Empty without mappings.
+  std::vector<int> variantMaterials;
+  BoundingBox bounds; // In the space of its mesh, see getPrimitiveBounds
+};
+
+struct RuntimeScene
+{
+  // Of model.materials, then the default material (see material())
+  std::vector<RuntimeMaterial> materials;
+  // Of all meshes in the order of model.meshes and their primitives, like
+  // DrawCommand::primitive. Those of mesh i start at firstPrimitives[i].
+  std::vector<RuntimePrimitive> primitives;
+  std::vector<uint32_t> firstPrimitives; // One more than model.meshes
+  std::vector<int> nodeSkins; // Of model.nodes, -1 if not skinned
+  // Names of the variants of KHR_materials_variants
+  std::vector<std::string> variants;
+
+  // Index in materials of a material of the model, -1 for the default one
+  size_t materialSlot(int materialIdx) const
+  {
+    return materialIdx >= 0 ? size_t(materialIdx) : materials.size() - 1;
+  }
+
+  const RuntimeMaterial &material(int materialIdx) const
+  {
+    return materials[materialSlot(materialIdx)];
+  }
+
+  // Material of a primitive with the variant selected, -1 for the materials
+  // of the primitives themselves
+  int variantMaterial(size_t primitiveIdx, int variant) const
+  {
+    const auto &primitive = primitives[primitiveIdx];
+    return variant >= 0 && size_t(variant) < primitive.variantMaterials.size()
+               ? primitive.variantMaterials[size_t(variant)]
+               : primitive.material;
+  }
+};
+
+// Bounds of primitives lacking min/max are computed from bufferBytes, or left
+// empty without scanVertices
+RuntimeScene buildRuntimeScene(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, bool scanVertices = true);
@@ -0,0 +1,664 @@
+#include "scene_cache.hpp"
+#include "block_compression.hpp"
+#include "parallel.hpp"
+#include "texture_uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+const uint32_t sceneCacheMagic = 0x43535647; // "GVSC"
+const uint32_t sceneCacheVersion = 11;
+
+// Blobs are aligned so that they can be uploaded straight from the mapping
+const size_t blobAlignment = 16;
+
+size_t alignOffset(size_t offset)
+{
+  return (offset + blobAlignment - 1) / blobAlignment * blobAlignment;
+}
+
+// FNV-1a over 64-bit words, only used to detect content changes
+uint64_t hashBytes(const unsigned char *data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * 0x100000001b3ull;
+  }
+  for (; i < size; ++i) {
+    hash = (hash ^ data[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// A file the cache depends on, the glTF file itself or one of its external
+// buffers and images
+struct FileKey
+{
+  std::string path; // Relative to the directory of the glTF file
+  uint64_t size = 0;
+  int64_t writeTime = 0;
+  uint64_t hash = 0;
+};
+
+FileKey computeFileKey(const fs::path &baseDir, const std::string &path)
+{
+  FileKey key;
+  key.path = path;
+  const auto fullPath = baseDir / path;
+  key.writeTime = getWriteTime(fullPath);
+  MappedFile file(fullPath);
+  key.size = file.size();
+  key.hash = hashBytes(file.data(), file.size());
+  return key;
+}
+
+bool isFileUnchanged(const fs::path &baseDir, const FileKey &key)
+{
+  std::error_code ec;
+  const auto fullPath = baseDir / key.path;
+  if (!fs::exists(fullPath, ec) || fs::file_size(fullPath, ec) != key.size) {
+    return false;
+  }
+  if (getWriteTime(fullPath) == key.writeTime) {
+    return true;
+  }
+  MappedFile file(fullPath);
+  return hashBytes(file.data(), file.size()) == key.hash;
+}
+
+std::vector<std::string> getExternalFiles(const tinygltf::Model &model)
+{
+  std::vector<std::string> files;
+  const auto addUri = [&](const std::string &uri) {
+    if (!uri.empty() && uri.compare(0, 5, "data:") != 0 &&
+        std::find(begin(files), end(files), uri) == end(files)) {
+      files.emplace_back(uri);
+    }
+  };
+  for (const auto &buffer : model.buffers) {
+    addUri(buffer.uri);
+  }
+  for (const auto &image : model.images) {
+    addUri(image.uri);
+  }
+  return files;
+}
+
+// Writer and Reader share the interface used by serializeModel, so that the
+// fields are read in the order they are written
+class Writer
+{
+public:
+  template <typename T> void value(const T &value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    const auto *bytes = reinterpret_cast<const unsigned char *>(&value);
+    m_data.insert(end(m_data), bytes, bytes + sizeof(T));
+  }
+
+  void value(const std::string &value)
+  {
+    this->value(uint64_t(value.size()));
+    m_data.insert(end(m_data), begin(value), end(value));
+  }
+
+  template <typename T> void value(const std::vector<T> &values)
+  {
+    arraySize(values);
+    for (const auto &value : values) {
+      this->value(value);
+    }
+  }
+
+  void value(const std::map<std::string, int> &values)
+  {
+    value(uint64_t(values.size()));
+    for (const auto &value : values) {
+      this->value(value.first);
+      this->value(value.second);
+    }
+  }
+
+  void value(const FileKey &key)
+  {
+    value(key.path);
+    value(key.size);
+    value(key.writeTime);
+    value(key.hash);
+  }
+
+  // Size of an array whose elements are serialized by the caller
+  template <typename T> void arraySize(const std::vector<T> &values)
+  {
+    value(uint64_t(values.size()));
+  }
+
+  std::vector<unsigned char> &data() { return m_data; }
+
+private:
+  std::vector<unsigned char> m_data;
+};
+
+// Throws std::runtime_error when reading past the end of the data
+class Reader
+{
+public:
+  Reader(const unsigned char *data, size_t size) : m_data(data), m_size(size)
+  {
+  }
+
+  template <typename T> void value(T &value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "");
+    std::memcpy(&value, consume(sizeof(T)), sizeof(T));
+  }
+
+  void value(std::string &value)
+  {
+    const auto size = readSize();
+    const auto *bytes = consume(size);
+    value.assign(bytes, bytes + size);
+  }
+
+  template <typename T> void value(std::vector<T> &values)
+  {
+    arraySize(values);
+    for (auto &value : values) {
+      this->value(value);
+    }
+  }
+
+  void value(std::map<std::string, int> &values)
+  {
+    values.clear();
+    for (auto count = readSize(); count > 0; --count) {
+      std::string key;
+      value(key);
+      value(values[key]);
+    }
+  }
+
+  void value(FileKey &key)
+  {
+    value(key.path);
+    value(key.size);
+    value(key.writeTime);
+    value(key.hash);
+  }
+
+  template <typename T> void arraySize(std::vector<T> &values)
+  {
+    values.resize(readSize());
+  }
+
+  size_t readSize()
+  {
+    uint64_t size;
+    value(size);
+    if (size > m_size - m_offset) { // Each element takes at least one byte
+      throw std::runtime_error("Truncated scene cache");
+    }
+    return size_t(size);
+  }
+
+private:
+  const unsigned char *consume(size_t size)
+  {
+    if (size > m_size - m_offset) {
+      throw std::runtime_error("Truncated scene cache");
+    }
+    const auto *bytes = m_data + m_offset;
+    m_offset += size;
+    return bytes;
+  }
+
+  const unsigned char *m_data;
+  size_t m_size;
+  size_t m_offset = 0;
+};
+
+template <typename Stream, typename TextureInfo>
+void serializeTextureInfo(Stream &stream, TextureInfo &info)
+{
+  stream.value(info.index);
+  stream.value(info.texCoord);
+}
+
+void serializeBasisuSource(Writer &writer, const tinygltf::Texture &texture)
+{
+  writer.value(getBasisuImageSource(texture));
+}
+
+void serializeBasisuSource(Reader &reader, tinygltf::Texture &texture)
+{
+  int source = -1;
+  reader.value(source);
+  if (source >= 0) {
+    texture.extensions["KHR_texture_basisu"] =
+        tinygltf::Value(tinygltf::Value::Object{{"source", tinygltf::Value(source)}});
+  }
+}
+
+// Model is const tinygltf::Model with Writer and tinygltf::Model with Reader.
+// Buffer and image data are not part of it, images and bufferViews are
+// serialized by the callers since they are relocated in the cache.
+template <typename Stream, typename Model>
+void serializeModel(Stream &stream, Model &model)
+{
+  stream.value(model.defaultScene);
+  stream.value(model.extensionsUsed);
+
+  stream.arraySize(model.accessors);
+  for (auto &accessor : model.accessors) {
+    stream.value(accessor.bufferView);
+    stream.value(accessor.byteOffset);
+    stream.value(accessor.normalized);
+    stream.value(accessor.componentType);
+    stream.value(accessor.count);
+    stream.value(accessor.type);
+    stream.value(accessor.minValues);
+    stream.value(accessor.maxValues);
+  }
+
+  stream.arraySize(model.meshes);
+  for (auto &mesh : model.meshes) {
+    stream.value(mesh.name);
+    stream.arraySize(mesh.primitives);
+    for (auto &primitive : mesh.primitives) {
+      stream.value(primitive.attributes);
+      stream.value(primitive.material);
+      stream.value(primitive.indices);
+      stream.value(primitive.mode);
+    }
+  }
+
+  stream.arraySize(model.nodes);
+  for (auto &node : model.nodes) {
+    stream.value(node.name);
+    stream.value(node.mesh);
+    stream.value(node.children);
+    stream.value(node.rotation);
+    stream.value(node.scale);
+    stream.value(node.translation);
+    stream.value(node.matrix);
+  }
+
+  stream.arraySize(model.scenes);
+  for (auto &scene : model.scenes) {
+    stream.value(scene.name);
+    stream.value(scene.nodes);
+  }
+
+  stream.arraySize(model.materials);
+  for (auto &material : model.materials) {
+    auto &pbr = material.pbrMetallicRoughness;
+    stream.value(material.name);
+    stream.value(pbr.baseColorFactor);
+    serializeTextureInfo(stream, pbr.baseColorTexture);
+    stream.value(pbr.metallicFactor);
+    stream.value(pbr.roughnessFactor);
+    serializeTextureInfo(stream, pbr.metallicRoughnessTexture);
+    serializeTextureInfo(stream, material.normalTexture);
+    stream.value(material.normalTexture.scale);
+    serializeTextureInfo(stream, material.occlusionTexture);
+    stream.value(material.occlusionTexture.strength);
+    serializeTextureInfo(stream, material.emissiveTexture);
+    stream.value(material.emissiveFactor);
+    stream.value(material.alphaMode);
+    stream.value(material.alphaCutoff);
+    stream.value(material.doubleSided);
+  }
+
+  stream.arraySize(model.textures);
+  for (auto &texture : model.textures) {
+    stream.value(texture.sampler);
+    stream.value(texture.source);
+    serializeBasisuSource(stream, texture);
+  }
+
+  stream.arraySize(model.samplers);
+  for (auto &sampler : model.samplers) {
+    stream.value(sampler.minFilter);
+    stream.value(sampler.magFilter);
+    stream.value(sampler.wrapS);
+    stream.value(sampler.wrapT);
+    stream.value(sampler.wrapR);
+  }
+}
+
+} // namespace
+
+fs::path getSceneCachePath(const fs::path &gltfFile)
+{
+  auto path = gltfFile;
+  path += ".cache";
+  return path;
+}
+
+bool isSceneCacheable(const tinygltf::Model &model, std::string &reason)
+{
+  for (const auto &extension : model.extensionsUsed) {
+    if (extension != "KHR_texture_basisu" &&
+        extension != "KHR_mesh_quantization") {
+      reason = "extension " + extension + " is not supported by the cache";
+      return false;
+    }
+  }
+  if (!model.animations.empty() || !model.skins.empty() ||
+      !model.cameras.empty() || !model.lights.empty()) {
+    reason = "animations, skins, cameras and lights are not cached";
+    return false;
+  }
+  for (const auto &accessor : model.accessors) {
+    if (accessor.sparse.isSparse) {
+      reason = "sparse accessors are not cached";
+      return false;
+    }
+  }
+  for (const auto &mesh : model.meshes) {
+    for (const auto &primitive : mesh.primitives) {
+      if (!primitive.targets.empty()) {
+        reason = "morph targets are not cached";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool writeSceneCache(const fs::path &gltfFile, const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax, bool optimizedMeshes, bool mergedStaticGeometry,
+    bool deduplicated, bool mipChains, bool compressedTextures,
+    const TextureSizeLimits &textureSizeLimits, std::string &err)
+{
+  if (!isSceneCacheable(model, err)) {
+    return false;
+  }
+
+  // Pixels of images that are still encoded (see storeEncodedImage), with
+  // their mip chain if the cache holds them, or their blocks
+  std::vector<tinygltf::Image> decodedImages(model.images.size());
+  const auto usages = getImageUsages(model);
+  parallelFor(model.images.size(), [&](size_t i) {
+    const auto &image = model.images[i];
+    const auto &usage = usages[i];
+    if (image.as_is && !isKtx2Image(image)) {
+      std::string decodingErr;
+      decodedImages[i] = image;
+      if (!decodeImage(decodedImages[i], int(i), decodingErr)) {
+        return;
+      }
+      limitImageSize(
+          decodedImages[i], textureSizeLimits.get(usage), usage.color);
+      if (compressedTextures && usage.sampled) {
+        compressImage(decodedImages[i], getBlockFormat(usage), usage.color,
+            usage.generateMipmaps);
+      } else if (mipChains && usage.generateMipmaps) {
+        generateMipChain(decodedImages[i], usage.color);
+      }
+    }
+  });
+  const auto getImage = [&](size_t i) -> const tinygltf::Image & {
+    return decodedImages[i].image.empty() ? model.images[i] : decodedImages[i];
+  };
+
+  // Blobs are placed in this order after the metadata
+  struct Blob
+  {
+    const unsigned char *data;
+    size_t size;
+    size_t offset; // From the start of the data section
+  };
+  std::vector<Blob> blobs;
+  size_t dataSize = 0;
+  const auto addBlob = [&](const unsigned char *data, size_t size) {
+    dataSize = alignOffset(dataSize);
+    blobs.push_back({data, size, dataSize});
+    dataSize += size;
+    return blobs.back().offset;
+  };
+
+  Writer writer;
+  try {
+    const auto baseDir = gltfFile.parent_path();
+    writer.value(computeFileKey(baseDir, gltfFile.filename().string()));
+    std::vector<FileKey> dependencies;
+    for (const auto &file : getExternalFiles(model)) {
+      dependencies.emplace_back(computeFileKey(baseDir, file));
+    }
+    writer.value(dependencies);
+    writer.value(optimizedMeshes);
+    writer.value(mergedStaticGeometry);
+    writer.value(deduplicated);
+    writer.value(mipChains);
+    writer.value(compressedTextures);
+    writer.value(int(textureSizeLimits.maxSize));
+    writer.value(int(textureSizeLimits.maxDataSize));
+  } catch (const std::runtime_error &e) {
+    err = e.what();
+    return false;
+  }
+  writer.value(bboxMin);
+  writer.value(bboxMax);
+  serializeModel(writer, model);
+
+  // The bufferViews read by accessors are packed in buffer 0, the others
+  // (images embedded in .glb files) are emptied
+  std::vector<bool> isBufferViewUsed(model.bufferViews.size(), false);
+  for (const auto &accessor : model.accessors) {
+    if (accessor.bufferView >= 0) {
+      isBufferViewUsed[accessor.bufferView] = true;
+    }
+  }
+  const auto bufferBlobOffset = alignOffset(dataSize);
+  writer.arraySize(model.bufferViews);
+  for (size_t i = 0; i < model.bufferViews.size(); ++i) {
+    const auto &bufferView = model.bufferViews[i];
+    uint64_t byteOffset = 0;
+    uint64_t byteLength = 0;
+    if (isBufferViewUsed[i]) {
+      const auto &bytes = bufferBytes[bufferView.buffer];
+      if (bufferView.byteOffset + bufferView.byteLength > bytes.size) {
+        err = "bufferView " + std::to_string(i) + " is out of its buffer";
+        return false;
+      }
+      byteOffset = addBlob(bytes.data + bufferView.byteOffset,
+                       bufferView.byteLength) -
+                   bufferBlobOffset;
+      byteLength = bufferView.byteLength;
+    }
+    writer.value(byteOffset);
+    writer.value(byteLength);
+    writer.value(uint64_t(bufferView.byteStride));
+    writer.value(bufferView.target);
+  }
+  writer.value(uint64_t(bufferBlobOffset));
+  writer.value(uint64_t(dataSize - bufferBlobOffset));
+
+  writer.arraySize(model.images);
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    const auto &image = getImage(i);
+    writer.value(image.name);
+    writer.value(image.uri);
+    writer.value(image.mimeType);
+    writer.value(image.width);
+    writer.value(image.height);
+    writer.value(image.component);
+    writer.value(image.bits);
+    writer.value(image.pixel_type);
+    writer.value(image.as_is);
+    writer.value(uint64_t(addBlob(image.image.data(), image.image.size())));
+    writer.value(uint64_t(image.image.size()));
+  }
+
+  // Written to a temporary file first, so that concurrent viewers never map
+  // a partial cache
+  const auto cachePath = getSceneCachePath(gltfFile);
+  auto tmpPath = cachePath;
+  tmpPath += ".tmp";
+  {
+    std::ofstream output(tmpPath.string(), std::ios::binary);
+    const auto &metadata = writer.data();
+    const uint64_t metadataSize = metadata.size();
+    output.write(reinterpret_cast<const char *>(&sceneCacheMagic), 4);
+    output.write(reinterpret_cast<const char *>(&sceneCacheVersion), 4);
+    output.write(reinterpret_cast<const char *>(&metadataSize), 8);
+    output.write(reinterpret_cast<const char *>(metadata.data()),
+        std::streamsize(metadata.size()));
+
+    const auto dataStart = alignOffset(16 + metadata.size());
+    size_t fileOffset = 16 + metadata.size();
+    const char padding[blobAlignment] = {};
+    for (const auto &blob : blobs) {
+      output.write(padding, std::streamsize(dataStart + blob.offset - fileOffset));
+      output.write(reinterpret_cast<const char *>(blob.data),
+          std::streamsize(blob.size));
+      fileOffset = dataStart + blob.offset + blob.size;
+    }
+    if (!output) {
+      err = "Unable to write " + tmpPath.string();
+      return false;
+    }
+  }
+  std::error_code ec;
+  fs::rename(tmpPath, cachePath, ec);
+  if (ec) {
+    err = "Unable to write " + cachePath.string() + ": " + ec.message();
+    fs::remove(tmpPath, ec);
+    return false;
+  }
+  return true;
+}
+
+bool loadSceneCache(const fs::path &gltfFile, tinygltf::Model &model,
+    MappedFile &cacheFile, std::vector<BufferBytes> &bufferBytes,
+    glm::vec3 &bboxMin, glm::vec3 &bboxMax, bool optimizedMeshes,
+    bool mergedStaticGeometry, bool deduplicated, bool mipChains,
+    bool compressedTextures, const TextureSizeLimits &textureSizeLimits)
+{
+  const auto cachePath = getSceneCachePath(gltfFile);
+  std::error_code ec;
+  if (!fs::exists(cachePath, ec)) {
+    return false;
+  }
+  try {
+    MappedFile file(cachePath);
+    Reader header(file.data(), file.size());
+    uint32_t magic = 0, version = 0;
+    uint64_t metadataSize = 0;
+    header.value(magic);
+    header.value(version);
+    header.value(metadataSize);
+    if (magic != sceneCacheMagic || version != sceneCacheVersion ||
+        metadataSize > file.size() - 16) {
+      return false; // Written by another version, will be overwritten
+    }
+    const auto dataStart = alignOffset(16 + size_t(metadataSize));
+    const auto getBlob = [&](uint64_t offset, uint64_t size) {
+      if (offset > file.size() || size > file.size() - offset ||
+          dataStart + offset + size > file.size()) {
+        throw std::runtime_error("Truncated scene cache");
+      }
+      return file.data() + dataStart + offset;
+    };
+
+    Reader reader(file.data() + 16, size_t(metadataSize));
+    const auto baseDir = gltfFile.parent_path();
+    FileKey source;
+    std::vector<FileKey> dependencies;
+    reader.value(source);
+    reader.value(dependencies);
+    if (source.path != gltfFile.filename().string() ||
+        !isFileUnchanged(baseDir, source)) {
+      return false;
+    }
+    for (const auto &dependency : dependencies) {
+      if (!isFileUnchanged(baseDir, dependency)) {
+        return false;
+      }
+    }
+    bool cachedOptimizedMeshes = false;
+    bool cachedMergedStaticGeometry = false;
+    bool cachedDeduplicated = false;
+    bool cachedMipChains = false;
+    bool cachedCompressedTextures = false;
+    reader.value(cachedOptimizedMeshes);
+    reader.value(cachedMergedStaticGeometry);
+    reader.value(cachedDeduplicated);
+    reader.value(cachedMipChains);
+    reader.value(cachedCompressedTextures);
+    auto cachedMaxTextureSize = 0;
+    auto cachedMaxDataTextureSize = 0;
+    reader.value(cachedMaxTextureSize);
+    reader.value(cachedMaxDataTextureSize);
+    if (cachedOptimizedMeshes != optimizedMeshes ||
+        cachedMergedStaticGeometry != mergedStaticGeometry ||
+        cachedDeduplicated != deduplicated ||
+        cachedMipChains != mipChains ||
+        cachedCompressedTextures != compressedTextures ||
+        cachedMaxTextureSize != textureSizeLimits.maxSize ||
+        cachedMaxDataTextureSize != textureSizeLimits.maxDataSize) {
+      return false;
+    }
+
+    tinygltf::Model cachedModel;
+    reader.value(bboxMin);
+    reader.value(bboxMax);
+    serializeModel(reader, cachedModel);
+
+    reader.arraySize(cachedModel.bufferViews);
+    for (auto &bufferView : cachedModel.bufferViews) {
+      uint64_t byteOffset, byteLength, byteStride;
+      reader.value(byteOffset);
+      reader.value(byteLength);
+      reader.value(byteStride);
+      reader.value(bufferView.target);
+      bufferView.buffer = 0;
+      bufferView.byteOffset = size_t(byteOffset);
+      bufferView.byteLength = size_t(byteLength);
+      bufferView.byteStride = size_t(byteStride);
+    }
+    uint64_t bufferOffset, bufferSize;
+    reader.value(bufferOffset);
+    reader.value(bufferSize);
+    cachedModel.buffers.resize(1); // Its data stays in the mapping
+    bufferBytes = {{getBlob(bufferOffset, bufferSize), size_t(bufferSize)}};
+
+    reader.arraySize(cachedModel.images);
+    for (auto &image : cachedModel.images) {
+      reader.value(image.name);
+      reader.value(image.uri);
+      reader.value(image.mimeType);
+      reader.value(image.width);
+      reader.value(image.height);
+      reader.value(image.component);
+      reader.value(image.bits);
+      reader.value(image.pixel_type);
+      reader.value(image.as_is);
+      uint64_t offset, size;
+      reader.value(offset);
+      reader.value(size);
+      const auto *pixels = getBlob(offset, size);
+      image.image.assign(pixels, pixels + size);
+    }
+
+    model = std::move(cachedModel);
+    cacheFile = std::move(file);
+    return true;
+  } catch (const std::runtime_error &e) {
+    std::cerr << "Warning : ignoring scene cache " << cachePath.string()
+              << ": " << e.what() << std::endl;
+    return false;
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "gltf.hpp"
+#include "mapped_file.hpp"
+#include "texture_uploader.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <string>
+#include <vector>
+
+// Binary cache of a glTF file, written next to it (model.glb.cache), holding
+// what the viewer needs to start drawing without parsing JSON nor decoding
+// images: the metadata of the model, the bufferViews used by accessors packed
+// in one blob, decoded images and the scene bounds.
+//
+// A cache is valid while the glTF file and the external files it references
+// have the same size and either the same modification time or the same
+// content hash, so it survives a fresh checkout of unchanged assets.
+//
+// Only the parts of tinygltf::Model used by the viewer are stored, models
+// using anything else (animations, skins, cameras, extensions other than
+// KHR_texture_basisu and KHR_mesh_quantization...) are not cached. Bump the version in scene_cache.cpp
+// when the stored fields change.
+
+fs::path getSceneCachePath(const fs::path &gltfFile);
+
+// True if writeSceneCache can represent the model
+bool isSceneCacheable(const tinygltf::Model &model, std::string &reason);
+
+// Returns true if a valid cache of gltfFile exists. model is then filled from
+// it, except buffer data: bufferBytes point into cacheFile, which must outlive
+// their use. optimizedMeshes, mergedStaticGeometry, deduplicated, mipChains,
+// compressedTextures and textureSizeLimits must match the values the cache
+// was written with.
+bool loadSceneCache(const fs::path &gltfFile, tinygltf::Model &model,
+    MappedFile &cacheFile, std::vector<BufferBytes> &bufferBytes,
+    glm::vec3 &bboxMin, glm::vec3 &bboxMax, bool optimizedMeshes,
+    bool mergedStaticGeometry, bool deduplicated, bool mipChains,
+    bool compressedTextures, const TextureSizeLimits &textureSizeLimits);
+
+// Write the cache of gltfFile, the content of buffers is read from
+// bufferBytes. Images still encoded are decoded for the cache, the model is
+// not modified. optimizedMeshes, mergedStaticGeometry and deduplicated record
+// whether optimizeMeshes, mergeStaticGeometry and deduplicateModel were
+// applied to the model. With
+// mipChains, the cache holds the mip chains of the images
+// sampled with mipmaps (see generateMipChains): decoded images of the model
+// must hold theirs, images decoded for the cache get theirs computed.
+// compressedTextures records whether compressTextures was applied to the
+// model, its images are then stored as the KTX2 files it made, and
+// textureSizeLimits those limitImageSizes applied. Images decoded for the
+// cache are limited and compressed the same way. Returns false with the
+// reason in err on failure.
+bool writeSceneCache(const fs::path &gltfFile, const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, const glm::vec3 &bboxMin,
+    const glm::vec3 &bboxMax, bool optimizedMeshes, bool mergedStaticGeometry,
+    bool deduplicated, bool mipChains, bool compressedTextures,
+    const TextureSizeLimits &textureSizeLimits, std::string &err);
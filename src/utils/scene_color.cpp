@@ -0,0 +1,86 @@
+#include "scene_color.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Number of levels of a full mip chain of a width x height texture
+GLsizei getLevelCount(GLsizei width, GLsizei height)
+{
+  return GLsizei(std::floor(std::log2(float(std::max(width, height))))) + 1;
+}
+
+} // namespace
+
+void SceneColor::capture(GLsizei width, GLsizei height)
+{
+  GLint previousReadFramebuffer = 0;
+  GLint previousDrawFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDrawFramebuffer);
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  GLint sampleBuffers = 0;
+  glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+
+  if (width != m_width || height != m_height) {
+    const auto halfWidth = std::max(width / 2, GLsizei(1));
+    const auto halfHeight = std::max(height / 2, GLsizei(1));
+    m_texture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+    // Blended draws can be HDR, before tone mapping
+    glTexStorage2D(GL_TEXTURE_2D, getLevelCount(halfWidth, halfHeight),
+        GL_RGBA16F, halfWidth, halfHeight);
+    glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    const auto texture = m_texture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+    m_framebuffer = GLFramebuffer::generate();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, m_texture.glId(), 0);
+    m_resolveTexture = GLTexture();
+    m_resolveFramebuffer = GLFramebuffer();
+    m_width = width;
+    m_height = height;
+  }
+  if (sampleBuffers && !m_resolveTexture.glId()) {
+    m_resolveTexture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_resolveTexture.glId());
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, width, height);
+    const auto texture = m_resolveTexture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+    m_resolveFramebuffer = GLFramebuffer::generate();
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFramebuffer.glId());
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+        GL_TEXTURE_2D, m_resolveTexture.glId(), 0);
+  }
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousDrawFramebuffer));
+  if (sampleBuffers) {
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolveFramebuffer.glId());
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_resolveFramebuffer.glId());
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glBlitFramebuffer(0, 0, width, height, 0, 0,
+      std::max(width / 2, GLsizei(1)), std::max(height / 2, GLsizei(1)),
+      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousReadFramebuffer));
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousDrawFramebuffer));
+
+  glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+  glBindSampler(TEXTURE_UNIT, 0);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "gl_objects.hpp"
+
+#include <glad/glad.h>
+
+// Color of the scene behind the materials of KHR_materials_transmission
+// (--sorted-transparency), sampled by pbr_directional_light.fs.glsl.
+//
+// Transmissive draws are drawn with the blended ones, after the opaque draws
+// and the cutouts: before them, the color drawn so far is copied once per
+// frame at half its size in a texture whose mip levels are then filtered, so
+// that all transmissive draws sample the same copy, rougher materials from
+// blurrier levels. Copying the framebuffer per transmissive draw would cost
+// a copy per draw.
+class SceneColor
+{
+public:
+  // Texture unit read by the TRANSMISSION variants of the shader, after
+  // those of AmbientOcclusion
+  static const GLuint TEXTURE_UNIT = 14;
+
+  SceneColor() = default;
+
+  SceneColor(const SceneColor &) = delete;
+
+  SceneColor &operator=(const SceneColor &) = delete;
+
+  // Copy the width x height color at the origin of the framebuffer bound to
+  // GL_DRAW_FRAMEBUFFER, filter its mip levels and bind it to TEXTURE_UNIT.
+  // Its texture is created again when the size changes.
+  void capture(GLsizei width, GLsizei height);
+
+private:
+  // Half the size of the framebuffer, with all its mip levels
+  GLTexture m_texture;
+  GLFramebuffer m_framebuffer; // Of level 0 of m_texture
+  GLsizei m_width = 0; // Of the framebuffer copied
+  GLsizei m_height = 0;
+  // Multisampled framebuffers are first resolved at their size in this
+  // texture, blits of multisampled framebuffers can not scale
+  GLTexture m_resolveTexture;
+  GLFramebuffer m_resolveFramebuffer;
+};
@@ -0,0 +1,86 @@
+#include "scene_outliner.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+SceneOutliner::SceneOutliner(
+    const tinygltf::Model &model, const FlatScene &scene) :
+    m_parents(scene.parents),
+    m_subtreeEnds(scene.subtreeEnds),
+    m_depths(scene.size(), 0),
+    m_isExpanded(scene.size(), 0)
+{
+  m_nameOffsets.reserve(scene.size() + 1);
+  for (size_t i = 0; i < scene.size(); ++i) {
+    const auto parent = scene.parents[i];
+    m_depths[i] = parent < 0 ? 0 : m_depths[size_t(parent)] + 1;
+    m_nameOffsets.push_back(m_names.size());
+    const auto nodeIdx = scene.nodes[i];
+    if (parent >= 0 && scene.nodes[size_t(parent)] == nodeIdx) {
+      m_names += "instance " + std::to_string(i - size_t(parent) - 1);
+    } else if (!model.nodes[size_t(nodeIdx)].name.empty()) {
+      m_names += model.nodes[size_t(nodeIdx)].name;
+    } else {
+      m_names += "node " + std::to_string(nodeIdx);
+    }
+    m_names += '\0';
+  }
+  m_nameOffsets.push_back(m_names.size());
+  m_lowercaseNames = m_names;
+  std::transform(begin(m_lowercaseNames), end(m_lowercaseNames),
+      begin(m_lowercaseNames),
+      [](char c) { return char(std::tolower(static_cast<unsigned char>(c))); });
+  updateRows();
+}
+
+void SceneOutliner::setExpanded(int entry, bool expanded)
+{
+  m_isExpanded[size_t(entry)] = expanded;
+  if (m_filter.empty()) {
+    updateRows();
+  }
+}
+
+size_t SceneOutliner::reveal(int entry)
+{
+  for (auto i = m_parents[size_t(entry)]; i >= 0; i = m_parents[size_t(i)]) {
+    m_isExpanded[size_t(i)] = 1;
+  }
+  m_filter.clear();
+  updateRows();
+  m_selected = entry;
+  return size_t(
+      std::lower_bound(begin(m_rows), end(m_rows), entry) - begin(m_rows));
+}
+
+void SceneOutliner::setFilter(const std::string &filter)
+{
+  m_filter = filter;
+  std::transform(begin(m_filter), end(m_filter), begin(m_filter),
+      [](char c) { return char(std::tolower(static_cast<unsigned char>(c))); });
+  updateRows();
+}
+
+void SceneOutliner::updateRows()
+{
+  m_rows.clear();
+  const auto entryCount = m_depths.size();
+  if (m_filter.empty()) {
+    for (size_t i = 0; i < entryCount;) {
+      m_rows.push_back(int(i));
+      i = m_isExpanded[i] ? i + 1 : size_t(m_subtreeEnds[i]);
+    }
+    return;
+  }
+  // Each match is in the name starting at the last offset before it, the
+  // search goes on from the next name
+  auto position = m_lowercaseNames.find(m_filter);
+  while (position != std::string::npos) {
+    const auto entry = size_t(std::upper_bound(begin(m_nameOffsets),
+                                  end(m_nameOffsets), position) -
+                              begin(m_nameOffsets)) -
+                       1;
+    m_rows.push_back(int(entry));
+    position = m_lowercaseNames.find(m_filter, m_nameOffsets[entry + 1]);
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "flat_scene.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Rows of the tree of the entries of a FlatScene, for the scene panel of the
+// viewer GUI. With hundreds of thousands of nodes, the GUI only draws the
+// rows in view (ImGuiListClipper): the outliner keeps the list of rows
+// instead of the GUI walking the tree every frame.
+//
+// Without a filter, rows are the entries whose ancestors are all expanded, in
+// depth first order, listed again once an entry is expanded or collapsed by
+// skipping the subtrees of collapsed ones. With a filter, rows are the
+// entries whose name contains it, case insensitively, found in an index of
+// the lowercase names of all entries, concatenated once: filtering is a
+// search through one string, done again only when the filter changes.
+//
+// Entries are hidden by a DrawVisibility.
+class SceneOutliner
+{
+public:
+  // Entries are named after their node, "node <index>" if unnamed. Those of
+  // EXT_mesh_gpu_instancing instances are "instance <index>".
+  SceneOutliner(const tinygltf::Model &model, const FlatScene &scene);
+
+  size_t rowCount() const { return m_rows.size(); }
+
+  int rowEntry(size_t row) const { return m_rows[row]; }
+
+  const char *name(int entry) const
+  {
+    return m_names.c_str() + m_nameOffsets[size_t(entry)];
+  }
+
+  int depth(int entry) const { return m_depths[size_t(entry)]; }
+
+  bool hasChildren(int entry) const
+  {
+    return m_subtreeEnds[size_t(entry)] > entry + 1;
+  }
+
+  bool isExpanded(int entry) const { return m_isExpanded[size_t(entry)]; }
+
+  void setExpanded(int entry, bool expanded);
+
+  // Expand the ancestors of entry, clear the filter and select it. Returns
+  // its row.
+  size_t reveal(int entry);
+
+  const std::string &filter() const { return m_filter; }
+
+  // Empty for the tree
+  void setFilter(const std::string &filter);
+
+  // -1 if none
+  int selected() const { return m_selected; }
+
+  void select(int entry) { m_selected = entry; }
+
+private:
+  void updateRows();
+
+  std::vector<int> m_parents;
+  std::vector<int> m_subtreeEnds;
+  std::vector<int> m_depths;
+  // Names separated by null characters, and the same in lowercase for
+  // filters
+  std::string m_names;
+  std::string m_lowercaseNames;
+  std::vector<size_t> m_nameOffsets;
+  std::vector<uint8_t> m_isExpanded;
+  std::string m_filter;
+  std::vector<int> m_rows;
+  int m_selected = -1;
+};
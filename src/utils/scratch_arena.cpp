@@ -0,0 +1,79 @@
+#include "scratch_arena.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+
+// Blocks are at least this large, larger allocations get a block of their own
+const size_t BLOCK_SIZE = 1 << 20;
+// The first block is freed too by the outermost scope when it grew larger
+const size_t MAX_KEPT_BLOCK_SIZE = 16 << 20;
+
+} // namespace
+
+ScratchArena &ScratchArena::local()
+{
+  thread_local ScratchArena arena;
+  return arena;
+}
+
+void *ScratchArena::allocate(size_t size, size_t alignment)
+{
+  if (!size) {
+    size = 1; // Distinct addresses for empty allocations
+  }
+  for (; m_block < m_blocks.size(); ++m_block, m_offset = 0) {
+    const auto &block = m_blocks[m_block];
+    const auto offset = (m_offset + alignment - 1) / alignment * alignment;
+    if (offset + size <= block.size) {
+      m_offset = offset + size;
+      return block.data.get() + offset;
+    }
+    if (m_block + 1 == m_blocks.size()) {
+      break;
+    }
+  }
+  // Blocks from new are aligned for any fundamental type
+  if (alignment > alignof(std::max_align_t)) {
+    throw std::bad_alloc();
+  }
+  const auto blockSize = std::max(size, BLOCK_SIZE);
+  m_blocks.push_back({std::make_unique<unsigned char[]>(blockSize), blockSize});
+  m_block = m_blocks.size() - 1;
+  m_offset = size;
+  return m_blocks.back().data.get();
+}
+
+size_t ScratchArena::capacity() const
+{
+  size_t size = 0;
+  for (const auto &block : m_blocks) {
+    size += block.size;
+  }
+  return size;
+}
+
+ScratchArena::Scope::Scope() :
+    m_arena(local()), m_block(m_arena.m_block), m_offset(m_arena.m_offset)
+{
+  ++m_arena.m_scopeDepth;
+}
+
+ScratchArena::Scope::~Scope()
+{
+  m_arena.m_block = m_block;
+  m_arena.m_offset = m_offset;
+  if (--m_arena.m_scopeDepth) {
+    return;
+  }
+  auto &blocks = m_arena.m_blocks;
+  auto keptCount = std::max(m_block + 1, size_t(1));
+  if (!m_block && !m_offset && !blocks.empty() &&
+      blocks.front().size > MAX_KEPT_BLOCK_SIZE) {
+    keptCount = 0;
+  }
+  if (keptCount < blocks.size()) {
+    blocks.erase(blocks.begin() + keptCount, blocks.end());
+  }
+}
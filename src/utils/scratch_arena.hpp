@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bump allocator of the temporary data of loading passes. Allocating moves a
+// cursor in the blocks of the arena and freeing does nothing: the memory is
+// reclaimed at once when the Scope it was allocated in ends. Each thread has
+// its own arena (local()), so the jobs of parallelFor allocate without locks,
+// and blocks are reused by the next jobs of the same thread instead of going
+// back to malloc.
+class ScratchArena
+{
+public:
+  // The arena of the calling thread
+  static ScratchArena &local();
+
+  ScratchArena() = default;
+
+  ScratchArena(const ScratchArena &) = delete;
+
+  ScratchArena &operator=(const ScratchArena &) = delete;
+
+  void *allocate(size_t size, size_t alignment);
+
+  // Bytes of the blocks of the arena
+  size_t capacity() const;
+
+  // Everything allocated in the arena of the thread during the lifetime of a
+  // scope is released when it ends. The outermost one also frees the blocks
+  // allocated after its start, except a first one kept for the next scopes.
+  class Scope
+  {
+  public:
+    Scope();
+
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    ScratchArena &m_arena;
+    size_t m_block;
+    size_t m_offset;
+  };
+
+private:
+  struct Block
+  {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  std::vector<Block> m_blocks;
+  size_t m_block = 0; // Allocating in this block, the next ones are free
+  size_t m_offset = 0; // In m_blocks[m_block]
+  size_t m_scopeDepth = 0;
+};
+
+// Allocator of containers holding temporary data in the arena of the thread
+// constructing it, like ScratchVector. They must not outlive the
+// ScratchArena::Scope they are created in.
+template <typename T>
+class ScratchAllocator
+{
+public:
+  using value_type = T;
+
+  ScratchAllocator() noexcept : m_arena(&ScratchArena::local())
+  {
+  }
+
+  template <typename U>
+  ScratchAllocator(const ScratchAllocator<U> &other) noexcept :
+      m_arena(other.arena())
+  {
+  }
+
+  T *allocate(size_t count)
+  {
+    return static_cast<T *>(
+        m_arena->allocate(count * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, size_t) noexcept
+  {
+  }
+
+  ScratchArena *arena() const noexcept
+  {
+    return m_arena;
+  }
+
+private:
+  ScratchArena *m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ScratchAllocator<T> &lhs, const ScratchAllocator<U> &rhs)
+{
+  return lhs.arena() == rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ScratchAllocator<T> &lhs, const ScratchAllocator<U> &rhs)
+{
+  return !(lhs == rhs);
+}
+
+template <typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
@@ -0,0 +1,113 @@
+#include "selection_outline.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+SelectionOutline::SelectionOutline(GLProgram maskProgram,
+    GLProgram jumpFloodProgram, GLProgram outlineProgram) :
+    m_maskProgram(std::move(maskProgram)),
+    m_jumpFloodProgram(std::move(jumpFloodProgram)),
+    m_outlineProgram(std::move(outlineProgram)),
+    m_emptyVertexArray(GLVertexArray::generate())
+{
+  m_uMaskSize = m_maskProgram.getUniformLocation("uSize");
+  m_uSelectedDrawIds = m_maskProgram.getUniformLocation("uSelectedDrawIds");
+  m_uJumpFloodSize = m_jumpFloodProgram.getUniformLocation("uSize");
+  m_uStep = m_jumpFloodProgram.getUniformLocation("uStep");
+  m_uScale = m_outlineProgram.getUniformLocation("uScale");
+  m_uWidth = m_outlineProgram.getUniformLocation("uWidth");
+}
+
+void SelectionOutline::draw(GLuint drawIdTexture, GLsizei width,
+    GLsizei height, uint32_t firstDrawId, uint32_t endDrawId,
+    float outlineWidth)
+{
+  if (width <= 0 || height <= 0 || firstDrawId >= endDrawId) {
+    return;
+  }
+  if (width != m_width || height != m_height) {
+    GLint previousTexture = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+    GLuint textures[2];
+    for (size_t i = 0; i < 2; ++i) {
+      m_seedTextures[i] = GLTexture::generate();
+      glBindTexture(GL_TEXTURE_2D, m_seedTextures[i].glId());
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG16I, width, height);
+      textures[i] = m_seedTextures[i].glId();
+    }
+    glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 2, textures);
+    m_width = width;
+    m_height = height;
+  }
+  GLint viewport[4] = {};
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  const auto scale = glm::vec2(float(width) / float(std::max(viewport[2], 1)),
+      float(height) / float(std::max(viewport[3], 1)));
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  const auto groupCountX = GLuint((width + 7) / 8);
+  const auto groupCountY = GLuint((height + 7) / 8);
+
+  // The draw IDs are written by the draws of the scene
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  m_maskProgram.use();
+  glUniform2i(m_uMaskSize, width, height);
+  glUniform2ui(m_uSelectedDrawIds, firstDrawId, endDrawId);
+  glBindImageTexture(
+      0, drawIdTexture, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+  glBindImageTexture(1, m_seedTextures[0].glId(), 0, GL_FALSE, 0,
+      GL_WRITE_ONLY, GL_RG16I);
+  glDispatchCompute(groupCountX, groupCountY, 1);
+
+  // Seeds farther than the outline are never drawn: the first step only
+  // needs to cover its width, in pixels of the seeds
+  const auto reach = std::max(int(std::ceil(outlineWidth *
+                                            std::max(scale.x, scale.y))),
+      1);
+  auto step = 1;
+  while (step < reach) {
+    step *= 2;
+  }
+  m_jumpFloodProgram.use();
+  glUniform2i(m_uJumpFloodSize, width, height);
+  size_t source = 0;
+  for (; step >= 1; step /= 2) {
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glUniform1i(m_uStep, step);
+    glBindImageTexture(0, m_seedTextures[source].glId(), 0, GL_FALSE, 0,
+        GL_READ_ONLY, GL_RG16I);
+    glBindImageTexture(1, m_seedTextures[1 - source].glId(), 0, GL_FALSE, 0,
+        GL_WRITE_ONLY, GL_RG16I);
+    glDispatchCompute(groupCountX, groupCountY, 1);
+    source = 1 - source;
+  }
+
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  GLint previousVertexArray = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+  const auto depthTest = glIsEnabled(GL_DEPTH_TEST);
+  const auto blend = glIsEnabled(GL_BLEND);
+  glBindImageTexture(0, m_seedTextures[source].glId(), 0, GL_FALSE, 0,
+      GL_READ_ONLY, GL_RG16I);
+  glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG16I);
+  m_outlineProgram.use();
+  glUniform2f(m_uScale, scale.x, scale.y);
+  glUniform1f(m_uWidth, outlineWidth);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBindVertexArray(m_emptyVertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(GLuint(previousVertexArray));
+  if (!blend) {
+    glDisable(GL_BLEND);
+  }
+  if (depthTest) {
+    glEnable(GL_DEPTH_TEST);
+  }
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RG16I);
+  glUseProgram(GLuint(previousProgram));
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+
+// Outline of the selected draws (--gpu-picking), drawn around their pixels
+// in the draw IDs of the scene image.
+//
+// A compute pass writes a mask of the selection as seeds: each pixel of a
+// selected draw is its own nearest selected pixel. A jump flood then spreads
+// the nearest seed to all pixels in log2 of the width passes, each pixel
+// comparing its seed with those of its 8 neighbors at a step halving down to
+// 1. The pixels within the width of their seed are outlined. The cost only
+// depends on the size of the image and the width, not on the area selected
+// nor on its shape, where dilating the mask would cost a pass per pixel of
+// width.
+class SelectionOutline
+{
+public:
+  // maskProgram is selection_mask.cs.glsl, jumpFloodProgram is
+  // jump_flood.cs.glsl and outlineProgram is fullscreen_triangle.vs.glsl
+  // with selection_outline.fs.glsl
+  SelectionOutline(GLProgram maskProgram, GLProgram jumpFloodProgram,
+      GLProgram outlineProgram);
+
+  SelectionOutline(const SelectionOutline &) = delete;
+
+  SelectionOutline &operator=(const SelectionOutline &) = delete;
+
+  // Blend over the viewport the outline, width pixels wide, of the draws
+  // whose IDs are in [firstDrawId, endDrawId) in the bottom left width x
+  // height pixels of the R32UI drawIdTexture. The seeds are created again
+  // when the size changes.
+  void draw(GLuint drawIdTexture, GLsizei width, GLsizei height,
+      uint32_t firstDrawId, uint32_t endDrawId, float outlineWidth);
+
+private:
+  GLProgram m_maskProgram;
+  GLProgram m_jumpFloodProgram;
+  GLProgram m_outlineProgram;
+  GLint m_uMaskSize = -1;
+  GLint m_uSelectedDrawIds = -1;
+  GLint m_uJumpFloodSize = -1;
+  GLint m_uStep = -1;
+  GLint m_uScale = -1;
+  GLint m_uWidth = -1;
+  GLVertexArray m_emptyVertexArray;
+  // RG16I, the nearest seed of each pixel, or (-1, -1). Passes read one and
+  // write the other.
+  GLTexture m_seedTextures[2];
+  GLsizei m_width = 0; // Of the seeds
+  GLsizei m_height = 0;
+};
@@ -1,14 +1,17 @@
 #pragma once
 
 #include "filesystem.hpp"
+#include <algorithm>
 #include <fstream>
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 #include <iostream>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 class GLShader
 {
@@ -92,12 +95,17 @@ GLShader compileShader(GLenum type, StringType &&src)
   return shader;
 }
 
-// Load and compile a shader according to the following naming convention:
+// Load a shader and start its compilation according to the following naming
+// convention:
 // *.vs.glsl -> vertex shader
 // *.fs.glsl -> fragment shader
 // *.gs.glsl -> geometry shader
 // *.cs.glsl -> compute shader
-inline GLShader loadShader(const fs::path &shaderPath)
+// defines ("#define NAME VALUE" lines) are inserted after the #version line.
+// Its status is checked by checkShader: with enableParallelShaderCompile,
+// shaders started one after the other compile at the same time.
+inline GLShader startLoadingShader(
+    const fs::path &shaderPath, const std::string &defines = {})
 {
   static auto extToShaderType =
       std::unordered_map<std::string, std::pair<GLenum, std::string>>(
@@ -117,20 +125,105 @@ inline GLShader loadShader(const fs::path &shaderPath)
             << "\n";
 
   GLShader shader{(*it).second.first};
-  shader.setSource(loadShaderSource(shaderPath));
-  shader.compile();
+  auto source = loadShaderSource(shaderPath);
+  if (!defines.empty()) {
+    const auto versionEnd = source.compare(0, 8, "#version") == 0
+                                ? std::min(source.find('\n'), source.size())
+                                : std::string::npos;
+    if (versionEnd == std::string::npos) {
+      source.insert(0, defines);
+    } else {
+      source.insert(versionEnd, "\n" + defines);
+    }
+  }
+  shader.setSource(source);
+  glCompileShader(shader.glId());
+  return shader;
+}
+
+// Wait for the compilation of a shader, throws if it failed
+inline void checkShader(const GLShader &shader)
+{
   if (!shader.getCompileStatus()) {
     std::cerr << "Shader compilation error:" << shader.getInfoLog()
               << std::endl;
     throw std::runtime_error("Shader compilation error:" + shader.getInfoLog());
   }
+}
+
+// Load and compile a shader, see startLoadingShader
+inline GLShader loadShader(
+    const fs::path &shaderPath, const std::string &defines = {})
+{
+  auto shader = startLoadingShader(shaderPath, defines);
+  checkShader(shader);
   return shader;
 }
 
+// Active uniforms and uniform blocks of a program are listed once linked, so
+// that their locations are found without querying the driver, and uniforms
+// set with setUniform skip the driver when their value does not change.
 class GLProgram
 {
   GLuint m_GLId;
   typedef std::unique_ptr<char[]> CharBuffer;
+  std::unordered_map<std::string, GLint> m_uniformLocations;
+  std::unordered_map<std::string, GLuint> m_uniformBlockIndices;
+  // Bytes of the last value given to setUniform, by location
+  std::unordered_map<GLint, std::vector<unsigned char>> m_uniformValues;
+
+  // Returns false if the uniform at location already has the size bytes at
+  // value, records them otherwise
+  bool changeUniformValue(GLint location, const void *value, size_t size)
+  {
+    const auto *bytes = static_cast<const unsigned char *>(value);
+    auto &current = m_uniformValues[location];
+    if (current.size() == size &&
+        std::equal(bytes, bytes + size, begin(current))) {
+      return false;
+    }
+    current.assign(bytes, bytes + size);
+    return true;
+  }
+
+  // Fill the tables of active uniforms and uniform blocks. Elements of arrays
+  // are only found by the name of the array, or of its first element.
+  void reflect()
+  {
+    m_uniformLocations.clear();
+    m_uniformBlockIndices.clear();
+    m_uniformValues.clear();
+    for (const auto interface : {GL_UNIFORM, GL_UNIFORM_BLOCK}) {
+      GLint count = 0;
+      GLint maxNameLength = 0;
+      glGetProgramInterfaceiv(m_GLId, interface, GL_ACTIVE_RESOURCES, &count);
+      glGetProgramInterfaceiv(
+          m_GLId, interface, GL_MAX_NAME_LENGTH, &maxNameLength);
+      std::vector<GLchar> name(size_t(std::max(maxNameLength, 1)));
+      for (GLint i = 0; i < count; ++i) {
+        glGetProgramResourceName(
+            m_GLId, interface, GLuint(i), maxNameLength, nullptr, name.data());
+        if (interface == GL_UNIFORM_BLOCK) {
+          m_uniformBlockIndices[name.data()] = GLuint(i);
+          continue;
+        }
+        const GLenum property = GL_LOCATION;
+        GLint location = -1;
+        glGetProgramResourceiv(m_GLId, interface, GLuint(i), 1, &property, 1,
+            nullptr, &location);
+        if (location < 0) {
+          continue; // In a uniform block
+        }
+        std::string uniformName = name.data();
+        m_uniformLocations[uniformName] = location;
+        const auto arraySuffix = uniformName.rfind("[0]");
+        if (arraySuffix != std::string::npos &&
+            arraySuffix + 3 == uniformName.size()) {
+          m_uniformLocations[uniformName.substr(0, arraySuffix)] = location;
+        }
+      }
+    }
+  }
 
 public:
   GLProgram() : m_GLId(glCreateProgram()) {}
@@ -141,13 +234,23 @@ public:
 
   GLProgram &operator=(const GLProgram &) = delete;
 
-  GLProgram(GLProgram &&rvalue) : m_GLId(rvalue.m_GLId) { rvalue.m_GLId = 0; }
+  GLProgram(GLProgram &&rvalue) :
+      m_GLId(rvalue.m_GLId),
+      m_uniformLocations(std::move(rvalue.m_uniformLocations)),
+      m_uniformBlockIndices(std::move(rvalue.m_uniformBlockIndices)),
+      m_uniformValues(std::move(rvalue.m_uniformValues))
+  {
+    rvalue.m_GLId = 0;
+  }
 
   GLProgram &operator=(GLProgram &&rvalue)
   {
-    this->~GLProgram();
+    glDeleteProgram(m_GLId);
     m_GLId = rvalue.m_GLId;
     rvalue.m_GLId = 0;
+    m_uniformLocations = std::move(rvalue.m_uniformLocations);
+    m_uniformBlockIndices = std::move(rvalue.m_uniformBlockIndices);
+    m_uniformValues = std::move(rvalue.m_uniformValues);
     return *this;
   }
 
@@ -161,7 +264,28 @@ public:
   bool link()
   {
     glLinkProgram(m_GLId);
-    return getLinkStatus();
+    return finishLink();
+  }
+
+  // Wait for the glLinkProgram call on the program
+  bool finishLink()
+  {
+    if (!getLinkStatus()) {
+      return false;
+    }
+    reflect();
+    return true;
+  }
+
+  // Link from a binary of glGetProgramBinary, false if the driver rejects it
+  bool loadBinary(GLenum format, const void *binary, GLsizei length)
+  {
+    glProgramBinary(m_GLId, format, binary, length);
+    if (!getLinkStatus()) {
+      return false;
+    }
+    reflect();
+    return true;
   }
 
   bool getLinkStatus() const
@@ -184,10 +308,65 @@ public:
 
   void use() const { glUseProgram(m_GLId); }
 
+  // -1 if the program has no active uniform of this name
   GLint getUniformLocation(const GLchar *name) const
   {
-    GLint location = glGetUniformLocation(m_GLId, name);
-    return location;
+    const auto it = m_uniformLocations.find(name);
+    return it != end(m_uniformLocations) ? it->second : -1;
+  }
+
+  // GL_INVALID_INDEX if the program has no active uniform block of this name
+  GLuint getUniformBlockIndex(const GLchar *name) const
+  {
+    const auto it = m_uniformBlockIndices.find(name);
+    return it != end(m_uniformBlockIndices) ? it->second : GL_INVALID_INDEX;
+  }
+
+  // Set a uniform of the program, in use or not, unless setUniform already
+  // gave it this value: it must not be set by other means. Location -1 is
+  // ignored.
+  void setUniform(GLint location, GLint value)
+  {
+    if (location >= 0 && changeUniformValue(location, &value, sizeof(value))) {
+      glProgramUniform1i(m_GLId, location, value);
+    }
+  }
+
+  void setUniform(GLint location, GLuint value)
+  {
+    if (location >= 0 && changeUniformValue(location, &value, sizeof(value))) {
+      glProgramUniform1ui(m_GLId, location, value);
+    }
+  }
+
+  void setUniform(GLint location, float value)
+  {
+    if (location >= 0 && changeUniformValue(location, &value, sizeof(value))) {
+      glProgramUniform1f(m_GLId, location, value);
+    }
+  }
+
+  void setUniform(GLint location, const glm::vec3 &value)
+  {
+    if (location >= 0 && changeUniformValue(location, &value, sizeof(value))) {
+      glProgramUniform3fv(m_GLId, location, 1, &value[0]);
+    }
+  }
+
+  // Array of count vec4
+  void setUniform(GLint location, const glm::vec4 *values, GLsizei count)
+  {
+    if (location >= 0 &&
+        changeUniformValue(location, values, sizeof(*values) * count)) {
+      glProgramUniform4fv(m_GLId, location, count, &values[0][0]);
+    }
+  }
+
+  void setUniform(GLint location, const glm::mat4 &value)
+  {
+    if (location >= 0 && changeUniformValue(location, &value, sizeof(value))) {
+      glProgramUniformMatrix4fv(m_GLId, location, 1, GL_FALSE, &value[0][0]);
+    }
   }
 
   GLint getAttribLocation(const GLchar *name) const
@@ -243,17 +422,75 @@ template <typename CSrc> GLProgram buildComputeProgram(CSrc &&src)
   ;
 }
 
-inline GLProgram compileProgram(std::vector<fs::path> shaderPaths)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// A program whose shaders are compiling and which is linking, see
+// startCompilingProgram
+struct PendingProgram
 {
   GLProgram program;
+  std::vector<GLShader> shaders; // Empty if program is linked already
+  // Where ProgramCache stores its binary once linked, empty if it does not
+  fs::path cachePath;
+};
+
+// Start compiling the shaders of a program (defines are given to
+// startLoadingShader) and linking it, without waiting for the driver. With
+// retrievableBinary, glGetProgramBinary can be called on the program.
+inline PendingProgram startCompilingProgram(
+    const std::vector<fs::path> &shaderPaths, const std::string &defines = {},
+    bool retrievableBinary = false)
+{
+  PendingProgram pending;
+  pending.shaders.reserve(shaderPaths.size());
   for (const auto &path : shaderPaths) {
-    auto shader = loadShader(path);
-    program.attachShader(shader);
+    pending.shaders.push_back(startLoadingShader(path, defines));
+    pending.program.attachShader(pending.shaders.back());
   }
-  program.link();
-  if (!program.getLinkStatus()) {
-    std::cerr << "Program link error:" << program.getInfoLog() << std::endl;
-    throw std::runtime_error("Program link error:" + program.getInfoLog());
+  if (retrievableBinary) {
+    glProgramParameteri(
+        pending.program.glId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   }
-  return program;
+  glLinkProgram(pending.program.glId());
+  return pending;
+}
+
+// True once the driver is done with the program, in which case
+// finishCompilingProgram does not wait. Only with
+// enableParallelShaderCompile, drivers compile synchronously otherwise.
+inline bool isProgramReady(const PendingProgram &pending)
+{
+  GLint completed = GL_TRUE;
+  glGetProgramiv(pending.program.glId(), GL_COMPLETION_STATUS_KHR, &completed);
+  return completed == GL_TRUE;
+}
+
+// Wait for the program, throws if a shader does not compile or if it does
+// not link
+inline GLProgram finishCompilingProgram(PendingProgram pending)
+{
+  if (pending.shaders.empty()) {
+    return std::move(pending.program);
+  }
+  for (const auto &shader : pending.shaders) {
+    checkShader(shader);
+  }
+  if (!pending.program.finishLink()) {
+    std::cerr << "Program link error:" << pending.program.getInfoLog()
+              << std::endl;
+    throw std::runtime_error(
+        "Program link error:" + pending.program.getInfoLog());
+  }
+  return std::move(pending.program);
+}
+
+// Compile and link a program at once, see startCompilingProgram. All its
+// shaders compile before the first one is waited for.
+inline GLProgram compileProgram(const std::vector<fs::path> &shaderPaths,
+    const std::string &defines = {}, bool retrievableBinary = false)
+{
+  return finishCompilingProgram(
+      startCompilingProgram(shaderPaths, defines, retrievableBinary));
 }
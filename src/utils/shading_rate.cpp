@@ -0,0 +1,95 @@
+#include "shading_rate.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+
+namespace {
+
+// Rates of the values written by shading_rate.cs.glsl
+const GLenum RATE_PALETTE[] = {GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+    GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV,
+    GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV};
+
+} // namespace
+
+ShadingRateImage::ShadingRateImage(
+    const ShadingRateImageFunctions &functions, GLProgram program) :
+    m_functions(functions),
+    m_program(std::move(program))
+{
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &m_tileWidth);
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &m_tileHeight);
+  m_tileWidth = std::max(m_tileWidth, 1);
+  m_tileHeight = std::max(m_tileHeight, 1);
+  m_uViewportSize = m_program.getUniformLocation("uViewportSize");
+  m_uTileSize = m_program.getUniformLocation("uTileSize");
+  glProgramUniform1i(
+      m_program.glId(), m_program.getUniformLocation("uColor"), 0);
+  glProgramUniform1i(
+      m_program.glId(), m_program.getUniformLocation("uRates"), 0);
+}
+
+void ShadingRateImage::update(
+    GLuint colorTexture, GLsizei width, GLsizei height)
+{
+  const auto tileCountX = (width + m_tileWidth - 1) / m_tileWidth;
+  const auto tileCountY = (height + m_tileHeight - 1) / m_tileHeight;
+  if (tileCountX > m_width || tileCountY > m_height) {
+    m_width = std::max(tileCountX, m_width);
+    m_height = std::max(tileCountY, m_height);
+    m_texture = GLTexture::generate();
+    glBindTexture(GL_TEXTURE_2D, m_texture.glId());
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, m_width, m_height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    const auto texture = m_texture.glId();
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 1, &texture);
+  }
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_program.use();
+  glUniform2i(m_uViewportSize, width, height);
+  glUniform2i(m_uTileSize, m_tileWidth, m_tileHeight);
+
+  glActiveTexture(GL_TEXTURE0);
+  GLint previousTexture = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  // Complete with its own parameters, not those of a bound sampler object
+  GLint previousSampler = 0;
+  glGetIntegerv(GL_SAMPLER_BINDING, &previousSampler);
+  glBindSampler(0, 0);
+  glBindTexture(GL_TEXTURE_2D, colorTexture);
+  glBindImageTexture(
+      0, m_texture.glId(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+  glDispatchCompute(GLuint(tileCountX), GLuint(tileCountY), 1);
+  // Read by the rasterizer of the next frame
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+                  GL_TEXTURE_FETCH_BARRIER_BIT);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+
+  glBindSampler(0, GLuint(previousSampler));
+  glBindTexture(GL_TEXTURE_2D, GLuint(previousTexture));
+  glUseProgram(GLuint(previousProgram));
+  m_hasRates = true;
+}
+
+void ShadingRateImage::begin() const
+{
+  if (!m_hasRates) {
+    return;
+  }
+  m_functions.bindShadingRateImage(m_texture.glId());
+  m_functions.shadingRateImagePalette(0, 0,
+      GLsizei(sizeof(RATE_PALETTE) / sizeof(RATE_PALETTE[0])), RATE_PALETTE);
+  glEnable(GL_SHADING_RATE_IMAGE_NV);
+}
+
+void ShadingRateImage::end() const
+{
+  if (!m_hasRates) {
+    return;
+  }
+  glDisable(GL_SHADING_RATE_IMAGE_NV);
+  m_functions.bindShadingRateImage(0);
+}
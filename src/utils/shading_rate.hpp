@@ -0,0 +1,51 @@
+#pragma once
+
+#include "gl_extensions.hpp"
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+
+// Coarse shading of flat and peripheral regions of the scene with
+// GL_NV_shading_rate_image (--variable-rate-shading).
+//
+// Each texel of an R8UI rate image covers a tile of the framebuffer (16x16
+// pixels on current hardware) and selects one fragment shader invocation
+// per pixel, per 2x2 or per 4x4 pixels. shading_rate.cs.glsl fills it from a
+// frame of the scene, for the next one: a workgroup per tile reduces the
+// variance of the luminance of its pixels in shared memory, flat tiles being
+// shaded coarser, and tiles far from the center of the view are shaded
+// coarser too (foveation). Depth and coverage are still per pixel, edges of
+// the geometry stay sharp.
+class ShadingRateImage
+{
+public:
+  // program is shading_rate.cs.glsl, functions are loaded
+  ShadingRateImage(
+      const ShadingRateImageFunctions &functions, GLProgram program);
+
+  ShadingRateImage(const ShadingRateImage &) = delete;
+
+  ShadingRateImage &operator=(const ShadingRateImage &) = delete;
+
+  // Compute the rates of the next frame from the bottom left width x height
+  // pixels of colorTexture, in linear values
+  void update(GLuint colorTexture, GLsizei width, GLsizei height);
+
+  // Shade the draws until end() at the rates of the last update(), if any
+  void begin() const;
+
+  void end() const;
+
+private:
+  ShadingRateImageFunctions m_functions;
+  GLProgram m_program;
+  GLint m_uViewportSize = -1;
+  GLint m_uTileSize = -1;
+  GLsizei m_tileWidth = 16; // Pixels of a texel of the rate image
+  GLsizei m_tileHeight = 16;
+  GLsizei m_width = 0; // Of the rate image, in tiles
+  GLsizei m_height = 0;
+  GLTexture m_texture;
+  bool m_hasRates = false;
+};
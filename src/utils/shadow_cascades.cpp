@@ -0,0 +1,223 @@
+#include "shadow_cascades.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+// Share of the logarithmic split in the depths of cascades, the rest being
+// uniform (the "practical" split scheme)
+const float LOG_SPLIT_WEIGHT = 0.75f;
+
+// A cascade covers its slice plus this margin on each side, so that it is
+// reused while the camera moves a little
+const float CASCADE_MARGIN = 0.25f;
+
+} // namespace
+
+ShadowCascades::ShadowCascades()
+{
+  m_texture = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture.glId());
+  glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT32F, MAP_SIZE,
+      MAP_SIZE, GLsizei(CASCADE_COUNT));
+  // Linear filtering of comparisons is a 2x2 percentage closer filter
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE,
+      GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  m_framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glFramebufferTextureLayer(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture.glId(), 0, 0);
+  glDrawBuffer(GL_NONE);
+  const auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("ShadowCascades: incomplete framebuffer");
+  }
+  const GLuint textures[] = {m_texture.glId()};
+  trackTextures(
+      GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D_ARRAY, 1, textures);
+
+  m_uniforms = ShadowUniforms();
+  m_uniformBuffer = GLBuffer::generate();
+  glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.glId());
+  glBufferStorage(GL_UNIFORM_BUFFER, sizeof(ShadowUniforms), &m_uniforms,
+      GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowCascades::invalidate()
+{
+  for (auto &cascade : m_cascades) {
+    cascade.isRendered = false;
+  }
+}
+
+void ShadowCascades::update(const glm::vec3 &lightDirection,
+    const BoundingBox &sceneBounds, const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, bool enabled)
+{
+  m_uniforms = ShadowUniforms();
+  if (!enabled || sceneBounds.isEmpty()) {
+    return;
+  }
+  const auto direction = glm::normalize(lightDirection);
+  if (direction != m_lightDirection) {
+    m_lightDirection = direction;
+    invalidate();
+  }
+  // Light space is centered on the scene, looking along the light
+  const auto center = 0.5f * (sceneBounds.min + sceneBounds.max);
+  const auto up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1)
+                                                : glm::vec3(0, 1, 0);
+  m_lightViewMatrix = glm::lookAt(center, center - direction, up);
+  const auto sceneLightBounds =
+      transformBoundingBox(sceneBounds, m_lightViewMatrix);
+  // All casters between the light and the scene are in the depth range
+  const auto depthMargin =
+      0.01f * (sceneLightBounds.max.z - sceneLightBounds.min.z) + 1e-4f;
+  m_lightDepthRange = glm::vec2(-sceneLightBounds.max.z - depthMargin,
+      -sceneLightBounds.min.z + depthMargin);
+
+  // Slices only split the depths of the view where the scene is, a flat
+  // scene facing the camera has a single depth
+  const auto zNear = projMatrix[3][2] / (projMatrix[2][2] - 1.f);
+  const auto zFar = projMatrix[3][2] / (projMatrix[2][2] + 1.f);
+  const auto sceneViewBounds = transformBoundingBox(sceneBounds, viewMatrix);
+  const auto minDepth = std::max(zNear, -sceneViewBounds.max.z);
+  const auto maxDepth = std::min(zFar, -sceneViewBounds.min.z);
+  if (minDepth > maxDepth) {
+    return;
+  }
+  const auto getSplitDepth = [&](size_t split) {
+    const auto ratio = float(split) / float(CASCADE_COUNT);
+    return LOG_SPLIT_WEIGHT * minDepth * std::pow(maxDepth / minDepth, ratio) +
+           (1.f - LOG_SPLIT_WEIGHT) * (minDepth + (maxDepth - minDepth) * ratio);
+  };
+
+  const auto inverseProjMatrix = glm::inverse(projMatrix);
+  const auto lightFromViewMatrix =
+      m_lightViewMatrix * glm::inverse(viewMatrix);
+  const auto sceneMin = glm::vec2(sceneLightBounds.min);
+  const auto sceneMax = glm::vec2(sceneLightBounds.max);
+  const auto biasMatrix =
+      glm::scale(glm::translate(glm::mat4(1), glm::vec3(0.5f)),
+          glm::vec3(0.5f));
+  for (size_t c = 0; c < CASCADE_COUNT; ++c) {
+    auto &cascade = m_cascades[c];
+    // Part of the scene in the light space box of the slice
+    BoundingBox sliceBounds;
+    for (int corner = 0; corner < 8; ++corner) {
+      auto ray = inverseProjMatrix *
+                 glm::vec4((corner & 1) ? 1.f : -1.f,
+                     (corner & 2) ? 1.f : -1.f, -1.f, 1.f);
+      const auto point = glm::vec3(ray) / ray.w;
+      const auto depth = getSplitDepth(c + ((corner & 4) ? 1 : 0));
+      sliceBounds.extend(glm::vec3(lightFromViewMatrix *
+                                   glm::vec4(point * (depth / -point.z), 1)));
+    }
+    const auto requiredMin = glm::max(glm::vec2(sliceBounds.min), sceneMin);
+    const auto requiredMax = glm::min(glm::vec2(sliceBounds.max), sceneMax);
+    cascade.isUsed =
+        requiredMin.x <= requiredMax.x && requiredMin.y <= requiredMax.y;
+    if (!cascade.isUsed) {
+      continue;
+    }
+
+    const auto requiredSize = requiredMax - requiredMin;
+    const auto requiredSide = std::max(requiredSize.x, requiredSize.y);
+    const auto isCovered =
+        glm::all(glm::lessThanEqual(cascade.min, requiredMin)) &&
+        glm::all(glm::lessThanEqual(requiredMax, cascade.max));
+    if (!cascade.isRendered || !isCovered ||
+        cascade.max.x - cascade.min.x > 2.f * requiredSide) {
+      // Squares keep texels square, those larger than the scene are centered
+      // on it, the others are moved inside it
+      const auto side = std::max(
+          (1.f + 2.f * CASCADE_MARGIN) * requiredSide, 1e-6f);
+      for (int axis = 0; axis < 2; ++axis) {
+        auto middle = 0.5f * (requiredMin[axis] + requiredMax[axis]);
+        if (side >= sceneMax[axis] - sceneMin[axis]) {
+          middle = 0.5f * (sceneMin[axis] + sceneMax[axis]);
+        } else {
+          middle = glm::clamp(middle, sceneMin[axis] + 0.5f * side,
+              sceneMax[axis] - 0.5f * side);
+        }
+        cascade.min[axis] = middle - 0.5f * side;
+        cascade.max[axis] = middle + 0.5f * side;
+      }
+      cascade.isRendered = false;
+    }
+    m_uniforms.shadowMatrices[c] =
+        biasMatrix * getProjMatrix(c) * lightFromViewMatrix;
+    m_uniforms.texelSizes[int(c)] =
+        (cascade.max.x - cascade.min.x) / float(MAP_SIZE);
+  }
+  m_uniforms.cascadeCount = GLint(CASCADE_COUNT);
+}
+
+bool ShadowCascades::needsRender(size_t cascade) const
+{
+  return m_uniforms.cascadeCount && m_cascades[cascade].isUsed &&
+         !m_cascades[cascade].isRendered;
+}
+
+glm::mat4 ShadowCascades::getProjMatrix(size_t cascade) const
+{
+  const auto &square = m_cascades[cascade];
+  return glm::ortho(square.min.x, square.max.x, square.min.y, square.max.y,
+      m_lightDepthRange.x, m_lightDepthRange.y);
+}
+
+float ShadowCascades::getTexelSize(size_t cascade) const
+{
+  const auto &square = m_cascades[cascade];
+  return (square.max.x - square.min.x) / float(MAP_SIZE);
+}
+
+void ShadowCascades::beginCascade(size_t cascade)
+{
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &m_previousFramebuffer);
+  glGetIntegerv(GL_VIEWPORT, m_previousViewport);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+      m_texture.glId(), 0, GLint(cascade));
+  glViewport(0, 0, MAP_SIZE, MAP_SIZE);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(2.f, 4.f);
+}
+
+void ShadowCascades::endCascade(size_t cascade)
+{
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(m_previousFramebuffer));
+  glViewport(m_previousViewport[0], m_previousViewport[1],
+      m_previousViewport[2], m_previousViewport[3]);
+  m_cascades[cascade].isRendered = true;
+}
+
+void ShadowCascades::bind()
+{
+  glBindBuffer(GL_UNIFORM_BUFFER, m_uniformBuffer.glId());
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(m_uniforms), &m_uniforms);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORMS_BINDING, m_uniformBuffer.glId());
+  glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture.glId());
+  glBindSampler(TEXTURE_UNIT, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Cascaded shadow maps of the directional light (--shadow-maps), cached
+// between frames.
+//
+// The depth range of the view frustum that holds the scene is split in
+// CASCADE_COUNT slices, nearer ones being thinner. Each cascade is a layer of
+// a depth array texture, rendered with an orthographic projection along the
+// light over a square of light space covering the part of the scene seen in
+// its slice, with a margin. A cascade is only rendered again when the light
+// direction or the scene changes, or when the camera moved enough for its
+// slice to leave the square or to be much smaller than it: orbiting around
+// a model mostly reuses the cascades of the previous frames.
+class ShadowCascades
+{
+public:
+  static const size_t CASCADE_COUNT = 4;
+  static const GLsizei MAP_SIZE = 2048;
+
+  // Uniform block read by pbr_directional_light.fs.glsl, after FrameUniforms
+  // and DrawUniforms, and texture unit of its shadow map, after the material
+  // textures
+  static const GLuint UNIFORMS_BINDING = 2;
+  static const GLuint TEXTURE_UNIT = 5;
+
+  ShadowCascades();
+
+  ShadowCascades(const ShadowCascades &) = delete;
+
+  ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+  // Cascades must be rendered again, after nodes moved for instance
+  void invalidate();
+
+  // Fit the cascades to the view of viewMatrix and of the perspective
+  // projMatrix (without the matrix of an output tile) over the scene in
+  // sceneBounds, lit from lightDirection (world space, towards the light).
+  // Without enabled, the scene is drawn without shadows.
+  void update(const glm::vec3 &lightDirection, const BoundingBox &sceneBounds,
+      const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+      bool enabled = true);
+
+  // True if cascade must be rendered between beginCascade and endCascade
+  // before drawing the view given to update()
+  bool needsRender(size_t cascade) const;
+
+  // Light view and projection matrices to draw cascade with
+  const glm::mat4 &lightViewMatrix() const { return m_lightViewMatrix; }
+  glm::mat4 getProjMatrix(size_t cascade) const;
+
+  // World space size of a texel of cascade, to cull and simplify casters
+  // whose details it can not resolve
+  float getTexelSize(size_t cascade) const;
+
+  // Bind the depth layer of cascade as draw framebuffer and clear it. Depth
+  // is offset by the slope of triangles to avoid shadow acne.
+  void beginCascade(size_t cascade);
+
+  // Restore the framebuffer and viewport bound before beginCascade
+  void endCascade(size_t cascade);
+
+  // Upload the matrices of the cascades for the view given to update(), and
+  // bind them with the shadow map for the next draws
+  void bind();
+
+private:
+  // Same layout as the ShadowUniforms block of the shader (std140)
+  struct ShadowUniforms
+  {
+    // View space to the texture coordinates and depth of each cascade
+    glm::mat4 shadowMatrices[CASCADE_COUNT];
+    glm::vec4 texelSizes; // View space size of a texel of each cascade
+    GLint cascadeCount; // 0 without shadows
+    GLint padding[3];
+  };
+
+  // Square of light space covered by a cascade, in xy
+  struct Cascade
+  {
+    glm::vec2 min = glm::vec2(0);
+    glm::vec2 max = glm::vec2(0);
+    bool isUsed = false; // False if its slice does not reach the scene
+    bool isRendered = false;
+  };
+
+  glm::vec3 m_lightDirection = glm::vec3(0);
+  glm::mat4 m_lightViewMatrix = glm::mat4(1);
+  glm::vec2 m_lightDepthRange = glm::vec2(0); // Of the scene, along -z
+  Cascade m_cascades[CASCADE_COUNT];
+  ShadowUniforms m_uniforms;
+  GLTexture m_texture;
+  GLFramebuffer m_framebuffer;
+  GLBuffer m_uniformBuffer;
+  GLint m_previousFramebuffer = 0;
+  GLint m_previousViewport[4] = {};
+};
@@ -0,0 +1,53 @@
+#include "skinning.hpp"
+
+#include <glm/gtc/type_ptr.hpp>
+
+JointPalette::JointPalette(const tinygltf::Model &model,
+    const FlatScene &scene, const std::vector<BufferBytes> &bufferBytes)
+{
+  const auto entries = getNodeEntries(scene, model.nodes.size());
+  std::vector<float> values;
+  for (const auto &skin : model.skins) {
+    m_firstJoints.push_back(m_inverseBindMatrices.size());
+    const auto jointCount = skin.joints.size();
+    const auto hasInverseBindMatrices =
+        skin.inverseBindMatrices >= 0 &&
+        readFloatAccessor(
+            model, bufferBytes, skin.inverseBindMatrices, 16, values) &&
+        values.size() >= 16 * jointCount;
+    for (size_t j = 0; j < jointCount; ++j) {
+      const auto joint = skin.joints[j];
+      m_jointEntries.push_back(
+          joint >= 0 && size_t(joint) < entries.size() ? entries[joint] : -1);
+      m_inverseBindMatrices.push_back(
+          hasInverseBindMatrices ? glm::make_mat4(values.data() + 16 * j)
+                                 : glm::mat4(1));
+    }
+  }
+  m_matrices.resize(m_inverseBindMatrices.size());
+  update(scene);
+}
+
+void JointPalette::update(const FlatScene &scene)
+{
+  for (size_t j = 0; j < m_matrices.size(); ++j) {
+    const auto entry = m_jointEntries[j];
+    m_matrices[j] = entry >= 0
+                        ? scene.worldMatrices[entry] * m_inverseBindMatrices[j]
+                        : m_inverseBindMatrices[j];
+  }
+}
+
+BoundingBox JointPalette::getSkinnedBounds(
+    const BoundingBox &bindBounds, int skin) const
+{
+  const auto first = m_firstJoints[skin];
+  const auto end = size_t(skin) + 1 < m_firstJoints.size()
+                       ? m_firstJoints[skin + 1]
+                       : m_matrices.size();
+  BoundingBox bounds; // Empty for a skin without joints
+  for (auto j = first; j < end; ++j) {
+    bounds.extend(transformBoundingBox(bindBounds, m_matrices[j]));
+  }
+  return bounds;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "flat_scene.hpp"
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <vector>
+
+// Joint matrices of all the skins of a model, one after the other in a
+// palette uploaded as is to the Joints storage buffer of forward.vs.glsl.
+// The matrix of joint j of a skin is the world matrix of the joint node times
+// its inverse bind matrix: it takes the vertices of the skinned meshes from
+// their bind pose to world space, the matrices of the nodes drawing them are
+// not applied (glTF ignores them).
+//
+// Matrices are computed once per skin, however many nodes draw meshes with
+// it, so that crowds sharing skeletons cost as many matrices as they have
+// skins, whatever the count of their vertices.
+class JointPalette
+{
+public:
+  // Inverse bind matrices are read from bufferBytes, identity if the skin
+  // has none or they cannot be read. Joints not in the scene keep their
+  // inverse bind matrix alone.
+  JointPalette(const tinygltf::Model &model, const FlatScene &scene,
+      const std::vector<BufferBytes> &bufferBytes);
+
+  // Recompute the matrices from the world matrices of scene, once updated
+  void update(const FlatScene &scene);
+
+  // Index of the first joint of skin in matrices()
+  int getFirstJoint(int skin) const { return int(m_firstJoints[skin]); }
+
+  // Box of the vertices of a primitive once skinned by skin, from the box
+  // of its bind pose: the union of the box transformed by each joint, which
+  // contains any weighted sum of the joint matrices.
+  BoundingBox getSkinnedBounds(const BoundingBox &bindBounds, int skin) const;
+
+  const std::vector<glm::mat4> &matrices() const { return m_matrices; }
+
+private:
+  std::vector<size_t> m_firstJoints; // Of each skin, in m_matrices
+  std::vector<int> m_jointEntries; // Of each joint, in the flat scene or -1
+  std::vector<glm::mat4> m_inverseBindMatrices; // Of each joint
+  std::vector<glm::mat4> m_matrices;
+};
@@ -0,0 +1,270 @@
+#include "skinning_prepass.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Elements of the accessor of attribute in attributes, none if it has none.
+// Returns false if it cannot be read or has not vertexCount elements.
+bool readAttribute(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const std::map<std::string, int> &attributes, const char *attribute,
+    int componentCount, size_t vertexCount, std::vector<float> &values)
+{
+  values.clear();
+  const auto it = attributes.find(attribute);
+  if (it == end(attributes)) {
+    return true;
+  }
+  return it->second >= 0 &&
+         readFloatAccessor(
+             model, bufferBytes, it->second, componentCount, values) &&
+         values.size() == vertexCount * size_t(componentCount);
+}
+
+} // namespace
+
+SkinningPrepass::SkinningPrepass(GLProgram program, GLuint jointsBinding) :
+    m_program(std::move(program))
+{
+  for (const auto &block : {std::make_pair("SourceVertices", SOURCES_BINDING),
+           std::make_pair("TargetDeltas", DELTAS_BINDING),
+           std::make_pair("SkinnedVertices", OUTPUT_BINDING),
+           std::make_pair("Joints", jointsBinding)}) {
+    const auto blockIndex = glGetProgramResourceIndex(
+        m_program.glId(), GL_SHADER_STORAGE_BLOCK, block.first);
+    if (blockIndex != GL_INVALID_INDEX) {
+      glShaderStorageBlockBinding(m_program.glId(), blockIndex, block.second);
+    }
+  }
+  m_uFirstSource = m_program.getUniformLocation("uFirstSource");
+  m_uVertexCount = m_program.getUniformLocation("uVertexCount");
+  m_uFirstOutput = m_program.getUniformLocation("uFirstOutput");
+  m_uFirstJoint = m_program.getUniformLocation("uFirstJoint");
+  m_uTargetCount = m_program.getUniformLocation("uTargetCount");
+  m_uFirstDeltas = m_program.getUniformLocation("uFirstDeltas");
+  m_uSparseCounts = m_program.getUniformLocation("uSparseCounts");
+  m_uTargetWeights = m_program.getUniformLocation("uTargetWeights");
+}
+
+int SkinningPrepass::addPrimitive(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive)
+{
+  const auto &attributes = primitive.attributes;
+  const auto position = attributes.find("POSITION");
+  if (position == end(attributes) || position->second < 0) {
+    return -1;
+  }
+  const auto vertexCount = model.accessors[position->second].count;
+  std::vector<float> positions, normals, tangents, texCoords, joints, weights;
+  if (!vertexCount ||
+      !readAttribute(model, bufferBytes, attributes, "POSITION", 3,
+          vertexCount, positions) ||
+      !readAttribute(model, bufferBytes, attributes, "NORMAL", 3, vertexCount,
+          normals) ||
+      !readAttribute(model, bufferBytes, attributes, "TANGENT", 4,
+          vertexCount, tangents) ||
+      !readAttribute(model, bufferBytes, attributes, "TEXCOORD_0", 2,
+          vertexCount, texCoords) ||
+      !readAttribute(model, bufferBytes, attributes, "JOINTS_0", 4,
+          vertexCount, joints) ||
+      !readAttribute(model, bufferBytes, attributes, "WEIGHTS_0", 4,
+          vertexCount, weights)) {
+    return -1;
+  }
+  // Missing attributes are zeros, as disabled vertex attributes are
+  std::vector<SourceVertex> sources(vertexCount);
+  for (size_t i = 0; i < vertexCount; ++i) {
+    auto &source = sources[i];
+    source.position =
+        glm::vec3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+    if (!normals.empty()) {
+      source.normal =
+          glm::vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+    }
+    if (!tangents.empty()) {
+      source.tangent = glm::vec4(tangents[4 * i], tangents[4 * i + 1],
+          tangents[4 * i + 2], tangents[4 * i + 3]);
+    }
+    if (!texCoords.empty()) {
+      source.u = texCoords[2 * i];
+      source.v = texCoords[2 * i + 1];
+    }
+    if (!joints.empty()) {
+      source.joints = glm::vec4(joints[4 * i], joints[4 * i + 1],
+          joints[4 * i + 2], joints[4 * i + 3]);
+    }
+    if (!weights.empty()) {
+      source.weights = glm::vec4(weights[4 * i], weights[4 * i + 1],
+          weights[4 * i + 2], weights[4 * i + 3]);
+    }
+  }
+
+  std::vector<TargetDelta> deltas;
+  std::vector<Target> targets;
+  std::vector<TargetDelta> targetDeltas(vertexCount);
+  for (const auto &target : primitive.targets) {
+    if (!readAttribute(model, bufferBytes, target, "POSITION", 3, vertexCount,
+            positions) ||
+        !readAttribute(
+            model, bufferBytes, target, "NORMAL", 3, vertexCount, normals) ||
+        !readAttribute(model, bufferBytes, target, "TANGENT", 3, vertexCount,
+            tangents)) {
+      return -1;
+    }
+    size_t movedCount = 0; // Vertices with a delta that is not zero
+    for (size_t i = 0; i < vertexCount; ++i) {
+      auto &delta = targetDeltas[i];
+      delta = TargetDelta();
+      delta.vertex = GLuint(i);
+      if (!positions.empty()) {
+        delta.position = glm::vec3(
+            positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+      }
+      if (!normals.empty()) {
+        delta.normal = glm::vec4(
+            normals[3 * i], normals[3 * i + 1], normals[3 * i + 2], 0);
+      }
+      if (!tangents.empty()) {
+        delta.tangent = glm::vec4(
+            tangents[3 * i], tangents[3 * i + 1], tangents[3 * i + 2], 0);
+      }
+      movedCount += delta.position != glm::vec3(0) ||
+                    delta.normal != glm::vec4(0) ||
+                    delta.tangent != glm::vec4(0);
+    }
+    // Sparse if it halves the memory, a search costs a few reads per vertex
+    const auto sparse = movedCount < vertexCount / 2;
+    targets.push_back(Target{m_deltas.size() + deltas.size(),
+        sparse ? movedCount : vertexCount, sparse});
+    for (const auto &delta : targetDeltas) {
+      if (!sparse || delta.position != glm::vec3(0) ||
+          delta.normal != glm::vec4(0) || delta.tangent != glm::vec4(0)) {
+        deltas.push_back(delta);
+      }
+    }
+  }
+
+  m_primitives.push_back(Primitive{m_sources.size(), vertexCount,
+      m_targets.size(), targets.size()});
+  m_sources.insert(end(m_sources), begin(sources), end(sources));
+  m_targets.insert(end(m_targets), begin(targets), end(targets));
+  m_deltas.insert(end(m_deltas), begin(deltas), end(deltas));
+  return int(m_primitives.size()) - 1;
+}
+
+int SkinningPrepass::addDraw(
+    int primitiveIdx, int firstJoint, const std::vector<double> &weights)
+{
+  const auto &primitive = m_primitives[primitiveIdx];
+  Draw draw;
+  draw.primitive = size_t(primitiveIdx);
+  draw.firstJoint = firstJoint;
+  // Targets of zero weight are skipped, the largest ones are kept
+  std::vector<std::pair<float, size_t>> targets;
+  for (size_t t = 0; t < std::min(weights.size(), primitive.targetCount);
+       ++t) {
+    // Targets moving no vertex are skipped as well
+    if (weights[t] != 0. &&
+        m_targets[primitive.firstTarget + t].deltaCount) {
+      targets.emplace_back(float(weights[t]), t);
+    }
+  }
+  std::sort(begin(targets), end(targets), [](const auto &a, const auto &b) {
+    return std::abs(a.first) > std::abs(b.first);
+  });
+  targets.resize(std::min(targets.size(), size_t(MAX_MORPH_TARGETS)));
+  if (firstJoint < 0 && targets.empty()) {
+    return -1;
+  }
+  std::vector<glm::vec3> positions(primitive.vertexCount);
+  for (size_t i = 0; i < primitive.vertexCount; ++i) {
+    positions[i] = m_sources[primitive.firstSource + i].position;
+  }
+  for (const auto &target : targets) {
+    const auto &deltas = m_targets[primitive.firstTarget + target.second];
+    draw.targets.push_back(DrawTarget{GLuint(deltas.firstDelta),
+        deltas.sparse ? GLuint(deltas.deltaCount) : 0, target.first});
+    for (size_t i = 0; i < deltas.deltaCount; ++i) {
+      const auto &delta = m_deltas[deltas.firstDelta + i];
+      positions[delta.vertex] += target.first * delta.position;
+    }
+  }
+  for (const auto &position : positions) {
+    draw.morphedBounds.extend(position);
+  }
+  draw.firstOutput = m_outputVertexCount;
+  m_outputVertexCount += primitive.vertexCount;
+  m_draws.push_back(std::move(draw));
+  return int(m_draws.size()) - 1;
+}
+
+void SkinningPrepass::createBuffers()
+{
+  const auto createBuffer = [](size_t size, const void *data) {
+    auto buffer = GLBuffer::generate();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer.glId());
+    glBufferStorage(
+        GL_SHADER_STORAGE_BUFFER, std::max(size, size_t(16)), data, 0);
+    return buffer;
+  };
+  m_sourceBuffer = createBuffer(
+      m_sources.size() * sizeof(SourceVertex), m_sources.data());
+  m_deltaBuffer =
+      createBuffer(m_deltas.size() * sizeof(TargetDelta), m_deltas.data());
+  m_outputBuffer =
+      createBuffer(m_outputVertexCount * sizeof(OutputVertex), nullptr);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const GLuint buffers[] = {
+      m_sourceBuffer.glId(), m_deltaBuffer.glId(), m_outputBuffer.glId()};
+  trackBuffers(GpuMemoryCategory::Geometry, 3, buffers);
+  m_sources = {};
+  m_targets = {};
+  m_deltas = {};
+}
+
+GLintptr SkinningPrepass::getVertexByteOffset(int draw) const
+{
+  return GLintptr(m_draws[draw].firstOutput * sizeof(OutputVertex));
+}
+
+void SkinningPrepass::run()
+{
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_program.use();
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, SOURCES_BINDING, m_sourceBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, DELTAS_BINDING, m_deltaBuffer.glId());
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, OUTPUT_BINDING, m_outputBuffer.glId());
+  for (const auto &draw : m_draws) {
+    if (m_hasRun && draw.firstJoint < 0) {
+      continue;
+    }
+    const auto &primitive = m_primitives[draw.primitive];
+    GLuint firstDeltas[MAX_MORPH_TARGETS] = {};
+    GLuint sparseCounts[MAX_MORPH_TARGETS] = {};
+    float targetWeights[MAX_MORPH_TARGETS] = {};
+    for (size_t t = 0; t < draw.targets.size(); ++t) {
+      firstDeltas[t] = draw.targets[t].firstDelta;
+      sparseCounts[t] = draw.targets[t].sparseCount;
+      targetWeights[t] = draw.targets[t].weight;
+    }
+    glUniform1ui(m_uFirstSource, GLuint(primitive.firstSource));
+    glUniform1ui(m_uVertexCount, GLuint(primitive.vertexCount));
+    glUniform1ui(m_uFirstOutput, GLuint(draw.firstOutput));
+    glUniform1i(m_uFirstJoint, draw.firstJoint);
+    glUniform1i(m_uTargetCount, GLint(draw.targets.size()));
+    glUniform1uiv(m_uFirstDeltas, MAX_MORPH_TARGETS, firstDeltas);
+    glUniform1uiv(m_uSparseCounts, MAX_MORPH_TARGETS, sparseCounts);
+    glUniform1fv(m_uTargetWeights, MAX_MORPH_TARGETS, targetWeights);
+    glDispatchCompute(GLuint((primitive.vertexCount + 63) / 64), 1, 1);
+  }
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  glUseProgram(GLuint(previousProgram));
+  m_hasRun = true;
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "packed_geometry.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compute pre-pass of --compute-skinning: the vertices of skinned or morphed
+// draws are skinned and morphed by skin_vertices.cs.glsl into a transient
+// vertex buffer, once each time the joint matrices change, instead of by the
+// vertex shader of every pass drawing them (depth pre-pass, shading).
+//
+// Vertices of each primitive are read once, however many draws use it, with
+// the deltas of its morph targets. A draw keeps the targets whose weight is
+// not zero, at most MAX_MORPH_TARGETS of the largest ones, so that the shader
+// skips the others. Skinned draws are written in world space, the others in
+// object space.
+//
+// Targets moving few of the vertices (face rigs, usually stored as sparse
+// accessors) keep only the deltas of those, sorted by vertex, which the
+// shader finds by binary search: their memory is proportional to the
+// vertices they move instead of to those of the primitive.
+class SkinningPrepass
+{
+public:
+  static const int MAX_MORPH_TARGETS = 8;
+
+  // Layout of the vertices of vertexBuffer(), zeros for the attributes a
+  // primitive does not have
+  struct OutputVertex
+  {
+    PackedVertex vertex;
+    glm::vec4 tangent; // Handedness in w
+  };
+
+  // Storage buffers of skin_vertices.cs.glsl, after those of the draws of
+  // ViewerApplication
+  static const GLuint SOURCES_BINDING = 7;
+  static const GLuint DELTAS_BINDING = 8;
+  static const GLuint OUTPUT_BINDING = 9;
+
+  // program is skin_vertices.cs.glsl, it reads the joint matrices bound at
+  // jointsBinding
+  SkinningPrepass(GLProgram program, GLuint jointsBinding);
+
+  SkinningPrepass(const SkinningPrepass &) = delete;
+
+  SkinningPrepass &operator=(const SkinningPrepass &) = delete;
+
+  // Read the vertices and morph targets of primitive from bufferBytes,
+  // returns their index for addDraw, or -1 if an attribute cannot be read
+  int addPrimitive(const tinygltf::Model &model,
+      const std::vector<BufferBytes> &bufferBytes,
+      const tinygltf::Primitive &primitive);
+
+  // Draw of the vertices of primitive (from addPrimitive), skinned from the
+  // firstJoint of the Joints table (-1 without a skin) and morphed with the
+  // weights of its targets. Returns its index, or -1 if there is nothing to
+  // do: no skin and no weight that is not zero.
+  int addDraw(int primitive, int firstJoint, const std::vector<double> &weights);
+
+  // Box of the morphed vertices of draw, before skinning
+  const BoundingBox &getMorphedBounds(int draw) const
+  {
+    return m_draws[draw].morphedBounds;
+  }
+
+  // Upload the vertices and morph targets, and allocate the vertex buffer,
+  // once all draws are added. Vertices are released from the CPU.
+  void createBuffers();
+
+  // Vertices of all draws, with the layout of OutputVertex
+  GLuint vertexBuffer() const { return m_outputBuffer.glId(); }
+
+  // Of the first vertex of draw in vertexBuffer()
+  GLintptr getVertexByteOffset(int draw) const;
+
+  size_t getVertexCount(int draw) const
+  {
+    return m_primitives[m_draws[draw].primitive].vertexCount;
+  }
+
+  // Skin and morph the vertices of draws, once the joint matrices are
+  // uploaded. Draws without a skin only depend on their weights and are only
+  // run the first time. Vertex attributes read afterwards see the result.
+  void run();
+
+private:
+  // Same layouts as in skin_vertices.cs.glsl (std430)
+  struct SourceVertex
+  {
+    glm::vec3 position;
+    float u = 0.f;
+    glm::vec3 normal = glm::vec3(0);
+    float v = 0.f;
+    glm::vec4 joints = glm::vec4(0);
+    glm::vec4 weights = glm::vec4(0);
+    glm::vec4 tangent = glm::vec4(0);
+  };
+  static_assert(sizeof(SourceVertex) == 80, "Must match std430 layout");
+
+  struct TargetDelta
+  {
+    glm::vec3 position = glm::vec3(0);
+    GLuint vertex = 0; // Of the primitive, for sparse targets
+    glm::vec4 normal = glm::vec4(0);
+    glm::vec4 tangent = glm::vec4(0);
+  };
+  static_assert(sizeof(TargetDelta) == 48, "Must match std430 layout");
+
+  // Deltas of a morph target, one per vertex of its primitive, or only those
+  // of the vertices it moves, by increasing vertex, for sparse targets
+  struct Target
+  {
+    size_t firstDelta; // In m_deltas
+    size_t deltaCount;
+    bool sparse;
+  };
+
+  struct Primitive
+  {
+    size_t firstSource; // In m_sources
+    size_t vertexCount;
+    size_t firstTarget; // In m_targets
+    size_t targetCount;
+  };
+
+  struct DrawTarget
+  {
+    GLuint firstDelta;
+    GLuint sparseCount; // Deltas of a sparse target, 0 for dense ones
+    float weight;
+  };
+
+  struct Draw
+  {
+    size_t primitive;
+    int firstJoint;
+    std::vector<DrawTarget> targets;
+    size_t firstOutput; // In vertices of vertexBuffer()
+    BoundingBox morphedBounds;
+  };
+
+  GLProgram m_program;
+  GLint m_uFirstSource = -1;
+  GLint m_uVertexCount = -1;
+  GLint m_uFirstOutput = -1;
+  GLint m_uFirstJoint = -1;
+  GLint m_uTargetCount = -1;
+  GLint m_uFirstDeltas = -1;
+  GLint m_uSparseCounts = -1;
+  GLint m_uTargetWeights = -1;
+
+  std::vector<Primitive> m_primitives;
+  std::vector<Target> m_targets;
+  std::vector<Draw> m_draws;
+  std::vector<SourceVertex> m_sources;
+  std::vector<TargetDelta> m_deltas;
+  size_t m_outputVertexCount = 0;
+  GLBuffer m_sourceBuffer;
+  GLBuffer m_deltaBuffer;
+  GLBuffer m_outputBuffer;
+  bool m_hasRun = false;
+};
@@ -0,0 +1,452 @@
+#include "static_geometry.hpp"
+#include "accessor_view.hpp"
+#include "flat_scene.hpp"
+#include "parallel.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Attributes merged, by name, with their number of components
+using VertexFormat = std::map<std::string, int>;
+
+// Components of an attribute merged as floats, 0 if it is not merged
+int getMergedComponentCount(
+    const std::string &name, const tinygltf::Accessor &accessor)
+{
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT ||
+      accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE) {
+    return 0; // Not read by readFloatAccessor
+  }
+  const auto componentCount = tinygltf::GetNumComponentsInType(accessor.type);
+  if (name == "POSITION" || name == "NORMAL") {
+    return componentCount == 3 ? 3 : 0;
+  }
+  if (name == "TANGENT") {
+    return componentCount == 4 ? 4 : 0;
+  }
+  if (name.compare(0, 9, "TEXCOORD_") == 0) {
+    return componentCount == 2 ? 2 : 0;
+  }
+  if (name == "COLOR_0") {
+    return componentCount == 3 || componentCount == 4 ? componentCount : 0;
+  }
+  return 0;
+}
+
+// 10 bits per coordinate of a point in [0, 1]^3, interleaved
+uint32_t getMortonCode(const glm::vec3 &point)
+{
+  const auto spread = [](float coordinate) {
+    auto bits = uint32_t(glm::clamp(coordinate, 0.f, 1.f) * 1023.f);
+    bits = (bits | (bits << 16)) & 0x030000FF;
+    bits = (bits | (bits << 8)) & 0x0300F00F;
+    bits = (bits | (bits << 4)) & 0x030C30C3;
+    bits = (bits | (bits << 2)) & 0x09249249;
+    return bits;
+  };
+  return (spread(point.x) << 2) | (spread(point.y) << 1) | spread(point.z);
+}
+
+// A primitive of a static node
+struct Source
+{
+  int entry; // In the flat scene
+  int primitive; // In the mesh of the entry
+  glm::vec3 center; // Of its world space bounds
+  uint32_t mortonCode = 0;
+  size_t vertexCount;
+};
+
+struct Chunk
+{
+  const VertexFormat *format;
+  int material;
+  std::vector<const Source *> sources;
+  size_t vertexCount = 0;
+  // Built by buildChunk, values of the attributes in the order of format
+  std::vector<std::vector<float>> values;
+  std::vector<uint32_t> indices;
+  BoundingBox bounds;
+  bool isValid = false;
+};
+
+bool buildChunk(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes, const FlatScene &scene,
+    Chunk &chunk)
+{
+  chunk.values.resize(chunk.format->size());
+  std::vector<float> values;
+  std::vector<uint32_t> indices;
+  for (const auto *source : chunk.sources) {
+    const auto &mesh = model.meshes[scene.meshes[source->entry]];
+    const auto &primitive = mesh.primitives[source->primitive];
+    const auto &worldMatrix = scene.worldMatrices[source->entry];
+    const auto normalMatrix = glm::mat3(scene.normalMatrices[source->entry]);
+    const auto isMirrored = glm::determinant(glm::mat3(worldMatrix)) < 0.f;
+    const auto firstVertex = uint32_t(chunk.vertexCount);
+
+    size_t attributeIdx = 0;
+    for (const auto &attribute : *chunk.format) {
+      if (!readFloatAccessor(model, bufferBytes,
+              primitive.attributes.at(attribute.first), attribute.second,
+              values) ||
+          values.size() != source->vertexCount * size_t(attribute.second)) {
+        return false;
+      }
+      if (attribute.first == "POSITION") {
+        for (size_t i = 0; i < values.size(); i += 3) {
+          const auto position = glm::vec3(worldMatrix *
+              glm::vec4(values[i], values[i + 1], values[i + 2], 1.f));
+          chunk.bounds.extend(position);
+          std::memcpy(&values[i], &position, sizeof(position));
+        }
+      } else if (attribute.first == "NORMAL") {
+        for (size_t i = 0; i < values.size(); i += 3) {
+          const auto normal =
+              normalMatrix * glm::vec3(values[i], values[i + 1], values[i + 2]);
+          const auto length = glm::length(normal);
+          const auto unitNormal = length > 0.f ? normal / length : normal;
+          std::memcpy(&values[i], &unitNormal, sizeof(unitNormal));
+        }
+      } else if (attribute.first == "TANGENT") {
+        for (size_t i = 0; i < values.size(); i += 4) {
+          const auto tangent =
+              glm::mat3(worldMatrix) *
+              glm::vec3(values[i], values[i + 1], values[i + 2]);
+          const auto length = glm::length(tangent);
+          const auto unitTangent = length > 0.f ? tangent / length : tangent;
+          std::memcpy(&values[i], &unitTangent, sizeof(unitTangent));
+          // Bitangents are flipped by mirroring matrices
+          values[i + 3] = isMirrored ? -values[i + 3] : values[i + 3];
+        }
+      }
+      auto &chunkValues = chunk.values[attributeIdx++];
+      chunkValues.insert(end(chunkValues), begin(values), end(values));
+    }
+
+    if (primitive.indices >= 0) {
+      const auto &indexAccessor = model.accessors[primitive.indices];
+      if (!readIndexAccessor(model, bufferBytes, indexAccessor, indices)) {
+        return false;
+      }
+    } else {
+      indices.resize(source->vertexCount);
+      for (size_t i = 0; i < indices.size(); ++i) {
+        indices[i] = uint32_t(i);
+      }
+    }
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      // Front faces of mirrored nodes are clockwise, glTF says
+      if (isMirrored) {
+        std::swap(indices[i + 1], indices[i + 2]);
+      }
+      for (size_t j = i; j < i + 3; ++j) {
+        if (indices[j] >= source->vertexCount) {
+          return false;
+        }
+        chunk.indices.push_back(firstVertex + indices[j]);
+      }
+    }
+    chunk.vertexCount += source->vertexCount;
+  }
+  return true;
+}
+
+} // namespace
+
+StaticMergeStats mergeStaticGeometry(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  StaticMergeStats stats;
+  if (model.defaultScene < 0 ||
+      size_t(model.defaultScene) >= model.scenes.size()) {
+    return stats;
+  }
+  const auto scene = flattenScene(model, model.defaultScene, bufferBytes);
+
+  std::vector<bool> isMovable(model.nodes.size(), false);
+  for (const auto &animation : model.animations) {
+    for (const auto &channel : animation.channels) {
+      if (channel.target_node >= 0 &&
+          size_t(channel.target_node) < model.nodes.size()) {
+        isMovable[channel.target_node] = true;
+      }
+    }
+  }
+  // Nodes of other scenes keep their meshes
+  for (size_t s = 0; s < model.scenes.size(); ++s) {
+    if (int(s) != model.defaultScene) {
+      for (const auto nodeIdx :
+          flattenScene(model, int(s), bufferBytes).nodes) {
+        isMovable[nodeIdx] = true;
+      }
+    }
+  }
+  std::vector<bool> isStatic(scene.size(), false);
+  for (size_t i = 0; i < scene.size(); ++i) {
+    const auto &node = model.nodes[scene.nodes[i]];
+    const auto parent = scene.parents[i];
+    isStatic[i] = !isMovable[scene.nodes[i]] && node.skin < 0 &&
+                  !node.extensions.count("EXT_mesh_gpu_instancing") &&
+                  (parent < 0 || isStatic[parent]);
+  }
+  for (const auto &group : scene.lodGroups) {
+    for (const auto level : group.levels) {
+      if (level >= 0) {
+        std::fill(begin(isStatic) + level,
+            begin(isStatic) + scene.subtreeEnds[level], false);
+      }
+    }
+  }
+
+  // Primitives of static entries by material and vertex format
+  std::map<std::pair<int, VertexFormat>, std::vector<Source>> groups;
+  BoundingBox centerBounds;
+  for (size_t i = 0; i < scene.size(); ++i) {
+    if (!isStatic[i] || scene.meshes[i] < 0) {
+      continue;
+    }
+    const auto &mesh = model.meshes[scene.meshes[i]];
+    for (size_t p = 0; p < mesh.primitives.size(); ++p) {
+      const auto &primitive = mesh.primitives[p];
+      // Materials of KHR_materials_variants are switched per primitive
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES ||
+          !primitive.targets.empty() ||
+          primitive.extensions.count("KHR_materials_variants") ||
+          (primitive.material >= 0 &&
+              model.materials[primitive.material].alphaMode == "BLEND")) {
+        continue;
+      }
+      const auto positionIt = primitive.attributes.find("POSITION");
+      if (positionIt == end(primitive.attributes)) {
+        continue;
+      }
+      const auto vertexCount = model.accessors[positionIt->second].count;
+      VertexFormat format;
+      for (const auto &attribute : primitive.attributes) {
+        const auto &accessor = model.accessors[attribute.second];
+        const auto componentCount =
+            getMergedComponentCount(attribute.first, accessor);
+        if (!componentCount || accessor.count != vertexCount) {
+          format.clear();
+          break;
+        }
+        format[attribute.first] = componentCount;
+      }
+      const auto indexCount = primitive.indices >= 0
+                                  ? model.accessors[primitive.indices].count
+                                  : vertexCount;
+      if (format.empty() || !vertexCount || !indexCount || indexCount % 3) {
+        continue;
+      }
+      const auto bounds = transformBoundingBox(
+          getPrimitiveBounds(model, primitive, bufferBytes),
+          scene.worldMatrices[i]);
+      if (bounds.isEmpty()) {
+        continue;
+      }
+      Source source;
+      source.entry = int(i);
+      source.primitive = int(p);
+      source.center = 0.5f * (bounds.min + bounds.max);
+      source.vertexCount = vertexCount;
+      centerBounds.extend(source.center);
+      groups[std::make_pair(primitive.material, std::move(format))].push_back(
+          source);
+    }
+  }
+
+  // Consecutive primitives along the Morton curve make a chunk, until it is
+  // full. A primitive larger than a chunk is left as it is.
+  std::vector<Chunk> chunks;
+  const auto centerExtent =
+      glm::max(centerBounds.max - centerBounds.min, glm::vec3(1e-20f));
+  for (auto &group : groups) {
+    auto &sources = group.second;
+    if (sources.size() < 2) {
+      continue;
+    }
+    for (auto &source : sources) {
+      source.mortonCode =
+          getMortonCode((source.center - centerBounds.min) / centerExtent);
+    }
+    std::stable_sort(begin(sources), end(sources),
+        [](const Source &a, const Source &b) {
+          return a.mortonCode < b.mortonCode;
+        });
+    Chunk chunk;
+    chunk.format = &group.first.second;
+    chunk.material = group.first.first;
+    auto chunkVertexCount = size_t(0);
+    for (const auto &source : sources) {
+      if (chunkVertexCount + source.vertexCount > MAX_STATIC_CHUNK_VERTICES) {
+        if (chunk.sources.size() > 1) {
+          chunks.push_back(chunk);
+        }
+        chunk.sources.clear();
+        chunkVertexCount = 0;
+      }
+      if (source.vertexCount <= MAX_STATIC_CHUNK_VERTICES) {
+        chunk.sources.push_back(&source);
+        chunkVertexCount += source.vertexCount;
+      }
+    }
+    if (chunk.sources.size() > 1) {
+      chunks.push_back(chunk);
+    }
+  }
+
+  parallelFor(chunks.size(), [&](size_t i) {
+    chunks[i].isValid = buildChunk(model, bufferBytes, scene, chunks[i]);
+    if (!chunks[i].isValid) {
+      chunks[i].values.clear();
+      chunks[i].indices.clear();
+    }
+  });
+
+  // Written in a new buffer, the original bytes may be a read only mapping
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  const auto addAccessor = [&](const void *data, size_t count, int type,
+                               int componentType, int target) {
+    const auto elementSize =
+        size_t(tinygltf::GetComponentSizeInBytes(componentType) *
+               tinygltf::GetNumComponentsInType(type));
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = (buffer.data.size() + 3) / 4 * 4;
+    bufferView.byteLength = elementSize * count;
+    bufferView.target = target;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset, data,
+        bufferView.byteLength);
+    model.bufferViews.push_back(bufferView);
+
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.componentType = componentType;
+    accessor.count = count;
+    accessor.type = type;
+    model.accessors.push_back(accessor);
+    return int(model.accessors.size() - 1);
+  };
+  static const int vectorTypes[] = {TINYGLTF_TYPE_SCALAR, TINYGLTF_TYPE_VEC2,
+      TINYGLTF_TYPE_VEC3, TINYGLTF_TYPE_VEC4};
+
+  // Primitives of each entry moved to a chunk
+  std::vector<std::vector<bool>> mergedPrimitives(scene.size());
+  std::vector<uint16_t> shortIndices;
+  for (const auto &chunk : chunks) {
+    if (!chunk.isValid) {
+      continue;
+    }
+    tinygltf::Primitive primitive;
+    primitive.mode = TINYGLTF_MODE_TRIANGLES;
+    primitive.material = chunk.material;
+    size_t attributeIdx = 0;
+    for (const auto &attribute : *chunk.format) {
+      const auto &values = chunk.values[attributeIdx++];
+      const auto accessorIdx = addAccessor(values.data(),
+          chunk.vertexCount, vectorTypes[attribute.second - 1],
+          TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TARGET_ARRAY_BUFFER);
+      if (attribute.first == "POSITION") {
+        auto &accessor = model.accessors[accessorIdx];
+        accessor.minValues = {
+            chunk.bounds.min.x, chunk.bounds.min.y, chunk.bounds.min.z};
+        accessor.maxValues = {
+            chunk.bounds.max.x, chunk.bounds.max.y, chunk.bounds.max.z};
+      }
+      primitive.attributes[attribute.first] = accessorIdx;
+    }
+    if (chunk.vertexCount <= size_t(1) << 16) {
+      shortIndices.assign(begin(chunk.indices), end(chunk.indices));
+      primitive.indices = addAccessor(shortIndices.data(),
+          shortIndices.size(), TINYGLTF_TYPE_SCALAR,
+          TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT,
+          TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+    } else {
+      primitive.indices = addAccessor(chunk.indices.data(),
+          chunk.indices.size(), TINYGLTF_TYPE_SCALAR,
+          TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT,
+          TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+    }
+    tinygltf::Mesh mesh;
+    mesh.name = "static geometry";
+    mesh.primitives.push_back(std::move(primitive));
+    model.meshes.push_back(std::move(mesh));
+    tinygltf::Node node;
+    node.name = "static geometry";
+    node.mesh = int(model.meshes.size() - 1);
+    model.nodes.push_back(std::move(node));
+    model.scenes[model.defaultScene].nodes.push_back(
+        int(model.nodes.size() - 1));
+
+    for (const auto *source : chunk.sources) {
+      auto &merged = mergedPrimitives[source->entry];
+      const auto &mesh = model.meshes[scene.meshes[source->entry]];
+      merged.resize(mesh.primitives.size());
+      merged[source->primitive] = true;
+    }
+    stats.mergedPrimitives += chunk.sources.size();
+    ++stats.chunks;
+  }
+  if (!stats.chunks) {
+    return stats;
+  }
+  model.buffers.push_back(std::move(buffer));
+  bufferBytes.push_back(
+      {model.buffers.back().data.data(), model.buffers.back().data.size()});
+
+  // Nodes keep the primitives not merged, in a mesh shared by the nodes of
+  // the same mesh keeping the same ones
+  std::map<std::pair<int, std::vector<bool>>, int> remainingMeshes;
+  std::vector<bool> isChangedMesh(model.meshes.size(), false);
+  for (size_t i = 0; i < scene.size(); ++i) {
+    const auto &merged = mergedPrimitives[i];
+    if (merged.empty()) {
+      continue;
+    }
+    const auto meshIdx = scene.meshes[i];
+    isChangedMesh[meshIdx] = true;
+    auto &node = model.nodes[scene.nodes[i]];
+    if (std::all_of(begin(merged), end(merged), [](bool b) { return b; })) {
+      node.mesh = -1;
+      continue;
+    }
+    auto &remainingMesh = remainingMeshes[std::make_pair(meshIdx, merged)];
+    if (!remainingMesh) {
+      auto mesh = model.meshes[meshIdx];
+      mesh.primitives.clear();
+      for (size_t p = 0; p < merged.size(); ++p) {
+        if (!merged[p]) {
+          mesh.primitives.push_back(model.meshes[meshIdx].primitives[p]);
+        }
+      }
+      model.meshes.push_back(std::move(mesh));
+      remainingMesh = int(model.meshes.size() - 1);
+    }
+    node.mesh = remainingMesh;
+  }
+  // Meshes no node draws anymore are not uploaded
+  std::vector<bool> isMeshUsed(model.meshes.size(), false);
+  for (const auto &node : model.nodes) {
+    if (node.mesh >= 0) {
+      isMeshUsed[node.mesh] = true;
+    }
+  }
+  for (size_t m = 0; m < isChangedMesh.size(); ++m) {
+    if (isChangedMesh[m] && !isMeshUsed[m]) {
+      model.meshes[m].primitives.clear();
+    }
+  }
+  return stats;
+}
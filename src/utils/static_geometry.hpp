@@ -0,0 +1,36 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <cstddef>
+#include <vector>
+
+// Most vertices of a merged chunk of static geometry, so that its indices fit
+// in 16 bits
+const size_t MAX_STATIC_CHUNK_VERTICES = size_t(1) << 16;
+
+struct StaticMergeStats
+{
+  size_t mergedPrimitives = 0; // Draws of nodes replaced by the chunks
+  size_t chunks = 0;
+};
+
+// Pre-transform the primitives of the static nodes of the default scene to
+// world space and merge them by material and vertex attributes in chunks of
+// at most MAX_STATIC_CHUNK_VERTICES vertices, each the only primitive of a new
+// root node of the scene. Primitives are ordered along a Morton curve of
+// their centers before being split in chunks, so chunks stay spatially
+// compact and are still culled.
+//
+// Static nodes are those neither animated nor below an animated node, not
+// skinned, not instanced by EXT_mesh_gpu_instancing, not levels of an
+// MSFT_lod group and in no other scene. Only indexed or non indexed triangle
+// lists without morph targets are merged, in groups of two primitives or more,
+// and not those of BLEND materials, which are sorted by draw. Nodes keep
+// their other primitives in a new mesh. Vertices and indices of the chunks
+// are written in a new buffer appended to model.buffers, whose bytes are
+// appended to bufferBytes.
+StaticMergeStats mergeStaticGeometry(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
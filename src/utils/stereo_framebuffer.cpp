@@ -0,0 +1,108 @@
+#include "stereo_framebuffer.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdexcept>
+
+StereoFramebuffer::StereoFramebuffer(
+    FramebufferTextureMultiviewFunction framebufferTextureMultiview,
+    GLsizei eyeWidth, GLsizei eyeHeight, bool srgb) :
+    m_eyeWidth(eyeWidth), m_eyeHeight(eyeHeight)
+{
+  GLint previousTexture = 0;
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousTexture);
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+  const GLenum formats[] = {GLenum(srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8),
+      GL_DEPTH_COMPONENT32F};
+  m_textures = GLTextures::generate(2);
+  for (GLsizei i = 0; i < 2; ++i) {
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_textures[i]);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, formats[i], eyeWidth, eyeHeight, 2);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, GLuint(previousTexture));
+
+  m_framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  framebufferTextureMultiview(
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[0], 0, 0, 2);
+  framebufferTextureMultiview(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_textures[1], 0, 0, 2);
+  const auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("StereoFramebuffer: incomplete framebuffer");
+  }
+  m_readFramebuffer = GLFramebuffer::generate();
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D_ARRAY, 2,
+      m_textures.data());
+}
+
+void StereoFramebuffer::render(const std::function<void()> &drawScene) const
+{
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  drawScene();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+}
+
+void StereoFramebuffer::blitSideBySide(GLsizei width, GLsizei height) const
+{
+  GLint previousReadFramebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, m_readFramebuffer.glId());
+  const auto halfWidth = width / 2;
+  const auto isScaled = halfWidth != m_eyeWidth || height != m_eyeHeight;
+  for (GLint eye = 0; eye < 2; ++eye) {
+    glFramebufferTextureLayer(
+        GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_textures[0], 0, eye);
+    glBlitFramebuffer(0, 0, m_eyeWidth, m_eyeHeight, eye * halfWidth, 0,
+        (eye + 1) * halfWidth, height, GL_COLOR_BUFFER_BIT,
+        isScaled ? GL_LINEAR : GL_NEAREST);
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousReadFramebuffer));
+}
+
+std::array<glm::mat4, 2> getStereoProjMatrices(
+    const glm::mat4 &proj, float separation, float convergence)
+{
+  // Each eye is moved by half the separation, then its image is shifted
+  // for the parallax of points at the convergence distance to cancel out
+  const auto halfSeparation = 0.5f * separation;
+  std::array<glm::mat4, 2> eyeMatrices;
+  for (size_t eye = 0; eye < 2; ++eye) {
+    const auto offset = eye == 0 ? halfSeparation : -halfSeparation;
+    auto shift = glm::mat4(1);
+    shift[3][0] = -proj[0][0] * offset / convergence;
+    eyeMatrices[eye] = shift * proj *
+                       glm::translate(glm::mat4(1), glm::vec3(offset, 0, 0));
+  }
+  return eyeMatrices;
+}
+
+Frustum getStereoFrustum(const glm::mat4 &proj, const glm::mat4 &viewMatrix,
+    float separation, float convergence)
+{
+  // The side planes of both eyes are within those of a wider frustum, whose
+  // apex is behind the camera: at a distance d, their images cover
+  // [-halfSeparation - d * slope, halfSeparation + d * slope]
+  const auto halfSeparation = 0.5f * separation;
+  const auto slope = 1.f / proj[0][0] + halfSeparation / convergence;
+  const auto apexDistance = halfSeparation / slope;
+  auto widerProj = proj;
+  widerProj[0][0] = 1.f / slope;
+  auto frustum = getFrustum(widerProj *
+                            glm::translate(glm::mat4(1),
+                                glm::vec3(0, 0, -apexDistance)) *
+                            viewMatrix);
+  // Near and far planes of the eyes are those of the camera
+  const auto cameraFrustum = getFrustum(proj * viewMatrix);
+  frustum.planes[4] = cameraFrustum.planes[4];
+  frustum.planes[5] = cameraFrustum.planes[5];
+  return frustum;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "gl_extensions.hpp"
+#include "gl_objects.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <functional>
+
+// Stereo views of --stereo, drawn in a single pass with GL_OVR_multiview2:
+// the color and depth attachments are arrays of two layers, the left and
+// right eyes, and each draw of the forward shaders compiled with MULTIVIEW
+// is rasterized in both, projected by the eye matrices of FrameUniforms. The
+// scene is culled, its materials bound and its draws submitted once, for
+// both eyes.
+//
+// The eyes are drawn with the projection of the window, each in half of its
+// width: blitSideBySide packs them side by side like half side-by-side 3D
+// displays expect, the left eye on the left.
+class StereoFramebuffer
+{
+public:
+  // Layers of eyeWidth x eyeHeight pixels, in sRGB if srgb is true. Throws
+  // std::runtime_error if the framebuffer is not complete.
+  StereoFramebuffer(
+      FramebufferTextureMultiviewFunction framebufferTextureMultiview,
+      GLsizei eyeWidth, GLsizei eyeHeight, bool srgb);
+
+  StereoFramebuffer(const StereoFramebuffer &) = delete;
+
+  StereoFramebuffer &operator=(const StereoFramebuffer &) = delete;
+
+  GLsizei eyeWidth() const { return m_eyeWidth; }
+
+  GLsizei eyeHeight() const { return m_eyeHeight; }
+
+  // Bind the framebuffer to GL_DRAW_FRAMEBUFFER, call drawScene(), which
+  // must only use multiview programs, then restore the previous binding
+  void render(const std::function<void()> &drawScene) const;
+
+  // Copy the left and right eyes of the last frame rendered to the left and
+  // right halves of the width x height framebuffer bound to
+  // GL_DRAW_FRAMEBUFFER, filtered linearly if their sizes differ
+  void blitSideBySide(GLsizei width, GLsizei height) const;
+
+private:
+  GLsizei m_eyeWidth;
+  GLsizei m_eyeHeight;
+  GLTextures m_textures; // Color and depth arrays
+  GLFramebuffer m_framebuffer;
+  GLFramebuffer m_readFramebuffer; // Of a layer of the color, for blits
+};
+
+// Projections of the left and right eyes, separation apart along the x axis
+// of the view space of proj, converging at convergence (parallel off-axis
+// frustums: points at that distance are drawn at the same place for both
+// eyes, nearer ones in front of the display)
+std::array<glm::mat4, 2> getStereoProjMatrices(
+    const glm::mat4 &proj, float separation, float convergence);
+
+// Frustum containing those of both eyes of getStereoProjMatrices, for the
+// view matrix viewMatrix, to cull their draws once
+Frustum getStereoFrustum(const glm::mat4 &proj, const glm::mat4 &viewMatrix,
+    float separation, float convergence);
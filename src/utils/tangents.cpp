@@ -0,0 +1,220 @@
+#include "tangents.hpp"
+#include "accessor_view.hpp"
+#include "parallel.hpp"
+#include "scratch_arena.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Any unit vector orthogonal to the unit vector n
+glm::vec3 getOrthogonal(const glm::vec3 &n)
+{
+  const auto axis =
+      std::abs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+  return glm::normalize(glm::cross(n, axis));
+}
+
+// Angle between the unit vectors a and b
+float getAngle(const glm::vec3 &a, const glm::vec3 &b)
+{
+  return std::acos(glm::clamp(glm::dot(a, b), -1.f, 1.f));
+}
+
+} // namespace
+
+size_t generateTangents(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes)
+{
+  // Primitives needing tangents, grouped by attributes
+  struct Group
+  {
+    std::map<std::string, int> attributes;
+    std::vector<std::pair<size_t, size_t>> primitives; // Mesh, primitive
+    std::vector<glm::vec4> tangents; // Empty if they cannot be computed
+  };
+  std::vector<Group> groups;
+  std::map<std::map<std::string, int>, size_t> groupIndices;
+  for (size_t meshIdx = 0; meshIdx < model.meshes.size(); ++meshIdx) {
+    const auto &primitives = model.meshes[meshIdx].primitives;
+    for (size_t primitiveIdx = 0; primitiveIdx < primitives.size();
+         ++primitiveIdx) {
+      const auto &primitive = primitives[primitiveIdx];
+      const auto &attributes = primitive.attributes;
+      // The shaders only read TEXCOORD_0
+      if (primitive.mode != TINYGLTF_MODE_TRIANGLES ||
+          primitive.material < 0 ||
+          model.materials[primitive.material].normalTexture.index < 0 ||
+          model.materials[primitive.material].normalTexture.texCoord != 0 ||
+          attributes.count("TANGENT") || !attributes.count("POSITION") ||
+          !attributes.count("NORMAL") || !attributes.count("TEXCOORD_0")) {
+        continue;
+      }
+      const auto it = groupIndices.emplace(attributes, groups.size()).first;
+      if (it->second == groups.size()) {
+        groups.emplace_back();
+        groups.back().attributes = attributes;
+      }
+      groups[it->second].primitives.emplace_back(meshIdx, primitiveIdx);
+    }
+  }
+
+  parallelFor(groups.size(), [&](size_t g) {
+    const ScratchArena::Scope scratch;
+    auto &group = groups[g];
+    const auto vertexCount =
+        model.accessors[group.attributes.at("POSITION")].count;
+    std::vector<float> positions, normals, texCoords;
+    if (!readFloatAccessor(model, bufferBytes, group.attributes.at("POSITION"),
+            3, positions) ||
+        !readFloatAccessor(model, bufferBytes, group.attributes.at("NORMAL"), 3,
+            normals) ||
+        !readFloatAccessor(model, bufferBytes,
+            group.attributes.at("TEXCOORD_0"), 2, texCoords) ||
+        positions.size() != 3 * vertexCount ||
+        normals.size() != 3 * vertexCount ||
+        texCoords.size() != 2 * vertexCount) {
+      return;
+    }
+    const auto getPosition = [&](uint32_t i) {
+      return glm::vec3(
+          positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+    };
+    const auto getTexCoords = [&](uint32_t i) {
+      return glm::vec2(texCoords[2 * i], texCoords[2 * i + 1]);
+    };
+
+    // Sums of the unit tangents and bitangents of the triangles of each
+    // vertex, weighted by their angles at the vertex
+    ScratchVector<glm::vec3> tangentSums(vertexCount, glm::vec3(0));
+    ScratchVector<glm::vec3> bitangentSums(vertexCount, glm::vec3(0));
+    ScratchVector<uint32_t> indices;
+    for (const auto &primitiveIndices : group.primitives) {
+      const auto &primitive = model.meshes[primitiveIndices.first]
+                                  .primitives[primitiveIndices.second];
+      if (primitive.indices >= 0) {
+        if (!readIndexAccessor(model, bufferBytes,
+                model.accessors[primitive.indices], indices)) {
+          return;
+        }
+      } else {
+        indices.resize(vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+          indices[i] = uint32_t(i);
+        }
+      }
+      for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        const uint32_t triangle[] = {
+            indices[t], indices[t + 1], indices[t + 2]};
+        if (std::max({triangle[0], triangle[1], triangle[2]}) >=
+            vertexCount) {
+          continue;
+        }
+        const auto p0 = getPosition(triangle[0]);
+        const auto edge1 = getPosition(triangle[1]) - p0;
+        const auto edge2 = getPosition(triangle[2]) - p0;
+        const auto uv0 = getTexCoords(triangle[0]);
+        const auto deltaUv1 = getTexCoords(triangle[1]) - uv0;
+        const auto deltaUv2 = getTexCoords(triangle[2]) - uv0;
+        const auto determinant =
+            deltaUv1.x * deltaUv2.y - deltaUv2.x * deltaUv1.y;
+        if (determinant == 0.f) {
+          continue; // Degenerate in UV space, no direction to follow
+        }
+        auto tangent = (edge1 * deltaUv2.y - edge2 * deltaUv1.y) / determinant;
+        auto bitangent =
+            (edge2 * deltaUv1.x - edge1 * deltaUv2.x) / determinant;
+        const auto tangentLength = glm::length(tangent);
+        const auto bitangentLength = glm::length(bitangent);
+        if (!(tangentLength > 0.f) || !(bitangentLength > 0.f) ||
+            !std::isfinite(tangentLength) || !std::isfinite(bitangentLength)) {
+          continue;
+        }
+        tangent /= tangentLength;
+        bitangent /= bitangentLength;
+        for (auto corner = 0; corner < 3; ++corner) {
+          const auto position = getPosition(triangle[corner]);
+          const auto toNext =
+              getPosition(triangle[(corner + 1) % 3]) - position;
+          const auto toPrevious =
+              getPosition(triangle[(corner + 2) % 3]) - position;
+          const auto nextLength = glm::length(toNext);
+          const auto previousLength = glm::length(toPrevious);
+          if (!(nextLength > 0.f) || !(previousLength > 0.f)) {
+            continue;
+          }
+          const auto angle =
+              getAngle(toNext / nextLength, toPrevious / previousLength);
+          tangentSums[triangle[corner]] += angle * tangent;
+          bitangentSums[triangle[corner]] += angle * bitangent;
+        }
+      }
+    }
+
+    group.tangents.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i) {
+      auto normal =
+          glm::vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+      const auto normalLength = glm::length(normal);
+      normal = normalLength > 0.f ? normal / normalLength : glm::vec3(0, 0, 1);
+      // Gram-Schmidt, any direction in the plane of the normal if the
+      // triangles give none
+      auto tangent =
+          tangentSums[i] - glm::dot(tangentSums[i], normal) * normal;
+      const auto tangentLength = glm::length(tangent);
+      tangent = tangentLength > 1e-6f ? tangent / tangentLength
+                                      : getOrthogonal(normal);
+      const auto handedness =
+          glm::dot(glm::cross(normal, tangent), bitangentSums[i]) < 0.f ? -1.f
+                                                                        : 1.f;
+      group.tangents[i] = glm::vec4(tangent, handedness);
+    }
+  });
+
+  // Written in a new buffer, the original bytes may be a read only mapping
+  const auto bufferIdx = int(model.buffers.size());
+  tinygltf::Buffer buffer;
+  size_t primitiveCount = 0;
+  for (const auto &group : groups) {
+    if (group.tangents.empty()) {
+      continue;
+    }
+    tinygltf::BufferView bufferView;
+    bufferView.buffer = bufferIdx;
+    bufferView.byteOffset = buffer.data.size();
+    bufferView.byteLength = group.tangents.size() * sizeof(glm::vec4);
+    bufferView.target = TINYGLTF_TARGET_ARRAY_BUFFER;
+    buffer.data.resize(bufferView.byteOffset + bufferView.byteLength);
+    std::memcpy(buffer.data.data() + bufferView.byteOffset,
+        group.tangents.data(), bufferView.byteLength);
+    model.bufferViews.push_back(bufferView);
+
+    tinygltf::Accessor accessor;
+    accessor.bufferView = int(model.bufferViews.size() - 1);
+    accessor.byteOffset = 0;
+    accessor.componentType = TINYGLTF_COMPONENT_TYPE_FLOAT;
+    accessor.type = TINYGLTF_TYPE_VEC4;
+    accessor.count = group.tangents.size();
+    model.accessors.push_back(accessor);
+    for (const auto &primitiveIndices : group.primitives) {
+      model.meshes[primitiveIndices.first]
+          .primitives[primitiveIndices.second]
+          .attributes["TANGENT"] = int(model.accessors.size() - 1);
+    }
+    primitiveCount += group.primitives.size();
+  }
+  if (!primitiveCount) {
+    return 0;
+  }
+  model.buffers.push_back(std::move(buffer));
+  bufferBytes.push_back(
+      {model.buffers.back().data.data(), model.buffers.back().data.size()});
+  return primitiveCount;
+}
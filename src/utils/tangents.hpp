@@ -0,0 +1,25 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <tiny_gltf.h>
+
+#include <vector>
+
+// Generate the TANGENT attribute of the triangle primitives that have a
+// material with a normal texture, NORMAL and TEXCOORD_0 but no tangents, as
+// glTF asks viewers to. Primitives sharing their attributes share their
+// tangents, computed from all their triangles, each group on its own thread.
+//
+// The tangent of a vertex is the sum of the tangents of its triangles in the
+// UV space of its texture coordinates, weighted by the angle of the triangle
+// at the vertex, made orthogonal to the normal, with the handedness of the
+// bitangent in w (the weighting of MikkTSpace, without splitting the vertices
+// whose triangles disagree on the handedness).
+//
+// Tangents are written in a new buffer appended to model.buffers, whose bytes
+// are appended to bufferBytes, like with optimizeMeshes: the scene cache
+// stores them as any other attribute. Returns the number of primitives that
+// got tangents.
+size_t generateTangents(
+    tinygltf::Model &model, std::vector<BufferBytes> &bufferBytes);
@@ -0,0 +1,118 @@
+#include "temporal_antialiasing.hpp"
+#include "frame_accumulator.hpp"
+#include "gpu_memory.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+TemporalAntiAliasing::TemporalAntiAliasing(GLProgram resolveProgram) :
+    m_resolveProgram(std::move(resolveProgram))
+{
+  m_uViewportSize = m_resolveProgram.getUniformLocation("uViewportSize");
+  m_uHistoryScale = m_resolveProgram.getUniformLocation("uHistoryScale");
+  m_uHasHistory = m_resolveProgram.getUniformLocation("uHasHistory");
+  m_uReprojectionMatrix =
+      m_resolveProgram.getUniformLocation("uReprojectionMatrix");
+  m_uJitter = m_resolveProgram.getUniformLocation("uJitter");
+  for (const auto &unit :
+      {std::make_pair("uColor", 0), std::make_pair("uDepth", 1),
+          std::make_pair("uMotion", 2), std::make_pair("uHistory", 3),
+          std::make_pair("uDestination", 0)}) {
+    glProgramUniform1i(m_resolveProgram.glId(),
+        m_resolveProgram.getUniformLocation(unit.first), unit.second);
+  }
+}
+
+glm::mat4 TemporalAntiAliasing::beginFrame(
+    const glm::mat4 &viewProjMatrix, GLsizei width, GLsizei height)
+{
+  m_frameWidth = width;
+  m_frameHeight = height;
+  m_viewProjMatrix = viewProjMatrix;
+  if (!m_hasHistory) {
+    m_previousViewProjMatrix = viewProjMatrix;
+  }
+  // In pixels, in (-0.5, 0.5), then in normalized device coordinates.
+  // Index 0 of the sequence would be the corner of the pixel.
+  const auto index = 1 + m_frameIndex % JITTER_COUNT;
+  const auto jitter = glm::vec2(getHaltonNumber(index, 2),
+                          getHaltonNumber(index, 3)) -
+                      0.5f;
+  m_jitter = 2.f * jitter / glm::vec2(width, height);
+  return glm::translate(glm::mat4(1), glm::vec3(m_jitter, 0));
+}
+
+void TemporalAntiAliasing::resolve(
+    GLuint colorTexture, GLuint depthTexture, GLuint motionTexture)
+{
+  if (m_frameWidth > m_width || m_frameHeight > m_height) {
+    m_width = std::max(m_frameWidth, m_width);
+    m_height = std::max(m_frameHeight, m_height);
+    for (auto &texture : m_textures) {
+      texture = GLTexture::generate();
+      glBindTexture(GL_TEXTURE_2D, texture.glId());
+      glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, m_width, m_height);
+      // Reprojected texels are filtered linearly, those of the tone mapping
+      // pass fetched
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    const GLuint textures[] = {m_textures[0].glId(), m_textures[1].glId()};
+    trackTextures(
+        GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D, 2, textures);
+    m_hasHistory = false;
+  }
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  m_resolveProgram.use();
+  glUniform2i(m_uViewportSize, m_frameWidth, m_frameHeight);
+  // The history may have been drawn at another size (--target-frame-time)
+  glUniform2f(m_uHistoryScale, float(m_historyWidth) / float(m_width),
+      float(m_historyHeight) / float(m_height));
+  glUniform1i(m_uHasHistory, GLint(m_hasHistory));
+  const auto reprojectionMatrix =
+      m_previousViewProjMatrix * glm::inverse(m_viewProjMatrix);
+  glUniformMatrix4fv(
+      m_uReprojectionMatrix, 1, GL_FALSE, &reprojectionMatrix[0][0]);
+  glUniform2f(m_uJitter, m_jitter.x, m_jitter.y);
+
+  // Complete with their own parameters, not those of bound sampler objects
+  GLint previousTextures[4] = {};
+  GLint previousSamplers[4] = {};
+  const GLuint textures[] = {
+      colorTexture, depthTexture, motionTexture, texture()};
+  for (GLuint unit = 0; unit < 4; ++unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextures[unit]);
+    glGetIntegerv(GL_SAMPLER_BINDING, &previousSamplers[unit]);
+    glBindSampler(unit, 0);
+    glBindTexture(GL_TEXTURE_2D, textures[unit]);
+  }
+  m_current = 1 - m_current;
+  glBindImageTexture(
+      0, texture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+  glDispatchCompute(GLuint((m_frameWidth + 7) / 8),
+      GLuint((m_frameHeight + 7) / 8), 1);
+  // Read by the passes of ToneMapping, and by the next resolve
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+  for (GLuint unit = 0; unit < 4; ++unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindSampler(unit, GLuint(previousSamplers[unit]));
+    glBindTexture(GL_TEXTURE_2D, GLuint(previousTextures[unit]));
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glUseProgram(GLuint(previousProgram));
+
+  m_previousViewProjMatrix = m_viewProjMatrix;
+  m_historyWidth = m_frameWidth;
+  m_historyHeight = m_frameHeight;
+  m_hasHistory = true;
+  ++m_frameIndex;
+}
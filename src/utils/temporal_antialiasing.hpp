@@ -0,0 +1,77 @@
+#pragma once
+
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Temporal antialiasing of the HDR scene of ToneMapping (--taa), instead of
+// multisampling.
+//
+// Each frame is drawn with its projection offset by a subpixel jitter, from
+// a short cycle of the Halton sequence of bases 2 and 3, and the forward
+// shaders write the motion of their draws from their model matrices of the
+// previous frame. temporal_resolve.cs.glsl then reprojects the history of
+// the previous frames to the pixels of this one, from their depth and
+// motion, and blends them into the next history, a GL_RGBA16F texture that
+// the tone mapping pass reads instead of the scene. Histories are ping-ponged
+// between two textures.
+class TemporalAntiAliasing
+{
+public:
+  // Jitters of a cycle, and frames of a still view after which the history
+  // has converged
+  static const size_t JITTER_COUNT = 8;
+  static const size_t CONVERGED_FRAME_COUNT = 16;
+
+  // resolveProgram is temporal_resolve.cs.glsl, compiled with the depth
+  // conventions of the scene
+  explicit TemporalAntiAliasing(GLProgram resolveProgram);
+
+  TemporalAntiAliasing(const TemporalAntiAliasing &) = delete;
+
+  TemporalAntiAliasing &operator=(const TemporalAntiAliasing &) = delete;
+
+  // Start a width x height frame of viewProjMatrix, unjittered. Returns the
+  // matrix applied after its projection, translating it by less than half a
+  // pixel.
+  glm::mat4 beginFrame(
+      const glm::mat4 &viewProjMatrix, GLsizei width, GLsizei height);
+
+  // Unjittered view and projection of the previous frame, that of the frame
+  // begun if none was resolved
+  const glm::mat4 &previousViewProjMatrix() const
+  {
+    return m_previousViewProjMatrix;
+  }
+
+  // Blend the bottom left pixels of the frame begun, from the three textures
+  // of its framebuffer, with the history into the same pixels of texture()
+  void resolve(
+      GLuint colorTexture, GLuint depthTexture, GLuint motionTexture);
+
+  // History of the last resolve, in linear values
+  GLuint texture() const { return m_textures[m_current].glId(); }
+
+private:
+  GLProgram m_resolveProgram;
+  GLint m_uViewportSize = -1;
+  GLint m_uHistoryScale = -1;
+  GLint m_uHasHistory = -1;
+  GLint m_uReprojectionMatrix = -1;
+  GLint m_uJitter = -1;
+  GLsizei m_width = 0; // Of the textures
+  GLsizei m_height = 0;
+  GLsizei m_frameWidth = 0; // Of the frame begun
+  GLsizei m_frameHeight = 0;
+  GLsizei m_historyWidth = 0; // Of the history in texture()
+  GLsizei m_historyHeight = 0;
+  glm::mat4 m_viewProjMatrix = glm::mat4(1);
+  glm::mat4 m_previousViewProjMatrix = glm::mat4(1);
+  glm::vec2 m_jitter = glm::vec2(0); // Normalized device coordinates
+  size_t m_frameIndex = 0;
+  GLTexture m_textures[2];
+  size_t m_current = 0; // Index of texture()
+  bool m_hasHistory = false;
+};
@@ -0,0 +1,70 @@
+#include "texture_arrays.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+std::vector<TextureArrayLayer> packTextureArrays(
+    const std::vector<GLuint> &textures, std::vector<GLuint> &arrayTextures)
+{
+  // Textures of each size, format and level count, in order
+  using TextureFormat = std::tuple<GLint, GLint, GLint, GLint>;
+  std::map<TextureFormat, std::vector<size_t>> formatTextures;
+  for (size_t i = 0; i < textures.size(); ++i) {
+    if (!textures[i]) {
+      continue;
+    }
+    GLint width = 0, height = 0, internalFormat = 0, levelCount = 0;
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexLevelParameteriv(
+        GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+    // 0 for mutable textures, which only have their first level
+    glGetTexParameteriv(
+        GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+    formatTextures[TextureFormat{
+                       width, height, internalFormat, std::max(levelCount, 1)}]
+        .push_back(i);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  std::vector<TextureArrayLayer> layers(textures.size());
+  GLint maxLayerCount = 0;
+  glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayerCount);
+  for (const auto &format : formatTextures) {
+    const auto width = std::get<0>(format.first);
+    const auto height = std::get<1>(format.first);
+    const auto levelCount = std::get<3>(format.first);
+    const auto &indices = format.second;
+    for (size_t first = 0; first < indices.size();
+         first += size_t(maxLayerCount)) {
+      const auto layerCount =
+          GLsizei(std::min(indices.size() - first, size_t(maxLayerCount)));
+      GLuint arrayTexture = 0;
+      glGenTextures(1, &arrayTexture);
+      glBindTexture(GL_TEXTURE_2D_ARRAY, arrayTexture);
+      glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount,
+          GLenum(std::get<2>(format.first)), width, height, layerCount);
+      arrayTextures.push_back(arrayTexture);
+      for (GLsizei layer = 0; layer < layerCount; ++layer) {
+        const auto textureIdx = indices[first + size_t(layer)];
+        // Compressed levels are copied whole, their blocks are not split
+        for (GLint level = 0; level < levelCount; ++level) {
+          glCopyImageSubData(textures[textureIdx], GL_TEXTURE_2D, level, 0, 0,
+              0, arrayTexture, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+              std::max(width >> level, 1), std::max(height >> level, 1), 1);
+        }
+        layers[textureIdx] = TextureArrayLayer{arrayTexture, layer};
+      }
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D_ARRAY,
+      GLsizei(arrayTextures.size()), arrayTextures.data());
+
+  untrackTextures(GLsizei(textures.size()), textures.data());
+  glDeleteTextures(GLsizei(textures.size()), textures.data());
+  return layers;
+}
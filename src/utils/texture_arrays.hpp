@@ -0,0 +1,22 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// Layer of a GL_TEXTURE_2D_ARRAY a texture was copied in by packTextureArrays
+struct TextureArrayLayer
+{
+  GLuint arrayTexture = 0; // 0 for textures that were 0
+  GLint layer = 0;
+};
+
+// Copy the 2D textures of the same size, internal format and number of
+// levels in the layers of one GL_TEXTURE_2D_ARRAY (several if there are more
+// than GL_MAX_ARRAY_TEXTURE_LAYERS of them) and delete them, so that draws
+// sampling any of them bind the same texture. Textures must be distinct, or
+// 0, and have a sized internal format. Returns the layer of each texture, and
+// the array textures created in arrayTextures. Leaves GL_TEXTURE_2D and
+// GL_TEXTURE_2D_ARRAY bound to 0.
+std::vector<TextureArrayLayer> packTextureArrays(
+    const std::vector<GLuint> &textures, std::vector<GLuint> &arrayTextures);
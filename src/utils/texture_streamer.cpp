@@ -0,0 +1,167 @@
+#include "texture_streamer.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+
+GLuint copyTextureLevels(GLuint texture, GLint firstLevel)
+{
+  GLint width = 0, height = 0, internalFormat = 0, levelCount = 0;
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+  glGetTexLevelParameteriv(
+      GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+  glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_IMMUTABLE_LEVELS, &levelCount);
+  firstLevel = std::min(std::max(firstLevel, 0), levelCount - 1);
+
+  GLuint levelsTexture = 0;
+  glGenTextures(1, &levelsTexture);
+  glBindTexture(GL_TEXTURE_2D, levelsTexture);
+  glTexStorage2D(GL_TEXTURE_2D, levelCount - firstLevel, GLenum(internalFormat),
+      std::max(width >> firstLevel, 1), std::max(height >> firstLevel, 1));
+  glBindTexture(GL_TEXTURE_2D, 0);
+  for (auto level = firstLevel; level < levelCount; ++level) {
+    glCopyImageSubData(texture, GL_TEXTURE_2D, level, 0, 0, 0, levelsTexture,
+        GL_TEXTURE_2D, level - firstLevel, 0, 0, 0,
+        std::max(width >> level, 1), std::max(height >> level, 1), 1);
+  }
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &levelsTexture);
+  return levelsTexture;
+}
+
+TextureStreamer::TextureStreamer(size_t budgetBytes) :
+    m_budgetBytes(budgetBytes)
+{
+}
+
+GLint TextureStreamer::getStartLevel(
+    const std::vector<TextureLevelSize> &levels, GLsizei maxSize)
+{
+  for (size_t level = 0; level < levels.size(); ++level) {
+    if (std::max(levels[level].width, levels[level].height) <= maxSize) {
+      return GLint(level);
+    }
+  }
+  return std::max(GLint(levels.size()) - 1, 0);
+}
+
+size_t TextureStreamer::add(
+    std::vector<TextureLevelSize> levels, bool mipmapped, GLint startLevel)
+{
+  Texture texture;
+  texture.levels = std::move(levels);
+  texture.mipmapped = mipmapped;
+  texture.startLevel = texture.residentLevel = texture.requestedLevel =
+      std::min(startLevel, std::max(GLint(texture.levels.size()) - 1, 0));
+  m_residentBytes += getByteSize(texture, texture.residentLevel);
+  m_textures.push_back(std::move(texture));
+  return m_textures.size() - 1;
+}
+
+void TextureStreamer::request(size_t textureIdx, float pixelSize)
+{
+  auto &texture = m_textures[textureIdx];
+  auto level = GLint(texture.levels.size()) - 1;
+  while (level > 0 && float(std::max(texture.levels[level].width,
+                          texture.levels[level].height)) < pixelSize) {
+    --level;
+  }
+  if (texture.lastRequestFrame != m_frame) {
+    texture.lastRequestFrame = m_frame;
+    texture.requestedLevel = level;
+  } else {
+    texture.requestedLevel = std::min(texture.requestedLevel, level);
+  }
+}
+
+std::vector<TextureStreamer::ResidencyChange> TextureStreamer::update(
+    size_t maxChanges, const std::vector<bool> &busyTextures) const
+{
+  // Textures requested finer than resident, furthest first
+  std::vector<size_t> finerTextures;
+  // Textures to make room with: the least recently requested ones first,
+  // then the ones requested coarser than resident
+  std::vector<size_t> coarserTextures;
+  for (size_t i = 0; i < m_textures.size(); ++i) {
+    const auto &texture = m_textures[i];
+    if (busyTextures[i]) {
+      continue;
+    }
+    const auto requested = texture.lastRequestFrame == m_frame;
+    if (requested && texture.requestedLevel < texture.residentLevel) {
+      finerTextures.push_back(i);
+    } else if (!requested ? texture.residentLevel < texture.startLevel
+                          : texture.requestedLevel > texture.residentLevel) {
+      coarserTextures.push_back(i);
+    }
+  }
+  std::stable_sort(
+      begin(finerTextures), end(finerTextures), [&](size_t a, size_t b) {
+        const auto &textureA = m_textures[a];
+        const auto &textureB = m_textures[b];
+        return textureA.residentLevel - textureA.requestedLevel >
+               textureB.residentLevel - textureB.requestedLevel;
+      });
+  std::stable_sort(
+      begin(coarserTextures), end(coarserTextures), [&](size_t a, size_t b) {
+        return m_textures[a].lastRequestFrame < m_textures[b].lastRequestFrame;
+      });
+
+  std::vector<ResidencyChange> changes;
+  auto residentBytes = m_residentBytes;
+  size_t evictedCount = 0;
+  for (const auto textureIdx : finerTextures) {
+    const auto &texture = m_textures[textureIdx];
+    for (auto level = texture.requestedLevel;
+         level < texture.residentLevel && changes.size() < maxChanges;
+         ++level) {
+      const auto addedBytes = getByteSize(texture, level) -
+                              getByteSize(texture, texture.residentLevel);
+      while (residentBytes + addedBytes > m_budgetBytes &&
+             evictedCount < coarserTextures.size() &&
+             changes.size() + 1 < maxChanges) {
+        const auto &evicted = m_textures[coarserTextures[evictedCount]];
+        const auto evictedLevel = evicted.lastRequestFrame == m_frame
+                                      ? evicted.requestedLevel
+                                      : evicted.startLevel;
+        changes.push_back(
+            ResidencyChange{coarserTextures[evictedCount], evictedLevel});
+        residentBytes -= getByteSize(evicted, evicted.residentLevel) -
+                         getByteSize(evicted, evictedLevel);
+        ++evictedCount;
+      }
+      if (residentBytes + addedBytes <= m_budgetBytes) {
+        changes.push_back(ResidencyChange{textureIdx, level});
+        residentBytes += addedBytes;
+        break;
+      }
+    }
+    if (changes.size() >= maxChanges) {
+      break;
+    }
+  }
+  return changes;
+}
+
+void TextureStreamer::setResidentLevel(size_t textureIdx, GLint level)
+{
+  auto &texture = m_textures[textureIdx];
+  m_residentBytes -= getByteSize(texture, texture.residentLevel);
+  texture.residentLevel = level;
+  m_residentBytes += getByteSize(texture, level);
+}
+
+size_t TextureStreamer::getByteSize(const Texture &texture, GLint level) const
+{
+  if (texture.levels.empty()) {
+    return 0;
+  }
+  if (!texture.mipmapped) {
+    return texture.levels[level].byteSize;
+  }
+  size_t byteSize = 0;
+  for (auto i = size_t(level); i < texture.levels.size(); ++i) {
+    byteSize += texture.levels[i].byteSize;
+  }
+  return byteSize;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "texture_uploader.hpp"
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Texture with the levels of an immutable 2D texture from firstLevel on,
+// copied on the GPU. Leaves GL_TEXTURE_2D bound to 0.
+GLuint copyTextureLevels(GLuint texture, GLint firstLevel);
+
+// Resolution of streamed textures, kept within a budget of GPU memory.
+//
+// Textures are created at load time from a coarse start level, and frames
+// request the level their visible draws sample (see request). update() plans
+// the textures to create again from a finer level, the ones furthest from
+// their request first. When they do not fit in the budget, textures the
+// frames requested least recently go back to their start level (LRU
+// eviction), then the ones requested coarser than resident. Start levels stay
+// resident, even if they alone exceed the budget.
+//
+// Only the bookkeeping: the caller creates the textures of the planned levels
+// and reports them with setResidentLevel.
+class TextureStreamer
+{
+public:
+  struct ResidencyChange
+  {
+    size_t texture = 0;
+    GLint level = 0; // Finest level of the texture to create
+  };
+
+  explicit TextureStreamer(size_t budgetBytes);
+
+  // First level of levels at most maxSize pixels large, or the last one
+  static GLint getStartLevel(
+      const std::vector<TextureLevelSize> &levels, GLsizei maxSize);
+
+  // Add a texture with levels from level 0 (see getTextureLevelSizes), now
+  // resident from startLevel. Created from level l, a mipmapped texture
+  // holds the levels from l, other ones level l alone. Returns its index.
+  size_t add(std::vector<TextureLevelSize> levels, bool mipmapped,
+      GLint startLevel);
+
+  // Start the requests of a new frame
+  void beginFrame() { ++m_frame; }
+
+  // A visible draw of the frame samples the texture over pixelSize pixels of
+  // the screen: the coarsest level at least as large is requested
+  void request(size_t texture, float pixelSize);
+
+  // At most maxChanges changes of resident levels, skipping the textures
+  // flagged in busyTextures (a level of theirs is being created)
+  std::vector<ResidencyChange> update(
+      size_t maxChanges, const std::vector<bool> &busyTextures) const;
+
+  // The texture is now created from level
+  void setResidentLevel(size_t texture, GLint level);
+
+  GLint residentLevel(size_t texture) const
+  {
+    return m_textures[texture].residentLevel;
+  }
+
+  size_t textureCount() const { return m_textures.size(); }
+
+  size_t residentBytes() const { return m_residentBytes; }
+
+  size_t budgetBytes() const { return m_budgetBytes; }
+
+private:
+  struct Texture
+  {
+    std::vector<TextureLevelSize> levels;
+    bool mipmapped = false;
+    GLint startLevel = 0;
+    GLint residentLevel = 0;
+    GLint requestedLevel = 0; // By the frame lastRequestFrame
+    size_t lastRequestFrame = 0; // 0 if never requested
+  };
+
+  // Bytes of the texture created from level
+  size_t getByteSize(const Texture &texture, GLint level) const;
+
+  size_t m_budgetBytes;
+  size_t m_residentBytes = 0;
+  size_t m_frame = 0;
+  std::vector<Texture> m_textures;
+};
@@ -0,0 +1,732 @@
+#include "texture_uploader.hpp"
+#include "gl_extensions.hpp"
+#include "gltf.hpp"
+#include "gpu_jpeg.hpp"
+#include "gpu_memory.hpp"
+#include "ktx2.hpp"
+#include "resource_pool.hpp"
+#include "texture_streamer.hpp"
+
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+// From GL_EXT_texture_compression_s3tc, not in the core GL glad header
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+// From GL_EXT_texture_sRGB, with S3TC
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+GLsizei getMipLevelCount(GLsizei width, GLsizei height)
+{
+  GLsizei levelCount = 1;
+  for (auto size = std::max(width, height); size > 1; size /= 2) {
+    ++levelCount;
+  }
+  return levelCount;
+}
+
+namespace {
+
+GLenum getPixelFormat(int component)
+{
+  switch (component) {
+  case 1:
+    return GL_RED;
+  case 2:
+    return GL_RG;
+  case 3:
+    return GL_RGB;
+  default:
+    return GL_RGBA;
+  }
+}
+
+// With srgb, 8 and 16 bits images are stored in 8 bits sRGB formats, GL
+// converts 16 bits pixels when transferring them. Float images are linear.
+GLenum getInternalFormat(int component, int pixelType, bool srgb)
+{
+  if (srgb && pixelType != GL_FLOAT) {
+    return component == 4 ? GL_SRGB8_ALPHA8 : GL_SRGB8;
+  }
+  static const GLenum formats8[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+  static const GLenum formats16[] = {GL_R16, GL_RG16, GL_RGB16, GL_RGBA16};
+  static const GLenum formats32F[] = {
+      GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F};
+  const auto i = std::min(std::max(component, 1), 4) - 1;
+  switch (pixelType) {
+  case GL_UNSIGNED_SHORT:
+    return formats16[i];
+  case GL_FLOAT:
+    return formats32F[i];
+  default:
+    return formats8[i];
+  }
+}
+
+size_t getPixelTypeSize(int pixelType)
+{
+  switch (pixelType) {
+  case GL_UNSIGNED_SHORT:
+    return 2;
+  case GL_FLOAT:
+    return 4;
+  default:
+    return 1;
+  }
+}
+
+// GL format of a block compressed VK_FORMAT_*, or 0 if it is not supported by
+// the context. BC4 and BC5 (3.0), BC7 (4.2) and ETC2 (4.3) are core in the
+// 4.4 contexts we create, BC1 and BC3 need the S3TC extension, and
+// GL_EXT_texture_sRGB for their sRGB variants. The sRGB and UNORM variants of
+// the file are mapped to the sRGB format if srgb is true, to the UNORM one
+// otherwise: without hardware decoding, shaders decode base color textures
+// from sRGB themselves.
+GLenum getCompressedInternalFormat(uint32_t vkFormat, bool srgb)
+{
+  switch (vkFormat) {
+  case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+  case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+  case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+  case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+  case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+  case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+  {
+    static const bool hasS3tc =
+        hasGLExtension("GL_EXT_texture_compression_s3tc");
+    static const bool hasS3tcSrgb =
+        hasGLExtension("GL_EXT_texture_sRGB") ||
+        hasGLExtension("GL_EXT_texture_compression_s3tc_srgb");
+    if (!hasS3tc || (srgb && !hasS3tcSrgb)) {
+      return 0;
+    }
+    if (vkFormat <= 132) {
+      return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                  : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    if (vkFormat <= 134) {
+      return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+                  : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    }
+    return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  }
+  case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+    return GL_COMPRESSED_RED_RGTC1;
+  case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+    return GL_COMPRESSED_RG_RGTC2;
+  case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+  case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+    return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+                : GL_COMPRESSED_RGBA_BPTC_UNORM;
+  case 147: // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK
+  case 148: // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK
+    return srgb ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2;
+  case 149: // VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK
+  case 150: // VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK
+    return srgb ? GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2
+                : GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+  case 151: // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK
+  case 152: // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK
+    return srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+                : GL_COMPRESSED_RGBA8_ETC2_EAC;
+  default:
+    return 0;
+  }
+}
+
+float decodeSrgb(float value)
+{
+  return value <= 0.04045f ? value / 12.92f
+                           : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float encodeSrgb(float value)
+{
+  return value <= 0.0031308f ? 12.92f * value
+                             : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+// Stored component values to [0, 1] for integers and back, decoding and
+// encoding sRGB for color components
+template <typename T> float loadComponent(T value, bool srgb)
+{
+  if (!std::is_integral<T>::value) {
+    return float(value);
+  }
+  const auto normalized =
+      float(value) / float(std::numeric_limits<T>::max());
+  if (!srgb) {
+    return normalized;
+  }
+  if (sizeof(T) == 1) {
+    static const auto decodedBytes = []() {
+      std::array<float, 256> values;
+      for (size_t i = 0; i < values.size(); ++i) {
+        values[i] = decodeSrgb(float(i) / 255.f);
+      }
+      return values;
+    }();
+    return decodedBytes[size_t(value)];
+  }
+  return decodeSrgb(normalized);
+}
+
+template <typename T> T storeComponent(float value, bool srgb)
+{
+  if (!std::is_integral<T>::value) {
+    return T(value);
+  }
+  const auto encoded = srgb ? encodeSrgb(value) : value;
+  return T(std::min(std::max(encoded, 0.f), 1.f) *
+               float(std::numeric_limits<T>::max()) +
+           0.5f);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+// The first pixels of a row of the next level of a linear RGBA8 image, 2 by
+// 2, from the 2 rows of the level above (the same row for images 1 pixel
+// high). Rounds like storeComponent. Returns the number of pixels written.
+int halveRgba8Row(const uint8_t *row, const uint8_t *nextRow, int outWidth,
+    uint8_t *target)
+{
+  const auto zero = _mm_setzero_si128();
+  const auto two = _mm_set1_epi16(2);
+  auto x = 0;
+  for (; x + 2 <= outWidth; x += 2) {
+    // 4 pixels of each row, their components in 16 bits lanes
+    const auto top =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + 8 * x));
+    const auto bottom =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(nextRow + 8 * x));
+    const auto low = _mm_add_epi16(
+        _mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+    const auto high = _mm_add_epi16(
+        _mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+    // Horizontal pairs of pixels, in the low 4 lanes
+    const auto lowSum = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+    const auto highSum = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+    const auto sum = _mm_unpacklo_epi64(lowSum, highSum);
+    const auto average = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(target + 4 * x),
+        _mm_packus_epi16(average, zero));
+  }
+  return x;
+}
+#endif
+
+// Pixels of the next mip level of a width x height image of componentCount
+// values of type T per pixel, written to target. The first colorCount
+// components of pixels are averaged decoded from sRGB. Rows are spread over
+// the threads of the job system.
+template <typename T>
+void halveLevel(const T *source, int width, int height, int componentCount,
+    int colorCount, T *target)
+{
+  const auto outWidth = std::max(width / 2, 1);
+  const auto outHeight = std::max(height / 2, 1);
+  const auto xStep = size_t(width > 1 ? componentCount : 0);
+  const auto rowLength = size_t(width) * componentCount;
+  const auto yStep = height > 1 ? rowLength : 0;
+  JobSystem::global().parallelFor(
+      size_t(outHeight),
+      [&](size_t y) {
+        const auto *row = source + (height > 1 ? 2 * y : 0) * rowLength;
+        auto *outPixel = target + y * size_t(outWidth) * componentCount;
+        auto x = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        // Images of tinygltf are RGBA, data images are linear
+        if (std::is_same<T, uint8_t>::value && componentCount == 4 &&
+            !colorCount && xStep) {
+          x = halveRgba8Row(reinterpret_cast<const uint8_t *>(row),
+              reinterpret_cast<const uint8_t *>(row + yStep), outWidth,
+              reinterpret_cast<uint8_t *>(outPixel));
+          outPixel += size_t(x) * componentCount;
+        }
+#endif
+        for (; x < outWidth; ++x) {
+          const auto *pixel =
+              row + (width > 1 ? 2 * size_t(x) : 0) * componentCount;
+          for (int c = 0; c < componentCount; ++c) {
+            const auto srgb = c < colorCount;
+            const auto sum = loadComponent(pixel[c], srgb) +
+                             loadComponent(pixel[c + xStep], srgb) +
+                             loadComponent(pixel[c + yStep], srgb) +
+                             loadComponent(pixel[c + xStep + yStep], srgb);
+            *outPixel++ = storeComponent<T>(0.25f * sum, srgb);
+          }
+        }
+      },
+      16);
+}
+
+// halveLevel of the level of image of width x height pixels at source
+void halveImageLevel(const tinygltf::Image &image, const unsigned char *source,
+    int width, int height, bool srgb, unsigned char *target)
+{
+  const auto componentCount = std::max(image.component, 1);
+  // Alpha is linear, and so are float images
+  const auto colorCount = srgb && image.pixel_type != GL_FLOAT
+                              ? (componentCount == 4 || componentCount == 2
+                                        ? componentCount - 1
+                                        : componentCount)
+                              : 0;
+  switch (image.pixel_type) {
+  case GL_UNSIGNED_SHORT:
+    halveLevel(reinterpret_cast<const uint16_t *>(source), width, height,
+        componentCount, colorCount, reinterpret_cast<uint16_t *>(target));
+    break;
+  case GL_FLOAT:
+    halveLevel(reinterpret_cast<const float *>(source), width, height,
+        componentCount, colorCount, reinterpret_cast<float *>(target));
+    break;
+  default:
+    halveLevel(source, width, height, componentCount, colorCount, target);
+    break;
+  }
+}
+
+} // namespace
+
+std::vector<TextureLevelSize> getTextureLevelSizes(
+    const tinygltf::Image &image)
+{
+  std::vector<TextureLevelSize> levels;
+  if (isKtx2Image(image)) {
+    Ktx2Texture ktx2;
+    std::string err;
+    if (!parseKtx2(image.image.data(), image.image.size(), ktx2, err)) {
+      return levels;
+    }
+    const auto width = GLsizei(ktx2.width);
+    const auto height = GLsizei(ktx2.height);
+    const auto levelCount = std::min(
+        ktx2.levels.size(), size_t(getMipLevelCount(width, height)));
+    for (size_t level = 0; level < levelCount; ++level) {
+      levels.push_back(TextureLevelSize{std::max(width >> level, 1),
+          std::max(height >> level, 1), size_t(ktx2.levels[level].byteLength)});
+    }
+  } else if (!image.as_is && !image.image.empty()) {
+    const auto width = GLsizei(image.width);
+    const auto height = GLsizei(image.height);
+    const auto pixelSize = size_t(std::max(image.component, 1)) *
+                           getPixelTypeSize(image.pixel_type);
+    for (GLsizei level = 0; level < getMipLevelCount(width, height); ++level) {
+      const auto levelWidth = std::max(width >> level, 1);
+      const auto levelHeight = std::max(height >> level, 1);
+      levels.push_back(TextureLevelSize{levelWidth, levelHeight,
+          size_t(levelWidth) * size_t(levelHeight) * pixelSize});
+    }
+  }
+  return levels;
+}
+
+GLsizei getImageLevelCount(const tinygltf::Image &image)
+{
+  if (image.as_is || image.image.empty()) {
+    return 0;
+  }
+  const auto levels = getTextureLevelSizes(image);
+  size_t chainSize = 0;
+  for (const auto &level : levels) {
+    chainSize += level.byteSize;
+  }
+  return image.image.size() >= chainSize ? GLsizei(levels.size()) : 1;
+}
+
+void generateMipChain(tinygltf::Image &image, bool srgb)
+{
+  if (getImageLevelCount(image) != 1) {
+    return; // Not decoded, or already holding its chain
+  }
+  const auto levels = getTextureLevelSizes(image);
+  size_t chainSize = 0;
+  for (const auto &level : levels) {
+    chainSize += level.byteSize;
+  }
+  image.image.resize(chainSize);
+  size_t offset = 0;
+  for (size_t level = 1; level < levels.size(); ++level) {
+    const auto &source = levels[level - 1];
+    halveImageLevel(image, image.image.data() + offset, source.width,
+        source.height, srgb, image.image.data() + offset + source.byteSize);
+    offset += source.byteSize;
+  }
+}
+
+void generateMipChains(tinygltf::Model &model)
+{
+  const auto usages = getImageUsages(model);
+  for (size_t i = 0; i < model.images.size(); ++i) {
+    if (usages[i].generateMipmaps) {
+      generateMipChain(model.images[i], usages[i].color);
+    }
+  }
+}
+
+tinygltf::Image downsampleImage(
+    const tinygltf::Image &image, GLint level, bool srgb)
+{
+  // Not a copy of image, its pixels are only read
+  tinygltf::Image levelImage;
+  levelImage.name = image.name;
+  levelImage.component = image.component;
+  levelImage.bits = image.bits;
+  levelImage.pixel_type = image.pixel_type;
+  const auto levels = getTextureLevelSizes(image);
+  if (levels.empty()) {
+    return levelImage;
+  }
+  level = std::min(std::max(level, 0), GLint(levels.size()) - 1);
+  levelImage.width = levels[level].width;
+  levelImage.height = levels[level].height;
+  size_t offset = 0;
+  for (GLint i = 0; i < level; ++i) {
+    offset += levels[i].byteSize;
+  }
+
+  if (getImageLevelCount(image) > 1) {
+    // The level and the following ones, from the chain of image
+    levelImage.image.assign(image.image.begin() + offset, image.image.end());
+    return levelImage;
+  }
+  std::vector<unsigned char> pixels(image.image.begin(),
+      image.image.begin() + (level > 0 ? levels[0].byteSize : 0));
+  for (GLint i = 1; i <= level; ++i) {
+    std::vector<unsigned char> halvedPixels(levels[i].byteSize);
+    halveImageLevel(image, i > 1 ? pixels.data() : image.image.data(),
+        levels[i - 1].width, levels[i - 1].height, srgb, halvedPixels.data());
+    pixels = std::move(halvedPixels);
+  }
+  levelImage.image = level > 0 ? std::move(pixels) : image.image;
+  return levelImage;
+}
+
+GLsizei TextureSizeLimits::get(const ImageUsage &usage) const
+{
+  // Normal maps are read as data, but their details show as much as colors
+  const auto isData = !usage.color && usage.channels != 2;
+  if (!isData || maxDataSize <= 0) {
+    return maxSize;
+  }
+  return maxSize > 0 ? std::min(maxSize, maxDataSize) : maxDataSize;
+}
+
+bool limitImageSize(tinygltf::Image &image, GLsizei maxSize, bool srgb)
+{
+  if (maxSize <= 0 || image.as_is) {
+    return false;
+  }
+  const auto level = TextureStreamer::getStartLevel(
+      getTextureLevelSizes(image), maxSize);
+  if (level == 0) {
+    return false;
+  }
+  auto downscaled = downsampleImage(image, level, srgb);
+  image.width = downscaled.width;
+  image.height = downscaled.height;
+  image.image = std::move(downscaled.image);
+  return true;
+}
+
+size_t limitImageSizes(
+    tinygltf::Model &model, const TextureSizeLimits &limits)
+{
+  const auto usages = getImageUsages(model);
+  std::atomic<size_t> downscaledCount{0};
+  parallelFor(model.images.size(), [&](size_t i) {
+    if (usages[i].sampled &&
+        limitImageSize(
+            model.images[i], limits.get(usages[i]), usages[i].color)) {
+      ++downscaledCount;
+    }
+  });
+  return downscaledCount;
+}
+
+TextureUploader::TextureUploader(
+    size_t pixelBufferCount, GLResourcePool *pool) :
+    m_pool(pool), m_pixelBuffers(pixelBufferCount)
+{
+  for (auto &pixelBuffer : m_pixelBuffers) {
+    glGenBuffers(1, &pixelBuffer.bufferObject);
+  }
+}
+
+TextureUploader::~TextureUploader()
+{
+  for (auto &pixelBuffer : m_pixelBuffers) {
+    if (pixelBuffer.fence) {
+      glDeleteSync(pixelBuffer.fence);
+    }
+    untrackBuffers(1, &pixelBuffer.bufferObject);
+    glDeleteBuffers(1, &pixelBuffer.bufferObject);
+  }
+}
+
+GLuint TextureUploader::createTexture(
+    const tinygltf::Image &image, bool generateMipmaps, bool srgb)
+{
+  const auto width = GLsizei(image.width);
+  const auto height = GLsizei(image.height);
+  const auto format = getPixelFormat(image.component);
+  const auto levelCount = generateMipmaps ? getMipLevelCount(width, height) : 1;
+  // Levels of the chain of the image are transferred instead of generated
+  const auto levels = getTextureLevelSizes(image);
+  const auto transferredLevelCount =
+      getImageLevelCount(image) >= levelCount ? levelCount : 1;
+  size_t byteSize = 0;
+  for (GLsizei level = 0; level < transferredLevelCount; ++level) {
+    byteSize += levels[level].byteSize;
+  }
+
+  const auto textureObject = createTextureStorage(levelCount,
+      getInternalFormat(image.component, image.pixel_type, srgb), width,
+      height);
+
+  // Rows of RGB or single channel images are not 4 bytes aligned
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const auto *source = static_cast<const unsigned char *>(
+      stagePixels(image.image.data(), byteSize));
+  for (GLsizei level = 0; level < transferredLevelCount; ++level) {
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levels[level].width,
+        levels[level].height, format, image.pixel_type, source);
+    source += levels[level].byteSize;
+  }
+  endTransfer();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  if (levelCount > transferredLevelCount) {
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &textureObject);
+  return textureObject;
+}
+
+GLuint TextureUploader::beginTexture(
+    const tinygltf::Image &image, bool generateMipmaps, bool srgb)
+{
+  const auto width = GLsizei(image.width);
+  const auto height = GLsizei(image.height);
+  const auto textureObject = createTextureStorage(
+      generateMipmaps ? getMipLevelCount(width, height) : 1,
+      getInternalFormat(image.component, image.pixel_type, srgb), width,
+      height);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &textureObject);
+  return textureObject;
+}
+
+void TextureUploader::uploadTextureRows(GLuint texture,
+    const tinygltf::Image &image, GLsizei firstRow, GLsizei rowCount)
+{
+  const auto rowSize = getTextureLevelSizes(image)[0].byteSize /
+                       size_t(std::max(image.height, 1));
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const auto *source = stagePixels(
+      image.image.data() + size_t(firstRow) * rowSize,
+      size_t(rowCount) * rowSize);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, GLsizei(image.width),
+      rowCount, getPixelFormat(image.component), image.pixel_type, source);
+  endTransfer();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureUploader::endTexture(
+    GLuint texture, const tinygltf::Image &image, bool generateMipmaps)
+{
+  const auto levelCount = getMipLevelCount(image.width, image.height);
+  if (!generateMipmaps || levelCount == 1) {
+    return;
+  }
+  glBindTexture(GL_TEXTURE_2D, texture);
+  if (getImageLevelCount(image) < levelCount) {
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return;
+  }
+  // The chain of the image, after its first level
+  const auto levels = getTextureLevelSizes(image);
+  size_t byteSize = 0;
+  for (GLsizei level = 1; level < levelCount; ++level) {
+    byteSize += levels[level].byteSize;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  const auto *source = static_cast<const unsigned char *>(stagePixels(
+      image.image.data() + levels[0].byteSize, byteSize));
+  const auto format = getPixelFormat(image.component);
+  for (GLsizei level = 1; level < levelCount; ++level) {
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levels[level].width,
+        levels[level].height, format, image.pixel_type, source);
+    source += levels[level].byteSize;
+  }
+  endTransfer();
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLuint TextureUploader::createCompressedTexture(const tinygltf::Image &image,
+    std::string &err, bool srgb, GLint firstLevel)
+{
+  Ktx2Texture ktx2;
+  if (!parseKtx2(image.image.data(), image.image.size(), ktx2, err)) {
+    return 0;
+  }
+  if (ktx2.supercompressionScheme == KTX2_SUPERCOMPRESSION_BASIS_LZ ||
+      ktx2.vkFormat == 0) {
+    err = "Basis Universal transcoding is not available in this build";
+    return 0;
+  }
+  if (ktx2.supercompressionScheme != KTX2_SUPERCOMPRESSION_NONE) {
+    err = "Unsupported KTX2 supercompression scheme " +
+          std::to_string(ktx2.supercompressionScheme);
+    return 0;
+  }
+  const auto internalFormat = getCompressedInternalFormat(ktx2.vkFormat, srgb);
+  if (!internalFormat) {
+    err = "KTX2 format " + std::to_string(ktx2.vkFormat) +
+          " is not supported by the GL context";
+    return 0;
+  }
+
+  const auto width = GLsizei(ktx2.width);
+  const auto height = GLsizei(ktx2.height);
+  const auto levelCount = GLsizei(std::min(
+      ktx2.levels.size(), size_t(getMipLevelCount(width, height))));
+  firstLevel = std::min(std::max(firstLevel, 0), levelCount - 1);
+
+  const auto textureObject = createTextureStorage(levelCount - firstLevel,
+      internalFormat, std::max(width >> firstLevel, 1),
+      std::max(height >> firstLevel, 1));
+
+  // All levels are transferred with one copy of the file
+  const auto *source = static_cast<const unsigned char *>(
+      stagePixels(image.image.data(), image.image.size()));
+  for (auto level = firstLevel; level < levelCount; ++level) {
+    const auto &range = ktx2.levels[level];
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, level - firstLevel, 0, 0,
+        std::max(width >> level, 1), std::max(height >> level, 1),
+        internalFormat, GLsizei(range.byteLength), source + range.byteOffset);
+  }
+  endTransfer();
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &textureObject);
+  return textureObject;
+}
+
+GLuint TextureUploader::createJpegTexture(const tinygltf::Image &image,
+    GpuJpegDecoder &decoder, std::string &err, bool generateMipmaps,
+    bool srgb)
+{
+  int width = 0;
+  int height = 0;
+  // Leaves the decoded pixels bound to GL_PIXEL_UNPACK_BUFFER
+  if (!decoder.decode(
+          image.image.data(), image.image.size(), width, height, err)) {
+    return 0;
+  }
+  const auto levelCount =
+      generateMipmaps ? getMipLevelCount(width, height) : 1;
+  const auto textureObject = createTextureStorage(levelCount,
+      getInternalFormat(3, GL_UNSIGNED_BYTE, srgb), width, height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGB,
+      GL_UNSIGNED_BYTE, nullptr);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  decoder.endTransfer();
+
+  if (levelCount > 1) {
+    glGenerateMipmap(GL_TEXTURE_2D);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  trackTextures(GpuMemoryCategory::Textures, GL_TEXTURE_2D, 1, &textureObject);
+  return textureObject;
+}
+
+GLuint TextureUploader::createTextureStorage(GLsizei levelCount,
+    GLenum internalFormat, GLsizei width, GLsizei height)
+{
+  GLuint textureObject = 0;
+  if (m_pool) {
+    textureObject =
+        m_pool->acquireTexture(levelCount, internalFormat, width, height);
+    glBindTexture(GL_TEXTURE_2D, textureObject);
+  } else {
+    glGenTextures(1, &textureObject);
+    glBindTexture(GL_TEXTURE_2D, textureObject);
+    glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, width, height);
+  }
+  return textureObject;
+}
+
+const void *TextureUploader::stagePixels(const void *data, size_t byteSize)
+{
+  if (m_pixelBuffers.empty()) {
+    return data;
+  }
+  auto &pixelBuffer = m_pixelBuffers[m_nextPixelBuffer];
+  m_nextPixelBuffer = (m_nextPixelBuffer + 1) % m_pixelBuffers.size();
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer.bufferObject);
+  auto mapFlags = GLbitfield(GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+  if (pixelBuffer.capacity < GLsizeiptr(byteSize)) {
+    // New storage, the GPU cannot be reading it
+    glBufferData(
+        GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(byteSize), nullptr, GL_STREAM_DRAW);
+    pixelBuffer.capacity = GLsizeiptr(byteSize);
+    trackBuffers(GpuMemoryCategory::Transfers, 1, &pixelBuffer.bufferObject);
+  } else if (pixelBuffer.fence) {
+    // Only blocks if the transfer from this pixel buffer, started
+    // m_pixelBuffers.size() textures ago, is still running
+    glClientWaitSync(
+        pixelBuffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    mapFlags |= GL_MAP_UNSYNCHRONIZED_BIT;
+  }
+  if (pixelBuffer.fence) {
+    glDeleteSync(pixelBuffer.fence);
+    pixelBuffer.fence = nullptr;
+  }
+
+  auto *ptr = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(byteSize), mapFlags);
+  if (!ptr) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return data;
+  }
+  std::memcpy(ptr, data, byteSize);
+  glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  m_pStagingBuffer = &pixelBuffer;
+  return nullptr; // Offset 0 in the pixel buffer
+}
+
+void TextureUploader::endTransfer()
+{
+  if (m_pStagingBuffer) {
+    m_pStagingBuffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pStagingBuffer = nullptr;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+}
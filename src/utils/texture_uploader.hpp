@@ -0,0 +1,162 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glad/glad.h>
+#include <tiny_gltf.h>
+
+#include <string>
+#include <vector>
+
+class GLResourcePool;
+class GpuJpegDecoder;
+
+// Number of levels of a full mipmap chain for a width x height texture
+GLsizei getMipLevelCount(GLsizei width, GLsizei height);
+
+// Size of a mip level of a texture, and its bytes in GPU memory (estimated
+// from the pixels transferred)
+struct TextureLevelSize
+{
+  GLsizei width = 0;
+  GLsizei height = 0;
+  size_t byteSize = 0;
+};
+
+// Levels of the full mipmap chain of the texture of a decoded image, or the
+// levels of the KTX2 file of an image (see isKtx2Image). Empty for images
+// still encoded, or KTX2 files that cannot be parsed.
+std::vector<TextureLevelSize> getTextureLevelSizes(
+    const tinygltf::Image &image);
+
+// Number of levels the pixels of a decoded image hold: level 0, then the
+// following levels of its full mip chain if generateMipChain was called on
+// it, tightly packed. 0 for images that are not decoded.
+GLsizei getImageLevelCount(const tinygltf::Image &image);
+
+// Append the levels of its full mip chain to the pixels of a decoded image,
+// each one averaging blocks of 2x2 pixels of the previous one (2x1 or 1x2
+// once a side is 1 pixel, the last row or column of odd sides is dropped,
+// like GL level sizes). With srgb, the color components of 8 and 16 bits
+// images are averaged once decoded from sRGB, alpha and float images are
+// linear. Rows of each level are spread over the threads of the job system.
+void generateMipChain(tinygltf::Image &image, bool srgb);
+
+// generateMipChain of the decoded images of model sampled with mipmaps, in
+// sRGB for colors (see getImageUsages)
+void generateMipChains(tinygltf::Model &model);
+
+// Decoded image of mip level level of image, with the following levels if
+// image holds its chain, otherwise filtered from level 0 like
+// generateMipChain
+tinygltf::Image downsampleImage(
+    const tinygltf::Image &image, GLint level, bool srgb = false);
+
+// Largest side of the textures of images, 0 for no limit (see
+// ViewerOptions::maxTextureSize)
+struct TextureSizeLimits
+{
+  GLsizei maxSize = 0;
+  // Of images materials only read as data (occlusion, metallic roughness),
+  // lowered first by quality tiers
+  GLsizei maxDataSize = 0;
+
+  // The limit of an image sampled as usage, 0 for none
+  GLsizei get(const ImageUsage &usage) const;
+};
+
+// Replace a decoded image larger than maxSize pixels by its first mip level
+// fitting in it (see downsampleImage). Returns false if the image is not
+// decoded or already fits.
+bool limitImageSize(tinygltf::Image &image, GLsizei maxSize, bool srgb);
+
+// limitImageSize of the images of model to the limit of their usage, one
+// image per job. Returns the number of images downscaled.
+size_t limitImageSizes(
+    tinygltf::Model &model, const TextureSizeLimits &limits);
+
+// Create immutable 2D textures (glTexStorage2D) from decoded glTF images.
+//
+// With pixelBufferCount > 0, pixels are copied into a ring of pixel buffer
+// objects and transferred from there: glTexSubImage2D returns immediately and
+// the GPU reads the pixel buffer while the next images are copied into the
+// other ones. A fence is put after each transfer so that a pixel buffer is
+// only written again once the GPU is done reading it.
+// With pixelBufferCount == 0, pixels are transferred from client memory.
+// With a pool, textures of the same format and size are reused from it.
+class TextureUploader
+{
+public:
+  explicit TextureUploader(
+      size_t pixelBufferCount, GLResourcePool *pool = nullptr);
+
+  ~TextureUploader();
+
+  TextureUploader(const TextureUploader &) = delete;
+
+  TextureUploader &operator=(const TextureUploader &) = delete;
+
+  // Returns a texture with the content of image and no mipmap, or a complete
+  // mipmap chain if generateMipmaps is true: the one image holds (see
+  // generateMipChain), or one generated by the GL. With srgb, 8 and 16 bits
+  // images are sampled decoded from sRGB (see GL_SRGB8_ALPHA8). Leaves
+  // GL_TEXTURE_2D bound to 0.
+  GLuint createTexture(
+      const tinygltf::Image &image, bool generateMipmaps, bool srgb = false);
+
+  // Same for an image still holding a KTX2 file (see isKtx2Image), with the
+  // mip levels of the file from firstLevel (clamped to the last one). Block
+  // compressed payloads (BC1, BC3, BC7, ETC2) are uploaded as is. Returns 0
+  // with the reason in err if the GL context cannot sample the format, or for
+  // Basis Universal payloads: this build has no transcoder. With srgb, blocks
+  // are sampled decoded from sRGB.
+  GLuint createCompressedTexture(const tinygltf::Image &image,
+      std::string &err, bool srgb = false, GLint firstLevel = 0);
+
+  // Same for an image still holding a JPEG file (see isJpegImage), decoded
+  // by decoder in GPU memory and copied from there. Returns 0 with the
+  // reason in err if it cannot be decoded, the image can then be decoded on
+  // the CPU (see decodeImage).
+  GLuint createJpegTexture(const tinygltf::Image &image,
+      GpuJpegDecoder &decoder, std::string &err, bool generateMipmaps,
+      bool srgb = false);
+
+  // Same as createTexture in parts, for the transfer of large images to be
+  // spread over frames (see UploadScheduler): beginTexture creates the
+  // storage of the texture, uploadTextureRows transfers rows of the first
+  // level, and once all are, endTexture completes the mip chain. The
+  // texture can be sampled from then. All leave GL_TEXTURE_2D bound to 0.
+  GLuint beginTexture(
+      const tinygltf::Image &image, bool generateMipmaps, bool srgb = false);
+
+  void uploadTextureRows(GLuint texture, const tinygltf::Image &image,
+      GLsizei firstRow, GLsizei rowCount);
+
+  void endTexture(
+      GLuint texture, const tinygltf::Image &image, bool generateMipmaps);
+
+private:
+  // New texture or one of the pool, left bound to GL_TEXTURE_2D
+  GLuint createTextureStorage(GLsizei levelCount, GLenum internalFormat,
+      GLsizei width, GLsizei height);
+
+  // Returns the pointer to give to glTexSubImage2D to read data: an offset in
+  // the pixel buffer now bound to GL_PIXEL_UNPACK_BUFFER, or data itself
+  // without pixel buffers
+  const void *stagePixels(const void *data, size_t byteSize);
+
+  // To be called after the glTexSubImage2D() reading staged pixels
+  void endTransfer();
+
+  struct PixelBuffer
+  {
+    GLuint bufferObject = 0;
+    GLsizeiptr capacity = 0;
+    GLsync fence = nullptr; // Signaled when the GPU is done reading
+  };
+
+  GLResourcePool *m_pool;
+  std::vector<PixelBuffer> m_pixelBuffers;
+  size_t m_nextPixelBuffer = 0;
+  PixelBuffer *m_pStagingBuffer = nullptr;
+};
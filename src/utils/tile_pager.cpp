@@ -0,0 +1,202 @@
+#include "tile_pager.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+TilePager::TilePager(const Tileset &tileset, size_t ramBudgetBytes,
+    size_t vramBudgetBytes, float maxScreenSpaceError) :
+    m_tileset(tileset),
+    m_ramBudgetBytes(ramBudgetBytes),
+    m_vramBudgetBytes(vramBudgetBytes),
+    m_maxScreenSpaceError(maxScreenSpaceError),
+    m_tiles(tileset.tiles.size())
+{
+}
+
+void TilePager::select(const glm::mat4 &viewMatrix,
+    const glm::mat4 &projMatrix, float viewportHeight)
+{
+  ++m_frame;
+  m_requested.clear();
+  m_selected.clear();
+  m_frustum = getFrustum(projMatrix * viewMatrix);
+  m_eye = glm::vec3(glm::inverse(viewMatrix)[3]);
+  m_errorScale = 0.5f * viewportHeight * projMatrix[1][1];
+  if (!m_tiles.empty()) {
+    selectTile(0);
+  }
+  // The errors that show the most first
+  std::stable_sort(
+      begin(m_requested), end(m_requested), [&](size_t lhs, size_t rhs) {
+        return m_tiles[lhs].screenSpaceError > m_tiles[rhs].screenSpaceError;
+      });
+}
+
+bool TilePager::selectTile(size_t tileIdx)
+{
+  const auto &tile = m_tileset.tiles[tileIdx];
+  if (!intersects(m_frustum, tile.bounds)) {
+    return true;
+  }
+  auto &state = m_tiles[tileIdx];
+  // Of the nearest point of its bounds, infinite from inside them
+  const auto distance = glm::length(glm::max(
+      glm::max(tile.bounds.min - m_eye, m_eye - tile.bounds.max),
+      glm::vec3(0)));
+  const auto screenSpaceError =
+      tile.geometricError * m_errorScale /
+      std::max(distance, std::numeric_limits<float>::min());
+  const auto hasContent = !tile.content.empty() && !state.failed;
+  if (hasContent) {
+    state.lastRequestFrame = m_frame;
+    state.screenSpaceError = screenSpaceError;
+    m_requested.push_back(tileIdx);
+  }
+  // Drawn once selected, or with nothing to draw
+  const auto resident = !hasContent || state.uploaded;
+  if (tile.children.empty() || screenSpaceError <= m_maxScreenSpaceError) {
+    if (hasContent && resident) {
+      m_selected.push_back(tileIdx);
+    }
+    return resident;
+  }
+
+  if (tile.refine == TileRefine::Add) {
+    if (hasContent && resident) {
+      m_selected.push_back(tileIdx);
+    }
+    auto complete = resident;
+    for (const auto child : tile.children) {
+      complete = selectTile(size_t(child)) && complete;
+    }
+    return complete;
+  }
+
+  // Children are drawn instead of the tile once they all are resident. Until
+  // then their contents are still requested.
+  const auto firstChild = m_selected.size();
+  auto complete = true;
+  for (const auto child : tile.children) {
+    complete = selectTile(size_t(child)) && complete;
+  }
+  if (complete) {
+    return true;
+  }
+  if (hasContent && resident) {
+    m_selected.resize(firstChild);
+    m_selected.push_back(tileIdx);
+    return true;
+  }
+  return false;
+}
+
+std::vector<size_t> TilePager::getEvictionOrder(bool gpu) const
+{
+  std::vector<size_t> tiles;
+  for (size_t i = 0; i < m_tiles.size(); ++i) {
+    const auto &state = m_tiles[i];
+    const auto requested = state.lastRequestFrame == m_frame;
+    // The GL objects of uploaded tiles no longer need their content
+    if (gpu ? state.uploaded && !requested
+            : state.loaded && (state.uploaded || !requested)) {
+      tiles.push_back(i);
+    }
+  }
+  const auto getKey = [&](size_t tileIdx) {
+    const auto &state = m_tiles[tileIdx];
+    return std::make_tuple(!gpu && !state.uploaded, state.lastRequestFrame,
+        ~m_tileset.tiles[tileIdx].depth);
+  };
+  std::sort(begin(tiles), end(tiles),
+      [&](size_t lhs, size_t rhs) { return getKey(lhs) < getKey(rhs); });
+  return tiles;
+}
+
+TilePager::Plan TilePager::update(size_t maxLoads, size_t maxUploads)
+{
+  Plan plan;
+  // Uploads first, their contents must not be unloaded by the loads
+  const auto gpuEvictions = getEvictionOrder(true);
+  auto nextGpuEviction = gpuEvictions.begin();
+  for (const auto tileIdx : m_requested) {
+    auto &state = m_tiles[tileIdx];
+    if (plan.uploads.size() >= maxUploads) {
+      break;
+    }
+    if (!state.loaded || state.uploaded) {
+      continue;
+    }
+    // Contents are about the size of their GL objects
+    while (m_vramBytes + state.cpuBytes > m_vramBudgetBytes &&
+           nextGpuEviction != gpuEvictions.end()) {
+      auto &evicted = m_tiles[*nextGpuEviction];
+      evicted.uploaded = false;
+      m_vramBytes -= evicted.gpuBytes;
+      evicted.gpuBytes = 0;
+      --m_uploadedCount;
+      plan.evictions.push_back(*nextGpuEviction++);
+    }
+    if (m_vramBytes + state.cpuBytes > m_vramBudgetBytes &&
+        m_uploadedCount + plan.uploads.size() > 0) {
+      break;
+    }
+    plan.uploads.push_back(tileIdx);
+  }
+
+  const auto cpuEvictions = getEvictionOrder(false);
+  auto nextCpuEviction = cpuEvictions.begin();
+  for (const auto tileIdx : m_requested) {
+    auto &state = m_tiles[tileIdx];
+    if (m_loadingCount >= maxLoads) {
+      break;
+    }
+    if (state.loaded || state.loading || state.uploaded) {
+      continue;
+    }
+    // The size of a content is only known once loaded
+    while (m_ramBytes >= m_ramBudgetBytes &&
+           nextCpuEviction != cpuEvictions.end()) {
+      auto &unloaded = m_tiles[*nextCpuEviction];
+      unloaded.loaded = false;
+      m_ramBytes -= unloaded.cpuBytes;
+      unloaded.cpuBytes = 0;
+      plan.unloads.push_back(*nextCpuEviction++);
+    }
+    if (m_ramBytes >= m_ramBudgetBytes && m_ramBytes > 0) {
+      break;
+    }
+    state.loading = true;
+    ++m_loadingCount;
+    plan.loads.push_back(tileIdx);
+  }
+  m_idle = plan.loads.empty() && plan.uploads.empty();
+  return plan;
+}
+
+void TilePager::setLoaded(size_t tile, size_t cpuBytes)
+{
+  auto &state = m_tiles[tile];
+  state.loading = false;
+  state.loaded = true;
+  state.cpuBytes = cpuBytes;
+  m_ramBytes += cpuBytes;
+  --m_loadingCount;
+}
+
+void TilePager::setLoadFailed(size_t tile)
+{
+  auto &state = m_tiles[tile];
+  state.loading = false;
+  state.failed = true;
+  --m_loadingCount;
+}
+
+void TilePager::setUploaded(size_t tile, size_t gpuBytes)
+{
+  auto &state = m_tiles[tile];
+  state.uploaded = true;
+  state.gpuBytes = gpuBytes;
+  m_vramBytes += gpuBytes;
+  ++m_uploadedCount;
+}
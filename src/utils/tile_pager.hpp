@@ -0,0 +1,115 @@
+#pragma once
+
+#include "tileset.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Tiles of a tileset resident in CPU and GPU memory, within budgets of both,
+// for scenes too large to be loaded whole (out-of-core rendering).
+//
+// select() traverses the tileset for a view and refines the tiles whose
+// screen-space error (their geometric error projected in pixels) exceeds the
+// maximum, skipping those outside of the frustum. The tiles it visits are
+// requested, the ones it refines to are drawn once resident on the GPU: until
+// all the children of a REPLACE tile are, the tile is drawn instead, so the
+// cut drawn never has holes once the coarse tiles are resident. update()
+// plans the contents to load and the loaded tiles to upload, those of the
+// largest screen-space errors first. Contents the frames requested least
+// recently are freed to fit in the budgets (LRU eviction), the CPU contents
+// of uploaded tiles before the others. Tiles requested by the last frame are
+// never evicted, even if they alone exceed a budget.
+//
+// Only the bookkeeping: the caller loads and uploads the planned tiles, frees
+// the evicted ones, and reports their sizes.
+class TilePager
+{
+public:
+  struct Plan
+  {
+    std::vector<size_t> loads; // Tiles to load the content of in memory
+    std::vector<size_t> uploads; // Loaded tiles to create GL objects for
+    std::vector<size_t> unloads; // Tiles to free the loaded content of
+    std::vector<size_t> evictions; // Tiles to destroy the GL objects of
+  };
+
+  TilePager(const Tileset &tileset, size_t ramBudgetBytes,
+      size_t vramBudgetBytes, float maxScreenSpaceError);
+
+  // Select the tiles to draw for a view of viewportHeight pixels
+  void select(const glm::mat4 &viewMatrix, const glm::mat4 &projMatrix,
+      float viewportHeight);
+
+  // Uploaded tiles drawn by the view of the last select()
+  const std::vector<size_t> &selectedTiles() const { return m_selected; }
+
+  // At most maxLoads contents loading at the same time and maxUploads
+  // uploads. Unloads and evictions are already accounted for.
+  Plan update(size_t maxLoads, size_t maxUploads);
+
+  // The content of the tile is loaded in cpuBytes of memory
+  void setLoaded(size_t tile, size_t cpuBytes);
+
+  // The content of the tile could not be loaded, it is not requested again
+  void setLoadFailed(size_t tile);
+
+  // GL objects of the tile are created, of gpuBytes
+  void setUploaded(size_t tile, size_t gpuBytes);
+
+  // The last update() planned nothing and no content is loading: the tiles
+  // of the last select() are drawn as refined as the budgets let them be
+  bool idle() const { return m_idle && !m_loadingCount; }
+
+  size_t tileCount() const { return m_tiles.size(); }
+
+  size_t uploadedTileCount() const { return m_uploadedCount; }
+
+  size_t loadingTileCount() const { return m_loadingCount; }
+
+  size_t ramBytes() const { return m_ramBytes; }
+
+  size_t vramBytes() const { return m_vramBytes; }
+
+private:
+  struct TileState
+  {
+    bool loading = false;
+    bool loaded = false;
+    bool failed = false;
+    bool uploaded = false;
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+    size_t lastRequestFrame = 0; // 0 if never requested
+    float screenSpaceError = 0.f; // Of the last request
+  };
+
+  // Append what to draw of the tile to m_selected, returns false if part of
+  // it is not resident yet
+  bool selectTile(size_t tileIdx);
+
+  // Tiles whose content or GL objects can be freed, least recently requested
+  // and deepest first
+  std::vector<size_t> getEvictionOrder(bool gpu) const;
+
+  const Tileset &m_tileset;
+  size_t m_ramBudgetBytes;
+  size_t m_vramBudgetBytes;
+  float m_maxScreenSpaceError;
+
+  std::vector<TileState> m_tiles;
+  size_t m_frame = 0;
+  std::vector<size_t> m_requested; // Tiles with content, by the last frame
+  std::vector<size_t> m_selected;
+  size_t m_ramBytes = 0;
+  size_t m_vramBytes = 0;
+  size_t m_loadingCount = 0;
+  size_t m_uploadedCount = 0;
+  bool m_idle = false;
+
+  // Of the view of select()
+  Frustum m_frustum;
+  glm::vec3 m_eye = glm::vec3(0);
+  float m_errorScale = 0.f; // Pixels of a unit at a distance of 1
+};
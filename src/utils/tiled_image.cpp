@@ -0,0 +1,65 @@
+#include "tiled_image.hpp"
+#include "image_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+TiledImageRenderer::TiledImageRenderer(size_t width, size_t height,
+    size_t tileSize, bool floatPixels, size_t sampleCount) :
+    m_framebuffer(
+        tileSize, tileSize, getOffscreenColorFormat(floatPixels), sampleCount),
+    m_width(width),
+    m_height(height),
+    m_tileSize(tileSize),
+    m_pixelSize(m_framebuffer.colorPixelSize()),
+    m_tilePixels(tileSize * tileSize * m_pixelSize),
+    m_bandPixels(width * tileSize * m_pixelSize)
+{
+}
+
+bool TiledImageRenderer::render(const fs::path &outputPath,
+    const std::function<void(const glm::mat4 &)> &drawTile)
+{
+  ImageFileWriter writer(outputPath, m_width, m_height);
+  if (!writer.isOpen()) {
+    return false;
+  }
+
+  // Bands from the top of the image, the first one may be cut by its top
+  const auto bandCount = (m_height + m_tileSize - 1) / m_tileSize;
+  const auto bandRowSize = m_width * m_pixelSize;
+  const auto tileRowSize = m_tileSize * m_pixelSize;
+  for (auto band = bandCount; band-- > 0;) {
+    const auto y = band * m_tileSize;
+    const auto rowCount = std::min(m_tileSize, m_height - y);
+    for (size_t x = 0; x < m_width; x += m_tileSize) {
+      const auto tileMatrix =
+          getTileMatrix(m_width, m_height, x, y, m_tileSize);
+      m_framebuffer.render([&]() { drawTile(tileMatrix); });
+      m_framebuffer.readColor(m_tilePixels.data());
+      // Both are bottom-up, the band starts at the bottom row of the tile
+      const auto columnSize = std::min(m_tileSize, m_width - x) * m_pixelSize;
+      for (size_t row = 0; row < rowCount; ++row) {
+        std::memcpy(m_bandPixels.data() + row * bandRowSize + x * m_pixelSize,
+            m_tilePixels.data() + row * tileRowSize, columnSize);
+      }
+    }
+    if (!writer.writeRows(m_bandPixels.data(), rowCount, true)) {
+      return false;
+    }
+  }
+  return writer.finish();
+}
+
+glm::mat4 getTileMatrix(
+    size_t width, size_t height, size_t x, size_t y, size_t tileSize)
+{
+  // Scale the tile to [-1, 1] and move its center to the origin
+  const auto size = float(tileSize);
+  glm::mat4 matrix(1);
+  matrix[0][0] = float(width) / size;
+  matrix[1][1] = float(height) / size;
+  matrix[3][0] = (float(width) - 2.f * float(x) - size) / size;
+  matrix[3][1] = (float(height) - 2.f * float(y) - size) / size;
+  return matrix;
+}
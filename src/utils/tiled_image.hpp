@@ -0,0 +1,48 @@
+#pragma once
+
+#include "filesystem.hpp"
+#include "images.hpp"
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+// Render images of any size, beyond GL_MAX_TEXTURE_SIZE, in square tiles of
+// tileSize pixels drawn one by one in a single OffscreenFramebuffer. Each row
+// of tiles is a band of the image, written to the file with ImageFileWriter
+// (see image_writer.hpp) before the next one renders: memory is bounded by a
+// tile on the GPU and a band on the CPU.
+//
+// A tile is drawn with the projection of the whole image followed by the
+// matrix of getTileMatrix. Tiles of the right column and top row extend past
+// the image, what is outside is drawn but not written.
+class TiledImageRenderer
+{
+public:
+  // Tiles are antialiased with a sampleCount above 1 (see
+  // OffscreenFramebuffer)
+  TiledImageRenderer(size_t width, size_t height, size_t tileSize,
+      bool floatPixels = false, size_t sampleCount = 1);
+
+  // Call drawTile(tileMatrix) for every tile, with the same requirements on
+  // drawTile as drawScene for renderToImage and a tileSize x tileSize
+  // viewport. Returns false if the image can not be written.
+  bool render(const fs::path &outputPath,
+      const std::function<void(const glm::mat4 &)> &drawTile);
+
+private:
+  OffscreenFramebuffer m_framebuffer;
+  size_t m_width;
+  size_t m_height;
+  size_t m_tileSize;
+  size_t m_pixelSize; // In bytes
+  std::vector<unsigned char> m_tilePixels;
+  std::vector<unsigned char> m_bandPixels; // Bottom row first
+};
+
+// Matrix mapping the clip space of an image of width x height pixels to that
+// of its tileSize x tileSize pixels with their bottom left corner at pixel
+// (x, y), from the bottom left corner of the image
+glm::mat4 getTileMatrix(
+    size_t width, size_t height, size_t x, size_t y, size_t tileSize);
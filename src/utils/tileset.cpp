@@ -0,0 +1,212 @@
+#include "tileset.hpp"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// Nesting of external tilesets read, deeper ones are not
+const size_t MAX_EXTERNAL_TILESET_DEPTH = 16;
+
+// 3D Tiles are z-up, glTF and the viewer y-up (the matrices are columns)
+const glm::mat4 Z_UP_TO_Y_UP(
+    1, 0, 0, 0, 0, 0, -1, 0, 0, 1, 0, 0, 0, 0, 0, 1);
+const glm::mat4 Y_UP_TO_Z_UP(
+    1, 0, 0, 0, 0, 0, 1, 0, 0, -1, 0, 0, 0, 0, 0, 1);
+
+std::string getLowerExtension(const fs::path &path)
+{
+  auto extension = path.extension().string();
+  std::transform(begin(extension), end(extension), begin(extension),
+      [](unsigned char c) { return char(std::tolower(c)); });
+  return extension;
+}
+
+nlohmann::json readJsonFile(const fs::path &path)
+{
+  std::ifstream file(path.string(), std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("unable to read " + path.string());
+  }
+  auto json = nlohmann::json::parse(file, nullptr, false);
+  if (json.is_discarded()) {
+    throw std::runtime_error(path.string() + " is not valid JSON");
+  }
+  return json;
+}
+
+std::vector<float> readNumbers(
+    const nlohmann::json &object, const char *name, size_t count)
+{
+  const auto it = object.find(name);
+  if (it == object.end() || !it->is_array() || it->size() != count) {
+    throw std::runtime_error(std::string("\"") + name + "\" is not " +
+                             std::to_string(count) + " numbers");
+  }
+  std::vector<float> numbers;
+  for (const auto &number : *it) {
+    numbers.push_back(number.get<float>());
+  }
+  return numbers;
+}
+
+glm::mat4 readTransform(const nlohmann::json &tile)
+{
+  glm::mat4 matrix(1);
+  if (tile.count("transform")) {
+    const auto numbers = readNumbers(tile, "transform", 16);
+    for (size_t i = 0; i < 16; ++i) {
+      matrix[i / 4][i % 4] = numbers[i];
+    }
+  }
+  return matrix;
+}
+
+// Box containing a bounding volume transformed by matrix
+BoundingBox readBoundingVolume(
+    const nlohmann::json &volume, const glm::mat4 &matrix)
+{
+  if (volume.count("box")) {
+    // Center, then the half axes of an oriented box
+    const auto numbers = readNumbers(volume, "box", 12);
+    const auto center =
+        glm::vec3(matrix * glm::vec4(numbers[0], numbers[1], numbers[2], 1));
+    glm::vec3 halfExtent(0);
+    for (size_t i = 1; i < 4; ++i) {
+      halfExtent += glm::abs(glm::vec3(matrix *
+          glm::vec4(numbers[3 * i], numbers[3 * i + 1], numbers[3 * i + 2],
+              0)));
+    }
+    return {center - halfExtent, center + halfExtent};
+  }
+  if (volume.count("sphere")) {
+    const auto numbers = readNumbers(volume, "sphere", 4);
+    const auto center =
+        glm::vec3(matrix * glm::vec4(numbers[0], numbers[1], numbers[2], 1));
+    const auto scale = std::max({glm::length(glm::vec3(matrix[0])),
+        glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))});
+    const auto radius = glm::vec3(numbers[3] * scale);
+    return {center - radius, center + radius};
+  }
+  if (volume.count("region")) {
+    throw std::runtime_error("region bounding volumes are not supported");
+  }
+  throw std::runtime_error("bounding volume is neither a box nor a sphere");
+}
+
+class TilesetReader
+{
+public:
+  Tileset tileset;
+  size_t skippedContents = 0; // Neither glTF, glb nor tilesets
+
+  // Append the tile and its descendants, returns its index
+  int readTile(const nlohmann::json &json, const fs::path &baseDir,
+      const glm::mat4 &parentMatrix, int parent, TileRefine parentRefine,
+      size_t externalDepth)
+  {
+    auto &tiles = tileset.tiles;
+    const auto matrix = parentMatrix * readTransform(json);
+    Tile tile;
+    tile.parent = parent;
+    tile.depth = parent >= 0 ? tiles[parent].depth + 1 : 0;
+    const auto volume = json.find("boundingVolume");
+    if (volume == json.end()) {
+      throw std::runtime_error("tile without bounding volume");
+    }
+    tile.bounds = readBoundingVolume(*volume, Z_UP_TO_Y_UP * matrix);
+    tile.geometricError = json.value("geometricError", 0.f);
+    tile.refine = parentRefine;
+    const auto refine = json.find("refine");
+    if (refine != json.end() && refine->is_string()) {
+      // Upper case in 3D Tiles 1.0 and later, any case before
+      auto value = refine->get<std::string>();
+      std::transform(begin(value), end(value), begin(value),
+          [](unsigned char c) { return char(std::toupper(c)); });
+      tile.refine = value == "ADD" ? TileRefine::Add : TileRefine::Replace;
+    }
+    tile.contentMatrix = Z_UP_TO_Y_UP * matrix * Y_UP_TO_Z_UP;
+    const auto tileIdx = int(tiles.size());
+    tiles.push_back(tile);
+
+    std::string uri;
+    const auto content = json.find("content");
+    if (content != json.end() && content->is_object()) {
+      // "url" before 3D Tiles 1.0
+      uri = content->value("uri", content->value("url", std::string()));
+    }
+    if (!uri.empty()) {
+      const auto path = baseDir / uri;
+      const auto extension = getLowerExtension(path);
+      if (extension == ".gltf" || extension == ".glb") {
+        tiles[tileIdx].content = path;
+      } else if (extension == ".json" &&
+                 externalDepth < MAX_EXTERNAL_TILESET_DEPTH) {
+        // An external tileset, whose root is the only child of the tile
+        const auto external = readJsonFile(path);
+        const auto root = external.find("root");
+        if (root == external.end() || !root->is_object()) {
+          throw std::runtime_error(path.string() + " has no root tile");
+        }
+        const auto childIdx = readTile(*root, path.parent_path(), matrix,
+            tileIdx, tiles[tileIdx].refine, externalDepth + 1);
+        tiles[tileIdx].children.push_back(childIdx);
+      } else {
+        ++skippedContents;
+      }
+    }
+
+    const auto children = json.find("children");
+    if (children != json.end() && children->is_array()) {
+      for (const auto &child : *children) {
+        const auto childIdx = readTile(child, baseDir, matrix, tileIdx,
+            tiles[tileIdx].refine, externalDepth);
+        tiles[tileIdx].children.push_back(childIdx);
+      }
+    }
+    return tileIdx;
+  }
+};
+
+} // namespace
+
+bool isTilesetFile(const fs::path &path)
+{
+  return getLowerExtension(path) == ".json";
+}
+
+Tileset loadTileset(const fs::path &path)
+{
+  TilesetReader reader;
+  try {
+    const auto json = readJsonFile(path);
+    const auto root = json.find("root");
+    if (root == json.end() || !root->is_object()) {
+      throw std::runtime_error("no root tile");
+    }
+    reader.readTile(
+        *root, path.parent_path(), glm::mat4(1), -1, TileRefine::Replace, 0);
+  } catch (const std::exception &e) {
+    throw std::runtime_error(
+        "unable to read tileset " + path.string() + ": " + e.what());
+  }
+  if (reader.skippedContents) {
+    std::cerr << "Warning : " << reader.skippedContents
+              << " tiles of content other than glTF, glb and tilesets are "
+                 "drawn without it"
+              << std::endl;
+  }
+  // Bounds of tiles contain their descendants, for them to be culled with
+  // their parents
+  auto &tiles = reader.tileset.tiles;
+  for (auto i = tiles.size(); i-- > 1;) {
+    tiles[size_t(tiles[i].parent)].bounds.extend(tiles[i].bounds);
+  }
+  return std::move(reader.tileset);
+}
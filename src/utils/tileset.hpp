@@ -0,0 +1,50 @@
+#pragma once
+
+#include "bounds.hpp"
+#include "filesystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// How the content of the children of a tile combines with its own: REPLACE
+// draws the children instead of the tile, ADD draws them with it
+enum class TileRefine
+{
+  Replace,
+  Add
+};
+
+// A tile of a 3D Tiles tileset, in the y-up space of the viewer
+struct Tile
+{
+  BoundingBox bounds; // Of the tile and its descendants
+  // In the units of the tileset, of drawing the tile instead of its children
+  float geometricError = 0.f;
+  TileRefine refine = TileRefine::Replace;
+  fs::path content; // glTF or glb file of the tile, empty if it has none
+  // From content to the viewer: transforms of the tile and its ancestors,
+  // between the y-up glTF axes and the z-up axes of 3D Tiles
+  glm::mat4 contentMatrix = glm::mat4(1);
+  int parent = -1;
+  std::vector<int> children; // Indices in Tileset::tiles
+  size_t depth = 0; // 0 for the root
+};
+
+// Hierarchy of tiles, each holding a chunk of a scene at the level of detail
+// of its geometric error (hierarchical LOD), its children split its bounds at
+// finer levels (an octree or any spatial subdivision).
+struct Tileset
+{
+  std::vector<Tile> tiles; // The root first, parents before their children
+};
+
+// True for .json files, read as tilesets by loadTileset
+bool isTilesetFile(const fs::path &path);
+
+// Read a 3D Tiles tileset.json and the external tilesets its tiles reference
+// as content. Bounding volumes are boxes or spheres, tiles with a region are
+// unsupported. Contents are glTF and glb files, tiles with another content
+// (b3dm, pnts...) are kept without it, with a warning. Throws
+// std::runtime_error if the file cannot be read or is not a tileset.
+Tileset loadTileset(const fs::path &path);
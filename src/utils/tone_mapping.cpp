@@ -0,0 +1,186 @@
+#include "tone_mapping.hpp"
+#include "gpu_memory.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+// Bins of the histogram of luminance_histogram.cs.glsl, the size of a
+// workgroup of both compute shaders
+const GLsizei HISTOGRAM_BIN_COUNT = 256;
+
+GLTexture createTexture(GLenum format, GLsizei width, GLsizei height)
+{
+  auto textureObject = GLTexture::generate();
+  glBindTexture(GL_TEXTURE_2D, textureObject.glId());
+  glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+  // Only read with texelFetch, but must be complete for it
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return textureObject;
+}
+
+} // namespace
+
+ToneMapping::ToneMapping(GLProgram histogramProgram,
+    GLProgram exposureProgram, GLProgram toneMappingProgram,
+    std::unique_ptr<Bloom> bloom, TemporalAntiAliasing *temporalAntiAliasing) :
+    m_histogramProgram(std::move(histogramProgram)),
+    m_exposureProgram(std::move(exposureProgram)),
+    m_toneMappingProgram(std::move(toneMappingProgram)),
+    m_exposureBuffer(GLBuffer::generate()),
+    m_emptyVertexArray(GLVertexArray::generate()),
+    m_bloom(std::move(bloom)),
+    m_temporalAntiAliasing(temporalAntiAliasing)
+{
+  for (const auto *program :
+      {&m_histogramProgram, &m_exposureProgram, &m_toneMappingProgram}) {
+    const auto blockIndex = glGetProgramResourceIndex(
+        program->glId(), GL_SHADER_STORAGE_BLOCK, "Exposure");
+    if (blockIndex != GL_INVALID_INDEX) {
+      glShaderStorageBlockBinding(
+          program->glId(), blockIndex, EXPOSURE_BINDING);
+    }
+  }
+  m_uHistogramViewportSize =
+      m_histogramProgram.getUniformLocation("uViewportSize");
+  m_uEncodeOutput = m_toneMappingProgram.getUniformLocation("uEncodeOutput");
+  m_uBloomSize = m_toneMappingProgram.getUniformLocation("uBloomSize");
+  m_uBloomLevelCount =
+      m_toneMappingProgram.getUniformLocation("uBloomLevelCount");
+  for (const auto *program : {&m_histogramProgram, &m_toneMappingProgram}) {
+    glProgramUniform1i(
+        program->glId(), program->getUniformLocation("uColor"), 0);
+  }
+  glProgramUniform1i(m_toneMappingProgram.glId(),
+      m_toneMappingProgram.getUniformLocation("uDepth"), 1);
+  glProgramUniform1i(m_toneMappingProgram.glId(),
+      m_toneMappingProgram.getUniformLocation("uBloom"), 2);
+
+  // Exposure then bins, all cleared: the first measure replaces the exposure
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_exposureBuffer.glId());
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER,
+      (1 + HISTOGRAM_BIN_COUNT) * sizeof(GLuint), nullptr,
+      GL_DYNAMIC_STORAGE_BIT);
+  const GLuint zero = 0;
+  glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER,
+      GL_UNSIGNED_INT, &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  const auto exposureBuffer = m_exposureBuffer.glId();
+  trackBuffers(GpuMemoryCategory::RenderTargets, 1, &exposureBuffer);
+}
+
+void ToneMapping::createTargets()
+{
+  m_colorTexture = createTexture(GL_RGBA16F, m_width, m_height);
+  m_depthTexture = createTexture(GL_DEPTH_COMPONENT32F, m_width, m_height);
+  if (m_temporalAntiAliasing) {
+    m_motionTexture = createTexture(GL_RG16F, m_width, m_height);
+  }
+
+  GLint previousFramebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  m_framebuffer = GLFramebuffer::generate();
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_colorTexture.glId(), 0);
+  glFramebufferTexture(
+      GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_depthTexture.glId(), 0);
+  if (m_temporalAntiAliasing) {
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+        m_motionTexture.glId(), 0);
+    const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+    glDrawBuffers(2, drawBuffers);
+  }
+  const auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(previousFramebuffer));
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    throw std::runtime_error("ToneMapping: incomplete framebuffer");
+  }
+  const GLuint textures[] = {
+      m_colorTexture.glId(), m_depthTexture.glId(), m_motionTexture.glId()};
+  trackTextures(GpuMemoryCategory::RenderTargets, GL_TEXTURE_2D,
+      m_temporalAntiAliasing ? 3 : 2, textures);
+}
+
+void ToneMapping::bindFramebuffer(GLsizei width, GLsizei height)
+{
+  if (width > m_width || height > m_height) {
+    m_width = std::max(width, m_width);
+    m_height = std::max(height, m_height);
+    createTargets();
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer.glId());
+}
+
+void ToneMapping::resolve(GLuint targetFramebuffer, GLsizei width,
+    GLsizei height, bool encodeOutput, bool measureExposure)
+{
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  if (m_temporalAntiAliasing) {
+    m_temporalAntiAliasing->resolve(m_colorTexture.glId(),
+        m_depthTexture.glId(), m_motionTexture.glId());
+  }
+  if (m_bloom) {
+    m_bloom->compute(colorTexture(), width, height);
+  }
+  // Color on unit 0, depth on unit 1 and bloom on unit 2, complete with
+  // their own parameters, not those of bound sampler objects
+  GLint previousTextures[3] = {};
+  GLint previousSamplers[3] = {};
+  const GLuint textures[] = {colorTexture(), m_depthTexture.glId(),
+      m_bloom ? m_bloom->texture() : 0};
+  for (GLuint unit = 0; unit < 3; ++unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextures[unit]);
+    glGetIntegerv(GL_SAMPLER_BINDING, &previousSamplers[unit]);
+    glBindSampler(unit, 0);
+    glBindTexture(GL_TEXTURE_2D, textures[unit]);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindBufferBase(
+      GL_SHADER_STORAGE_BUFFER, EXPOSURE_BINDING, m_exposureBuffer.glId());
+
+  if (measureExposure || !m_hasExposure) {
+    m_histogramProgram.use();
+    glUniform2i(m_uHistogramViewportSize, width, height);
+    glDispatchCompute(
+        GLuint((width + 15) / 16), GLuint((height + 15) / 16), 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    // Also clears the bins for the next measure
+    m_exposureProgram.use();
+    glDispatchCompute(1, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    m_hasExposure = true;
+  }
+
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFramebuffer);
+  m_toneMappingProgram.use();
+  glUniform1i(m_uEncodeOutput, GLint(encodeOutput));
+  if (m_bloom) {
+    const auto bloomSize = Bloom::getLevelSize(width, height, 0);
+    glUniform2i(m_uBloomSize, bloomSize.x, bloomSize.y);
+    glUniform1i(m_uBloomLevelCount, m_bloom->levelCount());
+  }
+  // Depths are copied as they are, whatever the depth test of the scene
+  GLint previousDepthFunc = GL_LESS;
+  glGetIntegerv(GL_DEPTH_FUNC, &previousDepthFunc);
+  GLint previousVertexArray = 0;
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+  glDepthFunc(GL_ALWAYS);
+  glBindVertexArray(m_emptyVertexArray.glId());
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(GLuint(previousVertexArray));
+  glDepthFunc(GLenum(previousDepthFunc));
+
+  for (GLuint unit = 0; unit < 3; ++unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindSampler(unit, GLuint(previousSamplers[unit]));
+    glBindTexture(GL_TEXTURE_2D, GLuint(previousTextures[unit]));
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glUseProgram(GLuint(previousProgram));
+}
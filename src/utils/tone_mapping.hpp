@@ -0,0 +1,92 @@
+#pragma once
+
+#include "bloom.hpp"
+#include "gl_objects.hpp"
+#include "shaders.hpp"
+#include "temporal_antialiasing.hpp"
+
+#include <glad/glad.h>
+
+#include <memory>
+
+// High dynamic range rendering with auto-exposure (--hdr).
+//
+// The scene is drawn in linear values into an offscreen framebuffer with a
+// GL_RGBA16F color texture, so lights brighter than 1 no longer clip.
+// resolve() bins the log2 luminance of its pixels into a histogram with
+// luminance_histogram.cs.glsl, reduces it to an exposure in a single
+// workgroup of adapt_exposure.cs.glsl, then draws the exposed colors through
+// an ACES filmic curve into the target framebuffer in one full-screen pass of
+// tone_mapping.fs.glsl, along with their depth. The exposure stays on the
+// GPU: no pixel nor histogram is read back. With a Bloom, its blur of the
+// scene is mixed in by the same pass. With a TemporalAntiAliasing, the
+// framebuffer also has a GL_RG16F attachment for the motion vectors of the
+// draws, and the passes read its history instead of the scene.
+//
+// The exposure of a frame is the one of its own histogram, not adapted over
+// several frames: the viewer draws frames on demand, an adaptation would
+// stop half way with them.
+class ToneMapping
+{
+public:
+  // Storage buffer of the exposure and histogram, after those of
+  // GpuReduction
+  static const GLuint EXPOSURE_BINDING = 19;
+
+  // Of the three shaders, tone_mapping.fs.glsl being linked with
+  // fullscreen_triangle.vs.glsl, and compiled with BLOOM for a bloom. The
+  // temporal antialiasing, if any, is not owned.
+  ToneMapping(GLProgram histogramProgram, GLProgram exposureProgram,
+      GLProgram toneMappingProgram, std::unique_ptr<Bloom> bloom = nullptr,
+      TemporalAntiAliasing *temporalAntiAliasing = nullptr);
+
+  ToneMapping(const ToneMapping &) = delete;
+
+  ToneMapping &operator=(const ToneMapping &) = delete;
+
+  // Bind the framebuffer the scene must be drawn in, in its bottom left
+  // width x height pixels. Its textures grow to that size if smaller. Motion
+  // vectors are written to its draw buffer 1, if any.
+  void bindFramebuffer(GLsizei width, GLsizei height);
+
+  // Draw the bottom left width x height pixels of the scene, exposed and tone
+  // mapped, to the same pixels of targetFramebuffer, left bound to
+  // GL_DRAW_FRAMEBUFFER. With measureExposure, or before the first measure,
+  // the exposure is measured from these pixels, else the previous one is
+  // kept (for the tiles of an image). Colors are sRGB encoded with
+  // encodeOutput, else by the framebuffer. With a temporal antialiasing,
+  // these pixels are those of the frame it began.
+  void resolve(GLuint targetFramebuffer, GLsizei width, GLsizei height,
+      bool encodeOutput, bool measureExposure);
+
+  // GL_RGBA16F texture of the scene of the last resolve, in linear values,
+  // antialiased by its temporal antialiasing if any
+  GLuint colorTexture() const
+  {
+    return m_temporalAntiAliasing ? m_temporalAntiAliasing->texture()
+                                  : m_colorTexture.glId();
+  }
+
+private:
+  // Textures and framebuffer of the current size
+  void createTargets();
+
+  GLProgram m_histogramProgram;
+  GLProgram m_exposureProgram;
+  GLProgram m_toneMappingProgram;
+  GLint m_uHistogramViewportSize = -1;
+  GLint m_uEncodeOutput = -1;
+  GLint m_uBloomSize = -1;
+  GLint m_uBloomLevelCount = -1;
+  GLsizei m_width = 0;
+  GLsizei m_height = 0;
+  GLTexture m_colorTexture;
+  GLTexture m_depthTexture;
+  GLTexture m_motionTexture; // With m_temporalAntiAliasing
+  GLFramebuffer m_framebuffer;
+  GLBuffer m_exposureBuffer;
+  GLVertexArray m_emptyVertexArray;
+  std::unique_ptr<Bloom> m_bloom;
+  TemporalAntiAliasing *m_temporalAntiAliasing = nullptr;
+  bool m_hasExposure = false;
+};
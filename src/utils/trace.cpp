@@ -0,0 +1,146 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Zone
+{
+  const char *name;
+  int64_t begin; // Nanoseconds since startTracing
+  int64_t end;
+};
+
+// Ring of the zones of a thread, zones[i % size] for i in
+// [count - size, count)
+struct ThreadZones
+{
+  size_t threadId;
+  std::vector<Zone> zones; // Grows up to the ring size, then wraps
+  std::atomic<size_t> count{0};
+};
+
+std::atomic<bool> tracing{false};
+thread_local const char *currentZone = nullptr;
+size_t ringSize = 0;
+std::chrono::steady_clock::time_point startTime;
+
+// Rings of all threads that recorded a zone. They outlive their thread, a
+// thread registers its ring once, under the mutex.
+std::mutex threadsMutex;
+std::vector<std::unique_ptr<ThreadZones>> threads;
+
+ThreadZones &getThreadZones()
+{
+  thread_local ThreadZones *threadZones = nullptr;
+  if (!threadZones) {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    threads.push_back(std::make_unique<ThreadZones>());
+    threadZones = threads.back().get();
+    threadZones->threadId = threads.size();
+    threadZones->zones.reserve(std::min(ringSize, size_t(1024)));
+  }
+  return *threadZones;
+}
+
+int64_t getTraceTime(std::chrono::steady_clock::time_point time)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(time - startTime)
+      .count();
+}
+
+// JSON string content, names are identifiers in practice
+void writeJsonString(std::ostream &output, const char *string)
+{
+  output << '"';
+  for (const auto *c = string; *c; ++c) {
+    if (*c == '"' || *c == '\\') {
+      output << '\\';
+    }
+    if (static_cast<unsigned char>(*c) >= 0x20) {
+      output << *c;
+    }
+  }
+  output << '"';
+}
+
+} // namespace
+
+void startTracing(size_t zonesPerThread)
+{
+  ringSize = std::max(zonesPerThread, size_t(1));
+  startTime = std::chrono::steady_clock::now();
+  tracing = true;
+}
+
+bool isTracing() { return tracing.load(std::memory_order_relaxed); }
+
+const char *getCurrentTraceZone() { return currentZone; }
+
+TraceZone::TraceZone(const char *name) :
+    m_name(name), m_parent(currentZone), m_recorded(isTracing())
+{
+  currentZone = name;
+  if (m_recorded) {
+    m_begin = std::chrono::steady_clock::now();
+  }
+}
+
+void TraceZone::end()
+{
+  if (!m_name) {
+    return;
+  }
+  currentZone = m_parent;
+  if (!m_recorded) {
+    m_name = nullptr;
+    return;
+  }
+  const auto end = std::chrono::steady_clock::now();
+  auto &threadZones = getThreadZones();
+  const auto count = threadZones.count.load(std::memory_order_relaxed);
+  const Zone zone{m_name, getTraceTime(m_begin), getTraceTime(end)};
+  if (threadZones.zones.size() < ringSize) {
+    threadZones.zones.push_back(zone);
+  } else {
+    threadZones.zones[count % ringSize] = zone;
+  }
+  // Publish the zone to writeTrace
+  threadZones.count.store(count + 1, std::memory_order_release);
+  m_name = nullptr;
+}
+
+bool writeTrace(const fs::path &path)
+{
+  std::ofstream output(path.string());
+  if (!output) {
+    return false;
+  }
+  // Complete events, in microseconds
+  output << std::fixed << std::setprecision(3);
+  output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto isFirstEvent = true;
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (const auto &threadZones : threads) {
+    const auto count = threadZones->count.load(std::memory_order_acquire);
+    const auto first = count > ringSize ? count - ringSize : size_t(0);
+    for (auto i = first; i < count; ++i) {
+      const auto &zone = threadZones->zones[i % ringSize];
+      output << (isFirstEvent ? "\n" : ",\n") << "{\"name\":";
+      writeJsonString(output, zone.name);
+      output << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadZones->threadId
+             << ",\"ts\":" << double(zone.begin) * 1e-3
+             << ",\"dur\":" << double(zone.end - zone.begin) * 1e-3 << "}";
+      isFirstEvent = false;
+    }
+  }
+  output << "\n]}\n";
+  return bool(output);
+}
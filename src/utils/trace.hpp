@@ -0,0 +1,50 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <chrono>
+#include <cstddef>
+
+// Timeline of named zones on every thread, written as a Chrome trace JSON
+// file (chrome://tracing, https://ui.perfetto.dev) by writeTrace.
+//
+// Nothing is recorded until startTracing. Each thread records its zones in
+// its own ring of at most zonesPerThread zones, only written by that thread:
+// recording a zone takes no lock. Once a ring is full, the oldest zones of
+// its thread are overwritten.
+
+void startTracing(size_t zonesPerThread = size_t(1) << 16);
+
+bool isTracing();
+
+// Write the zones recorded so far, by threads that are done or idle. Returns
+// false if the file can not be written.
+bool writeTrace(const fs::path &path);
+
+// Innermost zone of the calling thread, recorded or not, null outside of
+// zones
+const char *getCurrentTraceZone();
+
+// Record its lifetime as a zone of the calling thread. name must outlive the
+// trace, a string literal. Zones are current (see getCurrentTraceZone) even
+// when not tracing.
+class TraceZone
+{
+public:
+  explicit TraceZone(const char *name);
+
+  ~TraceZone() { end(); }
+
+  TraceZone(const TraceZone &) = delete;
+
+  TraceZone &operator=(const TraceZone &) = delete;
+
+  // End the zone before the end of the scope
+  void end();
+
+private:
+  const char *m_name; // Null once ended
+  const char *m_parent; // Current zone when it began
+  bool m_recorded; // If tracing when it began
+  std::chrono::steady_clock::time_point m_begin;
+};
@@ -0,0 +1,285 @@
+#include "transforms.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORMS_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRANSFORMS_NEON
+#endif
+
+namespace {
+
+const size_t LANES = 4;
+
+// 4 floats, one per matrix of a batch
+#if defined(TRANSFORMS_SSE)
+using Lanes = __m128;
+
+Lanes load(const float *values) { return _mm_loadu_ps(values); }
+
+void store(float *values, Lanes a) { _mm_storeu_ps(values, a); }
+
+Lanes broadcast(float value) { return _mm_set1_ps(value); }
+
+Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+
+Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+
+Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+
+void transpose(Lanes &a, Lanes &b, Lanes &c, Lanes &d)
+{
+  _MM_TRANSPOSE4_PS(a, b, c, d);
+}
+#elif defined(TRANSFORMS_NEON)
+using Lanes = float32x4_t;
+
+Lanes load(const float *values) { return vld1q_f32(values); }
+
+void store(float *values, Lanes a) { vst1q_f32(values, a); }
+
+Lanes broadcast(float value) { return vdupq_n_f32(value); }
+
+Lanes add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+
+Lanes sub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+
+Lanes mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+
+void transpose(Lanes &a, Lanes &b, Lanes &c, Lanes &d)
+{
+  const auto ab = vtrnq_f32(a, b);
+  const auto cd = vtrnq_f32(c, d);
+  a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+  b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+  c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+  d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+#else
+struct Lanes
+{
+  float values[LANES];
+};
+
+Lanes load(const float *values)
+{
+  Lanes a;
+  std::copy(values, values + LANES, a.values);
+  return a;
+}
+
+void store(float *values, Lanes a)
+{
+  std::copy(a.values, a.values + LANES, values);
+}
+
+Lanes broadcast(float value)
+{
+  Lanes a;
+  std::fill(a.values, a.values + LANES, value);
+  return a;
+}
+
+template <typename Op> Lanes apply(Lanes a, Lanes b, Op op)
+{
+  for (size_t i = 0; i < LANES; ++i) {
+    a.values[i] = op(a.values[i], b.values[i]);
+  }
+  return a;
+}
+
+Lanes add(Lanes a, Lanes b)
+{
+  return apply(a, b, [](float x, float y) { return x + y; });
+}
+
+Lanes sub(Lanes a, Lanes b)
+{
+  return apply(a, b, [](float x, float y) { return x - y; });
+}
+
+Lanes mul(Lanes a, Lanes b)
+{
+  return apply(a, b, [](float x, float y) { return x * y; });
+}
+
+void transpose(Lanes &a, Lanes &b, Lanes &c, Lanes &d)
+{
+  Lanes *rows[] = {&a, &b, &c, &d};
+  for (size_t i = 0; i < LANES; ++i) {
+    for (size_t j = i + 1; j < LANES; ++j) {
+      std::swap(rows[i]->values[j], rows[j]->values[i]);
+    }
+  }
+}
+#endif
+
+// Column c of the 4 matrices as their rows 0 to 3 across lanes
+void loadColumn(const glm::mat4 *const *matrices, int c, Lanes *rows)
+{
+  for (size_t lane = 0; lane < LANES; ++lane) {
+    rows[lane] = load(&(*matrices[lane])[c][0]);
+  }
+  transpose(rows[0], rows[1], rows[2], rows[3]);
+}
+
+// Write rows 0 to 2 of column c of count matrices, row 3 being 0 or 1 for
+// the translation
+void storeColumn(const Lanes *rows, int c, glm::mat4 *const *matrices,
+    size_t count)
+{
+  auto column0 = rows[0];
+  auto column1 = rows[1];
+  auto column2 = rows[2];
+  auto column3 = broadcast(c == 3 ? 1.f : 0.f);
+  transpose(column0, column1, column2, column3);
+  const Lanes laneColumns[] = {column0, column1, column2, column3};
+  for (size_t lane = 0; lane < count; ++lane) {
+    store(&(*matrices[lane])[c][0], laneColumns[lane]);
+  }
+}
+
+} // namespace
+
+void TrsArrays::resize(size_t count)
+{
+  for (auto &values : translations) {
+    values.resize(count, 0.f);
+  }
+  for (int c = 0; c < 4; ++c) {
+    rotations[c].resize(count, c == 3 ? 1.f : 0.f);
+  }
+  for (auto &values : scales) {
+    values.resize(count, 1.f);
+  }
+}
+
+glm::vec3 TrsArrays::translation(size_t i) const
+{
+  return glm::vec3(translations[0][i], translations[1][i], translations[2][i]);
+}
+
+glm::vec4 TrsArrays::rotation(size_t i) const
+{
+  return glm::vec4(
+      rotations[0][i], rotations[1][i], rotations[2][i], rotations[3][i]);
+}
+
+glm::vec3 TrsArrays::scale(size_t i) const
+{
+  return glm::vec3(scales[0][i], scales[1][i], scales[2][i]);
+}
+
+void TrsArrays::setTranslation(size_t i, const glm::vec3 &translation)
+{
+  for (int c = 0; c < 3; ++c) {
+    translations[c][i] = translation[c];
+  }
+}
+
+void TrsArrays::setRotation(size_t i, const glm::vec4 &rotation)
+{
+  for (int c = 0; c < 4; ++c) {
+    rotations[c][i] = rotation[c];
+  }
+}
+
+void TrsArrays::setScale(size_t i, const glm::vec3 &scale)
+{
+  for (int c = 0; c < 3; ++c) {
+    scales[c][i] = scale[c];
+  }
+}
+
+void composeTrsMatrices(const TrsArrays &trs, const size_t *indices,
+    size_t count, glm::mat4 *matrices)
+{
+  for (size_t first = 0; first < count; first += LANES) {
+    const auto batchSize = std::min(LANES, count - first);
+    // Components of the batch, the last entry repeated in unused lanes
+    const auto gather = [&](const std::vector<float> &values) {
+      if (!indices && batchSize == LANES) {
+        return load(&values[first]);
+      }
+      float laneValues[LANES];
+      for (size_t lane = 0; lane < LANES; ++lane) {
+        const auto i = first + std::min(lane, batchSize - 1);
+        laneValues[lane] = values[indices ? indices[i] : i];
+      }
+      return load(laneValues);
+    };
+    const auto x = gather(trs.rotations[0]);
+    const auto y = gather(trs.rotations[1]);
+    const auto z = gather(trs.rotations[2]);
+    const auto w = gather(trs.rotations[3]);
+    const auto sx = gather(trs.scales[0]);
+    const auto sy = gather(trs.scales[1]);
+    const auto sz = gather(trs.scales[2]);
+
+    // Terms of glm::mat4_cast, in the same order to round the same
+    const auto one = broadcast(1.f);
+    const auto two = broadcast(2.f);
+    const auto xx = mul(x, x), yy = mul(y, y), zz = mul(z, z);
+    const auto xy = mul(x, y), xz = mul(x, z), yz = mul(y, z);
+    const auto wx = mul(w, x), wy = mul(w, y), wz = mul(w, z);
+
+    glm::mat4 *batch[LANES];
+    for (size_t lane = 0; lane < batchSize; ++lane) {
+      batch[lane] = &matrices[first + lane];
+    }
+    const Lanes column0[] = {mul(sub(one, mul(two, add(yy, zz))), sx),
+        mul(mul(two, add(xy, wz)), sx), mul(mul(two, sub(xz, wy)), sx)};
+    storeColumn(column0, 0, batch, batchSize);
+    const Lanes column1[] = {mul(mul(two, sub(xy, wz)), sy),
+        mul(sub(one, mul(two, add(xx, zz))), sy),
+        mul(mul(two, add(yz, wx)), sy)};
+    storeColumn(column1, 1, batch, batchSize);
+    const Lanes column2[] = {mul(mul(two, add(xz, wy)), sz),
+        mul(mul(two, sub(yz, wx)), sz),
+        mul(sub(one, mul(two, add(xx, yy))), sz)};
+    storeColumn(column2, 2, batch, batchSize);
+    const Lanes column3[] = {gather(trs.translations[0]),
+        gather(trs.translations[1]), gather(trs.translations[2])};
+    storeColumn(column3, 3, batch, batchSize);
+  }
+}
+
+void multiplyAffineMatrices(const glm::mat4 *const *lefts,
+    const glm::mat4 *const *rights, glm::mat4 *const *results, size_t count)
+{
+  for (size_t first = 0; first < count; first += LANES) {
+    const auto batchSize = std::min(LANES, count - first);
+    // The last product repeated in unused lanes
+    const glm::mat4 *batchLefts[LANES];
+    const glm::mat4 *batchRights[LANES];
+    for (size_t lane = 0; lane < LANES; ++lane) {
+      const auto i = first + std::min(lane, batchSize - 1);
+      batchLefts[lane] = lefts[i];
+      batchRights[lane] = rights[i];
+    }
+    // Rows across lanes of the columns of the left matrices
+    Lanes left[4][4];
+    for (int c = 0; c < 4; ++c) {
+      loadColumn(batchLefts, c, left[c]);
+    }
+    for (int c = 0; c < 4; ++c) {
+      Lanes right[4];
+      loadColumn(batchRights, c, right);
+      // Added in the order of glm's operator*, the last row of right being
+      // (0, 0, 0, 1)
+      Lanes column[3];
+      for (int r = 0; r < 3; ++r) {
+        column[r] = add(add(mul(left[0][r], right[0]),
+                            mul(left[1][r], right[1])),
+            mul(left[2][r], right[2]));
+        if (c == 3) {
+          column[r] = add(column[r], left[3][r]);
+        }
+      }
+      storeColumn(column, c, results + first, batchSize);
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Translations, rotations and scales of nodes in contiguous float arrays
+// (structure of arrays), read once from the doubles of tinygltf or from
+// accessors, and composed into matrices 4 nodes at a time with SSE or NEON by
+// composeTrsMatrices instead of a glm::translate, mat4_cast and glm::scale
+// per node.
+struct TrsArrays
+{
+  std::vector<float> translations[3]; // x, y, z
+  std::vector<float> rotations[4]; // x, y, z, w as in glTF
+  std::vector<float> scales[3];
+
+  size_t size() const { return translations[0].size(); }
+
+  // New entries are the identity transform
+  void resize(size_t count);
+
+  glm::vec3 translation(size_t i) const;
+  glm::vec4 rotation(size_t i) const;
+  glm::vec3 scale(size_t i) const;
+
+  void setTranslation(size_t i, const glm::vec3 &translation);
+  void setRotation(size_t i, const glm::vec4 &rotation);
+  void setScale(size_t i, const glm::vec3 &scale);
+};
+
+// matrices[i] = T * R * S of entry indices[i] of trs, or of entry i if
+// indices is nullptr, for i < count. Only the 3 first rows are computed, the
+// last one of these affine matrices is (0, 0, 0, 1).
+void composeTrsMatrices(const TrsArrays &trs, const size_t *indices,
+    size_t count, glm::mat4 *matrices);
+
+// *results[i] = *lefts[i] * *rights[i] for i < count, 4 products at a time,
+// all matrices being affine. A result can not be one of the operands.
+void multiplyAffineMatrices(const glm::mat4 *const *lefts,
+    const glm::mat4 *const *rights, glm::mat4 *const *results, size_t count);
@@ -0,0 +1,88 @@
+#include "uniform_ring.hpp"
+#include "gpu_memory.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+size_t alignSize(size_t size, size_t alignment)
+{
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+UniformRing::UniformRing(
+    size_t maxBlockSize, size_t blocksPerFrame, size_t regionCount) :
+    m_fences(regionCount, nullptr)
+{
+  // Blocks are bound at offsets multiple of the alignment
+  GLint alignment = 0;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  if (alignment > 0) {
+    m_alignment = size_t(alignment);
+  }
+  m_regionSize = alignSize(maxBlockSize, m_alignment) * blocksPerFrame;
+
+  const auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                     GL_MAP_COHERENT_BIT;
+  const auto size = GLsizeiptr(m_regionSize * regionCount);
+  glGenBuffers(1, &m_buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+  m_data = static_cast<unsigned char *>(
+      glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  if (!m_data) {
+    glDeleteBuffers(1, &m_buffer);
+    throw std::runtime_error("Unable to map the uniform ring buffer");
+  }
+  trackBuffers(GpuMemoryCategory::DrawData, 1, &m_buffer);
+}
+
+UniformRing::~UniformRing()
+{
+  for (const auto fence : m_fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+  glUnmapBuffer(GL_UNIFORM_BUFFER);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  untrackBuffers(1, &m_buffer);
+  glDeleteBuffers(1, &m_buffer);
+}
+
+void UniformRing::beginFrame()
+{
+  if (m_isFrameStarted) {
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_region = (m_region + 1) % m_fences.size();
+  }
+  m_isFrameStarted = true;
+  m_offset = 0;
+
+  // Only blocks if the GPU is still drawing the frame written
+  // m_fences.size() frames ago
+  auto &fence = m_fences[m_region];
+  if (fence) {
+    glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+}
+
+void UniformRing::bindBlock(GLuint binding, const void *data, size_t size)
+{
+  const auto blockSize = alignSize(size, m_alignment);
+  if (m_offset + blockSize > m_regionSize) {
+    throw std::runtime_error("Uniform ring region full");
+  }
+  const auto offset = m_regionSize * m_region + m_offset;
+  std::memcpy(m_data + offset, data, size);
+  glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_buffer, GLintptr(offset),
+      GLsizeiptr(size));
+  m_offset += blockSize;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// Uniform blocks written by the CPU every frame, in a buffer persistently
+// and coherently mapped (glBufferStorage with GL_MAP_PERSISTENT_BIT): setting
+// a block is a copy at the next offset of the mapping and a glBindBufferRange.
+//
+// The buffer is split in regionCount regions, a frame writes one of them
+// while the GPU may still read the previous ones. A fence is put at the end
+// of each frame, so that a region is only written again once the GPU is done
+// with the frame that used it.
+class UniformRing
+{
+public:
+  // Room for blocksPerFrame blocks of at most maxBlockSize bytes per frame
+  UniformRing(
+      size_t maxBlockSize, size_t blocksPerFrame, size_t regionCount = 3);
+
+  ~UniformRing();
+
+  UniformRing(const UniformRing &) = delete;
+
+  UniformRing &operator=(const UniformRing &) = delete;
+
+  // Fence the region of the previous frame and start writing the next one,
+  // waiting for the GPU to be done with it if needed
+  void beginFrame();
+
+  // Copy a block in the region of the frame and bind it to the uniform
+  // buffer binding point. Throws if the region is full.
+  void bindBlock(GLuint binding, const void *data, size_t size);
+
+  template <typename T> void bindBlock(GLuint binding, const T &block)
+  {
+    bindBlock(binding, &block, sizeof(block));
+  }
+
+private:
+  GLuint m_buffer = 0;
+  unsigned char *m_data = nullptr;
+  size_t m_alignment = 256;
+  size_t m_regionSize;
+  size_t m_region = 0; // Written by the current frame
+  size_t m_offset = 0; // In the region
+  bool m_isFrameStarted = false;
+  std::vector<GLsync> m_fences; // Of each region, null once waited for
+};
@@ -0,0 +1,109 @@
+#include "upload_scheduler.hpp"
+#include "gl_objects.hpp"
+#include "gltf.hpp"
+#include "texture_uploader.hpp"
+
+#include <algorithm>
+
+UploadScheduler::UploadScheduler(size_t frameBytes, double frameSeconds) :
+    m_frameBytes(std::max(frameBytes, size_t(1))),
+    m_frameDuration(frameSeconds)
+{
+}
+
+UploadScheduler::~UploadScheduler()
+{
+  for (const auto &upload : m_queue) {
+    if (upload.texture) {
+      GLTextureTraits::destroy(1, &upload.texture);
+    }
+  }
+}
+
+bool UploadScheduler::canSplit(const tinygltf::Image &image)
+{
+  return !image.as_is && !image.image.empty() && image.width > 0 &&
+         image.height > 0 && image.component >= 1 && image.component <= 4;
+}
+
+void UploadScheduler::add(
+    int key, const tinygltf::Image &image, bool generateMipmaps, bool srgb)
+{
+  const auto rowSize =
+      getTextureLevelSizes(image)[0].byteSize / size_t(image.height);
+  m_queue.push_back(
+      Upload{key, &image, generateMipmaps, srgb, rowSize, m_nextOrder});
+  m_keys.insert(key);
+  ++m_nextOrder;
+}
+
+void UploadScheduler::setPriority(int key, float priority)
+{
+  if (!contains(key)) {
+    return;
+  }
+  auto &value = m_priorities[key];
+  value = std::max(value, priority);
+}
+
+std::vector<UploadScheduler::Completed> UploadScheduler::update(
+    TextureUploader &uploader)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (auto &upload : m_queue) {
+    const auto it = m_priorities.find(upload.key);
+    upload.priority = it != end(m_priorities) ? it->second : 0.f;
+  }
+  m_priorities.clear();
+  std::sort(begin(m_queue), end(m_queue),
+      [](const Upload &a, const Upload &b) {
+        if (a.priority != b.priority) {
+          return a.priority > b.priority;
+        }
+        if ((a.texture != 0) != (b.texture != 0)) {
+          return a.texture != 0;
+        }
+        return a.order < b.order;
+      });
+
+  std::vector<Completed> completed;
+  size_t bytes = 0;
+  size_t next = 0;
+  while (next < m_queue.size() && bytes < m_frameBytes &&
+         (bytes == 0 ||
+             std::chrono::steady_clock::now() - start < m_frameDuration)) {
+    auto &upload = m_queue[next];
+    const auto &image = *upload.image;
+    if (!upload.texture) {
+      upload.texture =
+          uploader.beginTexture(image, upload.generateMipmaps, upload.srgb);
+    }
+    const auto rowCount = GLsizei(std::min(size_t(image.height) -
+                                               size_t(upload.uploadedRows),
+        std::max((m_frameBytes - bytes) / upload.rowSize, size_t(1))));
+    uploader.uploadTextureRows(
+        upload.texture, image, upload.uploadedRows, rowCount);
+    upload.uploadedRows += rowCount;
+    bytes += size_t(rowCount) * upload.rowSize;
+    if (upload.uploadedRows < image.height) {
+      break; // The byte budget is spent
+    }
+    uploader.endTexture(upload.texture, image, upload.generateMipmaps);
+    completed.push_back(Completed{upload.key, upload.texture});
+    m_keys.erase(upload.key);
+    ++next;
+  }
+  m_queue.erase(begin(m_queue), begin(m_queue) + std::ptrdiff_t(next));
+  m_lastUpdateBytes = bytes;
+  return completed;
+}
+
+size_t UploadScheduler::queuedBytes() const
+{
+  size_t bytes = 0;
+  for (const auto &upload : m_queue) {
+    bytes += (size_t(upload.image->height) - size_t(upload.uploadedRows)) *
+             upload.rowSize;
+  }
+  return bytes;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <tiny_gltf.h>
+
+#include <chrono>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class TextureUploader;
+
+// Spreads the transfer of textures over frames (--upload-budget), so that
+// loading many large images does not stall one frame for hundreds of
+// milliseconds. Each update transfers rows of the queued textures within a
+// byte budget, and starts no new transfer once a time budget is spent,
+// textures most needed first: by priority (the screen size of the draws
+// sampling them), then those already started, then in the order queued.
+// Textures are only returned once complete, with their mip chain.
+//
+// Images must stay unchanged and alive until their texture is returned.
+// Textures still queued are deleted with the scheduler, whose GL context
+// must be current.
+class UploadScheduler
+{
+public:
+  struct Completed
+  {
+    int key;
+    GLuint texture;
+  };
+
+  // frameBytes is the budget of bytes transferred by update, frameSeconds
+  // its time budget
+  UploadScheduler(size_t frameBytes, double frameSeconds);
+
+  ~UploadScheduler();
+
+  UploadScheduler(const UploadScheduler &) = delete;
+
+  UploadScheduler &operator=(const UploadScheduler &) = delete;
+
+  // Whether the texture of image can be transferred in parts: images decoded
+  // to pixels (see TextureUploader::createTexture)
+  static bool canSplit(const tinygltf::Image &image);
+
+  // Queue the texture of image, returned with key once transferred, key
+  // not being queued already. Like
+  // TextureUploader::createTexture for generateMipmaps and srgb.
+  void add(int key, const tinygltf::Image &image, bool generateMipmaps,
+      bool srgb = false);
+
+  bool contains(int key) const { return m_keys.count(key) != 0; }
+
+  // Priority of the queued texture of key for the next update, the maximum
+  // of the calls. Textures without priority come after the others.
+  void setPriority(int key, float priority);
+
+  // Transfer queued textures within the budget of a frame, at least one row,
+  // and returns those completed
+  std::vector<Completed> update(TextureUploader &uploader);
+
+  size_t queueDepth() const { return m_queue.size(); }
+
+  // Bytes of the first levels still to transfer
+  size_t queuedBytes() const;
+
+  // Bytes transferred by the last update
+  size_t lastUpdateBytes() const { return m_lastUpdateBytes; }
+
+private:
+  struct Upload
+  {
+    int key;
+    const tinygltf::Image *image;
+    bool generateMipmaps;
+    bool srgb;
+    size_t rowSize;
+    size_t order; // Of add calls
+    GLuint texture = 0; // Once started
+    GLsizei uploadedRows = 0;
+    float priority = 0.f;
+  };
+
+  size_t m_frameBytes;
+  std::chrono::duration<double> m_frameDuration;
+  std::vector<Upload> m_queue;
+  std::unordered_map<int, float> m_priorities; // For the next update
+  std::unordered_set<int> m_keys; // Queued
+  size_t m_nextOrder = 0;
+  size_t m_lastUpdateBytes = 0;
+};
@@ -0,0 +1,116 @@
+#include "vertex_kernels.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VERTEX_KERNELS_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VERTEX_KERNELS_NEON
+#endif
+
+namespace {
+
+// Transform and min/max of the positions given by getPosition(i), which
+// returns a pointer to 3 floats. The matrix columns are splatted once, each
+// position costs 3 multiply-adds and 2 min/max on 4 wide registers.
+template <typename GetPosition>
+BoundingBox transformBounds(
+    size_t count, const glm::mat4 &matrix, GetPosition getPosition)
+{
+  BoundingBox bounds;
+  if (!count) {
+    return bounds;
+  }
+#if defined(VERTEX_KERNELS_SSE)
+  const auto c0 = _mm_loadu_ps(&matrix[0][0]);
+  const auto c1 = _mm_loadu_ps(&matrix[1][0]);
+  const auto c2 = _mm_loadu_ps(&matrix[2][0]);
+  const auto c3 = _mm_loadu_ps(&matrix[3][0]);
+  auto lo = _mm_set1_ps(bounds.min.x);
+  auto hi = _mm_set1_ps(bounds.max.x);
+  for (size_t i = 0; i < count; ++i) {
+    float p[3];
+    std::memcpy(p, getPosition(i), sizeof(p));
+    const auto v = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])),
+            _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+        _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+    lo = _mm_min_ps(lo, v);
+    hi = _mm_max_ps(hi, v);
+  }
+  float result[4];
+  _mm_storeu_ps(result, lo);
+  bounds.min = glm::vec3(result[0], result[1], result[2]);
+  _mm_storeu_ps(result, hi);
+  bounds.max = glm::vec3(result[0], result[1], result[2]);
+#elif defined(VERTEX_KERNELS_NEON)
+  const auto c0 = vld1q_f32(&matrix[0][0]);
+  const auto c1 = vld1q_f32(&matrix[1][0]);
+  const auto c2 = vld1q_f32(&matrix[2][0]);
+  const auto c3 = vld1q_f32(&matrix[3][0]);
+  auto lo = vdupq_n_f32(bounds.min.x);
+  auto hi = vdupq_n_f32(bounds.max.x);
+  for (size_t i = 0; i < count; ++i) {
+    float p[3];
+    std::memcpy(p, getPosition(i), sizeof(p));
+    auto v = vmlaq_n_f32(c3, c0, p[0]);
+    v = vmlaq_n_f32(v, c1, p[1]);
+    v = vmlaq_n_f32(v, c2, p[2]);
+    lo = vminq_f32(lo, v);
+    hi = vmaxq_f32(hi, v);
+  }
+  float result[4];
+  vst1q_f32(result, lo);
+  bounds.min = glm::vec3(result[0], result[1], result[2]);
+  vst1q_f32(result, hi);
+  bounds.max = glm::vec3(result[0], result[1], result[2]);
+#else
+  for (size_t i = 0; i < count; ++i) {
+    glm::vec3 p;
+    std::memcpy(&p, getPosition(i), sizeof(p));
+    bounds.extend(glm::vec3(matrix * glm::vec4(p, 1.f)));
+  }
+#endif
+  return bounds;
+}
+
+template <typename Index>
+BoundingBox indexedTransformBounds(const unsigned char *positions,
+    size_t byteStride, const unsigned char *indices, size_t indexByteStride,
+    size_t indexCount, const glm::mat4 &matrix)
+{
+  return transformBounds(indexCount, matrix, [&](size_t i) {
+    Index index;
+    std::memcpy(&index, indices + indexByteStride * i, sizeof(index));
+    return positions + byteStride * index;
+  });
+}
+
+} // namespace
+
+BoundingBox computeTransformedBounds(const unsigned char *positions,
+    size_t byteStride, size_t count, const glm::mat4 &matrix)
+{
+  return transformBounds(
+      count, matrix, [&](size_t i) { return positions + byteStride * i; });
+}
+
+BoundingBox computeIndexedTransformedBounds(const unsigned char *positions,
+    size_t byteStride, const unsigned char *indices, size_t indexSize,
+    size_t indexByteStride, size_t indexCount, const glm::mat4 &matrix)
+{
+  switch (indexSize) {
+  case 1:
+    return indexedTransformBounds<uint8_t>(
+        positions, byteStride, indices, indexByteStride, indexCount, matrix);
+  case 2:
+    return indexedTransformBounds<uint16_t>(
+        positions, byteStride, indices, indexByteStride, indexCount, matrix);
+  default:
+    return indexedTransformBounds<uint32_t>(
+        positions, byteStride, indices, indexByteStride, indexCount, matrix);
+  }
+}
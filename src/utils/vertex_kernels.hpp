@@ -0,0 +1,24 @@
+#pragma once
+
+#include "bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Per-vertex loops over raw glTF buffer content, vectorized with SSE on x86
+// and NEON on ARM (scalar elsewhere). Positions are read as 3 floats every
+// byteStride bytes, with no alignment requirement.
+//
+// Each call runs on the calling thread: split large inputs in ranges and
+// spread them with parallelFor, as computeSceneBounds does.
+
+// Bounds of matrix * positions[i] for i in [0, count)
+BoundingBox computeTransformedBounds(const unsigned char *positions,
+    size_t byteStride, size_t count, const glm::mat4 &matrix);
+
+// Bounds of matrix * positions[indices[i]] for i in [0, indexCount), with
+// indices of indexSize (1, 2 or 4) bytes every indexByteStride bytes
+BoundingBox computeIndexedTransformedBounds(const unsigned char *positions,
+    size_t byteStride, const unsigned char *indices, size_t indexSize,
+    size_t indexByteStride, size_t indexCount, const glm::mat4 &matrix);
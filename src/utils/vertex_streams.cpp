@@ -0,0 +1,151 @@
+#include "vertex_streams.hpp"
+
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Values of the accessor of attribute, empty if the primitive does not have
+// it. Returns false if it can not be read.
+bool readAttribute(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, const char *attribute,
+    int componentCount, std::vector<float> &values)
+{
+  values.clear();
+  const auto it = primitive.attributes.find(attribute);
+  return it == end(primitive.attributes) ||
+         readFloatAccessor(
+             model, bufferBytes, it->second, componentCount, values);
+}
+
+template <typename T>
+void writeValue(unsigned char *data, const T &value)
+{
+  std::memcpy(data, &value, sizeof(value));
+}
+
+} // namespace
+
+bool buildVertexStreams(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, bool quantize,
+    VertexStreams &streams)
+{
+  std::vector<float> positions, normals, tangents, texCoords;
+  if (!primitive.attributes.count("POSITION") ||
+      !readAttribute(
+          model, bufferBytes, primitive, "POSITION", 3, positions) ||
+      !readAttribute(model, bufferBytes, primitive, "NORMAL", 3, normals) ||
+      !readAttribute(model, bufferBytes, primitive, "TANGENT", 4, tangents) ||
+      !readAttribute(
+          model, bufferBytes, primitive, "TEXCOORD_0", 2, texCoords)) {
+    return false;
+  }
+  const auto vertexCount = positions.size() / 3;
+  if ((!normals.empty() && normals.size() != 3 * vertexCount) ||
+      (!tangents.empty() && tangents.size() != 4 * vertexCount) ||
+      (!texCoords.empty() && texCoords.size() != 2 * vertexCount)) {
+    return false;
+  }
+  streams.quantized = quantize;
+  streams.hasNormals = !normals.empty();
+  streams.hasTangents = !tangents.empty();
+  streams.hasTexCoords = !texCoords.empty();
+
+  streams.positionOffset = glm::vec3(0);
+  streams.positionScale = glm::vec3(1);
+  if (quantize && vertexCount) {
+    auto bboxMin = glm::vec3(std::numeric_limits<float>::max());
+    auto bboxMax = glm::vec3(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < vertexCount; ++i) {
+      const auto position = glm::vec3(
+          positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+      bboxMin = glm::min(bboxMin, position);
+      bboxMax = glm::max(bboxMax, position);
+    }
+    streams.positionOffset = bboxMin;
+    for (auto c = 0; c < 3; ++c) {
+      if (bboxMax[c] > bboxMin[c]) {
+        streams.positionScale[c] = bboxMax[c] - bboxMin[c];
+      }
+    }
+  }
+  streams.positionStride = quantize ? 4 * sizeof(uint16_t) : 3 * sizeof(float);
+  streams.positions.resize(streams.positionStride * vertexCount);
+  for (size_t i = 0; i < vertexCount; ++i) {
+    auto *vertex = streams.positions.data() + streams.positionStride * i;
+    for (auto c = 0; c < 3; ++c) {
+      if (quantize) {
+        const auto value =
+            (positions[3 * i + c] - streams.positionOffset[c]) /
+            streams.positionScale[c];
+        writeValue(vertex + sizeof(uint16_t) * c,
+            uint16_t(std::lround(glm::clamp(value, 0.f, 1.f) * 65535.f)));
+      } else {
+        writeValue(vertex + sizeof(float) * c, positions[3 * i + c]);
+      }
+    }
+    if (quantize) {
+      writeValue(vertex + sizeof(uint16_t) * 3, uint16_t(0));
+    }
+  }
+
+  const auto normalSize = !streams.hasNormals ? 0
+                          : quantize         ? sizeof(uint32_t)
+                                             : 3 * sizeof(float);
+  const auto tangentSize = !streams.hasTangents ? 0
+                           : quantize           ? sizeof(uint32_t)
+                                                : 4 * sizeof(float);
+  const auto texCoordSize = !streams.hasTexCoords ? 0
+                            : quantize ? 2 * sizeof(uint16_t)
+                                       : 2 * sizeof(float);
+  streams.tangentOffset = normalSize;
+  streams.texCoordOffset = normalSize + tangentSize;
+  streams.shadingStride = normalSize + tangentSize + texCoordSize;
+  streams.shading.resize(streams.shadingStride * vertexCount);
+  for (size_t i = 0; i < vertexCount && streams.shadingStride; ++i) {
+    auto *vertex = streams.shading.data() + streams.shadingStride * i;
+    if (streams.hasNormals) {
+      auto normal =
+          glm::vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+      if (quantize) {
+        const auto length = glm::length(normal);
+        if (length > 0) {
+          normal /= length;
+        }
+        writeValue(vertex, glm::packSnorm3x10_1x2(glm::vec4(normal, 0)));
+      } else {
+        writeValue(vertex, normal);
+      }
+    }
+    if (streams.hasTangents) {
+      auto tangent = glm::vec4(tangents[4 * i], tangents[4 * i + 1],
+          tangents[4 * i + 2], tangents[4 * i + 3]);
+      if (quantize) {
+        const auto length = glm::length(glm::vec3(tangent));
+        const auto direction =
+            length > 0 ? glm::vec3(tangent) / length : glm::vec3(0);
+        tangent = glm::vec4(direction, tangent.w < 0 ? -1.f : 1.f);
+        writeValue(vertex + streams.tangentOffset,
+            glm::packSnorm3x10_1x2(tangent));
+      } else {
+        writeValue(vertex + streams.tangentOffset, tangent);
+      }
+    }
+    if (streams.hasTexCoords) {
+      const auto texCoords2 = glm::vec2(texCoords[2 * i], texCoords[2 * i + 1]);
+      if (quantize) {
+        writeValue(vertex + streams.texCoordOffset,
+            glm::packHalf2x16(texCoords2));
+      } else {
+        writeValue(vertex + streams.texCoordOffset, texCoords2);
+      }
+    }
+  }
+  return true;
+}
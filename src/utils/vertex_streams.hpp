@@ -0,0 +1,48 @@
+#pragma once
+
+#include "gltf.hpp"
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+#include <cstdint>
+#include <vector>
+
+// POSITION, NORMAL, TANGENT and TEXCOORD_0 of a primitive rebuilt in two
+// vertex streams: positions alone, so that depth only passes fetch nothing
+// else, then normals, tangents and texture coordinates interleaved.
+//
+// When quantized, vertices take 16 bytes instead of 32 (20 instead of 48 with
+// tangents): positions are 16 bits unsigned normalized values within the
+// bounds of the primitive, normals and tangents are normalized 10-10-10-2 and
+// texture coordinates half floats.
+struct VertexStreams
+{
+  bool quantized = false;
+
+  // 3 floats, or 4 unsigned shorts (the last unused) when quantized, with
+  // position = positionOffset + positionScale * value
+  std::vector<unsigned char> positions;
+  size_t positionStride = 0;
+  glm::vec3 positionOffset = glm::vec3(0);
+  glm::vec3 positionScale = glm::vec3(1);
+
+  // Normal (3 floats or GL_INT_2_10_10_10_REV), tangent (4 floats or
+  // GL_INT_2_10_10_10_REV, handedness in w) then texture coordinates (2
+  // floats or 2 half floats) of each vertex, for those the primitive has.
+  // Empty if it has none.
+  std::vector<unsigned char> shading;
+  size_t shadingStride = 0;
+  size_t tangentOffset = 0; // In a vertex of shading
+  size_t texCoordOffset = 0;
+  bool hasNormals = false;
+  bool hasTangents = false;
+  bool hasTexCoords = false;
+};
+
+// Returns false if one of the attributes can not be read (see
+// readFloatAccessor), or if they do not have the same count.
+bool buildVertexStreams(const tinygltf::Model &model,
+    const std::vector<BufferBytes> &bufferBytes,
+    const tinygltf::Primitive &primitive, bool quantize,
+    VertexStreams &streams);
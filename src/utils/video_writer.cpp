@@ -0,0 +1,133 @@
+#include "video_writer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+#ifdef _WIN32
+const char *const NULL_OUTPUT = "NUL";
+#else
+const char *const NULL_OUTPUT = "/dev/null";
+#endif
+
+// Frames piped as raw video to ffmpeg, which flips them and encodes them
+class FfmpegVideoWriter : public VideoWriter
+{
+public:
+  FfmpegVideoWriter(FILE *pipe, size_t frameSize) :
+      m_pipe(pipe), m_frameSize(frameSize)
+  {
+  }
+
+  ~FfmpegVideoWriter() override { finish(); }
+
+  bool writeFrame(const void *pixels) override
+  {
+    m_hasFailed = m_hasFailed || !m_pipe ||
+                  std::fwrite(pixels, 1, m_frameSize, m_pipe) != m_frameSize;
+    return !m_hasFailed;
+  }
+
+  bool finish() override
+  {
+    if (m_pipe) {
+      // Exit status of ffmpeg, once it has written the end of the file
+      m_hasFailed = pclose(m_pipe) != 0 || m_hasFailed;
+      m_pipe = nullptr;
+    }
+    return !m_hasFailed;
+  }
+
+private:
+  FILE *m_pipe;
+  size_t m_frameSize;
+  bool m_hasFailed = false;
+};
+
+// ffmpeg encoding raw RGBA frames of its standard input with encoder, to the
+// output options and destination of output
+std::unique_ptr<VideoWriter> startFfmpeg(size_t width, size_t height,
+    size_t frameRate, const std::string &encoder, const std::string &output)
+{
+  // Else the pipe would be written to without reader
+  const auto versionCommand =
+      std::string("ffmpeg -version > ") + NULL_OUTPUT + " 2>&1";
+  if (std::system(versionCommand.c_str()) != 0) {
+    return nullptr;
+  }
+#ifndef _WIN32
+  // A failed ffmpeg makes writes fail instead of terminating the viewer
+  std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+  // VAAPI encoders take frames uploaded to a device, the others planar YUV
+  const auto isVaapi = encoder.find("_vaapi") != std::string::npos;
+  std::ostringstream command;
+  command << "ffmpeg -loglevel error -y";
+  if (isVaapi) {
+    command << " -vaapi_device /dev/dri/renderD128";
+  }
+  command << " -f rawvideo -pix_fmt rgba -s " << width << "x" << height
+          << " -r " << frameRate << " -i -";
+  // Rows are bottom-up
+  command << (isVaapi ? " -vf vflip,format=nv12,hwupload"
+                      : " -vf vflip -pix_fmt yuv420p");
+  command << " -c:v " << encoder << " " << output;
+#ifdef _WIN32
+  auto *pipe = popen(command.str().c_str(), "wb");
+#else
+  auto *pipe = popen(command.str().c_str(), "w");
+#endif
+  if (!pipe) {
+    return nullptr;
+  }
+  return std::make_unique<FfmpegVideoWriter>(pipe, width * height * 4);
+}
+
+} // namespace
+
+bool isVideoFormat(const fs::path &path)
+{
+  auto extension = path.extension().string();
+  std::transform(begin(extension), end(extension), begin(extension),
+      [](char c) { return char(std::tolower(c)); });
+  for (const auto *supported : {".mp4", ".mkv", ".mov", ".webm"}) {
+    if (extension == supported) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::unique_ptr<VideoWriter> createVideoWriter(const fs::path &path,
+    size_t width, size_t height, size_t frameRate, const std::string &encoder)
+{
+  return startFfmpeg(
+      width, height, frameRate, encoder, "\"" + path.string() + "\"");
+}
+
+std::unique_ptr<VideoWriter> createStreamWriter(uint16_t port, size_t width,
+    size_t height, size_t frameRate, const std::string &encoder)
+{
+  std::ostringstream output;
+  output << "-g " << frameRate << " -bf 0";
+  if (encoder == "libx264") {
+    output << " -preset ultrafast -tune zerolatency";
+  } else if (encoder.find("_nvenc") != std::string::npos) {
+    output << " -preset p1 -tune ull -zerolatency 1";
+  }
+  // Packets are sent as soon as they are muxed
+  output << " -flush_packets 1 -muxdelay 0 -f mpegts"
+         << " \"tcp://0.0.0.0:" << port << "?listen=1\"";
+  return startFfmpeg(width, height, frameRate, encoder, output.str());
+}
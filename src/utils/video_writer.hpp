@@ -0,0 +1,47 @@
+#pragma once
+
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Video files written frame by frame from the pixels of an
+// AsyncImageRenderer (see image_readback.hpp), for output paths with the
+// extension of a video container: .mp4, .mkv, .mov or .webm.
+//
+// Frames are 4 unsigned bytes per pixel (RGBA, alpha ignored), rows bottom
+// row first as read back from OpenGL, and are encoded as they come: the
+// frames of a video are never written as images.
+class VideoWriter
+{
+public:
+  virtual ~VideoWriter() = default;
+
+  // Encode the next frame, returns false once the encoder failed
+  virtual bool writeFrame(const void *pixels) = 0;
+
+  // Encode the frames still buffered and close the file, returns false if
+  // it could not be written
+  virtual bool finish() = 0;
+};
+
+bool isVideoFormat(const fs::path &path);
+
+// Writer of a width x height video at frameRate frames per second, encoded by
+// the codec encoder of an ffmpeg process the frames are piped to: libx264 or
+// libvpx-vp9 in software, or h264_nvenc, hevc_nvenc, h264_vaapi, hevc_vaapi
+// on the GPU, the frames then being uploaded by ffmpeg. Returns null if the
+// process can not be started.
+std::unique_ptr<VideoWriter> createVideoWriter(const fs::path &path,
+    size_t width, size_t height, size_t frameRate, const std::string &encoder);
+
+// Writer of a width x height live stream at frameRate frames per second,
+// served as MPEG-TS to the first client connecting to port over TCP, e.g.
+// "ffplay -fflags nobuffer tcp://<host>:<port>". The encoder is tuned for
+// latency: no B-frames, a keyframe per second, and the low latency presets
+// of libx264 (zerolatency) and of h264_nvenc / hevc_nvenc (p1, ull). Returns
+// null if the ffmpeg process can not be started.
+std::unique_ptr<VideoWriter> createStreamWriter(uint16_t port, size_t width,
+    size_t height, size_t frameRate, const std::string &encoder);
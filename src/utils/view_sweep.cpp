@@ -0,0 +1,151 @@
+#include "view_sweep.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+float draw(std::mt19937 &random, const SweepRange &range)
+{
+  return std::uniform_real_distribution<float>(range.min, range.max)(random);
+}
+
+} // namespace
+
+ViewSweepSpec loadViewSweepSpec(const fs::path &path)
+{
+  std::ifstream input(path.string());
+  if (!input) {
+    throw std::runtime_error("Unable to read sweep from " + path.string());
+  }
+  ViewSweepSpec spec;
+  std::string line;
+  for (size_t lineIdx = 1; std::getline(input, line); ++lineIdx) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream values(line);
+    std::string name;
+    if (!(values >> name)) {
+      continue;
+    }
+    std::vector<float> numbers;
+    float number = 0;
+    while (values >> number) {
+      numbers.push_back(number);
+    }
+    const auto error = [&](const std::string &expected) {
+      return std::runtime_error("Unable to parse sweep at " + path.string() +
+                                ":" + std::to_string(lineIdx) + " (expected " +
+                                expected + ")");
+    };
+    if (!values.eof()) {
+      throw error("numbers after " + name);
+    }
+    const auto range = [&]() {
+      if (numbers.empty() || numbers.size() > 2) {
+        throw error("one value or a min and a max after " + name);
+      }
+      const SweepRange result{numbers.front(), numbers.back()};
+      if (result.min > result.max) {
+        throw error("a min not greater than the max of " + name);
+      }
+      return result;
+    };
+    const auto value = [&]() {
+      if (numbers.size() != 1 || numbers[0] < 0) {
+        throw error("one positive value after " + name);
+      }
+      return numbers[0];
+    };
+    if (name == "count") {
+      spec.count = size_t(value());
+    } else if (name == "seed") {
+      spec.seed = uint32_t(value());
+    } else if (name == "distance") {
+      spec.distance = range();
+    } else if (name == "azimuth") {
+      spec.azimuth = range();
+    } else if (name == "elevation") {
+      spec.elevation = range();
+    } else if (name == "target") {
+      spec.target = value();
+    } else if (name == "sun_theta") {
+      spec.sunTheta = range();
+    } else if (name == "sun_phi") {
+      spec.sunPhi = range();
+    } else if (name == "sun_intensity") {
+      spec.sunIntensity = range();
+    } else {
+      throw error("count, seed, distance, azimuth, elevation, target, "
+                  "sun_theta, sun_phi or sun_intensity");
+    }
+  }
+  return spec;
+}
+
+glm::vec3 SweepView::lightDirection() const
+{
+  return glm::vec3(glm::sin(sunTheta) * glm::cos(sunPhi), glm::cos(sunTheta),
+      glm::sin(sunTheta) * glm::sin(sunPhi));
+}
+
+std::vector<SweepView> generateSweepViews(const ViewSweepSpec &spec,
+    const glm::vec3 &bboxMin, const glm::vec3 &bboxMax)
+{
+  const auto center = 0.5f * (bboxMax + bboxMin);
+  const auto diagonal = std::max(glm::length(bboxMax - bboxMin), 1e-3f);
+  // Views are drawn in sequence, so that view i does not depend on count
+  std::mt19937 random(spec.seed);
+  std::vector<SweepView> views;
+  views.reserve(spec.count);
+  for (size_t i = 0; i < spec.count; ++i) {
+    const auto distance = draw(random, spec.distance) * diagonal;
+    const auto azimuth = glm::radians(draw(random, spec.azimuth));
+    // Not straight above nor below, where the up axis would be the front one
+    const auto elevation =
+        glm::radians(glm::clamp(draw(random, spec.elevation), -89.f, 89.f));
+    auto target = center;
+    if (spec.target > 0) {
+      const SweepRange offset{-spec.target, spec.target};
+      target += diagonal * glm::vec3(draw(random, offset),
+                               draw(random, offset), draw(random, offset));
+    }
+    const auto eye =
+        target + distance * glm::vec3(glm::cos(elevation) * glm::sin(azimuth),
+                                glm::sin(elevation),
+                                glm::cos(elevation) * glm::cos(azimuth));
+    SweepView view;
+    view.camera = Camera(eye, target, glm::vec3(0, 1, 0));
+    view.sunTheta = draw(random, spec.sunTheta);
+    view.sunPhi = draw(random, spec.sunPhi);
+    view.sunIntensity = draw(random, spec.sunIntensity);
+    views.push_back(view);
+  }
+  return views;
+}
+
+std::string getSweepViewName(size_t viewIdx)
+{
+  char name[32];
+  std::snprintf(name, sizeof(name), "sweep_%06zu", viewIdx);
+  return name;
+}
+
+void writeSweepManifest(std::ostream &output,
+    const std::vector<SweepView> &views, const std::string &extension)
+{
+  output << "image,eye_x,eye_y,eye_z,center_x,center_y,center_z,up_x,up_y,"
+            "up_z,sun_theta,sun_phi,sun_intensity\n";
+  for (size_t i = 0; i < views.size(); ++i) {
+    const auto &view = views[i];
+    output << getSweepViewName(i) << extension << ","
+           << formatCamera(view.camera) << "," << view.sunTheta << ","
+           << view.sunPhi << "," << view.sunIntensity << "\n";
+  }
+}
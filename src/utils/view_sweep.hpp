@@ -0,0 +1,76 @@
+#pragma once
+
+#include "cameras.hpp"
+#include "filesystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Range of a parameter of a sweep, drawn uniformly in [min, max]
+struct SweepRange
+{
+  float min;
+  float max;
+};
+
+// Randomized views of a scene and of its sun for --sweep, read from a text
+// file of one parameter per line, a name followed by one value or by the min
+// and max of its range:
+//
+//   count 1000
+//   seed 7
+//   distance 0.75 1.5    # Of the eye to the target, in scene diagonals
+//   azimuth 0 360        # Degrees, around the vertical axis
+//   elevation -10 60     # Degrees, above the horizontal plane
+//   target 0.1           # Offset of the target from the scene center, in
+//                        # scene diagonals
+//   sun_theta 0 1.5708   # Radians, from the vertical axis as in the GUI
+//   sun_phi 0 6.2832     # Radians, around the vertical axis
+//   sun_intensity 1 3
+//
+// Parameters not in the file keep the defaults below. The views only depend
+// on the spec and the scene bounds, so workers sharing a sweep draw the same
+// ones.
+struct ViewSweepSpec
+{
+  size_t count = 100;
+  uint32_t seed = 0;
+  SweepRange distance{0.75f, 1.5f};
+  SweepRange azimuth{0.f, 360.f};
+  SweepRange elevation{-10.f, 60.f};
+  float target = 0.f;
+  SweepRange sunTheta{0.f, 1.5707964f};
+  SweepRange sunPhi{0.f, 6.2831855f};
+  SweepRange sunIntensity{1.f, 1.f};
+};
+
+// Throws std::runtime_error if the file can not be read, or a line is not a
+// known parameter with valid values
+ViewSweepSpec loadViewSweepSpec(const fs::path &path);
+
+// View of a sweep, with the direction towards its sun as set by the GUI
+struct SweepView
+{
+  Camera camera;
+  float sunTheta;
+  float sunPhi;
+  float sunIntensity;
+
+  glm::vec3 lightDirection() const;
+};
+
+// spec.count views around the scene bounds [bboxMin, bboxMax]
+std::vector<SweepView> generateSweepViews(const ViewSweepSpec &spec,
+    const glm::vec3 &bboxMin, const glm::vec3 &bboxMax);
+
+// Name of the image of view viewIdx, without extension
+std::string getSweepViewName(size_t viewIdx);
+
+// CSV of the parameters of views, one row per image named by
+// getSweepViewName with extension: name, then the camera in the format of
+// --lookat, then the sun
+void writeSweepManifest(std::ostream &output,
+    const std::vector<SweepView> &views, const std::string &extension);
@@ -0,0 +1,432 @@
+// Microbenchmarks of the CPU helpers the viewer runs while loading and every
+// frame, on fixed synthetic inputs, so that their cost can be followed in
+// isolation. Each benchmark is run in batches for at least --min-time seconds,
+// the time per call reported is the median of the batches.
+
+#include "utils/animation.hpp"
+#include "utils/bounds.hpp"
+#include "utils/bvh.hpp"
+#include "utils/flat_scene.hpp"
+#include "utils/gltf.hpp"
+#include "utils/gltf_json.hpp"
+#include "utils/images.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/transforms.hpp"
+
+#include <args.hxx>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Read by nothing, written so that the compiler keeps the benchmarked work
+volatile const void *benchmarkSink = nullptr;
+
+template <typename T> void keep(const T &value) { benchmarkSink = &value; }
+
+struct BenchmarkResult
+{
+  std::string name;
+  size_t iterations = 0;
+  double nanosecondsPerCall = 0;
+};
+
+BenchmarkResult runBenchmark(const std::string &name, double minTime,
+    const std::function<void()> &function)
+{
+  using clock = std::chrono::steady_clock;
+  function(); // Warm caches and allocations
+
+  // Batches of about a hundredth of minTime
+  size_t batchSize = 1;
+  for (;;) {
+    const auto start = clock::now();
+    for (size_t i = 0; i < batchSize; ++i) {
+      function();
+    }
+    const std::chrono::duration<double> duration = clock::now() - start;
+    if (duration.count() >= 0.01 * minTime || batchSize >= (size_t(1) << 30)) {
+      break;
+    }
+    batchSize *= 2;
+  }
+  std::vector<double> batchTimes;
+  auto totalTime = 0.;
+  while (totalTime < minTime || batchTimes.size() < 5) {
+    const auto start = clock::now();
+    for (size_t i = 0; i < batchSize; ++i) {
+      function();
+    }
+    const std::chrono::duration<double> duration = clock::now() - start;
+    batchTimes.push_back(duration.count() / double(batchSize));
+    totalTime += duration.count();
+  }
+  std::nth_element(begin(batchTimes),
+      begin(batchTimes) + batchTimes.size() / 2, end(batchTimes));
+  return BenchmarkResult{name, batchSize * batchTimes.size(),
+      batchTimes[batchTimes.size() / 2] * 1e9};
+}
+
+// Append values to the buffer, in an accessor of its own bufferView
+template <typename T>
+int addAccessor(tinygltf::Model &model, const std::vector<T> &values,
+    int componentType, int type)
+{
+  auto &buffer = model.buffers[0];
+  tinygltf::BufferView bufferView;
+  bufferView.buffer = 0;
+  bufferView.byteOffset = buffer.data.size();
+  bufferView.byteLength = values.size() * sizeof(T);
+  buffer.data.resize(buffer.data.size() + bufferView.byteLength);
+  std::memcpy(buffer.data.data() + bufferView.byteOffset, values.data(),
+      bufferView.byteLength);
+  model.bufferViews.push_back(bufferView);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = int(model.bufferViews.size()) - 1;
+  accessor.componentType = componentType;
+  accessor.count = values.size() / tinygltf::GetNumComponentsInType(type);
+  accessor.type = type;
+  model.accessors.push_back(accessor);
+  return int(model.accessors.size()) - 1;
+}
+
+// nodeCount nodes with translation, rotation and scale in groups of 10
+// under the root, drawing meshCount meshes of gridSize x gridSize vertices
+// with materialCount materials. Without accessor bounds, they are computed
+// from the vertices.
+tinygltf::Model createModel(size_t nodeCount, size_t meshCount,
+    size_t materialCount, size_t gridSize, bool withAccessorBounds)
+{
+  tinygltf::Model model;
+  model.buffers.emplace_back();
+  model.materials.resize(materialCount);
+  for (size_t m = 0; m < meshCount; ++m) {
+    std::vector<float> positions;
+    for (size_t y = 0; y < gridSize; ++y) {
+      for (size_t x = 0; x < gridSize; ++x) {
+        positions.insert(end(positions),
+            {float(x) / float(gridSize - 1), float(y) / float(gridSize - 1),
+                float(m) * 0.01f * float((x * y) % 7)});
+      }
+    }
+    std::vector<uint32_t> indices;
+    for (size_t y = 0; y + 1 < gridSize; ++y) {
+      for (size_t x = 0; x + 1 < gridSize; ++x) {
+        const auto a = uint32_t(y * gridSize + x);
+        const auto b = uint32_t(a + gridSize);
+        indices.insert(end(indices), {a, a + 1, b, a + 1, b + 1, b});
+      }
+    }
+    tinygltf::Primitive primitive;
+    primitive.mode = TINYGLTF_MODE_TRIANGLES;
+    primitive.material = int(m % materialCount);
+    primitive.attributes["POSITION"] = addAccessor(model, positions,
+        TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3);
+    if (withAccessorBounds) {
+      model.accessors.back().minValues = {0, 0, 0};
+      model.accessors.back().maxValues = {1, 1, double(m) * 0.06};
+    }
+    primitive.indices = addAccessor(model, indices,
+        TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR);
+    model.meshes.emplace_back();
+    model.meshes.back().primitives.push_back(primitive);
+  }
+
+  model.nodes.emplace_back(); // Root
+  for (size_t i = 0; i < nodeCount; ++i) {
+    if (i % 10 == 0) {
+      model.nodes.emplace_back();
+      model.nodes[0].children.push_back(int(model.nodes.size()) - 1);
+    }
+    const auto group = int(model.nodes.size()) - 1 - int(i % 10);
+    tinygltf::Node node;
+    node.mesh = int(i % meshCount);
+    node.translation = {double(i % 100), 0., double(i / 100)};
+    node.rotation = {0., 0.3826834, 0., 0.9238795};
+    node.scale = {0.5, 0.5, 0.5};
+    model.nodes.push_back(node);
+    model.nodes[group].children.push_back(int(model.nodes.size()) - 1);
+  }
+  model.scenes.emplace_back();
+  model.scenes[0].nodes.push_back(0);
+  model.defaultScene = 0;
+  return model;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  args::ArgumentParser parser{"Microbenchmarks of the glTF viewer helpers."};
+  args::HelpFlag help{parser, "help", "Display this help menu", {'h', "help"}};
+  args::ValueFlag<std::string> filter{parser, "filter",
+      "Only run the benchmarks whose name contains this string", {"filter"}};
+  args::ValueFlag<double> minTime{parser, "min-time",
+      "Seconds each benchmark runs for at least (default 0.5)",
+      {"min-time"}};
+  try {
+    parser.ParseCLI(argc, argv);
+  } catch (const args::Help &) {
+    std::cout << parser;
+    return 0;
+  } catch (const args::Error &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+  const auto benchmarkTime = minTime ? args::get(minTime) : 0.5;
+
+  std::vector<std::pair<std::string, std::function<void()>>> benchmarks;
+
+  const auto model = createModel(10000, 20, 50, 64, true);
+  benchmarks.emplace_back("getLocalToWorldMatrix/10000 nodes", [&]() {
+    auto matrix = glm::mat4(1);
+    for (const auto &node : model.nodes) {
+      matrix[3] += getLocalToWorldMatrix(node, glm::mat4(1))[3];
+    }
+    keep(matrix);
+  });
+
+  benchmarks.emplace_back("computeSceneBounds/accessor bounds", [&]() {
+    glm::vec3 bboxMin, bboxMax;
+    computeSceneBounds(model, bboxMin, bboxMax);
+    keep(bboxMin);
+  });
+  const auto unboundedModel = createModel(1000, 20, 50, 64, false);
+  benchmarks.emplace_back("computeSceneBounds/vertex bounds", [&]() {
+    glm::vec3 bboxMin, bboxMax;
+    computeSceneBounds(unboundedModel, bboxMin, bboxMax);
+    keep(bboxMin);
+  });
+
+  // Normalized 16 bits components, as KHR_mesh_quantization stores normals
+  auto quantizedModel = createModel(1, 1, 1, 2, true);
+  std::vector<uint16_t> quantizedValues(3 * 65536);
+  for (size_t i = 0; i < quantizedValues.size(); ++i) {
+    quantizedValues[i] = uint16_t(i * 7919);
+  }
+  const auto quantizedAccessor = addAccessor(quantizedModel, quantizedValues,
+      TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_VEC3);
+  quantizedModel.accessors[quantizedAccessor].normalized = true;
+  const auto quantizedBufferBytes = getBufferBytes(quantizedModel);
+  std::vector<float> dequantizedValues;
+  benchmarks.emplace_back("readFloatAccessor/65536 normalized VEC3", [&]() {
+    readFloatAccessor(quantizedModel, quantizedBufferBytes, quantizedAccessor,
+        3, dequantizedValues);
+    keep(dequantizedValues);
+  });
+
+  // Nodes and accessors with names and extras, as CAD exports have them,
+  // parsed by tinygltf alone or with --fast-json
+  auto jsonModel = createModel(20000, 2000, 50, 2, true);
+  jsonModel.asset.version = "2.0";
+  for (size_t m = 0; m < jsonModel.materials.size(); ++m) {
+    jsonModel.materials[m].name = "material " + std::to_string(m);
+  }
+  for (size_t n = 0; n < jsonModel.nodes.size(); ++n) {
+    jsonModel.nodes[n].name = "node " + std::to_string(n);
+    jsonModel.nodes[n].extras = tinygltf::Value(tinygltf::Value::Object{
+        {"partNumber", tinygltf::Value(int(n))},
+        {"description", tinygltf::Value(std::string("part \"\u00e9\"\t1"))}});
+  }
+  for (size_t a = 0; a < jsonModel.accessors.size(); ++a) {
+    jsonModel.accessors[a].name = "accessor " + std::to_string(a);
+  }
+  std::string jsonDocument;
+  {
+    std::ostringstream stream;
+    tinygltf::TinyGLTF().WriteGltfSceneToStream(
+        &jsonModel, stream, false, false);
+    jsonDocument = stream.str();
+  }
+  const auto jsonBytes =
+      reinterpret_cast<const unsigned char *>(jsonDocument.data());
+  const auto parseJson = [&](bool fastJson) {
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model parsedModel;
+    std::string err, warn;
+    const auto result =
+        fastJson ? loadGltfWithFastJson(loader, parsedModel, err, warn,
+                       jsonBytes, jsonDocument.size(), false, "")
+                 : loader.LoadASCIIFromString(&parsedModel, &err, &warn,
+                       jsonDocument.data(), (unsigned int)jsonDocument.size(),
+                       "");
+    if (!result || !warn.empty()) {
+      std::cerr << "Error : " << err << warn << std::endl;
+    }
+    return parsedModel;
+  };
+  if (!(parseJson(true) == parseJson(false))) {
+    std::cerr << "Error : loadGltfWithFastJson differs from tinygltf"
+              << std::endl;
+    return 1;
+  }
+  benchmarks.emplace_back("LoadASCIIFromString/22000 nodes", [&]() {
+    const auto parsedModel = parseJson(false);
+    keep(parsedModel);
+  });
+  benchmarks.emplace_back("loadGltfWithFastJson/22000 nodes", [&]() {
+    const auto parsedModel = parseJson(true);
+    keep(parsedModel);
+  });
+
+  const auto bufferBytes = getBufferBytes(model);
+  benchmarks.emplace_back("flattenScene/10000 nodes", [&]() {
+    const auto scene = flattenScene(model, 0, bufferBytes);
+    keep(scene);
+  });
+  auto flatScene = flattenScene(model, 0, bufferBytes);
+  benchmarks.emplace_back("updateWorldMatrices/10000 nodes", [&]() {
+    setLocalMatrix(flatScene, 0, flatScene.localMatrices[0]);
+    updateWorldMatrices(flatScene);
+    keep(flatScene);
+  });
+
+  // Rotation and translation channels on every node drawing a mesh, with
+  // keys every 1/30 s, sampled at the times of 60 Hz frames
+  auto animatedModel = createModel(5000, 20, 50, 2, true);
+  {
+    std::vector<float> times, rotations, translations;
+    for (size_t k = 0; k < 90; ++k) {
+      const auto angle = float(k) * 0.07f;
+      times.push_back(float(k) / 30.f);
+      rotations.insert(end(rotations),
+          {0.f, std::sin(angle / 2.f), 0.f, std::cos(angle / 2.f)});
+      translations.insert(end(translations), {0.f, angle, 0.f});
+    }
+    tinygltf::Animation animation;
+    const auto input = addAccessor(animatedModel, times,
+        TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_SCALAR);
+    for (const auto &values : {rotations, translations}) {
+      tinygltf::AnimationSampler sampler;
+      sampler.input = input;
+      sampler.output = addAccessor(animatedModel, values,
+          TINYGLTF_COMPONENT_TYPE_FLOAT,
+          values.size() == rotations.size() ? TINYGLTF_TYPE_VEC4
+                                            : TINYGLTF_TYPE_VEC3);
+      animation.samplers.push_back(sampler);
+    }
+    for (size_t n = 0; n < animatedModel.nodes.size(); ++n) {
+      if (animatedModel.nodes[n].mesh >= 0) {
+        for (const auto path : {"rotation", "translation"}) {
+          tinygltf::AnimationChannel channel;
+          channel.sampler = int(animation.channels.size() % 2);
+          channel.target_node = int(n);
+          channel.target_path = path;
+          animation.channels.push_back(channel);
+        }
+      }
+    }
+    animatedModel.animations.push_back(animation);
+  }
+  const auto animatedBufferBytes = getBufferBytes(animatedModel);
+  auto animatedScene = flattenScene(animatedModel, 0, animatedBufferBytes);
+  AnimationPlayer animationPlayer(
+      animatedModel, animatedScene, animatedBufferBytes);
+  size_t animationFrame = 0;
+  benchmarks.emplace_back("AnimationPlayer::sample/10000 channels", [&]() {
+    animationPlayer.sample(0, float(animationFrame++) / 60.f, animatedScene);
+    animatedScene.dirtyNodes.clear();
+    keep(animatedScene);
+  });
+  benchmarks.emplace_back("updateWorldMatrices/5000 animated nodes", [&]() {
+    animationPlayer.sample(0, float(animationFrame++) / 60.f, animatedScene);
+    updateWorldMatrices(animatedScene);
+    animatedScene.movedNodes.clear();
+    keep(animatedScene);
+  });
+
+  TrsArrays trs;
+  trs.resize(10000);
+  for (size_t i = 0; i < trs.size(); ++i) {
+    const auto angle = float(i) * 0.01f;
+    trs.setTranslation(i, glm::vec3(float(i), 1.f, 2.f));
+    trs.setRotation(
+        i, glm::vec4(0.f, std::sin(angle / 2.f), 0.f, std::cos(angle / 2.f)));
+    trs.setScale(i, glm::vec3(1.f + angle));
+  }
+  std::vector<glm::mat4> trsMatrices(trs.size());
+  benchmarks.emplace_back("composeTrsMatrices/10000 nodes", [&]() {
+    composeTrsMatrices(trs, nullptr, trs.size(), trsMatrices.data());
+    keep(trsMatrices);
+  });
+
+  std::vector<uint8_t> pixels(2048 * 2048 * 4);
+  benchmarks.emplace_back("flipImageYAxis/2048x2048 RGBA8", [&]() {
+    flipImageYAxis(2048, 2048, 4, pixels.data());
+    keep(pixels);
+  });
+  std::vector<float> floatPixels(1024 * 1024 * 4);
+  benchmarks.emplace_back("flipImageYAxis/1024x1024 RGBA32F", [&]() {
+    flipImageYAxis(1024, 1024, 4, floatPixels.data());
+    keep(floatPixels);
+  });
+
+  // One box per node drawing a mesh, as the draw loop culls them
+  std::vector<BoundingBox> primitiveBounds;
+  for (size_t n = 0; n < flatScene.size(); ++n) {
+    if (flatScene.meshes[n] >= 0) {
+      primitiveBounds.push_back(transformBoundingBox(
+          BoundingBox{glm::vec3(0), glm::vec3(1)}, flatScene.worldMatrices[n]));
+    }
+  }
+  benchmarks.emplace_back("buildBvh/10000 boxes", [&]() {
+    const auto bvh = buildBvh(primitiveBounds);
+    keep(bvh);
+  });
+  const auto bvh = buildBvh(primitiveBounds);
+  const auto frustum = getFrustum(
+      glm::perspective(0.8f, 16.f / 9.f, 0.1f, 100.f) *
+      glm::lookAt(glm::vec3(50, 10, -10), glm::vec3(50, 0, 40),
+          glm::vec3(0, 1, 0)));
+  std::vector<uint8_t> visibleItems;
+  benchmarks.emplace_back("cullBvh/10000 boxes", [&]() {
+    cullBvh(bvh, primitiveBounds, frustum, visibleItems);
+    keep(visibleItems);
+  });
+
+  // Material binds are only issued between draws of different materials,
+  // in the order of getDrawOrder
+  std::vector<DrawCommand> drawCommands;
+  for (size_t n = 0; n < flatScene.size(); ++n) {
+    if (flatScene.meshes[n] >= 0) {
+      const auto mesh = flatScene.meshes[n];
+      drawCommands.push_back(DrawCommand{int(n),
+          model.meshes[mesh].primitives[0].material, mesh, GLuint(mesh + 1),
+          GL_TRIANGLES, 63 * 63 * 6, GL_UNSIGNED_INT, 0, 0, 64 * 64 - 1});
+    }
+  }
+  benchmarks.emplace_back("getDrawOrder/10000 draws", [&]() {
+    const auto order = getDrawOrder(drawCommands);
+    keep(order);
+  });
+
+  std::cout << std::left << std::setw(40) << "benchmark" << std::right
+            << std::setw(14) << "iterations" << std::setw(16) << "ns/call"
+            << std::endl;
+  for (const auto &benchmark : benchmarks) {
+    if (filter &&
+        benchmark.first.find(args::get(filter)) == std::string::npos) {
+      continue;
+    }
+    const auto result =
+        runBenchmark(benchmark.first, benchmarkTime, benchmark.second);
+    std::cout << std::left << std::setw(40) << result.name << std::right
+              << std::setw(14) << result.iterations << std::setw(16)
+              << std::fixed << std::setprecision(1) << result.nanosecondsPerCall
+              << std::endl;
+  }
+  return 0;
+}
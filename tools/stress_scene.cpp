@@ -0,0 +1,363 @@
+// Writes synthetic glTF scenes with a controlled number of nodes, meshes,
+// materials, textures and triangles, to benchmark how the viewer scales with
+// them (see the bench command of gltf-viewer).
+//
+// Nodes are laid out on a grid in the XZ plane, under a hierarchy of group
+// nodes of the given depth. Node i draws mesh i % meshes, mesh j has material
+// j % materials and material k samples texture k % textures. Meshes are UV
+// spheres of 2 * slices * stacks triangles, squashed by a different amount
+// each. The output is fully determined by the arguments.
+
+#include <tiny_gltf.h>
+
+#include <args.hxx>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const auto pi = 3.14159265358979323846;
+
+struct SceneParameters
+{
+  size_t nodeCount = 1000;
+  size_t meshCount = 10;
+  size_t materialCount = 10;
+  size_t textureCount = 0;
+  size_t textureSize = 256;
+  size_t trianglesPerMesh = 1000;
+  size_t depth = 1; // Of group nodes above the nodes drawing meshes
+};
+
+// Append values to the buffer, in an accessor of its own bufferView
+template <typename T>
+int addAccessor(tinygltf::Model &model, const std::vector<T> &values,
+    int componentType, int type, int target)
+{
+  auto &buffer = model.buffers[0];
+  // Accessor offsets must be aligned on the size of their components
+  buffer.data.resize((buffer.data.size() + 3) & ~size_t(3));
+  tinygltf::BufferView bufferView;
+  bufferView.buffer = 0;
+  bufferView.byteOffset = buffer.data.size();
+  bufferView.byteLength = values.size() * sizeof(T);
+  bufferView.target = target;
+  buffer.data.resize(buffer.data.size() + bufferView.byteLength);
+  std::memcpy(buffer.data.data() + bufferView.byteOffset, values.data(),
+      bufferView.byteLength);
+  model.bufferViews.push_back(bufferView);
+
+  tinygltf::Accessor accessor;
+  accessor.bufferView = int(model.bufferViews.size()) - 1;
+  accessor.byteOffset = 0;
+  accessor.componentType = componentType;
+  accessor.count = values.size() / tinygltf::GetNumComponentsInType(type);
+  accessor.type = type;
+  model.accessors.push_back(accessor);
+  return int(model.accessors.size()) - 1;
+}
+
+// UV sphere of radius 1, its height scaled by heightScale
+void addSphereMesh(tinygltf::Model &model, size_t triangleCount,
+    float heightScale, int material)
+{
+  // 2 * slices * stacks triangles, with slices = 2 * stacks
+  const auto stacks = std::max(
+      size_t(std::lround(std::sqrt(double(triangleCount) / 4.))), size_t(2));
+  const auto slices = 2 * stacks;
+  std::vector<float> positions, normals, texCoords;
+  for (size_t i = 0; i <= stacks; ++i) {
+    const auto theta = float(pi) * float(i) / float(stacks);
+    for (size_t j = 0; j <= slices; ++j) {
+      const auto phi = 2.f * float(pi) * float(j) / float(slices);
+      const float normal[] = {std::sin(theta) * std::cos(phi), std::cos(theta),
+          std::sin(theta) * std::sin(phi)};
+      positions.insert(end(positions),
+          {normal[0], heightScale * normal[1], normal[2]});
+      normals.insert(end(normals), std::begin(normal), std::end(normal));
+      texCoords.insert(end(texCoords),
+          {float(j) / float(slices), float(i) / float(stacks)});
+    }
+  }
+  std::vector<uint32_t> indices;
+  for (size_t i = 0; i < stacks; ++i) {
+    for (size_t j = 0; j < slices; ++j) {
+      const auto a = uint32_t(i * (slices + 1) + j);
+      const auto b = uint32_t(a + slices + 1);
+      indices.insert(end(indices), {a, a + 1, b, a + 1, b + 1, b});
+    }
+  }
+
+  tinygltf::Primitive primitive;
+  primitive.mode = TINYGLTF_MODE_TRIANGLES;
+  primitive.material = material;
+  primitive.attributes["POSITION"] = addAccessor(model, positions,
+      TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3,
+      TINYGLTF_TARGET_ARRAY_BUFFER);
+  auto &positionAccessor = model.accessors.back();
+  positionAccessor.minValues = {-1, -heightScale, -1};
+  positionAccessor.maxValues = {1, heightScale, 1};
+  primitive.attributes["NORMAL"] = addAccessor(model, normals,
+      TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3,
+      TINYGLTF_TARGET_ARRAY_BUFFER);
+  primitive.attributes["TEXCOORD_0"] = addAccessor(model, texCoords,
+      TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2,
+      TINYGLTF_TARGET_ARRAY_BUFFER);
+  primitive.indices = addAccessor(model, indices,
+      TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR,
+      TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+
+  tinygltf::Mesh mesh;
+  mesh.primitives.push_back(primitive);
+  model.meshes.push_back(mesh);
+}
+
+// Color of material or texture i, hues spread around the color wheel
+std::vector<double> getColor(size_t i, size_t count)
+{
+  const auto hue = 6. * double(i) / double(std::max(count, size_t(1)));
+  std::vector<double> color(3);
+  for (size_t c = 0; c < 3; ++c) {
+    const auto h = std::fmod(hue + 4. * double(c), 6.);
+    color[c] = 0.2 + 0.8 * std::max(0., std::min(1., std::abs(h - 3.) - 1.));
+  }
+  return color;
+}
+
+// Checkerboard of 8 x 8 squares, the light squares of color
+void addTexture(tinygltf::Model &model, size_t size,
+    const std::vector<double> &color, const std::string &uri)
+{
+  tinygltf::Image image;
+  image.uri = uri;
+  image.width = int(size);
+  image.height = int(size);
+  image.component = 4;
+  image.bits = 8;
+  image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+  image.image.resize(size * size * 4);
+  const auto squareSize = std::max(size / 8, size_t(1));
+  for (size_t y = 0; y < size; ++y) {
+    for (size_t x = 0; x < size; ++x) {
+      const auto isLight = (x / squareSize + y / squareSize) % 2 == 0;
+      auto *pixel = &image.image[(y * size + x) * 4];
+      for (size_t c = 0; c < 3; ++c) {
+        pixel[c] = uint8_t(isLight ? 255. * color[c] : 32.);
+      }
+      pixel[3] = 255;
+    }
+  }
+  model.images.push_back(image);
+
+  tinygltf::Texture texture;
+  texture.sampler = 0;
+  texture.source = int(model.images.size()) - 1;
+  model.textures.push_back(texture);
+}
+
+// Add count nodes drawing meshes under parent, nodes firstNode to firstNode +
+// count of the grid, through levels levels of group nodes
+void addNodes(tinygltf::Model &model, int parent, size_t firstNode,
+    size_t count, size_t levels, const SceneParameters &parameters)
+{
+  if (levels == 0) {
+    const auto gridSize =
+        size_t(std::ceil(std::sqrt(double(parameters.nodeCount))));
+    for (auto i = firstNode; i < firstNode + count; ++i) {
+      tinygltf::Node node;
+      node.mesh = int(i % parameters.meshCount);
+      node.translation = {2.5 * double(i % gridSize), 0.,
+          2.5 * double(i / gridSize)};
+      model.nodes.push_back(node);
+      model.nodes[parent].children.push_back(int(model.nodes.size()) - 1);
+    }
+    return;
+  }
+  // Children split evenly in the remaining levels
+  const auto groupCount = std::max(
+      size_t(std::ceil(std::pow(double(count), 1. / double(levels + 1)))),
+      size_t(1));
+  const auto groupSize = (count + groupCount - 1) / groupCount;
+  for (size_t begin = 0; begin < count; begin += groupSize) {
+    model.nodes.emplace_back();
+    const auto group = int(model.nodes.size()) - 1;
+    model.nodes[parent].children.push_back(group);
+    addNodes(model, group, firstNode + begin,
+        std::min(groupSize, count - begin), levels - 1, parameters);
+  }
+}
+
+tinygltf::Model createScene(
+    const SceneParameters &parameters, const std::string &imagePrefix)
+{
+  tinygltf::Model model;
+  model.asset.version = "2.0";
+  model.asset.generator = "gltf-stress-scene";
+  model.buffers.emplace_back();
+
+  tinygltf::Sampler sampler;
+  sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+  sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+  model.samplers.push_back(sampler);
+  for (size_t i = 0; i < parameters.textureCount; ++i) {
+    addTexture(model, parameters.textureSize,
+        getColor(i, parameters.textureCount),
+        imagePrefix + std::to_string(i) + ".png");
+  }
+  for (size_t i = 0; i < parameters.materialCount; ++i) {
+    tinygltf::Material material;
+    auto &pbr = material.pbrMetallicRoughness;
+    if (parameters.textureCount) {
+      pbr.baseColorTexture.index = int(i % parameters.textureCount);
+    } else {
+      pbr.baseColorFactor = getColor(i, parameters.materialCount);
+      pbr.baseColorFactor.push_back(1.);
+    }
+    pbr.metallicFactor = 0.;
+    pbr.roughnessFactor =
+        0.2 + 0.8 * double(i) / double(parameters.materialCount);
+    model.materials.push_back(material);
+  }
+  for (size_t i = 0; i < parameters.meshCount; ++i) {
+    addSphereMesh(model, parameters.trianglesPerMesh,
+        1.f - 0.5f * float(i) / float(parameters.meshCount),
+        int(i % parameters.materialCount));
+  }
+
+  model.nodes.emplace_back(); // Root
+  addNodes(model, 0, 0, parameters.nodeCount, parameters.depth - 1,
+      parameters);
+  tinygltf::Scene scene;
+  scene.nodes.push_back(0);
+  model.scenes.push_back(scene);
+  model.defaultScene = 0;
+  return model;
+}
+
+std::string getExtension(const std::string &path)
+{
+  const auto dot = path.find_last_of('.');
+  if (dot == std::string::npos || path.find_first_of("/\\", dot) != path.npos) {
+    return "";
+  }
+  auto extension = path.substr(dot + 1);
+  std::transform(begin(extension), end(extension), begin(extension),
+      [](unsigned char c) { return char(std::tolower(c)); });
+  return extension;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  args::ArgumentParser parser{
+      "Write a synthetic glTF scene to benchmark the glTF viewer."};
+  args::HelpFlag help{parser, "help", "Display this help menu", {'h', "help"}};
+  args::Positional<std::string> output{parser, "output",
+      "Path of the .gltf file, written with a .bin file and PNG textures "
+      "next to it, or of a .glb file embedding them",
+      args::Options::Required};
+  args::ValueFlag<int32_t> nodeCount{
+      parser, "nodes", "Number of nodes drawing a mesh (default 1000)",
+      {"nodes"}};
+  args::ValueFlag<int32_t> meshCount{parser, "meshes",
+      "Number of distinct meshes, shared by the nodes (default 10)",
+      {"meshes"}};
+  args::ValueFlag<int32_t> materialCount{
+      parser, "materials", "Number of materials (default 10)", {"materials"}};
+  args::ValueFlag<int32_t> textureCount{parser, "textures",
+      "Number of base color textures, shared by the materials (default 0, "
+      "materials only have a color)",
+      {"textures"}};
+  args::ValueFlag<int32_t> textureSize{parser, "texture-size",
+      "Width and height of textures in pixels (default 256)",
+      {"texture-size"}};
+  args::ValueFlag<int32_t> trianglesPerMesh{parser, "triangles",
+      "Approximate number of triangles of each mesh (default 1000)",
+      {"triangles"}};
+  args::ValueFlag<int32_t> depth{parser, "depth",
+      "Depth of the hierarchy above the nodes drawing meshes, including the "
+      "root (default 1, all of them are children of the root)",
+      {"depth"}};
+
+  SceneParameters parameters;
+  try {
+    parser.ParseCLI(argc, argv);
+    const auto getCount = [](args::ValueFlag<int32_t> &flag, int32_t min,
+                              size_t defaultValue) {
+      if (!flag) {
+        return defaultValue;
+      }
+      if (args::get(flag) < min) {
+        throw args::ValidationError(
+            "--" + flag.Name() + " must be at least " + std::to_string(min));
+      }
+      return size_t(args::get(flag));
+    };
+    parameters.nodeCount = getCount(nodeCount, 1, parameters.nodeCount);
+    parameters.meshCount = getCount(meshCount, 1, parameters.meshCount);
+    parameters.materialCount =
+        getCount(materialCount, 1, parameters.materialCount);
+    parameters.textureCount =
+        getCount(textureCount, 0, parameters.textureCount);
+    parameters.textureSize = getCount(textureSize, 1, parameters.textureSize);
+    parameters.trianglesPerMesh =
+        getCount(trianglesPerMesh, 1, parameters.trianglesPerMesh);
+    parameters.depth = getCount(depth, 1, parameters.depth);
+    const auto extension = getExtension(args::get(output));
+    if (extension != "gltf" && extension != "glb") {
+      throw args::ValidationError("The output must be a .gltf or .glb file");
+    }
+  } catch (const args::Help &) {
+    std::cout << parser;
+    return 0;
+  } catch (const args::Error &e) {
+    std::cerr << e.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+
+  // Files next to the output are named after it
+  const auto &outputPath = args::get(output);
+  const auto isBinary = getExtension(outputPath) == "glb";
+  const auto fileName = outputPath.substr(outputPath.find_last_of("/\\") + 1);
+  const auto stem = fileName.substr(0, fileName.find_last_of('.'));
+  auto model = createScene(parameters, stem + "_texture_");
+  if (!isBinary) {
+    model.buffers[0].uri = stem + ".bin";
+  }
+
+  // The binary writer of tinygltf does not report files it can not open
+  tinygltf::TinyGLTF gltf;
+  if (!gltf.WriteGltfSceneToFile(
+          &model, outputPath, isBinary, isBinary, !isBinary, isBinary) ||
+      std::ifstream(outputPath, std::ios::binary | std::ios::ate).tellg() <=
+          0) {
+    std::cerr << "Error : unable to write " << outputPath << std::endl;
+    return -1;
+  }
+
+  size_t triangleCount = 0;
+  for (const auto &node : model.nodes) {
+    if (node.mesh >= 0) {
+      triangleCount +=
+          model.accessors[model.meshes[node.mesh].primitives[0].indices]
+              .count /
+          3;
+    }
+  }
+  std::cout << outputPath << ": " << model.nodes.size() << " nodes, "
+            << parameters.nodeCount << " draws, " << model.meshes.size()
+            << " meshes, " << model.materials.size() << " materials, "
+            << model.textures.size() << " textures, " << triangleCount
+            << " triangles" << std::endl;
+  return 0;
+}